@@ -95,7 +95,10 @@ to exclude the API function. */
 /* Normal assert() semantics without relying on the provision of an assert.h
 header file. */
 /* USER CODE BEGIN 1 */
-#define configASSERT( x ) if ((x) == 0) {taskDISABLE_INTERRUPTS(); for( ;; );}
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+void vAssertCalled(void);
+#endif
+#define configASSERT( x ) if ((x) == 0) {vAssertCalled();}
 /* USER CODE END 1 */
 
 /* Definitions that map the FreeRTOS port interrupt handlers to their CMSIS
@@ -110,6 +113,15 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS  1   /* Task IDs of the logger when LOG_CONTEXT_IDS is set */
+#define configUSE_TICKLESS_IDLE                  0   /* Set to 1 with VCP_LOW_POWER or LPUART_BACKEND, and LOG_LOW_POWER */
+#if configUSE_TICKLESS_IDLE && (defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__))
+void app_pre_sleep(uint32_t *pIdleTime);                /* app_freertos.c, for the log backend in use */
+#define configPRE_SLEEP_PROCESSING(x)            app_pre_sleep(&(x))
+#endif
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+#include "log_trace.h"                                  /* Kernel trace macros and run time stats of the logger */
+#endif
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
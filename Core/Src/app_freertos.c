@@ -25,7 +25,12 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-
+#include "log.h"
+#include "vcp.h"
+#include "rtt.h"
+#include "lpuart.h"
+#include "spi_log.h"
+#include "stripe.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -35,7 +40,11 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
-
+#if LOG_IDLE_HOOK_ITEMS
+#define IDLE_STACK_SIZE     256         /* The logs are formatted on the idle task stack */
+#else
+#define IDLE_STACK_SIZE     configMINIMAL_STACK_SIZE
+#endif
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -58,20 +67,59 @@ void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer, StackTy
 
 /* USER CODE BEGIN GET_IDLE_TASK_MEMORY */
 static StaticTask_t xIdleTaskTCBBuffer;
-static StackType_t xIdleStack[configMINIMAL_STACK_SIZE];
+static StackType_t xIdleStack[IDLE_STACK_SIZE];
 
 void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize )
 {
   *ppxIdleTaskTCBBuffer = &xIdleTaskTCBBuffer;
   *ppxIdleTaskStackBuffer = &xIdleStack[0];
-  *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+  *pulIdleTaskStackSize = IDLE_STACK_SIZE;
   /* place for user code */
 }
 /* USER CODE END GET_IDLE_TASK_MEMORY */
 
 /* Private application code --------------------------------------------------*/
 /* USER CODE BEGIN Application */
+#if LOG_IDLE_HOOK_ITEMS
+/* Replaces the logger thread, the logs are output while nothing else runs */
+void vApplicationIdleHook(void)
+{
+  log_idle_hook();
+}
+#endif
 
+#if configUSE_TICKLESS_IDLE
+/* configPRE_SLEEP_PROCESSING(), the sleep is put off while the log backend still needs the core */
+void app_pre_sleep(uint32_t *pIdleTime)
+{
+#if LPUART_BACKEND
+  lpuart_pre_sleep(pIdleTime);
+#elif VCP_LOW_POWER
+  vcp_pre_sleep(pIdleTime);
+#endif
+}
+#endif
+
+/* Called by configASSERT(), the pending logs are sent before halting */
+void vAssertCalled(void)
+{
+  taskDISABLE_INTERRUPTS();
+#if RTT_BACKEND
+  log_panic_flush(rtt_send);
+#elif LPUART_BACKEND
+  log_panic_flush(lpuart_panic_send);
+#elif SPI_LOG_BACKEND
+  log_panic_flush(spi_log_panic_send);
+#elif STRIPE_BACKEND
+  log_panic_flush(stripe_panic_send);
+#else
+  log_panic_flush(vcp_panic_send);
+#endif
+#if LOG_POST_MORTEM
+  log_post_mortem_save();
+#endif
+  for( ;; );
+}
 /* USER CODE END Application */
 
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
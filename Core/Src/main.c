@@ -25,6 +25,15 @@
 /* USER CODE BEGIN Includes */
 #include "log.h"
 #include "vcp.h"
+#include "log_bench.h"
+#include "log_stress.h"
+#include "log_throughput.h"
+#include "flash_log.h"
+#include "rtt.h"
+#include "itm.h"
+#include "lpuart.h"
+#include "spi_log.h"
+#include "stripe.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -46,15 +55,19 @@ TIM_HandleTypeDef htim2;
 
 UART_HandleTypeDef huart2;
 
+#if !LOG_IDLE_HOOK_ITEMS
 osThreadId logger_thHandle;
 uint32_t logger_th_buffer[ 256 ];
 osStaticThreadDef_t logger_th_cb;
+#endif
 osThreadId demo_thHandle;
 uint32_t demo_th_buffer[ 128 ];
 osStaticThreadDef_t demo_th_cb;
+#if !VCP_DIRECT && !VCP_TX_IRQ && !RTT_BACKEND && !ITM_BACKEND && !LPUART_BACKEND && !SPI_LOG_BACKEND && !LOG_DRAIN_BACKEND
 osThreadId vcp_thHandle;
 uint32_t vcpThBuffer[ 128 ];
 osStaticThreadDef_t vcpThCb;
+#endif
 /* USER CODE BEGIN PV */
 /* USER CODE END PV */
 
@@ -73,6 +86,13 @@ void entry_vcp_th(void const * argument);
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
+#if LOG_BOOT_MARKS && !RTT_BACKEND && !ITM_BACKEND && !LPUART_BACKEND && !SPI_LOG_BACKEND
+// Polled output of log_boot_flush(), before vcp_init() takes the UART over
+static void boot_uart_send(void* pData, uint32_t nBytes)
+{
+  HAL_UART_Transmit(&huart2, pData, nBytes, HAL_MAX_DELAY);
+}
+#endif
 
 /* USER CODE END 0 */
 
@@ -92,6 +112,7 @@ int main(void)
   HAL_Init();
 
   /* USER CODE BEGIN Init */
+  log_early_init();
 
   /* USER CODE END Init */
 
@@ -99,6 +120,7 @@ int main(void)
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
+  LOG_BOOT_MARK(SystemClock_Config);
 
   /* USER CODE END SysInit */
 
@@ -107,6 +129,10 @@ int main(void)
   MX_USART2_UART_Init();
   MX_TIM2_Init();
   /* USER CODE BEGIN 2 */
+  LOG_BOOT_MARK(MX_Init);
+#if LOG_BOOT_MARKS && !RTT_BACKEND && !ITM_BACKEND && !LPUART_BACKEND && !SPI_LOG_BACKEND
+  log_boot_flush(boot_uart_send);
+#endif
 
   /* USER CODE END 2 */
 
@@ -127,21 +153,61 @@ int main(void)
   /* USER CODE END RTOS_QUEUES */
 
   /* Create the thread(s) */
+#if !LOG_IDLE_HOOK_ITEMS
   /* definition and creation of logger_th */
   osThreadStaticDef(logger_th, entry_logger_thread, osPriorityLow, 0, 256, logger_th_buffer, &logger_th_cb);
   logger_thHandle = osThreadCreate(osThread(logger_th), NULL);
+#endif
 
   /* definition and creation of demo_th */
   osThreadStaticDef(demo_th, entry_demo_th, osPriorityNormal, 0, 128, demo_th_buffer, &demo_th_cb);
   demo_thHandle = osThreadCreate(osThread(demo_th), NULL);
 
+#if !VCP_DIRECT && !VCP_TX_IRQ && !RTT_BACKEND && !ITM_BACKEND && !LPUART_BACKEND && !SPI_LOG_BACKEND && !LOG_DRAIN_BACKEND
   /* definition and creation of vcp_th */
   osThreadStaticDef(vcp_th, entry_vcp_th, osPriorityIdle, 0, 128, vcpThBuffer, &vcpThCb);
   vcp_thHandle = osThreadCreate(osThread(vcp_th), NULL);
+#endif
 
   /* USER CODE BEGIN RTOS_THREADS */
+#if RTT_BACKEND
+  rtt_init();
+  log_init(rtt_send, NULL);
+  log_set_ready_handler(rtt_is_ready);
+#elif ITM_BACKEND
+  itm_init();
+  log_init(itm_send, itm_flush);
+  log_set_ready_handler(itm_is_ready);
+#elif LPUART_BACKEND
+  lpuart_init();
+  log_init(lpuart_send, lpuart_flush);
+  log_set_ready_handler(lpuart_is_ready);
+#elif SPI_LOG_BACKEND
+  spi_log_init();
+  log_init(spi_log_send, spi_log_flush);
+  log_set_ready_handler(spi_log_is_ready);
+#elif STRIPE_BACKEND
+  vcp_init(&huart2);
+  stripe_init();
+  log_init(stripe_send, stripe_flush);
+  log_set_ready_handler(stripe_is_ready);
+#else
   vcp_init(&huart2);
   log_init(vcp_send, vcp_flush);
+  log_set_ready_handler(vcp_is_ready);
+#if VCP_URGENT_BUFFER_SIZE && LOG_ERROR_FIFO_N_ELEM && !LOG_BINARY_OUTPUT
+  log_set_urgent_handler(vcp_send_urgent);
+#endif
+#endif
+#if LOG_N_BACKENDS > 1
+  flash_log_init();
+  // The error and warning files and the log_err_ calls of any file
+  log_add_backend(flash_log_send, flash_log_flush, LOG_LEVEL_BIT(LOG_LEVEL_ERROR) | LOG_LEVEL_BIT(LOG_LEVEL_WARNING), NULL, 0);
+#endif
+#if VCP_RX_LINE_SIZE && _LOG_COMMANDS && !RTT_BACKEND && !ITM_BACKEND && !LPUART_BACKEND && !SPI_LOG_BACKEND
+  vcp_set_rx_handler(log_command);
+#endif
+  LOG_BOOT_MARK(log_init);
 
   /* USER CODE END RTOS_THREADS */
 
@@ -408,6 +474,27 @@ void entry_demo_th(void const * argument)
   /* USER CODE BEGIN entry_demo_th */
     volatile uint32_t exec_time;
     HAL_TIM_Base_Start(&htim2);
+#if LOG_BENCH && RTT_BACKEND
+    log_bench_run(rtt_send, NULL);
+#elif LOG_BENCH && ITM_BACKEND
+    log_bench_run(itm_send, itm_flush);
+#elif LOG_BENCH && LPUART_BACKEND
+    log_bench_run(lpuart_send, lpuart_flush);
+#elif LOG_BENCH && SPI_LOG_BACKEND
+    log_bench_run(spi_log_send, spi_log_flush);
+#elif LOG_BENCH
+    log_bench_run(vcp_send, vcp_flush);
+#endif
+#if LOG_THROUGHPUT && !RTT_BACKEND && !ITM_BACKEND && !LPUART_BACKEND && !SPI_LOG_BACKEND && !STRIPE_BACKEND
+    log_throughput_run();
+    for(;;)
+        osDelay(1000);
+#endif
+#if LOG_STRESS
+    log_stress_run();
+    for(;;)
+        osDelay(1000);
+#endif
 
   /* Infinite loop */
   for(;;)
@@ -434,104 +521,75 @@ void entry_demo_th(void const * argument)
       log_flush();
 
       log_array_dec(array8, 4);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_array_dec(array16, 4);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_array_dec(array32, 4);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_array_dec(arrays16, 4);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_array_dec(arrays32, 4);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_array_hex(arrayh8, 4);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_array_hex(arrayh16, 4);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_array_hex(arrayh32, 4);
-      log_char('\r');
-      log_char('\n');
-      log_char('\r');
-      log_char('\n');
+      log_eol();
+      log_eol();
 
 
       log_dec(0);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_dec(100);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_dec(123);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_dec(12345, LOG_COLOR_YELLOW);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_dec(1234567890, LOG_COLOR_GREEN);
       log_char('\r', LOG_COLOR_YELLOW);
       log_char('\n', LOG_COLOR_DEFAULT);
 
       log_hex((uint8_t)0x12);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_hex((uint16_t)0x1234);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_hex((uint32_t)0x123456);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_hex((uint32_t)0x12345678);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
 
       log_dec(-123);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_dec(-12345);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       log_dec(-1234567890);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
 
       logc_str(1, "Conditional positive\r\n", LOG_COLOR_DEFAULT);
       logc_dec(1, (uint8_t)123);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       logc_hex(1, (uint8_t)0x12);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       logc_dec(0, (uint8_t)88);
       logc_hex(0, (uint8_t)0x77);
       logc_str(1, "Conditional positive\r\n");
       logc_str(0, "Conditional negative\r\n");
-      log_char('\r');
-      log_char('\n');
+      log_eol();
 
       logc_char(1, 'a');
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       logc_char(1, 'a', LOG_COLOR_RED);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       logc_array_dec(1, arrayh16, 2, LOG_COLOR_RED);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       logc_array_hex(1, arrayh16, 2, LOG_COLOR_RED);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       logc_array_dec(1, arrayh16, 2);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       logc_array_hex(1, arrayh16, 2);
-      log_char('\r');
-      log_char('\n');
+      log_eol();
       osDelay(500);
   }
   /* USER CODE END entry_demo_th */
@@ -581,6 +639,22 @@ void Error_Handler(void)
   /* USER CODE BEGIN Error_Handler_Debug */
   /* User can add his own implementation to report the HAL error return state */
   __disable_irq();
+#if RTT_BACKEND
+  log_panic_flush(rtt_send);
+#elif ITM_BACKEND
+  log_panic_flush(itm_send);
+#elif LPUART_BACKEND
+  log_panic_flush(lpuart_panic_send);
+#elif SPI_LOG_BACKEND
+  log_panic_flush(spi_log_panic_send);
+#elif STRIPE_BACKEND
+  log_panic_flush(stripe_panic_send);
+#else
+  log_panic_flush(vcp_panic_send);
+#endif
+#if LOG_POST_MORTEM
+  log_post_mortem_save();
+#endif
   while (1)
   {
   }
@@ -23,6 +23,13 @@
 #include "stm32g0xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "vcp.h"
+#include "rtt.h"
+#include "lpuart.h"
+#include "spi_log.h"
+#include "stripe.h"
+#include "log.h"
+#include "log_stress.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -86,7 +93,20 @@ void NMI_Handler(void)
 void HardFault_Handler(void)
 {
   /* USER CODE BEGIN HardFault_IRQn 0 */
-
+#if RTT_BACKEND
+  log_panic_flush(rtt_send);
+#elif LPUART_BACKEND
+  log_panic_flush(lpuart_panic_send);
+#elif SPI_LOG_BACKEND
+  log_panic_flush(spi_log_panic_send);
+#elif STRIPE_BACKEND
+  log_panic_flush(stripe_panic_send);
+#else
+  log_panic_flush(vcp_panic_send);
+#endif
+#if LOG_POST_MORTEM
+  log_post_mortem_save();
+#endif
   /* USER CODE END HardFault_IRQn 0 */
   while (1)
   {
@@ -117,6 +137,91 @@ void TIM17_IRQHandler(void)
 }
 
 /* USER CODE BEGIN 1 */
+#if VCP_USE_DMA
+/**
+  * @brief This function handles DMA1 channel 1 interrupt, used by vcp for USART2 TX.
+  */
+void DMA1_Channel1_IRQHandler(void)
+{
+  vcp_dma_irq_handler();
+}
+#endif
 
+#if LPUART_BACKEND
+/**
+  * @brief This function handles DMA1 channel 2 and 3 interrupts, used by lpuart for LPUART1 TX.
+  */
+void DMA1_Channel2_3_IRQHandler(void)
+{
+  lpuart_dma_irq_handler();
+}
+#elif SPI_LOG_BACKEND
+/**
+  * @brief This function handles DMA1 channel 2 and 3 interrupts, used by spi_log for SPI1 TX.
+  */
+void DMA1_Channel2_3_IRQHandler(void)
+{
+  spi_log_dma_irq_handler();
+}
+#elif STRIPE_BACKEND
+/**
+  * @brief This function handles DMA1 channel 2 and 3 interrupts, used by stripe for USART1 TX and by vcp for USART2 RX.
+  */
+void DMA1_Channel2_3_IRQHandler(void)
+{
+  stripe_dma_irq_handler();
+#if VCP_RX_DMA
+  vcp_rx_dma_irq_handler();
+#endif
+}
+#elif VCP_RX_DMA
+/**
+  * @brief This function handles DMA1 channel 2 and 3 interrupts, used by vcp for USART2 RX.
+  */
+void DMA1_Channel2_3_IRQHandler(void)
+{
+  vcp_rx_dma_irq_handler();
+}
+#endif
+
+#if VCP_USE_DMA || VCP_RX_LINE_SIZE || VCP_TX_IRQ
+/**
+  * @brief This function handles USART2 global interrupt.
+  */
+void USART2_IRQHandler(void)
+{
+  vcp_uart_irq_handler();
+}
+#endif
+
+#if LOG_STRESS && LOG_STRESS_ISR
+/**
+  * @brief This function handles TIM7 and LPTIM2 interrupts, used by log_stress for its ISR producer.
+  */
+void TIM7_LPTIM2_IRQHandler(void)
+{
+  log_stress_tim_irq_handler();
+}
+#endif
+
+#if LOG_STRESS && LOG_STRESS_JITTER
+/**
+  * @brief This function handles TIM6, DAC and LPTIM1 interrupts, used by log_stress to measure the interrupt latency.
+  */
+void TIM6_DAC_LPTIM1_IRQHandler(void)
+{
+  log_stress_jitter_irq_handler();
+}
+#endif
+
+#if LOG_POWER_FAIL_SAVE
+/**
+  * @brief This function handles the PVD interrupt, which saves the pending logs to flash before the power is lost.
+  */
+void PVD_IRQHandler(void)
+{
+  log_power_fail_irq_handler();
+}
+#endif
 /* USER CODE END 1 */
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
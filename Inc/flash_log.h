@@ -0,0 +1,24 @@
+#ifndef FLASH_LOG_H_
+#define FLASH_LOG_H_
+
+
+#include "main.h"
+#include <stdbool.h>
+
+
+#define FLASH_LOG_ROW_SIZE          256                     // Bytes buffered in RAM before programming them (multiple of 8)
+
+
+// Receives the stored bytes in flash_log_dump()
+typedef void (*flash_log_out_handler)(void* pData, uint32_t nBytes);
+
+
+void flash_log_send(void* pData, uint32_t nBytes);
+void flash_log_flush(void);
+uint32_t flash_log_dropped(void);
+void flash_log_dump(flash_log_out_handler handler);
+void flash_log_erase(void);
+void flash_log_init(void);
+
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef ITM_H_
+#define ITM_H_
+
+
+#include "main.h"
+#include <stdbool.h>
+
+
+#define ITM_BACKEND                 0                       // main.c logs to the ITM stimulus ports over SWO, Cortex-M3 and above only
+#define ITM_TEXT_PORT               0                       // Stimulus port of the text output, the one SWO viewers show
+#define ITM_BINARY_PORT             1                       // Stimulus port of the LOG_BINARY_OUTPUT records
+#define ITM_SWO_HZ                  2000000                 // SWO bit rate set by itm_init(), 0 leaves the trace setup to the debugger
+
+
+void itm_send(void* pData, uint32_t nBytes);
+void itm_flush(void);
+bool itm_is_ready(void);
+uint32_t itm_get_dropped_bytes(void);               // Bytes lost because the port was disabled by the debugger
+void itm_init(void);
+
+
+#endif
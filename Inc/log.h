@@ -20,11 +20,73 @@
  * 8 bit variable, a 16 bit or a 32 bit one.
  *
  * Strings are stored in the input FIFO by reference, so they have to be constant between storage
- * and processing of the FIFO.
+ * and processing of the FIFO. Those of up to 4 characters (1 with LOG_FIFO_PACKED) are the exception,
+ * they are copied into the item.
  * This FIFO is atomic, meaning that it disables all interrupts during insertions and extractions.
  * Measurements in a Cortex M0+ shows that it takes around 100 cycles to insert a new data, with
  * around 50 cycles required for the actual FIFO insertion (with interrupts disabled). Usage of a
  * RTOS queue was discarded because it would take around 550 cycles for the insertions in FreeRTOS.
+ * log_bench_run() measures both with LOG_BENCH_BASELINES.
+ * If interrupt latency matters more, LOG_FIFO_MODE selects a reserve/commit scheme instead, where
+ * interrupts are only disabled to increment the write index (LOG_FIFO_MPSC) or not disabled at all
+ * when there is a single producer (LOG_FIFO_SPSC). The item is then copied with interrupts enabled
+ * and the log thread only extracts it once it has been committed.
+ *
+ * If LOG_FIFO_LOCK_FREE is also set to 1, LOG_FIFO_MPSC reserves the slots with an LDREX/STREX loop
+ * on the write index instead of disabling interrupts, which also works when the FIFO is shared by
+ * several cores that PRIMASK cannot stop. It needs a Cortex-M3 or above and a single FIFO of fixed
+ * size items without copy arena. The other counters of the logger (LOG_STATS, LOG_DEDUP) are still
+ * protected by masking, so they are only exact for the producers of one core.
+ *
+ * log_str_from_isr() and the _from_isr variant of every other log_ macro are meant for the ISRs that
+ * no other ISR that logs can preempt, like the ones of the highest priority among those that log. If
+ * LOG_ISR_UNMASKED is set to 1 they store their items without touching PRIMASK, as no other producer
+ * can run until they return, and the wakeup of LOG_WAKEUP_FILL_PERCENT calls vTaskNotifyGiveFromISR()
+ * without reading IPSR first. Calling them from a task or from an ISR that a logging one preempts then
+ * corrupts the input FIFO. Otherwise they are the same as the plain macros.
+ *
+ * On cores with BASEPRI (Cortex-M3 and above) LOG_MASK_BASEPRI can be set to 1, so the critical
+ * sections raise BASEPRI to configMAX_SYSCALL_INTERRUPT_PRIORITY instead of disabling all interrupts,
+ * as FreeRTOS does. The interrupts of higher priority then get no added latency from the logger, but
+ * they must not log, like they must not call FreeRTOS. The Cortex-M0+ of this board only has PRIMASK.
+ *
+ * Each FIFO item takes a fixed size struct even if it only carries a char. When LOG_FIFO_PACKED is
+ * enabled, the FIFO becomes a byte ring of LOG_INPUT_FIFO_N_ELEM * LOG_PACKED_BYTES_PER_ELEM bytes
+ * where each record only takes a header byte (type and color) plus its payload: 1 byte for chars and
+ * 8 bit variables, 2 or 4 bytes for bigger variables and 6 bytes for strings (pointer and length).
+ *
+ * LOG_FIFO_SPLIT keeps the fixed size items of the LOG_FIFO_LOCKED FIFO but stores them as two arrays
+ * in the same buffer: the payload words, then a dense array of the header bytes (type, color, level,
+ * module and context ID), instead of padding each struct to its alignment. The log thread reads an
+ * item back from both, the header of any item is a single byte load away without touching its payload.
+ *
+ * By default all producers share the same input FIFO. With LOG_PER_CONTEXT_FIFOS, ISRs get their own
+ * (small) FIFO and tasks are split in LOG_N_TASK_FIFOS priority bands, each one with its own FIFO,
+ * so a chatty task cannot fill the queue used by interrupts or by more important tasks. Items are
+ * tagged with a sequence number on insertion and the log thread merges all FIFOs in that order.
+ *
+ * If LOG_ERROR_RESERVE is not 0, the last LOG_ERROR_RESERVE items of each input FIFO (bytes if
+ * LOG_FIFO_PACKED is set) are kept for the logs of LOG_LEVEL_ERROR: those of files whose LOG_FILE_LEVEL
+ * is LOG_LEVEL_ERROR and the log_err_ calls of any file. A flood of debug logs is then dropped before
+ * it can fill them, and the error that follows still finds room. Items carry the level of their call
+ * for that, as with several backends.
+ *
+ * If LOG_ERROR_FIFO_N_ELEM is not 0, the logs of LOG_LEVEL_ERROR (of files whose LOG_FILE_LEVEL is
+ * LOG_LEVEL_ERROR and the log_err_ calls of any file) go to a FIFO of their own with that many items
+ * (bytes if LOG_FIFO_PACKED is set), which _log_flush() drains first. An error does not wait behind
+ * hundreds of queued debug items then, only behind the end of the line being output, unless that end
+ * is not logged yet. Errors are output out of order with the other logs, LOG_TIMESTAMPS gives their
+ * actual time. It extends the single input FIFO, so it cannot be used with LOG_PER_CONTEXT_FIFOS nor
+ * LOG_FLIGHT_RECORDER.
+ *
+ * If LOG_FLIGHT_RECORDER is set to 1, the input FIFO keeps the most recent items: a full FIFO drops its
+ * oldest ones to store the new ones, and the logger thread sleeps until log_trigger() is called (from
+ * a task or an ISR). Like a logic analyzer, the trigger keeps the last LOG_TRIGGER_PRE_ITEMS items and
+ * lets LOG_TRIGGER_POST_ITEMS more in, then the FIFO is frozen (new logs are dropped) and the thread
+ * outputs the capture before recording again. Normal operation then only costs the insertions.
+ * log_flush() and log_panic_flush() also output the FIFO, the latter from fault and assert handlers,
+ * and log_command() triggers on a "logdump" line. It needs a single LOG_FIFO_LOCKED FIFO of fixed
+ * size items without copy arena.
  *
  * In order to process the data, its thread wakes up periodically to check if the input FIFO
  * contains data to process and converts it to strings that are sent to the backend. The library
@@ -40,15 +102,85 @@
  * the output strings. The second pointer is optional (can be NULL) and allows the library to call the
  * backend's flush function when log_flush() is called.
  *
+ * - log_early_init() can be called right after HAL_Init() to set up the input FIFOs first, so the logs
+ * of the clock and peripheral initialization are stored too. They wait in the FIFO until log_init(),
+ * which then only sets the handlers, and the log thread outputs them once the scheduler runs.
+ *
+ * - log_set_ready_handler() optionally registers a function that returns false when the backend
+ * cannot take more output. The logger thread then stops extracting items, which wait in the input
+ * FIFO instead of being formatted and dropped by the backend, and log_flush() calls the backend's
+ * flush function to make room. The handler is kept across log_init() calls. vcp.c provides
+ * vcp_is_ready() and the VCP_OVERFLOW_POLICY option for what happens when its buffer is full.
+ *
  * - log_thread() must be called from a low priority thread. The function does not return. The
  * function requires a stack of 144 bytes plus the backend requirement stack, so a FreeRTOS stack size
  * of 128 words should be enough for the thread.
  *
+ * - If LOG_FLUSH_BUDGET_ITEMS is not 0, log_thread() outputs the input FIFO in passes of that many
+ * items and yields between them, so the other tasks of its priority wait for one pass at most
+ * instead of the whole FIFO when it is full or the backend is slow. The throughput is the same when
+ * nothing else is ready to run.
+ *
+ * - If LOG_IDLE_HOOK_ITEMS is not 0, there is no logger thread: vApplicationIdleHook() calls
+ * log_idle_hook(), which outputs up to that many items each time the idle task runs and returns at
+ * once if the backend is not ready. Logs are then only processed in otherwise idle time, without the
+ * TCB and stack of a thread, but a busy system may keep them waiting until the input FIFO fills. The
+ * idle task stack needs the room of log_thread(), and the output handler must never block, as the
+ * idle task is not allowed to: vcp.c rejects VCP_DIRECT, VCP_TX_IRQ and VCP_OVERFLOW_BLOCK, which
+ * wait for the UART. configUSE_IDLE_HOOK must be set to 1, LOG_WAKEUP_FILL_PERCENT and
+ * LOG_FLIGHT_RECORDER are not supported as they wake up the logger thread.
+ *
+ * - If LOG_DRAIN_BACKEND is set to 1, log_thread() and log_idle_hook() call the flush handler of
+ * log_init() after each processing loop, so a backend that buffers the output does not need a thread
+ * of its own to send it. main.c then does not create vcp_th, vcp_flush() sends the input buffer from
+ * the logger thread, which only needs room for its 16 bytes chunk. Together with LOG_IDLE_HOOK_ITEMS
+ * both threads are gone and the output is sent from the idle task, so the flush handler must not
+ * block either: vcp_flush() then polls the UART, while lpuart.c, spi_log.c and stripe.c, whose flush
+ * sleeps until their DMA is done, are rejected.
+ *
  * - To print constant strings call log_str() or logc_str() if a condition check is needed. These
- * macros automatically extract the string size at compile time to optimize processing time.
+ * macros automatically extract the string size at compile time to optimize processing time. The
+ * size of a string that is not a literal, like a name from a table, is measured by strlen() at the
+ * call, unless LOG_DEFERRED_STRLEN is set to 1: the item then stores LOG_STR_LEN_UNKNOWN and the
+ * logger thread measures the string when it outputs it, so the producer does not scan it. Such
+ * strings are not copied into the item anymore even when short, they must stay valid like the others.
  *
  * - To print independent characters, call log_char() or logc_char(). These characters are read at
- * call time, so they do not need to be constant, unlike the strings.
+ * call time, so they do not need to be constant, unlike the strings. log_chars() copies a few of them
+ * at once, up to 4 per FIFO item and in a single insertion, and log_eol() is log_chars("\r\n"): a
+ * line end takes one item instead of the two of log_char('\r') and log_char('\n'). With
+ * LOG_FIFO_PACKED each character is its own record, which is still smaller than an item.
+ *
+ * - To print the name of an enum value, call log_enum(value, names) with names a constant array of
+ * constant strings. Only the table and the 1 byte index are stored, the logger thread looks the name
+ * up, so the caller neither reads the table nor measures the string. Values without a name in the
+ * table are printed as numbers, 255 for all the values above it.
+ *
+ * - To print a variable whose exact value at call time does not matter, like a diagnostic counter,
+ * call log_ref(&var) or log_ref_hex(&var). Only its address and type are stored, as for the strings
+ * of log_str(), and the logger thread reads it when it outputs the item, so the caller saves the
+ * read of wide values. The variable must still exist then, so it is a global or a static one, and 64
+ * bit variables (LOG_64BIT_NUMBERS) may be read while they change.
+ *
+ * If LOG_REGS is set to 1, log_reg(value, desc) prints a register split into its fields, like
+ * "ISR: TXE=1 TC=0 RXNE=0". desc is defined with LOG_REG_DESC() from the name of the register and
+ * its {"field", offset, width} fields, and placed in the .log_regs section of the linker script. The
+ * caller only stores the value and the word offset of desc there, the logger thread renders the
+ * fields (up to 128 characters) and sends them as a string, also in binary mode.
+ *
+ * LOG_CUSTOM_TYPES sets the number of user record types, which need the copy arena. A formatter is
+ * registered for each type ID with log_type_register(), then log_custom(typeId, ptr, size) copies up
+ * to 255 raw bytes, a CAN frame or any other struct, into the arena like log_hexdump_copy(). The
+ * caller does no formatting at all: the logger thread passes the copy to the formatter, whose text
+ * (up to 128 characters) is sent as a string, also in binary mode. Unregistered IDs print "?".
+ *
+ * If LOG_PRINTF is set to 1, log_printf(fmt, ...) takes printf() calls as they are, with a literal
+ * format and up to 16 arguments. The caller only copies the format pointer and one 32 bit word per
+ * argument into the copy arena, the logger thread parses the format later with the integer kernels of
+ * log_dec() and log_hex() and sends the text (up to 128 characters) as a string, also in binary mode.
+ * d i u x X p c s and f are supported with flags, width and precision, e and g print as f, and 64 bit
+ * arguments are not. %s strings are read by the logger thread, so they must still be valid then, as
+ * for log_str(): copy the others with log_strcpy().
  *
  * - To print variables with a decimal format, call log_dec() or logc_dec(). These variables will
  * be printing without leading zeroes and with '-' sign if variable is signed and negative, ie: -126
@@ -62,6 +194,35 @@
  * data and a number of elements to print. The size of each item is automatically extracted thanks
  * to _Generic. The separator used between each element is a space (' '). The data must not be
  * modified until the function returns (an interrupt that writes on the array could be problematic).
+ * If LOG_BULK_ARRAYS is enabled, each array only takes a single FIFO item with its address, number of
+ * elements and format, and it is expanded by the log thread. In that case the array is stored by
+ * reference, like strings, so its content must not change until it has been processed.
+ *
+ * - To print one field of an array of structs, or any elements spaced by a constant number of bytes,
+ * use log_array_dec_stride(&array[0].field, nItems, sizeof(array[0])) or log_array_hex_stride() (and
+ * their logc_ versions) instead of copying the field into a temporary array first. The elements are
+ * read like with log_array_dec(), by reference if LOG_BULK_ARRAYS is enabled: they then take one FIFO
+ * item per 255 elements if the stride is at most 255 bytes, one item per element otherwise.
+ *
+ * - To print strings or arrays that may change right after the call (stack buffers, DMA double
+ * buffers...) use log_strcpy() and log_array_dec_copy()/log_array_hex_copy() (and their logc_
+ * versions). Their content is copied into an arena of LOG_COPY_ARENA_SIZE bytes of the input FIFO
+ * within the same reservation than the FIFO item. If LOG_COPY_ARENA_SIZE is 0 they fall back to
+ * storing each char or array element in its own item.
+ *
+ * - To print memory regions use log_hexdump(ptr, length). The region is stored by reference, like
+ * strings, in a single item and the log thread prints it as 16 bytes per line with the offset, the
+ * bytes in hexadecimal and their printable chars, like hexdump -C. log_hexdump_copy() copies
+ * up to LOG_COPY_ARENA_SIZE bytes into the arena instead and only exists if the arena is enabled.
+ *
+ * If LOG_BUFFER_REFS is set to 1, log_buffer_ref(ptr, length, format, release, ctx) logs a buffer
+ * that is too large to copy, an acquisition buffer for example, with neither a copy nor a lifetime
+ * issue. It is stored by reference as text (LOG_BUFFER_TEXT) or as a dump (LOG_BUFFER_HEXDUMP), and
+ * once the logger thread has passed it to the backend, in text or binary mode, it calls release(ctx)
+ * so the caller can reuse the buffer. release is called right away if the FIFO is full or the logs
+ * of the file are disabled, it must not log. Buffers are cut at 65535 bytes. The backend must be done
+ * with its input when it returns, so VCP_DIRECT, which keeps sending it by DMA, needs
+ * LOG_RENDER_PING_PONG to copy the buffer first.
  *
  * All functions support an optional last parameter in the function call to configure the desired
  * ANSI color to print the item. It is supported (but ignored) even if LOG_SUPPORT_ANSI_COLOR is
@@ -71,30 +232,815 @@
  * FIFO in number of items, and LOG_DELAY_LOOPS_MS, which defines how often the logger thread
  * should wake up to check and process the input queue.
  *
+ * If LOG_FIFO_SPARE_RAM is set to 1, LOG_INPUT_FIFO_N_ELEM is ignored and the input FIFO takes the
+ * .log_fifo region of the linker script instead, which gets all the RAM left after the other sections
+ * and the _Min_Heap_Size and _Min_Stack_Size of ._user_heap_stack. log_init() divides it into the
+ * largest power of 2 of items (bytes if packed) that fits with their commit flags, so each build gets
+ * the most burst headroom without tuning, although up to half of the region may stay unused. The
+ * region is not cleared at startup, so LOG_POST_MORTEM keeps working. It does not apply to the FIFOs
+ * of LOG_PER_CONTEXT_FIFOS.
+ *
+ * If LOG_COLOR_ON_CHANGE is set to 1, the logger thread remembers the last color it sent and only
+ * emits an escape sequence when an item has a different one, so colored arrays and consecutive items
+ * of the same color cost almost no extra output. A terminal attached in the middle of a run shows the
+ * default color until the next change.
+ *
+ * log_fmt() takes up to 16 strings and numbers (decimal, or hexadecimal when wrapped in log_fmt_hex())
+ * and stores them in the input FIFO at once, with a single reservation and critical section, so the
+ * line is never split by the logs of other contexts. The whole line is dropped if it does not fit.
+ * log_fmt_color() does the same with a color as first parameter. Its strings are never interned.
+ * When all the parts are string literals, log_line() and log_line_color() join them at compile time
+ * into one log_str() item, instead of one item per part. Characters must then be written as strings,
+ * like "\r\n", and anything else than a literal does not compile.
+ *
+ * log_kv("temp", t, "rpm", r) stores up to 8 key-value pairs as one structured record, at once like
+ * log_fmt(). Keys are string literals and values strings or numbers, log_fmt_hex() ones too. The text
+ * output is a "temp=21 rpm=1500" line. The binary output sends a tag of 0xD0 followed by its timestamp
+ * and the pairs as a CBOR map (RFC 8949): numbers are integers, hexadecimal ones too, strings text
+ * strings, and the keys interned by LOG_INTERN_STRINGS are sent as the unsigned offset of their string
+ * in .log_strings. A record then costs a few bytes, and log_decode.py --json prints it as one JSON
+ * object per line for the host tools, which no longer parse text.
+ *
+ * C++ files (C++20) include log.hpp instead, as _Generic does not exist there. LOG("x={} y={:x}", x, y)
+ * and LOG_COLORED() split the format string at compile time into literal parts and decimal or
+ * hexadecimal placeholders, typed from the arguments by templates, and store them as one log_fmt()
+ * group. A wrong placeholder or argument count is a compile error.
+ *
+ * Lines built by several calls, for example in a loop, can be made atomic the same way. log_begin()
+ * starts a log_line_t (usually on the stack of the caller) with an optional color, log_add() appends a
+ * string or number to it without touching the input FIFO and log_end() stores all of them at once.
+ * Only LOG_LINE_N_ARGS tokens fit in a line, the following ones are ignored.
+ *
+ * If LOG_DEDUP is set to 1, a log_fmt() or log_end() message that is the same as the previous one
+ * (same string addresses, values and color) is only counted, and "Last message repeated N times" is
+ * stored before the next different message or by log_flush() and log_panic_flush(). A stuck error
+ * loop then fills neither the input FIFO nor the output. Messages of single log_ calls are not
+ * compared, as a line is usually made of several of them.
+ *
+ * log_str_ratelimited(ms, burst, ...) and the _ratelimited variant of every other log_ macro keep a
+ * small static window at each call site: at most burst calls are stored every ms milliseconds of
+ * LOG_RATELIMIT_MS_GET() and the following ones are dropped before the input FIFO is touched, by a
+ * compare and a counter increment. With LOG_STATS the dropped calls are added to nRateLimited of
+ * log_get_stats() when the window of their call site restarts. A call site is expected to be used
+ * from one context only, as the window is not protected against preemption.
+ *
+ * log_str_every(n, ...) and the other _every variants store the first call of each site and then one
+ * call every n, log_str_sample(percent, ...) and the other _sample variants store each call with the
+ * given probability, from a xorshift generator shared by all the call sites. Both cost a counter
+ * and a branch per call, so ISR rate code keeps a statistically useful part of its logs.
+ *
+ * Logs can also be removed at compile time. Each file may define LOG_FILE_LEVEL (LOG_LEVEL_INFO by
+ * default) and LOG_MODULE (0 by default, a bit number of LOG_MODULES_ENABLED) before including log.h.
+ * If that level is above LOG_LEVEL or the module bit is cleared, all the log_ and logc_ macros of the
+ * file expand to nothing, so neither the calls nor their literals end up in flash and their arguments
+ * are not evaluated. For single calls, LOG_LEVEL_ENABLED(level) can be used as the condition of a
+ * logc_ macro, which the compiler then removes when optimizing.
+ *
+ * log_err_str(), log_err_char(), log_err_dec(), log_err_hex(), log_err_strcpy() and log_err_fmt() log
+ * at LOG_LEVEL_ERROR whatever the LOG_FILE_LEVEL of their file, for the error path of a driver that
+ * otherwise logs at LOG_LEVEL_INFO. Their items carry that level, so they get the LOG_ERROR_RESERVE
+ * room, the LOG_ERROR_FIFO_N_ELEM FIFO and the backends of LOG_LEVEL_BIT(LOG_LEVEL_ERROR), and they are
+ * only removed when LOG_LEVEL_ERROR itself or the module of the file is disabled.
+ *
+ * If LOG_RUNTIME_LEVELS is set to 1, the logs that are compiled in are also checked against a
+ * level per module that log_set_module_level() changes at runtime (all start at LOG_LEVEL_DEBUG).
+ * A filtered call only costs a load, an AND and a branch, nothing is inserted in the input FIFO.
+ * log_command() parses "loglevel <module> <level>" text lines, so with VCP_RX_LINE_SIZE set main.c
+ * passes the lines received by the UART to it (levels are numbers, 0 = off to 4 = debug).
+ * The same channel takes "logdump" (LOG_FLIGHT_RECORDER), "logstats" that logs the counters of
+ * LOG_STATS and has the log thread dump the profiler of LOG_PROF, and "logwatch <index> <ms>" that
+ * changes the sampling period of a variable of LOG_WATCH, "logsync <beacon>" (LOG_TIME_SYNC),
+ * "loghistory" (LOG_HISTORY_SIZE) and "logtasks" (LOG_TASK_SNAPSHOT).
+ *
+ * If LOG_GOVERNOR is set to 1, the log thread also lowers all the runtime levels under pressure, so the
+ * bandwidth goes to the most important logs instead of to the ones that happen to find room. A loop
+ * that finds an input FIFO at LOG_GOVERNOR_HIGH_PERCENT while the ready handler reports the backend
+ * as behind, or whose flush took LOG_GOVERNOR_BUSY_TICKS, lowers the level by one, down to
+ * LOG_GOVERNOR_MIN_LEVEL. After LOG_GOVERNOR_CALM_LOOPS loops in a row with all the FIFOs below
+ * LOG_GOVERNOR_LOW_PERCENT, the level goes back up by one. Each change logs "Log governor level n".
+ * The module levels of log_set_module_level() still apply below it, log_get_module_level() returns
+ * them without the governor limit.
+ *
+ * If LOG_CPU_BUDGET_PERCENT is not 0, the log thread spends at most that share of the CPU time
+ * processing the input FIFOs, whatever the logging rate. It measures each pass of
+ * LOG_CPU_BUDGET_PASS_ITEMS items with LOG_TIMESTAMP_GET() against a credit refilled by that share of
+ * the elapsed time, up to one LOG_CPU_BUDGET_WINDOW_TICKS window of it, so over any window its work
+ * stays within the budget plus one pass. Once the credit is spent, the rest waits in the FIFOs for the
+ * next loops and the producers shed the logs above LOG_CPU_BUDGET_SHED_LEVEL until it refills.
+ * nBudgetShed of log_get_stats() counts the shed items, which are also counted in nDropped.
+ * log_flush() and log_panic_flush() are not limited.
+ *
+ * If LOG_WAKEUP_FILL_PERCENT is not 0, the producer that fills an input FIFO up to that percentage
+ * sends a task notification to the logger thread, which then starts processing without waiting for
+ * the end of its delay. In that case LOG_DELAY_LOOPS_MS only bounds the latency of a few idle logs
+ * and can be made much longer. ISRs that log must then have a priority allowed to call FreeRTOS
+ * FromISR functions (configMAX_SYSCALL_INTERRUPT_PRIORITY).
+ *
+ * If LOG_BOOST_FILL_PERCENT is not 0, the task that fills an input FIFO up to that percentage also
+ * raises the logger thread to LOG_BOOST_PRIORITY with vTaskPrioritySet(), and the thread goes back to
+ * its own priority once it has drained all the input FIFOs below LOG_BOOST_RESTORE_PERCENT. A burst
+ * of logs from higher priority tasks then does not starve it into dropping items, while logging stays
+ * below the application the rest of the time. ISRs do not change priorities, the next log of a task
+ * does it. The watermarks are usually combined with LOG_WAKEUP_FILL_PERCENT.
+ *
+ * If LOG_LOW_POWER is set to 1, the logger thread sleeps without timeout while the input FIFOs are
+ * empty and the first item stored wakes it up with a task notification, so it does not wake up the
+ * core every LOG_DELAY_LOOPS_MS, which then only paces the retries while the backend throttles the
+ * output. ISRs that log must have a priority allowed to call FreeRTOS FromISR functions. With
+ * configUSE_TICKLESS_IDLE, VCP_LOW_POWER gates the UART clock in sleep mode and vcp_pre_sleep() puts
+ * off the sleep while bytes are waiting or being sent, so the transfers always complete first. vcp_th
+ * must then sleep as well (VCP_BLOCKING_TH or VCP_USE_DMA), or be replaced by VCP_TX_IRQ or
+ * VCP_DIRECT.
+ *
+ * If LOG_RENDER_BUFFER_SIZE is not 0, the logger thread formats the items into a buffer of that
+ * size and calls the output handler once per full buffer and at the end of each processing loop,
+ * instead of once for every string, number or color escape sequence.
+ *
+ * If LOG_RENDER_PING_PONG is also set to 1, two render buffers are used alternately and all the
+ * output goes through them. The output handler may then keep reading the data it receives until it
+ * is called again, which lets a DMA backend send each buffer in place while the other one is filled.
+ * With VCP_DIRECT, vcp_send() does so from the logger thread, without vcp_th nor its stream buffer.
+ * VCP_DIRECT requires LOG_RENDER_PING_PONG, the transfer would otherwise read the FIFO slots, the
+ * render buffer or the caller buffers while the logger thread reuses or releases them.
+ *
+ * If LOG_ARRAY_CHUNK_ELEMS is not 0, the log thread outputs bulk array records (LOG_BULK_ARRAYS)
+ * that many elements at a time. The rest of the record waits for the next item of the flush pass,
+ * which counts it in LOG_FLUSH_BUDGET_ITEMS and the other budgets and checks the ready handler of the
+ * backend first, so a dump of thousands of elements streams at the rate of the link instead of
+ * holding the log thread and filling the backend buffer at once. No other item is output before the
+ * end of the record.
+ *
+ * If LOG_FAST_DECIMAL is set to 1, decimal numbers are formatted two digits at a time from a table
+ * in flash and divisions by 100 are replaced by reciprocal multiplications, as the Cortex-M0+ has no
+ * hardware divider. On a core with the CLZ instruction (__ARM_FEATURE_CLZ, Cortex-M3 and above), the
+ * number of digits comes from the bit length of the number instead of a loop of comparisons.
+ *
+ * If LOG_FAST_HEX is set to 1, hexadecimal numbers are formatted one byte at a time from a table of
+ * char pairs in flash and written to the output buffer a pair at a time, which mostly speeds up large
+ * log_array_hex() dumps.
+ *
+ * If LOG_RAM_FUNCTIONS is set to 1, the producer functions with their input FIFO writes and the
+ * formatting kernels are placed in the .RamFunc.log section, which the startup code copies to RAM
+ * with .data. At 64 MHz the flash has 2 wait states, so these paths run faster from RAM, which
+ * mostly matters to interrupt heavy builds. The RAM they take is __log_ramfunc_size in the map
+ * file. The tables of LOG_FAST_DECIMAL and LOG_FAST_HEX stay in flash.
+ *
+ * If LOG_INLINE_PRODUCERS is set to 1, log_dec() and log_hex() store their item at the call instead of
+ * calling _log_var(): the type and the color are constants there, and the item is written in place in
+ * its FIFO slot instead of being built on the stack and copied. The layout of the FIFO is then in
+ * log_fifo.h, and every call site grows by the critical section, so it pays off in hot loops of LTO
+ * builds. Only the single LOG_FIFO_LOCKED FIFO of items is supported, without context IDs, LOG_BENCH
+ * nor LOG_PROBES. The stats and wakeup checks stay out of line, LOG_STATS counts the stored item
+ * with a call from the critical section.
+ *
+ * If LOG_CONST_NUMBERS is set to 1, log_dec() of a constant from 0 to 9999 and log_hex() of a constant
+ * 8 or 16 bit value are formatted by the compiler into the 4 characters of the item, so the logger
+ * thread only copies them. The call costs the same as for a variable. Other values are formatted at
+ * run time as usual. It needs text output and unpacked items.
+ *
+ * If LOG_64BIT_NUMBERS is set to 1, log_dec() and log_hex() also accept long long and unsigned long
+ * long values, stored whole in a single item (8 bytes of payload if LOG_FIFO_PACKED is set). They are
+ * printed in chunks of 9 digits split with 32 bit operations only, so __aeabi_uldivmod is not linked.
+ * Arrays and log_fmt() arguments are still limited to 32 bits.
+ *
+ * log_fixed(value, fracBits, nDecimals) prints a fixed point number (for example a Q15 int16_t with
+ * fracBits 15) and log_float(number, nDecimals) a float, both rounded to nDecimals (0 to 9). Only the raw
+ * value is stored in the input FIFO, the log thread converts it with integer operations so neither
+ * printf nor the soft float library are needed. Halves are rounded up and floats from 2^32 upwards
+ * are printed as "ovf".
+ *
+ * The same formatting code is available to the rest of the firmware, in text and binary modes, for
+ * display or protocol strings without snprintf: log_format_dec(), log_format_udec(), log_format_hex()
+ * (of a 1, 2 or 4 byte value), log_format_fixed() and log_format_float() write into a caller buffer,
+ * and log_fmt_into(pBuf, size, ...) formats the arguments of log_fmt() one after the other. They are
+ * reentrant, the output is cut to the buffer size and zero terminated, and they return its length. A
+ * single number never takes more than LOG_FORMAT_MAX characters.
+ *
+ * If LOG_BINARY_OUTPUT is set to 1, the logger thread does not format the items. It sends compact
+ * records instead (a tag byte with type and color, then varint numbers or length prefixed strings)
+ * and the host script Tools/log_decode.py renders the same text output from a capture file or
+ * directly from the serial port.
+ *
+ * If LOG_INTERN_STRINGS is also set to 1, every log_str() literal is placed in the .log_strings
+ * section of the linker script and only its offset in that section is sent. The decoder then needs
+ * the firmware ELF file (--elf) to recover the text. In this mode log_str() only accepts string
+ * literals.
+ *
+ * If LOG_ARRAY_DELTA is also set to 1, array records (LOG_BULK_ARRAYS or copied arrays) send each
+ * element as the zigzag varint difference with the previous one, and each difference of 0 as a
+ * count of repeats. Slowly varying series like ADC samples then take about one byte per element.
+ *
+ * LOG_HERE() logs the place it is called from and log_assert(cond) logs "Assert " and that place
+ * when cond is false, so configASSERT() can be defined with log_assert() to report failed assertions
+ * without a debugger. By default the place is the __FILE_NAME__ (GCC 12 and later, __FILE__ otherwise)
+ * and __LINE__ string. If LOG_LOCATIONS is set to 1, it is a single 4 byte item instead: a 16 bit hash
+ * of the file name, computed by the compiler, and the line. The text output prints it as
+ * "@hash:line", and in binary mode Tools/log_decode.py prints "file:line" when given the source
+ * directories with --sources. Two files may have the same hash, the decoder then prints both names.
+ *
+ * If LOG_TIMESTAMPS is set to 1, every item stores the value of LOG_TIMESTAMP_GET() (by default the
+ * TIM2 counter, which must be running) when it is logged. In text mode the ticks elapsed since the
+ * previous line are printed as "[+ticks] " at the start of each line. In binary mode each record
+ * carries its delta with the previous record, decoded with log_decode.py --timestamps. Adding
+ * --trace trace.json also writes the lines as JSON trace events, to see them on a timeline in Perfetto.
+ *
+ * If LOG_SEQUENCE_NUMBERS is set to 1, every item gets a 16 bit sequence number when it is stored.
+ * The items that are dropped (full FIFO, quota, CPU budget) still take theirs, so the gaps count the
+ * exact losses of the target. In binary mode each record carries its number after the tag, and
+ * log_decode.py --seq reports the gaps on stderr and a summary at the end. With --packets the gaps
+ * across a lost packet are counted as transport losses, the others as losses of the input FIFOs. In
+ * text mode the number of the first item of a line is printed as "[#n] " every
+ * LOG_SEQUENCE_TEXT_LINES lines, and at once after a gap. Gaps of 65536 items or more are not seen.
+ *
+ * If LOG_TIME_SYNC is set to 1, log_command() answers each "logsync <beacon>" line of the host with
+ * a "Log sync node <LOG_NODE_ID> beacon <beacon> ticks <LOG_TIMESTAMP_GET()>" line, logged when the
+ * beacon is received. log_decode.py --sync --port ... sends a numbered beacon every --sync-period
+ * seconds and pairs the ticks of each answer with the host time it sent the beacon at, which also
+ * tracks the drift of the target clock. Each line then starts with "[<host seconds> node <n>] ", from
+ * the record timestamps (binary output with LOG_TIMESTAMPS). With a board per port, each decoder
+ * writes its own file and Tools/log_merge.py merges them into one time ordered view. The UART and USB
+ * latency of the beacons, usually below a millisecond, is the error of the mapping.
+ *
+ * If LOG_RTC_ANCHOR_MS is set to a period, the timestamps also get a wall clock time without any
+ * producer reading the RTC, whose calendar takes several synchronized register reads. Every
+ * LOG_RTC_ANCHOR_MS the log thread reads the calendar (SSR, TR then DR, which stay locked together)
+ * with the LOG_TIMESTAMP_GET() ticks of that instant. In text mode it keeps this anchor and prints
+ * "[hh:mm:ss.mmm] " at each line start instead of the ticks since the previous line, adding to the
+ * time of the anchor the ticks since its own, at LOG_TIMESTAMP_HZ. In binary mode it logs a
+ * "Log RTC anchor <seconds since 1970> s <ms> ms" line, and log_decode.py --timestamps --rtc starts
+ * each line with its date and time from the latest anchor and the ticks since then, measuring the
+ * actual rate of the counter between two anchors. The application sets up the RTC in 24 hour format,
+ * and the period must be far below the wrap of the counter (67 s at 64 MHz), as must be the wait of
+ * the items in the input FIFOs.
+ *
+ * LOG_RTOS_TRACE in log_trace.h, which FreeRTOSConfig.h includes, defines the FreeRTOS trace macros
+ * of task switches, task creation, deletion and delays, and queue sends and receives (semaphores and
+ * mutexes too). Each event is put in the input FIFO with its timestamp and the RAM offset of the task
+ * or queue, without waking up the logger thread as the kernel calls them from PendSV and critical
+ * sections. It requires LOG_BINARY_OUTPUT (or LOG_SYSVIEW) and LOG_TIMESTAMPS, the events print
+ * nothing and --trace draws them as the running time of each task, with the lines on the task that
+ * logged them. The tasks are named after their static control blocks (such as logger_th_cb) when --elf
+ * is given. Interrupt handlers that call log_trace_isr_enter() first and log_trace_isr_exit() last add
+ * their run time on the ISR track. The events before log_init() are dropped, so are the ones that find
+ * the FIFO full, which they fill quickly.
+ *
+ * LOG_TASK_STATS in log_trace.h turns on the FreeRTOS run time stats, counted by TIM2 (started by
+ * the scheduler, before the tasks run). Every LOG_TASK_STATS_PERIOD_MS the logger thread logs the
+ * ticks elapsed since its previous report, then a line per task with its share of them in percent
+ * and its own ticks, the logger thread and the idle task included. The lines are regular logs, sent
+ * as records in binary mode. With more tasks than LOG_TASK_STATS_MAX_TASKS only an error line is logged.
+ *
+ * LOG_STACK_STATS in log_trace.h makes the logger thread log every LOG_STACK_STATS_PERIOD_MS the
+ * least free stack in bytes that each task had since it started (uxTaskGetStackHighWaterMark()), or
+ * with LOG_STACK_STATS_ON_CHANGE only for the tasks whose minimum went down since the previous report.
+ * A task that never gets below a quarter of its stack, over the runs that matter, can give it back.
+ *
+ * LOG_TASK_SNAPSHOT in log_trace.h adds log_task_snapshot(), callable from any context, and the
+ * "logtasks" command: at its next wakeup the logger thread reads the tasks with uxTaskGetSystemState()
+ * into the static array of the task stats and logs a line per task, its name then a row of numbers
+ * (task number, state from 0 running to 4 deleted, priority, least free stack in bytes and run time
+ * ticks with LOG_TASK_STATS), one array record in binary mode. Triaging a hang this way needs neither
+ * a debugger nor vTaskList() and its sprintf() buffer.
+ *
+ * If LOG_CONTEXT_IDS is set to 1 (text mode only), every item stores a 1 byte ID of the context that
+ * logged it, and each line starts with its name: "[task name] " for tasks, "[ISR n] " for exception
+ * number n and "[main] " before the scheduler starts. A task is given the next of LOG_CONTEXT_N_TASKS
+ * IDs and its name is copied the first time it logs, the ID is then kept in its thread local storage
+ * pointer LOG_CONTEXT_TLS_INDEX (configNUM_THREAD_LOCAL_STORAGE_POINTERS must include it). The tasks
+ * beyond LOG_CONTEXT_N_TASKS are shown as "[?] ". IDs are not kept across a reset, so the lines
+ * restored by LOG_POST_MORTEM show the tasks that got them in the new boot.
+ *
+ * If LOG_LINE_PREFIX is set to 1 (text mode only), every item also stores the LOG_MODULE of its file
+ * and the log thread starts each line with the LOG_PREFIX_ template of the level of its first item,
+ * after the timestamp and the context name. The templates are string constants of log.h, in flash: %l
+ * and %L are the level letter and name, %m the module name given to log_set_module_names() (or its
+ * number), %M the module number, %t the timestamp of the item and %c the color of the level, so
+ * one log_str() of a producer gets the same decoration as several calls before it, without their
+ * cost. The logs that call the _log_ functions directly have no level and use LOG_PREFIX_NONE.
+ *
+ * If LOG_CONTEXT_QUOTA is not 0, each context may only hold that many items in the input FIFOs at
+ * once, so a task stuck in a logging loop has its own logs dropped instead of the logs of everyone
+ * else. Contexts are those of LOG_CONTEXT_IDS, all ISRs share one quota and so do the tasks beyond
+ * LOG_CONTEXT_N_TASKS. A group of items (log_fmt(), a line of log_end()) takes its whole size of
+ * the quota or is dropped. nQuotaDropped[] of log_get_stats() counts the items dropped for each
+ * context: index 0 is main, 1 to LOG_CONTEXT_N_TASKS the task IDs, then the other tasks and the ISRs.
+ * They are also counted in nDropped.
+ *
+ * If LOG_BENCH is set to 1, log_bench_run() from log_bench.h measures with LOG_TIMESTAMP_GET() the
+ * cycles taken by each type of insertion (arrays of 1, 16 and 64 items), the cycles per output byte
+ * of the log thread and the longest time with interrupts disabled, and prints a table to the given
+ * backend. The demo thread of main.c runs it at startup when the flag is set. With
+ * LOG_BENCH_BASELINES, a second table compares payloads of 1, 4 and 12 bytes (a char, a number and
+ * an array of 3 words) in the input FIFO, built in its LOG_FIFO_MODE, with xQueueSend(),
+ * xStreamBufferSend() and xMessageBufferSend(): average insertion cycles, longest time with
+ * interrupts disabled (logger only, the queue copies its items in a critical section) and average
+ * drain cycles, which for the logger include the formatting of _log_flush(). A last "Bench summary"
+ * line gathers the averages and the output bytes per record of the flush mix for Tools/log_matrix.py,
+ * which compiles log.c for each combination of a matrix of options and of the Debug and Release
+ * configurations, then reports the flash, RAM and input FIFO RAM of each, with these
+ * measurements too when it is given a command to build and flash the target.
+ *
+ * If LOG_STRESS is set to 1, the demo thread of main.c runs log_stress_run() from log_stress.h instead:
+ * LOG_STRESS_N_TASKS tasks of increasing priorities and the TIM7 interrupt log numbered lines with a
+ * check value, at a total rate raised by LOG_STRESS_RATE_STEP at each stage. Tools/log_stress.py
+ * reads the output (text, or the one of log_decode.py) and prints the events lost and corrupted in
+ * each stage, and the highest rate sustained without loss, to size LOG_INPUT_FIFO_N_ELEM and
+ * VCP_INPUT_BUFFER_SIZE for a given load. With LOG_STRESS_JITTER in log_stress.h, a TIM6 interrupt at
+ * the highest priority also reads its own counter on entry at LOG_STRESS_JITTER_HZ, and the script
+ * adds the p99 and worst jitter of that latency in each stage, which is what the interrupt masking
+ * of the input FIFO costs the other ISRs under load: build once with LOG_FIFO_LOCKED and once with
+ * LOG_FIFO_MPSC to compare them (LOG_FIFO_SPSC masks nothing but takes a single producer).
+ *
+ * If LOG_THROUGHPUT is set to 1 (with LOG_STATS), the demo thread runs log_throughput_run() from
+ * log_throughput.h instead, with the VCP backend: it floods the logger at the idle priority with
+ * mixes of strings only, decimals, hex arrays and colored output, LOG_THROUGHPUT_MIX_MS each, and
+ * prints for each the bytes per second sustained to the UART, its share of LOG_THROUGHPUT_LINE_BPS,
+ * the CPU share of the formatting of the log thread (with its cycles per output byte) and of
+ * vcp_send(), and the items and bytes dropped at the input FIFOs and at the VCP input buffer, which
+ * tells which stage limits the output. The flushTicks counter of log_get_stats() gives the time the
+ * log thread spent in its processing loops.
+ *
+ * Tools/log_sim.py sizes LOG_INPUT_FIFO_N_ELEM, VCP_INPUT_BUFFER_SIZE, LOG_DELAY_LOOPS_MS,
+ * LOG_WAKEUP_FILL_PERCENT and the baud rate without a board: it replays a timestamped text capture,
+ * or synthetic profiles of lines per second, through a model of the input FIFO, of the log thread at
+ * the cycles per output byte of the "Bench summary" line and of the VCP input buffer emptied by the
+ * UART. For each combination of the values given it prints the share of the lines dropped at the FIFO
+ * or damaged at the buffer, and the p50, p99 and worst latencies to the wire.
+ *
+ * log.c takes the CMSIS, HAL and FreeRTOS functions it calls from log_port.h. Built with
+ * -DLOG_PORT_HOST=1, that header replaces them with stubs for a single thread on a PC, which is
+ * enough for the default configuration. Tools/log_host.c uses it to check log_format_dec(),
+ * log_format_udec() and log_format_hex() against snprintf() for edge and random values, then prints
+ * how many millions of values per second they format, so that a formatter change can be tested
+ * without a board (build command at the top of the file). With LOG_COPY_ARENA_SIZE and a line prefix
+ * it also checks that the line after a log_hexdump_copy() keeps its prefix.
+ *
+ * Tools/log_gdb.py prints what a halted target had not sent yet: sourced in GDB with the firmware ELF
+ * file, log-dump renders the items left in the input FIFOs from their rdIdx, following the str pointers
+ * into flash, and vcp-dump the bytes left in the VCP input buffer, which -o saves for log_decode.py in
+ * the binary, compressed or packet modes. It reads the structures with the types of the ELF file at no
+ * cost on the target (usage at the top of the file).
+ *
+ * If LOG_PROF is set to 1, the code between LOG_PROF_BEGIN(id) and LOG_PROF_END(id) of log_prof.h is
+ * measured with LOG_TIMESTAMP_GET(), and each ID below LOG_PROF_N_IDS keeps the number of runs, the
+ * min, max and total cycles and a log2 histogram on the target. A run only costs the two counter
+ * reads and the update of its entry with the interrupts masked, no log item. The log thread logs the
+ * IDs that ran every LOG_PROF_PERIOD_MS, or when log_prof_request_dump() is called from any context,
+ * and clears them so each dump covers the runs since the previous one.
+ *
+ * If LOG_BOOT_MARKS is set to 1, LOG_BOOT_MARK(id) logs "Boot <id> at <us> us, +<us> us", the
+ * microseconds since HAL_Init() and since the previous mark. They are read from LOG_BOOT_TIMEBASE, the
+ * HAL time base (TIM17, 1 ms ticks of a 1 MHz counter), which runs from HAL_Init() on while TIM2 is
+ * only started by MX_TIM2_Init() and SysTick by the scheduler. With log_early_init() the marks of
+ * main() show which phase of the boot to shorten, SystemClock_Config() restarts the counter so its
+ * own mark may be up to 1 ms off. log_boot_flush(handler) outputs the logs stored so far through a
+ * handler that polls a peripheral, like log_panic_flush() but keeping the handlers of log_init(), so
+ * they are seen before the scheduler starts. The demo sends them with HAL_UART_Transmit() after the
+ * peripherals are set up.
+ *
+ * If LOG_PROBES is set to 1, log_init() makes the pins of log_probe.h (PC0 to PC2 by default) outputs
+ * that a logic analyzer can time against the application's own signals. LOG_PROBE_CRITICAL_PIN is high
+ * during each input FIFO critical section, so with the interrupts masked, LOG_PROBE_FLUSH_PIN during
+ * each processing pass of the log thread or of log_flush(), and LOG_PROBE_TX_PIN from the start of each
+ * UART transfer of vcp.c to its end (DMA complete, last byte written or TX interrupt disabled). Each
+ * edge is a single store to BSRR, a few cycles that the measured durations include.
+ *
+ * If LOG_METRICS is set to 1, log_metric_inc(id), log_metric_add(id, value) and log_metric_set(id,
+ * value) of log_metric.h update one of LOG_METRIC_N_IDS 32 bit counters instead of logging each event
+ * (packets, CRC errors, retries...). A call costs a few cycles with the interrupts masked. The log
+ * thread logs all the counters as one array every LOG_METRIC_PERIOD_MS, or their changes since the
+ * previous snapshot with LOG_METRIC_DELTAS, so the output rate does not depend on the event rate.
+ *
+ * If LOG_WATCH is set to 1, log_watch(&var, periodMs) of log_watch.h adds an integer variable of 8 to
+ * 32 bits to a list of LOG_WATCH_N_VARS that the log thread samples itself, logging the ones due on a
+ * "Watch: index=value ..." line, signed or not after the type of the variable. The task that owns it
+ * pays nothing for the trend, and log_unwatch() removes it. The periods are only as precise as the
+ * wakeups of the log thread (LOG_DELAY_LOOPS_MS).
+ *
+ * If LOG_QUEUE_MONITOR is set to 1, the log thread samples at each wakeup the fill level of the queues
+ * of the FreeRTOS registry (vQueueAddToRegistry(), configQUEUE_REGISTRY_SIZE slots) and of the stream
+ * buffers given to log_queue_monitor_stream() of log_queue.h, the VCP input buffer among them. Every
+ * LOG_QUEUE_MONITOR_PERIOD_MS it logs a "Queue high water:" line, then one per queue with its name and
+ * an array of its highest level since the previous report and its size, in items or bytes. A queue
+ * that reaches its size is where the producers block or drop, without any code of their own.
+ *
+ * If LOG_STATS is set to 1, log_get_stats() returns the number of items enqueued and dropped because
+ * an input FIFO (or its copy arena) was full, the highest fill level seen in any input FIFO (items,
+ * or bytes if LOG_FIFO_PACKED is set), the bytes sent to the output handler and the longest
+ * processing loop in LOG_TIMESTAMP_GET() ticks, including the time spent in the handler. Bytes lost
+ * by the backend itself are not seen by the logger, vcp.c reports its own with vcp_get_dropped_bytes().
+ *
+ * If LOG_LATENCY is set to 1, log_get_stats() also returns two histograms of LOG_LATENCY_N_BINS
+ * bins of LOG_TIMESTAMP_GET() ticks, whose first bin is below 2^LOG_LATENCY_SHIFT ticks and each next
+ * one twice as wide. latencyHandoff[] counts each item by the time from its timestamp, taken when
+ * log_fifo_put() stores it, to the output handler call that carries its bytes, so it shows the delay
+ * of the log thread, its render buffer and the packets. latencyWire[] counts the oldest item of each
+ * handler call by the time to the end of its transfer, reported by the backend calling
+ * log_latency_tx_done() in the order of the calls: vcp.c does it at the end of each DMA with
+ * VCP_DIRECT, where the data of each call is sent by one transfer. The two lines of "logstats" print
+ * the bins. It needs LOG_TIMESTAMPS, LOG_STATS and a single output handler.
+ *
+ * If LOG_SATURATION_HOOKS is set to 1, the function given to log_set_saturation_handler() is called
+ * in the context of the producer when a store leaves its input FIFO at LOG_SATURATION_PERCENT or more
+ * (LOG_SATURATION_HIGH_WATER) or drops items because the FIFO or its arena is full
+ * (LOG_SATURATION_FIFO_DROP), and in the context of the log thread when vcp.c drops or truncates
+ * output (LOG_SATURATION_OUTPUT_DROP). Each event calls it at most once per LOG_SATURATION_HOOK_MS,
+ * the drops in between are added to the value of the next call, so the application can react at
+ * once, by raising the log thread priority, switching to a less verbose level or raising an alarm,
+ * instead of finding the "Log input FIFO full" line later. The handler may run in an ISR, with the
+ * interrupts enabled, and must not log. Other backends report their losses with
+ * log_saturation_notify().
+ *
+ * If LOG_HISTORY_SIZE is not 0, the log thread also copies the last LOG_HISTORY_SIZE bytes it sends to
+ * the output handler into a RAM ring, so a terminal connected late can still see the boot messages.
+ * log_history_replay(), from any context, or the "loghistory" command has the log thread send the ring
+ * as it is, between "Log history" and "Log history end" lines, before the next output: nothing is
+ * formatted again and no producer data has to stay valid. Call it from the connection event of the
+ * host, such as the DTR change of a USB CDC backend, to replay in one burst when it opens the port.
+ * Only the text output of log_init() is kept, without compression nor packets.
+ *
+ * If LOG_INSTANCES is set to 1 (text mode only), log_ctx_init() adds a logger instance with its own
+ * input FIFO, made of the given buffer, and its own output handler. log_ctx_str(), log_ctx_char(),
+ * log_ctx_dec() and log_ctx_hex() store in it instead of the FIFO of log_init(), so a hot subsystem
+ * can have a small queue that the rest of the logs cannot fill, and the other way around. The log
+ * thread drains all the instances at the start of each processing loop, before the default FIFO,
+ * with the same formatting and only to the handler of the instance, without timestamps nor context
+ * names. The buffer needs the alignment of a pointer, the FIFO takes the largest power of 2 of items
+ * that fits in it. LOG_CTX_DEFAULT as the instance stores in the FIFO of log_init() instead, the same
+ * as the plain macros, which keep storing there directly rather than through an instance, so their
+ * speed and their options do not change. The instances have no thread of their own either: the
+ * formatting state is shared, so their priority is to be drained first by the log thread. They
+ * exclude LOG_SEQUENCE_NUMBERS, as their items would leave gaps that are not losses in the numbers.
+ *
+ * If LOG_N_BACKENDS is greater than 1, log_add_backend() registers up to LOG_N_BACKENDS - 1 more output
+ * handlers besides the one of log_init(), each with a mask of the levels it accepts (LOG_LEVEL_BIT() of
+ * each one) and an optional render buffer of its own. Every item stores the LOG_FILE_LEVEL of its
+ * caller and is formatted once, its output then goes to the log_init() backend and to each extra one
+ * that accepts the level. Only the log_init() backend can throttle the log thread with
+ * log_set_ready_handler(), the others must take their output without blocking.
+ *
+ * flash_log.c is such a backend: flash_log_send() appends the output to a ring of flash pages kept
+ * out of the program by the FLASH_LOG region of the linker script, so the errors survive resets and
+ * power losses. main.c registers it for LOG_LEVEL_ERROR and LOG_LEVEL_WARNING when LOG_N_BACKENDS is
+ * greater than 1, so for the files of these levels and the log_err_ calls of any file. The output is
+ * buffered in RAM and programmed at the end of each line, padded with zero bytes to a double word,
+ * and a page is only erased when the ring reaches it. The bytes that fail to be programmed are given
+ * by flash_log_dropped() and the ring moves on to the next page. flash_log_dump() sends the stored
+ * logs to any handler and flash_log_erase() clears them.
+ *
+ * rtt.c replaces vcp.c when RTT_BACKEND is set to 1. rtt_send() copies the output into an up
+ * buffer described by a control block with the layout of SEGGER RTT, which the debug probe finds in
+ * RAM and reads over SWD while the target runs, so no UART, DMA nor vcp_th are used. RTT_MODE selects
+ * what happens when the probe does not read fast enough (or is not attached): skip the whole write,
+ * trim it or wait for room.
+ *
+ * itm.c replaces vcp.c when ITM_BACKEND is set to 1, on the Cortex-M3 and above ports (the M0+ of
+ * the G071 has no ITM). itm_send() writes the output to an ITM stimulus port 32 bits at a time,
+ * checking the ready bit of the port before each write, and the TPIU sends it out of the SWO pin at
+ * ITM_SWO_HZ, so no UART, DMA nor vcp_th are used. The text goes to ITM_TEXT_PORT and the binary
+ * records of LOG_BINARY_OUTPUT to ITM_BINARY_PORT, so that a viewer shows one and log_decode.py reads
+ * the other. Output sent while the debugger has not enabled the port is counted as dropped.
+ *
+ * lpuart.c replaces vcp.c when LPUART_BACKEND is set to 1. lpuart_send() copies the output into a ring
+ * that the DMA sends in place through LPUART1, on PA2 like USART2, without thread. The LPUART is
+ * clocked by HSI or LSE (LPUART_CLK_SOURCE, 9600 bauds at most with LSE) and keeps emptying its TX
+ * FIFO in STOP mode, so with configUSE_TICKLESS_IDLE lpuart_pre_sleep() only puts off the sleep until
+ * the DMA has moved the whole ring into the FIFO. The same check lets an application that enters
+ * STOP1 from its idle processing keep logging at modest rates.
+ *
+ * spi_log.c replaces vcp.c when SPI_LOG_BACKEND is set to 1, for rates the UART can not keep up with.
+ * spi_log_send() cuts the output into frames (0xA5 0x5A, 16 bit little endian length, payload) in a
+ * ring that the DMA sends through SPI1 at up to 32 MHz (SPI_LOG_BAUDRATE_PRESCALER), SCK on PB3, MOSI on
+ * PB5 and CS on PA4, held low while the DMA runs. The target is the master, so the output is captured
+ * by a logic analyzer or a USB bridge in SPI slave mode, and log_decode.py --spi strips the frames,
+ * resyncing on the sync bytes if the capture starts in the middle of one. Frames that do not fit in
+ * the ring are dropped whole.
+ *
+ * stripe.c doubles the bandwidth of the UART output when STRIPE_BACKEND is set to 1, along with
+ * LOG_PACKETS. stripe_send() gets one whole packet per call and sends it either through vcp.c on
+ * USART2 or through a ring that the DMA sends in place through USART1 on PA9, at the same baud rate
+ * (STRIPE_BAUDRATE). STRIPE_SCHEDULING picks the lane with the fewest bytes queued or takes turns, a
+ * packet goes to the other lane if it does not fit, and is dropped whole if neither has room. Both
+ * lanes then carry complete packets in sequence order, which log_decode.py --stripe reads from a
+ * second USB bridge and merges back by sequence number, counting the lost ones as usual.
+ *
+ * VCP_TX_IRQ is meant for boards without a free DMA channel. vcp_th is not created, the UART
+ * interrupt sends the input buffer itself and vcp_flush() sleeps until it is drained.
+ * With VCP_ZERO_COPY too, the interrupt reads the byte ring in place, with no stream buffer calls.
+ * VCP_TX_FIFO enables the 8 byte TX FIFO of the USART, which every mode of vcp.c can use. With
+ * both set, the interrupt refills the FIFO each time it drains to the threshold of
+ * MX_USART2_UART_Init(), so it fires once every few bytes instead of once per byte.
+ *
+ * VCP_LL_TX takes the HAL UART driver out of the transmit path of every mode of vcp.c: the polled
+ * writes go straight to the data register without the lock, state and HAL_GetTick() timeout handling
+ * of HAL_UART_Transmit(), nor their wait for TC after each chunk, and with VCP_USE_DMA the channel is
+ * started through the LL DMA driver and released by its own transfer complete interrupt, so the UART
+ * interrupt is not used. vcp_flush() waits for TC once at the end. The HAL still initializes the UART
+ * and receives with VCP_RX_LINE_SIZE.
+ *
+ * With LOG_ERROR_FIFO_N_ELEM, errors still wait behind the output already in the VCP input buffer,
+ * up to VCP_INPUT_BUFFER_SIZE bytes. VCP_URGENT_BUFFER_SIZE adds an urgent lane of that size that
+ * vcp_th, its DMA chunks or the UART interrupt of VCP_TX_IRQ take before the input buffer, so an error
+ * reaches the wire once the current chunk is sent. log_set_urgent_handler() sends the output of the
+ * error FIFO, so the error files and the log_err_ calls of any file, to vcp_send_urgent(), which
+ * main.c registers, instead of the log_init() handler. Writes that do not fit in the lane are dropped
+ * whole, and an error line may land in the middle of one that was being sent. It takes the text
+ * output of a stream buffer, so not LOG_BINARY_OUTPUT, VCP_ZERO_COPY nor VCP_DIRECT, and a sleeping
+ * vcp_th needs VCP_FLUSH_TIMEOUT_MS for a write just before it sleeps.
+ *
+ * VCP_HW_FLOW_CONTROL enables the CTS input of USART2 on PA0, and its RTS output on PA1 when
+ * VCP_RX_LINE_SIZE receives too, for USB bridges that can stall. The UART then only sends while the
+ * host holds CTS low, so nothing is lost on the wire, and vcp_is_ready() returns false while it does
+ * not: the logger keeps the items in its FIFOs, where the usual overflow handling and counters apply,
+ * instead of filling the input buffer of vcp.c. CTS is pulled down, an unconnected pin does not hold
+ * the output back. vcp_panic_send() and vcp_flush() wait for the host like the UART does.
+ *
+ * VCP_RX_DMA receives the lines of VCP_RX_LINE_SIZE with a circular DMA into VCP_RX_DMA_BUFFER_SIZE
+ * bytes instead of an interrupt per byte. The bytes are parsed when the line goes idle and at each
+ * half of the buffer, so a command costs one or two interrupts whatever its length.
+ *
+ * VCP_AUTOBAUD makes vcp_init() look for the fastest baud rate that both the UART and the USB bridge
+ * handle. It offers the rates of VCP_AUTOBAUD_RATES in turn to log_decode.py --autobaud, and for each
+ * one the host accepts, both switch to it (with oversampling by 8) and the host must echo a CRC checked
+ * probe sent at that rate. The first failure goes back to the last good rate. The tool must be running
+ * when the target boots. Without it, the first offer only costs VCP_AUTOBAUD_TIMEOUT_MS at startup.
+ *
+ * If LOG_POST_MORTEM is set to 1, the input FIFOs (and their arenas) are placed in the .noinit
+ * section of the linker script, which the startup code does not clear. Calling log_post_mortem_save()
+ * from a fault handler stores a magic word and the CRC-32 of the FIFOs, without any RTOS call. After
+ * the reset, log_init() keeps the saved items if both are valid, so the log thread prints them first,
+ * followed by "--- Reset ---" and the new logs. Strings and bulk arrays logged by reference to RAM are
+ * printed with whatever that RAM holds after the reset, only constants and copied data are reliable.
+ *
+ * If LOG_POWER_FAIL_SAVE is set to 1 too, the PVD interrupt saves them to flash when the supply
+ * drops, as RAM does not survive that. log_init() sets the PVD to LOG_POWER_FAIL_PVD_LEVEL and
+ * PVD_IRQHandler() calls log_power_fail_irq_handler(), which programs the FIFOs and only their pending
+ * items, with CRC-32, into the FLASH_LOG_SAVE region of the linker script, kept erased beforehand.
+ * It writes the registers directly, without the RTOS nor the HAL. Each double word takes about 85 us,
+ * so the hold-up time of the supply must cover the pending items, and an image larger than the region
+ * is dropped. The next log_init() writes them back and they are printed first, followed by "--- Power
+ * fail ---", then the region is erased again. If the supply recovers instead, the handler resets the
+ * MCU once it is back above the threshold, so the saved items are printed just the same.
+ *
+ * If LOG_COMPRESS is set to 1, the output of the log_init() backend is LZSS compressed just before
+ * the output handler, in text and binary modes. Repeated bytes are sent as references of 2 bytes to
+ * the last LOG_COMPRESS_WINDOW bytes, found with a hash table of 256 entries, so the cost per byte is
+ * constant. Each handler call gets the encoding of one output chunk, which works best with
+ * LOG_RENDER_BUFFER_SIZE set (without it, the small chunks may even grow). Tools/log_decode.py
+ * decodes it with --compressed, plus --text in text mode. A lost byte would garble the rest of the
+ * stream, so at the start of the first chunk after every LOG_COMPRESS_SYNC_BYTES bytes the window is
+ * emptied and a 4 byte marker is sent. The decoder resyncs on it when a match refers to bytes it does
+ * not have, after a lost packet or when the capture starts after log_init(). With
+ * LOG_COMPRESS_SYNC_BYTES set to 0, the capture must start before log_init() and nothing may be lost.
+ *
+ * If LOG_PACKETS is set to 1, the output of the log_init() backend is cut into packets of up to
+ * LOG_PACKET_PAYLOAD bytes, after the compression if LOG_COMPRESS is set too. Each one holds a 16 bit
+ * sequence number, the output bytes and their CRC-32, which the CRC peripheral computes while they are
+ * COBS encoded, and ends with the only zero byte of the packet. A dropped or corrupted byte then loses
+ * one packet instead of desyncing the decoder: Tools/log_decode.py --packets restarts at the next zero
+ * byte, counts the lost packets from the sequence numbers and skips the ones with a bad CRC. The CRC
+ * peripheral is reserved to the logger.
+ *
+ * If LOG_SYSVIEW is set to 1, the output is the event stream of SEGGER SystemView instead of text,
+ * to view the timeline there. Each line becomes a print packet (up to 128 characters, without its line
+ * end), and with LOG_RTOS_TRACE the task switches, creations and deletions become task packets, the
+ * tasks being named from their control block the first time they run. The interrupt handlers to show
+ * call log_trace_isr_enter() first and log_trace_isr_exit() last. The packets carry the LOG_TIMESTAMPS
+ * ticks since the previous one, at LOG_TIMESTAMP_HZ, and every LOG_SYSVIEW_SYNC_PACKETS packets the
+ * stream is synced again with the system description of LOG_SYSVIEW_DESC. It goes through the
+ * log_init() handler, the UART of vcp.c or RTT, and is recorded by the host before SystemView opens
+ * it. The queue events and delays are not sent, nor are colors or line prefixes.
+ *
  * A flush function of the input FIFO is also available in case the system needs to reset and all
  * remaining data must be processed outside of the logger thread. If during initialization,
  * a pointer was provided for backend flushing, this function calls it after processing input FIFO.
  *
+ * If LOG_DELEGATED_FLUSH is set to 1, log_flush() called from a task wakes up the logger thread,
+ * which does the flush, and sleeps on a binary semaphore until it is done, so the notifications of
+ * the task are left to the application. The items are then formatted at the priority of the logger
+ * thread instead of the caller one, and never by two tasks at the same time. Only one task is
+ * served at a time, the others wait for their turn. Without scheduler, from ISRs, with the
+ * interrupts masked or from the logger thread itself, log_flush() still runs in the caller, so it
+ * can be used before a reset.
+ *
+ * If LOG_OVERFLOW_BLOCK is set to 1, a task that finds its input FIFO full wakes up the logger
+ * thread and sleeps on a binary semaphore until a processing pass makes room, for up to
+ * LOG_OVERFLOW_BLOCK_MS in total before its item is dropped. Nothing is lost as long as the logger
+ * thread keeps up within that time, so test captures are complete without oversizing the FIFO, at the
+ * cost of slowing the producers down. LOG_OVERFLOW_BLOCK_TASKS tasks can wait at once, each on the
+ * semaphore of its slot, which leaves the task notifications to the application. The others check
+ * again at each tick. ISRs, code with the interrupts masked, the logger thread
+ * itself and the logs before the scheduler starts still drop and count in nDropped.
+ *
+ * In fault handlers neither the RTOS nor the backend can be trusted, log_panic_flush(handler) processes
+ * the input FIFO in the calling context sending all the output to the given handler instead, such as
+ * vcp_panic_send() which polls the UART registers. It works with interrupts disabled, the demo calls it
+ * from HardFault_Handler, Error_Handler and configASSERT.
+ *
  *
  * Public defines
  *
  * LOG_INPUT_FIFO_N_ELEM
+ * LOG_FIFO_SPARE_RAM
  * LOG_DELAY_LOOPS_MS
+ * LOG_IDLE_HOOK_ITEMS
+ * LOG_FLUSH_BUDGET_ITEMS
+ * LOG_DELEGATED_FLUSH
+ * LOG_OVERFLOW_BLOCK
+ * LOG_OVERFLOW_BLOCK_MS
+ * LOG_OVERFLOW_BLOCK_TASKS
+ * LOG_LOW_POWER
+ * LOG_DRAIN_BACKEND
+ * LOG_LEVEL
+ * LOG_MODULES_ENABLED
+ * LOG_FILE_LEVEL
+ * LOG_MODULE
+ * LOG_RUNTIME_LEVELS
+ * LOG_GOVERNOR
+ * LOG_GOVERNOR_MIN_LEVEL
+ * LOG_GOVERNOR_HIGH_PERCENT
+ * LOG_GOVERNOR_LOW_PERCENT
+ * LOG_GOVERNOR_CALM_LOOPS
+ * LOG_GOVERNOR_BUSY_TICKS
+ * LOG_CPU_BUDGET_PERCENT
+ * LOG_CPU_BUDGET_WINDOW_TICKS
+ * LOG_CPU_BUDGET_SHED_LEVEL
+ * LOG_CPU_BUDGET_PASS_ITEMS
+ * LOG_WAKEUP_FILL_PERCENT
+ * LOG_BOOST_FILL_PERCENT
+ * LOG_BOOST_RESTORE_PERCENT
+ * LOG_BOOST_PRIORITY
+ * LOG_RENDER_BUFFER_SIZE
+ * LOG_RENDER_PING_PONG
+ * LOG_FAST_DECIMAL
+ * LOG_FAST_HEX
+ * LOG_RAM_FUNCTIONS
+ * LOG_INLINE_PRODUCERS
+ * LOG_CONST_NUMBERS
+ * LOG_64BIT_NUMBERS
+ * LOG_BINARY_OUTPUT
+ * LOG_TIMESTAMPS
+ * LOG_TIMESTAMP_GET()
+ * LOG_TIMESTAMP_HZ
+ * LOG_SEQUENCE_NUMBERS
+ * LOG_SEQUENCE_TEXT_LINES
+ * LOG_TIME_SYNC
+ * LOG_RTC_ANCHOR_MS
+ * LOG_NODE_ID
+ * LOG_CONTEXT_IDS
+ * LOG_LINE_PREFIX
+ * LOG_CONTEXT_N_TASKS
+ * LOG_CONTEXT_TLS_INDEX
+ * LOG_CONTEXT_QUOTA
+ * LOG_BENCH
+ * LOG_STRESS
+ * LOG_THROUGHPUT
+ * LOG_PROF
+ * LOG_BOOT_MARKS
+ * LOG_BOOT_TIMEBASE
+ * LOG_PROBES
+ * LOG_METRICS
+ * LOG_WATCH
+ * LOG_QUEUE_MONITOR
+ * LOG_REGS
+ * LOG_CUSTOM_TYPES
+ * LOG_PRINTF
+ * LOG_LOCATIONS
+ * LOG_INTERN_STRINGS
+ * LOG_DEFERRED_STRLEN
+ * LOG_ARRAY_DELTA
+ * LOG_HISTORY_SIZE
+ * LOG_STATS
+ * LOG_LATENCY
+ * LOG_LATENCY_N_BINS
+ * LOG_LATENCY_SHIFT
+ * LOG_LATENCY_PENDING
+ * LOG_SATURATION_HOOKS
+ * LOG_SATURATION_PERCENT
+ * LOG_SATURATION_HOOK_MS
+ * LOG_LINE_N_ARGS
+ * LOG_DEDUP
+ * LOG_RATELIMIT_MS_GET()
  * LOG_SUPPORT_ANSI_COLOR
+ * LOG_COLOR_ON_CHANGE
+ * LOG_FIFO_MODE
+ * LOG_FIFO_LOCK_FREE
+ * LOG_ISR_UNMASKED
+ * LOG_MASK_BASEPRI
+ * LOG_BULK_ARRAYS
+ * LOG_ARRAY_CHUNK_ELEMS
+ * LOG_COPY_ARENA_SIZE
+ * LOG_BUFFER_REFS
+ * LOG_FIFO_PACKED
+ * LOG_PACKED_BYTES_PER_ELEM
+ * LOG_FIFO_SPLIT
+ * LOG_PER_CONTEXT_FIFOS
+ * LOG_ISR_FIFO_N_ELEM
+ * LOG_N_TASK_FIFOS
+ * LOG_ERROR_RESERVE
+ * LOG_ERROR_FIFO_N_ELEM
+ * LOG_FLIGHT_RECORDER
+ * LOG_TRIGGER_PRE_ITEMS
+ * LOG_TRIGGER_POST_ITEMS
+ * LOG_INSTANCES
+ * LOG_N_BACKENDS
+ * LOG_POST_MORTEM
+ * LOG_POWER_FAIL_SAVE
+ * LOG_POWER_FAIL_PVD_LEVEL
+ * LOG_COMPRESS
+ * LOG_COMPRESS_WINDOW
+ * LOG_COMPRESS_SYNC_BYTES
+ * LOG_PACKETS
+ * LOG_PACKET_PAYLOAD
+ * LOG_SYSVIEW
+ * LOG_SYSVIEW_DESC
+ * LOG_SYSVIEW_SYNC_PACKETS
  *
  *
  * Public functions/macros
  *
  * - log_init()
+ * - log_early_init()
+ * - log_set_ready_handler()
+ * - log_set_urgent_handler()
+ * - log_set_module_names()
+ * - log_add_backend()
+ * - log_ctx_init()
+ * - log_ctx_str()
+ * - log_ctx_char()
+ * - log_ctx_dec()
+ * - log_ctx_hex()
+ * - LOG_LEVEL_BIT()
  * - log_thread()
+ * - log_idle_hook()
  * - log_flush()
+ * - log_panic_flush()
+ * - log_boot_flush()
+ * - LOG_BOOT_MARK()
+ * - log_get_stats()
+ * - log_set_saturation_handler()
+ * - log_saturation_notify()
+ * - log_post_mortem_save()
+ * - log_power_fail_save()
+ * - log_power_fail_irq_handler()
+ * - LOG_LEVEL_ENABLED()
+ * - log_set_module_level()
+ * - log_get_module_level()
+ * - log_command()
+ * - log_trigger()
+ * - log_task_snapshot()
+ * - log_trace_isr_enter()
+ * - log_trace_isr_exit()
+ * - log_type_register()
  *
  * - log_str()
  * - log_char()
+ * - log_chars()
+ * - log_eol()
+ * - log_enum()
+ * - log_reg()
+ * - log_custom()
+ * - log_printf()
  * - log_dec()
  * - log_hex()
+ * - log_ref()
+ * - log_ref_hex()
  * - log_array_dec()
  * - log_array_hex()
+ * - log_array_dec_stride()
+ * - log_array_hex_stride()
+ * - log_fixed()
+ * - log_float()
+ * - log_strcpy()
+ * - log_array_dec_copy()
+ * - log_array_hex_copy()
+ * - log_hexdump()
+ * - log_hexdump_copy()
+ * - log_buffer_ref()
+ * - log_fmt()
+ * - log_fmt_color()
+ * - log_kv()
+ * - log_line()
+ * - log_line_color()
+ * - LOG()
+ * - LOG_COLORED()
+ * - log_fmt_hex()
+ * - log_begin()
+ * - log_add()
+ * - log_end()
+ * - log_format_dec()
+ * - log_format_udec()
+ * - log_format_hex()
+ * - log_format_fixed()
+ * - log_format_float()
+ * - log_fmt_into()
+ *
+ * - log_err_str()
+ * - log_err_char()
+ * - log_err_dec()
+ * - log_err_hex()
+ * - log_err_strcpy()
+ * - log_err_fmt()
  *
  * - logc_str()
  * - logc_char()
@@ -102,6 +1048,77 @@
  * - logc_hex()
  * - logc_array_dec()
  * - logc_array_hex()
+ * - logc_array_dec_stride()
+ * - logc_array_hex_stride()
+ * - logc_fixed()
+ * - logc_float()
+ * - logc_strcpy()
+ * - logc_array_dec_copy()
+ * - logc_array_hex_copy()
+ * - logc_hexdump()
+ * - logc_hexdump_copy()
+ * - logc_fmt()
+ * - logc_kv()
+ *
+ * - log_str_ratelimited()
+ * - log_char_ratelimited()
+ * - log_dec_ratelimited()
+ * - log_hex_ratelimited()
+ * - log_array_dec_ratelimited()
+ * - log_array_hex_ratelimited()
+ * - log_fixed_ratelimited()
+ * - log_float_ratelimited()
+ * - log_strcpy_ratelimited()
+ * - log_array_dec_copy_ratelimited()
+ * - log_array_hex_copy_ratelimited()
+ * - log_hexdump_ratelimited()
+ * - log_hexdump_copy_ratelimited()
+ * - log_fmt_ratelimited()
+ *
+ * - log_str_every()
+ * - log_char_every()
+ * - log_dec_every()
+ * - log_hex_every()
+ * - log_array_dec_every()
+ * - log_array_hex_every()
+ * - log_fixed_every()
+ * - log_float_every()
+ * - log_strcpy_every()
+ * - log_array_dec_copy_every()
+ * - log_array_hex_copy_every()
+ * - log_hexdump_every()
+ * - log_hexdump_copy_every()
+ * - log_fmt_every()
+ *
+ * - log_str_sample()
+ * - log_char_sample()
+ * - log_dec_sample()
+ * - log_hex_sample()
+ * - log_array_dec_sample()
+ * - log_array_hex_sample()
+ * - log_fixed_sample()
+ * - log_float_sample()
+ * - log_strcpy_sample()
+ * - log_array_dec_copy_sample()
+ * - log_array_hex_copy_sample()
+ * - log_hexdump_sample()
+ * - log_hexdump_copy_sample()
+ * - log_fmt_sample()
+ *
+ * - log_str_from_isr()
+ * - log_char_from_isr()
+ * - log_dec_from_isr()
+ * - log_hex_from_isr()
+ * - log_array_dec_from_isr()
+ * - log_array_hex_from_isr()
+ * - log_fixed_from_isr()
+ * - log_float_from_isr()
+ * - log_strcpy_from_isr()
+ * - log_array_dec_copy_from_isr()
+ * - log_array_hex_copy_from_isr()
+ * - log_hexdump_from_isr()
+ * - log_hexdump_copy_from_isr()
+ * - log_fmt_from_isr()
  *
  *
  * Usage example
@@ -116,6 +1133,7 @@
  *
  * - log_char('\r');
  * - logc_char(PRINT_CR, '\r');
+ * - log_eol();
  *
  * - log_dec(u32Var);
  * - log_dec(s8Var);
@@ -129,6 +1147,16 @@
  * - uint16_t data[3] = {23, 156, 0};
  *   logc_array_hex(PRINT_DATA, &data[1], 2);     <-- Prints only last two array elements
  *
+ * - log_fmt("ADC ", channel, ": ", log_fmt_hex(value), "\r\n");   <-- One line, one FIFO insertion
+ *
+ * - log_line("State ", STATE_NAME, "\r\n");   <-- Literals only, one string item
+ *
+ * - log_line_t line;
+ *   log_begin(&line);
+ *   for(i = 0; i < nSensors; i++) { log_add(&line, " "); log_add(&line, sensors[i]); }
+ *   log_add(&line, "\r\n");
+ *   log_end(&line);
+ *
  */
 
 
@@ -146,21 +1174,212 @@ extern "C" {
 #endif
 
 
-#include "main.h"
+#include "log_port.h"
 
 #include <string.h>
 #include <stdbool.h>
 
 
+// Input FIFO synchronization schemes, selected with LOG_FIFO_MODE
+#define LOG_FIFO_LOCKED         0       // Interrupts disabled during the whole item copy, any number of producers
+#define LOG_FIFO_MPSC           1       // Interrupts disabled only to reserve a slot, item is copied and committed unmasked
+#define LOG_FIFO_SPSC           2       // No interrupt masking at all, only valid if a single task or ISR logs
+
+// Log levels, selected with LOG_LEVEL and LOG_FILE_LEVEL
+#define LOG_LEVEL_OFF           0
+#define LOG_LEVEL_ERROR         1
+#define LOG_LEVEL_WARNING       2
+#define LOG_LEVEL_INFO          3
+#define LOG_LEVEL_DEBUG         4
+
+// Line prefixes of LOG_LINE_PREFIX for each level, NONE for the logs without one. %l is the level
+// letter, %L its name, %m the module name of log_set_module_names() (or its number), %M the module
+// number, %t the timestamp ticks of the item (LOG_TIMESTAMPS), %c switches to the color of the level
+// and %% is a '%'. Everything else is copied.
+#define LOG_PREFIX_NONE         ""
+#define LOG_PREFIX_ERROR        "%c%l %m: "
+#define LOG_PREFIX_WARNING      "%c%l %m: "
+#define LOG_PREFIX_INFO         "%c%l %m: "
+#define LOG_PREFIX_DEBUG        "%c%l %m: "
+
+
 /*********************** User configurable definitions ***********************/
 
 #define LOG_INPUT_FIFO_N_ELEM   256     // Defines log input FIFO size in number of elements (const strings, variables, etc)
+#define LOG_FIFO_SPARE_RAM      0       // The input FIFO fills the .log_fifo region of the RAM left by the linker instead
 #define LOG_DELAY_LOOPS_MS      100     // Delay between log thread pollings to check if input queue contains data
+#define LOG_IDLE_HOOK_ITEMS     0       // Items log_idle_hook() outputs per call, replaces log_thread() (0 disables it)
+#define LOG_FLUSH_BUDGET_ITEMS  0       // Items log_thread() outputs before yielding to the tasks of its priority (0 outputs all)
+#define LOG_DELEGATED_FLUSH     0       // log_flush() from a task has the log thread do the flush and waits for it
+#define LOG_OVERFLOW_BLOCK      0       // Tasks wait for the log thread to make room in a full input FIFO instead of dropping
+#define LOG_OVERFLOW_BLOCK_MS   100     // Longest wait of a task for room before its item is dropped
+#define LOG_OVERFLOW_BLOCK_TASKS    4   // Tasks that can wait on a semaphore at once, the others poll at each tick
+#define LOG_LOW_POWER           0       // The log thread sleeps without timeout while the input FIFOs are empty
+#define LOG_DRAIN_BACKEND       0       // log_thread() and log_idle_hook() call the flush handler, the backend needs no thread
+#define LOG_LEVEL               LOG_LEVEL_DEBUG     // Most verbose level compiled in, logs of higher levels are removed
+#define LOG_MODULES_ENABLED     0xFFFFFFFFUL        // Bit mask of the LOG_MODULE numbers whose logs are compiled in
+#define LOG_RUNTIME_LEVELS      0       // Per module level that can be changed at runtime with log_set_module_level()
+#define LOG_GOVERNOR            0       // The log thread lowers the runtime level while the input FIFOs fill up faster than the output
+#define LOG_GOVERNOR_MIN_LEVEL  LOG_LEVEL_WARNING   // Lowest level the governor goes down to
+#define LOG_GOVERNOR_HIGH_PERCENT   75  // Input FIFO fill level at which the governor lowers the level if the output is behind
+#define LOG_GOVERNOR_LOW_PERCENT    25  // Fill level of all the input FIFOs below which a log thread loop is calm
+#define LOG_GOVERNOR_CALM_LOOPS 10      // Calm loops before the governor raises the level back by one
+#define LOG_GOVERNOR_BUSY_TICKS (LOG_DELAY_LOOPS_MS * 32000UL)  // LOG_TIMESTAMP_GET() ticks of a busy flush, half a loop at 64 MHz
+#define LOG_CPU_BUDGET_PERCENT  0       // Highest share of the CPU time the log thread spends processing the input FIFOs (0 = no limit)
+#define LOG_CPU_BUDGET_WINDOW_TICKS (100 * 64000UL)     // LOG_TIMESTAMP_GET() ticks the budget is measured over, 100 ms at 64 MHz
+#define LOG_CPU_BUDGET_SHED_LEVEL   LOG_LEVEL_WARNING   // Highest level still stored while the log thread is over budget
+#define LOG_CPU_BUDGET_PASS_ITEMS   16  // Items processed between two checks of the budget
+#define LOG_WAKEUP_FILL_PERCENT 0       // Input FIFO fill level that wakes up the log thread before its delay ends (0 disables it)
+#define LOG_BOOST_FILL_PERCENT  0       // Input FIFO fill level that raises the log thread to LOG_BOOST_PRIORITY (0 disables it)
+#define LOG_BOOST_RESTORE_PERCENT   25  // Fill level of all the input FIFOs below which the boosted log thread gets its priority back
+#define LOG_BOOST_PRIORITY      (tskIDLE_PRIORITY + 4)  // FreeRTOS priority of the boosted log thread (osPriorityAboveNormal)
+#define LOG_RENDER_BUFFER_SIZE  0       // Bytes of output batched before calling the output handler (0 sends each item directly)
+#define LOG_RENDER_PING_PONG    0       // Alternate two render buffers so the output handler can send them in place
+#define LOG_FAST_DECIMAL        0       // Division free decimal formatting, uses a 200 bytes table
+#define LOG_FAST_HEX            0       // Hexadecimal formatting one byte per lookup, uses a 512 bytes table
+#define LOG_RAM_FUNCTIONS       0       // Run the producer fast path and the formatting kernels from RAM, without flash wait states
+#define LOG_INLINE_PRODUCERS    0       // log_dec() and log_hex() write their item into the input FIFO at the call, without calling _log_var()
+#define LOG_CONST_NUMBERS       0       // log_dec() and log_hex() of literals that fit in 4 characters are formatted at compile time
+#define LOG_64BIT_NUMBERS       0       // Accept (unsigned) long long in log_dec() and log_hex(), adds 4 bytes to each item
+#define LOG_BINARY_OUTPUT       0       // Send encoded records instead of text, decoded on the host by Tools/log_decode.py
+#define LOG_TIMESTAMPS          0       // Timestamp each item with LOG_TIMESTAMP_GET() and print the delta at each line start
+#define LOG_TIMESTAMP_GET()     (TIM2->CNT)     // Free running 32 bit counter read for timestamps (TIM2 counts core cycles)
+#define LOG_TIMESTAMP_HZ        64000000UL      // Frequency of LOG_TIMESTAMP_GET(), to give its ticks a wall clock time
+#define LOG_SEQUENCE_NUMBERS    0       // Number each item when stored, dropped ones included, and send it so the host counts the losses
+#define LOG_SEQUENCE_TEXT_LINES 16      // Lines between two sequence numbers printed in text mode
+#define LOG_TIME_SYNC           0       // log_command() answers the "logsync" beacons of the host with the ticks they arrived at
+#define LOG_RTC_ANCHOR_MS       0       // Period of the RTC calendar reads of the log thread that date the timestamps (0 disables them)
+#define LOG_NODE_ID             0       // Number of the board in the sync lines, to tell apart the streams of several boards
+#define LOG_CONTEXT_IDS         0       // Tag each item with the task or ISR that logged it and print its name at each line start
+#define LOG_CONTEXT_N_TASKS     8       // Tasks given their own ID, the following ones are shown as [?]
+#define LOG_CONTEXT_TLS_INDEX   0       // Thread local storage pointer of each task that holds its ID
+#define LOG_LINE_PREFIX         0       // Start each line with the LOG_PREFIX_ template of its level, expanded by the log thread
+#define LOG_CONTEXT_QUOTA       0       // Input FIFO items that each context ID may hold at once, its next logs are dropped (0 disables it)
+#define LOG_BENCH               0       // Measure the longest input FIFO critical section for log_bench_run()
+#define LOG_STRESS              0       // The demo thread of main.c runs the multi-producer stages of log_stress.h instead
+#define LOG_THROUGHPUT          0       // The demo thread of main.c runs the end to end mixes of log_throughput.h instead, needs LOG_STATS
+#define LOG_PROF                0       // Cycle profiler of the LOG_PROF_BEGIN()/LOG_PROF_END() sections of log_prof.h
+#define LOG_BOOT_MARKS          0       // LOG_BOOT_MARK() logs the microseconds since HAL_Init() and since the previous mark
+#define LOG_BOOT_TIMEBASE       TIM17   // HAL time base timer of the boot marks, 1 MHz counter with a 1 ms period
+#define LOG_PROBES              0       // Debug GPIOs of log_probe.h high during the critical sections, processing passes and UART transfers
+#define LOG_METRICS             0       // Counters of log_metric.h, logged as one array by the log thread every LOG_METRIC_PERIOD_MS
+#define LOG_WATCH               0       // Variables of log_watch() sampled and logged by the log thread itself
+#define LOG_QUEUE_MONITOR       0       // High water marks of the registered queues and stream buffers, logged by the log thread
+#define LOG_REGS                0       // log_reg() values split into the fields of LOG_REG_DESC() by the log thread
+#define LOG_CUSTOM_TYPES        0       // Type IDs of log_custom(), whose raw copies are rendered by log_type_register() formatters
+#define LOG_PRINTF              0       // log_printf() copies the argument words, the log thread parses the format (needs the copy arena)
+#define LOG_LOCATIONS           0       // LOG_HERE() and log_assert() log a 4 byte file name hash and line instead of __FILE__ and __LINE__
+#define LOG_INTERN_STRINGS      0       // Send log_str() literals as offsets in the .log_strings section (needs LOG_BINARY_OUTPUT)
+#define LOG_DEFERRED_STRLEN     0       // log_str() of a non constant string leaves its strlen() to the log thread
+#define LOG_ARRAY_DELTA         0       // Send array records as zigzag differences and runs of repeats (needs LOG_BINARY_OUTPUT)
+#define LOG_HISTORY_SIZE        0       // Bytes of the last output kept for log_history_replay() and "loghistory" (power of 2, 0 disables it)
+#define LOG_STATS               0       // Count enqueued and dropped items, FIFO high-water mark, output bytes and flush time
+#define LOG_LATENCY             0       // Histograms in log_get_stats() of the ticks from log_fifo_put() to the handler and to the wire
+#define LOG_LATENCY_N_BINS      16      // Bins of each histogram, the last one holds all the longer latencies
+#define LOG_LATENCY_SHIFT       6       // The first bin is below 2^n ticks (1 us at 64 MHz), each next one doubles
+#define LOG_LATENCY_PENDING     32      // Items output between two handler calls that are timed at the call, the next at their output
+#define LOG_SATURATION_HOOKS    0       // Call the log_set_saturation_handler() function on FIFO high water, FIFO drops and backend drops
+#define LOG_SATURATION_PERCENT  75      // Input FIFO fill level of the LOG_SATURATION_HIGH_WATER event
+#define LOG_SATURATION_HOOK_MS  100     // Shortest time between two calls for the same event, LOG_RATELIMIT_MS_GET() milliseconds
+#define LOG_LINE_N_ARGS         16      // Tokens that a log_begin()/log_end() line can hold, the following ones are ignored
+#define LOG_DEDUP               0       // Count repeats of the previous log_fmt()/log_end() message instead of storing them
+#define LOG_RATELIMIT_MS_GET()  HAL_GetTick()   // Millisecond counter of the log_*_ratelimited() windows
 #define LOG_SUPPORT_ANSI_COLOR  1       // Activating colors increase element size
+#define LOG_COLOR_ON_CHANGE     0       // Emit color escape sequences only when the color changes
+#define LOG_FIFO_MODE           LOG_FIFO_LOCKED     // Input FIFO synchronization scheme (LOG_FIFO_LOCKED, LOG_FIFO_MPSC, LOG_FIFO_SPSC)
+#define LOG_ISR_UNMASKED        0       // log_*_from_isr() store without masking interrupts, only from ISRs no logging ISR preempts
+#define LOG_FIFO_LOCK_FREE      0       // LOG_FIFO_MPSC reserves slots with LDREX/STREX instead of masking (Cortex-M3 and above, multi-core)
+#define LOG_MASK_BASEPRI        0       // Critical sections only mask up to configMAX_SYSCALL_INTERRUPT_PRIORITY (Cortex-M3 and above)
+#define LOG_BULK_ARRAYS         0       // Store arrays as a single reference record, expanded by the log thread
+#define LOG_ARRAY_CHUNK_ELEMS   0       // Elements of a bulk array record output per item of a flush pass (0 outputs it whole)
+#define LOG_COPY_ARENA_SIZE     0       // Bytes per input FIFO for log_strcpy() and log_array_*_copy() data (power of 2, 0 disables it)
+#define LOG_BUFFER_REFS         0       // log_buffer_ref() buffers output in place and handed back with their release callback
+#define LOG_FIFO_PACKED         0       // Store variable length records (1 byte header + 0..6 bytes payload) in a byte ring
+#define LOG_PACKED_BYTES_PER_ELEM   8   // Bytes of packed ring allocated per element of LOG_INPUT_FIFO_N_ELEM (power of 2)
+#define LOG_FIFO_SPLIT          0       // Store the header bytes of the items in a dense array apart from their payload words (LOG_FIFO_LOCKED)
+#define LOG_PER_CONTEXT_FIFOS   0       // Separate input FIFOs for ISRs and for each task priority band
+#define LOG_ISR_FIFO_N_ELEM     32      // Size of the ISR input FIFO if LOG_PER_CONTEXT_FIFOS is enabled
+#define LOG_N_TASK_FIFOS        2       // Number of task priority bands, each with a FIFO of LOG_INPUT_FIFO_N_ELEM
+#define LOG_ERROR_RESERVE       0       // Items (bytes if packed) of each input FIFO that only LOG_LEVEL_ERROR logs can fill
+#define LOG_ERROR_FIFO_N_ELEM   0       // Size of the FIFO of the LOG_LEVEL_ERROR logs, output before the others (0 disables it)
+#define LOG_FLIGHT_RECORDER     0       // Overwrite the oldest items when the input FIFO is full, output them only on log_trigger()
+#define LOG_TRIGGER_PRE_ITEMS   (LOG_INPUT_FIFO_N_ELEM - LOG_TRIGGER_POST_ITEMS)    // Recorded items kept when log_trigger() is called
+#define LOG_TRIGGER_POST_ITEMS  0       // Items stored after log_trigger() before the FIFO is frozen and output
+#define LOG_INSTANCES           0       // log_ctx_init() loggers with their own input FIFO and output handler
+#define LOG_N_BACKENDS          1       // Output backends, the one of log_init() and up to LOG_N_BACKENDS - 1 from log_add_backend()
+#define LOG_POST_MORTEM         0       // Keep the input FIFOs in .noinit RAM, log_post_mortem_save() preserves them across a reset
+#define LOG_POWER_FAIL_SAVE     0       // With LOG_POST_MORTEM, the PVD interrupt saves the pending items to the FLASH_LOG_SAVE region
+#define LOG_POWER_FAIL_PVD_LEVEL    PWR_PVDLEVEL_6  // PVD thresholds of LOG_POWER_FAIL_SAVE, 2.8 V falling on the G071
+#define LOG_COMPRESS            0       // LZSS compress the output for Tools/log_decode.py, uses LOG_COMPRESS_WINDOW + 640 bytes of RAM (768 with LOG_RENDER_PING_PONG)
+#define LOG_COMPRESS_WINDOW     1024    // Bytes of past output that compression matches can refer to (power of 2, 1024 at most)
+#define LOG_COMPRESS_SYNC_BYTES 4096    // Output bytes between the resync markers of the compressed stream (0 disables them)
+#define LOG_PACKETS             0       // Send the output in COBS packets with sequence number and CRC-32 of the CRC peripheral
+#define LOG_PACKET_PAYLOAD      128     // Output bytes per packet at most
+#define LOG_SYSVIEW             0       // Send the text lines and the LOG_RTOS_TRACE events as SEGGER SystemView packets
+#define LOG_SYSVIEW_DESC        "N=Logger,D=Cortex-M0+,O=FreeRTOS"  // System description shown by SystemView
+#define LOG_SYSVIEW_SYNC_PACKETS    256 // Packets between two syncs, so that the host can join the stream at any time
 
 /*****************************************************************************/
 
 
+// Level and module of the logs of the including file, they can be defined before including log.h
+#ifndef LOG_FILE_LEVEL
+#define LOG_FILE_LEVEL          LOG_LEVEL_INFO
+#endif
+#ifndef LOG_MODULE
+#define LOG_MODULE              0
+#endif
+
+#if LOG_MODULE > 31
+#error "LOG_MODULE must be a bit number of a 32 bit mask"
+#endif
+
+// Constant expression, usable as the condition of logc_ macros so disabled logs are optimized out
+#define LOG_LEVEL_ENABLED(level)    ((level) <= LOG_LEVEL && ((LOG_MODULES_ENABLED >> LOG_MODULE) & 1))
+
+#if LOG_LINE_PREFIX
+// The module travels above the level, for the prefix of the line
+#define _LOG_LEVEL_SHIFT            4
+#define _LOG_MODULE_SHIFT           7
+#define _LOG_COLOR_LEVEL(color, level) ((enum log_color)((color) | ((level) << _LOG_LEVEL_SHIFT) | \
+                                                         (LOG_MODULE << _LOG_MODULE_SHIFT)))
+#elif LOG_N_BACKENDS > 1 || LOG_ERROR_RESERVE || LOG_ERROR_FIFO_N_ELEM || LOG_CPU_BUDGET_PERCENT
+// The level of the calling file travels in the high bits of the color argument until it is stored
+// in the item, so each backend can filter it and the input FIFOs can keep room or a FIFO for errors
+#define _LOG_LEVEL_SHIFT            4
+#define _LOG_COLOR_LEVEL(color, level) ((enum log_color)((color) | ((level) << _LOG_LEVEL_SHIFT)))
+#else
+#define _LOG_COLOR_LEVEL(color, level) (color)
+#endif
+#define _LOG_COLOR(color)           _LOG_COLOR_LEVEL(color, LOG_FILE_LEVEL)
+
+// Level mask bit for log_add_backend()
+#define LOG_LEVEL_BIT(level)        (1UL << (level))
+
+// Interrupt masking of the critical sections of log.c and of the modules around it. With
+// LOG_MASK_BASEPRI the interrupts above configMAX_SYSCALL_INTERRUPT_PRIORITY keep running, they are
+// not allowed to log (nor to call FreeRTOS). The saved value is then BASEPRI, even if the variables
+// are still named primaskBit.
+#if LOG_MASK_BASEPRI
+#define LOG_MASK_SAVE(primaskBit)       do { (primaskBit) = __get_BASEPRI();                             \
+                                             __set_BASEPRI_MAX(configMAX_SYSCALL_INTERRUPT_PRIORITY);    \
+                                             __ISB(); } while(0)
+#define LOG_MASK_RESTORE(primaskBit)    __set_BASEPRI(primaskBit)
+#else
+#define LOG_MASK_SAVE(primaskBit)       do { (primaskBit) = __get_PRIMASK(); __disable_irq(); } while(0)
+#define LOG_MASK_RESTORE(primaskBit)    __set_PRIMASK(primaskBit)
+#endif
+
+#if LOG_RUNTIME_LEVELS
+// For each level, mask of the modules that currently log at it. Checked before any FIFO access.
+extern volatile uint32_t _logLevelModules[LOG_LEVEL_DEBUG + 1];
+#define _LOG_CALL_LEVEL(level, call)    ((_logLevelModules[level] & (1UL << LOG_MODULE)) ? (call) : (void)0)
+#else
+#define _LOG_CALL_LEVEL(level, call)    (call)
+#endif
+#define _LOG_CALL(call)             _LOG_CALL_LEVEL(LOG_FILE_LEVEL, call)
+
+
 enum log_data_type {
     _LOG_STRING,
     _LOG_UINT_DEC,
@@ -170,7 +1389,32 @@ enum log_data_type {
     _LOG_HEX_1,
     _LOG_HEX_2,
     _LOG_HEX_4,
-    LOG_CHAR
+    LOG_CHAR,
+    _LOG_ARRAY,
+    _LOG_STRING_COPY,
+    _LOG_ARRAY_COPY,
+    _LOG_HEX_8,
+    _LOG_UINT_DEC_8,
+    _LOG_INT_DEC_8,
+    _LOG_FIXED,
+    _LOG_FLOAT,
+    _LOG_HEXDUMP,
+    _LOG_HEXDUMP_COPY,
+    _LOG_TRACE,                         // Kernel event of log_trace.h
+    _LOG_ENUM,                          // Index in a table of names, looked up by the log thread
+    _LOG_REG,                           // Register value and its LOG_REG_DESC() fields
+    _LOG_CUSTOM,                        // Raw copy rendered by the formatter of its type ID
+    _LOG_BUFFER_CTX,                    // Argument of the release of a log_buffer_ref() buffer
+    _LOG_BUFFER_RELEASE,                // Release of the buffer, called once it is output
+    _LOG_LOCATION,                      // LOG_HERE() file name hash and line
+    _LOG_ARRAY_STRIDE,                  // Array record of elements spaced by a stride, like a field of structs
+    _LOG_KV,                            // log_kv() record of uData pairs, whose keys and values follow it
+    _LOG_REF                            // log_ref() variable at str, read by the log thread
+};
+
+enum log_buffer_format {
+    LOG_BUFFER_TEXT,
+    LOG_BUFFER_HEXDUMP
 };
 
 enum log_color {
@@ -190,88 +1434,800 @@ enum log_color {
 
 typedef void (*log_out_handler)(void* p_data, uint32_t length);
 typedef void (*log_out_flush_handler)(void);
+typedef bool (*log_out_ready_handler)(void);
+typedef void (*log_buffer_release_t)(void *ctx);
 
+#if LOG_CONTEXT_QUOTA
+// Counters of LOG_CONTEXT_QUOTA: main, the LOG_CONTEXT_N_TASKS task IDs, the tasks beyond them, the ISRs
+#define LOG_QUOTA_N_CONTEXTS    (LOG_CONTEXT_N_TASKS + 3)
+#endif
+
+typedef struct log_stats_s
+{
+    uint32_t nEnqueued;                 // Items stored in the input FIFOs
+    uint32_t nDropped;                  // Items lost because an input FIFO or its arena was full
+    uint32_t highWater;                 // Highest input FIFO fill level, in items or in bytes if packed
+    uint32_t nBytesOut;                 // Bytes sent to the output handler
+    uint32_t maxFlushTicks;             // Longest processing loop, in LOG_TIMESTAMP_GET() ticks
+    uint32_t flushTicks;                // All the processing loops, wraps around like LOG_TIMESTAMP_GET()
+    uint32_t nRateLimited;              // Calls dropped by the log_*_ratelimited() macros
+#if LOG_CONTEXT_QUOTA
+    uint32_t nQuotaDropped[LOG_QUOTA_N_CONTEXTS];   // Items of each context dropped by LOG_CONTEXT_QUOTA
+#endif
+#if LOG_CPU_BUDGET_PERCENT
+    uint32_t nBudgetShed;               // Items dropped while the log thread was over LOG_CPU_BUDGET_PERCENT
+#endif
+#if LOG_LATENCY
+    uint32_t latencyHandoff[LOG_LATENCY_N_BINS];    // Items by ticks from their enqueue to the output handler call
+    uint32_t latencyWire[LOG_LATENCY_N_BINS];       // Oldest items of each call by ticks to log_latency_tx_done()
+#endif
+} log_stats_t;
+
+// Events of the log_set_saturation_handler() function
+typedef enum
+{
+    LOG_SATURATION_HIGH_WATER,          // An input FIFO reached LOG_SATURATION_PERCENT, value is its fill level
+    LOG_SATURATION_FIFO_DROP,           // Items dropped because an input FIFO was full, value is their number since the last call
+    LOG_SATURATION_OUTPUT_DROP,         // Bytes dropped or cut by the backend, value is their number since the last call
+    _LOG_SATURATION_LEN
+} log_saturation_event_t;
+
+typedef void (*log_saturation_handler)(log_saturation_event_t event, uint32_t value);
+
+#if LOG_INSTANCES
+// Logger instance of log_ctx_init(), only used by log.c. fifo holds the state of its input FIFO.
+typedef struct log_ctx_s
+{
+    void                *fifo[8];
+    log_out_handler      printHandler;
+    struct log_ctx_s    *pNext;                 // Next instance drained by the log thread
+} log_ctx_t;
+
+// Instance of the FIFO and the backend of log_init(), log_ctx_dec(LOG_CTX_DEFAULT, x) is log_dec(x)
+#define LOG_CTX_DEFAULT             ((log_ctx_t*)NULL)
+#endif
+
+
+
+#if LOG_INTERN_STRINGS
+// Places the string literal in the .log_strings section, so only its offset in it is sent
+#define _LOG_STR(str)               ({ static const char _logStr[] __attribute__((section(".log_strings"))) = str; \
+                                       (char*)_logStr; })
+#else
+#define _LOG_STR(str)               (str)
+#endif
+
+#define LOG_STR_LEN_UNKNOWN         0xFFFF      // Length of a log_str() item measured by the log thread
+#if LOG_DEFERRED_STRLEN
+// Literals still fold to their length, other strings are measured when they are output
+#define _LOG_STRLEN(str)            (__builtin_constant_p(strlen(str)) ? strlen(str) : LOG_STR_LEN_UNKNOWN)
+#else
+#define _LOG_STRLEN(str)            strlen(str)
+#endif
 
 
 // Macro that returns the second element.
 // Used to count the number of variable arguments
 #define GET_MACRO(_1, NAME, ...) NAME
 
+// Names of a log_enum() table, which must be an array and not a pointer
+#define _LOG_N_NAMES(names)         (sizeof(names) / sizeof((names)[0]))
+
+// LOG_HERE() record: 16 bit hash of the file name in the high half and the line in the low one. The
+// hash sums the first 32 characters times the powers of 0x01000193 and folds the sum to 16 bits, as
+// Tools/log_decode.py --sources does. The characters of the literal are constants, so the compiler
+// folds it all (from -O1, -O0 computes it at each call).
+#ifdef __FILE_NAME__
+#define _LOG_FILE_NAME              __FILE_NAME__
+#else
+#define _LOG_FILE_NAME              __FILE__
+#endif
+#define _LOG_FILE_CHAR(i, power)    ((uint32_t)(uint8_t)_LOG_FILE_NAME[((i) < sizeof(_LOG_FILE_NAME)) ? (i) : 0] * \
+                                     (((i) < sizeof(_LOG_FILE_NAME) - 1) ? (power) : 0))
+#define _LOG_FILE_HASH32            (_LOG_FILE_CHAR(0, 0x00000001UL) + _LOG_FILE_CHAR(1, 0x01000193UL) + _LOG_FILE_CHAR(2, 0x26027A69UL) + _LOG_FILE_CHAR(3, 0x3EE6B34BUL) + \
+                                     _LOG_FILE_CHAR(4, 0x502C3F11UL) + _LOG_FILE_CHAR(5, 0x46A747C3UL) + _LOG_FILE_CHAR(6, 0xFC55F7F9UL) + _LOG_FILE_CHAR(7, 0x34555CFBUL) + \
+                                     _LOG_FILE_CHAR(8, 0x5D615F21UL) + _LOG_FILE_CHAR(9, 0x2148C0F3UL) + _LOG_FILE_CHAR(10, 0x5887BE89UL) + _LOG_FILE_CHAR(11, 0xE6B0F1ABUL) + \
+                                     _LOG_FILE_CHAR(12, 0xD38C7031UL) + _LOG_FILE_CHAR(13, 0x37149D23UL) + _LOG_FILE_CHAR(14, 0xD8735E19UL) + _LOG_FILE_CHAR(15, 0xD69D215BUL) + \
+                                     _LOG_FILE_CHAR(16, 0x345B8241UL) + _LOG_FILE_CHAR(17, 0xAD0E0C53UL) + _LOG_FILE_CHAR(18, 0xC01D66A9UL) + _LOG_FILE_CHAR(19, 0x17489C0BUL) + \
+                                     _LOG_FILE_CHAR(20, 0xB24DA551UL) + _LOG_FILE_CHAR(21, 0x013B3E83UL) + _LOG_FILE_CHAR(22, 0x73436839UL) + _LOG_FILE_CHAR(23, 0xAC1D11BBUL) + \
+                                     _LOG_FILE_CHAR(24, 0xACC2E961UL) + _LOG_FILE_CHAR(25, 0x57D563B3UL) + _LOG_FILE_CHAR(26, 0xF7EBF2C9UL) + _LOG_FILE_CHAR(27, 0x116F326BUL) + \
+                                     _LOG_FILE_CHAR(28, 0xDD0C5E71UL) + _LOG_FILE_CHAR(29, 0x6B78ABE3UL) + _LOG_FILE_CHAR(30, 0x11F69659UL) + _LOG_FILE_CHAR(31, 0xA02EAE1BUL))
+#define _LOG_LOCATION_ID            ((((_LOG_FILE_HASH32 ^ (_LOG_FILE_HASH32 >> 16)) & 0xFFFF) << 16) | (__LINE__ & 0xFFFF))
+#define _LOG_STRINGIFY(x)           #x
+#define _LOG_LINE_STR(line)         _LOG_STRINGIFY(line)
+
 
 
-#define log_str(str, ...)           GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_str((str), strlen(str) __VA_OPT__(,) __VA_ARGS__), \
-                                                                        _log_str((str), strlen(str), LOG_COLOR_NONE))
+#if LOG_LEVEL_ENABLED(LOG_FILE_LEVEL)
+#define log_str(str, ...)           _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_str(_LOG_STR(str), _LOG_STRLEN(str) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                  _log_str(_LOG_STR(str), _LOG_STRLEN(str), _LOG_COLOR(LOG_COLOR_NONE))))
 
-#define log_char(chr, ...)          GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_char((chr) __VA_OPT__(,) __VA_ARGS__),   \
-                                                                        _log_char((chr), LOG_COLOR_NONE))
+#define log_char(chr, ...)          _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_char((chr) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)),   \
+                                                                                  _log_char((chr), _LOG_COLOR(LOG_COLOR_NONE))))
 
-#define log_dec(number, ...)        GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_dec((number) __VA_OPT__(,) __VA_ARGS__), \
-                                                                        _log_dec((number), LOG_COLOR_NONE))
+#define log_chars(str, ...)         _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_chars((str), strlen(str) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                  _log_chars((str), strlen(str), _LOG_COLOR(LOG_COLOR_NONE))))
 
-#define log_hex(number, ...)        GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_hex((number) __VA_OPT__(,) __VA_ARGS__), \
-                                                                        _log_hex((number), LOG_COLOR_NONE))
+#define log_eol(...)                log_chars("\r\n" __VA_OPT__(,) __VA_ARGS__)
 
-#define log_array_dec(array, nItems, ...)   GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_array_dec((array), (nItems) __VA_OPT__(,) __VA_ARGS__), \
-                                                                                _log_array_dec((array), (nItems), LOG_COLOR_NONE))
+#define log_enum(value, names, ...) _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_enum((value), (names), _LOG_N_NAMES(names) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                  _log_enum((value), (names), _LOG_N_NAMES(names), _LOG_COLOR(LOG_COLOR_NONE))))
 
-#define log_array_hex(array, nItems, ...)   GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_array_hex((array), (nItems) __VA_OPT__(,) __VA_ARGS__), \
-                                                                                _log_array_hex((array), (nItems), LOG_COLOR_NONE))
+#if LOG_LOCATIONS
+#define LOG_HERE()                  _LOG_CALL(_log_var(_LOG_LOCATION_ID, _LOG_LOCATION, _LOG_COLOR(LOG_COLOR_NONE)))
+#else
+#define LOG_HERE()                  log_str(_LOG_FILE_NAME ":" _LOG_LINE_STR(__LINE__))
+#endif
+
+#define log_assert(cond)            ((cond) ? (void)0 : (log_str("Assert "), LOG_HERE(), log_eol()))
 
+#if LOG_REGS
+#define log_reg(value, desc, ...)   _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_reg((value), &(desc) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                  _log_reg((value), &(desc), _LOG_COLOR(LOG_COLOR_NONE))))
+#else
+#define log_reg(value, desc, ...)   ((void)sizeof(value))
+#endif
 
+#if LOG_CUSTOM_TYPES
+#define log_custom(typeId, ptr, size, ...)  _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_custom((typeId), (ptr), (size) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                          _log_custom((typeId), (ptr), (size), _LOG_COLOR(LOG_COLOR_NONE))))
+#else
+#define log_custom(typeId, ptr, size, ...)  ((void)sizeof(ptr), (void)sizeof(size))
+#endif
 
-#define _log_dec(number, color) _log_var((uint32_t)(number), _Generic((number),             \
-                                                            unsigned char:  _LOG_UINT_DEC,  \
-                                                            unsigned short: _LOG_UINT_DEC,  \
-                                                            unsigned long:  _LOG_UINT_DEC,  \
-                                                            unsigned int:   _LOG_UINT_DEC,  \
-                                                            char:           _LOG_INT_DEC_1, \
-                                                            signed char:    _LOG_INT_DEC_1, \
-                                                            signed short:   _LOG_INT_DEC_2, \
-                                                            signed long:    _LOG_INT_DEC_4, \
-                                                            signed int:     _LOG_INT_DEC_4), (color))
+#if LOG_PRINTF
+#define log_printf(fmt, ...)        _LOG_CALL(_log_printf((const uintptr_t[]){ (uintptr_t)("" fmt) __VA_OPT__(, _LOG_PRINTF_ARGS(__VA_ARGS__)) }, \
+                                                          1 __VA_OPT__(+ _LOG_NARGS(__VA_ARGS__)), _LOG_COLOR(LOG_COLOR_NONE)))
+#else
+#define log_printf(fmt, ...)        ((void)sizeof((const uintptr_t[]){ (uintptr_t)("" fmt) __VA_OPT__(, _LOG_PRINTF_ARGS(__VA_ARGS__)) }))
+#endif
 
+#define log_dec(number, ...)        _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_dec((number) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                  _log_dec((number), _LOG_COLOR(LOG_COLOR_NONE))))
 
-#define _log_hex(number, color) _log_var((uint32_t)(number), _Generic((number),          \
-                                                            unsigned char:  _LOG_HEX_1,  \
-                                                            unsigned short: _LOG_HEX_2,  \
-                                                            unsigned long:  _LOG_HEX_4,  \
-                                                            unsigned int:   _LOG_HEX_4,  \
-                                                            char:           _LOG_HEX_1,  \
-                                                            signed char:    _LOG_HEX_1,  \
-                                                            signed short:   _LOG_HEX_2,  \
-                                                            signed long:    _LOG_HEX_4,  \
-                                                            signed int:     _LOG_HEX_4), (color))
+#define log_hex(number, ...)        _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_hex((number) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                  _log_hex((number), _LOG_COLOR(LOG_COLOR_NONE))))
 
+#define log_ref(ptr, ...)           _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_ref((ptr), _LOG_REF_DEC_TYPE(*(ptr)), sizeof(*(ptr)) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                  _log_ref((ptr), _LOG_REF_DEC_TYPE(*(ptr)), sizeof(*(ptr)), _LOG_COLOR(LOG_COLOR_NONE))))
 
-#define _log_array_dec(array, nItems, color)    _log_array((uint32_t*)(array), (nItems), sizeof((array)[0]), \
-                                                            _Generic((array)[0],            \
-                                                            unsigned char:  _LOG_UINT_DEC,  \
-                                                            unsigned short: _LOG_UINT_DEC,  \
-                                                            unsigned long:  _LOG_UINT_DEC,  \
-                                                            unsigned int:   _LOG_UINT_DEC,  \
-                                                            char:           _LOG_INT_DEC_1, \
-                                                            signed char:    _LOG_INT_DEC_1, \
-                                                            signed short:   _LOG_INT_DEC_2, \
-                                                            signed long:    _LOG_INT_DEC_4, \
-                                                            signed int:     _LOG_INT_DEC_4), (color))
+#define log_ref_hex(ptr, ...)       _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_ref((ptr), _LOG_REF_HEX_TYPE(*(ptr)), sizeof(*(ptr)) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                  _log_ref((ptr), _LOG_REF_HEX_TYPE(*(ptr)), sizeof(*(ptr)), _LOG_COLOR(LOG_COLOR_NONE))))
 
+#define log_array_dec(array, nItems, ...)   _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_array_dec((array), (nItems) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                          _log_array_dec((array), (nItems), _LOG_COLOR(LOG_COLOR_NONE))))
+
+#define log_array_hex(array, nItems, ...)   _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_array_hex((array), (nItems) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                          _log_array_hex((array), (nItems), _LOG_COLOR(LOG_COLOR_NONE))))
+
+#define log_array_dec_stride(array, nItems, stride, ...)    _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_array_dec_stride((array), (nItems), (stride) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                                          _log_array_dec_stride((array), (nItems), (stride), _LOG_COLOR(LOG_COLOR_NONE))))
+
+#define log_array_hex_stride(array, nItems, stride, ...)    _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_array_hex_stride((array), (nItems), (stride) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                                          _log_array_hex_stride((array), (nItems), (stride), _LOG_COLOR(LOG_COLOR_NONE))))
+
+#define log_strcpy(str, ...)        _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_strcpy((str), strlen(str) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                  _log_strcpy((str), strlen(str), _LOG_COLOR(LOG_COLOR_NONE))))
+
+#define log_array_dec_copy(array, nItems, ...)  _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_array_dec_copy((array), (nItems) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                              _log_array_dec_copy((array), (nItems), _LOG_COLOR(LOG_COLOR_NONE))))
+
+#define log_array_hex_copy(array, nItems, ...)  _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_array_hex_copy((array), (nItems) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                              _log_array_hex_copy((array), (nItems), _LOG_COLOR(LOG_COLOR_NONE))))
+
+#define log_fixed(value, fracBits, nDecimals, ...)  _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_fixed((value), (fracBits), (nDecimals) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                              _log_fixed((value), (fracBits), (nDecimals), _LOG_COLOR(LOG_COLOR_NONE))))
+
+#define log_float(number, nDecimals, ...)   _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_float((number), (nDecimals) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                          _log_float((number), (nDecimals), _LOG_COLOR(LOG_COLOR_NONE))))
+
+#define log_hexdump(ptr, length, ...)   _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_hexdump((ptr), (length) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                      _log_hexdump((ptr), (length), _LOG_COLOR(LOG_COLOR_NONE))))
+
+#if LOG_COPY_ARENA_SIZE
+#define log_hexdump_copy(ptr, length, ...)  _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_hexdump_copy((ptr), (length) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                          _log_hexdump_copy((ptr), (length), _LOG_COLOR(LOG_COLOR_NONE))))
+#endif
+
+// Without records the buffer is handed back at once, so the caller can rely on its release
+#if LOG_BUFFER_REFS
+#define log_buffer_ref(ptr, length, format, release, ctx, ...)                                              \
+    _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_buffer_ref((ptr), (length), (format), (release), (ctx) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                  _log_buffer_ref((ptr), (length), (format), (release), (ctx), _LOG_COLOR(LOG_COLOR_NONE))))
+#else
+#define log_buffer_ref(ptr, length, format, release, ctx, ...) ((void)sizeof(ptr), (void)sizeof(length), (release) ? (release)(ctx) : (void)0)
+#endif
+
+#define log_fmt(...)                _LOG_CALL(_log_fmt((const log_fmt_arg_t[]){ _LOG_FMT_ARGS(__VA_ARGS__) },  \
+                                                       _LOG_NARGS(__VA_ARGS__), _LOG_COLOR(LOG_COLOR_NONE)))
+
+#define log_fmt_color(color, ...)   _LOG_CALL(_log_fmt((const log_fmt_arg_t[]){ _LOG_FMT_ARGS(__VA_ARGS__) },  \
+                                                       _LOG_NARGS(__VA_ARGS__), _LOG_COLOR(color)))
+
+#define log_kv(...)                 _LOG_CALL(_log_kv((const log_fmt_arg_t[]){ _LOG_KV_ARGS(__VA_ARGS__) },    \
+                                                      _LOG_NARGS(__VA_ARGS__) / 2, _LOG_COLOR(LOG_COLOR_NONE)))
+
+#define log_begin(pLine, ...)       GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_begin((pLine) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                        _log_begin((pLine), _LOG_COLOR(LOG_COLOR_NONE)))
+
+#define log_add(pLine, x)           _log_add((pLine), _LOG_FMT_ARG(x))
+
+#define log_end(pLine)              _LOG_CALL(_log_end(pLine))
+
+#define log_ctx_str(pCtx, str, ...) _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_ctx_str((pCtx), (str), _LOG_STRLEN(str) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                  _log_ctx_str((pCtx), (str), _LOG_STRLEN(str), _LOG_COLOR(LOG_COLOR_NONE))))
+#define log_ctx_char(pCtx, chr, ...)    _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_ctx_char((pCtx), (chr) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                      _log_ctx_char((pCtx), (chr), _LOG_COLOR(LOG_COLOR_NONE))))
+#define log_ctx_dec(pCtx, number, ...)  _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_ctx_var((pCtx), (uint32_t)(number), _LOG_DEC_TYPE(number) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                      _log_ctx_var((pCtx), (uint32_t)(number), _LOG_DEC_TYPE(number), _LOG_COLOR(LOG_COLOR_NONE))))
+#define log_ctx_hex(pCtx, number, ...)  _LOG_CALL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) _log_ctx_var((pCtx), (uint32_t)(number), _LOG_HEX_TYPE(number) __VA_OPT__(,) _LOG_COLOR(__VA_ARGS__)), \
+                                                                                      _log_ctx_var((pCtx), (uint32_t)(number), _LOG_HEX_TYPE(number), _LOG_COLOR(LOG_COLOR_NONE))))
+#else
+// The logs of this file are disabled, their arguments are only used in sizeof so they are not evaluated
+// and no literal is kept
+#define log_str(str, ...)           ((void)sizeof(str))
+#define log_char(chr, ...)          ((void)sizeof(chr))
+#define log_chars(str, ...)         ((void)sizeof(str))
+#define log_eol(...)                ((void)0)
+#define log_enum(value, names, ...) ((void)sizeof(value), (void)sizeof(names))
+#define LOG_HERE()                  ((void)0)
+#define log_assert(cond)            ((void)sizeof(cond))
+#define log_reg(value, desc, ...)   ((void)sizeof(value))
+#define log_custom(typeId, ptr, size, ...)  ((void)sizeof(ptr), (void)sizeof(size))
+#define log_printf(fmt, ...)        ((void)sizeof((const uintptr_t[]){ (uintptr_t)("" fmt) __VA_OPT__(, _LOG_PRINTF_ARGS(__VA_ARGS__)) }))
+#define log_dec(number, ...)        ((void)sizeof(number))
+#define log_hex(number, ...)        ((void)sizeof(number))
+#define log_ref(ptr, ...)           ((void)sizeof(ptr))
+#define log_ref_hex(ptr, ...)       ((void)sizeof(ptr))
+#define log_array_dec(array, nItems, ...)   ((void)sizeof(array), (void)sizeof(nItems))
+#define log_array_hex(array, nItems, ...)   ((void)sizeof(array), (void)sizeof(nItems))
+#define log_array_dec_stride(array, nItems, stride, ...)    ((void)sizeof(array), (void)sizeof(nItems), (void)sizeof(stride))
+#define log_array_hex_stride(array, nItems, stride, ...)    ((void)sizeof(array), (void)sizeof(nItems), (void)sizeof(stride))
+#define log_strcpy(str, ...)        ((void)sizeof(str))
+#define log_array_dec_copy(array, nItems, ...)  ((void)sizeof(array), (void)sizeof(nItems))
+#define log_array_hex_copy(array, nItems, ...)  ((void)sizeof(array), (void)sizeof(nItems))
+#define log_fixed(value, fracBits, nDecimals, ...)  ((void)sizeof(value), (void)sizeof(fracBits), (void)sizeof(nDecimals))
+#define log_float(number, nDecimals, ...)   ((void)sizeof(number), (void)sizeof(nDecimals))
+#define log_hexdump(ptr, length, ...)   ((void)sizeof(ptr), (void)sizeof(length))
+#define log_hexdump_copy(ptr, length, ...)  ((void)sizeof(ptr), (void)sizeof(length))
+#define log_buffer_ref(ptr, length, format, release, ctx, ...) ((void)sizeof(ptr), (void)sizeof(length), (release) ? (release)(ctx) : (void)0)
+#define log_fmt(...)                ((void)sizeof((const log_fmt_arg_t[]){ _LOG_FMT_ARGS(__VA_ARGS__) }))
+#define log_fmt_color(color, ...)   ((void)sizeof(color), (void)sizeof((const log_fmt_arg_t[]){ _LOG_FMT_ARGS(__VA_ARGS__) }))
+#define log_kv(...)                 ((void)sizeof((const log_fmt_arg_t[]){ _LOG_FMT_ARGS(__VA_ARGS__) }))
+#define log_begin(pLine, ...)       ((void)sizeof(pLine))
+#define log_add(pLine, x)           ((void)sizeof(pLine), (void)sizeof(x))
+#define log_end(pLine)              ((void)sizeof(pLine))
+#define log_ctx_str(pCtx, str, ...)     ((void)sizeof(pCtx), (void)sizeof(str))
+#define log_ctx_char(pCtx, chr, ...)    ((void)sizeof(pCtx), (void)sizeof(chr))
+#define log_ctx_dec(pCtx, number, ...)  ((void)sizeof(pCtx), (void)sizeof(number))
+#define log_ctx_hex(pCtx, number, ...)  ((void)sizeof(pCtx), (void)sizeof(number))
+#endif
+
+// Logs of LOG_LEVEL_ERROR whatever the LOG_FILE_LEVEL of the file, for the error paths of files that
+// log at other levels: the item carries the level of the call for the reserve, the error FIFO and
+// the backends
+#define _LOG_ERR_COLOR(...)         _LOG_COLOR_LEVEL(GET_MACRO(__VA_ARGS__ __VA_OPT__(,) __VA_ARGS__, LOG_COLOR_NONE), LOG_LEVEL_ERROR)
+#if LOG_LEVEL_ENABLED(LOG_LEVEL_ERROR)
+#define log_err_str(str, ...)       _LOG_CALL_LEVEL(LOG_LEVEL_ERROR, _log_str(_LOG_STR(str), _LOG_STRLEN(str), _LOG_ERR_COLOR(__VA_ARGS__)))
+#define log_err_char(chr, ...)      _LOG_CALL_LEVEL(LOG_LEVEL_ERROR, _log_char((chr), _LOG_ERR_COLOR(__VA_ARGS__)))
+#define log_err_dec(number, ...)    _LOG_CALL_LEVEL(LOG_LEVEL_ERROR, _log_dec((number), _LOG_ERR_COLOR(__VA_ARGS__)))
+#define log_err_hex(number, ...)    _LOG_CALL_LEVEL(LOG_LEVEL_ERROR, _log_hex((number), _LOG_ERR_COLOR(__VA_ARGS__)))
+#define log_err_strcpy(str, ...)    _LOG_CALL_LEVEL(LOG_LEVEL_ERROR, _log_strcpy((str), strlen(str), _LOG_ERR_COLOR(__VA_ARGS__)))
+#define log_err_fmt(...)            _LOG_CALL_LEVEL(LOG_LEVEL_ERROR, _log_fmt((const log_fmt_arg_t[]){ _LOG_FMT_ARGS(__VA_ARGS__) }, \
+                                                                      _LOG_NARGS(__VA_ARGS__), _LOG_ERR_COLOR()))
+#else
+#define log_err_str(str, ...)       ((void)sizeof(str))
+#define log_err_char(chr, ...)      ((void)sizeof(chr))
+#define log_err_dec(number, ...)    ((void)sizeof(number))
+#define log_err_hex(number, ...)    ((void)sizeof(number))
+#define log_err_strcpy(str, ...)    ((void)sizeof(str))
+#define log_err_fmt(...)            ((void)sizeof((const log_fmt_arg_t[]){ _LOG_FMT_ARGS(__VA_ARGS__) }))
+#endif
+
+
+
+#define _LOG_DEC_TYPES                                          \
+                                    unsigned char:  _LOG_UINT_DEC,  \
+                                    unsigned short: _LOG_UINT_DEC,  \
+                                    unsigned long:  _LOG_UINT_DEC,  \
+                                    unsigned int:   _LOG_UINT_DEC,  \
+                                    char:           _LOG_INT_DEC_1, \
+                                    signed char:    _LOG_INT_DEC_1, \
+                                    signed short:   _LOG_INT_DEC_2, \
+                                    signed long:    _LOG_INT_DEC_4, \
+                                    signed int:     _LOG_INT_DEC_4
+
+#define _LOG_DEC_TYPE(x)        _Generic((x), _LOG_DEC_TYPES)
+
+
+#define _LOG_HEX_TYPES                                          \
+                                    unsigned char:  _LOG_HEX_1,     \
+                                    unsigned short: _LOG_HEX_2,     \
+                                    unsigned long:  _LOG_HEX_4,     \
+                                    unsigned int:   _LOG_HEX_4,     \
+                                    char:           _LOG_HEX_1,     \
+                                    signed char:    _LOG_HEX_1,     \
+                                    signed short:   _LOG_HEX_2,     \
+                                    signed long:    _LOG_HEX_4,     \
+                                    signed int:     _LOG_HEX_4
+
+#define _LOG_HEX_TYPE(x)        _Generic((x), _LOG_HEX_TYPES)
+
+
+#if LOG_INLINE_PRODUCERS
+#define _LOG_VAR                _log_var_inline     // From log_fifo.h
+#else
+#define _LOG_VAR                _log_var
+#endif
+
+
+#if LOG_64BIT_NUMBERS
+// Only single numbers accept 64 bit types, they are stored whole in a single item
+#define _log_dec_var(number, color) _Generic((number),                                  \
+                                    unsigned long long: _log_var64,                     \
+                                    signed long long:   _log_var64,                     \
+                                    default:            _LOG_VAR)((number),             \
+                                _Generic((number), _LOG_DEC_TYPES,                      \
+                                    unsigned long long: _LOG_UINT_DEC_8,                \
+                                    signed long long:   _LOG_INT_DEC_8), (color))
+
+#define _log_hex_var(number, color) _Generic((number),                                  \
+                                    unsigned long long: _log_var64,                     \
+                                    signed long long:   _log_var64,                     \
+                                    default:            _LOG_VAR)((number),             \
+                                _Generic((number), _LOG_HEX_TYPES,                      \
+                                    unsigned long long: _LOG_HEX_8,                     \
+                                    signed long long:   _LOG_HEX_8), (color))
+
+#define _LOG_REF_DEC_TYPE(x)        _Generic((x), _LOG_DEC_TYPES,                       \
+                                    unsigned long long: _LOG_UINT_DEC_8,                \
+                                    signed long long:   _LOG_INT_DEC_8)
+
+#define _LOG_REF_HEX_TYPE(x)        _Generic((x), _LOG_HEX_TYPES,                       \
+                                    unsigned long long: _LOG_HEX_8,                     \
+                                    signed long long:   _LOG_HEX_8)
+#else
+#define _log_dec_var(number, color) _LOG_VAR((uint32_t)(number), _LOG_DEC_TYPE(number), (color))
+
+#define _log_hex_var(number, color) _LOG_VAR((uint32_t)(number), _LOG_HEX_TYPE(number), (color))
+
+#define _LOG_REF_DEC_TYPE(x)        _LOG_DEC_TYPE(x)
+#define _LOG_REF_HEX_TYPE(x)        _LOG_HEX_TYPE(x)
+#endif
+
+#if LOG_CONST_NUMBERS
+// The characters of a constant are computed in the word stored as chr[] of the item, first one in
+// the low byte. Checks are constant too, so only one branch is kept.
+#define _LOG_CONST_POW10(k)         ((k) == 0 ? 1U : (k) == 1 ? 10U : (k) == 2 ? 100U : 1000U)
+#define _LOG_CONST_DEC_N(n)         ((n) < 10 ? 1U : (n) < 100 ? 2U : (n) < 1000 ? 3U : 4U)
+#define _LOG_CONST_DEC_CHAR(n, i)   (_LOG_CONST_DEC_N(n) > (i) ?                                             \
+                                     ('0' + ((n) / _LOG_CONST_POW10(_LOG_CONST_DEC_N(n) - 1 - (i))) % 10) << (8 * (i)) : 0)
+#define _LOG_CONST_DEC(n)           (_LOG_CONST_DEC_CHAR(n, 0) | _LOG_CONST_DEC_CHAR(n, 1) |                 \
+                                     _LOG_CONST_DEC_CHAR(n, 2) | _LOG_CONST_DEC_CHAR(n, 3))
+
+#define _LOG_CONST_HEX_N(x)         _Generic((x), unsigned char: 2U, signed char: 2U, char: 2U,              \
+                                              unsigned short: 4U, signed short: 4U, default: 0U)
+#define _LOG_CONST_NIBBLE(c)        ((c) < 10 ? '0' + (c) : 'A' - 10 + (c))
+#define _LOG_CONST_HEX_CHAR(n, nDigits, i)  ((nDigits) > (i) ?                                              \
+                                     _LOG_CONST_NIBBLE(((n) >> (4 * ((nDigits) - 1 - (i)))) & 0x0F) << (8 * (i)) : 0)
+#define _LOG_CONST_HEX(n, nDigits)  (_LOG_CONST_HEX_CHAR(n, nDigits, 0) | _LOG_CONST_HEX_CHAR(n, nDigits, 1) | \
+                                     _LOG_CONST_HEX_CHAR(n, nDigits, 2) | _LOG_CONST_HEX_CHAR(n, nDigits, 3))
+
+#define _log_dec(number, color)     (__builtin_constant_p(number) && (uint64_t)(number) < 10000 ?             \
+                                     _log_chars_word(_LOG_CONST_DEC((uint32_t)(number)),                       \
+                                                     _LOG_CONST_DEC_N((uint32_t)(number)), (color)) :          \
+                                     _log_dec_var((number), (color)))
+
+#define _log_hex(number, color)     (__builtin_constant_p(number) && _LOG_CONST_HEX_N(number) ?               \
+                                     _log_chars_word(_LOG_CONST_HEX((uint32_t)(number), _LOG_CONST_HEX_N(number)), \
+                                                     _LOG_CONST_HEX_N(number), (color)) :                      \
+                                     _log_hex_var((number), (color)))
+#else
+#define _log_dec(number, color)     _log_dec_var((number), (color))
+#define _log_hex(number, color)     _log_hex_var((number), (color))
+#endif
+
+
+#define _LOG_FIXED_UNSIGNED     0x80    // Flag of the fraction bits of unsigned fixed point values
+
+// Values are sign extended to 32 bits unless their type is unsigned
+#define _log_fixed(value, fracBits, nDecimals, color)   _log_real((uint32_t)(value), _LOG_FIXED, (fracBits) |       \
+                                                            (_LOG_DEC_TYPE(value) == _LOG_UINT_DEC ? _LOG_FIXED_UNSIGNED : 0), \
+                                                            (nDecimals), (color))
+
+#define _log_float(number, nDecimals, color)    _log_real(_log_float_bits(number), _LOG_FLOAT, 0, (nDecimals), (color))
+
+// Raw IEEE 754 bits of the number, which is only decoded by the log thread
+static inline uint32_t _log_float_bits(float number)
+{
+    uint32_t bits;
+
+    memcpy(&bits, &number, sizeof(bits));
+    return bits;
+}
+
+
+// Field of a register, printed as name=value by log_reg()
+typedef struct log_reg_field_s
+{
+    const char          *name;
+    uint8_t              offset;        // Position of the lowest bit
+    uint8_t              width;         // Bits
+} log_reg_field_t;
+
+typedef struct log_reg_desc_s
+{
+    const char              *name;      // Printed before the fields, NULL for none
+    const log_reg_field_t   *pFields;
+    uint32_t                 nFields;
+} log_reg_desc_t;
+
+// Defines the descriptor desc of a register from its name and {"field", offset, width} fields, for
+// example LOG_REG_DESC(usartIsr, "ISR", {"TXE", 7, 1}, {"TC", 6, 1}). It is placed in the .log_regs
+// section, so log_reg() records only carry its offset there.
+#if LOG_REGS
+#define LOG_REG_DESC(desc, regName, ...)                                                                \
+    static const log_reg_field_t _logRegFields_##desc[] = { __VA_ARGS__ };                              \
+    static const log_reg_desc_t desc __attribute__((section(".log_regs"), used, aligned(4))) =          \
+        { (regName), _logRegFields_##desc, sizeof(_logRegFields_##desc) / sizeof(_logRegFields_##desc[0]) }
+#else
+#define LOG_REG_DESC(desc, regName, ...)    extern const log_reg_desc_t desc
+#endif
+
+
+// Formatter of a log_custom() type, called by the logger thread with the copied bytes. It writes its
+// text with put(), which can be called several times.
+typedef void (*log_type_put_t)(const char *str, uint32_t length);
+typedef void (*log_type_format_t)(const void *pData, uint32_t size, log_type_put_t put);
+
+
+#define _log_array_dec(array, nItems, color)    _log_array((uint32_t*)(array), (nItems), sizeof((array)[0]), \
+                                                            _LOG_DEC_TYPE((array)[0]), (color))
 
 #define _log_array_hex(array, nItems, color)    _log_array((uint32_t*)(array), (nItems), sizeof((array)[0]), \
-                                                            _Generic((array)[0],         \
-                                                            unsigned char:  _LOG_HEX_1,  \
-                                                            unsigned short: _LOG_HEX_2,  \
-                                                            unsigned long:  _LOG_HEX_4,  \
-                                                            unsigned int:   _LOG_HEX_4,  \
-                                                            char:           _LOG_HEX_1,  \
-                                                            signed char:    _LOG_HEX_1,  \
-                                                            signed short:   _LOG_HEX_2,  \
-                                                            signed long:    _LOG_HEX_4,  \
-                                                            signed int:     _LOG_HEX_4), (color))
+                                                            _LOG_HEX_TYPE((array)[0]), (color))
+
+// array points to the first element, the type of the elements gives their size and format
+#define _log_array_dec_stride(array, nItems, stride, color) _log_array_stride((array), (nItems), (stride), sizeof((array)[0]), \
+                                                                          _LOG_DEC_TYPE((array)[0]), (color))
+
+#define _log_array_hex_stride(array, nItems, stride, color) _log_array_stride((array), (nItems), (stride), sizeof((array)[0]), \
+                                                                          _LOG_HEX_TYPE((array)[0]), (color))
+
+#define _log_array_dec_copy(array, nItems, color)   _log_array_copy((array), (nItems), sizeof((array)[0]), \
+                                                                _LOG_DEC_TYPE((array)[0]), (color))
+
+#define _log_array_hex_copy(array, nItems, color)   _log_array_copy((array), (nItems), sizeof((array)[0]), \
+                                                                _LOG_HEX_TYPE((array)[0]), (color))
+
+
+// Arguments of log_fmt(), all of them are stored in the input FIFO at once
+typedef struct log_fmt_arg_s
+{
+    const char          *str;
+    uint32_t             number;        // Value, or length of str
+    enum log_data_type   type;
+} log_fmt_arg_t;
+
+typedef struct log_fmt_hex_s
+{
+    uint32_t             number;
+    enum log_data_type   type;
+} log_fmt_hex_t;
+
+// Marks a log_fmt() argument to be printed in hexadecimal
+#define log_fmt_hex(number)     ((log_fmt_hex_t){ (uint32_t)(number), _LOG_HEX_TYPE(number) })
+
+// Initialized in order without compound literals, so log.h also compiles cleanly in C++
+static inline log_fmt_arg_t _log_fmt_arg_str(const char *str, enum log_data_type type)
+{
+    log_fmt_arg_t arg = { str, (uint32_t)strlen(str), type };
+
+    return arg;
+}
+
+static inline log_fmt_arg_t _log_fmt_arg_hex(log_fmt_hex_t hex, enum log_data_type type)
+{
+    log_fmt_arg_t arg = { NULL, hex.number, hex.type };
+
+    (void)type;
+    return arg;
+}
+
+static inline log_fmt_arg_t _log_fmt_arg_dec(uint32_t number, enum log_data_type type)
+{
+    log_fmt_arg_t arg = { NULL, number, type };
+
+    return arg;
+}
+
+// Same as _LOG_DEC_TYPE(), but it must also accept the types that are not numbers
+#define _LOG_FMT_TYPE(x)        _Generic((x),                   \
+                                    char*:          _LOG_STRING,    \
+                                    const char*:    _LOG_STRING,    \
+                                    char:           _LOG_INT_DEC_1, \
+                                    signed char:    _LOG_INT_DEC_1, \
+                                    signed short:   _LOG_INT_DEC_2, \
+                                    signed long:    _LOG_INT_DEC_4, \
+                                    signed int:     _LOG_INT_DEC_4, \
+                                    default:        _LOG_UINT_DEC)
+
+#define _LOG_FMT_ARG(x)         _Generic((x),                   \
+                                    char*:          _log_fmt_arg_str, \
+                                    const char*:    _log_fmt_arg_str, \
+                                    log_fmt_hex_t:  _log_fmt_arg_hex, \
+                                    default:        _log_fmt_arg_dec)((x), _LOG_FMT_TYPE(x))
+
+// Number of arguments of log_fmt(), up to 16
+#define _LOG_NARGS(...)         _LOG_NARGS_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define _LOG_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+
+#define _LOG_CONCAT(a, b)       _LOG_CONCAT_(a, b)
+#define _LOG_CONCAT_(a, b)      a ## b
+
+#define _LOG_FMT_ARGS(...)      _LOG_CONCAT(_LOG_FMT_, _LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define _LOG_FMT_1(x)           _LOG_FMT_ARG(x)
+#define _LOG_FMT_2(x, ...)      _LOG_FMT_ARG(x), _LOG_FMT_1(__VA_ARGS__)
+#define _LOG_FMT_3(x, ...)      _LOG_FMT_ARG(x), _LOG_FMT_2(__VA_ARGS__)
+#define _LOG_FMT_4(x, ...)      _LOG_FMT_ARG(x), _LOG_FMT_3(__VA_ARGS__)
+#define _LOG_FMT_5(x, ...)      _LOG_FMT_ARG(x), _LOG_FMT_4(__VA_ARGS__)
+#define _LOG_FMT_6(x, ...)      _LOG_FMT_ARG(x), _LOG_FMT_5(__VA_ARGS__)
+#define _LOG_FMT_7(x, ...)      _LOG_FMT_ARG(x), _LOG_FMT_6(__VA_ARGS__)
+#define _LOG_FMT_8(x, ...)      _LOG_FMT_ARG(x), _LOG_FMT_7(__VA_ARGS__)
+#define _LOG_FMT_9(x, ...)      _LOG_FMT_ARG(x), _LOG_FMT_8(__VA_ARGS__)
+#define _LOG_FMT_10(x, ...)     _LOG_FMT_ARG(x), _LOG_FMT_9(__VA_ARGS__)
+#define _LOG_FMT_11(x, ...)     _LOG_FMT_ARG(x), _LOG_FMT_10(__VA_ARGS__)
+#define _LOG_FMT_12(x, ...)     _LOG_FMT_ARG(x), _LOG_FMT_11(__VA_ARGS__)
+#define _LOG_FMT_13(x, ...)     _LOG_FMT_ARG(x), _LOG_FMT_12(__VA_ARGS__)
+#define _LOG_FMT_14(x, ...)     _LOG_FMT_ARG(x), _LOG_FMT_13(__VA_ARGS__)
+#define _LOG_FMT_15(x, ...)     _LOG_FMT_ARG(x), _LOG_FMT_14(__VA_ARGS__)
+#define _LOG_FMT_16(x, ...)     _LOG_FMT_ARG(x), _LOG_FMT_15(__VA_ARGS__)
+
+// Words of the log_printf() arguments, up to 16: strings and pointers are passed as they are, floats
+// and doubles as their single precision bits and integers on 32 bits. Other pointers need a void* cast.
+static inline uintptr_t _log_printf_ptr(const void *ptr)
+{
+    return (uintptr_t)ptr;
+}
+
+static inline uintptr_t _log_printf_float(double number)
+{
+    return _log_float_bits((float)number);
+}
+
+static inline uintptr_t _log_printf_word(uint32_t word)
+{
+    return word;
+}
+
+#define _LOG_PRINTF_ARG(x)      _Generic((x),                   \
+                                    char*:          _log_printf_ptr,   \
+                                    const char*:    _log_printf_ptr,   \
+                                    void*:          _log_printf_ptr,   \
+                                    const void*:    _log_printf_ptr,   \
+                                    float:          _log_printf_float, \
+                                    double:         _log_printf_float, \
+                                    default:        _log_printf_word)(x)
+
+#define _LOG_PRINTF_ARGS(...)   _LOG_CONCAT(_LOG_PRINTF_, _LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define _LOG_PRINTF_1(x)        _LOG_PRINTF_ARG(x)
+#define _LOG_PRINTF_2(x, ...)   _LOG_PRINTF_ARG(x), _LOG_PRINTF_1(__VA_ARGS__)
+#define _LOG_PRINTF_3(x, ...)   _LOG_PRINTF_ARG(x), _LOG_PRINTF_2(__VA_ARGS__)
+#define _LOG_PRINTF_4(x, ...)   _LOG_PRINTF_ARG(x), _LOG_PRINTF_3(__VA_ARGS__)
+#define _LOG_PRINTF_5(x, ...)   _LOG_PRINTF_ARG(x), _LOG_PRINTF_4(__VA_ARGS__)
+#define _LOG_PRINTF_6(x, ...)   _LOG_PRINTF_ARG(x), _LOG_PRINTF_5(__VA_ARGS__)
+#define _LOG_PRINTF_7(x, ...)   _LOG_PRINTF_ARG(x), _LOG_PRINTF_6(__VA_ARGS__)
+#define _LOG_PRINTF_8(x, ...)   _LOG_PRINTF_ARG(x), _LOG_PRINTF_7(__VA_ARGS__)
+#define _LOG_PRINTF_9(x, ...)   _LOG_PRINTF_ARG(x), _LOG_PRINTF_8(__VA_ARGS__)
+#define _LOG_PRINTF_10(x, ...)  _LOG_PRINTF_ARG(x), _LOG_PRINTF_9(__VA_ARGS__)
+#define _LOG_PRINTF_11(x, ...)  _LOG_PRINTF_ARG(x), _LOG_PRINTF_10(__VA_ARGS__)
+#define _LOG_PRINTF_12(x, ...)  _LOG_PRINTF_ARG(x), _LOG_PRINTF_11(__VA_ARGS__)
+#define _LOG_PRINTF_13(x, ...)  _LOG_PRINTF_ARG(x), _LOG_PRINTF_12(__VA_ARGS__)
+#define _LOG_PRINTF_14(x, ...)  _LOG_PRINTF_ARG(x), _LOG_PRINTF_13(__VA_ARGS__)
+#define _LOG_PRINTF_15(x, ...)  _LOG_PRINTF_ARG(x), _LOG_PRINTF_14(__VA_ARGS__)
+#define _LOG_PRINTF_16(x, ...)  _LOG_PRINTF_ARG(x), _LOG_PRINTF_15(__VA_ARGS__)
+
+// Keys and values of log_kv(), up to 8 pairs. Keys are literals, interned with LOG_INTERN_STRINGS, and
+// an odd number of arguments does not compile.
+#define _LOG_KV_ARGS(...)       _LOG_CONCAT(_LOG_KV_, _LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define _LOG_KV_PAIR(key, x)    _log_fmt_arg_str(_LOG_STR(key), _LOG_STRING), _LOG_FMT_ARG(x)
+#define _LOG_KV_2(key, x)       _LOG_KV_PAIR(key, x)
+#define _LOG_KV_4(key, x, ...)  _LOG_KV_PAIR(key, x), _LOG_KV_2(__VA_ARGS__)
+#define _LOG_KV_6(key, x, ...)  _LOG_KV_PAIR(key, x), _LOG_KV_4(__VA_ARGS__)
+#define _LOG_KV_8(key, x, ...)  _LOG_KV_PAIR(key, x), _LOG_KV_6(__VA_ARGS__)
+#define _LOG_KV_10(key, x, ...) _LOG_KV_PAIR(key, x), _LOG_KV_8(__VA_ARGS__)
+#define _LOG_KV_12(key, x, ...) _LOG_KV_PAIR(key, x), _LOG_KV_10(__VA_ARGS__)
+#define _LOG_KV_14(key, x, ...) _LOG_KV_PAIR(key, x), _LOG_KV_12(__VA_ARGS__)
+#define _LOG_KV_16(key, x, ...) _LOG_KV_PAIR(key, x), _LOG_KV_14(__VA_ARGS__)
+
+
+// Formats the arguments of log_fmt() into pBuf instead of logging them, whatever the log level
+#define log_fmt_into(pBuf, size, ...)   log_format_args((pBuf), (size), (const log_fmt_arg_t[]){ _LOG_FMT_ARGS(__VA_ARGS__) }, \
+                                                        _LOG_NARGS(__VA_ARGS__))
+
+#define LOG_FORMAT_MAX          24      // Longest number of the log_format functions, sign and decimals included
+
+
+// String literals of log_line() without the commas, so the compiler joins them into a single one
+#define log_line(...)               log_str(_LOG_LITERALS(__VA_ARGS__))
+#define log_line_color(color, ...)  log_str(_LOG_LITERALS(__VA_ARGS__), color)
+
+#define _LOG_LITERALS(...)      _LOG_CONCAT(_LOG_LIT_, _LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define _LOG_LIT_1(x)           x
+#define _LOG_LIT_2(x, ...)      x _LOG_LIT_1(__VA_ARGS__)
+#define _LOG_LIT_3(x, ...)      x _LOG_LIT_2(__VA_ARGS__)
+#define _LOG_LIT_4(x, ...)      x _LOG_LIT_3(__VA_ARGS__)
+#define _LOG_LIT_5(x, ...)      x _LOG_LIT_4(__VA_ARGS__)
+#define _LOG_LIT_6(x, ...)      x _LOG_LIT_5(__VA_ARGS__)
+#define _LOG_LIT_7(x, ...)      x _LOG_LIT_6(__VA_ARGS__)
+#define _LOG_LIT_8(x, ...)      x _LOG_LIT_7(__VA_ARGS__)
+#define _LOG_LIT_9(x, ...)      x _LOG_LIT_8(__VA_ARGS__)
+#define _LOG_LIT_10(x, ...)     x _LOG_LIT_9(__VA_ARGS__)
+#define _LOG_LIT_11(x, ...)     x _LOG_LIT_10(__VA_ARGS__)
+#define _LOG_LIT_12(x, ...)     x _LOG_LIT_11(__VA_ARGS__)
+#define _LOG_LIT_13(x, ...)     x _LOG_LIT_12(__VA_ARGS__)
+#define _LOG_LIT_14(x, ...)     x _LOG_LIT_13(__VA_ARGS__)
+#define _LOG_LIT_15(x, ...)     x _LOG_LIT_14(__VA_ARGS__)
+#define _LOG_LIT_16(x, ...)     x _LOG_LIT_15(__VA_ARGS__)
+
+
+// Tokens of a log_begin()/log_end() line, kept by the caller until log_end()
+typedef struct log_line_s
+{
+    log_fmt_arg_t        args[LOG_LINE_N_ARGS];
+    uint32_t             nArgs;
+    enum log_color       color;
+} log_line_t;
+
+static inline void _log_begin(log_line_t *pLine, enum log_color color)
+{
+    pLine->nArgs = 0;
+    pLine->color = color;
+}
+
+static inline void _log_add(log_line_t *pLine, log_fmt_arg_t arg)
+{
+    if(pLine->nArgs < LOG_LINE_N_ARGS)
+        pLine->args[pLine->nArgs++] = arg;
+}
+
+#define _log_end(pLine)         ((pLine)->nArgs ? _log_fmt((pLine)->args, (pLine)->nArgs, (pLine)->color) : (void)0)
 
 
 #define log_flush()     _log_flush(true)
 
 
+// Window of a log_*_ratelimited() call site
+typedef struct log_ratelimit_s
+{
+    uint32_t             start;                 // LOG_RATELIMIT_MS_GET() when the window started
+    uint32_t             nCalls;                // Calls stored in it
+#if LOG_STATS
+    uint32_t             nSuppressed;           // Not yet added to the stats
+#endif
+} log_ratelimit_t;
+
+bool _log_ratelimit_restart(log_ratelimit_t *pWindow);
+
+static inline bool _log_ratelimit(log_ratelimit_t *pWindow, uint32_t ms, uint32_t burst)
+{
+    if(pWindow->nCalls < burst)
+    {
+        if(!pWindow->nCalls)            // The first window starts at the first call, not at 0
+            pWindow->start = LOG_RATELIMIT_MS_GET();
+        pWindow->nCalls++;
+        return true;
+    }
+    if(!burst || LOG_RATELIMIT_MS_GET() - pWindow->start < ms)
+    {
+#if LOG_STATS
+        pWindow->nSuppressed++;
+#endif
+        return false;
+    }
+    return _log_ratelimit_restart(pWindow);
+}
+
+
+#define _LOG_RATELIMITED(logc, ms, burst, ...)  do{ static log_ratelimit_t _logWindow;                              \
+                                                    logc(_log_ratelimit(&_logWindow, (ms), (burst)), __VA_ARGS__); } while(0)
+#define log_str_ratelimited(ms, burst, ...)             _LOG_RATELIMITED(logc_str, ms, burst, __VA_ARGS__)
+#define log_char_ratelimited(ms, burst, ...)            _LOG_RATELIMITED(logc_char, ms, burst, __VA_ARGS__)
+#define log_dec_ratelimited(ms, burst, ...)             _LOG_RATELIMITED(logc_dec, ms, burst, __VA_ARGS__)
+#define log_hex_ratelimited(ms, burst, ...)             _LOG_RATELIMITED(logc_hex, ms, burst, __VA_ARGS__)
+#define log_array_dec_ratelimited(ms, burst, ...)       _LOG_RATELIMITED(logc_array_dec, ms, burst, __VA_ARGS__)
+#define log_array_hex_ratelimited(ms, burst, ...)       _LOG_RATELIMITED(logc_array_hex, ms, burst, __VA_ARGS__)
+#define log_fixed_ratelimited(ms, burst, ...)           _LOG_RATELIMITED(logc_fixed, ms, burst, __VA_ARGS__)
+#define log_float_ratelimited(ms, burst, ...)           _LOG_RATELIMITED(logc_float, ms, burst, __VA_ARGS__)
+#define log_strcpy_ratelimited(ms, burst, ...)          _LOG_RATELIMITED(logc_strcpy, ms, burst, __VA_ARGS__)
+#define log_array_dec_copy_ratelimited(ms, burst, ...)  _LOG_RATELIMITED(logc_array_dec_copy, ms, burst, __VA_ARGS__)
+#define log_array_hex_copy_ratelimited(ms, burst, ...)  _LOG_RATELIMITED(logc_array_hex_copy, ms, burst, __VA_ARGS__)
+#define log_hexdump_ratelimited(ms, burst, ...)         _LOG_RATELIMITED(logc_hexdump, ms, burst, __VA_ARGS__)
+#define log_hexdump_copy_ratelimited(ms, burst, ...)    _LOG_RATELIMITED(logc_hexdump_copy, ms, burst, __VA_ARGS__)
+#define log_fmt_ratelimited(ms, burst, ...)             _LOG_RATELIMITED(logc_fmt, ms, burst, __VA_ARGS__)
+
+
+// Per site counter of the log_*_every() macros, the first call is stored
+static inline bool _log_every(uint32_t *pCount, uint32_t n)
+{
+    bool isStored = (*pCount == 0);
+
+    if(++*pCount >= n)
+        *pCount = 0;
+    return isStored;
+}
+
+// xorshift32 state of the log_*_sample() macros, the races between contexts only repeat a value
+extern uint32_t _logSampleState;
+
+static inline bool _log_sample(uint32_t threshold)
+{
+    uint32_t x = _logSampleState;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    _logSampleState = x;
+    return (x >> 16) < threshold;
+}
+
+
+#define _LOG_EVERY(logc, n, ...)                do{ static uint32_t _logCount;                                      \
+                                                    logc(_log_every(&_logCount, (n)), __VA_ARGS__); } while(0)
+#define log_str_every(n, ...)                           _LOG_EVERY(logc_str, n, __VA_ARGS__)
+#define log_char_every(n, ...)                          _LOG_EVERY(logc_char, n, __VA_ARGS__)
+#define log_dec_every(n, ...)                           _LOG_EVERY(logc_dec, n, __VA_ARGS__)
+#define log_hex_every(n, ...)                           _LOG_EVERY(logc_hex, n, __VA_ARGS__)
+#define log_array_dec_every(n, ...)                     _LOG_EVERY(logc_array_dec, n, __VA_ARGS__)
+#define log_array_hex_every(n, ...)                     _LOG_EVERY(logc_array_hex, n, __VA_ARGS__)
+#define log_fixed_every(n, ...)                         _LOG_EVERY(logc_fixed, n, __VA_ARGS__)
+#define log_float_every(n, ...)                         _LOG_EVERY(logc_float, n, __VA_ARGS__)
+#define log_strcpy_every(n, ...)                        _LOG_EVERY(logc_strcpy, n, __VA_ARGS__)
+#define log_array_dec_copy_every(n, ...)                _LOG_EVERY(logc_array_dec_copy, n, __VA_ARGS__)
+#define log_array_hex_copy_every(n, ...)                _LOG_EVERY(logc_array_hex_copy, n, __VA_ARGS__)
+#define log_hexdump_every(n, ...)                       _LOG_EVERY(logc_hexdump, n, __VA_ARGS__)
+#define log_hexdump_copy_every(n, ...)                  _LOG_EVERY(logc_hexdump_copy, n, __VA_ARGS__)
+#define log_fmt_every(n, ...)                           _LOG_EVERY(logc_fmt, n, __VA_ARGS__)
+
+#define _LOG_SAMPLE(logc, percent, ...)         logc(_log_sample((uint32_t)(percent) * 65536 / 100), __VA_ARGS__)
+#define log_str_sample(percent, ...)                    _LOG_SAMPLE(logc_str, percent, __VA_ARGS__)
+#define log_char_sample(percent, ...)                   _LOG_SAMPLE(logc_char, percent, __VA_ARGS__)
+#define log_dec_sample(percent, ...)                    _LOG_SAMPLE(logc_dec, percent, __VA_ARGS__)
+#define log_hex_sample(percent, ...)                    _LOG_SAMPLE(logc_hex, percent, __VA_ARGS__)
+#define log_array_dec_sample(percent, ...)              _LOG_SAMPLE(logc_array_dec, percent, __VA_ARGS__)
+#define log_array_hex_sample(percent, ...)              _LOG_SAMPLE(logc_array_hex, percent, __VA_ARGS__)
+#define log_fixed_sample(percent, ...)                  _LOG_SAMPLE(logc_fixed, percent, __VA_ARGS__)
+#define log_float_sample(percent, ...)                  _LOG_SAMPLE(logc_float, percent, __VA_ARGS__)
+#define log_strcpy_sample(percent, ...)                 _LOG_SAMPLE(logc_strcpy, percent, __VA_ARGS__)
+#define log_array_dec_copy_sample(percent, ...)         _LOG_SAMPLE(logc_array_dec_copy, percent, __VA_ARGS__)
+#define log_array_hex_copy_sample(percent, ...)         _LOG_SAMPLE(logc_array_hex_copy, percent, __VA_ARGS__)
+#define log_hexdump_sample(percent, ...)                _LOG_SAMPLE(logc_hexdump, percent, __VA_ARGS__)
+#define log_hexdump_copy_sample(percent, ...)           _LOG_SAMPLE(logc_hexdump_copy, percent, __VA_ARGS__)
+#define log_fmt_sample(percent, ...)                    _LOG_SAMPLE(logc_fmt, percent, __VA_ARGS__)
+
+#if LOG_ISR_UNMASKED
+extern volatile bool _logFromIsr;               // Set during a log_*_from_isr() call, see LOG_ISR_UNMASKED
+
+#define _LOG_FROM_ISR(logc, ...)                do{ _logFromIsr = true; logc(1, __VA_ARGS__); _logFromIsr = false; } while(0)
+#else
+#define _LOG_FROM_ISR(logc, ...)                logc(1, __VA_ARGS__)
+#endif
+#define log_str_from_isr(...)                   _LOG_FROM_ISR(logc_str, __VA_ARGS__)
+#define log_char_from_isr(...)                  _LOG_FROM_ISR(logc_char, __VA_ARGS__)
+#define log_dec_from_isr(...)                   _LOG_FROM_ISR(logc_dec, __VA_ARGS__)
+#define log_hex_from_isr(...)                   _LOG_FROM_ISR(logc_hex, __VA_ARGS__)
+#define log_array_dec_from_isr(...)             _LOG_FROM_ISR(logc_array_dec, __VA_ARGS__)
+#define log_array_hex_from_isr(...)             _LOG_FROM_ISR(logc_array_hex, __VA_ARGS__)
+#define log_fixed_from_isr(...)                 _LOG_FROM_ISR(logc_fixed, __VA_ARGS__)
+#define log_float_from_isr(...)                 _LOG_FROM_ISR(logc_float, __VA_ARGS__)
+#define log_strcpy_from_isr(...)                _LOG_FROM_ISR(logc_strcpy, __VA_ARGS__)
+#define log_array_dec_copy_from_isr(...)        _LOG_FROM_ISR(logc_array_dec_copy, __VA_ARGS__)
+#define log_array_hex_copy_from_isr(...)        _LOG_FROM_ISR(logc_array_hex_copy, __VA_ARGS__)
+#define log_hexdump_from_isr(...)               _LOG_FROM_ISR(logc_hexdump, __VA_ARGS__)
+#define log_hexdump_copy_from_isr(...)          _LOG_FROM_ISR(logc_hexdump_copy, __VA_ARGS__)
+#define log_fmt_from_isr(...)                   _LOG_FROM_ISR(logc_fmt, __VA_ARGS__)
+
+
 // Suppress syntax error for conditional logs when parsing with IntelliSense or CDT parser
 #if defined(__INTELLISENSE__) || defined(__CDT_PARSER__)
 #define logc_str(cond, string, ...)  0
@@ -280,6 +2236,35 @@ typedef void (*log_out_flush_handler)(void);
 #define logc_char(cond, chr, ...)    0
 #define logc_array_dec(cond, array, nItems, ...)    0
 #define logc_array_hex(cond, array, nItems, ...)    0
+#define logc_array_dec_stride(cond, array, nItems, stride, ...) 0
+#define logc_array_hex_stride(cond, array, nItems, stride, ...) 0
+#define logc_strcpy(cond, string, ...)  0
+#define logc_fixed(cond, value, fracBits, nDecimals, ...)   0
+#define logc_float(cond, number, nDecimals, ...)    0
+#define logc_hexdump(cond, ptr, length, ...)    0
+#define logc_hexdump_copy(cond, ptr, length, ...)   0
+#define logc_array_dec_copy(cond, array, nItems, ...)   0
+#define logc_array_hex_copy(cond, array, nItems, ...)   0
+#define logc_fmt(cond, ...)          0
+#define logc_kv(cond, ...)           0
+#elif !LOG_LEVEL_ENABLED(LOG_FILE_LEVEL)
+#define logc_str(cond, string, ...)  ((void)sizeof(cond), (void)sizeof(string))
+#define logc_dec(cond, number, ...)  ((void)sizeof(cond), (void)sizeof(number))
+#define logc_hex(cond, number, ...)  ((void)sizeof(cond), (void)sizeof(number))
+#define logc_char(cond, chr, ...)    ((void)sizeof(cond), (void)sizeof(chr))
+#define logc_array_dec(cond, array, nItems, ...)    ((void)sizeof(cond), (void)sizeof(array), (void)sizeof(nItems))
+#define logc_array_hex(cond, array, nItems, ...)    ((void)sizeof(cond), (void)sizeof(array), (void)sizeof(nItems))
+#define logc_array_dec_stride(cond, array, nItems, stride, ...) ((void)sizeof(cond), log_array_dec_stride(array, nItems, stride))
+#define logc_array_hex_stride(cond, array, nItems, stride, ...) ((void)sizeof(cond), log_array_hex_stride(array, nItems, stride))
+#define logc_strcpy(cond, string, ...)  ((void)sizeof(cond), (void)sizeof(string))
+#define logc_fixed(cond, value, fracBits, nDecimals, ...)   ((void)sizeof(cond), log_fixed(value, fracBits, nDecimals))
+#define logc_float(cond, number, nDecimals, ...)    ((void)sizeof(cond), log_float(number, nDecimals))
+#define logc_hexdump(cond, ptr, length, ...)    ((void)sizeof(cond), (void)sizeof(ptr), (void)sizeof(length))
+#define logc_hexdump_copy(cond, ptr, length, ...)   ((void)sizeof(cond), (void)sizeof(ptr), (void)sizeof(length))
+#define logc_array_dec_copy(cond, array, nItems, ...)   ((void)sizeof(cond), (void)sizeof(array), (void)sizeof(nItems))
+#define logc_array_hex_copy(cond, array, nItems, ...)   ((void)sizeof(cond), (void)sizeof(array), (void)sizeof(nItems))
+#define logc_fmt(cond, ...)          ((void)sizeof(cond), log_fmt(__VA_ARGS__))
+#define logc_kv(cond, ...)           ((void)sizeof(cond), log_kv(__VA_ARGS__))
 #else
 #define logc_str(cond, string, ...)  do{ if(cond){ log_str((string) __VA_OPT__(,) __VA_ARGS__); } } while(0)
 #define logc_dec(cond, number, ...)  do{ if(cond){ log_dec((number) __VA_OPT__(,) __VA_ARGS__); } } while(0)
@@ -287,18 +2272,143 @@ typedef void (*log_out_flush_handler)(void);
 #define logc_char(cond, chr, ...)    do{ if(cond){ log_char((chr)   __VA_OPT__(,) __VA_ARGS__); } } while(0)
 #define logc_array_dec(cond, array, nItems, ...)   do{ if(cond){ log_array_dec((array), (nItems) __VA_OPT__(,) __VA_ARGS__); } } while(0)
 #define logc_array_hex(cond, array, nItems, ...)   do{ if(cond){ log_array_hex((array), (nItems) __VA_OPT__(,) __VA_ARGS__); } } while(0)
+#define logc_array_dec_stride(cond, array, nItems, stride, ...)    do{ if(cond){ log_array_dec_stride((array), (nItems), (stride) __VA_OPT__(,) __VA_ARGS__); } } while(0)
+#define logc_array_hex_stride(cond, array, nItems, stride, ...)    do{ if(cond){ log_array_hex_stride((array), (nItems), (stride) __VA_OPT__(,) __VA_ARGS__); } } while(0)
+#define logc_strcpy(cond, string, ...)  do{ if(cond){ log_strcpy((string) __VA_OPT__(,) __VA_ARGS__); } } while(0)
+#define logc_fixed(cond, value, fracBits, nDecimals, ...)  do{ if(cond){ log_fixed((value), (fracBits), (nDecimals) __VA_OPT__(,) __VA_ARGS__); } } while(0)
+#define logc_float(cond, number, nDecimals, ...)   do{ if(cond){ log_float((number), (nDecimals) __VA_OPT__(,) __VA_ARGS__); } } while(0)
+#define logc_hexdump(cond, ptr, length, ...)   do{ if(cond){ log_hexdump((ptr), (length) __VA_OPT__(,) __VA_ARGS__); } } while(0)
+#define logc_hexdump_copy(cond, ptr, length, ...)  do{ if(cond){ log_hexdump_copy((ptr), (length) __VA_OPT__(,) __VA_ARGS__); } } while(0)
+#define logc_array_dec_copy(cond, array, nItems, ...)  do{ if(cond){ log_array_dec_copy((array), (nItems) __VA_OPT__(,) __VA_ARGS__); } } while(0)
+#define logc_array_hex_copy(cond, array, nItems, ...)  do{ if(cond){ log_array_hex_copy((array), (nItems) __VA_OPT__(,) __VA_ARGS__); } } while(0)
+#define logc_fmt(cond, ...)          do{ if(cond){ log_fmt(__VA_ARGS__); } } while(0)
+#define logc_kv(cond, ...)           do{ if(cond){ log_kv(__VA_ARGS__); } } while(0)
 #endif
 
 
 void _log_var(uint32_t number, enum log_data_type type, enum log_color color);
+#if LOG_64BIT_NUMBERS
+void _log_var64(uint64_t number, enum log_data_type type, enum log_color color);
+#endif
 void _log_str(char *string,    uint32_t length,         enum log_color color);
 void _log_char(char chr,       enum log_color color);
+void _log_chars(const char *chars, uint32_t nChars, enum log_color color);
+void _log_enum(uint32_t value, const char *const *pNames, uint32_t nNames, enum log_color color);
+void _log_ref(const volatile void *pVar, enum log_data_type type, uint32_t size, enum log_color color);
+#if LOG_REGS
+void _log_reg(uint32_t value, const log_reg_desc_t *pDesc, enum log_color color);
+#endif
+#if LOG_CUSTOM_TYPES
+void _log_custom(uint32_t typeId, const void *pData, uint32_t size, enum log_color color);
+#endif
+#if LOG_PRINTF
+void _log_printf(const uintptr_t *pWords, uint32_t nWords, enum log_color color);
+#endif
+#if LOG_CONST_NUMBERS
+void _log_chars_word(uint32_t chars, uint32_t nChars, enum log_color color);
+#endif
+void _log_real(uint32_t number, enum log_data_type type, uint8_t fracBits, uint8_t nDecimals, enum log_color color);
 void _log_array(void *pArray, uint32_t nItems, uint8_t nBytesPerItem, enum log_data_type type, enum log_color color);
+void _log_array_stride(const void *pFirst, uint32_t nItems, uint32_t stride, uint8_t nBytesPerItem,
+                       enum log_data_type type, enum log_color color);
+void _log_strcpy(const char *string, uint32_t length, enum log_color color);
+void _log_array_copy(const void *pArray, uint32_t nItems, uint8_t nBytesPerItem, enum log_data_type type, enum log_color color);
+void _log_hexdump(const void *pData, uint32_t length, enum log_color color);
+#if LOG_COPY_ARENA_SIZE
+void _log_hexdump_copy(const void *pData, uint32_t length, enum log_color color);
+#endif
+#if LOG_BUFFER_REFS
+void _log_buffer_ref(const void *pData, uint32_t length, enum log_buffer_format format,
+                     log_buffer_release_t release, void *pReleaseCtx, enum log_color color);
+#endif
+void _log_fmt(const log_fmt_arg_t *pArgs, uint32_t nArgs, enum log_color color);
+void _log_kv(const log_fmt_arg_t *pArgs, uint32_t nPairs, enum log_color color);
+uint32_t log_format_dec(char *pBuf, uint32_t size, int32_t number);
+uint32_t log_format_udec(char *pBuf, uint32_t size, uint32_t number);
+uint32_t log_format_hex(char *pBuf, uint32_t size, uint32_t number, uint32_t nBytes);
+uint32_t log_format_fixed(char *pBuf, uint32_t size, int32_t number, uint8_t fracBits, uint8_t nDecimals);
+uint32_t log_format_float(char *pBuf, uint32_t size, float number, uint8_t nDecimals);
+uint32_t log_format_args(char *pBuf, uint32_t size, const log_fmt_arg_t *pArgs, uint32_t nArgs);
 void _log_flush(bool isPublicCall);
+void log_panic_flush(log_out_handler panicHandler);
+#if LOG_BOOT_MARKS
+#define LOG_BOOT_MARK(id)           _log_boot_mark(_LOG_STR(#id))
+void log_boot_flush(log_out_handler pollHandler);
+void _log_boot_mark(const char *pName);
+#else
+#define LOG_BOOT_MARK(id)           ((void)0)
+#endif
+#if LOG_BENCH
+uint32_t _log_bench_irq_off_max(void);
+#endif
+#if LOG_STATS
+void log_get_stats(log_stats_t *pStats);
+#endif
+#if LOG_LATENCY
+void log_latency_tx_done(void);
+#endif
+#if LOG_SATURATION_HOOKS
+void log_set_saturation_handler(log_saturation_handler handler);
+void log_saturation_notify(log_saturation_event_t event, uint32_t value);
+#endif
+#if LOG_HISTORY_SIZE
+void log_history_replay(void);
+#endif
+#if LOG_TASK_SNAPSHOT
+void log_task_snapshot(void);
+#endif
+#if LOG_POST_MORTEM
+void log_post_mortem_save(void);
+#endif
+#if LOG_POWER_FAIL_SAVE
+void log_power_fail_save(void);
+void log_power_fail_irq_handler(void);
+#endif
+#if LOG_RUNTIME_LEVELS
+void log_set_module_level(uint32_t module, uint32_t level);
+uint32_t log_get_module_level(uint32_t module);
+#endif
+#if LOG_FLIGHT_RECORDER
+void log_trigger(void);
+#endif
+#if LOG_CUSTOM_TYPES
+bool log_type_register(uint32_t typeId, log_type_format_t format);
+#endif
+#define _LOG_COMMANDS   (LOG_RUNTIME_LEVELS || LOG_FLIGHT_RECORDER || LOG_STATS || LOG_PROF || LOG_WATCH || LOG_TIME_SYNC || \
+                         LOG_HISTORY_SIZE || LOG_TASK_SNAPSHOT)
+#if _LOG_COMMANDS
+void log_command(char *pLine, uint32_t length);
+#endif
+#if LOG_INSTANCES
+bool log_ctx_init(log_ctx_t *pCtx, void *pBuffer, uint32_t nBytes, log_out_handler printHandler);
+void _log_ctx_var(log_ctx_t *pCtx, uint32_t number, enum log_data_type type, enum log_color color);
+void _log_ctx_str(log_ctx_t *pCtx, char *string, uint32_t length, enum log_color color);
+void _log_ctx_char(log_ctx_t *pCtx, char chr, enum log_color color);
+#endif
 
 
 void log_thread(void const * argument);
+#if LOG_IDLE_HOOK_ITEMS
+void log_idle_hook(void);
+#endif
+void log_early_init(void);
 void log_init(log_out_handler printHandler, log_out_flush_handler flushHandler);
+void log_set_ready_handler(log_out_ready_handler readyHandler);
+#if LOG_ERROR_FIFO_N_ELEM && !LOG_BINARY_OUTPUT
+void log_set_urgent_handler(log_out_handler urgentHandler);
+#endif
+#if LOG_LINE_PREFIX
+void log_set_module_names(const char *const *pNames, uint32_t nNames);
+#endif
+#if LOG_N_BACKENDS > 1
+bool log_add_backend(log_out_handler printHandler, log_out_flush_handler flushHandler, uint32_t levelMask,
+                     char *pRenderBuffer, uint32_t renderSize);
+#endif
+
+
+#if LOG_INLINE_PRODUCERS
+#include "log_fifo.h"
+#endif
 
 
 
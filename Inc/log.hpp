@@ -0,0 +1,173 @@
+#ifndef LOG_HPP_
+#define LOG_HPP_
+
+
+// C++ frontend of the logger (C++20). The macros of log.h rely on _Generic, which C++ does not have,
+// LOG() takes the argument types from templates instead:
+//
+//   LOG("ADC {} = {:x}\r\n", channel, value);
+//
+// The format string is split by the compiler into its literal parts and placeholders, {} for decimal
+// and {:x} for hexadecimal, with {{ and }} for the braces themselves. The call then stores them as a
+// single log_fmt() group: one reservation, no parsing at run time and no heap. Mismatched argument
+// counts and unknown placeholders do not compile.
+#include "log.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+
+namespace logger
+{
+
+// Format string given as a template argument, so the compiler can parse it
+template<std::size_t N>
+struct format_string
+{
+    char chars[N];
+
+    consteval format_string(const char (&str)[N])
+    {
+        for(std::size_t i = 0; i < N; i++)
+            chars[i] = str[i];
+    }
+};
+
+
+// Literal part or placeholder of a parsed format string
+struct format_token
+{
+    uint16_t    offset;                 // Literal in format_tokens::text
+    uint16_t    length;
+    bool        isArg;
+    bool        isHex;
+};
+
+
+template<std::size_t N>
+struct format_tokens
+{
+    char            text[N];            // Literals without placeholders, braces unescaped
+    format_token    tokens[N];
+    std::size_t     nTokens;
+    std::size_t     nArgs;
+};
+
+
+// A throw in a consteval function is a compile error, which points at the faulty format string
+template<std::size_t N>
+consteval format_tokens<N> parse(const char (&fmt)[N])
+{
+    format_tokens<N> parsed{};
+    std::size_t nText = 0;
+    std::size_t i = 0;
+
+    while(i < N - 1)
+    {
+        if(fmt[i] == '{' && fmt[i + 1] != '{')
+        {
+            format_token &arg = parsed.tokens[parsed.nTokens++];
+
+            arg.isArg = true;
+            if(fmt[i + 1] == '}')
+                i += 2;
+            else if(fmt[i + 1] == ':' && (fmt[i + 2] == 'x' || fmt[i + 2] == 'X') && fmt[i + 3] == '}')
+            {
+                arg.isHex = true;
+                i += 4;
+            }
+            else if(fmt[i + 1] == ':' && fmt[i + 2] == 'd' && fmt[i + 3] == '}')
+                i += 4;
+            else
+                throw "LOG() placeholders are {}, {:d} and {:x}";
+            parsed.nArgs++;
+            continue;
+        }
+        if(fmt[i] == '}' && fmt[i + 1] != '}')
+            throw "LOG() braces must be escaped as {{ and }}";
+
+        if(!parsed.nTokens || parsed.tokens[parsed.nTokens - 1].isArg)
+            parsed.tokens[parsed.nTokens++] = format_token{static_cast<uint16_t>(nText), 0, false, false};
+        parsed.text[nText++] = fmt[i];
+        parsed.tokens[parsed.nTokens - 1].length++;
+        i += (fmt[i] == '{' || fmt[i] == '}') ? 2 : 1;
+    }
+    return parsed;
+}
+
+
+// Value and both formats of an argument, only one of them is used by its placeholder
+struct format_arg
+{
+    const char *        str;
+    uint32_t            number;
+    enum log_data_type  decType;
+    enum log_data_type  hexType;
+};
+
+
+// Same types as _LOG_FMT_TYPE() and _LOG_HEX_TYPE() of the C macros
+template<typename T>
+inline format_arg make_arg(T value)
+{
+    if constexpr(std::is_enum_v<T>)
+        return make_arg(static_cast<std::underlying_type_t<T>>(value));
+    else if constexpr(std::is_same_v<std::decay_t<T>, char*> || std::is_same_v<std::decay_t<T>, const char*>)
+        return format_arg{value, static_cast<uint32_t>(strlen(value)), _LOG_STRING, _LOG_STRING};
+    else
+    {
+        static_assert(std::is_integral_v<T> && sizeof(T) <= sizeof(uint32_t),
+                      "LOG() arguments are integers of up to 32 bits or constant strings");
+        constexpr enum log_data_type hexType = (sizeof(T) == 1) ? _LOG_HEX_1 :
+                                               (sizeof(T) == 2) ? _LOG_HEX_2 : _LOG_HEX_4;
+        constexpr enum log_data_type decType = !std::is_signed_v<T> && !std::is_same_v<T, char> ? _LOG_UINT_DEC :
+                                               (sizeof(T) == 1) ? _LOG_INT_DEC_1 :
+                                               (sizeof(T) == 2) ? _LOG_INT_DEC_2 : _LOG_INT_DEC_4;
+
+        return format_arg{nullptr, static_cast<uint32_t>(value), decType, hexType};
+    }
+}
+
+
+template<format_string Fmt, typename... Args>
+inline void print(enum log_color color, const Args &...args)
+{
+    static constexpr format_tokens parsed = parse(Fmt.chars);
+    const format_arg values[sizeof...(Args) + 1] = {make_arg(args)...};
+    log_fmt_arg_t items[parsed.nTokens ? parsed.nTokens : 1];
+    std::size_t iArg = 0;
+
+    static_assert(parsed.nArgs == sizeof...(Args), "LOG() needs one argument per placeholder");
+    static_assert(parsed.nTokens > 0 && parsed.nTokens <= LOG_LINE_N_ARGS,
+                  "LOG() takes up to LOG_LINE_N_ARGS literal parts and placeholders");
+
+    for(std::size_t i = 0; i < parsed.nTokens; i++)
+    {
+        const format_token &token = parsed.tokens[i];
+
+        if(!token.isArg)
+            items[i] = log_fmt_arg_t{&parsed.text[token.offset], token.length, _LOG_STRING};
+        else
+        {
+            const format_arg &arg = values[iArg++];
+
+            items[i] = log_fmt_arg_t{arg.str, arg.number, token.isHex ? arg.hexType : arg.decType};
+        }
+    }
+    _log_fmt(items, parsed.nTokens, color);
+}
+
+}
+
+
+// The level of the including file and its module mask are checked like the C macros
+#define LOG(fmt, ...)                   _LOG_CPP_CALL(LOG_COLOR_NONE, fmt __VA_OPT__(,) __VA_ARGS__)
+#define LOG_COLORED(color, fmt, ...)    _LOG_CPP_CALL(color, fmt __VA_OPT__(,) __VA_ARGS__)
+
+#define _LOG_CPP_CALL(color, fmt, ...)  do{ if constexpr(LOG_LEVEL_ENABLED(LOG_FILE_LEVEL)) {                     \
+                                            _LOG_CALL(::logger::print<fmt>(_LOG_COLOR(color) __VA_OPT__(,) __VA_ARGS__)); \
+                                        } } while(0)
+
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef LOG_BENCH_H_
+#define LOG_BENCH_H_
+
+
+#include "log.h"
+
+
+#define LOG_BENCH_N_RUNS            32      // Calls measured for each benchmark entry
+#define LOG_BENCH_BASELINES         1       // Also compare the input FIFO with FreeRTOS queues, stream and message buffers
+
+
+#if LOG_BENCH
+void log_bench_run(log_out_handler printHandler, log_out_flush_handler flushHandler);
+#endif
+
+
+#endif
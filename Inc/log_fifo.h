@@ -0,0 +1,241 @@
+#ifndef LOG_FIFO_H_
+#define LOG_FIFO_H_
+
+
+// Layout of the input FIFO, shared by log.c and the producers that log.h inlines with
+// LOG_INLINE_PRODUCERS. Nothing here is part of the API.
+#include "log.h"
+#include <stddef.h>
+
+
+#define LOG_ARRAY_RECORDS           (LOG_BULK_ARRAYS || LOG_COPY_ARENA_SIZE)
+#define LOG_SEQ_ITEMS               (LOG_PER_CONTEXT_FIFOS || LOG_SEQUENCE_NUMBERS)
+#define LOG_LEVEL_ITEMS             (LOG_N_BACKENDS > 1 || LOG_ERROR_RESERVE || LOG_ERROR_FIFO_N_ELEM || \
+                                     LOG_CPU_BUDGET_PERCENT || LOG_LINE_PREFIX)
+
+
+typedef struct log_fifo_item_s
+{
+    union
+    {
+        uint32_t uData;
+        int32_t  sData;
+        char *   str;
+        char     chr[4];
+        uint32_t arenaIdx;              // Free running index of the data copied in the FIFO arena
+    };
+    union
+    {
+        uint16_t strLen;
+        uint8_t  nChars;
+        uint16_t nElems;
+        struct
+        {
+            uint8_t strideElems;        // Elements of a _LOG_ARRAY_STRIDE record at str
+            uint8_t stride;             // Bytes from one element to the next
+        };
+        struct
+        {
+            uint8_t fracBits;           // Format of fixed point and float numbers
+            uint8_t nDecimals;
+        };
+        uint8_t  traceEvent;            // enum log_trace_event, uData is the task or queue
+        struct
+        {
+            uint8_t enumIndex;          // Value of log_enum(), str is its table of names
+            uint8_t enumCount;
+        };
+        uint16_t regDesc;               // Word offset of the LOG_REG_DESC() of uData in .log_regs
+        struct
+        {
+            uint8_t refType;            // enum log_data_type and bytes of the log_ref() variable at str
+            uint8_t refSize;
+        };
+        struct
+        {
+            uint8_t customLen;          // Bytes of log_custom() at arenaIdx
+            uint8_t customId;
+        };
+    };
+#if LOG_64BIT_NUMBERS
+    uint32_t           uDataHi;         // High word of 64 bit numbers, uData holds the low one
+#endif
+#if LOG_ARRAY_RECORDS
+    uint8_t            elemType;        // Format and size of each item of an array record
+    uint8_t            elemSize;
+#endif
+#if LOG_SEQ_ITEMS
+    uint16_t           seq;             // Global insertion order, used to merge the context FIFOs and sent to the host
+#endif
+#if LOG_TIMESTAMPS
+    uint32_t           timestamp;       // LOG_TIMESTAMP_GET() value when the item was logged
+#endif
+    // Header fields from here on, stored in the head array of a LOG_FIFO_SPLIT slot
+#if LOG_LEVEL_ITEMS
+    uint8_t            level;           // LOG_FILE_LEVEL of the caller, 0 if it called _log_ functions directly
+#endif
+#if LOG_LINE_PREFIX
+    uint8_t            module;          // LOG_MODULE of the caller
+#endif
+#if LOG_CONTEXT_IDS
+    uint8_t            ctxId;           // Task or ISR that logged the item, from log_context_id()
+#endif
+    enum log_data_type type;
+#if LOG_SUPPORT_ANSI_COLOR
+    enum log_color     color;
+#endif
+} log_fifo_item_t;
+
+
+#if LOG_FIFO_PACKED
+// Packed records are stored in a byte ring: a header byte with type and color followed by its payload
+typedef uint8_t log_fifo_slot_t;
+#define LOG_FIFO_N_SLOTS(nElem)     ((nElem) * LOG_PACKED_BYTES_PER_ELEM)
+#elif LOG_FIFO_SPLIT
+// Split items are stored as two arrays in the same buffer: the words of the payloads (the fields of
+// log_fifo_item_t before its header), then a dense array of the header bytes
+typedef struct log_fifo_head_s
+{
+#if LOG_LEVEL_ITEMS
+    uint8_t            level;
+#endif
+#if LOG_LINE_PREFIX
+    uint8_t            module;
+#endif
+#if LOG_CONTEXT_IDS
+    uint8_t            ctxId;
+#endif
+    uint8_t            type;            // enum log_data_type
+#if LOG_SUPPORT_ANSI_COLOR
+    uint8_t            color;           // enum log_color
+#endif
+} log_fifo_head_t;
+
+#if LOG_LEVEL_ITEMS
+#define LOG_FIFO_BODY_SIZE          offsetof(log_fifo_item_t, level)
+#elif LOG_LINE_PREFIX
+#define LOG_FIFO_BODY_SIZE          offsetof(log_fifo_item_t, module)
+#elif LOG_CONTEXT_IDS
+#define LOG_FIFO_BODY_SIZE          offsetof(log_fifo_item_t, ctxId)
+#else
+#define LOG_FIFO_BODY_SIZE          offsetof(log_fifo_item_t, type)
+#endif
+
+typedef struct log_fifo_body_s
+{
+    uint32_t           words[(LOG_FIFO_BODY_SIZE + sizeof(uint32_t) - 1) / sizeof(uint32_t)];
+} log_fifo_slot_t;
+
+// The head array takes the slots right after the last payload
+#define LOG_FIFO_N_SLOTS(nElem)     ((nElem) + ((nElem) * sizeof(log_fifo_head_t) + sizeof(log_fifo_slot_t) - 1) / \
+                                               sizeof(log_fifo_slot_t))
+#else
+typedef log_fifo_item_t log_fifo_slot_t;
+#define LOG_FIFO_N_SLOTS(nElem)     (nElem)
+#endif
+
+#define LOG_FIFO_HAS_COMMIT_FLAGS   (LOG_FIFO_MODE == LOG_FIFO_MPSC && !LOG_FIFO_PACKED)
+
+
+typedef struct log_fifo_s
+{
+    log_fifo_slot_t *buffer;
+#if LOG_FIFO_SPLIT
+    log_fifo_head_t *head;              // Header bytes of the items, after the size payloads of buffer
+#endif
+    uint32_t size;                      // Number of slots, must be power of 2
+#if LOG_FIFO_MODE == LOG_FIFO_LOCKED && !LOG_FIFO_PACKED
+    uint32_t wrIdx;
+    uint32_t rdIdx;
+    uint32_t nItems;
+#else
+#if LOG_FIFO_HAS_COMMIT_FLAGS
+    volatile bool *isCommitted;
+#endif
+    volatile uint32_t wrIdx;            // Free running indexes, masked when accessing buffer
+    volatile uint32_t rdIdx;
+#endif
+#if LOG_COPY_ARENA_SIZE
+    uint8_t *arena;                     // Strings and arrays copied by the producers
+    volatile uint32_t arenaWrIdx;       // Free running indexes, allocations are always contiguous
+    volatile uint32_t arenaRdIdx;
+#endif
+} log_fifo_t;
+
+
+#if LOG_INLINE_PRODUCERS && (LOG_FIFO_MODE != LOG_FIFO_LOCKED || LOG_FIFO_PACKED || LOG_FIFO_SPLIT || LOG_PER_CONTEXT_FIFOS || \
+                             LOG_FLIGHT_RECORDER || LOG_CONTEXT_IDS || LOG_ERROR_FIFO_N_ELEM || \
+                             LOG_CPU_BUDGET_PERCENT || LOG_OVERFLOW_BLOCK || LOG_SEQUENCE_NUMBERS || LOG_LINE_PREFIX || \
+                             LOG_BENCH || LOG_PROBES)
+#error "LOG_INLINE_PRODUCERS requires the single LOG_FIFO_LOCKED FIFO of items, without context IDs, CPU budget, blocking, sequence numbers, bench nor probes"
+#endif
+
+
+#if LOG_INLINE_PRODUCERS
+#define LOG_INPUT_NOTIFY            (LOG_STATS || LOG_WAKEUP_FILL_PERCENT || LOG_LOW_POWER || LOG_BOOST_FILL_PERCENT)
+
+extern log_fifo_t _logFifo;
+#if LOG_INPUT_NOTIFY
+void _log_input_notify(bool isStored);
+#endif
+#if LOG_STATS
+void _log_inline_stored(void);          // Counts the stored item, called in the critical section
+#endif
+
+
+// _log_var() with log_fifo_put() expanded at the call: the type and the color are constants of
+// log_dec() and log_hex(), the item is written in place in its slot instead of being built on the
+// stack and copied.
+static inline __attribute__((always_inline)) void _log_var_inline(uint32_t number, enum log_data_type type,
+                                                                  enum log_color color)
+{
+    log_fifo_item_t *pSlot;
+    bool isStored = false;
+    uint32_t primaskBit;
+#if LOG_TIMESTAMPS
+    uint32_t timestamp = LOG_TIMESTAMP_GET();
+#endif
+#if LOG_LEVEL_ITEMS
+    uint8_t level = (uint32_t)color >> _LOG_LEVEL_SHIFT;
+
+    color = (enum log_color)((uint32_t)color & ((1UL << _LOG_LEVEL_SHIFT) - 1));
+#endif
+
+    LOG_MASK_SAVE(primaskBit);
+#if LOG_ERROR_RESERVE
+    if(_logFifo.nItems + ((level == LOG_LEVEL_ERROR) ? 0 : LOG_ERROR_RESERVE) < _logFifo.size)
+#else
+    if(_logFifo.nItems < _logFifo.size)
+#endif
+    {
+        pSlot = &_logFifo.buffer[_logFifo.wrIdx];
+        pSlot->uData = number;
+        pSlot->type = type;
+#if LOG_SUPPORT_ANSI_COLOR
+        pSlot->color = color;
+#endif
+#if LOG_LEVEL_ITEMS
+        pSlot->level = level;
+#endif
+#if LOG_TIMESTAMPS
+        pSlot->timestamp = timestamp;
+#endif
+        _logFifo.wrIdx = (_logFifo.wrIdx + 1) & (_logFifo.size - 1);
+        _logFifo.nItems++;
+#if LOG_STATS
+        _log_inline_stored();
+#endif
+        isStored = true;
+    }
+    LOG_MASK_RESTORE(primaskBit);
+
+#if LOG_INPUT_NOTIFY
+    _log_input_notify(isStored);
+#else
+    (void)isStored;
+#endif
+}
+#endif
+
+
+#endif
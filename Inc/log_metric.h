@@ -0,0 +1,45 @@
+#ifndef LOG_METRIC_H_
+#define LOG_METRIC_H_
+
+
+#include "log.h"
+
+
+#define LOG_METRIC_N_IDS            16      // Counters, their IDs go from 0 to LOG_METRIC_N_IDS - 1
+#define LOG_METRIC_PERIOD_MS        1000    // Time between two snapshots logged by the log thread
+#define LOG_METRIC_DELTAS           0       // Log the change of each counter since the previous snapshot instead of its value
+
+
+#if LOG_METRICS
+extern volatile uint32_t _logMetrics[LOG_METRIC_N_IDS];
+
+// From any context. The interrupts are masked with LOG_MASK_SAVE() for the read-modify-write, as the
+// Cortex-M0+ has no exclusive accesses, an aligned store is atomic by itself.
+static inline void log_metric_add(uint32_t id, uint32_t value)
+{
+    uint32_t primaskBit;
+
+    if(id >= LOG_METRIC_N_IDS)
+        return;
+    LOG_MASK_SAVE(primaskBit);
+    _logMetrics[id] += value;
+    LOG_MASK_RESTORE(primaskBit);
+}
+
+static inline void log_metric_set(uint32_t id, uint32_t value)
+{
+    if(id < LOG_METRIC_N_IDS)
+        _logMetrics[id] = value;
+}
+
+#define log_metric_inc(id)          log_metric_add((id), 1)
+
+void _log_metric_poll(void);                        // Called by log_thread() at each wakeup
+#else
+#define log_metric_add(id, value)   ((void)(id), (void)(value))
+#define log_metric_set(id, value)   ((void)(id), (void)(value))
+#define log_metric_inc(id)          ((void)(id))
+#endif
+
+
+#endif
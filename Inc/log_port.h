@@ -0,0 +1,91 @@
+#ifndef LOG_PORT_H_
+#define LOG_PORT_H_
+
+/*
+ * Platform of log.c: the CMSIS core functions, the HAL registers and the FreeRTOS calls it uses.
+ * The target build takes them from the Cube and FreeRTOS headers. Building with -DLOG_PORT_HOST=1
+ * replaces them with the stubs below, enough for log.c in its default configuration to run in a
+ * single thread on a PC, such as Tools/log_host.c does to benchmark and check the formatters.
+ * Interrupts are never masked there, no code runs as an ISR and the scheduler is not started.
+ */
+
+
+#ifndef LOG_PORT_HOST
+#define LOG_PORT_HOST               0
+#endif
+
+
+#if !LOG_PORT_HOST
+
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#else
+
+#include <stdint.h>
+#include <stddef.h>
+
+static inline uint32_t __get_PRIMASK(void)              { return 0; }
+static inline void __set_PRIMASK(uint32_t priMask)      { (void)priMask; }
+static inline void __disable_irq(void)                  { }
+static inline void __enable_irq(void)                   { }
+static inline uint32_t __get_IPSR(void)                 { return 0; }
+#define __DMB()                     __sync_synchronize()
+
+// TIM2->CNT of LOG_TIMESTAMP_GET() reads a counter the host program may advance
+typedef struct
+{
+    volatile uint32_t CNT;
+} TIM_TypeDef;
+extern TIM_TypeDef logPortTim2;
+#define TIM2                        (&logPortTim2)
+
+// Calendar registers of LOG_RTC_ANCHOR_MS, which the host program sets
+typedef struct
+{
+    volatile uint32_t TR;
+    volatile uint32_t DR;
+    volatile uint32_t SSR;
+    volatile uint32_t PRER;
+} RTC_TypeDef;
+extern RTC_TypeDef logPortRtc;
+#define RTC                         (&logPortRtc)
+static inline uint32_t HAL_GetTick(void)                { return 0; }
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+
+#define pdTRUE                      1
+#define pdFALSE                     0
+#define pdPASS                      1
+#define pdMS_TO_TICKS(ms)           (ms)
+#define portMAX_DELAY               0xFFFFFFFFUL
+#define portYIELD_FROM_ISR(x)       (void)(x)
+#define tskIDLE_PRIORITY            0
+#define configMAX_PRIORITIES        7
+#define configMAX_TASK_NAME_LEN     16
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS 1
+#define taskSCHEDULER_NOT_STARTED   1
+#define taskSCHEDULER_RUNNING       2
+
+static inline BaseType_t xTaskGetSchedulerState(void)   { return taskSCHEDULER_NOT_STARTED; }
+static inline TaskHandle_t xTaskGetCurrentTaskHandle(void)  { return NULL; }
+static inline TickType_t xTaskGetTickCount(void)        { return 0; }
+static inline void vTaskDelay(TickType_t ticks)         { (void)ticks; }
+static inline void vTaskSuspendAll(void)                { }
+static inline BaseType_t xTaskResumeAll(void)           { return pdFALSE; }
+static inline BaseType_t xTaskNotifyGive(TaskHandle_t task)     { (void)task; return pdPASS; }
+static inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *pWoken)  { (void)task; *pWoken = pdFALSE; }
+static inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)       { (void)clear; (void)ticks; return 0; }
+static inline void osDelay(uint32_t ms)                 { (void)ms; }
+static inline int osThreadYield(void)                   { return 0; }
+
+#endif
+
+
+#endif
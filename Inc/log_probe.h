@@ -0,0 +1,27 @@
+#ifndef LOG_PROBE_H_
+#define LOG_PROBE_H_
+
+
+#include "log.h"
+
+
+#define LOG_PROBE_GPIO_PORT         GPIOC
+#define LOG_PROBE_GPIO_CLK_ENABLE() __HAL_RCC_GPIOC_CLK_ENABLE()
+#define LOG_PROBE_CRITICAL_PIN      GPIO_PIN_0      // High while an input FIFO critical section masks the interrupts
+#define LOG_PROBE_FLUSH_PIN         GPIO_PIN_1      // High during each processing pass of the input FIFOs
+#define LOG_PROBE_TX_PIN            GPIO_PIN_2      // High from the start of each vcp.c UART transfer to its end
+
+
+#if LOG_PROBES
+// Single stores to BSRR, whose upper half resets the pins, so they need no read-modify-write
+#define LOG_PROBE_HIGH(pin)         (LOG_PROBE_GPIO_PORT->BSRR = (pin))
+#define LOG_PROBE_LOW(pin)          (LOG_PROBE_GPIO_PORT->BSRR = (uint32_t)(pin) << 16)
+
+void log_probe_init(void);                          // Called by log_init()
+#else
+#define LOG_PROBE_HIGH(pin)         ((void)0)
+#define LOG_PROBE_LOW(pin)          ((void)0)
+#endif
+
+
+#endif
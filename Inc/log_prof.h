@@ -0,0 +1,31 @@
+#ifndef LOG_PROF_H_
+#define LOG_PROF_H_
+
+
+#include "log.h"
+
+
+#define LOG_PROF_N_IDS              16      // Profiled sections, their IDs go from 0 to LOG_PROF_N_IDS - 1
+#define LOG_PROF_N_BUCKETS          24      // Log2 histogram buckets, the last one also counts the longer runs
+#define LOG_PROF_PERIOD_MS          0       // Time between two dumps of the log thread, 0 for log_prof_request_dump() only
+
+
+#if LOG_PROF
+// The ID must be a number or a constant name, as it is pasted in the name of the start variable. Both
+// macros must be in the same scope, the cycles measured include the two LOG_TIMESTAMP_GET() reads.
+#define LOG_PROF_BEGIN(id)          uint32_t _logProfStart##id = LOG_TIMESTAMP_GET()
+#define LOG_PROF_END(id)            _log_prof_add((id), LOG_TIMESTAMP_GET() - _logProfStart##id)
+
+void _log_prof_add(uint32_t id, uint32_t cycles);
+void _log_prof_poll(void);                          // Called by log_thread() at each wakeup
+void log_prof_dump(void);                           // Logs the table and clears it, from a task
+void log_prof_request_dump(void);                   // Any context, done by the log thread at its next wakeup
+#else
+#define LOG_PROF_BEGIN(id)          ((void)0)
+#define LOG_PROF_END(id)            ((void)(id))
+#define log_prof_dump()             ((void)0)
+#define log_prof_request_dump()     ((void)0)
+#endif
+
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef LOG_QUEUE_H_
+#define LOG_QUEUE_H_
+
+
+#include "log.h"
+
+
+#define LOG_QUEUE_MONITOR_PERIOD_MS 1000    // Time between two reports of the high water marks
+#define LOG_QUEUE_MONITOR_N_STREAMS 2       // Stream buffers of log_queue_monitor_stream(), the queues come from the registry
+
+
+#if LOG_QUEUE_MONITOR
+#include "FreeRTOS.h"
+#include "stream_buffer.h"
+
+// Adds a stream buffer, which the queue registry does not take, under pName. Returns false if the
+// list is full. The stream buffer must not be deleted afterwards.
+bool log_queue_monitor_stream(StreamBufferHandle_t stream, const char *pName);
+void _log_queue_poll(void);                         // Called by log_thread() at each wakeup
+#else
+#define log_queue_monitor_stream(stream, pName) ((void)(stream), (void)(pName), false)
+#endif
+
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef LOG_STRESS_H_
+#define LOG_STRESS_H_
+
+
+#include "log.h"
+
+
+#define LOG_STRESS_N_TASKS          3       // Producer tasks, at the priorities above the log thread one after the other
+#define LOG_STRESS_ISR              1       // TIM7 interrupt producer too
+#define LOG_STRESS_TIM_HZ           1000    // TIM7 interrupt rate, the ISR producer logs its share of a stage at this pace
+#define LOG_STRESS_IRQ_PRIORITY     3
+#define LOG_STRESS_START_RATE       1000    // Events per second of all the producers together in the first stage
+#define LOG_STRESS_RATE_STEP        1000    // Added at each following stage
+#define LOG_STRESS_N_STAGES         10
+#define LOG_STRESS_STAGE_MS         2000
+#define LOG_STRESS_STACK_SIZE       128     // Words of each producer task
+#define LOG_STRESS_JITTER           1       // TIM6 interrupt recording its entry latency in each stage
+#define LOG_STRESS_JITTER_HZ        10000   // TIM6 interrupt rate, at most 65535 samples per stage
+#define LOG_STRESS_JITTER_N_BINS    256     // Latency histogram bins of one TIM6 tick, the last one holds the longer ones
+
+
+#if LOG_STRESS
+void log_stress_run(void);
+
+// Must be called from TIM7_LPTIM2_IRQHandler() with LOG_STRESS_ISR
+void log_stress_tim_irq_handler(void);
+
+// Must be called first thing from TIM6_DAC_LPTIM1_IRQHandler() with LOG_STRESS_JITTER
+void log_stress_jitter_irq_handler(void);
+#endif
+
+
+#endif
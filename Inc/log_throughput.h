@@ -0,0 +1,17 @@
+#ifndef LOG_THROUGHPUT_H_
+#define LOG_THROUGHPUT_H_
+
+
+#include "log.h"
+
+
+#define LOG_THROUGHPUT_MIX_MS       2000        // Flood time of each mix, at most 60000 at 64 MHz
+#define LOG_THROUGHPUT_LINE_BPS     2000000     // Baud rate of the VCP UART, 10 bits per byte on the line
+
+
+#if LOG_THROUGHPUT
+void log_throughput_run(void);
+#endif
+
+
+#endif
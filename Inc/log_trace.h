@@ -0,0 +1,81 @@
+#ifndef LOG_TRACE_H_
+#define LOG_TRACE_H_
+
+
+// Kernel instrumentation of the logger. Included by FreeRTOSConfig.h, so it must not include log.h
+// nor the FreeRTOS headers.
+#include <stdint.h>
+
+
+#define LOG_RTOS_TRACE              0       // FreeRTOS trace macros store task switches and queue events in the log input FIFO
+#define LOG_TASK_STATS              0       // TIM2 counts the FreeRTOS run time stats, the log thread logs the CPU use of each task
+#define LOG_TASK_STATS_PERIOD_MS    1000    // Time between two reports (less than the 67 s wrap of TIM2 at 64 MHz)
+#define LOG_STACK_STATS             0       // The log thread logs the stack high water mark of each task
+#define LOG_STACK_STATS_PERIOD_MS   10000   // Time between two stack reports
+#define LOG_STACK_STATS_ON_CHANGE   0       // Only log the tasks whose free stack went down since the previous report
+#define LOG_TASK_SNAPSHOT           0       // log_task_snapshot() and the "logtasks" command log a row of state, priority, stack and run time per task
+#define LOG_TASK_STATS_MAX_TASKS    8       // At least the number of tasks, idle task included, or no report is made
+#define LOG_TASK_STATS_COUNTER      (*(volatile uint32_t*)0x40000024UL)    // TIM2->CNT, the device header is not included here
+
+
+// Event of a trace record, sent in the low nibble of its tag and decoded by Tools/log_decode.py --trace
+enum log_trace_event {
+    LOG_TRACE_TASK_SWITCHED_IN,
+    LOG_TRACE_TASK_CREATE,
+    LOG_TRACE_TASK_DELETE,
+    LOG_TRACE_TASK_DELAY,
+    LOG_TRACE_QUEUE_SEND,
+    LOG_TRACE_QUEUE_SEND_FAILED,
+    LOG_TRACE_QUEUE_RECEIVE,
+    LOG_TRACE_QUEUE_RECEIVE_FAILED,
+    LOG_TRACE_QUEUE_BLOCK_SEND,
+    LOG_TRACE_QUEUE_BLOCK_RECEIVE,
+    LOG_TRACE_QUEUE_SEND_FROM_ISR,
+    LOG_TRACE_QUEUE_RECEIVE_FROM_ISR,
+    LOG_TRACE_ISR_ENTER,                // Of log_trace_isr_enter() and log_trace_isr_exit(), the object
+    LOG_TRACE_ISR_EXIT                  // is the exception number
+};
+
+
+#if LOG_RTOS_TRACE
+void _log_trace(enum log_trace_event event, const void *pObject);
+void log_trace_isr_enter(void);
+void log_trace_isr_exit(void);
+
+// Expanded in tasks.c and queue.c, where pxCurrentTCB is the running task. Semaphores and mutexes
+// are queues too.
+#define traceTASK_SWITCHED_IN()                     _log_trace(LOG_TRACE_TASK_SWITCHED_IN, pxCurrentTCB)
+#define traceTASK_CREATE(pxNewTCB)                  _log_trace(LOG_TRACE_TASK_CREATE, pxNewTCB)
+#define traceTASK_DELETE(pxTaskToDelete)            _log_trace(LOG_TRACE_TASK_DELETE, pxTaskToDelete)
+#define traceTASK_DELAY()                           _log_trace(LOG_TRACE_TASK_DELAY, pxCurrentTCB)
+#define traceQUEUE_SEND(pxQueue)                    _log_trace(LOG_TRACE_QUEUE_SEND, pxQueue)
+#define traceQUEUE_SEND_FAILED(pxQueue)             _log_trace(LOG_TRACE_QUEUE_SEND_FAILED, pxQueue)
+#define traceQUEUE_RECEIVE(pxQueue)                 _log_trace(LOG_TRACE_QUEUE_RECEIVE, pxQueue)
+#define traceQUEUE_RECEIVE_FAILED(pxQueue)          _log_trace(LOG_TRACE_QUEUE_RECEIVE_FAILED, pxQueue)
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue)        _log_trace(LOG_TRACE_QUEUE_BLOCK_SEND, pxQueue)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue)     _log_trace(LOG_TRACE_QUEUE_BLOCK_RECEIVE, pxQueue)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue)           _log_trace(LOG_TRACE_QUEUE_SEND_FROM_ISR, pxQueue)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue)        _log_trace(LOG_TRACE_QUEUE_RECEIVE_FROM_ISR, pxQueue)
+#else
+#define log_trace_isr_enter()                       ((void)0)
+#define log_trace_isr_exit()                        ((void)0)
+#endif
+
+
+#if LOG_TASK_STATS
+void _log_task_stats_start(void);
+
+// uxTaskGetSystemState() needs the trace facility, the counter is read at each context switch
+#define configGENERATE_RUN_TIME_STATS               1
+#define configUSE_TRACE_FACILITY                    1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()    _log_task_stats_start()
+#define portGET_RUN_TIME_COUNTER_VALUE()            LOG_TASK_STATS_COUNTER
+#endif
+
+
+#if (LOG_STACK_STATS || LOG_TASK_SNAPSHOT) && !LOG_TASK_STATS
+#define configUSE_TRACE_FACILITY                    1   // uxTaskGetSystemState()
+#endif
+
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef LOG_WATCH_H_
+#define LOG_WATCH_H_
+
+
+#include "log.h"
+
+
+#define LOG_WATCH_N_VARS            8       // Variables that can be watched at the same time
+
+
+#if LOG_WATCH
+// Samples the integer variable of pVar (8 to 32 bit) every periodMs from the log thread, as a signed
+// or unsigned decimal after its type. Returns false if the watch list is full.
+#define log_watch(pVar, periodMs)   _log_watch((const volatile void*)(pVar), sizeof(*(pVar)), _LOG_DEC_TYPE(*(pVar)), (periodMs))
+
+bool _log_watch(const volatile void *pVar, uint32_t size, enum log_data_type type, uint32_t periodMs);
+void log_unwatch(const volatile void *pVar);
+bool log_watch_set_period(uint32_t index, uint32_t periodMs);  // Index in the order of the log_watch() calls
+void _log_watch_poll(void);                         // Called by log_thread() at each wakeup
+#else
+#define log_watch(pVar, periodMs)   ((void)(pVar), (void)(periodMs), false)
+#define log_unwatch(pVar)           ((void)(pVar))
+#define log_watch_set_period(index, periodMs)   ((void)(index), (void)(periodMs), false)
+#endif
+
+
+#endif
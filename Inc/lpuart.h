@@ -0,0 +1,32 @@
+#ifndef LPUART_H_
+#define LPUART_H_
+
+
+#include "main.h"
+#include <stdbool.h>
+
+
+#define LPUART_BACKEND              0                       // main.c logs to LPUART1 on PA2, vcp.c and vcp_th are not used
+#define LPUART_BUFFER_SIZE          1024                    // Output ring sent in place by DMA (power of 2)
+#define LPUART_BAUDRATE             115200
+#define LPUART_CLK_SOURCE           RCC_LPUART1CLKSOURCE_HSI    // HSI or LSE (9600 bauds at most), both keep running in STOP mode
+#define LPUART_DMA_CHANNEL          DMA1_Channel2
+#define LPUART_DMA_REQUEST          DMA_REQUEST_LPUART1_TX
+#define LPUART_DMA_IRQn             DMA1_Channel2_3_IRQn
+#define LPUART_IRQ_PRIORITY         3
+#define LPUART_READY_MIN_FREE       64                      // Free bytes below which lpuart_is_ready() throttles the logger
+
+
+void lpuart_send(void* pData, uint32_t nBytes);
+void lpuart_flush(void);
+bool lpuart_is_ready(void);
+uint32_t lpuart_get_dropped_bytes(void);            // Bytes lost because the ring was full
+void lpuart_panic_send(void* pData, uint32_t nBytes);   // Polls the LPUART registers, for log_panic_flush()
+void lpuart_pre_sleep(uint32_t *pIdleTime);         // configPRE_SLEEP_PROCESSING() of tickless idle
+void lpuart_init(void);
+
+// Must be called from the IRQ handler of LPUART_DMA_IRQn
+void lpuart_dma_irq_handler(void);
+
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef RTT_H_
+#define RTT_H_
+
+
+#include "main.h"
+#include <stdbool.h>
+
+
+// Up buffer modes, matching the SEGGER RTT flags so the host tools may change them too
+#define RTT_MODE_SKIP               0                       // Writes that do not fit are dropped whole
+#define RTT_MODE_TRIM               1                       // The bytes that do not fit are dropped
+#define RTT_MODE_BLOCK              2                       // Wait for the probe to read, hangs without one attached
+
+
+#define RTT_BACKEND                 0                       // main.c logs to the RTT up buffer, the UART and vcp_th are not used
+#define RTT_UP_BUFFER_SIZE          1024
+#define RTT_MODE                    RTT_MODE_TRIM
+#define RTT_READY_MIN_FREE          64                      // Free bytes below which rtt_is_ready() throttles the logger
+
+
+void rtt_send(void* pData, uint32_t nBytes);
+bool rtt_is_ready(void);
+uint32_t rtt_get_dropped_bytes(void);               // Bytes lost because the up buffer was full
+void rtt_init(void);
+
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SPI_LOG_H_
+#define SPI_LOG_H_
+
+
+#include "main.h"
+#include <stdbool.h>
+
+
+#define SPI_LOG_BACKEND             0                       // main.c logs to SPI1 (PB3 SCK, PB5 MOSI, PA4 CS), vcp.c and vcp_th are not used
+#define SPI_LOG_BUFFER_SIZE         2048                    // Output ring sent in place by DMA (power of 2)
+#define SPI_LOG_BAUDRATE_PRESCALER  0                       // SPI_CR1 BR field: SCK is PCLK / 2^(n + 1), 0 gives 32 MHz
+#define SPI_LOG_FRAME_MAX           256                     // Largest payload of a frame, longer sends are split
+#define SPI_LOG_DMA_CHANNEL         DMA1_Channel3
+#define SPI_LOG_DMA_REQUEST         DMA_REQUEST_SPI1_TX
+#define SPI_LOG_DMA_IRQn            DMA1_Channel2_3_IRQn
+#define SPI_LOG_IRQ_PRIORITY        3
+#define SPI_LOG_READY_MIN_FREE      (SPI_LOG_FRAME_MAX + SPI_LOG_HDR_SIZE)  // Free bytes below which spi_log_is_ready() throttles the logger
+
+// Frame header: sync bytes then the payload length, little endian
+#define SPI_LOG_SYNC_0              0xA5
+#define SPI_LOG_SYNC_1              0x5A
+#define SPI_LOG_HDR_SIZE            4
+
+
+void spi_log_send(void* pData, uint32_t nBytes);
+void spi_log_flush(void);
+bool spi_log_is_ready(void);
+uint32_t spi_log_get_dropped_bytes(void);           // Payload bytes lost because the ring was full
+void spi_log_panic_send(void* pData, uint32_t nBytes);  // Polls the SPI registers, for log_panic_flush()
+void spi_log_init(void);
+
+// Must be called from the IRQ handler of SPI_LOG_DMA_IRQn
+void spi_log_dma_irq_handler(void);
+
+
+#endif
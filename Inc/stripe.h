@@ -0,0 +1,36 @@
+#ifndef STRIPE_H_
+#define STRIPE_H_
+
+
+#include "main.h"
+#include <stdbool.h>
+
+
+// Lane choice of each packet, selected with STRIPE_SCHEDULING
+#define STRIPE_ROUND_ROBIN          0                       // The lanes take turns, a full one passes its turn
+#define STRIPE_LEAST_BACKLOG        1                       // The lane with the fewest bytes queued, turns on ties
+
+
+#define STRIPE_BACKEND              0                       // main.c stripes the LOG_PACKETS packets across USART2 (vcp.c) and USART1 on PA9
+#define STRIPE_BUFFER_SIZE          1024                    // Output ring of USART1 sent in place by DMA (power of 2)
+#define STRIPE_BAUDRATE             2000000                 // The one of MX_USART2_UART_Init(), so that both lanes drain at the same rate
+#define STRIPE_SCHEDULING           STRIPE_LEAST_BACKLOG
+#define STRIPE_DMA_CHANNEL          DMA1_Channel2
+#define STRIPE_DMA_REQUEST          DMA_REQUEST_USART1_TX
+#define STRIPE_DMA_IRQn             DMA1_Channel2_3_IRQn    // Shared with VCP_RX_DMA, whose channel 3 is checked by the same handler
+#define STRIPE_IRQ_PRIORITY         3
+#define STRIPE_READY_MIN_FREE       64                      // Free bytes of both lanes below which stripe_is_ready() throttles the logger
+
+
+void stripe_send(void* pData, uint32_t nBytes);
+void stripe_flush(void);
+bool stripe_is_ready(void);
+uint32_t stripe_get_dropped_bytes(void);            // Bytes of the packets lost because no lane had room
+void stripe_panic_send(void* pData, uint32_t nBytes);   // Polls the USART1 ring out, then vcp_panic_send()
+void stripe_init(void);                             // After vcp_init()
+
+// Must be called from the IRQ handler of STRIPE_DMA_IRQn
+void stripe_dma_irq_handler(void);
+
+
+#endif
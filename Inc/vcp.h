@@ -1,18 +1,90 @@
-
 #ifndef VCP_TH_H_
 #define VCP_TH_H_
 
 
 #include "main.h"
+#include <stdbool.h>
+
+
+// Input buffer overflow policies, selected with VCP_OVERFLOW_POLICY
+#define VCP_OVERFLOW_TRUNCATE       0                       // The bytes that do not fit are dropped
+#define VCP_OVERFLOW_DROP           1                       // Writes that do not fit are dropped whole
+#define VCP_OVERFLOW_BLOCK          2                       // Wait up to VCP_SEND_TIMEOUT_MS for room, then drop the write
+#define VCP_OVERFLOW_MARKER         3                       // Drop whole writes and send "[N bytes lost]" once there is room (text output only)
 
 
 #define VCP_INPUT_BUFFER_SIZE       1024
+#define VCP_INPUT_BUFFER_PLACEMENT                          // Attributes of the input buffer, like __attribute__((section(".sram2")))
+#define VCP_TRIGGER_LEVEL           1                       // Bytes in the input buffer that wake up a sleeping vcp_th (VCP_DMA_BUFFER_SIZE sends full chunks)
+#define VCP_FLUSH_TIMEOUT_MS        0                       // Longest sleep of vcp_th with bytes below the trigger level (0 waits forever)
+#define VCP_URGENT_BUFFER_SIZE      0                       // Urgent lane of vcp_send_urgent(), sent before the input buffer at the next chunk (0 disables it)
+
+#define VCP_ZERO_COPY               0                       // Own byte ring sent in place, instead of a stream buffer (power of 2 size)
+#define VCP_BLOCKING_TH             0                       // vcp_th sleeps on the stream buffer instead of polling it
+#define VCP_USE_DMA                 0                       // Send with DMA, vcp_th sleeps while the UART drains
+#define VCP_DMA_BUFFER_SIZE         64                      // Size of each of the two DMA transmit buffers
+#define VCP_DMA_CHANNEL             DMA1_Channel1
+#define VCP_DMA_REQUEST             DMA_REQUEST_USART2_TX
+#define VCP_DMA_IRQn                DMA1_Channel1_IRQn
+#define VCP_UART_IRQn               USART2_IRQn
+#define VCP_IRQ_PRIORITY            3
+#define VCP_TX_FIFO                 0                       // Enable the 8 byte TX FIFO of the USART
+#define VCP_TX_IRQ                  0                       // The UART interrupt sends the input buffer (refilling the TX FIFO at its threshold), no vcp_th
+#define VCP_DIRECT                  0                       // vcp_send() starts the DMA of the caller data in place, no vcp_th nor input buffer (needs LOG_RENDER_PING_PONG)
+#define VCP_LL_TX                   0                       // Send through the USART registers and the LL DMA driver, without the HAL UART state machine
+#define VCP_OVERFLOW_POLICY         VCP_OVERFLOW_TRUNCATE
+#define VCP_SEND_TIMEOUT_MS         10                      // Longest wait for room with VCP_OVERFLOW_BLOCK
+#define VCP_READY_MIN_FREE          64                      // Free bytes below which vcp_is_ready() throttles the logger
+#define VCP_RX_LINE_SIZE            0                       // Receive buffer for lines passed to the vcp_set_rx_handler() one (0 disables reception)
+#define VCP_RX_DMA                  0                       // Receive by circular DMA, parsed at idle line and DMA half/full events instead of per byte
+#define VCP_RX_DMA_BUFFER_SIZE      64                      // Circular DMA buffer, parsed at each half so it may take two lines per event
+#define VCP_RX_DMA_CHANNEL          DMA1_Channel3
+#define VCP_RX_DMA_REQUEST          DMA_REQUEST_USART2_RX
+#define VCP_RX_DMA_IRQn             DMA1_Channel2_3_IRQn    // Shared with the LPUART and SPI backends, which do not use vcp.c
+#define VCP_HW_FLOW_CONTROL         0                       // The host pauses the output with CTS (PA0), and RTS (PA1) pauses it with VCP_RX_LINE_SIZE
+#define VCP_LOW_POWER               0                       // Gate the UART clock in sleep, vcp_pre_sleep() holds off tickless idle until it is done
+#define VCP_UART_CLK_SLEEP_DISABLE()    __HAL_RCC_USART2_CLK_SLEEP_DISABLE()
+#define VCP_AUTOBAUD                0                       // vcp_init() steps the baud rate up with log_decode.py --autobaud, each step checked by a CRC'd probe
+#define VCP_AUTOBAUD_RATES          {3000000, 4000000, 6000000, 8000000}    // Tried in this order above the MX_USART2_UART_Init() one (8 Mbauds at most from 64 MHz)
+#define VCP_AUTOBAUD_TIMEOUT_MS     50                      // Longest wait for each host answer, paid once at boot without host tool
+#define VCP_AUTOBAUD_SETTLE_MS      10                      // Time left to the host to switch its own baud rate
+#define VCP_UART_PERIPHCLK          RCC_PERIPHCLK_USART2
+
+
+// Called from the UART interrupt with each received line, without its end of line and NUL terminated
+typedef void (*vcp_rx_handler)(char *pLine, uint32_t length);
 
 
 void vcp_flush(void);
 void vcp_th(void const * argument);
 void vcp_send(void* pData, uint32_t nBytes);
+#if VCP_URGENT_BUFFER_SIZE
+void vcp_send_urgent(void* pData, uint32_t nBytes);   // Not with VCP_ZERO_COPY nor VCP_DIRECT
+#endif
+bool vcp_is_ready(void);
+uint32_t vcp_get_free(void);                        // Bytes that vcp_send() takes without dropping (not with VCP_DIRECT)
+uint32_t vcp_get_dropped_bytes(void);               // Bytes lost because the input buffer was full
+void vcp_panic_send(void* pData, uint32_t nBytes);  // Polls the UART registers, for log_panic_flush() in fault handlers
+#if VCP_RX_LINE_SIZE
+void vcp_set_rx_handler(vcp_rx_handler handler);
+#endif
 void vcp_init(UART_HandleTypeDef *p_huart);
+#if VCP_LOW_POWER
+void vcp_pre_sleep(uint32_t *pIdleTime);            // configPRE_SLEEP_PROCESSING() of tickless idle
+#endif
+
+#if VCP_USE_DMA
+// Must be called from the IRQ handler of VCP_DMA_IRQn
+void vcp_dma_irq_handler(void);
+#endif
+#if VCP_RX_DMA
+// Must be called from the IRQ handler of VCP_RX_DMA_IRQn
+void vcp_rx_dma_irq_handler(void);
+#endif
+#if VCP_USE_DMA || VCP_RX_LINE_SIZE || VCP_TX_IRQ
+// Must be called from the IRQ handler of VCP_UART_IRQn
+void vcp_uart_irq_handler(void);
+#endif
 
 
 #endif
@@ -0,0 +1,290 @@
+/*
+ * flash_log.c
+ *
+ * Log backend that appends the output to the pages of the FLASH_LOG region of the linker script, so
+ * it survives resets and power losses. Pages are used as a ring, each one starts with a double word
+ * header (magic and sequence number) to find the newest one after a reset. The output is buffered in
+ * RAM and programmed at the end of each line, padded to a double word with zero bytes that terminals
+ * ignore (whole double words of each output with LOG_BINARY_OUTPUT), and a page is only erased when
+ * the ring moves to it. The erase stall is then paid once per page and all the pages wear evenly.
+ * The bytes that fail to be programmed are counted by flash_log_dropped() and the ring skips to the
+ * next page.
+ */
+
+
+#include "flash_log.h"
+#include "log.h"
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+
+#define FLASH_LOG_MAGIC             0x474F4C46UL            // "FLOG"
+#define FLASH_LOG_HDR_SIZE          8                       // Magic and sequence number, one double word
+#define FLASH_LOG_ERASED            0xFFFFFFFFFFFFFFFFULL
+#define FLASH_LOG_START             ((uint32_t)__flash_log_start)
+#define FLASH_LOG_N_PAGES           (((uint32_t)__flash_log_end - FLASH_LOG_START) / FLASH_PAGE_SIZE)
+#define FLASH_LOG_PAGE_ADDR(page)   (FLASH_LOG_START + (page) * FLASH_PAGE_SIZE)
+
+
+typedef struct flash_log_hdr_s
+{
+    uint32_t magic;
+    uint32_t seq;                                           // Incremented each time the ring moves to a new page
+} flash_log_hdr_t;
+
+
+extern const uint8_t __flash_log_start[];                   // FLASH_LOG region of the linker script
+extern const uint8_t __flash_log_end[];
+
+static uint8_t              mRow[FLASH_LOG_ROW_SIZE] __attribute__((aligned(8)));
+static uint32_t             mRowLen = 0;
+static uint32_t             mPage = 0;                      // Page being written
+static uint32_t             mPageOffset = 0;                // Offset of the next double word to program in it
+static uint32_t             mSeq = 0;
+static uint32_t             mDropped = 0;
+static bool                 mIsReady = false;
+
+
+static inline const flash_log_hdr_t *flash_log_hdr(uint32_t page)
+{
+    return (const flash_log_hdr_t*)FLASH_LOG_PAGE_ADDR(page);
+}
+
+
+// Returns the offset that follows the last programmed double word of the page. The output never
+// ends with an erased double word (see flash_log_program_row()), so the first one of the free space
+// is the one after the last double word that is not erased.
+static uint32_t flash_log_used(uint32_t page)
+{
+    uint32_t offset = FLASH_PAGE_SIZE;
+
+    while(offset > FLASH_LOG_HDR_SIZE &&
+          *(const volatile uint64_t*)(FLASH_LOG_PAGE_ADDR(page) + offset - 8) == FLASH_LOG_ERASED)
+        offset -= 8;
+    return offset;
+}
+
+
+static inline bool flash_log_is_erased(const uint8_t *pData)
+{
+    uint64_t word;
+
+    memcpy(&word, pData, sizeof(word));
+    return word == FLASH_LOG_ERASED;
+}
+
+
+// Erases the next page of the ring and writes its header, the flash must be unlocked. On failure the
+// page is left full, the next output then tries the following one.
+static bool flash_log_next_page(void)
+{
+    FLASH_EraseInitTypeDef erase = {.TypeErase = FLASH_TYPEERASE_PAGES, .Banks = FLASH_BANK_1, .NbPages = 1};
+    flash_log_hdr_t hdr;
+    uint64_t hdrWord;
+    uint32_t pageError;
+
+    mPage = (mPage + 1) % FLASH_LOG_N_PAGES;
+    mSeq++;
+    mPageOffset = FLASH_LOG_HDR_SIZE;
+
+    hdr.magic = FLASH_LOG_MAGIC;
+    hdr.seq   = mSeq;
+    memcpy(&hdrWord, &hdr, sizeof(hdrWord));
+
+    erase.Page = (FLASH_LOG_PAGE_ADDR(mPage) - FLASH_BASE) / FLASH_PAGE_SIZE;
+    if(HAL_FLASHEx_Erase(&erase, &pageError) != HAL_OK ||
+       HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, FLASH_LOG_PAGE_ADDR(mPage), hdrWord) != HAL_OK)
+    {
+        mPageOffset = FLASH_PAGE_SIZE;
+        return false;
+    }
+    return true;
+}
+
+
+// Programs whole double words, moving to the next page when the current one is full. After a failed
+// erase or programming, the rest of the bytes are dropped and the next output starts a new page.
+static void flash_log_program(const uint8_t *pData, uint32_t nBytes)
+{
+    uint64_t word;
+
+    HAL_FLASH_Unlock();
+    while(nBytes >= sizeof(word))
+    {
+        if(mPageOffset >= FLASH_PAGE_SIZE && !flash_log_next_page())
+            break;
+
+        memcpy(&word, pData, sizeof(word));
+        if(HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, FLASH_LOG_PAGE_ADDR(mPage) + mPageOffset, word) != HAL_OK)
+        {
+            mPageOffset = FLASH_PAGE_SIZE;
+            break;
+        }
+        mPageOffset += sizeof(word);
+        pData       += sizeof(word);
+        nBytes      -= sizeof(word);
+    }
+    mDropped += nBytes;
+    HAL_FLASH_Lock();
+}
+
+
+// Programs the first nBytes of the row (whole double words) but the erased ones at their end, which
+// stay in RAM for the next output: after a reset flash_log_used() could not tell them from the free
+// space, and programming them again would corrupt their ECC. A full row of erased double words, which
+// the text output never has, is dropped.
+static void flash_log_program_row(uint32_t nBytes)
+{
+    uint32_t nProgram = nBytes;
+
+    while(nProgram && flash_log_is_erased(&mRow[nProgram - sizeof(uint64_t)]))
+        nProgram -= sizeof(uint64_t);
+
+    if(nProgram)
+        flash_log_program(mRow, nProgram);
+    else if(nBytes == FLASH_LOG_ROW_SIZE)
+    {
+        mDropped += nBytes;
+        nProgram  = nBytes;
+    }
+    mRowLen -= nProgram;
+    memmove(mRow, &mRow[nProgram], mRowLen);
+}
+
+
+// Output handler for the logger. Programming stalls the CPU while it runs from flash, so it is
+// better registered for the levels that are rare enough, like errors.
+void flash_log_send(void* pData, uint32_t nBytes)
+{
+    uint8_t *pBytes = pData;
+    uint32_t nChunk;
+
+    if(!mIsReady || !nBytes)
+        return;
+
+    while(nBytes)
+    {
+        nChunk = FLASH_LOG_ROW_SIZE - mRowLen;
+        if(nChunk > nBytes)
+            nChunk = nBytes;
+
+        memcpy(&mRow[mRowLen], pBytes, nChunk);
+        mRowLen += nChunk;
+        pBytes  += nChunk;
+        nBytes  -= nChunk;
+
+        if(mRowLen == FLASH_LOG_ROW_SIZE)
+            flash_log_program_row(FLASH_LOG_ROW_SIZE);
+    }
+
+#if !LOG_BINARY_OUTPUT
+    if(pBytes[-1] == '\n')                                  // The line is stored at once
+    {
+        while(mRowLen % sizeof(uint64_t))
+            mRow[mRowLen++] = '\0';
+    }
+#endif
+    flash_log_flush();
+}
+
+
+// Programs the buffered output. A double word can only be programmed once, so the last bytes that
+// do not fill one wait in RAM for the next output.
+void flash_log_flush(void)
+{
+    uint32_t nFlushed = mRowLen & ~(uint32_t)(sizeof(uint64_t) - 1);
+
+    if(!mIsReady || !nFlushed)
+        return;
+
+    flash_log_program_row(nFlushed);
+}
+
+
+// Returns the number of bytes that could not be programmed since the start
+uint32_t flash_log_dropped(void)
+{
+    return mDropped;
+}
+
+
+// Sends the stored output to the handler in chunks of FLASH_LOG_ROW_SIZE bytes, from the oldest page
+// to the newest one. The bytes still buffered in RAM are not included.
+void flash_log_dump(flash_log_out_handler handler)
+{
+    uint32_t i;
+    uint32_t page;
+    uint32_t offset;
+    uint32_t used;
+    uint32_t nChunk;
+
+    if(!mIsReady)
+        return;
+
+    for(i = FLASH_LOG_N_PAGES; i > 0; i--)
+    {
+        page = (mPage + 1 + FLASH_LOG_N_PAGES - i) % FLASH_LOG_N_PAGES;
+        if(flash_log_hdr(page)->magic != FLASH_LOG_MAGIC || flash_log_hdr(page)->seq != mSeq + 1 - i)
+            continue;                                       // Not written since the region was erased
+
+        used = (page == mPage) ? mPageOffset : flash_log_used(page);
+        for(offset = FLASH_LOG_HDR_SIZE; offset < used; offset += nChunk)
+        {
+            nChunk = (used - offset < FLASH_LOG_ROW_SIZE) ? used - offset : FLASH_LOG_ROW_SIZE;
+            handler((void*)(FLASH_LOG_PAGE_ADDR(page) + offset), nChunk);
+        }
+    }
+}
+
+
+void flash_log_erase(void)
+{
+    FLASH_EraseInitTypeDef erase = {.TypeErase = FLASH_TYPEERASE_PAGES, .Banks = FLASH_BANK_1,
+                                    .Page = (FLASH_LOG_START - FLASH_BASE) / FLASH_PAGE_SIZE,
+                                    .NbPages = FLASH_LOG_N_PAGES};
+    uint32_t pageError;
+
+    HAL_FLASH_Unlock();
+    if(HAL_FLASHEx_Erase(&erase, &pageError) != HAL_OK)
+        mSeq += FLASH_LOG_N_PAGES;                          // No page left behind matches the sequence of the new ring
+    mPage   = FLASH_LOG_N_PAGES - 1;                        // The ring restarts at the first page
+    mRowLen = 0;
+    (void)flash_log_next_page();
+    HAL_FLASH_Lock();
+}
+
+
+// Finds the newest page, the output is appended after its last programmed double word
+void flash_log_init(void)
+{
+    const flash_log_hdr_t *pHdr;
+    bool isFound = false;
+    uint32_t page;
+
+    static_assert(!(FLASH_LOG_ROW_SIZE % sizeof(uint64_t)), "Flash log row size must be a multiple of a double word");
+    mRowLen = 0;
+
+    for(page = 0; page < FLASH_LOG_N_PAGES; page++)
+    {
+        pHdr = flash_log_hdr(page);
+        if(pHdr->magic == FLASH_LOG_MAGIC && (!isFound || (int32_t)(pHdr->seq - mSeq) > 0))
+        {
+            mPage   = page;
+            mSeq    = pHdr->seq;
+            isFound = true;
+        }
+    }
+
+    if(isFound)
+        mPageOffset = flash_log_used(mPage);
+    else
+    {
+        mPage = FLASH_LOG_N_PAGES - 1;
+        mSeq  = 0;
+        HAL_FLASH_Unlock();
+        (void)flash_log_next_page();
+        HAL_FLASH_Lock();
+    }
+    mIsReady = true;
+}
@@ -0,0 +1,145 @@
+/*
+ * itm.c
+ *
+ * Log backend writing to a stimulus port of the ITM, which the TPIU sends out on the SWO pin in
+ * hardware: there is neither UART, DMA nor thread, and each word costs a store once the port is
+ * ready. The output is written as 32 bit stimulus words, with byte and half word writes only at the
+ * unaligned ends. Text goes to ITM_TEXT_PORT and binary records to ITM_BINARY_PORT, so that a viewer
+ * of port 0 is not fed with records. Nothing is sent while the debugger has the port disabled, so the
+ * target runs the same without probe. The Cortex-M0+ of the STM32G071 has no ITM, this is for the
+ * Cortex-M3 and above ports.
+ */
+
+
+#include "itm.h"
+#include "log.h"
+#include <stdint.h>
+#include <string.h>
+
+#if ITM_BACKEND
+
+
+#if !defined(__CORTEX_M) || __CORTEX_M < 3
+#error "ITM_BACKEND needs the ITM of a Cortex-M3 or above"
+#endif
+
+
+#if LOG_BINARY_OUTPUT
+#define ITM_PORT                    ITM_BINARY_PORT
+#else
+#define ITM_PORT                    ITM_TEXT_PORT
+#endif
+#define ITM_LAR_KEY                 0xC5ACCE55UL            // Unlocks the ITM registers
+#define ITM_TRACE_BUS_ID            1
+#define ITM_TPIU_NRZ                2                       // Asynchronous SWO encoding of the TPIU
+
+
+static uint32_t             mDroppedBytes = 0;
+
+
+static inline bool itm_is_enabled(void)
+{
+    return (ITM->TCR & ITM_TCR_ITMENA_Msk) && (ITM->TER & (1UL << ITM_PORT));
+}
+
+
+// Bit 0 of a stimulus port read is set once its FIFO has room for a write
+static inline bool itm_port_wait(void)
+{
+    while(!(ITM->PORT[ITM_PORT].u32 & 1))
+    {
+        if(!itm_is_enabled())
+            return false;
+    }
+    return true;
+}
+
+
+void itm_send(void* pData, uint32_t nBytes)
+{
+    const uint8_t *pBytes = pData;
+    uint32_t word;
+
+    if(!itm_is_enabled())
+    {
+        mDroppedBytes += nBytes;
+        return;
+    }
+
+    // Byte writes up to a word boundary of the source, then whole words
+    while(nBytes && ((uintptr_t)pBytes & 3))
+    {
+        if(!itm_port_wait())
+            goto dropped;
+        ITM->PORT[ITM_PORT].u8 = *pBytes++;
+        nBytes--;
+    }
+    while(nBytes >= sizeof(uint32_t))
+    {
+        memcpy(&word, pBytes, sizeof(word));
+        if(!itm_port_wait())
+            goto dropped;
+        ITM->PORT[ITM_PORT].u32 = word;
+        pBytes += sizeof(word);
+        nBytes -= sizeof(word);
+    }
+    if(nBytes >= sizeof(uint16_t))
+    {
+        if(!itm_port_wait())
+            goto dropped;
+        ITM->PORT[ITM_PORT].u16 = pBytes[0] | (pBytes[1] << 8);
+        pBytes += sizeof(uint16_t);
+        nBytes -= sizeof(uint16_t);
+    }
+    if(nBytes)
+    {
+        if(!itm_port_wait())
+            goto dropped;
+        ITM->PORT[ITM_PORT].u8 = *pBytes;
+    }
+    return;
+
+dropped:
+    mDroppedBytes += nBytes;
+}
+
+
+// The FIFO of the ITM holds a few words only, the logger goes on as soon as it has room
+bool itm_is_ready(void)
+{
+    return !itm_is_enabled() || (ITM->PORT[ITM_PORT].u32 & 1);
+}
+
+
+// Waits until the ITM has passed all its words to the TPIU
+void itm_flush(void)
+{
+    while(itm_is_enabled() && (ITM->TCR & ITM_TCR_BUSY_Msk))
+        ;
+}
+
+
+uint32_t itm_get_dropped_bytes(void)
+{
+    return mDroppedBytes;
+}
+
+
+// Sets up the TPIU for NRZ at ITM_SWO_HZ from the core clock and enables the port, as the SWO viewers
+// of the debug probes do. The pin itself is the SWO alternate function of the part.
+void itm_init(void)
+{
+#if ITM_SWO_HZ
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    TPI->SPPR = ITM_TPIU_NRZ;
+    TPI->ACPR = SystemCoreClock / ITM_SWO_HZ - 1;
+    TPI->FFCR = TPI_FFCR_TrigIn_Msk;    // Formatter off, the ITM packets go out as they are
+    ITM->LAR  = ITM_LAR_KEY;
+    ITM->TCR  = (ITM_TRACE_BUS_ID << ITM_TCR_TraceBusID_Pos) | ITM_TCR_SWOENA_Msk | ITM_TCR_SYNCENA_Msk |
+                ITM_TCR_ITMENA_Msk;
+    ITM->TPR  = 0;                      // Unprivileged writes allowed
+    ITM->TER |= 1UL << ITM_PORT;
+#endif
+}
+
+#endif
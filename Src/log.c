@@ -1,19 +1,25 @@
 
 #include "log.h"
+#include "log_fifo.h"
+#include "log_trace.h"
+#include "log_prof.h"
+#include "log_metric.h"
+#include "log_watch.h"
+#include "log_queue.h"
+#include "log_probe.h"
 
 #include <string.h>
 #include <stdbool.h>
 #include <assert.h>
 
-#include "main.h"
-#include "cmsis_os.h"
+#include "log_port.h"
 
 
 
 #define LOG_ARRAY_N_ELEM(x)     (sizeof(x)/sizeof((x)[0]))
 
 
-#if LOG_SUPPORT_ANSI_COLOR
+#if LOG_SUPPORT_ANSI_COLOR && !LOG_BINARY_OUTPUT
 #define LOG_ANSI_PREFIX         "\x1B["
 #define LOG_ANSI_SUFFIX         'm'
 
@@ -31,294 +37,7596 @@ static const char ansiColors[_LOG_COLOR_LEN][2] = {
 #endif
 
 
-typedef struct log_fifo_item_s
+#if LOG_BUFFER_REFS && (LOG_FLIGHT_RECORDER || LOG_POST_MORTEM)
+#error "LOG_BUFFER_REFS records must be output to release their buffer, without flight recorder nor post mortem"
+#endif
+#if LOG_CUSTOM_TYPES && !LOG_COPY_ARENA_SIZE
+#error "LOG_CUSTOM_TYPES requires LOG_COPY_ARENA_SIZE"
+#endif
+#if LOG_PRINTF && (!LOG_COPY_ARENA_SIZE || LOG_CUSTOM_TYPES > 255)
+#error "LOG_PRINTF requires LOG_COPY_ARENA_SIZE, and its record type ID is above the ones of LOG_CUSTOM_TYPES"
+#endif
+#if LOG_INTERN_STRINGS && !LOG_BINARY_OUTPUT
+#error "LOG_INTERN_STRINGS requires LOG_BINARY_OUTPUT"
+#endif
+#if LOG_ARRAY_DELTA && (!LOG_BINARY_OUTPUT || !(LOG_BULK_ARRAYS || LOG_COPY_ARENA_SIZE))
+#error "LOG_ARRAY_DELTA requires LOG_BINARY_OUTPUT and array records (LOG_BULK_ARRAYS or LOG_COPY_ARENA_SIZE)"
+#endif
+#if LOG_LINE_PREFIX && LOG_BINARY_OUTPUT
+#error "LOG_LINE_PREFIX is only for the text output, the host decorates the binary records"
+#endif
+#if LOG_ARRAY_CHUNK_ELEMS && (!LOG_BULK_ARRAYS || LOG_INSTANCES)
+#error "LOG_ARRAY_CHUNK_ELEMS requires LOG_BULK_ARRAYS, without LOG_INSTANCES"
+#endif
+#if LOG_FIFO_SPARE_RAM && LOG_PER_CONTEXT_FIFOS
+#error "LOG_FIFO_SPARE_RAM sizes the single input FIFO, not the ones of LOG_PER_CONTEXT_FIFOS"
+#endif
+#if LOG_POWER_FAIL_SAVE && !LOG_POST_MORTEM
+#error "LOG_POWER_FAIL_SAVE saves the .noinit FIFOs of LOG_POST_MORTEM"
+#endif
+#if LOG_RTC_ANCHOR_MS && (!LOG_TIMESTAMPS || LOG_RTC_ANCHOR_MS * (LOG_TIMESTAMP_HZ / 1000) >= 0x80000000)
+#error "LOG_RTC_ANCHOR_MS dates the LOG_TIMESTAMPS ticks, its period must be below half the wrap of LOG_TIMESTAMP_GET()"
+#endif
+#if LOG_RENDER_PING_PONG && !LOG_RENDER_BUFFER_SIZE
+#error "LOG_RENDER_PING_PONG requires LOG_RENDER_BUFFER_SIZE"
+#endif
+#if LOG_COMPRESS && LOG_COMPRESS_WINDOW > 1024
+#error "LOG_COMPRESS_WINDOW must fit in the 10 bit distance of the compression matches"
+#endif
+#if LOG_FLIGHT_RECORDER && (LOG_FIFO_MODE != LOG_FIFO_LOCKED || LOG_FIFO_PACKED || LOG_PER_CONTEXT_FIFOS || \
+                            LOG_COPY_ARENA_SIZE || LOG_WAKEUP_FILL_PERCENT || LOG_ERROR_RESERVE)
+#error "LOG_FLIGHT_RECORDER requires a single LOG_FIFO_LOCKED FIFO of fixed size items, without copy arena, wakeup or reserve"
+#endif
+#if LOG_ERROR_FIFO_N_ELEM && (LOG_PER_CONTEXT_FIFOS || LOG_FLIGHT_RECORDER)
+#error "LOG_ERROR_FIFO_N_ELEM adds a FIFO to the single input FIFO, it does not work with LOG_PER_CONTEXT_FIFOS nor LOG_FLIGHT_RECORDER"
+#endif
+#if LOG_FLIGHT_RECORDER && LOG_TRIGGER_PRE_ITEMS + LOG_TRIGGER_POST_ITEMS > LOG_INPUT_FIFO_N_ELEM
+#error "LOG_TRIGGER_PRE_ITEMS and LOG_TRIGGER_POST_ITEMS must fit together in the input FIFO"
+#endif
+#if LOG_CONTEXT_IDS && LOG_BINARY_OUTPUT
+#error "LOG_CONTEXT_IDS names are only printed in text mode"
+#endif
+#if LOG_CONTEXT_QUOTA && (!LOG_CONTEXT_IDS || LOG_FLIGHT_RECORDER)
+#error "LOG_CONTEXT_QUOTA counts the items of each LOG_CONTEXT_IDS context, the flight recorder overwrites them uncounted"
+#endif
+#if LOG_CONTEXT_IDS && (LOG_CONTEXT_TLS_INDEX >= configNUM_THREAD_LOCAL_STORAGE_POINTERS || LOG_CONTEXT_N_TASKS >= 0x7F)
+#error "LOG_CONTEXT_IDS requires a LOG_CONTEXT_TLS_INDEX below configNUM_THREAD_LOCAL_STORAGE_POINTERS and less than 127 tasks"
+#endif
+#if LOG_MASK_BASEPRI && !(defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__))
+#error "LOG_MASK_BASEPRI requires a core with BASEPRI (Cortex-M3 and above), Cortex-M0/M0+/M23 only have PRIMASK"
+#endif
+#if LOG_FIFO_LOCK_FREE && !(defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__))
+#error "LOG_FIFO_LOCK_FREE requires LDREX/STREX (Cortex-M3 and above), Cortex-M0/M0+ only have PRIMASK"
+#endif
+#if LOG_FIFO_LOCK_FREE && (LOG_FIFO_MODE != LOG_FIFO_MPSC || LOG_FIFO_PACKED || LOG_PER_CONTEXT_FIFOS || LOG_COPY_ARENA_SIZE)
+#error "LOG_FIFO_LOCK_FREE requires a single LOG_FIFO_MPSC FIFO of fixed size items, without copy arena"
+#endif
+#if LOG_SEQUENCE_NUMBERS && LOG_FIFO_LOCK_FREE
+#error "LOG_SEQUENCE_NUMBERS requires the FIFO reservations under a lock, not LOG_FIFO_LOCK_FREE"
+#endif
+#if LOG_INSTANCES && (LOG_BINARY_OUTPUT || LOG_COMPRESS || LOG_PACKETS || LOG_FLIGHT_RECORDER)
+#error "LOG_INSTANCES requires text output, without compression, packets nor flight recorder"
+#endif
+#if LOG_INSTANCES && LOG_SEQUENCE_NUMBERS
+#error "LOG_SEQUENCE_NUMBERS can not be used with LOG_INSTANCES, their items would take numbers of the default stream"
+#endif
+#if LOG_MASK_BASEPRI && !defined(configMAX_SYSCALL_INTERRUPT_PRIORITY)
+#error "LOG_MASK_BASEPRI requires configMAX_SYSCALL_INTERRUPT_PRIORITY in FreeRTOSConfig.h"
+#endif
+#if LOG_IDLE_HOOK_ITEMS && (!configUSE_IDLE_HOOK || LOG_WAKEUP_FILL_PERCENT || LOG_FLIGHT_RECORDER)
+#error "LOG_IDLE_HOOK_ITEMS requires configUSE_IDLE_HOOK, without wakeup nor flight recorder as there is no logger thread"
+#endif
+#if LOG_BOOST_FILL_PERCENT && (LOG_IDLE_HOOK_ITEMS || LOG_FLIGHT_RECORDER || LOG_BOOST_RESTORE_PERCENT >= LOG_BOOST_FILL_PERCENT)
+#error "LOG_BOOST_FILL_PERCENT requires the logger thread draining the FIFO and a lower LOG_BOOST_RESTORE_PERCENT"
+#endif
+#if LOG_GOVERNOR && (!LOG_RUNTIME_LEVELS || LOG_IDLE_HOOK_ITEMS || LOG_FLIGHT_RECORDER || \
+                     LOG_GOVERNOR_MIN_LEVEL < LOG_LEVEL_ERROR || LOG_GOVERNOR_LOW_PERCENT >= LOG_GOVERNOR_HIGH_PERCENT)
+#error "LOG_GOVERNOR requires LOG_RUNTIME_LEVELS, the logger thread draining the FIFO and a lower LOG_GOVERNOR_LOW_PERCENT"
+#endif
+#if LOG_CPU_BUDGET_PERCENT && (LOG_IDLE_HOOK_ITEMS || LOG_FLIGHT_RECORDER || LOG_CPU_BUDGET_PERCENT > 100 || \
+                               LOG_CPU_BUDGET_WINDOW_TICKS > UINT32_MAX / 100 || !LOG_CPU_BUDGET_PASS_ITEMS)
+#error "LOG_CPU_BUDGET_PERCENT requires the logger thread draining the FIFO, a percentage and a window below 2^32 / 100 ticks"
+#endif
+#if LOG_LATENCY && (!LOG_TIMESTAMPS || !LOG_STATS || LOG_INSTANCES || LOG_N_BACKENDS > 1 || !LOG_LATENCY_N_BINS)
+#error "LOG_LATENCY requires LOG_TIMESTAMPS, LOG_STATS and a single output handler"
+#endif
+#if LOG_HISTORY_SIZE && (LOG_BINARY_OUTPUT || LOG_COMPRESS || LOG_PACKETS || LOG_FLIGHT_RECORDER)
+#error "LOG_HISTORY_SIZE requires the text output, without compression nor packets, and no flight recorder"
+#endif
+#if LOG_DELEGATED_FLUSH && (LOG_IDLE_HOOK_ITEMS || LOG_FLIGHT_RECORDER)
+#error "LOG_DELEGATED_FLUSH requires the logger thread draining the FIFO"
+#endif
+#if LOG_OVERFLOW_BLOCK && (LOG_IDLE_HOOK_ITEMS || LOG_FLIGHT_RECORDER || !LOG_OVERFLOW_BLOCK_TASKS)
+#error "LOG_OVERFLOW_BLOCK requires the logger thread draining the FIFO and LOG_OVERFLOW_BLOCK_TASKS"
+#endif
+#if LOG_RTOS_TRACE && (!(LOG_BINARY_OUTPUT || LOG_SYSVIEW) || !LOG_TIMESTAMPS)
+#error "LOG_RTOS_TRACE requires LOG_BINARY_OUTPUT or LOG_SYSVIEW, and LOG_TIMESTAMPS"
+#endif
+#if LOG_SYSVIEW && (LOG_BINARY_OUTPUT || !LOG_TIMESTAMPS || LOG_SUPPORT_ANSI_COLOR || LOG_CONTEXT_IDS || LOG_SEQUENCE_NUMBERS || \
+                    LOG_LINE_PREFIX || LOG_RTC_ANCHOR_MS || LOG_COMPRESS || LOG_PACKETS || LOG_INSTANCES || LOG_HISTORY_SIZE || \
+                    LOG_N_BACKENDS > 1)
+#error "LOG_SYSVIEW encodes the timestamped text lines itself, without colors, line prefixes, other encodings, instances, history nor backends"
+#endif
+#if (LOG_TASK_STATS || LOG_STACK_STATS || LOG_TASK_SNAPSHOT || LOG_PROF || LOG_METRICS || LOG_WATCH || LOG_QUEUE_MONITOR) && \
+    (LOG_IDLE_HOOK_ITEMS || LOG_FLIGHT_RECORDER || LOG_LOW_POWER)
+#error "The task stats, the profiler, the metrics, the watch list and the queue monitor require the logger thread polling the FIFO"
+#endif
+#if LOG_LOW_POWER && (LOG_IDLE_HOOK_ITEMS || LOG_FLIGHT_RECORDER)
+#error "LOG_LOW_POWER requires the logger thread draining the FIFO, the flight recorder one already sleeps until a capture"
+#endif
+#if LOG_CONST_NUMBERS && (LOG_BINARY_OUTPUT || LOG_FIFO_PACKED)
+#error "LOG_CONST_NUMBERS requires text output and the 4 characters of unpacked FIFO items"
+#endif
+#if LOG_FIFO_SPLIT && (LOG_FIFO_MODE != LOG_FIFO_LOCKED || LOG_FIFO_PACKED || LOG_FIFO_SPARE_RAM || LOG_INSTANCES)
+#error "LOG_FIFO_SPLIT requires the LOG_FIFO_LOCKED FIFO of items in its own buffers"
+#endif
+
+
+// Producers notify the log thread when an input FIFO reaches LOG_WAKEUP_LEVEL percent. With
+// LOG_LOW_POWER it sleeps without timeout when the FIFOs are empty, so the first item wakes it up.
+#define LOG_THREAD_WAKEUP           (LOG_WAKEUP_FILL_PERCENT || LOG_LOW_POWER)
+#define LOG_WAKEUP_LEVEL            (LOG_LOW_POWER ? 0 : LOG_WAKEUP_FILL_PERCENT)
+
+
+// Input FIFO critical sections, with LOG_BENCH the longest one is measured and with LOG_PROBES
+// LOG_PROBE_CRITICAL_PIN is high during each.
+#if LOG_BENCH
+static uint32_t mBenchIrqOffStart;
+static uint32_t mBenchIrqOffMax = 0;
+
+#define LOG_ENTER_CRITICAL(primaskBit)  do { LOG_MASK_SAVE(primaskBit);                                  \
+                                             LOG_PROBE_HIGH(LOG_PROBE_CRITICAL_PIN);                     \
+                                             mBenchIrqOffStart = LOG_TIMESTAMP_GET(); } while(0)
+#define LOG_EXIT_CRITICAL(primaskBit)   do { uint32_t irqOff = LOG_TIMESTAMP_GET() - mBenchIrqOffStart;  \
+                                             if(irqOff > mBenchIrqOffMax)                                \
+                                                 mBenchIrqOffMax = irqOff;                               \
+                                             LOG_PROBE_LOW(LOG_PROBE_CRITICAL_PIN);                      \
+                                             LOG_MASK_RESTORE(primaskBit); } while(0)
+#else
+#define LOG_ENTER_CRITICAL(primaskBit)  do { LOG_MASK_SAVE(primaskBit);                                  \
+                                             LOG_PROBE_HIGH(LOG_PROBE_CRITICAL_PIN); } while(0)
+#define LOG_EXIT_CRITICAL(primaskBit)   do { LOG_PROBE_LOW(LOG_PROBE_CRITICAL_PIN);                      \
+                                             LOG_MASK_RESTORE(primaskBit); } while(0)
+#endif
+
+// Critical sections of the puts into the input FIFOs. With LOG_ISR_UNMASKED the log_*_from_isr()
+// calls skip them, no other producer can preempt those.
+#if LOG_ISR_UNMASKED
+#define LOG_ENTER_PUT_CRITICAL(primaskBit)  do { (primaskBit) = 0;                                       \
+                                                 if(!_logFromIsr)                                        \
+                                                     LOG_ENTER_CRITICAL(primaskBit); } while(0)
+#define LOG_EXIT_PUT_CRITICAL(primaskBit)   do { if(!_logFromIsr)                                        \
+                                                     LOG_EXIT_CRITICAL(primaskBit); } while(0)
+#else
+#define LOG_ENTER_PUT_CRITICAL(primaskBit)  LOG_ENTER_CRITICAL(primaskBit)
+#define LOG_EXIT_PUT_CRITICAL(primaskBit)   LOG_EXIT_CRITICAL(primaskBit)
+#endif
+
+
+#if LOG_COMPRESS
+#define LOG_COMPRESS_OUT_SIZE       128             // Encoded bytes sent to the output handler at once
+#define LOG_COMPRESS_HASH_SIZE      256             // Last position seen for each hash of 3 bytes (power of 2)
+#define LOG_COMPRESS_MIN_MATCH      3
+#define LOG_COMPRESS_MAX_MATCH      (LOG_COMPRESS_MIN_MATCH + 31)   // Length - 3 in the 5 bits of a match token
+#define LOG_COMPRESS_MAX_LITERALS   128             // Count - 1 in the 7 bits of a literal token
+#define LOG_COMPRESS_SYNC           "\xFF\xFFLZ"    // Resync marker, its first 2 bytes are never a match token
+#endif
+
+#if LOG_PACKETS
+#define LOG_PACKET_RAW_SIZE         (2 + LOG_PACKET_PAYLOAD + 4)    // Sequence number, payload and CRC-32
+#define LOG_PACKET_OUT_SIZE         (LOG_PACKET_RAW_SIZE + LOG_PACKET_RAW_SIZE / 254 + 3)   // Plus COBS codes and delimiters
+#define LOG_PACKET_CRC_DR8          (*(volatile uint8_t*)&CRC->DR)  // Byte access, one CRC step per byte
+#define LOG_PACKET_CRC_CR           (CRC_CR_REV_IN_0 | CRC_CR_REV_OUT)  // Reflected in and out, as zlib
+#endif
+
+// Copied to RAM by the startup code with .data, see __log_ramfunc_size in the linker script. Calls
+// between flash and RAM are out of range of BL, the linker inserts veneers for them.
+#if LOG_RAM_FUNCTIONS
+#define LOG_RAMFUNC                 __attribute__((section(".RamFunc.log")))
+#else
+#define LOG_RAMFUNC
+#endif
+
+#if LOG_POST_MORTEM
+#define LOG_NOINIT                  __attribute__((section(".noinit.log")))     // Not cleared by the startup code
+#define LOG_POST_MORTEM_MAGIC       0x4C4F4721UL    // "LOG!"
+#define LOG_POST_MORTEM_MARK        "\r\n--- Reset ---\r\n"
+#else
+#define LOG_NOINIT
+#endif
+
+#if LOG_PRINTF
+#define LOG_PRINTF_TYPE_ID          0xFF            // log_custom() type ID of the log_printf() records
+#define LOG_PRINTF_MAX_WORDS        17              // Format and up to 16 arguments
+#endif
+
+#if LOG_CONTEXT_IDS
+#define LOG_CONTEXT_ID_MAIN         0               // Logged before the scheduler started
+#define LOG_CONTEXT_ID_UNKNOWN      0x7F            // Task beyond LOG_CONTEXT_N_TASKS, tasks use 1 to LOG_CONTEXT_N_TASKS
+#define LOG_CONTEXT_ID_ISR          0x80            // Or'ed with the exception number of IPSR
+#endif
+
+
+// Writes the item number idx of a group stored with log_fifo_put_n()
+typedef void (*log_fifo_fill_t)(log_fifo_item_t *pItem, uint32_t idx, const void *pCtx);
+
+#if LOG_ERROR_RESERVE
+// Room that an item must leave free in the FIFO, errors can take all of it
+static inline uint32_t log_fifo_reserve(const log_fifo_item_t *pItem)
+{
+    return (pItem->level == LOG_LEVEL_ERROR) ? 0 : LOG_ERROR_RESERVE;
+}
+
+// Same for a group of log_fifo_put_n(), which has the level of its first item
+static inline uint32_t log_fifo_reserve_n(log_fifo_fill_t fill, const void *pCtx)
+{
+    log_fifo_item_t item;
+
+    fill(&item, 0, pCtx);
+    return log_fifo_reserve(&item);
+}
+#else
+#define log_fifo_reserve(pItem)         0
+#define log_fifo_reserve_n(fill, pCtx)  0
+#endif
+
+
+#if LOG_FIFO_HAS_COMMIT_FLAGS
+#define LOG_FIFO_COMMIT_FLAGS(x)    (x)
+#else
+#define LOG_FIFO_COMMIT_FLAGS(x)    NULL
+#endif
+
+#if LOG_COPY_ARENA_SIZE
+#define LOG_FIFO_ARENA(x)           (x)
+#else
+#define LOG_FIFO_ARENA(x)           NULL
+#endif
+
+
+#if LOG_PER_CONTEXT_FIFOS && LOG_FIFO_MODE == LOG_FIFO_SPSC
+#error "LOG_PER_CONTEXT_FIFOS requires several producers per FIFO, use LOG_FIFO_LOCKED or LOG_FIFO_MPSC"
+#endif
+
+
+#if LOG_PER_CONTEXT_FIFOS
+static log_fifo_slot_t       isrFifoBuffer[LOG_FIFO_N_SLOTS(LOG_ISR_FIFO_N_ELEM)] LOG_NOINIT;
+static log_fifo_slot_t       taskFifoBuffers[LOG_N_TASK_FIFOS][LOG_FIFO_N_SLOTS(LOG_INPUT_FIFO_N_ELEM)] LOG_NOINIT;
+#if LOG_FIFO_HAS_COMMIT_FLAGS
+static volatile bool         isrFifoCommitted[LOG_ISR_FIFO_N_ELEM] LOG_NOINIT;
+static volatile bool         taskFifosCommitted[LOG_N_TASK_FIFOS][LOG_INPUT_FIFO_N_ELEM] LOG_NOINIT;
+#endif
+#if LOG_COPY_ARENA_SIZE
+static uint8_t               isrFifoArena[LOG_COPY_ARENA_SIZE] __attribute__((aligned(4))) LOG_NOINIT;
+static uint8_t               taskFifoArenas[LOG_N_TASK_FIFOS][LOG_COPY_ARENA_SIZE] __attribute__((aligned(4))) LOG_NOINIT;
+#endif
+static log_fifo_t            isrFifo LOG_NOINIT;
+static log_fifo_t            taskFifos[LOG_N_TASK_FIFOS] LOG_NOINIT;
+#else
+#if LOG_FIFO_SPARE_RAM
+extern log_fifo_slot_t       __log_fifo_start[];    // .log_fifo region of the RAM left after the other sections
+extern uint8_t               __log_fifo_end[];
+#define logFifoBuffer        __log_fifo_start
+#define logFifoCommitted     ((volatile bool*)&__log_fifo_start[log_fifo_spare_slots()])    // Right after the slots
+#define LOG_FIFO_BUFFER_SLOTS   log_fifo_spare_slots()
+#else
+static log_fifo_slot_t       logFifoBuffer[LOG_FIFO_N_SLOTS(LOG_INPUT_FIFO_N_ELEM)] LOG_NOINIT;
+#if LOG_FIFO_HAS_COMMIT_FLAGS
+static volatile bool         logFifoCommitted[LOG_INPUT_FIFO_N_ELEM] LOG_NOINIT;
+#endif
+#define LOG_FIFO_BUFFER_SLOTS   LOG_ARRAY_N_ELEM(logFifoBuffer)
+#endif
+#if LOG_COPY_ARENA_SIZE
+static uint8_t               logFifoArena[LOG_COPY_ARENA_SIZE] __attribute__((aligned(4))) LOG_NOINIT;
+#endif
+#if LOG_ERROR_FIFO_N_ELEM
+static log_fifo_slot_t       errorFifoBuffer[LOG_FIFO_N_SLOTS(LOG_ERROR_FIFO_N_ELEM)] LOG_NOINIT;
+#if LOG_FIFO_HAS_COMMIT_FLAGS
+static volatile bool         errorFifoCommitted[LOG_ERROR_FIFO_N_ELEM] LOG_NOINIT;
+#endif
+#if LOG_COPY_ARENA_SIZE
+static uint8_t               errorFifoArena[LOG_COPY_ARENA_SIZE] __attribute__((aligned(4))) LOG_NOINIT;
+#endif
+static log_fifo_t            errorFifo LOG_NOINIT;
+static log_fifo_t           *mLineFifo = NULL;      // FIFO of the line being output, until its end
+#endif
+#if LOG_INLINE_PRODUCERS
+log_fifo_t                   _logFifo LOG_NOINIT;   // Also written by _log_var_inline() of log_fifo.h
+#define logFifo              _logFifo
+#else
+static log_fifo_t            logFifo LOG_NOINIT;
+#endif
+#endif
+#if LOG_POST_MORTEM
+static struct
+{
+    uint32_t magic;                     // LOG_POST_MORTEM_MAGIC if the FIFOs were saved before the reset
+    uint32_t crc;                       // CRC-32 of the FIFOs when they were saved
+} mPostMortem LOG_NOINIT;
+#endif
+static log_out_handler       mPrintHandler = NULL;
+static log_out_flush_handler mFlushHandler = NULL;
+static log_out_ready_handler mReadyHandler = NULL;
+#if LOG_ERROR_FIFO_N_ELEM && !LOG_BINARY_OUTPUT
+static log_out_handler       mUrgentHandler = NULL;     // Takes the output of the error FIFO if set
+static bool                  mIsUrgentOutput = false;   // The item being output comes from the error FIFO
+#endif
+static bool                  mIsEarlyInit = false;  // log_early_init() set up the FIFOs for the next log_init()
+#if LOG_BOOT_MARKS
+static uint32_t              mBootMarkUs = 0;       // Time of the previous LOG_BOOT_MARK(), since HAL_Init()
+#endif
+#if LOG_N_BACKENDS > 1
+static struct
+{
+    log_out_handler       print;
+    log_out_flush_handler flush;
+    uint32_t              levelMask;    // LOG_LEVEL_BIT() of each accepted level
+    char                 *pRender;      // Optional, output is batched here before calling print
+    uint32_t              renderSize;
+    uint32_t              renderLen;
+}                            mBackends[LOG_N_BACKENDS - 1];     // The one of log_init() is not in the array
+static volatile uint32_t     mNumBackends = 0;
+static uint32_t              mOutLevelBit = UINT32_MAX;     // Level of the item being processed, all bits if it has none
+#endif
+#if LOG_RENDER_BUFFER_SIZE
+static char                  mRenderBuffers[LOG_RENDER_PING_PONG ? 2 : 1][LOG_RENDER_BUFFER_SIZE];
+static char                 *mRenderBuffer = mRenderBuffers[0];
+static uint32_t              mRenderLen = 0;
+#endif
+#if LOG_COMPRESS
+static uint8_t               mCompressWindow[LOG_COMPRESS_WINDOW];     // Last bytes entered, by free running position
+static uint16_t              mCompressHash[LOG_COMPRESS_HASH_SIZE];
+static uint32_t              mCompressPos = 0;  // Bytes entered since log_init(), the host decoder counts the same
+static uint32_t              mCompressBase = 0; // Position of the last resync marker, matches do not go further back
+static uint8_t               mCompressOutBuffers[LOG_RENDER_PING_PONG ? 2 : 1][LOG_COMPRESS_OUT_SIZE];
+static uint8_t              *mCompressOut = mCompressOutBuffers[0];
+static uint32_t              mCompressOutLen = 0;
+#endif
+#if LOG_PACKETS
+static uint8_t               mPacketBuffers[LOG_RENDER_PING_PONG ? 2 : 1][LOG_PACKET_OUT_SIZE];
+static uint8_t              *mPacketOut = mPacketBuffers[0];
+static uint32_t              mPacketLen = 0;
+static uint32_t              mPacketCodeIdx = 0;    // Where the COBS code of the current block goes
+static uint16_t              mPacketSeq = 0;
+#endif
+#if LOG_THREAD_WAKEUP || LOG_FLIGHT_RECORDER || LOG_BOOST_FILL_PERCENT || LOG_DELEGATED_FLUSH || LOG_OVERFLOW_BLOCK
+static TaskHandle_t volatile mLogTask = NULL;
+#endif
+#if LOG_SEQ_ITEMS
+static uint16_t              mSeq LOG_NOINIT;       // Insertion order of the items, set by log_input_init()
+#endif
+#if LOG_DELEGATED_FLUSH
+static TaskHandle_t volatile mFlushTask = NULL;     // Waiting in log_flush() for the log thread
+static SemaphoreHandle_t     mFlushDone;            // Given by the log thread when the flush of mFlushTask is done
+static StaticSemaphore_t     mFlushDoneBuffer;
+#endif
+#if LOG_OVERFLOW_BLOCK
+enum log_overflow_slot
+{
+    LOG_OVERFLOW_FREE,
+    LOG_OVERFLOW_WAITING,                       // A task waits for room in an input FIFO
+    LOG_OVERFLOW_GIVEN                          // The log thread gives or gave the semaphore of the slot
+};
+
+static volatile uint8_t      mOverflowSlots[LOG_OVERFLOW_BLOCK_TASKS];
+static SemaphoreHandle_t     mOverflowSems[LOG_OVERFLOW_BLOCK_TASKS];
+static StaticSemaphore_t     mOverflowSemBuffers[LOG_OVERFLOW_BLOCK_TASKS];
+#endif
+#if LOG_BOOST_FILL_PERCENT
+static UBaseType_t           mLogPriority;      // Of the log thread when it is not boosted
+static volatile bool         mIsBoosted = false;
+#endif
+#if LOG_THREAD_WAKEUP
+static volatile bool         mIsWakeupPending = false;
+#endif
+#if LOG_FLIGHT_RECORDER
+static volatile enum
+{
+    LOG_RECORDER_RECORDING,             // The oldest items are overwritten
+    LOG_RECORDER_POST_TRIGGER,          // Storing the items that follow log_trigger()
+    LOG_RECORDER_CAPTURED,              // Frozen, the log thread is not notified yet
+    LOG_RECORDER_OUTPUT                 // Frozen until the log thread has output the capture
+}                            mRecorderState = LOG_RECORDER_RECORDING;
+static uint32_t              mRecorderPostLeft;
+#endif
+#if LOG_STATS
+static log_stats_t           mStats;
+#endif
+#if LOG_RTOS_TRACE
+static volatile bool         mIsTraceOn = false;    // Set once the input FIFOs are initialized
+#endif
+#if LOG_TASK_STATS || LOG_STACK_STATS || LOG_TASK_SNAPSHOT
+static TaskStatus_t          mTaskStatus[LOG_TASK_STATS_MAX_TASKS];
+#endif
+#if LOG_TASK_STATS
+static UBaseType_t           mTaskStatsNumbers[LOG_TASK_STATS_MAX_TASKS];  // xTaskNumber and run time of the tasks
+static uint32_t              mTaskStatsRunTimes[LOG_TASK_STATS_MAX_TASKS]; // at the previous report
+static uint32_t              mTaskStatsNTasks;
+static uint32_t              mTaskStatsTotal;
+static TickType_t            mTaskStatsTick;
+#endif
+#if LOG_TASK_SNAPSHOT
+static volatile bool         mIsSnapshotRequested = false;
+#endif
+#if LOG_STACK_STATS
+static UBaseType_t           mStackStatsNumbers[LOG_TASK_STATS_MAX_TASKS]; // xTaskNumber and free stack of the tasks
+static configSTACK_DEPTH_TYPE mStackStatsFree[LOG_TASK_STATS_MAX_TASKS];    // at the previous report
+static uint32_t              mStackStatsNTasks;
+static TickType_t            mStackStatsTick;
+#endif
+#if LOG_INSTANCES
+static log_ctx_t * volatile  mInstances = NULL;             // Last one of log_ctx_init(), linked by pNext
+#endif
+#if LOG_COLOR_ON_CHANGE && LOG_SUPPORT_ANSI_COLOR && !LOG_BINARY_OUTPUT
+static enum log_color        mLastColor = _LOG_COLOR_LEN;   // Not a color, the first one is always sent
+#endif
+#if LOG_RUNTIME_LEVELS
+volatile uint32_t            _logLevelModules[LOG_LEVEL_DEBUG + 1] = { [0 ... LOG_LEVEL_DEBUG] = 0xFFFFFFFFUL };
+#endif
+uint32_t                     _logSampleState = 2463534242UL;     // Any value but 0
+#if LOG_ISR_UNMASKED
+volatile bool                _logFromIsr = false;
+#endif
+
+
+
+#if LOG_COPY_ARENA_SIZE
+// Must be called with the same synchronization used to reserve the FIFO slot of the data,
+// so arena allocations are always released in the same order than FIFO items are extracted
+// Allocations are word aligned so copied arrays can be read with their natural alignment
+#define LOG_ARENA_ALIGN(x)      (((x) + 3) & ~3UL)
+
+LOG_RAMFUNC static inline bool log_arena_reserve(log_fifo_t *pFifo, uint32_t length, uint32_t *pIdx)
+{
+    uint32_t wrIdx = pFifo->arenaWrIdx;
+    uint32_t toEnd = LOG_COPY_ARENA_SIZE - (wrIdx & (LOG_COPY_ARENA_SIZE - 1));
+
+    length = LOG_ARENA_ALIGN(length);
+
+    if(length > toEnd)                  // Skips the end of the arena so data is contiguous
+        wrIdx += toEnd;
+
+    if(wrIdx + length - pFifo->arenaRdIdx > LOG_COPY_ARENA_SIZE)
+        return false;
+
+    *pIdx = wrIdx;
+    pFifo->arenaWrIdx = wrIdx + length;
+    return true;
+}
+
+
+static inline uint8_t *log_arena_ptr(log_fifo_t *pFifo, uint32_t idx)
+{
+    return &pFifo->arena[idx & (LOG_COPY_ARENA_SIZE - 1)];
+}
+
+
+// Frees the allocation ending at idx and any skipped area that preceded it
+static inline void log_arena_release(log_fifo_t *pFifo, uint32_t idx)
+{
+    __DMB();
+    pFifo->arenaRdIdx = LOG_ARENA_ALIGN(idx);
+}
+#endif
+
+
+// The puts that mask interrupts count their items in the same critical section, the others
+// (LOG_FIFO_SPSC and LOG_FIFO_LOCK_FREE) are counted by log_input_stats()
+#define LOG_FIFO_COUNTS_STORES  (LOG_FIFO_MODE != LOG_FIFO_SPSC && !LOG_FIFO_LOCK_FREE)
+
+#if LOG_STATS
+// Counts nItems stored in pFifo and updates the high-water mark. Must be called with interrupts disabled.
+LOG_RAMFUNC static inline void log_stats_stored(log_fifo_t *pFifo, uint32_t nItems)
+{
+#if !LOG_FIFO_PACKED && LOG_FIFO_MODE == LOG_FIFO_LOCKED
+    uint32_t used = pFifo->nItems;
+#else
+    uint32_t used = pFifo->wrIdx - pFifo->rdIdx;
+#endif
+
+    mStats.nEnqueued += nItems;
+    if(used > mStats.highWater)
+        mStats.highWater = used;
+}
+#else
+LOG_RAMFUNC static inline void log_stats_stored(log_fifo_t *pFifo, uint32_t nItems)
+{
+    (void)pFifo;
+    (void)nItems;
+}
+#endif
+
+
+#if !LOG_FIFO_PACKED
+#if LOG_FIFO_MODE == LOG_FIFO_LOCKED
+
+#if LOG_FLIGHT_RECORDER
+// Drops the oldest items so that at most nKept remain. Must be called with interrupts disabled.
+static inline void log_fifo_trim(log_fifo_t *pFifo, uint32_t nKept)
+{
+    if(pFifo->nItems > nKept)
+    {
+        pFifo->rdIdx  = (pFifo->rdIdx + pFifo->nItems - nKept) & (pFifo->size - 1);
+        pFifo->nItems = nKept;
+    }
+}
+
+
+// Makes room for nItems while recording, so the FIFO always holds the most recent ones. After
+// log_trigger() only LOG_TRIGGER_POST_ITEMS more are stored, then the FIFO is frozen until the
+// capture has been output. Returns false if the items must be dropped. Must be called with
+// interrupts disabled.
+static inline bool log_fifo_record(log_fifo_t *pFifo, uint32_t nItems)
+{
+    switch(mRecorderState)
+    {
+    case LOG_RECORDER_RECORDING:
+        if(nItems <= pFifo->size)
+            log_fifo_trim(pFifo, pFifo->size - nItems);
+        return true;
+
+    case LOG_RECORDER_POST_TRIGGER:
+        if(mRecorderPostLeft > nItems)
+            mRecorderPostLeft -= nItems;
+        else
+            mRecorderState = LOG_RECORDER_CAPTURED;
+        return true;
+
+    default:
+        return false;
+    }
+}
+#endif
+
+
+#if LOG_FIFO_SPLIT
+LOG_RAMFUNC static inline void log_slot_store(log_fifo_t *pFifo, uint32_t idx, const log_fifo_item_t *pItem)
+{
+    log_fifo_head_t *pHead = &pFifo->head[idx];
+
+    memcpy(&pFifo->buffer[idx], pItem, LOG_FIFO_BODY_SIZE);
+#if LOG_LEVEL_ITEMS
+    pHead->level = pItem->level;
+#endif
+#if LOG_LINE_PREFIX
+    pHead->module = pItem->module;
+#endif
+#if LOG_CONTEXT_IDS
+    pHead->ctxId = pItem->ctxId;
+#endif
+    pHead->type = pItem->type;
+#if LOG_SUPPORT_ANSI_COLOR
+    pHead->color = pItem->color;
+#endif
+}
+
+
+static inline void log_slot_load(log_fifo_item_t *pItem, log_fifo_t *pFifo, uint32_t idx)
+{
+    const log_fifo_head_t *pHead = &pFifo->head[idx];
+
+    memcpy(pItem, &pFifo->buffer[idx], LOG_FIFO_BODY_SIZE);
+#if LOG_LEVEL_ITEMS
+    pItem->level = pHead->level;
+#endif
+#if LOG_LINE_PREFIX
+    pItem->module = pHead->module;
+#endif
+#if LOG_CONTEXT_IDS
+    pItem->ctxId = pHead->ctxId;
+#endif
+    pItem->type = (enum log_data_type)pHead->type;
+#if LOG_SUPPORT_ANSI_COLOR
+    pItem->color = (enum log_color)pHead->color;
+#endif
+}
+#else
+LOG_RAMFUNC static inline void log_slot_store(log_fifo_t *pFifo, uint32_t idx, const log_fifo_item_t *pItem)
+{
+    pFifo->buffer[idx] = *pItem;
+}
+
+
+static inline void log_slot_load(log_fifo_item_t *pItem, log_fifo_t *pFifo, uint32_t idx)
+{
+    *pItem = pFifo->buffer[idx];
+}
+#endif
+
+
+// Stores the item and, if length is not 0, a copy of pData in the arena of the FIFO.
+// Returns false if the item was dropped.
+LOG_RAMFUNC static inline bool log_fifo_put_copy(log_fifo_item_t *pItem, log_fifo_t *pFifo, const void *pData, uint32_t length)
+{
+    bool isStored = false;
+    uint32_t primaskBit;
+
+#if !LOG_COPY_ARENA_SIZE
+    (void)pData;
+    (void)length;
+#endif
+
+    LOG_ENTER_PUT_CRITICAL(primaskBit);
+
+#if LOG_FLIGHT_RECORDER
+    if(!log_fifo_record(pFifo, 1))
+    {
+        LOG_EXIT_PUT_CRITICAL(primaskBit);
+        return false;
+    }
+#endif
+    if(pFifo->nItems + log_fifo_reserve(pItem) < pFifo->size)
+    {
+#if LOG_COPY_ARENA_SIZE
+        if(length)
+        {
+            if(!log_arena_reserve(pFifo, length, &pItem->arenaIdx))
+            {
+                LOG_EXIT_PUT_CRITICAL(primaskBit);
+                return false;
+            }
+            memcpy(log_arena_ptr(pFifo, pItem->arenaIdx), pData, length);
+        }
+#endif
+#if LOG_SEQ_ITEMS
+        pItem->seq = mSeq++;
+#endif
+        log_slot_store(pFifo, pFifo->wrIdx, pItem);
+        pFifo->wrIdx = (pFifo->wrIdx + 1) & (pFifo->size - 1);
+        pFifo->nItems++;
+        log_stats_stored(pFifo, 1);
+        isStored = true;
+    }
+
+    LOG_EXIT_PUT_CRITICAL(primaskBit);
+    return isStored;
+}
+
+
+// Stores nItems consecutive items filled in place by fill(), all of them or none.
+// Returns false if they were dropped.
+LOG_RAMFUNC static inline bool log_fifo_put_n(log_fifo_t *pFifo, uint32_t nItems, log_fifo_fill_t fill, const void *pCtx)
+{
+    uint32_t reserve = log_fifo_reserve_n(fill, pCtx);
+    bool isStored = false;
+    uint32_t primaskBit;
+    uint32_t i;
+
+    LOG_ENTER_PUT_CRITICAL(primaskBit);
+
+#if LOG_FLIGHT_RECORDER
+    if(!log_fifo_record(pFifo, nItems))
+    {
+        LOG_EXIT_PUT_CRITICAL(primaskBit);
+        return false;
+    }
+#endif
+    if(pFifo->size - pFifo->nItems >= nItems + reserve)
+    {
+        for(i = 0; i < nItems; i++)
+        {
+#if LOG_FIFO_SPLIT
+            log_fifo_item_t item;
+
+            fill(&item, i, pCtx);
+#if LOG_SEQ_ITEMS
+            item.seq = mSeq++;
+#endif
+            log_slot_store(pFifo, pFifo->wrIdx, &item);
+#else
+            fill(&pFifo->buffer[pFifo->wrIdx], i, pCtx);
+#if LOG_SEQ_ITEMS
+            pFifo->buffer[pFifo->wrIdx].seq = mSeq++;
+#endif
+#endif
+            pFifo->wrIdx = (pFifo->wrIdx + 1) & (pFifo->size - 1);
+        }
+        pFifo->nItems += nItems;
+        log_stats_stored(pFifo, nItems);
+        isStored = true;
+    }
+
+    LOG_EXIT_PUT_CRITICAL(primaskBit);
+    return isStored;
+}
+
+
+static inline bool log_fifo_peek(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+{
+    bool retVal = false;
+    uint32_t primaskBit;
+
+    LOG_ENTER_CRITICAL(primaskBit);
+
+    if(pFifo->nItems)
+    {
+        log_slot_load(pItem, pFifo, pFifo->rdIdx);
+        retVal = true;
+    }
+
+    LOG_EXIT_CRITICAL(primaskBit);
+    return retVal;
+}
+
+
+static inline bool log_fifo_get(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+{
+    bool retVal = false;
+    uint32_t primaskBit;
+
+    LOG_ENTER_CRITICAL(primaskBit);
+
+    if(pFifo->nItems)
+    {
+        log_slot_load(pItem, pFifo, pFifo->rdIdx);
+        pFifo->rdIdx = (pFifo->rdIdx + 1) & (pFifo->size - 1);
+        pFifo->nItems--;
+        retVal = true;
+    }
+
+    LOG_EXIT_CRITICAL(primaskBit);
+    return retVal;
+}
+
+
+static inline bool log_fifo_is_empty(log_fifo_t *pFifo)
+{
+    return pFifo->nItems == 0;
+}
+
+
+// Full for the logs that are not errors, the reserve is left to those
+static inline bool log_fifo_is_full(log_fifo_t *pFifo)
+{
+    return pFifo->nItems + LOG_ERROR_RESERVE >= pFifo->size;
+}
+
+#elif LOG_FIFO_MODE == LOG_FIFO_MPSC
+
+#if LOG_FIFO_LOCK_FREE
+// Reserves nItems slots with LDREX/STREX, so producers of any core or priority do not need to mask
+// interrupts. The store fails and the loop retries if another producer took slots in between.
+static inline bool log_fifo_claim(log_fifo_t *pFifo, uint32_t nItems, uint32_t reserve, uint32_t *pWrIdx)
+{
+    uint32_t wrIdx;
+
+    do
+    {
+        wrIdx = __LDREXW(&pFifo->wrIdx);
+        if(pFifo->size - (wrIdx - pFifo->rdIdx) < nItems + reserve)
+        {
+            __CLREX();
+            return false;
+        }
+    } while(__STREXW(wrIdx + nItems, &pFifo->wrIdx));
+
+    __DMB();
+    *pWrIdx = wrIdx;
+    return true;
+}
+#endif
+
+
+// Stores the item and, if length is not 0, a copy of pData in the arena of the FIFO.
+// Returns false if the item was dropped.
+LOG_RAMFUNC static inline bool log_fifo_put_copy(log_fifo_item_t *pItem, log_fifo_t *pFifo, const void *pData, uint32_t length)
+{
+#if !LOG_FIFO_LOCK_FREE
+    uint32_t primaskBit;
+#endif
+    uint32_t slot;
+#if LOG_COPY_ARENA_SIZE
+    uint32_t arenaIdx = 0;
+#endif
+    bool isReserved = false;
+#if LOG_SEQ_ITEMS
+    uint16_t seq;
+#endif
+
+#if !LOG_COPY_ARENA_SIZE
+    (void)pData;
+    (void)length;
+#endif
+
+#if LOG_FIFO_LOCK_FREE
+    if(log_fifo_claim(pFifo, 1, log_fifo_reserve(pItem), &slot))
+    {
+        slot &= pFifo->size - 1;
+        isReserved = true;
+    }
+#else
+    // Only the slot (and arena) reservation is done with interrupts disabled
+    LOG_ENTER_PUT_CRITICAL(primaskBit);
+
+    if(pFifo->wrIdx - pFifo->rdIdx + log_fifo_reserve(pItem) < pFifo->size)
+    {
+#if LOG_COPY_ARENA_SIZE
+        if(!length || log_arena_reserve(pFifo, length, &arenaIdx))
+#endif
+        {
+            slot = pFifo->wrIdx++ & (pFifo->size - 1);
+#if LOG_SEQ_ITEMS
+            seq = mSeq++;
+#endif
+            log_stats_stored(pFifo, 1);
+            isReserved = true;
+        }
+    }
+
+    LOG_EXIT_PUT_CRITICAL(primaskBit);
+#endif
+
+    if(isReserved)
+    {
+        pFifo->buffer[slot] = *pItem;
+#if LOG_COPY_ARENA_SIZE
+        if(length)
+        {
+            memcpy(log_arena_ptr(pFifo, arenaIdx), pData, length);
+            pFifo->buffer[slot].arenaIdx = arenaIdx;
+        }
+#endif
+#if LOG_SEQ_ITEMS
+        pFifo->buffer[slot].seq = seq;
+#endif
+        __DMB();
+        pFifo->isCommitted[slot] = true;
+    }
+    return isReserved;
+}
+
+
+// Stores nItems consecutive items filled in place by fill(), all of them or none.
+// Returns false if they were dropped.
+LOG_RAMFUNC static inline bool log_fifo_put_n(log_fifo_t *pFifo, uint32_t nItems, log_fifo_fill_t fill, const void *pCtx)
+{
+    uint32_t reserve = log_fifo_reserve_n(fill, pCtx);
+#if !LOG_FIFO_LOCK_FREE
+    uint32_t primaskBit;
+#endif
+    uint32_t wrIdx;
+    uint32_t slot;
+    uint32_t i;
+    bool isReserved = false;
+#if LOG_SEQ_ITEMS
+    uint16_t seq;
+#endif
+
+#if LOG_FIFO_LOCK_FREE
+    isReserved = log_fifo_claim(pFifo, nItems, reserve, &wrIdx);
+#else
+    // All the slots are reserved at once, each one is then committed after being filled
+    LOG_ENTER_PUT_CRITICAL(primaskBit);
+
+    if(pFifo->size - (pFifo->wrIdx - pFifo->rdIdx) >= nItems + reserve)
+    {
+        wrIdx = pFifo->wrIdx;
+        pFifo->wrIdx += nItems;
+#if LOG_SEQ_ITEMS
+        seq = mSeq;
+        mSeq += nItems;
+#endif
+        log_stats_stored(pFifo, nItems);
+        isReserved = true;
+    }
+
+    LOG_EXIT_PUT_CRITICAL(primaskBit);
+#endif
+
+    if(isReserved)
+    {
+        for(i = 0; i < nItems; i++)
+        {
+            slot = (wrIdx + i) & (pFifo->size - 1);
+            fill(&pFifo->buffer[slot], i, pCtx);
+#if LOG_SEQ_ITEMS
+            pFifo->buffer[slot].seq = seq + i;
+#endif
+            __DMB();
+            pFifo->isCommitted[slot] = true;
+        }
+    }
+    return isReserved;
+}
+
+
+static inline bool log_fifo_peek(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+{
+    uint32_t slot = pFifo->rdIdx & (pFifo->size - 1);
+
+    // A slot reserved by a preempted producer stops extraction until it is committed
+    if(!pFifo->isCommitted[slot])
+        return false;
+
+    __DMB();
+    *pItem = pFifo->buffer[slot];
+    return true;
+}
+
+
+static inline bool log_fifo_get(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+{
+    uint32_t slot = pFifo->rdIdx & (pFifo->size - 1);
+
+    if(!log_fifo_peek(pItem, pFifo))
+        return false;
+
+    pFifo->isCommitted[slot] = false;
+    __DMB();
+    pFifo->rdIdx++;
+    return true;
+}
+
+#elif LOG_FIFO_MODE == LOG_FIFO_SPSC
+
+// Stores the item and, if length is not 0, a copy of pData in the arena of the FIFO.
+// Returns false if the item was dropped.
+LOG_RAMFUNC static inline bool log_fifo_put_copy(log_fifo_item_t *pItem, log_fifo_t *pFifo, const void *pData, uint32_t length)
+{
+    uint32_t wrIdx = pFifo->wrIdx;
+    log_fifo_item_t *pSlot = &pFifo->buffer[wrIdx & (pFifo->size - 1)];
+
+#if !LOG_COPY_ARENA_SIZE
+    (void)pData;
+    (void)length;
+#endif
+
+    if(wrIdx - pFifo->rdIdx + log_fifo_reserve(pItem) < pFifo->size)
+    {
+        *pSlot = *pItem;
+#if LOG_COPY_ARENA_SIZE
+        if(length)
+        {
+            if(!log_arena_reserve(pFifo, length, &pSlot->arenaIdx))
+                return false;
+            memcpy(log_arena_ptr(pFifo, pSlot->arenaIdx), pData, length);
+        }
+#endif
+        __DMB();
+        pFifo->wrIdx = wrIdx + 1;
+        return true;
+    }
+    return false;
+}
+
+
+// Stores nItems consecutive items filled in place by fill(), all of them or none.
+// Returns false if they were dropped.
+LOG_RAMFUNC static inline bool log_fifo_put_n(log_fifo_t *pFifo, uint32_t nItems, log_fifo_fill_t fill, const void *pCtx)
+{
+    uint32_t reserve = log_fifo_reserve_n(fill, pCtx);
+    uint32_t wrIdx = pFifo->wrIdx;
+    uint32_t i;
+
+    if(pFifo->size - (wrIdx - pFifo->rdIdx) < nItems + reserve)
+        return false;
+
+    for(i = 0; i < nItems; i++)
+        fill(&pFifo->buffer[(wrIdx + i) & (pFifo->size - 1)], i, pCtx);
+    __DMB();
+    pFifo->wrIdx = wrIdx + nItems;
+    return true;
+}
+
+
+static inline bool log_fifo_get(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+{
+    uint32_t rdIdx = pFifo->rdIdx;
+
+    if(rdIdx == pFifo->wrIdx)
+        return false;
+
+    __DMB();
+    *pItem = pFifo->buffer[rdIdx & (pFifo->size - 1)];
+    __DMB();
+    pFifo->rdIdx = rdIdx + 1;
+    return true;
+}
+
+#else
+#error "Unknown LOG_FIFO_MODE"
+#endif
+
+#if LOG_FIFO_MODE != LOG_FIFO_LOCKED
+static inline bool log_fifo_is_empty(log_fifo_t *pFifo)
+{
+    return pFifo->wrIdx == pFifo->rdIdx;
+}
+
+
+// Full for the logs that are not errors, the reserve is left to those
+static inline bool log_fifo_is_full(log_fifo_t *pFifo)
+{
+    return pFifo->wrIdx - pFifo->rdIdx + LOG_ERROR_RESERVE >= pFifo->size;
+}
+#endif
+
+#else /* LOG_FIFO_PACKED */
+
+#if LOG_SEQ_ITEMS
+#define LOG_PACKED_SEQ_SIZE     sizeof(uint16_t)
+#else
+#define LOG_PACKED_SEQ_SIZE     0
+#endif
+
+#if LOG_TIMESTAMPS
+#define LOG_PACKED_TS_SIZE      sizeof(uint32_t)
+#else
+#define LOG_PACKED_TS_SIZE      0
+#endif
+
+#if LOG_LEVEL_ITEMS
+#define LOG_PACKED_LEVEL_SIZE   1
+#else
+#define LOG_PACKED_LEVEL_SIZE   0
+#endif
+
+#if LOG_CONTEXT_IDS
+#define LOG_PACKED_CTX_SIZE     1
+#else
+#define LOG_PACKED_CTX_SIZE     0
+#endif
+
+#if LOG_LINE_PREFIX
+#define LOG_PACKED_MODULE_SIZE  1
+#else
+#define LOG_PACKED_MODULE_SIZE  0
+#endif
+
+// Sequence number, timestamp, level, context ID and module follow the header, then the payload
+#define LOG_PACKED_PREFIX_SIZE  (LOG_PACKED_SEQ_SIZE + LOG_PACKED_TS_SIZE + LOG_PACKED_LEVEL_SIZE + LOG_PACKED_CTX_SIZE + \
+                                 LOG_PACKED_MODULE_SIZE)
+#define LOG_PACKED_LEVEL_IDX    (1 + LOG_PACKED_SEQ_SIZE + LOG_PACKED_TS_SIZE)
+#define LOG_PACKED_CTX_IDX      (LOG_PACKED_LEVEL_IDX + LOG_PACKED_LEVEL_SIZE)
+#define LOG_PACKED_MODULE_IDX   (LOG_PACKED_CTX_IDX + LOG_PACKED_CTX_SIZE)
+
+#define LOG_PACKED_HDR_EMPTY    0       // Header of a reserved but not committed record
+#define LOG_PACKED_ARRAY_SIZE   (sizeof(char*) + sizeof(uint16_t) + 1)     // Pointer, number of items, format and size
+#if LOG_64BIT_NUMBERS
+#define LOG_PACKED_MAX_PAYLOAD  (LOG_PACKED_ARRAY_SIZE > 8 ? LOG_PACKED_ARRAY_SIZE : 8)
+#else
+#define LOG_PACKED_MAX_PAYLOAD  LOG_PACKED_ARRAY_SIZE
+#endif
+#define LOG_PACKED_MAX_RECORD   (1 + LOG_PACKED_PREFIX_SIZE + 1 + LOG_PACKED_MAX_PAYLOAD)
+
+// Header layout: low nibble is data type + 1 (so it is never empty), high nibble is color.
+// The types that do not fit in the nibble set it to LOG_PACKED_HDR_EXT and are stored in an
+// extra byte between the prefix and the payload.
+#define LOG_PACKED_N_HDR_TYPES          14
+#define LOG_PACKED_HDR_EXT              0x0F
+#define LOG_PACKED_HDR(type, color)     ((uint8_t)(((type) < LOG_PACKED_N_HDR_TYPES ? (type) + 1 : LOG_PACKED_HDR_EXT) | \
+                                                   ((color) << 4)))
+#define LOG_PACKED_HDR_COLOR(hdr)       ((enum log_color)((hdr) >> 4))
+#define LOG_PACKED_IS_EXT(hdr)          (((hdr) & 0x0F) == LOG_PACKED_HDR_EXT)
+#define LOG_PACKED_PAYLOAD_IDX(type)    (1 + LOG_PACKED_PREFIX_SIZE + ((type) >= LOG_PACKED_N_HDR_TYPES))
+
+static const uint8_t packedPayloadSize[] = {
+    [_LOG_STRING]    = sizeof(char*) + sizeof(uint16_t),
+    [_LOG_UINT_DEC]  = 4,
+    [_LOG_INT_DEC_1] = 1,
+    [_LOG_INT_DEC_2] = 2,
+    [_LOG_INT_DEC_4] = 4,
+    [_LOG_HEX_1]     = 1,
+    [_LOG_HEX_2]     = 2,
+    [_LOG_HEX_4]     = 4,
+    [LOG_CHAR]       = 1,
+    [_LOG_ARRAY]     = LOG_PACKED_ARRAY_SIZE,
+    [_LOG_STRING_COPY] = sizeof(uint32_t) + sizeof(uint16_t),    // Arena index and length
+    [_LOG_ARRAY_COPY]  = sizeof(uint32_t) + sizeof(uint16_t) + 1,
+    [_LOG_HEX_8]       = 8,
+    [_LOG_UINT_DEC_8]  = 8,
+    [_LOG_INT_DEC_8]   = 8,
+    [_LOG_FIXED]       = 6,             // Value, fraction bits and decimals
+    [_LOG_FLOAT]       = 6,
+    [_LOG_HEXDUMP]     = sizeof(char*) + sizeof(uint16_t),
+    [_LOG_HEXDUMP_COPY] = sizeof(uint32_t) + sizeof(uint16_t),
+    [_LOG_TRACE]       = 5,             // Object and event
+    [_LOG_ENUM]        = sizeof(char*) + 2,     // Table, index and number of names
+    [_LOG_REG]         = 6,             // Value and descriptor
+    [_LOG_CUSTOM]      = sizeof(uint32_t) + 2,  // Arena index, length and type ID
+    [_LOG_BUFFER_CTX]  = sizeof(char*),
+    [_LOG_BUFFER_RELEASE] = sizeof(char*),
+    [_LOG_LOCATION]    = 4,             // File name hash and line
+    [_LOG_ARRAY_STRIDE] = sizeof(char*) + 3,    // First element, elements, stride, format and size
+    [_LOG_KV]          = 1,             // Number of pairs
+    [_LOG_REF]         = sizeof(char*) + 2,     // Variable, its type and size
+};
+
+
+static inline uint32_t log_packed_type_len(enum log_data_type type)
+{
+    return LOG_PACKED_PAYLOAD_IDX(type) + packedPayloadSize[type];
+}
+
+
+// The extra type byte must already be in the record if the header says so
+static inline enum log_data_type log_packed_type(const uint8_t *pRecord)
+{
+    if(LOG_PACKED_IS_EXT(pRecord[0]))
+        return (enum log_data_type)pRecord[1 + LOG_PACKED_PREFIX_SIZE];
+    return (enum log_data_type)((pRecord[0] & 0x0F) - 1);
+}
+
+
+// Little endian targets only: numbers are truncated to their low bytes
+static inline uint32_t log_pack_item(const log_fifo_item_t *pItem, uint8_t *pRecord)
+{
+    uint8_t *pPayload = &pRecord[LOG_PACKED_PAYLOAD_IDX(pItem->type)];
+
+#if LOG_SUPPORT_ANSI_COLOR
+    pRecord[0] = LOG_PACKED_HDR(pItem->type, pItem->color);
+#else
+    pRecord[0] = LOG_PACKED_HDR(pItem->type, 0);
+#endif
+#if LOG_TIMESTAMPS
+    memcpy(&pRecord[1 + LOG_PACKED_SEQ_SIZE], &pItem->timestamp, sizeof(uint32_t));
+#endif
+#if LOG_LEVEL_ITEMS
+    pRecord[LOG_PACKED_LEVEL_IDX] = pItem->level;
+#endif
+#if LOG_CONTEXT_IDS
+    pRecord[LOG_PACKED_CTX_IDX] = pItem->ctxId;
+#endif
+#if LOG_LINE_PREFIX
+    pRecord[LOG_PACKED_MODULE_IDX] = pItem->module;
+#endif
+    if(pItem->type >= LOG_PACKED_N_HDR_TYPES)
+        pRecord[1 + LOG_PACKED_PREFIX_SIZE] = pItem->type;
+
+    switch(pItem->type)
+    {
+    case _LOG_STRING:
+    case _LOG_ARRAY:
+    case _LOG_HEXDUMP:
+        memcpy(pPayload, &pItem->str, sizeof(char*));
+        memcpy(&pPayload[sizeof(char*)], &pItem->strLen, sizeof(uint16_t));
+#if LOG_ARRAY_RECORDS
+        if(pItem->type == _LOG_ARRAY)
+            pPayload[sizeof(char*) + sizeof(uint16_t)] = pItem->elemType | (pItem->elemSize << 4);
+#endif
+        break;
+    case _LOG_STRING_COPY:              // Arena index is filled in when it is reserved
+    case _LOG_ARRAY_COPY:
+    case _LOG_HEXDUMP_COPY:
+        memcpy(&pPayload[sizeof(uint32_t)], &pItem->strLen, sizeof(uint16_t));
+#if LOG_ARRAY_RECORDS
+        if(pItem->type == _LOG_ARRAY_COPY)
+            pPayload[sizeof(uint32_t) + sizeof(uint16_t)] = pItem->elemType | (pItem->elemSize << 4);
+#endif
+        break;
+#if LOG_BULK_ARRAYS
+    case _LOG_ARRAY_STRIDE:
+        memcpy(pPayload, &pItem->str, sizeof(char*));
+        pPayload[sizeof(char*)]     = pItem->strideElems;
+        pPayload[sizeof(char*) + 1] = pItem->stride;
+        pPayload[sizeof(char*) + 2] = pItem->elemType | (pItem->elemSize << 4);
+        break;
+#endif
+    case _LOG_CUSTOM:
+        pPayload[sizeof(uint32_t)]     = pItem->customLen;
+        pPayload[sizeof(uint32_t) + 1] = pItem->customId;
+        break;
+#if LOG_64BIT_NUMBERS
+    case _LOG_HEX_8:
+    case _LOG_UINT_DEC_8:
+    case _LOG_INT_DEC_8:
+        memcpy(pPayload, &pItem->uData, sizeof(uint32_t));
+        memcpy(&pPayload[sizeof(uint32_t)], &pItem->uDataHi, sizeof(uint32_t));
+        break;
+#endif
+    case _LOG_FIXED:
+    case _LOG_FLOAT:
+        memcpy(pPayload, &pItem->uData, sizeof(uint32_t));
+        pPayload[sizeof(uint32_t)]     = pItem->fracBits;
+        pPayload[sizeof(uint32_t) + 1] = pItem->nDecimals;
+        break;
+    case _LOG_TRACE:
+        memcpy(pPayload, &pItem->uData, sizeof(uint32_t));
+        pPayload[sizeof(uint32_t)] = pItem->traceEvent;
+        break;
+    case _LOG_ENUM:
+        memcpy(pPayload, &pItem->str, sizeof(char*));
+        pPayload[sizeof(char*)]     = pItem->enumIndex;
+        pPayload[sizeof(char*) + 1] = pItem->enumCount;
+        break;
+    case _LOG_REF:
+        memcpy(pPayload, &pItem->str, sizeof(char*));
+        pPayload[sizeof(char*)]     = pItem->refType;
+        pPayload[sizeof(char*) + 1] = pItem->refSize;
+        break;
+    case _LOG_REG:
+        memcpy(pPayload, &pItem->uData, sizeof(uint32_t));
+        memcpy(&pPayload[sizeof(uint32_t)], &pItem->regDesc, sizeof(uint16_t));
+        break;
+    default:
+        memcpy(pPayload, &pItem->uData, packedPayloadSize[pItem->type]);
+    }
+
+    return log_packed_type_len(pItem->type);
+}
+
+
+static inline void log_unpack_item(log_fifo_item_t *pItem, const uint8_t *pRecord)
+{
+    const uint8_t *pPayload;
+
+    memset(pItem, 0, sizeof(*pItem));
+    pItem->type  = log_packed_type(pRecord);
+    pPayload     = &pRecord[LOG_PACKED_PAYLOAD_IDX(pItem->type)];
+#if LOG_SUPPORT_ANSI_COLOR
+    pItem->color = LOG_PACKED_HDR_COLOR(pRecord[0]);
+#endif
+#if LOG_SEQ_ITEMS
+    memcpy(&pItem->seq, &pRecord[1], sizeof(uint16_t));
+#endif
+#if LOG_TIMESTAMPS
+    memcpy(&pItem->timestamp, &pRecord[1 + LOG_PACKED_SEQ_SIZE], sizeof(uint32_t));
+#endif
+#if LOG_LEVEL_ITEMS
+    pItem->level = pRecord[LOG_PACKED_LEVEL_IDX];
+#endif
+#if LOG_CONTEXT_IDS
+    pItem->ctxId = pRecord[LOG_PACKED_CTX_IDX];
+#endif
+#if LOG_LINE_PREFIX
+    pItem->module = pRecord[LOG_PACKED_MODULE_IDX];
+#endif
+
+    switch(pItem->type)
+    {
+    case _LOG_STRING:
+    case _LOG_ARRAY:
+    case _LOG_HEXDUMP:
+        memcpy(&pItem->str, pPayload, sizeof(char*));
+        memcpy(&pItem->strLen, &pPayload[sizeof(char*)], sizeof(uint16_t));
+#if LOG_ARRAY_RECORDS
+        if(pItem->type == _LOG_ARRAY)
+        {
+            pItem->elemType = pPayload[sizeof(char*) + sizeof(uint16_t)] & 0x0F;
+            pItem->elemSize = pPayload[sizeof(char*) + sizeof(uint16_t)] >> 4;
+        }
+#endif
+        break;
+    case _LOG_STRING_COPY:
+    case _LOG_ARRAY_COPY:
+    case _LOG_HEXDUMP_COPY:
+        memcpy(&pItem->arenaIdx, pPayload, sizeof(uint32_t));
+        memcpy(&pItem->strLen, &pPayload[sizeof(uint32_t)], sizeof(uint16_t));
+#if LOG_ARRAY_RECORDS
+        if(pItem->type == _LOG_ARRAY_COPY)
+        {
+            pItem->elemType = pPayload[sizeof(uint32_t) + sizeof(uint16_t)] & 0x0F;
+            pItem->elemSize = pPayload[sizeof(uint32_t) + sizeof(uint16_t)] >> 4;
+        }
+#endif
+        break;
+#if LOG_BULK_ARRAYS
+    case _LOG_ARRAY_STRIDE:
+        memcpy(&pItem->str, pPayload, sizeof(char*));
+        pItem->strideElems = pPayload[sizeof(char*)];
+        pItem->stride      = pPayload[sizeof(char*) + 1];
+        pItem->elemType    = pPayload[sizeof(char*) + 2] & 0x0F;
+        pItem->elemSize    = pPayload[sizeof(char*) + 2] >> 4;
+        break;
+#endif
+    case _LOG_CUSTOM:
+        memcpy(&pItem->arenaIdx, pPayload, sizeof(uint32_t));
+        pItem->customLen = pPayload[sizeof(uint32_t)];
+        pItem->customId  = pPayload[sizeof(uint32_t) + 1];
+        break;
+    case LOG_CHAR:
+        pItem->chr[0] = pPayload[0];
+        pItem->nChars = 1;
+        break;
+#if LOG_64BIT_NUMBERS
+    case _LOG_HEX_8:
+    case _LOG_UINT_DEC_8:
+    case _LOG_INT_DEC_8:
+        memcpy(&pItem->uData, pPayload, sizeof(uint32_t));
+        memcpy(&pItem->uDataHi, &pPayload[sizeof(uint32_t)], sizeof(uint32_t));
+        break;
+#endif
+    case _LOG_FIXED:
+    case _LOG_FLOAT:
+        memcpy(&pItem->uData, pPayload, sizeof(uint32_t));
+        pItem->fracBits  = pPayload[sizeof(uint32_t)];
+        pItem->nDecimals = pPayload[sizeof(uint32_t) + 1];
+        break;
+    case _LOG_TRACE:
+        memcpy(&pItem->uData, pPayload, sizeof(uint32_t));
+        pItem->traceEvent = pPayload[sizeof(uint32_t)];
+        break;
+    case _LOG_ENUM:
+        memcpy(&pItem->str, pPayload, sizeof(char*));
+        pItem->enumIndex = pPayload[sizeof(char*)];
+        pItem->enumCount = pPayload[sizeof(char*) + 1];
+        break;
+    case _LOG_REF:
+        memcpy(&pItem->str, pPayload, sizeof(char*));
+        pItem->refType = pPayload[sizeof(char*)];
+        pItem->refSize = pPayload[sizeof(char*) + 1];
+        break;
+    case _LOG_REG:
+        memcpy(&pItem->uData, pPayload, sizeof(uint32_t));
+        memcpy(&pItem->regDesc, &pPayload[sizeof(uint32_t)], sizeof(uint16_t));
+        break;
+    default:
+        memcpy(&pItem->uData, pPayload, packedPayloadSize[pItem->type]);
+    }
+}
+
+
+LOG_RAMFUNC static inline void log_fifo_write(log_fifo_t *pFifo, uint32_t idx, const uint8_t *pData, uint32_t length)
+{
+    while(length--)
+        pFifo->buffer[idx++ & (pFifo->size - 1)] = *pData++;
+}
+
+
+static inline void log_fifo_read(log_fifo_t *pFifo, uint32_t idx, uint8_t *pData, uint32_t length)
+{
+    while(length--)
+        *pData++ = pFifo->buffer[idx++ & (pFifo->size - 1)];
+}
+
+
+// Decodes the record at the read index without extracting it, returns its length or 0 if none
+static inline uint32_t log_fifo_read_record(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+{
+    uint8_t record[LOG_PACKED_MAX_RECORD];
+    uint32_t rdIdx = pFifo->rdIdx;
+    uint32_t length;
+
+    if(rdIdx == pFifo->wrIdx)
+        return 0;
+
+    // A record reserved by a preempted producer stops extraction until it is committed
+    record[0] = pFifo->buffer[rdIdx & (pFifo->size - 1)];
+    if(record[0] == LOG_PACKED_HDR_EMPTY)
+        return 0;
+
+    __DMB();
+    if(LOG_PACKED_IS_EXT(record[0]))
+        record[1 + LOG_PACKED_PREFIX_SIZE] = pFifo->buffer[(rdIdx + 1 + LOG_PACKED_PREFIX_SIZE) & (pFifo->size - 1)];
+    length = log_packed_type_len(log_packed_type(record));
+    log_fifo_read(pFifo, rdIdx + 1, &record[1], length - 1);
+    log_unpack_item(pItem, record);
+    return length;
+}
+
+
+// Stores the item and, if dataLength is not 0, a copy of pData in the arena of the FIFO.
+// The arena index is the first field of the payload of copy records. Returns false if the item was dropped.
+LOG_RAMFUNC static inline bool log_fifo_put_copy(log_fifo_item_t *pItem, log_fifo_t *pFifo, const void *pData, uint32_t dataLength)
+{
+    uint8_t record[LOG_PACKED_MAX_RECORD];
+    uint32_t length = log_pack_item(pItem, record);
+    uint32_t reserve = log_fifo_reserve(pItem);
+#if LOG_COPY_ARENA_SIZE
+    uint8_t *pArenaIdx = &record[LOG_PACKED_PAYLOAD_IDX(pItem->type)];
+    uint32_t arenaIdx = 0;
+#endif
+#if LOG_FIFO_MODE == LOG_FIFO_LOCKED
+    bool isStored = false;
+    uint32_t primaskBit;
+
+#if !LOG_COPY_ARENA_SIZE
+    (void)pData;
+    (void)dataLength;
+#endif
+
+    LOG_ENTER_PUT_CRITICAL(primaskBit);
+
+    if(pFifo->size - (pFifo->wrIdx - pFifo->rdIdx) >= length + reserve)
+    {
+#if LOG_COPY_ARENA_SIZE
+        if(dataLength)
+        {
+            if(!log_arena_reserve(pFifo, dataLength, &arenaIdx))
+            {
+                LOG_EXIT_PUT_CRITICAL(primaskBit);
+                return false;
+            }
+            memcpy(log_arena_ptr(pFifo, arenaIdx), pData, dataLength);
+            memcpy(pArenaIdx, &arenaIdx, sizeof(arenaIdx));
+        }
+#endif
+#if LOG_SEQ_ITEMS
+        memcpy(&record[1], &mSeq, sizeof(uint16_t));
+        mSeq++;
+#endif
+        log_fifo_write(pFifo, pFifo->wrIdx, record, length);
+        pFifo->wrIdx += length;
+        log_stats_stored(pFifo, 1);
+        isStored = true;
+    }
+
+    LOG_EXIT_PUT_CRITICAL(primaskBit);
+    return isStored;
+
+#elif LOG_FIFO_MODE == LOG_FIFO_MPSC
+    uint32_t primaskBit;
+    uint32_t wrIdx;
+    bool isReserved = false;
+
+#if !LOG_COPY_ARENA_SIZE
+    (void)pData;
+    (void)dataLength;
+#endif
+
+    // Only the record reservation is done with interrupts disabled. Its header is cleared
+    // in the same critical section and written last, which commits the record.
+    LOG_ENTER_PUT_CRITICAL(primaskBit);
+
+    if(pFifo->size - (pFifo->wrIdx - pFifo->rdIdx) >= length + reserve)
+    {
+#if LOG_COPY_ARENA_SIZE
+        if(!dataLength || log_arena_reserve(pFifo, dataLength, &arenaIdx))
+#endif
+        {
+            wrIdx = pFifo->wrIdx;
+            pFifo->wrIdx += length;
+            pFifo->buffer[wrIdx & (pFifo->size - 1)] = LOG_PACKED_HDR_EMPTY;
+#if LOG_SEQ_ITEMS
+            memcpy(&record[1], &mSeq, sizeof(uint16_t));
+            mSeq++;
+#endif
+            log_stats_stored(pFifo, 1);
+            isReserved = true;
+        }
+    }
+
+    LOG_EXIT_PUT_CRITICAL(primaskBit);
+
+    if(isReserved)
+    {
+#if LOG_COPY_ARENA_SIZE
+        if(dataLength)
+        {
+            memcpy(log_arena_ptr(pFifo, arenaIdx), pData, dataLength);
+            memcpy(pArenaIdx, &arenaIdx, sizeof(arenaIdx));
+        }
+#endif
+        log_fifo_write(pFifo, wrIdx + 1, &record[1], length - 1);
+        __DMB();
+        pFifo->buffer[wrIdx & (pFifo->size - 1)] = record[0];
+    }
+    return isReserved;
+
+#elif LOG_FIFO_MODE == LOG_FIFO_SPSC
+    uint32_t wrIdx = pFifo->wrIdx;
+
+#if !LOG_COPY_ARENA_SIZE
+    (void)pData;
+    (void)dataLength;
+#endif
+
+    if(pFifo->size - (wrIdx - pFifo->rdIdx) >= length + reserve)
+    {
+#if LOG_COPY_ARENA_SIZE
+        if(dataLength)
+        {
+            if(!log_arena_reserve(pFifo, dataLength, &arenaIdx))
+                return false;
+            memcpy(log_arena_ptr(pFifo, arenaIdx), pData, dataLength);
+            memcpy(pArenaIdx, &arenaIdx, sizeof(arenaIdx));
+        }
+#endif
+        log_fifo_write(pFifo, wrIdx, record, length);
+        __DMB();
+        pFifo->wrIdx = wrIdx + length;
+        return true;
+    }
+    return false;
+#else
+#error "Unknown LOG_FIFO_MODE"
+#endif
+}
+
+
+// Stores nItems consecutive records filled by fill(), all of them or none.
+// Returns false if they were dropped.
+LOG_RAMFUNC static inline bool log_fifo_put_n(log_fifo_t *pFifo, uint32_t nItems, log_fifo_fill_t fill, const void *pCtx)
+{
+    uint8_t record[LOG_PACKED_MAX_RECORD];
+    log_fifo_item_t item;
+    uint32_t length = 0;
+    uint32_t reserve = log_fifo_reserve_n(fill, pCtx);
+    uint32_t recordLen;
+    uint32_t wrIdx;
+    uint32_t i;
+#if LOG_FIFO_MODE != LOG_FIFO_SPSC
+    uint32_t primaskBit;
+#endif
+#if LOG_FIFO_MODE == LOG_FIFO_MPSC
+    uint32_t firstIdx;
+    uint8_t firstHeader = LOG_PACKED_HDR_EMPTY;
+#endif
+#if LOG_SEQ_ITEMS
+    uint16_t seq;
+#endif
+
+    // Records have variable length, so the items are filled once to know the space they need
+    for(i = 0; i < nItems; i++)
+    {
+        fill(&item, i, pCtx);
+        length += log_packed_type_len(item.type);
+    }
+
+#if LOG_FIFO_MODE == LOG_FIFO_LOCKED
+    LOG_ENTER_PUT_CRITICAL(primaskBit);
+
+    if(pFifo->size - (pFifo->wrIdx - pFifo->rdIdx) < length + reserve)
+    {
+        LOG_EXIT_PUT_CRITICAL(primaskBit);
+        return false;
+    }
+
+    wrIdx = pFifo->wrIdx;
+    for(i = 0; i < nItems; i++)
+    {
+        fill(&item, i, pCtx);
+        recordLen = log_pack_item(&item, record);
+#if LOG_SEQ_ITEMS
+        seq = mSeq++;
+        memcpy(&record[1], &seq, sizeof(uint16_t));
+#endif
+        log_fifo_write(pFifo, wrIdx, record, recordLen);
+        wrIdx += recordLen;
+    }
+    pFifo->wrIdx = wrIdx;
+    log_stats_stored(pFifo, nItems);
+
+    LOG_EXIT_PUT_CRITICAL(primaskBit);
+
+#elif LOG_FIFO_MODE == LOG_FIFO_MPSC
+    // Same as a single record: the header of the first one is cleared when reserving and
+    // written last, once all the others are in place
+    LOG_ENTER_PUT_CRITICAL(primaskBit);
+
+    if(pFifo->size - (pFifo->wrIdx - pFifo->rdIdx) < length + reserve)
+    {
+        LOG_EXIT_PUT_CRITICAL(primaskBit);
+        return false;
+    }
+
+    wrIdx = pFifo->wrIdx;
+    pFifo->wrIdx += length;
+    pFifo->buffer[wrIdx & (pFifo->size - 1)] = LOG_PACKED_HDR_EMPTY;
+#if LOG_SEQ_ITEMS
+    seq = mSeq;
+    mSeq += nItems;
+#endif
+    log_stats_stored(pFifo, nItems);
+
+    LOG_EXIT_PUT_CRITICAL(primaskBit);
+
+    firstIdx = wrIdx;
+    for(i = 0; i < nItems; i++)
+    {
+        fill(&item, i, pCtx);
+        recordLen = log_pack_item(&item, record);
+#if LOG_SEQ_ITEMS
+        memcpy(&record[1], &seq, sizeof(uint16_t));
+        seq++;
+#endif
+        if(i == 0)
+        {
+            firstHeader = record[0];
+            log_fifo_write(pFifo, wrIdx + 1, &record[1], recordLen - 1);
+        }
+        else
+            log_fifo_write(pFifo, wrIdx, record, recordLen);
+        wrIdx += recordLen;
+    }
+    __DMB();
+    pFifo->buffer[firstIdx & (pFifo->size - 1)] = firstHeader;
+
+#elif LOG_FIFO_MODE == LOG_FIFO_SPSC
+    wrIdx = pFifo->wrIdx;
+
+    if(pFifo->size - (wrIdx - pFifo->rdIdx) < length + reserve)
+        return false;
+
+    for(i = 0; i < nItems; i++)
+    {
+        fill(&item, i, pCtx);
+        recordLen = log_pack_item(&item, record);
+        log_fifo_write(pFifo, wrIdx, record, recordLen);
+        wrIdx += recordLen;
+    }
+    __DMB();
+    pFifo->wrIdx = wrIdx;
+#endif
+    return true;
+}
+
+
+static inline bool log_fifo_peek(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+{
+    uint32_t length;
+#if LOG_FIFO_MODE == LOG_FIFO_LOCKED
+    uint32_t primaskBit;
+
+    LOG_ENTER_CRITICAL(primaskBit);
+    length = log_fifo_read_record(pItem, pFifo);
+    LOG_EXIT_CRITICAL(primaskBit);
+#else
+    length = log_fifo_read_record(pItem, pFifo);
+#endif
+    return length != 0;
+}
+
+
+static inline bool log_fifo_get(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+{
+    uint32_t length;
+#if LOG_FIFO_MODE == LOG_FIFO_LOCKED
+    uint32_t primaskBit;
+
+    LOG_ENTER_CRITICAL(primaskBit);
+    length = log_fifo_read_record(pItem, pFifo);
+    pFifo->rdIdx += length;
+    LOG_EXIT_CRITICAL(primaskBit);
+#else
+    length = log_fifo_read_record(pItem, pFifo);
+    __DMB();
+    pFifo->rdIdx += length;
+#endif
+    return length != 0;
+}
+
+
+static inline bool log_fifo_is_empty(log_fifo_t *pFifo)
+{
+    return pFifo->wrIdx == pFifo->rdIdx;
+}
+
+
+// Full means that the biggest record would not fit anymore, except in the reserve of the errors
+static inline bool log_fifo_is_full(log_fifo_t *pFifo)
+{
+    return pFifo->size - (pFifo->wrIdx - pFifo->rdIdx) < LOG_PACKED_MAX_RECORD + LOG_ERROR_RESERVE;
+}
+
+#endif /* LOG_FIFO_PACKED */
+
+
+static void log_fifo_reset(log_fifo_t *pFifo)
+{
+    pFifo->rdIdx  = 0;
+    pFifo->wrIdx  = 0;
+#if LOG_FIFO_MODE == LOG_FIFO_LOCKED && !LOG_FIFO_PACKED
+    pFifo->nItems = 0;
+#elif LOG_FIFO_HAS_COMMIT_FLAGS
+    memset((void*)pFifo->isCommitted, 0, pFifo->size * sizeof(pFifo->isCommitted[0]));
+#endif
+#if LOG_COPY_ARENA_SIZE
+    pFifo->arenaRdIdx = 0;
+    pFifo->arenaWrIdx = 0;
+#endif
+}
+
+
+LOG_RAMFUNC static inline bool log_fifo_put(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+{
+    return log_fifo_put_copy(pItem, pFifo, NULL, 0);
+}
+
+
+// Returns the used space of the FIFO, in items or in bytes if it is packed
+static inline uint32_t log_fifo_used(log_fifo_t *pFifo)
+{
+#if !LOG_FIFO_PACKED && LOG_FIFO_MODE == LOG_FIFO_LOCKED
+    return pFifo->nItems;
+#else
+    return pFifo->wrIdx - pFifo->rdIdx;
+#endif
+}
+
+
+#if LOG_FIFO_SPLIT
+// Returns the items of a buffer of nSlots slots, LOG_FIFO_N_SLOTS() of a power of 2, the rest holds their heads
+static uint32_t log_fifo_split_size(uint32_t nSlots)
+{
+    uint32_t size = nSlots * sizeof(log_fifo_slot_t) / (sizeof(log_fifo_slot_t) + sizeof(log_fifo_head_t));
+
+    while(size & (size - 1))
+        size &= size - 1;
+    return size;
+}
+#endif
+
+
+static void log_fifo_init(log_fifo_t *pFifo, log_fifo_slot_t *pBuffer, volatile bool *pCommitted, uint8_t *pArena,
+                          uint32_t size)
+{
+#if LOG_FIFO_SPLIT
+    size = log_fifo_split_size(size);
+    pFifo->head = (log_fifo_head_t*)&pBuffer[size];
+#endif
+#if LOG_FIFO_HAS_COMMIT_FLAGS
+    pFifo->isCommitted = pCommitted;
+#else
+    (void)pCommitted;
+#endif
+#if LOG_COPY_ARENA_SIZE
+    pFifo->arena = pArena;
+#else
+    (void)pArena;
+#endif
+    pFifo->buffer = pBuffer;
+    pFifo->size   = size;
+    log_fifo_reset(pFifo);
+}
+
+
+#if LOG_POST_MORTEM
+static uint32_t log_crc32(uint32_t crc, const volatile void *pData, uint32_t length)
+{
+    const volatile uint8_t *pByte = pData;
+    uint32_t i;
+
+    // Bitwise to avoid a table in flash, it only runs when saving and restoring the FIFOs
+    while(length--)
+    {
+        crc ^= *pByte++;
+        for(i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xEDB88320UL & -(crc & 1));
+    }
+    return crc;
+}
+
+
+static uint32_t log_fifo_crc(uint32_t crc, log_fifo_t *pFifo)
+{
+    crc = log_crc32(crc, pFifo, sizeof(*pFifo));
+    crc = log_crc32(crc, pFifo->buffer, pFifo->size * sizeof(log_fifo_slot_t));
+#if LOG_FIFO_SPLIT
+    crc = log_crc32(crc, pFifo->head, pFifo->size * sizeof(log_fifo_head_t));
+#endif
+#if LOG_FIFO_HAS_COMMIT_FLAGS
+    crc = log_crc32(crc, pFifo->isCommitted, pFifo->size * sizeof(bool));
+#endif
+#if LOG_COPY_ARENA_SIZE
+    crc = log_crc32(crc, pFifo->arena, LOG_COPY_ARENA_SIZE);
+#endif
+    return crc;
+}
+
+
+// Checks that a FIFO found in RAM after a reset still describes its storage, before reading it
+static bool log_fifo_is_intact(log_fifo_t *pFifo, log_fifo_slot_t *pBuffer, volatile bool *pCommitted,
+                               uint8_t *pArena, uint32_t size)
+{
+#if LOG_FIFO_SPLIT
+    size = log_fifo_split_size(size);
+    if(pFifo->head != (log_fifo_head_t*)&pBuffer[size])
+        return false;
+#endif
+    if(pFifo->buffer != pBuffer || pFifo->size != size || log_fifo_used(pFifo) > size)
+        return false;
+#if LOG_FIFO_MODE == LOG_FIFO_LOCKED && !LOG_FIFO_PACKED
+    if(pFifo->wrIdx >= size || pFifo->rdIdx >= size)
+        return false;
+#endif
+#if LOG_FIFO_HAS_COMMIT_FLAGS
+    if(pFifo->isCommitted != pCommitted)
+        return false;
+#else
+    (void)pCommitted;
+#endif
+#if LOG_COPY_ARENA_SIZE
+    if(pFifo->arena != pArena || pFifo->arenaWrIdx - pFifo->arenaRdIdx > LOG_COPY_ARENA_SIZE)
+        return false;
+#else
+    (void)pArena;
+#endif
+    return true;
+}
+
+
+// Drops the items that a producer had reserved but not committed when the reset happened,
+// otherwise the log thread would wait for them forever
+static void log_fifo_recover(log_fifo_t *pFifo)
+{
+#if LOG_FIFO_PACKED
+    uint8_t record[LOG_PACKED_MAX_RECORD];
+    uint32_t idx = pFifo->rdIdx;
+    enum log_data_type type;
+
+    while(idx != pFifo->wrIdx)
+    {
+        record[0] = pFifo->buffer[idx & (pFifo->size - 1)];
+        if(record[0] == LOG_PACKED_HDR_EMPTY)
+            break;
+        if(LOG_PACKED_IS_EXT(record[0]))
+            record[1 + LOG_PACKED_PREFIX_SIZE] = pFifo->buffer[(idx + 1 + LOG_PACKED_PREFIX_SIZE) & (pFifo->size - 1)];
+        type = log_packed_type(record);
+        if(type >= LOG_ARRAY_N_ELEM(packedPayloadSize) || log_packed_type_len(type) > pFifo->wrIdx - idx)
+            break;
+        idx += log_packed_type_len(type);
+    }
+    pFifo->wrIdx = idx;
+#elif LOG_FIFO_HAS_COMMIT_FLAGS
+    uint32_t idx = pFifo->rdIdx;
+    uint32_t wrIdx = pFifo->wrIdx;
+
+    while(idx != wrIdx && pFifo->isCommitted[idx & (pFifo->size - 1)])
+        idx++;
+    pFifo->wrIdx = idx;
+    while(idx != wrIdx)                 // Committed after the dropped one, they cannot be kept in order
+        pFifo->isCommitted[idx++ & (pFifo->size - 1)] = false;
+#else
+    (void)pFifo;                        // Items only become visible once they are complete
+#endif
+}
+#endif
+
+
+#if LOG_POWER_FAIL_SAVE
+#define LOG_POWER_FAIL_MAGIC        0x4C4F4750UL    // "LOGP"
+#define LOG_POWER_FAIL_MARK         "\r\n--- Power fail ---\r\n"
+#define LOG_POWER_FAIL_START        ((uint32_t)__log_save_start)
+#define LOG_POWER_FAIL_END          ((uint32_t)__log_save_end)
+#define LOG_POWER_FAIL_ERASED       0xFFFFFFFFUL
+
+// First two double words of the FLASH_LOG_SAVE region, the magic is programmed last
+typedef struct log_power_fail_hdr_s
+{
+    uint32_t magic;
+    uint32_t length;                    // Bytes of chunks that follow the header
+    uint32_t crc;                       // CRC-32 of these bytes
+    uint32_t reserved;
+} log_power_fail_hdr_t;
+
+// Each chunk is the copy of a range of the .noinit.log section, to be written back at its address
+typedef struct log_power_fail_chunk_s
+{
+    uint32_t address;
+    uint32_t length;
+} log_power_fail_chunk_t;
+
+extern const uint8_t __log_save_start[];        // FLASH_LOG_SAVE region of the linker script
+extern const uint8_t __log_save_end[];
+extern uint8_t __log_noinit_start[];            // .noinit.log section of the FIFOs
+extern uint8_t __log_noinit_end[];
+
+static struct
+{
+    uint32_t address;                   // Of the next double word to program
+    uint32_t length;
+    uint32_t crc;
+    uint8_t  word[8];
+    uint32_t nBytes;                    // Bytes of word not programmed yet
+    bool     isFull;                    // The region is too small, the image is dropped
+} mPowerFail;
+
+
+// Programs a double word through the registers, no HAL lock nor tick count is involved
+static void log_flash_program(uint32_t address, const uint8_t *pWord)
+{
+    uint32_t low;
+    uint32_t high;
+
+    memcpy(&low, pWord, sizeof(low));
+    memcpy(&high, &pWord[sizeof(low)], sizeof(high));
+    while(FLASH->SR & FLASH_SR_BSY1)
+        ;
+    FLASH->SR = FLASH_SR_ERRORS;
+    FLASH->CR |= FLASH_CR_PG;
+    *(volatile uint32_t*)address = low;
+    __ISB();
+    *(volatile uint32_t*)(address + sizeof(low)) = high;
+    while(FLASH->SR & FLASH_SR_BSY1)
+        ;
+    FLASH->CR &= ~FLASH_CR_PG;
+}
+
+
+static void log_power_fail_put(const volatile void *pData, uint32_t length)
+{
+    const volatile uint8_t *pByte = pData;
+
+    mPowerFail.crc     = log_crc32(mPowerFail.crc, pData, length);
+    mPowerFail.length += length;
+    while(length-- && !mPowerFail.isFull)
+    {
+        mPowerFail.word[mPowerFail.nBytes++] = *pByte++;
+        if(mPowerFail.nBytes < sizeof(mPowerFail.word))
+            continue;
+        if(mPowerFail.address >= LOG_POWER_FAIL_END)
+        {
+            mPowerFail.isFull = true;
+            break;
+        }
+        log_flash_program(mPowerFail.address, mPowerFail.word);
+        mPowerFail.address += sizeof(mPowerFail.word);
+        mPowerFail.nBytes   = 0;
+    }
+}
+
+
+static void log_power_fail_chunk(const volatile void *pData, uint32_t length)
+{
+    log_power_fail_chunk_t chunk = {.address = (uint32_t)(uintptr_t)pData, .length = length};
+
+    if(!length)
+        return;
+    log_power_fail_put(&chunk, sizeof(chunk));
+    log_power_fail_put(pData, length);
+}
+
+
+// Saves count elements of elemSize bytes from index first of a ring of size elements (power of 2)
+static void log_power_fail_ring(const volatile void *pRing, uint32_t elemSize, uint32_t size, uint32_t first,
+                                uint32_t count)
+{
+    const volatile uint8_t *pBase = pRing;
+    uint32_t nFirst;
+
+    if(count > size)
+        count = size;
+    first &= size - 1;
+    nFirst = (count < size - first) ? count : size - first;
+    log_power_fail_chunk(&pBase[first * elemSize], nFirst * elemSize);
+    log_power_fail_chunk(pBase, (count - nFirst) * elemSize);
+}
+
+
+// Only the FIFO and its pending items are kept, the free slots are not worth their programming time
+static void log_fifo_power_fail_save(log_fifo_t *pFifo)
+{
+    log_power_fail_chunk(pFifo, sizeof(*pFifo));
+    log_power_fail_ring(pFifo->buffer, sizeof(log_fifo_slot_t), pFifo->size, pFifo->rdIdx, log_fifo_used(pFifo));
+#if LOG_FIFO_SPLIT
+    log_power_fail_ring(pFifo->head, sizeof(log_fifo_head_t), pFifo->size, pFifo->rdIdx, log_fifo_used(pFifo));
+#endif
+#if LOG_FIFO_HAS_COMMIT_FLAGS
+    log_power_fail_ring(pFifo->isCommitted, sizeof(bool), pFifo->size, pFifo->rdIdx, log_fifo_used(pFifo));
+#endif
+#if LOG_COPY_ARENA_SIZE
+    log_power_fail_ring(pFifo->arena, 1, LOG_COPY_ARENA_SIZE, pFifo->arenaRdIdx,
+                        pFifo->arenaWrIdx - pFifo->arenaRdIdx);
+#endif
+}
+#endif
+
+
+#if LOG_THREAD_WAKEUP || LOG_FLIGHT_RECORDER || LOG_DELEGATED_FLUSH || LOG_OVERFLOW_BLOCK
+// Gives the notification the logger thread waits for, from a task or an ISR
+static void log_thread_notify(void)
+{
+    BaseType_t isYieldNeeded = pdFALSE;
+
+#if LOG_ISR_UNMASKED
+    if(_logFromIsr || __get_IPSR())
+#else
+    if(__get_IPSR())
+#endif
+    {
+        vTaskNotifyGiveFromISR(mLogTask, &isYieldNeeded);
+        portYIELD_FROM_ISR(isYieldNeeded);
+    }
+    else
+        xTaskNotifyGive(mLogTask);
+}
+#endif
+
+
+#if LOG_BOOST_FILL_PERCENT
+// Raises the priority of the log thread once the FIFO fill level crosses the watermark, so a burst of
+// higher priority logs does not starve it. ISRs cannot change priorities, the next task log does it.
+static inline void log_thread_boost(log_fifo_t *pFifo)
+{
+#if LOG_ISR_UNMASKED
+    if(mIsBoosted || !mLogTask || _logFromIsr || __get_IPSR())
+#else
+    if(mIsBoosted || !mLogTask || __get_IPSR())
+#endif
+        return;
+    if(log_fifo_used(pFifo) * 100 < pFifo->size * LOG_BOOST_FILL_PERCENT)
+        return;
+
+    mIsBoosted = true;
+    vTaskPrioritySet(mLogTask, LOG_BOOST_PRIORITY);
+}
+#else
+static inline void log_thread_boost(log_fifo_t *pFifo)
+{
+    (void)pFifo;
+}
+#endif
+
+
+#if LOG_THREAD_WAKEUP
+// Notifies the log thread once when the FIFO fill level crosses the watermark
+static inline void log_input_wakeup(log_fifo_t *pFifo)
+{
+    log_thread_boost(pFifo);
+    if(mIsWakeupPending || !mLogTask)
+        return;
+    if(log_fifo_used(pFifo) * 100 < pFifo->size * LOG_WAKEUP_LEVEL)
+        return;
+
+    mIsWakeupPending = true;
+    log_thread_notify();
+}
+#elif LOG_FLIGHT_RECORDER
+// Notifies the log thread once the capture is complete
+static inline void log_input_wakeup(log_fifo_t *pFifo)
+{
+    uint32_t primaskBit;
+    bool isCaptured;
+
+    (void)pFifo;
+    if(mRecorderState != LOG_RECORDER_CAPTURED || !mLogTask)
+        return;
+
+    LOG_ENTER_CRITICAL(primaskBit);
+    isCaptured = (mRecorderState == LOG_RECORDER_CAPTURED);
+    if(isCaptured)
+        mRecorderState = LOG_RECORDER_OUTPUT;
+    LOG_EXIT_CRITICAL(primaskBit);
+
+    if(isCaptured)
+        log_thread_notify();
+}
+#else
+static inline void log_input_wakeup(log_fifo_t *pFifo)
+{
+    log_thread_boost(pFifo);
+}
+#endif
+
+
+#if LOG_STATS
+// Counts the items as dropped, or as enqueued if the put did not, and updates the high-water mark
+static inline void log_input_count(log_fifo_t *pFifo, uint32_t nItems, bool isStored)
+{
+    uint32_t primaskBit;
+    uint32_t used;
+
+#if LOG_FIFO_COUNTS_STORES
+    if(isStored)
+        return;
+#endif
+    LOG_ENTER_CRITICAL(primaskBit);
+    if(isStored)
+        log_stats_stored(pFifo, nItems);
+    else
+    {
+        mStats.nDropped += nItems;
+#if LOG_SEQUENCE_NUMBERS
+        mSeq += nItems;                 // The gap shows the loss to the host
+#endif
+        used = log_fifo_used(pFifo);
+        if(used > mStats.highWater)
+            mStats.highWater = used;
+    }
+    LOG_EXIT_CRITICAL(primaskBit);
+}
+#elif LOG_SEQUENCE_NUMBERS
+// Dropped items still take their sequence numbers, the gap shows the loss to the host
+static inline void log_input_count(log_fifo_t *pFifo, uint32_t nItems, bool isStored)
+{
+    uint32_t primaskBit;
+
+    (void)pFifo;
+    if(isStored)
+        return;
+    LOG_ENTER_CRITICAL(primaskBit);
+    mSeq += nItems;
+    LOG_EXIT_CRITICAL(primaskBit);
+}
+#else
+static inline void log_input_count(log_fifo_t *pFifo, uint32_t nItems, bool isStored)
+{
+    (void)pFifo;
+    (void)nItems;
+    (void)isStored;
+}
+#endif
+
+
+#if LOG_SATURATION_HOOKS
+static log_saturation_handler mSaturationHandler = NULL;
+static uint32_t mSaturationMs[_LOG_SATURATION_LEN];         // LOG_RATELIMIT_MS_GET() of the last call of each event
+static uint32_t mSaturationCounts[_LOG_SATURATION_LEN];     // Drops since the last call
+static uint32_t mSaturationCalled = 0;                      // Bit of each event called at least once
+
+
+void log_set_saturation_handler(log_saturation_handler handler)
+{
+    mSaturationHandler = handler;
+}
+
+
+// Calls the saturation handler unless the event had a call less than LOG_SATURATION_HOOK_MS ago.
+// The drop counts are summed until the next call, the high water value is the current fill level.
+void log_saturation_notify(log_saturation_event_t event, uint32_t value)
+{
+    log_saturation_handler handler = mSaturationHandler;
+    uint32_t now = LOG_RATELIMIT_MS_GET();
+    uint32_t primaskBit;
+    bool isDue;
+
+    if(!handler || event >= _LOG_SATURATION_LEN)
+        return;
+    LOG_ENTER_CRITICAL(primaskBit);
+    if(event != LOG_SATURATION_HIGH_WATER)
+        value = (mSaturationCounts[event] += value);
+    isDue = !(mSaturationCalled & (1UL << event)) || now - mSaturationMs[event] >= LOG_SATURATION_HOOK_MS;
+    if(isDue)
+    {
+        mSaturationMs[event] = now;
+        mSaturationCalled |= 1UL << event;
+        mSaturationCounts[event] = 0;
+    }
+    LOG_EXIT_CRITICAL(primaskBit);
+    if(isDue)
+        handler(event, value);
+}
+#endif
+
+
+// Counts the result of a store and reports the saturation of the FIFO, in the producer context
+static inline void log_input_stats(log_fifo_t *pFifo, uint32_t nItems, bool isStored)
+{
+    log_input_count(pFifo, nItems, isStored);
+#if LOG_SATURATION_HOOKS
+    if(!mSaturationHandler)
+        return;
+    if(!isStored)
+        log_saturation_notify(LOG_SATURATION_FIFO_DROP, nItems);
+    else if(log_fifo_used(pFifo) * 100 >= pFifo->size * LOG_SATURATION_PERCENT)
+        log_saturation_notify(LOG_SATURATION_HIGH_WATER, log_fifo_used(pFifo));
+#endif
+}
+
+#if LOG_CONTEXT_IDS
+static char                 mContextNames[LOG_CONTEXT_N_TASKS][configMAX_TASK_NAME_LEN];
+static uint32_t             mNContexts = 0;
+
+
+// Gives the calling task the next free ID and copies its name, called once per task
+static uint8_t log_context_register(void)
+{
+    uint32_t primaskBit;
+    uint32_t id = LOG_CONTEXT_ID_UNKNOWN;
+
+    LOG_ENTER_CRITICAL(primaskBit);
+    if(mNContexts < LOG_CONTEXT_N_TASKS)
+    {
+        strncpy(mContextNames[mNContexts], pcTaskGetName(NULL), configMAX_TASK_NAME_LEN - 1);
+        id = ++mNContexts;
+    }
+    LOG_EXIT_CRITICAL(primaskBit);
+
+    vTaskSetThreadLocalStoragePointer(NULL, LOG_CONTEXT_TLS_INDEX, (void*)(uintptr_t)id);
+    return id;
+}
+
+
+// ISRs are told by IPSR, tasks by the ID kept in their thread local storage
+static inline uint8_t log_context_id(void)
+{
+    uint32_t ipsr = __get_IPSR();
+    uint32_t id;
+
+    if(ipsr)
+        return LOG_CONTEXT_ID_ISR | ipsr;
+    if(xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)
+        return LOG_CONTEXT_ID_MAIN;
+
+    id = (uintptr_t)pvTaskGetThreadLocalStoragePointer(NULL, LOG_CONTEXT_TLS_INDEX);
+    return id ? id : log_context_register();
+}
+#endif
+
+
+#if LOG_CONTEXT_QUOTA
+static uint16_t             mQuotaUsed[LOG_QUOTA_N_CONTEXTS];   // Items of each context in the input FIFOs
+
+
+// Counter of the context, see LOG_QUOTA_N_CONTEXTS
+static inline uint32_t log_quota_index(uint8_t ctxId)
+{
+    if(ctxId & LOG_CONTEXT_ID_ISR)
+        return LOG_QUOTA_N_CONTEXTS - 1;
+    if(ctxId == LOG_CONTEXT_ID_UNKNOWN)
+        return LOG_QUOTA_N_CONTEXTS - 2;
+    return ctxId;
+}
+
+
+// Takes nItems of the quota of the context before they are stored, false if it would be exceeded
+static inline bool log_quota_take(uint8_t ctxId, uint32_t nItems)
+{
+    uint32_t idx = log_quota_index(ctxId);
+    bool isTaken = false;
+    uint32_t primaskBit;
+
+    LOG_ENTER_CRITICAL(primaskBit);
+    if(mQuotaUsed[idx] + nItems <= LOG_CONTEXT_QUOTA)
+    {
+        mQuotaUsed[idx] += nItems;
+        isTaken = true;
+    }
+#if LOG_STATS
+    else
+        mStats.nQuotaDropped[idx] += nItems;
+#endif
+    LOG_EXIT_CRITICAL(primaskBit);
+    return isTaken;
+}
+
+
+// Gives back the quota of items dropped by the FIFO or extracted by the log thread. Items restored
+// by LOG_POST_MORTEM were not counted, hence the floor.
+static inline void log_quota_give(uint8_t ctxId, uint32_t nItems)
+{
+    uint32_t idx = log_quota_index(ctxId);
+    uint32_t primaskBit;
+
+    LOG_ENTER_CRITICAL(primaskBit);
+    mQuotaUsed[idx] = (mQuotaUsed[idx] > nItems) ? mQuotaUsed[idx] - nItems : 0;
+    LOG_EXIT_CRITICAL(primaskBit);
+}
+#endif
+
+
+#if LOG_CPU_BUDGET_PERCENT
+#define LOG_CPU_BUDGET_TICKS        ((int32_t)(LOG_CPU_BUDGET_WINDOW_TICKS * LOG_CPU_BUDGET_PERCENT / 100))
+
+static volatile bool        mIsOverBudget = false;  // The log thread spent its credit, set until it refills
+static int32_t              mBudgetCredit = LOG_CPU_BUDGET_TICKS;   // Ticks the log thread may still work
+static uint32_t             mBudgetLast = 0;        // LOG_TIMESTAMP_GET() of the last refill
+
+
+// Tells if the item, or the group of nItems it starts, is shed because the log thread is over budget
+LOG_RAMFUNC static inline bool log_budget_shed(const log_fifo_item_t *pItem, uint32_t nItems)
+{
+#if LOG_STATS
+    uint32_t primaskBit;
+#endif
+
+    if(!mIsOverBudget || pItem->level <= LOG_CPU_BUDGET_SHED_LEVEL)
+        return false;
+#if LOG_STATS
+    LOG_ENTER_CRITICAL(primaskBit);
+    mStats.nBudgetShed += nItems;
+    LOG_EXIT_CRITICAL(primaskBit);
+#endif
+    return true;
+}
+#endif
+
+
+#if LOG_OVERFLOW_BLOCK
+// Each slot has a binary semaphore of its own, so the wait leaves the notification of the task to
+// the application
+static void log_overflow_init(void)
+{
+    uint32_t i;
+
+    for(i = 0; i < LOG_OVERFLOW_BLOCK_TASKS; i++)
+    {
+        mOverflowSlots[i] = LOG_OVERFLOW_FREE;
+        mOverflowSems[i]  = xSemaphoreCreateBinaryStatic(&mOverflowSemBuffers[i]);
+    }
+}
+
+
+// Has the log thread make room in the full input FIFO and sleeps until a pass is done, *pTimeLeft
+// ticks at most. Returns false if the caller must drop its item: the wait is over, or it cannot block
+// as it is an ISR, runs with the interrupts masked, before the scheduler or is the log thread.
+static bool log_overflow_wait(TickType_t *pTimeLeft)
+{
+    TickType_t start;
+    TickType_t elapsed;
+    uint32_t primaskBit;
+    uint32_t i;
+    bool isTaken;
+    bool isGiven;
+
+    if(!*pTimeLeft || __get_PRIMASK() || __get_IPSR() || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING ||
+       !mLogTask || xTaskGetCurrentTaskHandle() == mLogTask)
+        return false;
+
+    LOG_ENTER_CRITICAL(primaskBit);
+    for(i = 0; i < LOG_OVERFLOW_BLOCK_TASKS && mOverflowSlots[i] != LOG_OVERFLOW_FREE; i++);
+    if(i < LOG_OVERFLOW_BLOCK_TASKS)
+        mOverflowSlots[i] = LOG_OVERFLOW_WAITING;
+    LOG_EXIT_CRITICAL(primaskBit);
+
+    start = xTaskGetTickCount();
+    log_thread_notify();
+    if(i < LOG_OVERFLOW_BLOCK_TASKS)
+    {
+        isTaken = (xSemaphoreTake(mOverflowSems[i], *pTimeLeft) == pdTRUE);
+        LOG_ENTER_CRITICAL(primaskBit);
+        isGiven = (mOverflowSlots[i] == LOG_OVERFLOW_GIVEN);
+        if(isTaken || !isGiven)
+            mOverflowSlots[i] = LOG_OVERFLOW_FREE;
+        LOG_EXIT_CRITICAL(primaskBit);
+        // Timed out while the log thread was giving it: the slot is kept until the semaphore is
+        // taken, so the next task of the slot does not start with a stale give
+        if(isGiven && !isTaken)
+        {
+            xSemaphoreTake(mOverflowSems[i], portMAX_DELAY);
+            mOverflowSlots[i] = LOG_OVERFLOW_FREE;
+        }
+    }
+    else
+        vTaskDelay(1);                  // All the slots are taken
+    elapsed = xTaskGetTickCount() - start;
+    *pTimeLeft = (elapsed < *pTimeLeft) ? *pTimeLeft - elapsed : 0;
+    return true;
+}
+
+
+// Wakes up the tasks waiting for room, called by the log thread after each pass. A slot is given once,
+// its task frees it.
+static void log_overflow_release(void)
+{
+    uint32_t primaskBit;
+    uint32_t i;
+    bool isWaiting;
+
+    for(i = 0; i < LOG_OVERFLOW_BLOCK_TASKS; i++)
+    {
+        LOG_ENTER_CRITICAL(primaskBit);
+        isWaiting = (mOverflowSlots[i] == LOG_OVERFLOW_WAITING);
+        if(isWaiting)
+            mOverflowSlots[i] = LOG_OVERFLOW_GIVEN;
+        LOG_EXIT_CRITICAL(primaskBit);
+        if(isWaiting)
+            xSemaphoreGive(mOverflowSems[i]);
+    }
+}
+#else
+static inline void log_overflow_release(void)
+{
+}
+#endif
+
+
+// Stores the item in pFifo if its context is within its quota
+LOG_RAMFUNC static inline bool log_input_store(log_fifo_item_t *pItem, log_fifo_t *pFifo, const void *pData,
+                                               uint32_t length)
+{
+#if LOG_OVERFLOW_BLOCK
+    TickType_t timeLeft = pdMS_TO_TICKS(LOG_OVERFLOW_BLOCK_MS);
+#endif
+
+#if LOG_CPU_BUDGET_PERCENT
+    if(log_budget_shed(pItem, 1))
+        return false;
+#endif
+#if LOG_CONTEXT_QUOTA
+    if(!log_quota_take(pItem->ctxId, 1))
+        return false;
+#endif
+    while(!log_fifo_put_copy(pItem, pFifo, pData, length))
+    {
+#if LOG_OVERFLOW_BLOCK
+        if(log_overflow_wait(&timeLeft))
+            continue;
+#endif
+#if LOG_CONTEXT_QUOTA
+        log_quota_give(pItem->ctxId, 1);
+#endif
+        return false;
+    }
+    return true;
+}
+
+
+// Same for a group of log_fifo_put_n(), which has the context of its first item
+LOG_RAMFUNC static inline bool log_input_store_n(log_fifo_t *pFifo, uint32_t nItems, log_fifo_fill_t fill,
+                                                 const void *pCtx)
+{
+#if LOG_CONTEXT_QUOTA || LOG_CPU_BUDGET_PERCENT
+    log_fifo_item_t item;
+#endif
+#if LOG_OVERFLOW_BLOCK
+    TickType_t timeLeft = pdMS_TO_TICKS(LOG_OVERFLOW_BLOCK_MS);
+#endif
+
+#if LOG_CONTEXT_QUOTA || LOG_CPU_BUDGET_PERCENT
+    fill(&item, 0, pCtx);
+#endif
+#if LOG_CPU_BUDGET_PERCENT
+    if(log_budget_shed(&item, nItems))
+        return false;
+#endif
+#if LOG_CONTEXT_QUOTA
+    if(!log_quota_take(item.ctxId, nItems))
+        return false;
+#endif
+    while(!log_fifo_put_n(pFifo, nItems, fill, pCtx))
+    {
+#if LOG_OVERFLOW_BLOCK
+        if(log_overflow_wait(&timeLeft))
+            continue;
+#endif
+#if LOG_CONTEXT_QUOTA
+        log_quota_give(item.ctxId, nItems);
+#endif
+        return false;
+    }
+    return true;
+}
+
+
+#if LOG_DEFERRED_STRLEN
+// A log_str() of a non constant string is measured here instead of by its producer
+static inline void log_strlen_resolve(log_fifo_item_t *pItem)
+{
+    size_t length;
+
+    if(pItem->type != _LOG_STRING || pItem->strLen != LOG_STR_LEN_UNKNOWN)
+        return;
+    length = strlen(pItem->str);
+    pItem->strLen = (length < LOG_STR_LEN_UNKNOWN) ? length : LOG_STR_LEN_UNKNOWN - 1;
+}
+#endif
+
+
+#if ((LOG_TIMESTAMPS || LOG_CONTEXT_IDS || LOG_SEQUENCE_NUMBERS || LOG_LINE_PREFIX) && !LOG_BINARY_OUTPUT && !LOG_SYSVIEW) || \
+    LOG_ERROR_FIFO_N_ELEM
+// Tells if the item is the last one of its line, its copied data is in the arena of pFifo
+static bool log_item_ends_line(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+{
+#if LOG_DEFERRED_STRLEN
+    log_strlen_resolve(pItem);
+#endif
+    switch(pItem->type)
+    {
+    case _LOG_STRING:
+        return pItem->strLen && pItem->str[pItem->strLen - 1] == '\n';
+    case LOG_CHAR:
+        return pItem->chr[pItem->nChars - 1] == '\n';
+#if LOG_COPY_ARENA_SIZE
+    case _LOG_STRING_COPY:
+        return pItem->strLen && *log_arena_ptr(pFifo, pItem->arenaIdx + pItem->strLen - 1) == '\n';
+    case _LOG_HEXDUMP_COPY:
+#endif
+    case _LOG_HEXDUMP:                  // Every line of a dump is terminated
+    case _LOG_KV:                       // And so is a record, with its pairs
+        return true;
+#if LOG_PRINTF
+    case _LOG_CUSTOM:
+        if(pItem->customId == LOG_PRINTF_TYPE_ID)
+        {
+            const char *pFmt;
+
+            memcpy(&pFmt, log_arena_ptr(pFifo, pItem->arenaIdx), sizeof(pFmt));
+            return pFmt[0] && pFmt[strlen(pFmt) - 1] == '\n';
+        }
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+#endif
+
+
+#if LOG_PER_CONTEXT_FIFOS
+
+// Selects the ISR FIFO or the FIFO of the priority band of the calling task
+static inline log_fifo_t *log_input_fifo(void)
+{
+    if(__get_IPSR())
+        return &isrFifo;
+    if(xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)
+        return &taskFifos[0];
+    return &taskFifos[(uxTaskPriorityGet(NULL) * LOG_N_TASK_FIFOS) / configMAX_PRIORITIES];
+}
+
+
+LOG_RAMFUNC static inline void log_input_put(log_fifo_item_t *pItem)
+{
+    log_fifo_t *pFifo = log_input_fifo();
+
+#if LOG_TIMESTAMPS
+    pItem->timestamp = LOG_TIMESTAMP_GET();
+#endif
+#if LOG_CONTEXT_IDS
+    pItem->ctxId = log_context_id();
+#endif
+    log_input_stats(pFifo, 1, log_input_store(pItem, pFifo, NULL, 0));
+    log_input_wakeup(pFifo);
+}
+
+
+LOG_RAMFUNC static inline void log_input_put_copy(log_fifo_item_t *pItem, const void *pData, uint32_t length)
+{
+    log_fifo_t *pFifo = log_input_fifo();
+
+#if LOG_TIMESTAMPS
+    pItem->timestamp = LOG_TIMESTAMP_GET();
+#endif
+#if LOG_CONTEXT_IDS
+    pItem->ctxId = log_context_id();
+#endif
+    log_input_stats(pFifo, 1, log_input_store(pItem, pFifo, pData, length));
+    log_input_wakeup(pFifo);
+}
+
+
+// Items that must not be split are stored at once, fill() also sets their timestamp and context ID
+LOG_RAMFUNC static inline bool log_input_put_n(uint32_t nItems, log_fifo_fill_t fill, const void *pCtx)
+{
+    log_fifo_t *pFifo = log_input_fifo();
+    bool isStored = log_input_store_n(pFifo, nItems, fill, pCtx);
+
+    log_input_stats(pFifo, nItems, isStored);
+    log_input_wakeup(pFifo);
+    return isStored;
+}
+
+
+// Extracts the oldest item among all context FIFOs, returns the FIFO it comes from
+static log_fifo_t *log_input_get(log_fifo_item_t *pItem)
+{
+    log_fifo_t *pOldest = NULL;
+    log_fifo_item_t head;
+    uint16_t oldestSeq = 0;
+    uint32_t i;
+
+    for(i = 0; i <= LOG_N_TASK_FIFOS; i++)
+    {
+        log_fifo_t *pFifo = (i < LOG_N_TASK_FIFOS) ? &taskFifos[i] : &isrFifo;
+
+        if(log_fifo_peek(&head, pFifo))
+        {
+            if(!pOldest || (int16_t)(head.seq - oldestSeq) < 0)
+            {
+                pOldest   = pFifo;
+                oldestSeq = head.seq;
+            }
+        }
+        else if(!log_fifo_is_empty(pFifo))
+            return NULL;                // Uncommitted item, wait for it to keep global order
+    }
+
+    if(pOldest && log_fifo_get(pItem, pOldest))
+        return pOldest;
+    return NULL;
+}
+
+
+static bool log_input_is_full(void)
+{
+    bool isFull = log_fifo_is_full(&isrFifo);
+    uint32_t i;
+
+    for(i = 0; i < LOG_N_TASK_FIFOS; i++)
+        isFull |= log_fifo_is_full(&taskFifos[i]);
+    return isFull;
+}
+
+
+#if LOG_LOW_POWER
+static bool log_input_is_empty(void)
+{
+    bool isEmpty = log_fifo_is_empty(&isrFifo);
+    uint32_t i;
+
+    for(i = 0; i < LOG_N_TASK_FIFOS; i++)
+        isEmpty &= log_fifo_is_empty(&taskFifos[i]);
+    return isEmpty;
+}
+#endif
+
+
+#if LOG_BOOST_FILL_PERCENT || LOG_GOVERNOR
+static bool log_input_is_below(uint32_t percent)
+{
+    bool isBelow = log_fifo_used(&isrFifo) * 100 < isrFifo.size * percent;
+    uint32_t i;
+
+    for(i = 0; i < LOG_N_TASK_FIFOS; i++)
+        isBelow &= log_fifo_used(&taskFifos[i]) * 100 < taskFifos[i].size * percent;
+    return isBelow;
+}
+#endif
+
+
+static void log_input_init(void)
+{
+    uint32_t i;
+
+    log_fifo_init(&isrFifo, isrFifoBuffer, LOG_FIFO_COMMIT_FLAGS(isrFifoCommitted), LOG_FIFO_ARENA(isrFifoArena),
+                  LOG_ARRAY_N_ELEM(isrFifoBuffer));
+    for(i = 0; i < LOG_N_TASK_FIFOS; i++)
+        log_fifo_init(&taskFifos[i], taskFifoBuffers[i], LOG_FIFO_COMMIT_FLAGS(taskFifosCommitted[i]),
+                      LOG_FIFO_ARENA(taskFifoArenas[i]), LOG_ARRAY_N_ELEM(taskFifoBuffers[i]));
+    mSeq = 0;
+}
+
+
+#if LOG_POST_MORTEM
+static uint32_t log_input_crc(void)
+{
+    uint32_t crc = log_crc32(0xFFFFFFFFUL, &mSeq, sizeof(mSeq));
+    uint32_t i;
+
+    crc = log_fifo_crc(crc, &isrFifo);
+    for(i = 0; i < LOG_N_TASK_FIFOS; i++)
+        crc = log_fifo_crc(crc, &taskFifos[i]);
+    return ~crc;
+}
+
+
+// Keeps the FIFOs found in RAM after a reset if they are the ones saved by log_post_mortem_save()
+static bool log_input_restore(void)
+{
+    uint32_t i;
+
+    if(!log_fifo_is_intact(&isrFifo, isrFifoBuffer, LOG_FIFO_COMMIT_FLAGS(isrFifoCommitted),
+                           LOG_FIFO_ARENA(isrFifoArena), LOG_ARRAY_N_ELEM(isrFifoBuffer)))
+        return false;
+    for(i = 0; i < LOG_N_TASK_FIFOS; i++)
+        if(!log_fifo_is_intact(&taskFifos[i], taskFifoBuffers[i], LOG_FIFO_COMMIT_FLAGS(taskFifosCommitted[i]),
+                               LOG_FIFO_ARENA(taskFifoArenas[i]), LOG_ARRAY_N_ELEM(taskFifoBuffers[i])))
+            return false;
+    if(log_input_crc() != mPostMortem.crc)
+        return false;
+
+    log_fifo_recover(&isrFifo);
+    for(i = 0; i < LOG_N_TASK_FIFOS; i++)
+        log_fifo_recover(&taskFifos[i]);
+    return true;
+}
+#endif
+
+#if LOG_POWER_FAIL_SAVE
+static void log_input_power_fail_save(void)
+{
+    uint32_t i;
+
+    log_power_fail_chunk(&mSeq, sizeof(mSeq));
+    log_fifo_power_fail_save(&isrFifo);
+    for(i = 0; i < LOG_N_TASK_FIFOS; i++)
+        log_fifo_power_fail_save(&taskFifos[i]);
+}
+#endif
+
+#else
+
+#if LOG_ERROR_FIFO_N_ELEM
+// The logs of LOG_LEVEL_ERROR, per file or per call (log_err_), have their own FIFO
+static inline log_fifo_t *log_input_fifo(const log_fifo_item_t *pItem)
+{
+    return (pItem->level == LOG_LEVEL_ERROR) ? &errorFifo : &logFifo;
+}
+
+// Same for a group of log_input_put_n(), which has the level of its first item
+static inline log_fifo_t *log_input_fifo_n(log_fifo_fill_t fill, const void *pCtx)
+{
+    log_fifo_item_t item;
+
+    fill(&item, 0, pCtx);
+    return log_input_fifo(&item);
+}
+#else
+#define log_input_fifo(pItem)           (&logFifo)
+#define log_input_fifo_n(fill, pCtx)    (&logFifo)
+#endif
+
+
+LOG_RAMFUNC static inline void log_input_put(log_fifo_item_t *pItem)
+{
+    log_fifo_t *pFifo = log_input_fifo(pItem);
+
+#if LOG_TIMESTAMPS
+    pItem->timestamp = LOG_TIMESTAMP_GET();
+#endif
+#if LOG_CONTEXT_IDS
+    pItem->ctxId = log_context_id();
+#endif
+    log_input_stats(pFifo, 1, log_input_store(pItem, pFifo, NULL, 0));
+    log_input_wakeup(pFifo);
+}
+
+
+LOG_RAMFUNC static inline void log_input_put_copy(log_fifo_item_t *pItem, const void *pData, uint32_t length)
+{
+    log_fifo_t *pFifo = log_input_fifo(pItem);
+
+#if LOG_TIMESTAMPS
+    pItem->timestamp = LOG_TIMESTAMP_GET();
+#endif
+#if LOG_CONTEXT_IDS
+    pItem->ctxId = log_context_id();
+#endif
+    log_input_stats(pFifo, 1, log_input_store(pItem, pFifo, pData, length));
+    log_input_wakeup(pFifo);
+}
+
+
+// Items that must not be split are stored at once, fill() also sets their timestamp and context ID
+LOG_RAMFUNC static inline bool log_input_put_n(uint32_t nItems, log_fifo_fill_t fill, const void *pCtx)
+{
+    log_fifo_t *pFifo = log_input_fifo_n(fill, pCtx);
+    bool isStored = log_input_store_n(pFifo, nItems, fill, pCtx);
+
+    log_input_stats(pFifo, nItems, isStored);
+    log_input_wakeup(pFifo);
+    return isStored;
+}
+
+
+#if LOG_INLINE_PRODUCERS && LOG_INPUT_NOTIFY
+// End of the items stored by _log_var_inline(), out of line as it is not needed by default
+void _log_input_notify(bool isStored)
+{
+    log_input_stats(&logFifo, 1, isStored);
+    log_input_wakeup(&logFifo);
+}
+#endif
+
+
+#if LOG_INLINE_PRODUCERS && LOG_STATS
+// _log_var_inline() cannot reach the counters, it counts its stores through this call
+LOG_RAMFUNC void _log_inline_stored(void)
+{
+    log_stats_stored(&logFifo, 1);
+}
+#endif
+
+
+#if LOG_ERROR_FIFO_N_ELEM
+// Error lines go first, but a line being output is finished from its FIFO as long as that one has
+// items, so lines are only split when their end is not logged yet
+static log_fifo_t *log_input_get(log_fifo_item_t *pItem)
+{
+    log_fifo_t *pFifo = mLineFifo;
+
+    if(!pFifo || log_fifo_is_empty(pFifo))
+        pFifo = log_fifo_is_empty(&errorFifo) ? &logFifo : &errorFifo;
+    if(!log_fifo_get(pItem, pFifo))
+        return NULL;
+
+    mLineFifo = log_item_ends_line(pItem, pFifo) ? NULL : pFifo;
+    return pFifo;
+}
+#else
+static inline log_fifo_t *log_input_get(log_fifo_item_t *pItem)
+{
+    return log_fifo_get(pItem, &logFifo) ? &logFifo : NULL;
+}
+#endif
+
+
+static inline bool log_input_is_full(void)
+{
+#if LOG_FLIGHT_RECORDER
+    return false;                       // The normal state, the oldest items are overwritten
+#elif LOG_ERROR_FIFO_N_ELEM
+    return log_fifo_is_full(&logFifo) || log_fifo_is_full(&errorFifo);
+#else
+    return log_fifo_is_full(&logFifo);
+#endif
+}
+
+
+#if LOG_BOOST_FILL_PERCENT || LOG_GOVERNOR
+static inline bool log_input_is_below(uint32_t percent)
+{
+#if LOG_ERROR_FIFO_N_ELEM
+    if(log_fifo_used(&errorFifo) * 100 >= errorFifo.size * percent)
+        return false;
+#endif
+    return log_fifo_used(&logFifo) * 100 < logFifo.size * percent;
+}
+#endif
+
+
+#if LOG_FLIGHT_RECORDER || LOG_LOW_POWER
+static inline bool log_input_is_empty(void)
+{
+#if LOG_ERROR_FIFO_N_ELEM
+    if(!log_fifo_is_empty(&errorFifo))
+        return false;
+#endif
+    return log_fifo_is_empty(&logFifo);
+}
+#endif
+
+
+#if LOG_FIFO_SPARE_RAM
+// Largest power of 2 of slots that fits in the .log_fifo region together with their commit flags
+static uint32_t log_fifo_spare_slots(void)
+{
+    uint32_t nSlots = (uint32_t)(__log_fifo_end - (uint8_t*)__log_fifo_start) /
+                      (sizeof(log_fifo_slot_t) + (LOG_FIFO_HAS_COMMIT_FLAGS ? sizeof(bool) : 0));
+
+    while(nSlots & (nSlots - 1))
+        nSlots &= nSlots - 1;
+    return nSlots;
+}
+#endif
+
+
+static void log_input_init(void)
+{
+    log_fifo_init(&logFifo, logFifoBuffer, LOG_FIFO_COMMIT_FLAGS(logFifoCommitted), LOG_FIFO_ARENA(logFifoArena),
+                  LOG_FIFO_BUFFER_SLOTS);
+#if LOG_ERROR_FIFO_N_ELEM
+    log_fifo_init(&errorFifo, errorFifoBuffer, LOG_FIFO_COMMIT_FLAGS(errorFifoCommitted),
+                  LOG_FIFO_ARENA(errorFifoArena), LOG_ARRAY_N_ELEM(errorFifoBuffer));
+    mLineFifo = NULL;
+#endif
+#if LOG_SEQUENCE_NUMBERS
+    mSeq = 0;
+#endif
+}
+
+
+#if LOG_POST_MORTEM
+static uint32_t log_input_crc(void)
+{
+    uint32_t crc = log_fifo_crc(0xFFFFFFFFUL, &logFifo);
+
+#if LOG_ERROR_FIFO_N_ELEM
+    crc = log_fifo_crc(crc, &errorFifo);
+#endif
+    return ~crc;
+}
+
+
+// Keeps the FIFOs found in RAM after a reset if they are the ones saved by log_post_mortem_save()
+static bool log_input_restore(void)
+{
+    if(!log_fifo_is_intact(&logFifo, logFifoBuffer, LOG_FIFO_COMMIT_FLAGS(logFifoCommitted),
+                           LOG_FIFO_ARENA(logFifoArena), LOG_FIFO_BUFFER_SLOTS))
+        return false;
+#if LOG_ERROR_FIFO_N_ELEM
+    if(!log_fifo_is_intact(&errorFifo, errorFifoBuffer, LOG_FIFO_COMMIT_FLAGS(errorFifoCommitted),
+                           LOG_FIFO_ARENA(errorFifoArena), LOG_ARRAY_N_ELEM(errorFifoBuffer)))
+        return false;
+#endif
+    if(log_input_crc() != mPostMortem.crc)
+        return false;
+
+    log_fifo_recover(&logFifo);
+#if LOG_ERROR_FIFO_N_ELEM
+    log_fifo_recover(&errorFifo);
+#endif
+    return true;
+}
+#endif
+
+#if LOG_POWER_FAIL_SAVE
+static void log_input_power_fail_save(void)
+{
+    log_fifo_power_fail_save(&logFifo);
+#if LOG_ERROR_FIFO_N_ELEM
+    log_fifo_power_fail_save(&errorFifo);
+#endif
+}
+#endif
+
+#endif
+
+
+#if LOG_INSTANCES
+#define LOG_CTX_FIFO(pCtx)          ((log_fifo_t*)(pCtx)->fifo)
+#define LOG_CTX_SLOT_SIZE           (sizeof(log_fifo_slot_t) + (LOG_FIFO_HAS_COMMIT_FLAGS ? sizeof(bool) : 0))
+
+
+// LOG_CTX_DEFAULT stores in the input FIFO of log_init() the same way as the plain macros
+static inline void log_ctx_put(log_ctx_t *pCtx, log_fifo_item_t *pItem)
+{
+    log_fifo_t *pFifo;
+
+    if(pCtx == LOG_CTX_DEFAULT)
+    {
+        log_input_put(pItem);
+        return;
+    }
+    pFifo = LOG_CTX_FIFO(pCtx);
+    log_input_stats(pFifo, 1, log_fifo_put(pItem, pFifo));
+    log_input_wakeup(pFifo);
+}
+#endif
+
+
+#if LOG_LATENCY
+#define LOG_LATENCY_BATCHES         4   // Handler calls whose transfer may still be ongoing, the DMA has one
+
+typedef struct log_latency_batch_s
+{
+    uint32_t timestamp;                 // Of the oldest item of the call
+    bool     hasItems;                  // Calls that only carry the rest of an earlier item are not binned
+} log_latency_batch_t;
+
+static uint32_t             mLatencyPending[LOG_LATENCY_PENDING];  // Timestamps of the items not yet handed over
+static uint32_t             mLatencyNPending = 0;
+static log_latency_batch_t  mLatencyBatches[LOG_LATENCY_BATCHES];
+static volatile uint32_t    mLatencyBatchWr = 0;   // Written by the log thread
+static volatile uint32_t    mLatencyBatchRd = 0;   // Written by log_latency_tx_done()
+
+
+// 0 below 2^LOG_LATENCY_SHIFT ticks, then one bin per doubling up to the last, which holds the rest
+static uint32_t log_latency_bin(uint32_t ticks)
+{
+    uint32_t bin = 0;
+
+    ticks >>= LOG_LATENCY_SHIFT;
+    while(ticks && bin < LOG_LATENCY_N_BINS - 1)
+    {
+        ticks >>= 1;
+        bin++;
+    }
+    return bin;
+}
+
+
+// Called by the log thread with each item it outputs, binned once its bytes reach the handler
+static void log_latency_item(uint32_t timestamp)
+{
+    if(mLatencyNPending < LOG_LATENCY_PENDING)
+        mLatencyPending[mLatencyNPending++] = timestamp;
+    else
+        mStats.latencyHandoff[log_latency_bin(LOG_TIMESTAMP_GET() - timestamp)]++;
+}
+
+
+// Bins the items of the handler call and queues its oldest one for log_latency_tx_done()
+static void log_latency_handoff(void)
+{
+    uint32_t now = LOG_TIMESTAMP_GET();
+    uint32_t oldest = 0;
+    uint32_t ticks;
+    uint32_t i;
+    log_latency_batch_t *pBatch;
+
+    for(i = 0; i < mLatencyNPending; i++)
+    {
+        ticks = now - mLatencyPending[i];
+        mStats.latencyHandoff[log_latency_bin(ticks)]++;
+        if(ticks > oldest)
+            oldest = ticks;
+    }
+
+    if(mLatencyBatchWr - mLatencyBatchRd < LOG_LATENCY_BATCHES)
+    {
+        pBatch = &mLatencyBatches[mLatencyBatchWr % LOG_LATENCY_BATCHES];
+        pBatch->timestamp = now - oldest;
+        pBatch->hasItems = mLatencyNPending != 0;
+        __DMB();
+        mLatencyBatchWr++;
+    }
+    mLatencyNPending = 0;
+}
+
+
+/**
+ * Called by the backend, usually from its DMA interrupt, once the bytes of the oldest output handler
+ * call still in flight are sent, in the order of the calls. The oldest item of that call is binned in
+ * latencyWire[] of log_get_stats().
+ */
+void log_latency_tx_done(void)
+{
+    log_latency_batch_t *pBatch;
+
+    if(mLatencyBatchRd == mLatencyBatchWr)
+        return;
+    pBatch = &mLatencyBatches[mLatencyBatchRd % LOG_LATENCY_BATCHES];
+    if(pBatch->hasItems)
+        mStats.latencyWire[log_latency_bin(LOG_TIMESTAMP_GET() - pBatch->timestamp)]++;
+    mLatencyBatchRd++;
+}
+#endif
+
+
+#if LOG_HISTORY_SIZE
+static char                 mHistory[LOG_HISTORY_SIZE];
+static uint32_t             mHistoryWrIdx = 0;      // Free running, bytes output since log_init()
+static volatile bool        mIsHistoryRequested = false;
+
+
+// Keeps the last LOG_HISTORY_SIZE bytes of the output
+static inline void log_history_put(const char *string, uint32_t length)
+{
+    uint32_t idx;
+    uint32_t nFirst;
+
+    if(length > LOG_HISTORY_SIZE)
+    {
+        string += length - LOG_HISTORY_SIZE;
+        mHistoryWrIdx += length - LOG_HISTORY_SIZE;
+        length = LOG_HISTORY_SIZE;
+    }
+    idx = mHistoryWrIdx & (LOG_HISTORY_SIZE - 1);
+    nFirst = (length < LOG_HISTORY_SIZE - idx) ? length : LOG_HISTORY_SIZE - idx;
+    memcpy(&mHistory[idx], string, nFirst);
+    memcpy(mHistory, string + nFirst, length - nFirst);
+    mHistoryWrIdx += length;
+}
+
+
+// Any context, the log thread sends the history at its next wakeup
+void log_history_replay(void)
+{
+    mIsHistoryRequested = true;
+}
+
+
+// Sends the history as it is to the output handler, between two marker lines. It is not recorded again.
+static void log_history_poll(void)
+{
+    uint32_t nBytes = (mHistoryWrIdx < LOG_HISTORY_SIZE) ? mHistoryWrIdx : LOG_HISTORY_SIZE;
+    uint32_t start = (mHistoryWrIdx - nBytes) & (LOG_HISTORY_SIZE - 1);
+
+    if(!mIsHistoryRequested)
+        return;
+    mIsHistoryRequested = false;
+    if(!mPrintHandler)
+        return;
+
+    mPrintHandler("\r\nLog history\r\n", strlen("\r\nLog history\r\n"));
+    if(start + nBytes > LOG_HISTORY_SIZE)
+    {
+        mPrintHandler(&mHistory[start], LOG_HISTORY_SIZE - start);
+        mPrintHandler(mHistory, start + nBytes - LOG_HISTORY_SIZE);
+    }
+    else if(nBytes)
+        mPrintHandler(&mHistory[start], nBytes);
+    mPrintHandler("\r\nLog history end\r\n", strlen("\r\nLog history end\r\n"));
+    if(mFlushHandler)
+        mFlushHandler();                // Sent before the ring changes, backends may send in place
+}
+#endif
+
+
+static void log_handler_send(char *string, uint32_t length)
+{
+    log_out_handler printHandler = mPrintHandler;
+
+#if LOG_LATENCY
+    log_latency_handoff();
+#endif
+#if LOG_HISTORY_SIZE
+    log_history_put(string, length);
+#endif
+#if LOG_ERROR_FIFO_N_ELEM && !LOG_BINARY_OUTPUT
+    if(mIsUrgentOutput)
+        printHandler = mUrgentHandler;
+#endif
+    if(printHandler)
+        printHandler(string, length);
+#if LOG_STATS
+    mStats.nBytesOut += length;
+#endif
+}
+
+
+#if LOG_PACKETS
+// Appends a byte to the COBS encoding of the packet: each block starts with a code, the number of
+// bytes up to the next zero byte, which is not sent, or 0xFF for 254 bytes without zero
+static inline void packet_put(uint8_t byte)
+{
+    if(byte)
+    {
+        mPacketOut[mPacketLen++] = byte;
+        if(mPacketLen - mPacketCodeIdx < 0xFF)
+            return;
+    }
+    mPacketOut[mPacketCodeIdx] = (uint8_t)(mPacketLen - mPacketCodeIdx);
+    mPacketCodeIdx = mPacketLen++;
+}
+
+
+static inline void packet_put_crc(uint8_t byte)
+{
+    LOG_PACKET_CRC_DR8 = byte;
+    packet_put(byte);
+}
+
+
+// Packets of the 16 bit sequence number, up to LOG_PACKET_PAYLOAD bytes of output and the CRC-32 of
+// both (little endian). The CRC peripheral computes it while the bytes are COBS encoded, and the zero
+// byte ending each packet appears nowhere else, Tools/log_decode.py --packets resyncs on it.
+static void log_send(char *string, uint32_t length)
+{
+    const uint8_t *pData = (const uint8_t*)string;
+    uint32_t nChunk;
+    uint32_t crc;
+
+    while(length)
+    {
+        nChunk = (length < LOG_PACKET_PAYLOAD) ? length : LOG_PACKET_PAYLOAD;
+        length -= nChunk;
+
+        CRC->CR = LOG_PACKET_CRC_CR | CRC_CR_RESET;
+        mPacketLen = 0;
+        if(!mPacketSeq)                 // Ends what the receiver got before, so the first packet is not lost
+            mPacketOut[mPacketLen++] = 0;
+        mPacketCodeIdx = mPacketLen++;
+        packet_put_crc((uint8_t)mPacketSeq);
+        packet_put_crc((uint8_t)(mPacketSeq >> 8));
+        mPacketSeq++;
+        while(nChunk--)
+            packet_put_crc(*pData++);
+
+        crc = ~CRC->DR;
+        packet_put((uint8_t)crc);
+        packet_put((uint8_t)(crc >> 8));
+        packet_put((uint8_t)(crc >> 16));
+        packet_put((uint8_t)(crc >> 24));
+        mPacketOut[mPacketCodeIdx] = (uint8_t)(mPacketLen - mPacketCodeIdx);
+        mPacketOut[mPacketLen++] = 0;
+
+        log_handler_send((char*)mPacketOut, mPacketLen);
+#if LOG_RENDER_PING_PONG
+        mPacketOut = (mPacketOut == mPacketBuffers[0]) ? mPacketBuffers[1] : mPacketBuffers[0];
+#endif
+    }
+}
+
+
+// The CRC peripheral is only used here, with the polynomial of CRC-32 and the initial value all ones
+static void packet_init(void)
+{
+    __HAL_RCC_CRC_CLK_ENABLE();
+    CRC->POL  = 0x04C11DB7UL;
+    CRC->INIT = 0xFFFFFFFFUL;
+    CRC->CR   = LOG_PACKET_CRC_CR | CRC_CR_RESET;
+    mPacketSeq = 0;
+}
+#else
+static inline void log_send(char *string, uint32_t length)
+{
+    log_handler_send(string, length);
+}
+#endif
+
+
+#if LOG_COMPRESS
+// Byte stream of LZSS tokens, decoded by Tools/log_decode.py --compressed:
+// - 0nnnnnnn: n + 1 literal bytes follow
+// - 1llllldd dddddddd: copy l + 3 bytes from d + 1 bytes back, the two low bits of the first byte
+//   are the high ones of d. The copy may overlap the bytes it writes.
+// - 0xFF 0xFF 'L' 'Z': resync marker, the window restarts empty. The match of 34 bytes from 1024
+//   back it would be is sent as 33 bytes instead.
+static void compress_out_flush(void)
+{
+    if(mCompressOutLen)
+    {
+        log_send((char*)mCompressOut, mCompressOutLen);
+#if LOG_RENDER_PING_PONG
+        mCompressOut = (mCompressOut == mCompressOutBuffers[0]) ? mCompressOutBuffers[1] : mCompressOutBuffers[0];
+#endif
+    }
+    mCompressOutLen = 0;
+}
+
+
+static inline void compress_out_byte(uint8_t byte)
+{
+    if(mCompressOutLen == LOG_COMPRESS_OUT_SIZE)
+        compress_out_flush();
+    mCompressOut[mCompressOutLen++] = byte;
+}
+
+
+static void compress_out_literals(const uint8_t *pData, uint32_t nBytes)
+{
+    if(!nBytes)
+        return;
+
+    compress_out_byte(nBytes - 1);
+    while(nBytes--)
+        compress_out_byte(*pData++);
+}
+
+
+static inline uint32_t compress_hash(const uint8_t *pData)
+{
+    return ((pData[0] << 6) ^ (pData[1] << 3) ^ pData[2]) & (LOG_COMPRESS_HASH_SIZE - 1);
+}
+
+
+// Enters the byte at the current position in the window
+static inline void compress_insert(const uint8_t *pData, uint32_t idx, uint32_t length)
+{
+    if(idx + LOG_COMPRESS_MIN_MATCH <= length)
+        mCompressHash[compress_hash(&pData[idx])] = (uint16_t)mCompressPos;
+    mCompressWindow[mCompressPos & (LOG_COMPRESS_WINDOW - 1)] = pData[idx];
+    mCompressPos++;
+}
+
+
+// Returns the length of the match of the data at idx with the bytes dist positions back, which
+// come from the window or, if the match overlaps itself, from the data being encoded
+static uint32_t compress_match_len(const uint8_t *pData, uint32_t idx, uint32_t length, uint32_t dist)
+{
+    uint32_t maxLen = length - idx;
+    uint32_t matchLen = 0;
+    uint32_t srcPos = mCompressPos - dist;
+    uint8_t  src;
+
+    if(maxLen > LOG_COMPRESS_MAX_MATCH)
+        maxLen = LOG_COMPRESS_MAX_MATCH;
+    if(dist == 1024 && maxLen == LOG_COMPRESS_MAX_MATCH)
+        maxLen--;                                       // Its token would be the resync marker
+
+    for(; matchLen < maxLen; matchLen++, srcPos++)
+    {
+        src = (matchLen < dist) ? mCompressWindow[srcPos & (LOG_COMPRESS_WINDOW - 1)] : pData[idx + matchLen - dist];
+        if(src != pData[idx + matchLen])
+            break;
+    }
+    return matchLen;
+}
+
+
+#if LOG_COMPRESS_SYNC_BYTES
+// Sends the resync marker, the next matches only refer to the bytes that follow it
+static void compress_sync(void)
+{
+    uint32_t i;
+
+    for(i = 0; i < strlen(LOG_COMPRESS_SYNC); i++)
+        compress_out_byte(LOG_COMPRESS_SYNC[i]);
+    mCompressBase = mCompressPos;
+}
+#endif
+
+
+// Only the last position of each hash is tried, so the cost per byte is constant
+static void log_output(char *string, uint32_t length)
+{
+    const uint8_t *pData = (const uint8_t*)string;
+    uint32_t idx = 0;
+    uint32_t litStart = 0;
+    uint32_t dist;
+    uint32_t matchLen;
+
+#if LOG_COMPRESS_SYNC_BYTES
+    if(mCompressPos - mCompressBase >= LOG_COMPRESS_SYNC_BYTES)
+        compress_sync();
+#endif
+    while(idx < length)
+    {
+        matchLen = 0;
+        if(idx + LOG_COMPRESS_MIN_MATCH <= length)
+        {
+            dist = (uint16_t)(mCompressPos - mCompressHash[compress_hash(&pData[idx])]);
+            if(dist && dist <= LOG_COMPRESS_WINDOW && dist <= mCompressPos - mCompressBase)
+                matchLen = compress_match_len(pData, idx, length, dist);
+        }
+
+        if(matchLen >= LOG_COMPRESS_MIN_MATCH)
+        {
+            compress_out_literals(&pData[litStart], idx - litStart);
+            compress_out_byte(0x80 | ((matchLen - LOG_COMPRESS_MIN_MATCH) << 2) | ((dist - 1) >> 8));
+            compress_out_byte((dist - 1) & 0xFF);
+            while(matchLen--)
+                compress_insert(pData, idx++, length);
+            litStart = idx;
+        }
+        else
+        {
+            compress_insert(pData, idx++, length);
+            if(idx - litStart == LOG_COMPRESS_MAX_LITERALS)
+            {
+                compress_out_literals(&pData[litStart], idx - litStart);
+                litStart = idx;
+            }
+        }
+    }
+    compress_out_literals(&pData[litStart], idx - litStart);
+    compress_out_flush();
+}
+
+
+static void compress_init(void)
+{
+    mCompressPos    = 0;
+    mCompressBase   = 0;
+    mCompressOutLen = 0;
+}
+#else
+static inline void log_output(char *string, uint32_t length)
+{
+    log_send(string, length);
+}
+#endif
+
+
+#if LOG_RENDER_BUFFER_SIZE
+// Sends the output rendered so far to the backend
+static void render_flush(void)
+{
+    if(mRenderLen)
+    {
+        log_output(mRenderBuffer, mRenderLen);
+#if LOG_RENDER_PING_PONG
+        // The handler may still be sending this buffer in place, the other one is filled meanwhile
+        mRenderBuffer = (mRenderBuffer == mRenderBuffers[0]) ? mRenderBuffers[1] : mRenderBuffers[0];
+#endif
+    }
+    mRenderLen = 0;
+}
+
+
+#if LOG_RENDER_PING_PONG
+// Everything is copied to the render buffers, as the handler may keep reading its input data
+static void render_string(char *string, uint32_t length)
+{
+    uint32_t nChunk;
+
+    while(length)
+    {
+        nChunk = LOG_RENDER_BUFFER_SIZE - mRenderLen;
+        if(nChunk > length)
+            nChunk = length;
+
+        memcpy(&mRenderBuffer[mRenderLen], string, nChunk);
+        mRenderLen += nChunk;
+        string     += nChunk;
+        length     -= nChunk;
+
+        if(mRenderLen == LOG_RENDER_BUFFER_SIZE)
+            render_flush();
+    }
+}
+#else
+static void render_string(char *string, uint32_t length)
+{
+    if(mRenderLen + length > LOG_RENDER_BUFFER_SIZE)
+        render_flush();
+
+    if(length >= LOG_RENDER_BUFFER_SIZE)                // Too long to be batched, sent as is
+        log_output(string, length);
+    else
+    {
+        memcpy(&mRenderBuffer[mRenderLen], string, length);
+        mRenderLen += length;
+    }
+}
+#endif
+#else
+static void render_string(char *string, uint32_t length)
+{
+    log_output(string, length);
+}
+#endif
+
+
+#if LOG_N_BACKENDS > 1
+// Sends the bytes to the backends of log_add_backend() that accept the level of the current item
+static void backends_output(char *string, uint32_t length)
+{
+    uint32_t i;
+
+    for(i = 0; i < mNumBackends; i++)
+    {
+        if(!(mBackends[i].levelMask & mOutLevelBit))
+            continue;
+
+        if(mBackends[i].renderLen + length > mBackends[i].renderSize)
+        {
+            if(mBackends[i].renderLen)
+                mBackends[i].print(mBackends[i].pRender, mBackends[i].renderLen);
+            mBackends[i].renderLen = 0;
+        }
+
+        if(length >= mBackends[i].renderSize)           // Too long to be batched, or no buffer
+            mBackends[i].print(string, length);
+        else
+        {
+            memcpy(&mBackends[i].pRender[mBackends[i].renderLen], string, length);
+            mBackends[i].renderLen += length;
+        }
+    }
+}
+
+
+static void backends_flush(bool isPublicCall)
+{
+    uint32_t i;
+
+    for(i = 0; i < mNumBackends; i++)
+    {
+        if(mBackends[i].renderLen)
+            mBackends[i].print(mBackends[i].pRender, mBackends[i].renderLen);
+        mBackends[i].renderLen = 0;
+        if(isPublicCall && mBackends[i].flush)
+            mBackends[i].flush();
+    }
+}
+
+
+// Selects the backends that get the output of the item
+static inline void backends_select(const log_fifo_item_t *pItem)
+{
+    mOutLevelBit = pItem->level ? LOG_LEVEL_BIT(pItem->level) : UINT32_MAX;
+}
+#endif
+
+
+#if LOG_ERROR_FIFO_N_ELEM && !LOG_BINARY_OUTPUT
+// Sends the items of the error FIFO to the log_set_urgent_handler() one, the output batched for the
+// other handler first
+static inline void urgent_select(const log_fifo_t *pFifo)
+{
+    bool isUrgent = (pFifo == &errorFifo) && mUrgentHandler;
+
+    if(isUrgent == mIsUrgentOutput)
+        return;
+#if LOG_RENDER_BUFFER_SIZE
+    render_flush();
+#endif
+    mIsUrgentOutput = isUrgent;
+}
+#endif
+
+
+// Each output is formatted once and then fanned out to all the backends that accept it
+static inline void output_string(char *string, uint32_t length)
+{
+#if LOG_N_BACKENDS > 1
+    backends_output(string, length);
+#endif
+    render_string(string, length);
+}
+
+
+#if LOG_SYSVIEW
+#define LOG_SYSVIEW_EVTID_ISR_ENTER         2
+#define LOG_SYSVIEW_EVTID_ISR_EXIT          3
+#define LOG_SYSVIEW_EVTID_TASK_START_EXEC   4
+#define LOG_SYSVIEW_EVTID_TASK_CREATE       8
+#define LOG_SYSVIEW_EVTID_TASK_INFO         9
+#define LOG_SYSVIEW_EVTID_TRACE_START       10
+#define LOG_SYSVIEW_EVTID_SYSDESC           14
+#define LOG_SYSVIEW_EVTID_INIT              24      // The IDs from 24 have a payload length
+#define LOG_SYSVIEW_EVTID_PRINT_FORMATTED   26
+#define LOG_SYSVIEW_EVTID_TASK_TERMINATE    29
+#define LOG_SYSVIEW_ID_SHIFT                2       // Task IDs are word offsets in RAM, as the trace items store them
+#define LOG_SYSVIEW_SYNC_LEN                10      // Zero bytes the host looks for to find the packets
+#define LOG_SYSVIEW_MAX_STRING              128     // Longer lines are cut
+#define LOG_SYSVIEW_N_TASKS                 16      // Tasks named since the last sync
+#define LOG_SYSVIEW_PAYLOAD_SIZE            (1 + LOG_SYSVIEW_MAX_STRING + 2 * 5)
+
+static uint32_t mSysviewTicks;                      // Timestamp of the item being output
+static uint32_t mSysviewLastTicks;                  // Of the previous packet, each one ends with the delta since then
+static uint32_t mSysviewNPackets;                   // Since the last sync, 0 sends one before the next packet
+static bool     mSysviewIsStarted;
+static char     mSysviewLine[LOG_SYSVIEW_MAX_STRING];
+static uint32_t mSysviewLineLen;
+#if LOG_RTOS_TRACE
+static uint32_t mSysviewTasks[LOG_SYSVIEW_N_TASKS];
+static uint32_t mSysviewNTasks;
+#endif
+static uint8_t  mSysviewPayload[LOG_SYSVIEW_PAYLOAD_SIZE];
+static uint8_t  mSysviewPacket[2 + 2 + LOG_SYSVIEW_PAYLOAD_SIZE + 5];
+
+
+// SystemView variable length number: 7 bits per byte from the lowest ones, the high bit tells that
+// another byte follows
+static uint32_t sysview_put_u32(uint8_t *pOut, uint32_t number)
+{
+    uint32_t length = 0;
+
+    while(number > 0x7F)
+    {
+        pOut[length++] = (uint8_t)(number | 0x80);
+        number >>= 7;
+    }
+    pOut[length++] = (uint8_t)number;
+    return length;
+}
+
+
+static uint32_t sysview_put_str(uint8_t *pOut, const char *str, uint32_t length)
+{
+    if(length > LOG_SYSVIEW_MAX_STRING)
+        length = LOG_SYSVIEW_MAX_STRING;
+    pOut[0] = (uint8_t)length;
+    memcpy(&pOut[1], str, length);
+    return length + 1;
+}
+
+
+// Sends the event with the length bytes of mSysviewPayload, then the ticks since the previous packet.
+// Items of different contexts can be a few ticks out of order, they get a delta of 0 instead of a wrap.
+static void sysview_packet(uint32_t eventId, uint32_t length)
+{
+    uint32_t delta = mSysviewTicks - mSysviewLastTicks;
+    uint32_t packetLen = 0;
+
+    if((int32_t)delta < 0)
+        delta = 0;
+    else
+        mSysviewLastTicks = mSysviewTicks;
+
+    mSysviewPacket[packetLen++] = (uint8_t)eventId;
+    if(eventId >= LOG_SYSVIEW_EVTID_INIT)
+        packetLen += sysview_put_u32(&mSysviewPacket[packetLen], length);
+    memcpy(&mSysviewPacket[packetLen], mSysviewPayload, length);
+    packetLen += length;
+    packetLen += sysview_put_u32(&mSysviewPacket[packetLen], delta);
+    output_string((char*)mSysviewPacket, packetLen);
+
+    if(++mSysviewNPackets > LOG_SYSVIEW_SYNC_PACKETS)
+        mSysviewNPackets = 0;
+}
+
+
+// Lets the host find the packets in a stream it joined at any time, then describes the system. The
+// tasks are named again when they are next switched in.
+static void sysview_sync(void)
+{
+    static const char sysDesc[] = LOG_SYSVIEW_DESC;
+    uint32_t length = 0;
+
+    if(!mSysviewIsStarted)              // The first packet is the time origin
+    {
+        mSysviewLastTicks = mSysviewTicks;
+        mSysviewIsStarted = true;
+    }
+    mSysviewNPackets = 1;
+    memset(mSysviewPacket, 0, LOG_SYSVIEW_SYNC_LEN);
+    output_string((char*)mSysviewPacket, LOG_SYSVIEW_SYNC_LEN);
+    sysview_packet(LOG_SYSVIEW_EVTID_TRACE_START, 0);
+
+    length += sysview_put_u32(&mSysviewPayload[length], LOG_TIMESTAMP_HZ);
+    length += sysview_put_u32(&mSysviewPayload[length], SystemCoreClock);
+    length += sysview_put_u32(&mSysviewPayload[length], SRAM_BASE);
+    length += sysview_put_u32(&mSysviewPayload[length], LOG_SYSVIEW_ID_SHIFT);
+    sysview_packet(LOG_SYSVIEW_EVTID_INIT, length);
+    sysview_packet(LOG_SYSVIEW_EVTID_SYSDESC, sysview_put_str(mSysviewPayload, sysDesc, strlen(sysDesc)));
+#if LOG_RTOS_TRACE
+    mSysviewNTasks = 0;
+#endif
+}
+
+
+// The callers fill mSysviewPayload after this, as a sync uses it
+static inline void sysview_begin(void)
+{
+    if(!mSysviewNPackets)
+        sysview_sync();
+}
+
+
+// The text is cut into lines, each one sent as a print packet without arguments. Empty lines are not
+// sent, nor are the line ends.
+static void sysview_put_text(const char *string, uint32_t length)
+{
+    uint32_t packetLen;
+    uint32_t i;
+
+    for(i = 0; i < length; i++)
+    {
+        if(string[i] == '\n')
+        {
+            if(!mSysviewLineLen)
+                continue;
+            sysview_begin();
+            packetLen = sysview_put_str(mSysviewPayload, mSysviewLine, mSysviewLineLen);
+            mSysviewPayload[packetLen++] = 0;       // SEGGER_SYSVIEW_LOG option
+            mSysviewPayload[packetLen++] = 0;       // Number of arguments
+            sysview_packet(LOG_SYSVIEW_EVTID_PRINT_FORMATTED, packetLen);
+            mSysviewLineLen = 0;
+        }
+        else if(string[i] != '\r' && mSysviewLineLen < LOG_SYSVIEW_MAX_STRING)
+            mSysviewLine[mSysviewLineLen++] = string[i];
+    }
+}
+
+
+#if LOG_RTOS_TRACE
+// Names the task the first time it is switched in after a sync. Its control block must still be there
+// when the event is output, as the ones of the static tasks are.
+static void sysview_task_info(uint32_t taskId)
+{
+    TaskHandle_t task = (TaskHandle_t)(SRAM_BASE + (taskId << LOG_SYSVIEW_ID_SHIFT));
+    const char *pName;
+    uint32_t length = 0;
+    uint32_t i;
+
+    for(i = 0; i < mSysviewNTasks; i++)
+    {
+        if(mSysviewTasks[i] == taskId)
+            return;
+    }
+    if(mSysviewNTasks == LOG_SYSVIEW_N_TASKS)
+        return;
+    mSysviewTasks[mSysviewNTasks++] = taskId;
+
+    pName = pcTaskGetName(task);
+    length += sysview_put_u32(&mSysviewPayload[length], taskId);
+    length += sysview_put_u32(&mSysviewPayload[length], uxTaskPriorityGet(task));
+    length += sysview_put_str(&mSysviewPayload[length], pName, strlen(pName));
+    sysview_packet(LOG_SYSVIEW_EVTID_TASK_INFO, length);
+}
+
+
+// The queue events and the delays have no SystemView packet, they are not sent
+static void sysview_trace(const log_fifo_item_t *pItem)
+{
+    uint32_t eventId;
+
+    sysview_begin();
+    switch(pItem->traceEvent)
+    {
+    case LOG_TRACE_TASK_SWITCHED_IN:
+        sysview_task_info(pItem->uData);
+        eventId = LOG_SYSVIEW_EVTID_TASK_START_EXEC;
+        break;
+    case LOG_TRACE_TASK_CREATE:
+        eventId = LOG_SYSVIEW_EVTID_TASK_CREATE;
+        break;
+    case LOG_TRACE_TASK_DELETE:
+        eventId = LOG_SYSVIEW_EVTID_TASK_TERMINATE;
+        break;
+    case LOG_TRACE_ISR_ENTER:
+        eventId = LOG_SYSVIEW_EVTID_ISR_ENTER;
+        break;
+    case LOG_TRACE_ISR_EXIT:
+        sysview_packet(LOG_SYSVIEW_EVTID_ISR_EXIT, 0);
+        return;
+    default:
+        return;
+    }
+    sysview_packet(eventId, sysview_put_u32(mSysviewPayload, pItem->uData));
+}
+#endif
+#endif
+
+
+static inline void process_string(char *string, uint32_t length)
+{
+#if LOG_SYSVIEW
+    sysview_put_text(string, length);
+#else
+    output_string(string, length);
+#endif
+}
+
+
+#if !LOG_BINARY_OUTPUT
+#if LOG_SUPPORT_ANSI_COLOR
+static void set_color(enum log_color color)
+{
+#if LOG_COLOR_ON_CHANGE
+    if(color == mLastColor)             // The terminal is already showing it
+        return;
+#endif
+    if(color != LOG_COLOR_NONE)
+    {
+        char str[5] = LOG_ANSI_PREFIX;
+
+#if LOG_COLOR_ON_CHANGE
+        mLastColor = color;
+#endif
+        str[2] = ansiColors[color][0];
+        if(color != LOG_COLOR_DEFAULT)
+        {
+            str[3] = ansiColors[color][1];
+            str[4] = LOG_ANSI_SUFFIX;
+            process_string(str, 5);
+        }
+        else
+        {
+            str[3] = LOG_ANSI_SUFFIX;
+            process_string(str, 4);
+        }
+    }
+}
+#endif
+#endif
+
+
+// Formatting kernels, shared by the output and the public log_format functions. They write the
+// characters at pOut, without terminating zero, and return their number.
+static const uint32_t decimalPowers[10] = {1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL,
+                                           10000000UL, 100000000UL, 1000000000UL};
+
+
+#if LOG_FAST_HEX
+#define LOG_HEX_CHAR(nibble)    ((nibble) < 10 ? '0' + (nibble) : 'A' - 10 + (nibble))
+// Both chars of a byte, the first one in the low byte so they can be stored as a half word
+#define LOG_HEX_PAIR(byte)      (LOG_HEX_CHAR((byte) >> 4) | (LOG_HEX_CHAR((byte) & 0x0F) << 8))
+#define LOG_HEX_ROW(high)       LOG_HEX_PAIR(high + 0x0), LOG_HEX_PAIR(high + 0x1), LOG_HEX_PAIR(high + 0x2), \
+                                LOG_HEX_PAIR(high + 0x3), LOG_HEX_PAIR(high + 0x4), LOG_HEX_PAIR(high + 0x5), \
+                                LOG_HEX_PAIR(high + 0x6), LOG_HEX_PAIR(high + 0x7), LOG_HEX_PAIR(high + 0x8), \
+                                LOG_HEX_PAIR(high + 0x9), LOG_HEX_PAIR(high + 0xA), LOG_HEX_PAIR(high + 0xB), \
+                                LOG_HEX_PAIR(high + 0xC), LOG_HEX_PAIR(high + 0xD), LOG_HEX_PAIR(high + 0xE), \
+                                LOG_HEX_PAIR(high + 0xF)
+
+static const uint16_t hexPairs[256] = {
+    LOG_HEX_ROW(0x00), LOG_HEX_ROW(0x10), LOG_HEX_ROW(0x20), LOG_HEX_ROW(0x30),
+    LOG_HEX_ROW(0x40), LOG_HEX_ROW(0x50), LOG_HEX_ROW(0x60), LOG_HEX_ROW(0x70),
+    LOG_HEX_ROW(0x80), LOG_HEX_ROW(0x90), LOG_HEX_ROW(0xA0), LOG_HEX_ROW(0xB0),
+    LOG_HEX_ROW(0xC0), LOG_HEX_ROW(0xD0), LOG_HEX_ROW(0xE0), LOG_HEX_ROW(0xF0)
+};
+
+
+// Little endian targets only: the pair of each byte is copied as a half word, 2, 4 or 8 digits
+LOG_RAMFUNC static uint32_t format_hexadecimal(char *pOut, uint32_t number, uint8_t nDigits)
+{
+    int8_t i;
+
+    for(i = nDigits - 2; i >= 0; i -= 2)
+    {
+        memcpy(&pOut[i], &hexPairs[number & 0xFF], 2);
+        number >>= 8;
+    }
+    return nDigits;
+}
+#else
+LOG_RAMFUNC static uint32_t format_hexadecimal(char *pOut, uint32_t number, uint8_t nDigits)
+{
+    static const char hexVals[16] = {'0','1','2','3','4','5','6','7',
+                                     '8','9','A','B','C','D','E','F'};
+    int8_t i;
+
+    // Fill char array starting at the end
+    for(i = nDigits-1 ; i > -1; i--)
+    {
+        pOut[i] = hexVals[number & 0x0F];
+        number >>= 4;
+    }
+    return nDigits;
+}
+#endif
+
+
+#if LOG_FAST_DECIMAL
+static const char decimalPairs[200] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+
+LOG_RAMFUNC static uint32_t format_decimal(char *pOut, uint32_t number, bool isNegative)
+{
+    uint32_t length = 1;
+    uint32_t i;
+    uint32_t quotient;
+
+#if defined(__ARM_FEATURE_CLZ)
+    // Cores with CLZ (M3 and above, not the M0+) get the digits from the bit length, 1233 / 4096 being
+    // just below log10(2), so a single comparison fixes the estimate
+    length = ((32 - __builtin_clz(number | 1)) * 1233) >> 12;
+    length += (number >= decimalPowers[length]);
+    if(!length)
+        length = 1;
+#else
+    while(length < 10 && number >= decimalPowers[length])
+        length++;
+#endif
+    if(isNegative)
+        *pOut++ = '-';
+    i = length;
+
+    // Fill char array two digits at a time starting at the end, dividing by 100 with reciprocals
+    while(number >= 100)
+    {
+        if(number < 43699)
+            quotient = (number * 5243UL) >> 19;
+        else
+            quotient = (uint32_t)(((uint64_t)number * 1374389535UL) >> 37);
+        i -= 2;
+        memcpy(&pOut[i], &decimalPairs[(number - quotient * 100) * 2], 2);
+        number = quotient;
+    }
+
+    if(number >= 10)
+        memcpy(pOut, &decimalPairs[number * 2], 2);
+    else
+        pOut[0] = 0x30 + number;
+
+    return length + isNegative;
+}
+#else
+LOG_RAMFUNC static uint32_t format_decimal(char *pOut, uint32_t number, bool isNegative)
+{
+    uint32_t divider = 1000000000UL;
+    uint8_t i = 0;
+
+    if(isNegative)
+        pOut[i++] = '-';
+
+    while(number < divider)
+        divider /= 10;
+
+    while(divider >= 10)
+    {
+        pOut[i++] = 0x30 + number/divider;
+        number %= divider;
+        divider /= 10;
+    }
+
+    pOut[i++] = 0x30 + number;
+    return i;
+}
+#endif
+
+
+// Formats the number with leading zeros up to nDigits (1 to 9)
+LOG_RAMFUNC static uint32_t format_decimal_padded(char *pOut, uint32_t number, uint8_t nDigits)
+{
+    uint8_t nZeros = nDigits - 1;
+
+    while(nZeros && number >= decimalPowers[nDigits - nZeros])
+        nZeros--;
+
+    memset(pOut, '0', nZeros);
+    return nZeros + format_decimal(&pOut[nZeros], number, false);
+}
+
+
+LOG_RAMFUNC static uint32_t format_number(char *pOut, uint32_t number, enum log_data_type type)
+{
+    switch(type)
+    {
+    case _LOG_UINT_DEC:
+        return format_decimal(pOut, number, false);
+    case _LOG_INT_DEC_1:
+        if((int8_t)number < 0)
+            return format_decimal(pOut, (uint32_t)-((int8_t)number), true);
+        return format_decimal(pOut, number, false);
+    case _LOG_INT_DEC_2:
+        if((int16_t)number < 0)
+            return format_decimal(pOut, (uint32_t)-((int16_t)number), true);
+        return format_decimal(pOut, number, false);
+    case _LOG_INT_DEC_4:
+        if((int32_t)number < 0)
+            return format_decimal(pOut, -number, true);
+        return format_decimal(pOut, number, false);
+    case _LOG_HEX_1:
+        return format_hexadecimal(pOut, number, 2);
+    case _LOG_HEX_2:
+        return format_hexadecimal(pOut, number, 4);
+    case _LOG_HEX_4:
+        return format_hexadecimal(pOut, number, 8);
+    default:
+        return 0;
+    }
+}
+
+
+// Formats magnitude / 2^fracBits rounded to nDecimals. The fraction times 10^nDecimals takes
+// at most 62 bits, so only 64 bit multiplications and shifts are needed.
+LOG_RAMFUNC static uint32_t format_fixed(char *pOut, uint32_t magnitude, uint8_t fracBits, uint8_t nDecimals, bool isNegative)
+{
+    uint32_t integer = (fracBits < 32) ? magnitude >> fracBits : 0;
+    uint64_t fraction = (fracBits < 32) ? magnitude & ((1UL << fracBits) - 1) : magnitude;
+    uint32_t digits = 0;
+    uint32_t length;
+
+    if(fracBits && fracBits < 64)       // Beyond that everything rounds to 0
+    {
+        fraction = fraction * decimalPowers[nDecimals] + (1ULL << (fracBits - 1));
+        digits = fraction >> fracBits;
+        if(digits >= decimalPowers[nDecimals])
+        {
+            integer++;
+            digits -= decimalPowers[nDecimals];
+        }
+    }
+
+    length = format_decimal(pOut, integer, isNegative);
+    if(nDecimals)
+    {
+        pOut[length++] = '.';
+        length += format_decimal_padded(&pOut[length], digits, nDecimals);
+    }
+    return length;
+}
+
+
+LOG_RAMFUNC static uint32_t format_fixed_number(char *pOut, uint32_t number, uint8_t fracBits, uint8_t nDecimals)
+{
+    bool isNegative = !(fracBits & _LOG_FIXED_UNSIGNED) && (int32_t)number < 0;
+
+    return format_fixed(pOut, isNegative ? -number : number, fracBits & ~_LOG_FIXED_UNSIGNED, nDecimals, isNegative);
+}
+
+
+// Decodes the IEEE 754 single precision bits into a fixed point number of up to 149 fraction bits
+LOG_RAMFUNC static uint32_t format_float(char *pOut, uint32_t bits, uint8_t nDecimals)
+{
+    bool isNegative = bits >> 31;
+    uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    const char *str;
+
+    if(exponent == 0xFF)
+        str = mantissa ? "nan" : (isNegative ? "-inf" : "inf");
+    else if(exponent > 150 + 8)         // The value is mantissa * 2^(exponent - 150)
+        str = isNegative ? "-ovf" : "ovf";
+    else
+    {
+        if(exponent)
+            mantissa |= 0x800000;
+        else
+            exponent = 1;               // Subnormal
+
+        if(exponent >= 150)
+            return format_fixed(pOut, mantissa << (exponent - 150), 0, nDecimals, isNegative);
+        return format_fixed(pOut, mantissa, 150 - exponent, nDecimals, isNegative);
+    }
+
+    memcpy(pOut, str, strlen(str));
+    return strlen(str);
+}
+
+
+#if LOG_64BIT_NUMBERS && !LOG_BINARY_OUTPUT
+// Divides the number by 10^9 and returns the remainder. Long division one bit at a time, so only
+// 32 bit operations are used instead of __aeabi_uldivmod (the remainder is below 2^30).
+LOG_RAMFUNC static uint32_t log_div_1e9(uint32_t *pHi, uint32_t *pLo)
+{
+    uint32_t remainder;
+    uint32_t word = *pLo;
+    uint32_t quotient = 0;
+    uint8_t i;
+
+    if(*pHi < 1000000000UL)             // High word of the quotient is 0, as after a first division
+    {
+        remainder = *pHi;
+        *pHi = 0;
+    }
+    else
+    {
+        remainder = *pHi % 1000000000UL;
+        *pHi /= 1000000000UL;
+    }
+
+    for(i = 0; i < 32; i++)
+    {
+        remainder = (remainder << 1) | (word >> 31);
+        word <<= 1;
+        quotient <<= 1;
+        if(remainder >= 1000000000UL)
+        {
+            remainder -= 1000000000UL;
+            quotient |= 1;
+        }
+    }
+
+    *pLo = quotient;
+    return remainder;
+}
+
+
+LOG_RAMFUNC static uint32_t format_decimal64(char *pOut, uint32_t hi, uint32_t lo, bool isNegative)
+{
+    uint32_t chunks[2];
+    uint8_t nChunks = 0;
+    uint32_t length;
+
+    // Up to 20 digits: a leading part of up to 2 digits, then chunks of 9 starting at the end
+    while(hi)
+        chunks[nChunks++] = log_div_1e9(&hi, &lo);
+
+    length = format_decimal(pOut, lo, isNegative);
+    while(nChunks)
+        length += format_decimal_padded(&pOut[length], chunks[--nChunks], 9);
+    return length;
+}
+
+
+LOG_RAMFUNC static uint32_t format_number64(char *pOut, uint32_t lo, uint32_t hi, enum log_data_type type)
+{
+    switch(type)
+    {
+    case _LOG_UINT_DEC_8:
+        return format_decimal64(pOut, hi, lo, false);
+    case _LOG_INT_DEC_8:
+        if((int32_t)hi < 0)             // Two's complement negation of both words
+            return format_decimal64(pOut, ~hi + (lo == 0), -lo, true);
+        return format_decimal64(pOut, hi, lo, false);
+    case _LOG_HEX_8:
+        format_hexadecimal(pOut, hi, 8);
+        return 8 + format_hexadecimal(&pOut[8], lo, 8);
+    default:
+        return 0;
+    }
+}
+#endif
+
+
+// Copies the output of a kernel into the caller buffer, cut to its size and zero terminated
+static uint32_t log_format_copy(char *pBuf, uint32_t size, const char *pOut, uint32_t length)
+{
+    if(!size)
+        return 0;
+    if(length > size - 1)
+        length = size - 1;
+    memcpy(pBuf, pOut, length);
+    pBuf[length] = '\0';
+    return length;
+}
+
+
+uint32_t log_format_dec(char *pBuf, uint32_t size, int32_t number)
+{
+    char output[LOG_FORMAT_MAX];
+
+    return log_format_copy(pBuf, size, output, format_number(output, number, _LOG_INT_DEC_4));
+}
+
+
+uint32_t log_format_udec(char *pBuf, uint32_t size, uint32_t number)
+{
+    char output[LOG_FORMAT_MAX];
+
+    return log_format_copy(pBuf, size, output, format_decimal(output, number, false));
+}
+
+
+uint32_t log_format_hex(char *pBuf, uint32_t size, uint32_t number, uint32_t nBytes)
+{
+    char output[LOG_FORMAT_MAX];
+
+    nBytes = (nBytes >= 4) ? 4 : (nBytes >= 2) ? 2 : 1;
+    return log_format_copy(pBuf, size, output, format_hexadecimal(output, number, 2 * nBytes));
+}
+
+
+uint32_t log_format_fixed(char *pBuf, uint32_t size, int32_t number, uint8_t fracBits, uint8_t nDecimals)
+{
+    char output[LOG_FORMAT_MAX];
+
+    if(nDecimals > 9)
+        nDecimals = 9;
+    return log_format_copy(pBuf, size, output, format_fixed_number(output, number, fracBits & ~_LOG_FIXED_UNSIGNED,
+                                                                   nDecimals));
+}
+
+
+uint32_t log_format_float(char *pBuf, uint32_t size, float number, uint8_t nDecimals)
+{
+    char output[LOG_FORMAT_MAX];
+
+    if(nDecimals > 9)
+        nDecimals = 9;
+    return log_format_copy(pBuf, size, output, format_float(output, _log_float_bits(number), nDecimals));
+}
+
+
+// Formats arguments of log_fmt() one after the other, the output is cut at the end of the buffer
+uint32_t log_format_args(char *pBuf, uint32_t size, const log_fmt_arg_t *pArgs, uint32_t nArgs)
+{
+    char output[LOG_FORMAT_MAX];
+    uint32_t length = 0;
+    uint32_t i;
+
+    if(!size)
+        return 0;
+    pBuf[0] = '\0';
+    for(i = 0; i < nArgs && length < size - 1; i++)
+    {
+        if(pArgs[i].type == _LOG_STRING)
+            length += log_format_copy(&pBuf[length], size - length, pArgs[i].str, pArgs[i].number);
+        else
+            length += log_format_copy(&pBuf[length], size - length, output,
+                                      format_number(output, pArgs[i].number, pArgs[i].type));
+    }
+    return length;
+}
+
+
+#if !LOG_BINARY_OUTPUT
+#if LOG_TIMESTAMPS || LOG_CONTEXT_IDS || LOG_SEQUENCE_NUMBERS || LOG_LINE_PREFIX
+static void process_decimal(uint32_t number, bool isNegative)
+{
+    char output[11];
+
+    process_string(output, format_decimal(output, number, isNegative));
+}
+#endif
+
+
+static void process_number(uint32_t number, enum log_data_type type)
+{
+    char output[LOG_FORMAT_MAX];
+
+    process_string(output, format_number(output, number, type));
+}
+
+
+static void process_fixed_number(uint32_t number, uint8_t fracBits, uint8_t nDecimals)
+{
+    char output[LOG_FORMAT_MAX];
+
+    process_string(output, format_fixed_number(output, number, fracBits, nDecimals));
+}
+
+
+static void process_float(uint32_t bits, uint8_t nDecimals)
+{
+    char output[LOG_FORMAT_MAX];
+
+    process_string(output, format_float(output, bits, nDecimals));
+}
+
+
+// "@hash:line", the host maps the hash back to the file name
+static void process_location(uint32_t location)
+{
+    char output[LOG_FORMAT_MAX];
+    uint32_t length = 1;
+
+    output[0] = '@';
+    length += format_hexadecimal(&output[length], location >> 16, 4);
+    output[length++] = ':';
+    length += format_decimal(&output[length], location & 0xFFFF, false);
+    process_string(output, length);
+}
+
+
+#if LOG_64BIT_NUMBERS
+static void process_number64(uint32_t lo, uint32_t hi, enum log_data_type type)
+{
+    char output[LOG_FORMAT_MAX];
+
+    process_string(output, format_number64(output, lo, hi, type));
+}
+#endif
+#endif
+
+
+// Stores the color argument of the public macros, which also carries the level with several backends
+// and the module with LOG_LINE_PREFIX
+static inline void log_item_set_color(log_fifo_item_t *pItem, enum log_color color)
+{
+#if LOG_LINE_PREFIX
+    pItem->module = (uint32_t)color >> _LOG_MODULE_SHIFT;
+    color = (enum log_color)((uint32_t)color & ((1UL << _LOG_MODULE_SHIFT) - 1));
+#endif
+#if LOG_LEVEL_ITEMS
+    pItem->level = (uint32_t)color >> _LOG_LEVEL_SHIFT;
+    color = (enum log_color)((uint32_t)color & ((1UL << _LOG_LEVEL_SHIFT) - 1));
+#endif
+#if LOG_SUPPORT_ANSI_COLOR
+    pItem->color = color;
+#else
+    (void)pItem;
+    (void)color;
+#endif
+}
+
+
+LOG_RAMFUNC void _log_var(uint32_t number, enum log_data_type type, enum log_color color)
+{
+    log_fifo_item_t item = {.type = type, .uData = number};
+
+    log_item_set_color(&item, color);
+
+    log_input_put(&item);
+}
+
+
+LOG_RAMFUNC void _log_real(uint32_t number, enum log_data_type type, uint8_t fracBits, uint8_t nDecimals, enum log_color color)
+{
+    log_fifo_item_t item = {.type = type, .uData = number, .fracBits = fracBits,
+                            .nDecimals = (nDecimals > 9) ? 9 : nDecimals};
+
+    log_item_set_color(&item, color);
+
+    log_input_put(&item);
+}
+
+
+#if LOG_64BIT_NUMBERS
+LOG_RAMFUNC void _log_var64(uint64_t number, enum log_data_type type, enum log_color color)
+{
+    log_fifo_item_t item = {.type = type, .uData = (uint32_t)number, .uDataHi = (uint32_t)(number >> 32)};
+
+    log_item_set_color(&item, color);
+
+    log_input_put(&item);
+}
+#endif
+
+
+// Only the table and the index are stored, the log thread looks the name up
+void _log_enum(uint32_t value, const char *const *pNames, uint32_t nNames, enum log_color color)
+{
+    log_fifo_item_t item = {.type = _LOG_ENUM, .str = (char*)pNames,
+                            .enumIndex = (value < UINT8_MAX) ? value : UINT8_MAX,
+                            .enumCount = (nNames < UINT8_MAX) ? nNames : UINT8_MAX};
+
+    log_item_set_color(&item, color);
+
+    log_input_put(&item);
+}
+
+
+// Only the address is stored, the log thread reads the variable
+void _log_ref(const volatile void *pVar, enum log_data_type type, uint32_t size, enum log_color color)
+{
+    log_fifo_item_t item = {.type = _LOG_REF, .str = (char*)pVar, .refType = type, .refSize = size};
+
+    log_item_set_color(&item, color);
+
+    log_input_put(&item);
+}
+
+
+#if LOG_REGS
+extern const uint8_t __log_regs_start[];        // Defined in the linker script
+
+// The descriptor is in flash: sending its offset is enough, the log thread reads the fields
+void _log_reg(uint32_t value, const log_reg_desc_t *pDesc, enum log_color color)
+{
+    log_fifo_item_t item = {.type = _LOG_REG, .uData = value,
+                            .regDesc = ((const uint8_t*)pDesc - __log_regs_start) >> 2};
+
+    log_item_set_color(&item, color);
+
+    log_input_put(&item);
+}
+#endif
+
+
+#if LOG_CUSTOM_TYPES
+static log_type_format_t mTypeFormats[LOG_CUSTOM_TYPES];
+
+
+bool log_type_register(uint32_t typeId, log_type_format_t format)
+{
+    if(typeId >= LOG_CUSTOM_TYPES)
+        return false;
+    mTypeFormats[typeId] = format;
+    return true;
+}
+
+
+// Only the raw bytes are copied, the formatter runs in the log thread
+void _log_custom(uint32_t typeId, const void *pData, uint32_t size, enum log_color color)
+{
+    log_fifo_item_t item = {.type = _LOG_CUSTOM, .customId = typeId};
+
+    log_item_set_color(&item, color);
+
+    if(size > UINT8_MAX)
+        size = UINT8_MAX;
+    if(size > LOG_COPY_ARENA_SIZE)
+        size = LOG_COPY_ARENA_SIZE;
+    item.customLen = size;
+
+    log_input_put_copy(&item, pData, size);
+}
+#endif
+
+
+#if LOG_PRINTF
+// Only the format pointer and the argument words are copied, the log thread parses the format
+void _log_printf(const uintptr_t *pWords, uint32_t nWords, enum log_color color)
+{
+    log_fifo_item_t item = {.type = _LOG_CUSTOM, .customId = LOG_PRINTF_TYPE_ID};
+    uint32_t size = nWords * sizeof(uintptr_t);
+
+    log_item_set_color(&item, color);
+
+    if(size > LOG_COPY_ARENA_SIZE)      // The last arguments are printed as "?"
+        size = LOG_COPY_ARENA_SIZE & ~(sizeof(uintptr_t) - 1);
+    item.customLen = size;
+
+    log_input_put_copy(&item, pWords, size);
+}
+#endif
+
+
+#if LOG_BUFFER_REFS
+typedef struct
+{
+    const void *            pData;
+    uint32_t                length;
+    enum log_buffer_format  format;
+    log_buffer_release_t    release;
+    void *                  pReleaseCtx;
+    enum log_color          color;
+#if LOG_TIMESTAMPS
+    uint32_t                timestamp;
+#endif
+#if LOG_CONTEXT_IDS
+    uint8_t                 ctxId;
+#endif
+} log_buffer_ctx_t;
+
+static void *mBufferReleaseCtx;
+
+
+// The buffer is followed by the context and the function that release it
+static void log_buffer_fill(log_fifo_item_t *pItem, uint32_t idx, const void *pCtx)
+{
+    const log_buffer_ctx_t *pBuffer = pCtx;
+
+    if(idx == 0)
+        *pItem = (log_fifo_item_t){.type = (pBuffer->format == LOG_BUFFER_HEXDUMP) ? _LOG_HEXDUMP : _LOG_STRING,
+                                   .str = (char*)pBuffer->pData, .strLen = pBuffer->length};
+    else if(idx == 1)
+        *pItem = (log_fifo_item_t){.type = _LOG_BUFFER_CTX, .str = pBuffer->pReleaseCtx};
+    else
+        *pItem = (log_fifo_item_t){.type = _LOG_BUFFER_RELEASE, .str = (char*)pBuffer->release};
+    log_item_set_color(pItem, idx ? LOG_COLOR_NONE : pBuffer->color);
+#if LOG_TIMESTAMPS
+    pItem->timestamp = pBuffer->timestamp;
+#endif
+#if LOG_CONTEXT_IDS
+    pItem->ctxId = pBuffer->ctxId;
+#endif
+}
+
+
+// The log thread outputs the buffer in place, from the same items than log_str() and log_hexdump().
+// If the FIFO is full the buffer is released right away.
+void _log_buffer_ref(const void *pData, uint32_t length, enum log_buffer_format format,
+                     log_buffer_release_t release, void *pReleaseCtx, enum log_color color)
+{
+    log_buffer_ctx_t ctx = {.pData = pData, .length = (length < UINT16_MAX) ? length : UINT16_MAX,
+                            .format = format, .release = release, .pReleaseCtx = pReleaseCtx, .color = color};
+
+#if LOG_TIMESTAMPS
+    ctx.timestamp = LOG_TIMESTAMP_GET();
+#endif
+#if LOG_CONTEXT_IDS
+    ctx.ctxId = log_context_id();
+#endif
+
+    if(!log_input_put_n(3, log_buffer_fill, &ctx) && release)
+        release(pReleaseCtx);
+}
+
+
+// Returns true if the item is the context or the release of a buffer, which output nothing. The
+// buffer item came just before and is already in the backend.
+static bool log_buffer_release(const log_fifo_item_t *pItem)
+{
+    log_buffer_release_t release;
+
+    if(pItem->type == _LOG_BUFFER_CTX)
+        mBufferReleaseCtx = pItem->str;
+    else if(pItem->type == _LOG_BUFFER_RELEASE)
+    {
+        release = (log_buffer_release_t)(void*)pItem->str;
+        if(release)
+            release(mBufferReleaseCtx);
+    }
+    else
+        return false;
+    return true;
+}
+#endif
+
+
+#if LOG_CONST_NUMBERS
+// Characters formatted by the compiler, first one in the low byte (little endian targets only)
+LOG_RAMFUNC void _log_chars_word(uint32_t chars, uint32_t nChars, enum log_color color)
+{
+    log_fifo_item_t item = {.type = LOG_CHAR, .uData = chars, .nChars = nChars};
+
+    log_item_set_color(&item, color);
+
+    log_input_put(&item);
+}
+#endif
+
+
+// A packed record has room for a single character, which already makes it smaller than an item
+#if LOG_FIFO_PACKED
+#define LOG_CHARS_PER_ITEM      1
+#else
+#define LOG_CHARS_PER_ITEM      sizeof(((log_fifo_item_t*)0)->chr)
+#endif
+
+
+// Strings that fit in the characters of an item are copied there, which makes them safe to release
+// after the call and saves the log thread reading them through the pointer
+LOG_RAMFUNC void _log_str(char *string, uint32_t length, enum log_color color)
+{
+    log_fifo_item_t item = {.type = _LOG_STRING, .str = string, .strLen = length};
+
+    if(length && length <= LOG_CHARS_PER_ITEM)
+    {
+        item = (log_fifo_item_t){.type = LOG_CHAR, .nChars = length};
+        memcpy(item.chr, string, length);
+    }
+    log_item_set_color(&item, color);
+
+    log_input_put(&item);
+}
+
+
+LOG_RAMFUNC void _log_char(char chr, enum log_color color)
+{
+    log_fifo_item_t item = {.type = LOG_CHAR, .chr[0] = chr, .nChars = 1};
+
+    log_item_set_color(&item, color);
+
+    log_input_put(&item);
+}
+
+typedef struct log_chars_ctx_s
+{
+    const char *         chars;
+    uint32_t             nChars;
+    enum log_color       color;
+#if LOG_TIMESTAMPS
+    uint32_t             timestamp;
+#endif
+#if LOG_CONTEXT_IDS
+    uint8_t              ctxId;
+#endif
+} log_chars_ctx_t;
+
+
+// Only the first item has the color, like the groups of log_fmt()
+LOG_RAMFUNC static void log_chars_fill(log_fifo_item_t *pItem, uint32_t idx, const void *pCtx)
+{
+    const log_chars_ctx_t *pChars = pCtx;
+    uint32_t first = idx * LOG_CHARS_PER_ITEM;
+    uint32_t nChars = pChars->nChars - first;
+
+    if(nChars > LOG_CHARS_PER_ITEM)
+        nChars = LOG_CHARS_PER_ITEM;
+    *pItem = (log_fifo_item_t){.type = LOG_CHAR, .nChars = nChars};
+    memcpy(pItem->chr, &pChars->chars[first], nChars);
+    log_item_set_color(pItem, pChars->color);
+#if LOG_SUPPORT_ANSI_COLOR
+    if(idx)
+        pItem->color = LOG_COLOR_NONE;
+#endif
+#if LOG_TIMESTAMPS
+    pItem->timestamp = pChars->timestamp;
+#endif
+#if LOG_CONTEXT_IDS
+    pItem->ctxId = pChars->ctxId;
+#endif
+}
+
+
+// The characters are copied, up to 4 per item, and stored at once so no other log comes in between
+LOG_RAMFUNC void _log_chars(const char *chars, uint32_t nChars, enum log_color color)
+{
+    log_chars_ctx_t ctx = {.chars = chars, .nChars = nChars, .color = color};
+
+    if(!nChars)
+        return;
+#if LOG_TIMESTAMPS
+    ctx.timestamp = LOG_TIMESTAMP_GET();
+#endif
+#if LOG_CONTEXT_IDS
+    ctx.ctxId = log_context_id();
+#endif
+
+    log_input_put_n((nChars + LOG_CHARS_PER_ITEM - 1) / LOG_CHARS_PER_ITEM, log_chars_fill, &ctx);
+}
+
+
+#if LOG_RTOS_TRACE
+// Called by the FreeRTOS trace macros from inside the kernel: in PendSV, critical sections, ISRs or
+// with the scheduler suspended. The item only goes in the FIFO, the log thread is not woken up as
+// the kernel must not be called from there. It outputs the events with the next logs or after its
+// LOG_DELAY_LOOPS_MS wait. Tasks and queues are identified by their word offset in RAM.
+static void log_trace_put(enum log_trace_event event, uint32_t object)
+{
+    log_fifo_item_t item = {.type = _LOG_TRACE, .traceEvent = event, .uData = object};
+#if LOG_PER_CONTEXT_FIFOS
+    log_fifo_t *pFifo;
+#else
+    log_fifo_t *pFifo = &logFifo;
+#endif
+
+    if(!mIsTraceOn)                     // Tasks are created before log_init()
+        return;
+#if LOG_PER_CONTEXT_FIFOS
+    pFifo = log_input_fifo();
+#endif
+    item.timestamp = LOG_TIMESTAMP_GET();
+    log_input_stats(pFifo, 1, log_fifo_put(&item, pFifo));
+}
+
+
+void _log_trace(enum log_trace_event event, const void *pObject)
+{
+    log_trace_put(event, ((uintptr_t)pObject - SRAM_BASE) >> 2);
+}
+
+
+// Called first and last in the interrupt handlers to show, the exception number stands for the object
+void log_trace_isr_enter(void)
+{
+    log_trace_put(LOG_TRACE_ISR_ENTER, __get_IPSR());
+}
+
+
+void log_trace_isr_exit(void)
+{
+    log_trace_put(LOG_TRACE_ISR_EXIT, __get_IPSR());
+}
+#endif
+
+
+#if LOG_TASK_STATS || LOG_STACK_STATS || LOG_TASK_SNAPSHOT
+static inline void log_task_stats_str(const char *str)
+{
+    _log_str((char*)str, strlen(str), LOG_COLOR_NONE);
+}
+
+
+// Fills mTaskStatus with all the tasks, or logs an error line and returns 0 if they do not fit
+static uint32_t log_task_stats_get(uint32_t *pTotalRunTime)
+{
+    uint32_t nTasks = uxTaskGetSystemState(mTaskStatus, LOG_TASK_STATS_MAX_TASKS, pTotalRunTime);
+
+    if(!nTasks)
+        log_task_stats_str("Task stats: more than LOG_TASK_STATS_MAX_TASKS tasks\r\n");
+    return nTasks;
+}
+
+
+static inline void log_task_stats_name(const TaskStatus_t *pStatus)
+{
+    log_task_stats_str("  ");
+    _log_strcpy(pStatus->pcTaskName, strlen(pStatus->pcTaskName), LOG_COLOR_NONE);
+    log_task_stats_str(" ");
+}
+#endif
+
+
+#if LOG_TASK_STATS || LOG_STACK_STATS
+// Index of a task among the nTasks ones of the previous report, -1 if it did not exist then
+static int32_t log_task_stats_find(const UBaseType_t *pNumbers, uint32_t nTasks, UBaseType_t taskNumber)
+{
+    uint32_t i;
+
+    for(i = 0; i < nTasks; i++)
+    {
+        if(pNumbers[i] == taskNumber)
+            return (int32_t)i;
+    }
+    return -1;
+}
+#endif
+
+
+#if LOG_TASK_STATS
+// portCONFIGURE_TIMER_FOR_RUN_TIME_STATS(), called by vTaskStartScheduler() once MX_TIM2_Init() is done
+void _log_task_stats_start(void)
+{
+    SET_BIT(TIM2->CR1, TIM_CR1_CEN);
+}
+
+
+// Logs the counter ticks elapsed since the previous report, then for each task its share of them in
+// percent and its own ticks. The counters wrap, only their differences are used.
+static void log_task_stats_report(void)
+{
+    uint32_t nTasks;
+    uint32_t total;
+    uint32_t elapsed;
+    uint32_t runTime;
+    int32_t prev;
+    uint32_t i;
+
+    nTasks = log_task_stats_get(&total);
+    if(!nTasks)
+        return;
+    elapsed = total - mTaskStatsTotal;
+    mTaskStatsTotal = total;
+
+    log_task_stats_str("Task stats: ");
+    _log_var(elapsed, _LOG_UINT_DEC, LOG_COLOR_NONE);
+    log_task_stats_str(" ticks\r\n");
+    for(i = 0; i < nTasks; i++)
+    {
+        prev = log_task_stats_find(mTaskStatsNumbers, mTaskStatsNTasks, mTaskStatus[i].xTaskNumber);
+        runTime = mTaskStatus[i].ulRunTimeCounter - (prev < 0 ? 0 : mTaskStatsRunTimes[prev]);
+        log_task_stats_name(&mTaskStatus[i]);
+        _log_real(elapsed ? (uint32_t)(((uint64_t)runTime * 100 << 8) / elapsed) : 0, _LOG_FIXED,
+                  8 | _LOG_FIXED_UNSIGNED, 1, LOG_COLOR_NONE);
+        log_task_stats_str("% ");
+        _log_var(runTime, _LOG_UINT_DEC, LOG_COLOR_NONE);
+        log_task_stats_str("\r\n");
+    }
+
+    for(i = 0; i < nTasks; i++)
+    {
+        mTaskStatsNumbers[i]  = mTaskStatus[i].xTaskNumber;
+        mTaskStatsRunTimes[i] = mTaskStatus[i].ulRunTimeCounter;
+    }
+    mTaskStatsNTasks = nTasks;
+}
+#endif
+
+
+#if LOG_STACK_STATS
+// Logs the least free stack of each task since it started, in bytes. With LOG_STACK_STATS_ON_CHANGE
+// only the tasks whose minimum went down since the previous report are logged.
+static void log_stack_stats_report(void)
+{
+    uint32_t nTasks;
+    bool isHeaderLogged = false;
+    int32_t prev;
+    uint32_t i;
+
+    nTasks = log_task_stats_get(NULL);
+    if(!nTasks)
+        return;
+
+    for(i = 0; i < nTasks; i++)
+    {
+        prev = log_task_stats_find(mStackStatsNumbers, mStackStatsNTasks, mTaskStatus[i].xTaskNumber);
+        if(LOG_STACK_STATS_ON_CHANGE && prev >= 0 && mStackStatsFree[prev] == mTaskStatus[i].usStackHighWaterMark)
+            continue;
+        if(!isHeaderLogged)
+        {
+            log_task_stats_str("Stack free:\r\n");
+            isHeaderLogged = true;
+        }
+        log_task_stats_name(&mTaskStatus[i]);
+        _log_var(mTaskStatus[i].usStackHighWaterMark * sizeof(StackType_t), _LOG_UINT_DEC, LOG_COLOR_NONE);
+        log_task_stats_str(" bytes\r\n");
+    }
+
+    for(i = 0; i < nTasks; i++)
+    {
+        mStackStatsNumbers[i] = mTaskStatus[i].xTaskNumber;
+        mStackStatsFree[i]    = mTaskStatus[i].usStackHighWaterMark;
+    }
+    mStackStatsNTasks = nTasks;
+}
+#endif
+
+
+#if LOG_TASK_SNAPSHOT
+// Any context, the log thread logs the tasks at its next wakeup
+void log_task_snapshot(void)
+{
+    mIsSnapshotRequested = true;
+}
+
+
+// Logs a row per task after its name: number, eTaskState (0 running to 4 deleted), current priority,
+// least free stack in bytes and run time ticks (0 without LOG_TASK_STATS). The row is one array item,
+// a single record in binary mode, and the only copy is the one of uxTaskGetSystemState().
+static void log_task_snapshot_poll(void)
+{
+    uint32_t row[5];
+    uint32_t nTasks;
+    uint32_t i;
+
+    if(!mIsSnapshotRequested)
+        return;
+    mIsSnapshotRequested = false;
+    nTasks = log_task_stats_get(NULL);
+    if(!nTasks)
+        return;
+
+    log_task_stats_str("Task snapshot: number state priority stack run\r\n");
+    for(i = 0; i < nTasks; i++)
+    {
+        row[0] = mTaskStatus[i].xTaskNumber;
+        row[1] = mTaskStatus[i].eCurrentState;
+        row[2] = mTaskStatus[i].uxCurrentPriority;
+        row[3] = mTaskStatus[i].usStackHighWaterMark * sizeof(StackType_t);
+        row[4] = LOG_TASK_STATS ? mTaskStatus[i].ulRunTimeCounter : 0;
+        log_task_stats_name(&mTaskStatus[i]);
+        _log_array_copy(row, LOG_ARRAY_N_ELEM(row), sizeof(row[0]), _LOG_UINT_DEC, LOG_COLOR_NONE);
+        log_task_stats_str("\r\n");
+    }
+}
+#endif
+
+
+#if LOG_TASK_STATS || LOG_STACK_STATS
+// Called by the log thread at each wakeup, so the periods are only as precise as LOG_DELAY_LOOPS_MS
+static void log_task_stats_poll(void)
+{
+    TickType_t now = xTaskGetTickCount();
+
+#if LOG_TASK_STATS
+    if(now - mTaskStatsTick >= pdMS_TO_TICKS(LOG_TASK_STATS_PERIOD_MS))
+    {
+        mTaskStatsTick = now;
+        log_task_stats_report();
+    }
+#endif
+#if LOG_STACK_STATS
+    if(now - mStackStatsTick >= pdMS_TO_TICKS(LOG_STACK_STATS_PERIOD_MS))
+    {
+        mStackStatsTick = now;
+        log_stack_stats_report();
+    }
+#endif
+}
+#endif
+
+
+#if LOG_INSTANCES
+// Adds an instance whose input FIFO is made of the nBytes of pBuffer, which must be aligned for a
+// pointer. Returns false if there is not room for 2 items besides LOG_ERROR_RESERVE.
+bool log_ctx_init(log_ctx_t *pCtx, void *pBuffer, uint32_t nBytes, log_out_handler printHandler)
+{
+    uint32_t nSlots = nBytes / LOG_CTX_SLOT_SIZE;
+    uint32_t primaskBit;
+
+    static_assert(sizeof(log_fifo_t) <= sizeof(pCtx->fifo), "Log instance state must fit a FIFO");
+    if(!printHandler || ((uintptr_t)pBuffer & (sizeof(void*) - 1)))
+        return false;
+
+    while(nSlots & (nSlots - 1))
+        nSlots &= nSlots - 1;           // Largest power of 2 that fits
+    if(nSlots < LOG_FIFO_N_SLOTS(2) + LOG_ERROR_RESERVE)
+        return false;
+
+    log_fifo_init(LOG_CTX_FIFO(pCtx), pBuffer, (volatile bool*)((log_fifo_slot_t*)pBuffer + nSlots), NULL, nSlots);
+    pCtx->printHandler = printHandler;
+
+    LOG_ENTER_CRITICAL(primaskBit);
+    pCtx->pNext = mInstances;
+    mInstances  = pCtx;
+    LOG_EXIT_CRITICAL(primaskBit);
+    return true;
+}
+
+
+void _log_ctx_var(log_ctx_t *pCtx, uint32_t number, enum log_data_type type, enum log_color color)
+{
+    log_fifo_item_t item = {.type = type, .uData = number};
+
+    log_item_set_color(&item, color);
+
+    log_ctx_put(pCtx, &item);
+}
+
+
+void _log_ctx_str(log_ctx_t *pCtx, char *string, uint32_t length, enum log_color color)
+{
+    log_fifo_item_t item = {.type = _LOG_STRING, .str = string, .strLen = length};
+
+    log_item_set_color(&item, color);
+
+    log_ctx_put(pCtx, &item);
+}
+
+
+void _log_ctx_char(log_ctx_t *pCtx, char chr, enum log_color color)
+{
+    log_fifo_item_t item = {.type = LOG_CHAR, .chr[0] = chr, .nChars = 1};
+
+    log_item_set_color(&item, color);
+
+    log_ctx_put(pCtx, &item);
+}
+#endif
+
+
+typedef struct log_fmt_ctx_s
+{
+    const log_fmt_arg_t *pArgs;
+    enum log_color       color;
+    uint32_t             nPairs;                // Of a log_kv() record
+#if LOG_TIMESTAMPS
+    uint32_t             timestamp;
+#endif
+#if LOG_CONTEXT_IDS
+    uint8_t              ctxId;
+#endif
+#if LOG_DEDUP
+    uint32_t             nRepeats;              // Of the previous message, its notice goes first
+    enum log_color       repeatColor;
+#endif
+} log_fmt_ctx_t;
+
+
+#if LOG_DEDUP
+#define LOG_DEDUP_N_NOTICE      LOG_ARRAY_N_ELEM(mDedupNotice)
+
+static const log_fmt_arg_t mDedupNotice[] = {
+    {.str = "Last message repeated ", .number = sizeof("Last message repeated ") - 1, .type = _LOG_STRING},
+    {.type = _LOG_UINT_DEC},
+    {.str = " times\r\n", .number = sizeof(" times\r\n") - 1, .type = _LOG_STRING}
+};
+
+static log_fmt_arg_t        mDedupArgs[LOG_LINE_N_ARGS];    // Previous message
+static uint32_t             mDedupNArgs = 0;
+static enum log_color       mDedupColor;
+static uint32_t             mDedupRepeats = 0;
+#endif
+
+
+// Converts an argument of log_fmt() to an item. Only the first one has the color, which then
+// stays for the rest of the group.
+LOG_RAMFUNC static void log_fmt_fill(log_fifo_item_t *pItem, uint32_t idx, const void *pCtx)
+{
+    const log_fmt_ctx_t *pFmt = pCtx;
+    const log_fmt_arg_t *pArg;
+    enum log_color color = pFmt->color;
+#if LOG_DEDUP
+    log_fmt_arg_t notice;
+
+    if(pFmt->nRepeats && idx < LOG_DEDUP_N_NOTICE)
+    {
+        notice = mDedupNotice[idx];
+        if(notice.type == _LOG_UINT_DEC)
+            notice.number = pFmt->nRepeats;
+        pArg  = &notice;
+        color = pFmt->repeatColor;                 // Same level, it goes to the same backends
+    }
+    else
+    {
+        if(pFmt->nRepeats)
+            idx -= LOG_DEDUP_N_NOTICE;
+        pArg = &pFmt->pArgs[idx];
+    }
+#else
+    pArg = &pFmt->pArgs[idx];
+#endif
+
+    *pItem = (log_fifo_item_t){.type = pArg->type};
+    if(pArg->type == _LOG_STRING)
+    {
+        pItem->str    = (char*)pArg->str;
+        pItem->strLen = pArg->number;
+    }
+    else
+        pItem->uData  = pArg->number;
+    log_item_set_color(pItem, color);
+#if LOG_SUPPORT_ANSI_COLOR
+    if(idx)
+        pItem->color = LOG_COLOR_NONE;
+#endif
+#if LOG_TIMESTAMPS
+    pItem->timestamp = pFmt->timestamp;
+#endif
+#if LOG_CONTEXT_IDS
+    pItem->ctxId = pFmt->ctxId;
+#endif
+}
+
+
+#if LOG_DEDUP
+// Returns true if the message is the same as the previous one, which is then only counted. Otherwise
+// it becomes the one to compare with and pCtx gets the repeats of the previous one. Strings are
+// compared by address, the logger already requires their content to stay the same.
+static bool log_dedup(const log_fmt_arg_t *pArgs, uint32_t nArgs, log_fmt_ctx_t *pCtx)
+{
+    uint32_t primaskBit;
+    bool isRepeat;
+    uint32_t i;
+
+    LOG_ENTER_CRITICAL(primaskBit);
+    isRepeat = (nArgs == mDedupNArgs && pCtx->color == mDedupColor);
+    for(i = 0; isRepeat && i < nArgs; i++)
+        isRepeat = (pArgs[i].str == mDedupArgs[i].str && pArgs[i].number == mDedupArgs[i].number &&
+                    pArgs[i].type == mDedupArgs[i].type);
+
+    if(isRepeat)
+        mDedupRepeats++;
+    else
+    {
+        pCtx->nRepeats    = mDedupRepeats;
+        pCtx->repeatColor = mDedupColor;
+        mDedupRepeats     = 0;
+        mDedupNArgs       = (nArgs <= LOG_LINE_N_ARGS) ? nArgs : 0;     // Longer ones are never compared
+        mDedupColor       = pCtx->color;
+        memcpy(mDedupArgs, pArgs, mDedupNArgs * sizeof(*pArgs));
+    }
+    LOG_EXIT_CRITICAL(primaskBit);
+
+    return isRepeat;
+}
+
+
+// Stores the notice of the pending repeats, the next message is then stored whole again
+static void log_dedup_flush(void)
+{
+    log_fmt_ctx_t ctx = {.pArgs = NULL};
+    uint32_t primaskBit;
+
+    LOG_ENTER_CRITICAL(primaskBit);
+    ctx.nRepeats    = mDedupRepeats;
+    ctx.repeatColor = mDedupColor;
+    mDedupRepeats   = 0;
+    mDedupNArgs     = 0;
+    LOG_EXIT_CRITICAL(primaskBit);
+
+    if(ctx.nRepeats)
+    {
+#if LOG_TIMESTAMPS
+        ctx.timestamp = LOG_TIMESTAMP_GET();
+#endif
+#if LOG_CONTEXT_IDS
+        ctx.ctxId = log_context_id();
+#endif
+        log_input_put_n(LOG_DEDUP_N_NOTICE, log_fmt_fill, &ctx);
+    }
+}
+#endif
+
+
+LOG_RAMFUNC void _log_fmt(const log_fmt_arg_t *pArgs, uint32_t nArgs, enum log_color color)
+{
+    log_fmt_ctx_t ctx = {.pArgs = pArgs, .color = color};
+
+#if LOG_DEDUP
+    if(log_dedup(pArgs, nArgs, &ctx))
+        return;
+    if(ctx.nRepeats)
+        nArgs += LOG_DEDUP_N_NOTICE;
+#endif
+#if LOG_TIMESTAMPS
+    ctx.timestamp = LOG_TIMESTAMP_GET();
+#endif
+#if LOG_CONTEXT_IDS
+    ctx.ctxId = log_context_id();
+#endif
+
+    log_input_put_n(nArgs, log_fmt_fill, &ctx);
+}
+
+
+// The record item goes first with the number of pairs, then the keys and values as log_fmt() arguments
+LOG_RAMFUNC static void log_kv_fill(log_fifo_item_t *pItem, uint32_t idx, const void *pCtx)
+{
+    const log_fmt_ctx_t *pFmt = pCtx;
+
+    if(idx)
+    {
+        log_fmt_fill(pItem, idx - 1, pCtx);
+        log_item_set_color(pItem, LOG_COLOR_NONE);
+        return;
+    }
+
+    *pItem = (log_fifo_item_t){.type = _LOG_KV, .uData = pFmt->nPairs};
+    log_item_set_color(pItem, pFmt->color);
+#if LOG_TIMESTAMPS
+    pItem->timestamp = pFmt->timestamp;
+#endif
+#if LOG_CONTEXT_IDS
+    pItem->ctxId = pFmt->ctxId;
+#endif
+}
+
+
+// Not compared by LOG_DEDUP, the values of a record are what changes
+LOG_RAMFUNC void _log_kv(const log_fmt_arg_t *pArgs, uint32_t nPairs, enum log_color color)
+{
+    log_fmt_ctx_t ctx = {.pArgs = pArgs, .color = color, .nPairs = nPairs};
+
+#if LOG_TIMESTAMPS
+    ctx.timestamp = LOG_TIMESTAMP_GET();
+#endif
+#if LOG_CONTEXT_IDS
+    ctx.ctxId = log_context_id();
+#endif
+
+    log_input_put_n(1 + 2 * nPairs, log_kv_fill, &ctx);
+}
+
+
+#if !LOG_BINARY_OUTPUT
+#define LOG_HEXDUMP_ASCII_IDX   57      // Offset, 16 bytes in two groups, then " |"
+#define LOG_HEXDUMP_LINE_SIZE   (LOG_HEXDUMP_ASCII_IDX + 16 + 3)
+
+// Renders 16 bytes per line like hexdump -C: offset, bytes in hexadecimal and printable chars
+static void process_hexdump(const uint8_t *pData, uint32_t length)
+{
+    static const char hexDigits[16] = {'0','1','2','3','4','5','6','7',
+                                       '8','9','A','B','C','D','E','F'};
+    char line[LOG_HEXDUMP_LINE_SIZE];
+    uint32_t offset;
+    uint32_t nBytes;
+    uint32_t i;
+    char *pHex;
+
+    for(offset = 0; offset < length; offset += 16)
+    {
+        nBytes = (length - offset < 16) ? length - offset : 16;
+        memset(line, ' ', LOG_HEXDUMP_ASCII_IDX);
+        for(i = 0; i < 4; i++)
+            line[i] = hexDigits[(offset >> (12 - 4 * i)) & 0x0F];
+
+        for(i = 0; i < nBytes; i++)
+        {
+            uint8_t byte = pData[offset + i];
+
+            pHex = &line[6 + 3 * i + (i >= 8)];
+            pHex[0] = hexDigits[byte >> 4];
+            pHex[1] = hexDigits[byte & 0x0F];
+            line[LOG_HEXDUMP_ASCII_IDX + i] = (byte >= ' ' && byte <= '~') ? byte : '.';
+        }
+
+        line[LOG_HEXDUMP_ASCII_IDX - 1]          = '|';
+        line[LOG_HEXDUMP_ASCII_IDX + nBytes]     = '|';
+        line[LOG_HEXDUMP_ASCII_IDX + nBytes + 1] = '\r';
+        line[LOG_HEXDUMP_ASCII_IDX + nBytes + 2] = '\n';
+        process_string(line, LOG_HEXDUMP_ASCII_IDX + nBytes + 3);
+    }
+}
+#endif
+
+
+static inline uint32_t read_array_item(uint8_t *pData, uint8_t nBytesPerItem)
+{
+    if(nBytesPerItem == 4)
+        return *((uint32_t*)pData);
+    else if(nBytesPerItem == 2)
+        return *((uint16_t*)pData);
+    else
+        return *pData;
+}
+
+
+#if LOG_ARRAY_RECORDS && !LOG_BINARY_OUTPUT
+#define LOG_ARRAY_TEXT_SIZE     64      // Elements formatted before they are output together
+
+// stride is the distance in bytes between the items, nBytesPerItem for contiguous arrays. The elements
+// and their separators are formatted into one buffer, so the output only runs once per buffer.
+static void process_array(uint8_t *pData, uint32_t nItems, uint8_t nBytesPerItem, uint32_t stride,
+                          enum log_data_type type)
+{
+    char output[LOG_ARRAY_TEXT_SIZE];
+    uint32_t length = 0;
+
+    while(nItems--)
+    {
+        if(length > LOG_ARRAY_TEXT_SIZE - LOG_FORMAT_MAX - 1)
+        {
+            process_string(output, length);
+            length = 0;
+        }
+        length += format_number(&output[length], read_array_item(pData, nBytesPerItem), type);
+        pData += stride;
+        if(nItems)                      // Skips separator after last array item
+            output[length++] = ' ';
+    }
+    process_string(output, length);
+}
+#endif
+
+
+// A log_enum() item becomes the string of its name, or the number if the table has none for it
+static inline void log_enum_resolve(log_fifo_item_t *pItem)
+{
+    const char *const *pNames = (const char *const *)pItem->str;
+    uint8_t index = pItem->enumIndex;
+
+    if(index < pItem->enumCount)
+    {
+        pItem->type   = _LOG_STRING;
+        pItem->str    = (char*)pNames[index];
+        pItem->strLen = strlen(pItem->str);
+    }
+    else
+    {
+        pItem->type  = _LOG_UINT_DEC;
+        pItem->uData = index;
+    }
+}
+
+
+// Reads the log_ref() variable now, with a single access up to 32 bits
+static inline void log_ref_resolve(log_fifo_item_t *pItem)
+{
+    const volatile void *pVar = pItem->str;
+
+    switch(pItem->refSize)
+    {
+    case 1:
+        pItem->uData = *(const volatile uint8_t*)pVar;
+        break;
+    case 2:
+        pItem->uData = *(const volatile uint16_t*)pVar;
+        break;
+#if LOG_64BIT_NUMBERS
+    case 8:                             // Little endian, low word first
+        pItem->uData   = ((const volatile uint32_t*)pVar)[0];
+        pItem->uDataHi = ((const volatile uint32_t*)pVar)[1];
+        break;
+#endif
+    default:
+        pItem->uData = *(const volatile uint32_t*)pVar;
+    }
+    pItem->type = (enum log_data_type)pItem->refType;
+}
+
+
+#if LOG_REGS || LOG_CUSTOM_TYPES || LOG_PRINTF
+#define LOG_DECODE_LINE_SIZE    128     // Longer decodes are cut
+
+static char     mDecodeLine[LOG_DECODE_LINE_SIZE];
+static uint32_t mDecodeLength;
+
+
+static void log_decode_put(const char *str, uint32_t strLen)
+{
+    if(strLen > LOG_DECODE_LINE_SIZE - mDecodeLength)
+        strLen = LOG_DECODE_LINE_SIZE - mDecodeLength;
+    memcpy(&mDecodeLine[mDecodeLength], str, strLen);
+    mDecodeLength += strLen;
+}
+
+
+// The decoded item is sent as a string, the buffer is free again once it is processed
+static void log_decode_end(log_fifo_item_t *pItem)
+{
+    pItem->type   = _LOG_STRING;
+    pItem->str    = mDecodeLine;
+    pItem->strLen = mDecodeLength;
+}
+#endif
+
+
+#if LOG_REGS
+// A log_reg() item becomes the string of its fields, rendered in a buffer of the log thread
+static void log_reg_resolve(log_fifo_item_t *pItem)
+{
+    const log_reg_desc_t *pDesc = (const log_reg_desc_t*)&__log_regs_start[pItem->regDesc << 2];
+    const log_reg_field_t *pField;
+    char digits[10];
+    uint32_t field;
+    uint32_t i;
+
+    mDecodeLength = 0;
+    if(pDesc->name)
+    {
+        log_decode_put(pDesc->name, strlen(pDesc->name));
+        log_decode_put(":", 1);
+    }
+    for(i = 0; i < pDesc->nFields; i++)
+    {
+        pField = &pDesc->pFields[i];
+        field  = pItem->uData >> pField->offset;
+        if(pField->width < 32)
+            field &= (1UL << pField->width) - 1;
+
+        if(mDecodeLength)
+            log_decode_put(" ", 1);
+        log_decode_put(pField->name, strlen(pField->name));
+        log_decode_put("=", 1);
+        log_decode_put(digits, format_decimal(digits, field, false));
+    }
+    log_decode_end(pItem);
+}
+#endif
+
+
+#if LOG_PRINTF
+static void log_printf_pad(char chr, uint32_t nChars, log_type_put_t put)
+{
+    if(nChars > LOG_DECODE_LINE_SIZE)
+        nChars = LOG_DECODE_LINE_SIZE;
+    while(nChars--)
+        put(&chr, 1);
+}
+
+
+// Puts a conversion padded to its width: the sign or prefix, then the zeros of the '0' flag or of the
+// precision of integers, then the digits or the string
+static void log_printf_field(const char *pPrefix, uint32_t prefixLen, uint32_t nZeros, const char *str, uint32_t strLen,
+                             uint32_t width, bool isLeft, bool isZeroPad, log_type_put_t put)
+{
+    uint32_t length = prefixLen + nZeros + strLen;
+    uint32_t nPad = (width > length) ? width - length : 0;
+
+    if(!isLeft && !isZeroPad)
+        log_printf_pad(' ', nPad, put);
+    put(pPrefix, prefixLen);
+    log_printf_pad('0', nZeros + ((!isLeft && isZeroPad) ? nPad : 0), put);
+    put(str, strLen);
+    if(isLeft)
+        log_printf_pad(' ', nPad, put);
+}
+
+
+// Reads a width or a precision, '*' takes it from the next argument
+static int32_t log_printf_number(const char **ppFmt, const uintptr_t *pWords, uint32_t nWords, uint32_t *pWordIdx)
+{
+    int32_t number = 0;
+
+    if(**ppFmt == '*')
+    {
+        (*ppFmt)++;
+        return (*pWordIdx < nWords) ? (int32_t)pWords[(*pWordIdx)++] : 0;
+    }
+    while(**ppFmt >= '0' && **ppFmt <= '9')
+    {
+        if(number < LOG_DECODE_LINE_SIZE)
+            number = number * 10 + *(*ppFmt)++ - '0';
+        else
+            (*ppFmt)++;
+    }
+    return number;
+}
+
+
+// Formatter of the log_printf() records: the words are the format pointer then the arguments. Flags,
+// width and precision are supported, length modifiers are skipped and e and g print as f. Arguments
+// missing from the record print "?".
+static void log_printf_render(const void *pData, uint32_t size, log_type_put_t put)
+{
+    uintptr_t words[LOG_PRINTF_MAX_WORDS];
+    uint32_t nWords = size / sizeof(uintptr_t);
+    uint32_t wordIdx = 1;
+    char digits[LOG_FORMAT_MAX];
+    const char *pFmt;
+    const char *pStart;
+    const char *str;
+    uint32_t strLen;
+    uintptr_t word;
+    uint32_t nZeros;
+    uint32_t i;
+    int32_t width;
+    int32_t precision;
+    bool isLeft;
+    bool isZeroPad;
+    bool isAlternate;
+    char sign;
+    char conversion;
+
+    if(nWords > LOG_PRINTF_MAX_WORDS)
+        nWords = LOG_PRINTF_MAX_WORDS;
+    memcpy(words, pData, nWords * sizeof(uintptr_t));
+    pFmt = (const char*)words[0];
+
+    while(*pFmt)
+    {
+        pStart = pFmt;
+        while(*pFmt && *pFmt != '%')
+            pFmt++;
+        put(pStart, pFmt - pStart);
+        if(!*pFmt)
+            break;
+
+        pStart = pFmt++;
+        isLeft = isZeroPad = isAlternate = false;
+        sign = 0;
+        for(;; pFmt++)
+        {
+            if(*pFmt == '-')
+                isLeft = true;
+            else if(*pFmt == '0')
+                isZeroPad = true;
+            else if(*pFmt == '+')
+                sign = '+';
+            else if(*pFmt == ' ')
+                sign = sign ? sign : ' ';
+            else if(*pFmt == '#')
+                isAlternate = true;
+            else
+                break;
+        }
+        width = log_printf_number(&pFmt, words, nWords, &wordIdx);
+        if(width < 0)
+        {
+            isLeft = true;
+            width = (width < -LOG_DECODE_LINE_SIZE) ? LOG_DECODE_LINE_SIZE : -width;
+        }
+        precision = -1;
+        if(*pFmt == '.')
+        {
+            pFmt++;
+            precision = log_printf_number(&pFmt, words, nWords, &wordIdx);
+            if(precision < 0)
+                precision = -1;
+        }
+        while(*pFmt && strchr("hlLqjzt", *pFmt))
+            pFmt++;
+
+        conversion = *pFmt;
+        if(!conversion)
+        {
+            put(pStart, pFmt - pStart);
+            break;
+        }
+        pFmt++;
+        if(conversion == '%')
+        {
+            put("%", 1);
+            continue;
+        }
+        if(!strchr("diuxXpcsfFeEgG", conversion))
+        {
+            put(pStart, pFmt - pStart);     // Unknown conversions are printed as they are
+            continue;
+        }
+        if(wordIdx >= nWords)
+        {
+            put("?", 1);
+            continue;
+        }
+
+        word   = words[wordIdx++];
+        str    = digits;
+        nZeros = 0;
+        switch(conversion)
+        {
+        case 'c':
+            digits[0] = (char)word;
+            log_printf_field("", 0, 0, digits, 1, width, isLeft, false, put);
+            continue;
+        case 's':
+            str = word ? (const char*)word : "(null)";
+            strLen = strlen(str);
+            if(precision >= 0 && strLen > (uint32_t)precision)
+                strLen = precision;
+            log_printf_field("", 0, 0, str, strLen, width, isLeft, false, put);
+            continue;
+        case 'd':
+        case 'i':
+            strLen = format_decimal(digits, ((int32_t)word < 0) ? -(uint32_t)word : word, (int32_t)word < 0);
+            break;
+        case 'u':
+            strLen = format_decimal(digits, word, false);
+            sign = 0;
+            break;
+        case 'x':
+        case 'X':
+        case 'p':
+            strLen = format_hexadecimal(digits, word, 8);
+            while(strLen > 1 && *str == '0')
+            {
+                str++;
+                strLen--;
+            }
+            for(i = 8 - strLen; conversion != 'X' && i < 8; i++)
+                digits[i] |= 0x20;          // Lower case letters, digits are unchanged
+            sign = 0;
+            break;
+        default:
+            strLen = format_float(digits, word, (precision < 0) ? 6 : (precision > 9) ? 9 : precision);
+            precision = -1;
+            break;
+        }
+
+        // The sign or prefix goes before the zeros
+        if(str[0] == '-')
+        {
+            sign = '-';
+            str++;
+            strLen--;
+        }
+        if(precision >= 0)
+        {
+            isZeroPad = false;
+            if(strLen < (uint32_t)precision)
+                nZeros = precision - strLen;
+            else if(!precision && word == 0)
+                strLen = 0;
+        }
+        if(conversion == 'p' || (isAlternate && (conversion == 'x' || conversion == 'X') && word))
+            log_printf_field((conversion == 'X') ? "0X" : "0x", 2, nZeros, str, strLen, width, isLeft, isZeroPad, put);
+        else
+            log_printf_field(&sign, sign ? 1 : 0, nZeros, str, strLen, width, isLeft, isZeroPad, put);
+    }
+}
+#endif
+
+
+#if LOG_CUSTOM_TYPES || LOG_PRINTF
+// The formatter of a log_custom() item renders the copy, which is released before the string is sent.
+// Records without data have no arena allocation.
+static void log_custom_resolve(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+{
+    log_type_format_t format = NULL;
+    const uint8_t *pData = pItem->customLen ? log_arena_ptr(pFifo, pItem->arenaIdx) : NULL;
+
+#if LOG_CUSTOM_TYPES
+    if(pItem->customId < LOG_CUSTOM_TYPES)
+        format = mTypeFormats[pItem->customId];
+#endif
+#if LOG_PRINTF
+    if(pItem->customId == LOG_PRINTF_TYPE_ID)
+        format = log_printf_render;
+#endif
+    mDecodeLength = 0;
+    if(format)
+        format(pData, pItem->customLen, log_decode_put);
+    else
+        log_decode_put("?", 1);
+    if(pItem->customLen)
+        log_arena_release(pFifo, pItem->arenaIdx + pItem->customLen);
+    log_decode_end(pItem);
+}
+#endif
+
+
+#if LOG_BINARY_OUTPUT
+#define LOG_BINARY_TAG(type, color)     ((uint8_t)(((type) + 1) | ((color) << 4)))
+#define LOG_BINARY_FIFO_FULL            0       // Tag sent when the input FIFO was found full
+#define LOG_BINARY_VARINT_MAX           5
+#define LOG_BINARY_VARINT64_MAX         10
+#define LOG_BINARY_SEQ_SIZE             (LOG_SEQUENCE_NUMBERS ? sizeof(uint16_t) : 0)
+#define LOG_BINARY_STRING_ID            14      // Type of interned string records, outside of enum log_data_type
+#define LOG_BINARY_FIXED                10      // Types of fixed point and float records, which reuse the ones of
+#define LOG_BINARY_FLOAT                11      // the copy records as those are sent as strings and arrays
+#define LOG_BINARY_HEXDUMP              13      // 64 bit decimals are sent with the 32 bit tags, so it is free
+#define LOG_BINARY_TRACE                0xF0    // No color uses this high nibble, the low one is the trace event
+#define LOG_BINARY_LOCATION             0xE0    // Nor this one, followed by the 4 bytes of the LOG_HERE() record
+#define LOG_BINARY_KV                   0xD0    // Nor this one, followed by the CBOR map of a log_kv() record
+#define LOG_CBOR_UINT                   0x00    // Major types of the CBOR heads, in the top 3 bits
+#define LOG_CBOR_NEGINT                 0x20
+#define LOG_CBOR_TEXT                   0x60
+#define LOG_CBOR_MAP                    0xA0
+#define LOG_CBOR_HEAD_MAX               5
+#if LOG_ARRAY_DELTA
+#define LOG_BINARY_ARRAY_DELTA          0x80    // Flag of the element type byte of delta encoded arrays
+#else
+#define LOG_BINARY_ARRAY_DELTA          0
+#endif
+
+#if LOG_INTERN_STRINGS
+extern const char __log_strings_start[];        // Defined in the linker script
+extern const char __log_strings_end[];
+#endif
+
+#if LOG_SUPPORT_ANSI_COLOR
+#define LOG_BINARY_COLOR(pItem)         ((pItem)->color)
+#else
+#define LOG_BINARY_COLOR(pItem)         LOG_COLOR_NONE
+#endif
+
+
+// Writes number as a base 128 varint (7 bits per byte, LSB first), returns its length
+static uint32_t binary_put_varint(uint8_t *pOutput, uint32_t number)
+{
+    uint32_t i = 0;
+
+    while(number >= 0x80)
+    {
+        pOutput[i++] = (number & 0x7F) | 0x80;
+        number >>= 7;
+    }
+    pOutput[i++] = number;
+    return i;
+}
+
+
+// Signed values are zigzag encoded so small negative numbers also need few bytes
+static uint32_t binary_put_number(uint8_t *pOutput, uint32_t number, enum log_data_type type)
+{
+    int32_t value;
+
+    switch(type)
+    {
+    case _LOG_INT_DEC_1:
+        value = (int8_t)number;
+        break;
+    case _LOG_INT_DEC_2:
+        value = (int16_t)number;
+        break;
+    case _LOG_INT_DEC_4:
+        value = (int32_t)number;
+        break;
+    case _LOG_HEX_1:
+        return binary_put_varint(pOutput, number & 0xFF);
+    case _LOG_HEX_2:
+        return binary_put_varint(pOutput, number & 0xFFFF);
+    default:
+        return binary_put_varint(pOutput, number);
+    }
+
+    return binary_put_varint(pOutput, (value < 0) ? ~((uint32_t)value << 1) : ((uint32_t)value << 1));
+}
+
+
+#if LOG_64BIT_NUMBERS
+// Same encodings for 64 bit numbers, split in two words
+static uint32_t binary_put_number64(uint8_t *pOutput, uint32_t lo, uint32_t hi, enum log_data_type type)
+{
+    uint32_t i = 0;
+
+    if(type == _LOG_INT_DEC_8)
+    {
+        bool isNegative = (int32_t)hi < 0;
+
+        hi = (hi << 1) | (lo >> 31);
+        lo <<= 1;
+        if(isNegative)
+        {
+            hi = ~hi;
+            lo = ~lo;
+        }
+    }
+
+    while(hi || lo >= 0x80)
+    {
+        pOutput[i++] = (lo & 0x7F) | 0x80;
+        lo = (lo >> 7) | (hi << 25);
+        hi >>= 7;
+    }
+    pOutput[i++] = lo;
+    return i;
+}
+#endif
+
+
+#if LOG_ARRAY_DELTA
+// Signed items are sign extended, so the difference of two of them is the one of their values
+static inline uint32_t binary_array_value(uint8_t *pData, uint8_t nBytesPerItem, enum log_data_type type)
+{
+    uint32_t number = read_array_item(pData, nBytesPerItem);
+
+    if(type == _LOG_INT_DEC_1)
+        return (uint32_t)(int32_t)(int8_t)number;
+    if(type == _LOG_INT_DEC_2)
+        return (uint32_t)(int32_t)(int16_t)number;
+    return number;
+}
+
+
+// Each item is sent as the zigzag difference with the previous one (modulo 2^32, the first one with 0).
+// A difference of 0 is followed by the number of further repeats, so slowly varying series take
+// one byte per item and constant ones a couple of bytes in total. Returns the last item, the previous
+// one of the next chunk of the same record.
+static uint32_t binary_process_array(uint8_t *pData, uint32_t nItems, uint8_t nBytesPerItem, uint32_t stride,
+                                     enum log_data_type type, uint32_t previous)
+{
+    uint8_t output[2 * LOG_BINARY_VARINT_MAX];
+    uint32_t value;
+    uint32_t nRepeats;
+    uint32_t length;
+
+    while(nItems)
+    {
+        value = binary_array_value(pData, nBytesPerItem, type);
+        pData += stride;
+        nItems--;
+
+        length = binary_put_number(output, value - previous, _LOG_INT_DEC_4);
+        if(value == previous)
+        {
+            for(nRepeats = 0; nItems && binary_array_value(pData, nBytesPerItem, type) == value; nRepeats++)
+            {
+                pData += stride;
+                nItems--;
+            }
+            length += binary_put_varint(&output[length], nRepeats);
+        }
+        process_string((char*)output, length);
+        previous = value;
+    }
+    return previous;
+}
+#elif LOG_ARRAY_RECORDS
+static uint32_t binary_process_array(uint8_t *pData, uint32_t nItems, uint8_t nBytesPerItem, uint32_t stride,
+                                     enum log_data_type type, uint32_t previous)
+{
+    uint8_t output[LOG_BINARY_VARINT_MAX];
+
+    (void)previous;                     // Only the differences of LOG_ARRAY_DELTA need it
+    while(nItems--)
+    {
+        process_string((char*)output, binary_put_number(output, read_array_item(pData, nBytesPerItem), type));
+        pData += stride;
+    }
+    return 0;
+}
+#endif
+#endif
+
+
+#if LOG_ARRAY_CHUNK_ELEMS
+// Bulk array record being output, LOG_ARRAY_CHUNK_ELEMS elements per item of the flush passes, so a
+// large one does not hold the log thread nor flood the backend at once
+typedef struct log_array_cursor_s
+{
+    uint8_t *pData;                     // Next element
+    uint32_t nElems;                    // Elements left, 0 if no record is pending
+    uint32_t stride;
+    uint8_t  elemSize;
+    enum log_data_type elemType;
+#if LOG_BINARY_OUTPUT
+    uint32_t previous;                  // Last element sent, LOG_ARRAY_DELTA goes on from it
+#endif
+#if LOG_N_BACKENDS > 1
+    uint32_t outLevelBit;               // Backends of the record
+#endif
+} log_array_cursor_t;
+
+static log_array_cursor_t mArrayCursor;
+
+#define LOG_ARRAY_IS_PENDING()          (mArrayCursor.nElems != 0)
+
+
+static void process_array_chunk(void)
+{
+    uint32_t nElems = (mArrayCursor.nElems > LOG_ARRAY_CHUNK_ELEMS) ? LOG_ARRAY_CHUNK_ELEMS : mArrayCursor.nElems;
+
+#if LOG_N_BACKENDS > 1
+    mOutLevelBit = mArrayCursor.outLevelBit;
+#endif
+#if LOG_BINARY_OUTPUT
+    mArrayCursor.previous = binary_process_array(mArrayCursor.pData, nElems, mArrayCursor.elemSize,
+                                                 mArrayCursor.stride, mArrayCursor.elemType, mArrayCursor.previous);
+#else
+    process_array(mArrayCursor.pData, nElems, mArrayCursor.elemSize, mArrayCursor.stride, mArrayCursor.elemType);
+    if(nElems < mArrayCursor.nElems)
+        process_string(" ", 1);
+#endif
+    mArrayCursor.pData  += nElems * mArrayCursor.stride;
+    mArrayCursor.nElems -= nElems;
+}
+#else
+#define LOG_ARRAY_IS_PENDING()          false
+#endif
+
+
+#if LOG_BULK_ARRAYS
+// Elements of a reference record, after its binary header. With LOG_ARRAY_CHUNK_ELEMS only the first
+// chunk is output here, log_flush_items() outputs the others before any new item.
+static void process_array_record(uint8_t *pData, uint32_t nElems, uint8_t elemSize, uint32_t stride,
+                                 enum log_data_type type)
+{
+#if LOG_ARRAY_CHUNK_ELEMS
+    mArrayCursor.pData    = pData;
+    mArrayCursor.nElems   = nElems;
+    mArrayCursor.stride   = stride;
+    mArrayCursor.elemSize = elemSize;
+    mArrayCursor.elemType = type;
+#if LOG_BINARY_OUTPUT
+    mArrayCursor.previous = 0;
+#endif
+#if LOG_N_BACKENDS > 1
+    mArrayCursor.outLevelBit = mOutLevelBit;
+#endif
+    process_array_chunk();
+#elif LOG_BINARY_OUTPUT
+    binary_process_array(pData, nElems, elemSize, stride, type, 0);
+#else
+    process_array(pData, nElems, elemSize, stride, type);
+#endif
+}
+#endif
+
+
+#if LOG_BINARY_OUTPUT
+#if LOG_TIMESTAMPS
+static uint32_t mLastTimestamp = 0;
+#endif
+
+
+// Writes a CBOR head, its major type and its argument in the shortest big endian form, returns its length
+static uint32_t binary_put_cbor(uint8_t *pOutput, uint8_t major, uint32_t argument)
+{
+    uint32_t nBytes = (argument > UINT16_MAX) ? 4 : (argument > UINT8_MAX) ? 2 : (argument >= 24) ? 1 : 0;
+    uint32_t i;
+
+    pOutput[0] = major | ((nBytes == 4) ? 26 : (nBytes == 2) ? 25 : nBytes ? 24 : argument);
+    for(i = 0; i < nBytes; i++)
+        pOutput[1 + i] = argument >> (8 * (nBytes - 1 - i));
+    return 1 + nBytes;
+}
+
+
+// Same types as binary_put_number(), as CBOR unsigned or negative integers
+static uint32_t binary_put_cbor_number(uint8_t *pOutput, uint32_t number, enum log_data_type type)
+{
+    int32_t value;
+
+    switch(type)
+    {
+    case _LOG_INT_DEC_1:
+        value = (int8_t)number;
+        break;
+    case _LOG_INT_DEC_2:
+        value = (int16_t)number;
+        break;
+    case _LOG_INT_DEC_4:
+        value = (int32_t)number;
+        break;
+    case _LOG_HEX_1:
+        return binary_put_cbor(pOutput, LOG_CBOR_UINT, number & 0xFF);
+    case _LOG_HEX_2:
+        return binary_put_cbor(pOutput, LOG_CBOR_UINT, number & 0xFFFF);
+    default:
+        return binary_put_cbor(pOutput, LOG_CBOR_UINT, number);
+    }
+
+    // A negative integer head holds -1 - value
+    if(value < 0)
+        return binary_put_cbor(pOutput, LOG_CBOR_NEGINT, ~(uint32_t)value);
+    return binary_put_cbor(pOutput, LOG_CBOR_UINT, value);
+}
+
+
+// Sends the keys and values of a log_kv() record, the next items of its FIFO, into its CBOR map.
+// Interned keys are sent as the unsigned offset of their string instead of its characters.
+static void binary_process_kv(uint32_t nPairs, log_fifo_t *pFifo)
+{
+    uint8_t output[LOG_CBOR_HEAD_MAX];
+    log_fifo_item_t item;
+    uint32_t i;
+
+    for(i = 0; i < 2 * nPairs && log_fifo_get(&item, pFifo); i++)
+    {
+        if(item.type != _LOG_STRING)
+        {
+            process_string((char*)output, binary_put_cbor_number(output, item.uData, item.type));
+            continue;
+        }
+#if LOG_INTERN_STRINGS
+        if(!(i & 1) && (uintptr_t)item.str >= (uintptr_t)__log_strings_start &&
+           (uintptr_t)item.str < (uintptr_t)__log_strings_end)
+        {
+            process_string((char*)output, binary_put_cbor(output, LOG_CBOR_UINT, item.str - __log_strings_start));
+            continue;
+        }
+#endif
+        process_string((char*)output, binary_put_cbor(output, LOG_CBOR_TEXT, item.strLen));
+        process_string(item.str, item.strLen);
+    }
+}
+
+
+// Sends the item as a tag byte (type + 1 and color) followed by its encoded content
+static void binary_process_item(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+{
+#if LOG_64BIT_NUMBERS
+    uint8_t output[2 + LOG_BINARY_SEQ_SIZE + LOG_BINARY_VARINT_MAX + LOG_BINARY_VARINT64_MAX];
+#else
+    uint8_t output[3 + LOG_BINARY_SEQ_SIZE + 2 * LOG_BINARY_VARINT_MAX];   // Fixed point records have two format bytes
+#endif
+    uint32_t length = 1;
+
+#if LOG_LATENCY
+    log_latency_item(pItem->timestamp);
+#endif
+#if LOG_SEQUENCE_NUMBERS
+    // Then the 16 bit little endian sequence number, dropped items leave a gap
+    memcpy(&output[length], &pItem->seq, sizeof(uint16_t));
+    length += sizeof(uint16_t);
+#endif
+#if LOG_TIMESTAMPS
+    // Each tag is followed by the signed difference with the timestamp of the previous record
+    length += binary_put_number(&output[length], pItem->timestamp - mLastTimestamp, _LOG_INT_DEC_4);
+    mLastTimestamp = pItem->timestamp;
+#endif
+#if LOG_DEFERRED_STRLEN
+    log_strlen_resolve(pItem);
+#endif
+    if(pItem->type == _LOG_ENUM)        // Names of the string section are sent as interned strings
+        log_enum_resolve(pItem);
+    if(pItem->type == _LOG_REF)
+        log_ref_resolve(pItem);
+#if LOG_REGS
+    if(pItem->type == _LOG_REG)
+        log_reg_resolve(pItem);
+#endif
+#if LOG_CUSTOM_TYPES || LOG_PRINTF
+    if(pItem->type == _LOG_CUSTOM)
+        log_custom_resolve(pItem, pFifo);
+#endif
+
+    switch(pItem->type)
+    {
+    case _LOG_STRING:
+#if LOG_INTERN_STRINGS
+        if((uintptr_t)pItem->str >= (uintptr_t)__log_strings_start && (uintptr_t)pItem->str < (uintptr_t)__log_strings_end)
+        {
+            output[0] = LOG_BINARY_TAG(LOG_BINARY_STRING_ID, LOG_BINARY_COLOR(pItem));
+            length += binary_put_varint(&output[length], pItem->str - __log_strings_start);
+            process_string((char*)output, length);
+            break;
+        }
+#endif
+        output[0] = LOG_BINARY_TAG(_LOG_STRING, LOG_BINARY_COLOR(pItem));
+        length += binary_put_varint(&output[length], pItem->strLen);
+        process_string((char*)output, length);
+        process_string(pItem->str, pItem->strLen);
+        break;
+    case LOG_CHAR:
+        output[0] = LOG_BINARY_TAG(LOG_CHAR, LOG_BINARY_COLOR(pItem));
+        output[length++] = pItem->nChars;
+        process_string((char*)output, length);
+        process_string(pItem->chr, pItem->nChars);
+        break;
+#if LOG_BULK_ARRAYS
+    case _LOG_ARRAY:
+        output[0] = LOG_BINARY_TAG(_LOG_ARRAY, LOG_BINARY_COLOR(pItem));
+        output[length++] = pItem->elemType | LOG_BINARY_ARRAY_DELTA;
+        length += binary_put_varint(&output[length], pItem->nElems);
+        process_string((char*)output, length);
+        process_array_record((uint8_t*)pItem->str, pItem->nElems, pItem->elemSize, pItem->elemSize, pItem->elemType);
+        break;
+    case _LOG_ARRAY_STRIDE:             // Same record as a contiguous array for the host
+        output[0] = LOG_BINARY_TAG(_LOG_ARRAY, LOG_BINARY_COLOR(pItem));
+        output[length++] = pItem->elemType | LOG_BINARY_ARRAY_DELTA;
+        length += binary_put_varint(&output[length], pItem->strideElems);
+        process_string((char*)output, length);
+        process_array_record((uint8_t*)pItem->str, pItem->strideElems, pItem->elemSize, pItem->stride, pItem->elemType);
+        break;
+#endif
+#if LOG_COPY_ARENA_SIZE
+    case _LOG_STRING_COPY:
+        output[0] = LOG_BINARY_TAG(_LOG_STRING, LOG_BINARY_COLOR(pItem));
+        length += binary_put_varint(&output[length], pItem->strLen);
+        process_string((char*)output, length);
+        process_string((char*)log_arena_ptr(pFifo, pItem->arenaIdx), pItem->strLen);
+        log_arena_release(pFifo, pItem->arenaIdx + pItem->strLen);
+        break;
+    case _LOG_ARRAY_COPY:
+        output[0] = LOG_BINARY_TAG(_LOG_ARRAY, LOG_BINARY_COLOR(pItem));
+        output[length++] = pItem->elemType | LOG_BINARY_ARRAY_DELTA;
+        length += binary_put_varint(&output[length], pItem->nElems);
+        process_string((char*)output, length);
+        binary_process_array(log_arena_ptr(pFifo, pItem->arenaIdx), pItem->nElems, pItem->elemSize, pItem->elemSize,
+                             pItem->elemType, 0);
+        log_arena_release(pFifo, pItem->arenaIdx + pItem->nElems * pItem->elemSize);
+        break;
+    case _LOG_HEXDUMP_COPY:
+        output[0] = LOG_BINARY_TAG(LOG_BINARY_HEXDUMP, LOG_BINARY_COLOR(pItem));
+        length += binary_put_varint(&output[length], pItem->strLen);
+        process_string((char*)output, length);
+        process_string((char*)log_arena_ptr(pFifo, pItem->arenaIdx), pItem->strLen);
+        log_arena_release(pFifo, pItem->arenaIdx + pItem->strLen);
+        break;
+#endif
+    case _LOG_HEXDUMP:
+        output[0] = LOG_BINARY_TAG(LOG_BINARY_HEXDUMP, LOG_BINARY_COLOR(pItem));
+        length += binary_put_varint(&output[length], pItem->strLen);
+        process_string((char*)output, length);
+        process_string(pItem->str, pItem->strLen);
+        break;
+    case _LOG_FIXED:
+        output[0] = LOG_BINARY_TAG(LOG_BINARY_FIXED, LOG_BINARY_COLOR(pItem));
+        output[length++] = pItem->fracBits;
+        output[length++] = pItem->nDecimals;
+        length += binary_put_number(&output[length], pItem->uData,
+                                    (pItem->fracBits & _LOG_FIXED_UNSIGNED) ? _LOG_UINT_DEC : _LOG_INT_DEC_4);
+        process_string((char*)output, length);
+        break;
+    case _LOG_FLOAT:
+        output[0] = LOG_BINARY_TAG(LOG_BINARY_FLOAT, LOG_BINARY_COLOR(pItem));
+        output[length++] = pItem->nDecimals;
+        memcpy(&output[length], &pItem->uData, sizeof(uint32_t));
+        length += sizeof(uint32_t);
+        process_string((char*)output, length);
+        break;
+#if LOG_64BIT_NUMBERS
+    // Varints have no fixed size, so 64 bit decimals reuse the 32 bit tags. Only hex needs its own
+    // tag, as it is printed with 16 digits.
+    case _LOG_HEX_8:
+    case _LOG_UINT_DEC_8:
+    case _LOG_INT_DEC_8:
+        output[0] = LOG_BINARY_TAG(pItem->type == _LOG_HEX_8     ? _LOG_HEX_8    :
+                                   pItem->type == _LOG_UINT_DEC_8 ? _LOG_UINT_DEC : _LOG_INT_DEC_4,
+                                   LOG_BINARY_COLOR(pItem));
+        length += binary_put_number64(&output[length], pItem->uData, pItem->uDataHi, pItem->type);
+        process_string((char*)output, length);
+        break;
+#endif
+#if LOG_RTOS_TRACE
+    case _LOG_TRACE:
+        output[0] = LOG_BINARY_TRACE | pItem->traceEvent;
+        length += binary_put_varint(&output[length], pItem->uData);
+        process_string((char*)output, length);
+        break;
+#endif
+    case _LOG_LOCATION:
+        output[0] = LOG_BINARY_LOCATION;
+        memcpy(&output[length], &pItem->uData, sizeof(uint32_t));
+        length += sizeof(uint32_t);
+        process_string((char*)output, length);
+        break;
+    case _LOG_KV:
+        output[0] = LOG_BINARY_KV;
+        length += binary_put_cbor(&output[length], LOG_CBOR_MAP, pItem->uData);
+        process_string((char*)output, length);
+        binary_process_kv(pItem->uData, pFifo);
+        break;
+    default:
+        output[0] = LOG_BINARY_TAG(pItem->type, LOG_BINARY_COLOR(pItem));
+        length += binary_put_number(&output[length], pItem->uData, pItem->type);
+        process_string((char*)output, length);
+    }
+
+    (void)pFifo;
+}
+#endif
+
+
+LOG_RAMFUNC void _log_array(void *pArray, uint32_t nItems, uint8_t nBytesPerItem, enum log_data_type type, enum log_color color)
+{
+    uint8_t *pData = (uint8_t*) pArray;
+#if LOG_BULK_ARRAYS
+    log_fifo_item_t item = {.type = _LOG_ARRAY, .elemType = type, .elemSize = nBytesPerItem};
+    uint32_t nChunk;
+
+    log_item_set_color(&item, color);
+
+    // Only the reference is stored, items are read when the log thread formats them
+    while(nItems)
+    {
+        nChunk      = (nItems > UINT16_MAX) ? UINT16_MAX : nItems;
+        item.str    = (char*)pData;
+        item.nElems = nChunk;
+        log_input_put(&item);
+
+        nItems -= nChunk;
+        pData  += nChunk * nBytesPerItem;
+        if(nItems)
+            _log_char(' ', color);
+    }
+#else
+    while(nItems--)
+    {
+        _log_var(read_array_item(pData, nBytesPerItem), type, color);
+        pData += nBytesPerItem;
+        if(nItems)                      // Skips separator after last array item
+            _log_char(' ', color);
+    }
+#endif
+}
+
+
+LOG_RAMFUNC void _log_array_stride(const void *pFirst, uint32_t nItems, uint32_t stride, uint8_t nBytesPerItem,
+                                   enum log_data_type type, enum log_color color)
+{
+    uint8_t *pData = (uint8_t*) pFirst;
+#if LOG_BULK_ARRAYS
+    log_fifo_item_t item = {.type = _LOG_ARRAY_STRIDE, .elemType = type, .elemSize = nBytesPerItem};
+    uint32_t nChunk;
+
+    // Only the reference is stored, like _log_array(), in records of up to 255 items. Larger strides
+    // do not fit a record and are logged item by item below.
+    if(stride <= UINT8_MAX)
+    {
+        log_item_set_color(&item, color);
+        item.stride = stride;
+        while(nItems)
+        {
+            nChunk           = (nItems > UINT8_MAX) ? UINT8_MAX : nItems;
+            item.str         = (char*)pData;
+            item.strideElems = nChunk;
+            log_input_put(&item);
+
+            nItems -= nChunk;
+            pData  += nChunk * stride;
+            if(nItems)
+                _log_char(' ', color);
+        }
+        return;
+    }
+#endif
+    while(nItems--)
+    {
+        _log_var(read_array_item(pData, nBytesPerItem), type, color);
+        pData += stride;
+        if(nItems)
+            _log_char(' ', color);
+    }
+}
+
+
+void _log_strcpy(const char *string, uint32_t length, enum log_color color)
+{
+#if LOG_COPY_ARENA_SIZE
+    log_fifo_item_t item = {.type = _LOG_STRING_COPY, .strLen = length};
+
+    log_item_set_color(&item, color);
+
+    if(length <= LOG_CHARS_PER_ITEM)
+        _log_chars(string, length, color);
+    else
+        log_input_put_copy(&item, string, length);
+#else
+    // Without arena the string is stored in the characters of the items, so it can be released after
+    // the call anyway
+    _log_chars(string, length, color);
+#endif
+}
+
+
+void _log_array_copy(const void *pArray, uint32_t nItems, uint8_t nBytesPerItem, enum log_data_type type,
+                     enum log_color color)
+{
+#if LOG_COPY_ARENA_SIZE
+    const uint8_t *pData = (const uint8_t*) pArray;
+    log_fifo_item_t item = {.type = _LOG_ARRAY_COPY, .elemType = type, .elemSize = nBytesPerItem};
+    uint32_t nChunk;
+    uint32_t maxChunk = LOG_COPY_ARENA_SIZE / nBytesPerItem;
+
+    log_item_set_color(&item, color);
+
+    if(maxChunk > UINT16_MAX)
+        maxChunk = UINT16_MAX;
+
+    // Each chunk is copied into the arena within a single reservation
+    while(nItems)
+    {
+        nChunk      = (nItems > maxChunk) ? maxChunk : nItems;
+        item.nElems = nChunk;
+        log_input_put_copy(&item, pData, nChunk * nBytesPerItem);
+
+        nItems -= nChunk;
+        pData  += nChunk * nBytesPerItem;
+        if(nItems)
+            _log_char(' ', color);
+    }
+#else
+    // Without arena each value is stored in its own item, so the array can be modified after the call
+    const uint8_t *pData = (const uint8_t*) pArray;
+
+    while(nItems--)
+    {
+        _log_var(read_array_item((uint8_t*)pData, nBytesPerItem), type, color);
+        pData += nBytesPerItem;
+        if(nItems)
+            _log_char(' ', color);
+    }
+#endif
+}
+
+
+void _log_hexdump(const void *pData, uint32_t length, enum log_color color)
+{
+    log_fifo_item_t item = {.type = _LOG_HEXDUMP, .str = (char*)pData};
+
+    log_item_set_color(&item, color);
+
+    if(length > UINT16_MAX)             // Limited by the width of the length field
+        length = UINT16_MAX;
+    item.strLen = length;
+
+    if(length)
+        log_input_put(&item);
+}
+
+
+#if LOG_COPY_ARENA_SIZE
+void _log_hexdump_copy(const void *pData, uint32_t length, enum log_color color)
+{
+    log_fifo_item_t item = {.type = _LOG_HEXDUMP_COPY};
+
+    log_item_set_color(&item, color);
+
+    // A single reservation has to hold all the bytes
+    if(length > LOG_COPY_ARENA_SIZE)
+        length = LOG_COPY_ARENA_SIZE;
+    item.strLen = length;
+
+    if(length)
+        log_input_put_copy(&item, pData, length);
+}
+#endif
+
+
+#if (LOG_TIMESTAMPS || LOG_CONTEXT_IDS || LOG_SEQUENCE_NUMBERS || LOG_LINE_PREFIX) && !LOG_BINARY_OUTPUT && !LOG_SYSVIEW
+static bool     mIsLineStart = true;
+#endif
+
+
+#if LOG_SEQUENCE_NUMBERS && !LOG_BINARY_OUTPUT
+static uint16_t mNextSeq = 0;
+static uint32_t mSeqLines = LOG_SEQUENCE_TEXT_LINES;    // The first line shows its number
+
+
+// Prints the sequence number of the first item of the line every LOG_SEQUENCE_TEXT_LINES lines, and
+// the one of any item that follows a gap, even in the middle of a line
+static void process_sequence(uint16_t seq, bool isLineStart)
+{
+    bool isGap = (seq != mNextSeq);
+
+    mNextSeq = seq + 1;
+    if(!isGap && (!isLineStart || ++mSeqLines < LOG_SEQUENCE_TEXT_LINES))
+        return;
+
+    mSeqLines = 0;
+    process_string("[#", 2);
+    process_decimal(seq, false);
+    process_string("] ", 2);
+}
+#endif
+
+
+#if LOG_RTC_ANCHOR_MS
+#define LOG_MS_PER_DAY          86400000UL
+
+static TickType_t mRtcAnchorTick = 0;           // xTaskGetTickCount() of the last anchor
+static bool mIsRtcAnchored = false;
+#if !LOG_BINARY_OUTPUT
+static uint32_t mRtcAnchorMs;                   // Time of the day of the anchor
+static uint32_t mRtcAnchorTicks;                // And its LOG_TIMESTAMP_GET()
+#endif
+
+
+static inline uint32_t log_bcd(uint32_t bcd)
+{
+    return (bcd >> 4) * 10 + (bcd & 0x0F);
+}
+
+
+// Days since 1970-01-01 of a date of the Gregorian calendar, the year starting in March so that
+// the leap day is the last one
+static uint32_t log_days_from_civil(uint32_t year, uint32_t month, uint32_t day)
+{
+    uint32_t yearOfEra;
+    uint32_t dayOfYear;
+
+    year -= (month <= 2);
+    yearOfEra = year % 400;
+    dayOfYear = (153 * ((month > 2) ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    return (year / 400) * 146097 + yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear - 719468;
+}
+
+
+// Reads the RTC calendar, in 24 hour format, and returns the LOG_TIMESTAMP_GET() ticks of that
+// instant. Reading SSR locks TR and DR in their shadow registers until DR is read, so all three are
+// from the same second.
+static uint32_t log_rtc_read(uint32_t *pSeconds, uint32_t *pMs)
+{
+    uint32_t ticks = LOG_TIMESTAMP_GET();
+    uint32_t subSeconds = RTC->SSR;
+    uint32_t time = RTC->TR;
+    uint32_t date = RTC->DR;
+    uint32_t prediv = RTC->PRER & 0x7FFF;       // PREDIV_S, from which the subsecond counter counts down
+    uint32_t days = log_days_from_civil(2000 + log_bcd((date >> 16) & 0xFF), log_bcd((date >> 8) & 0x1F),
+                                        log_bcd(date & 0x3F));
+
+    *pSeconds = days * 86400 + log_bcd((time >> 16) & 0x3F) * 3600 + log_bcd((time >> 8) & 0x7F) * 60 +
+                log_bcd(time & 0x7F);
+    *pMs = (subSeconds <= prediv) ? (prediv - subSeconds) * 1000 / (prediv + 1) : 0;
+    return ticks;
+}
+
+
+// Text mode keeps the anchor to date the lines it prints, binary mode logs it for the host
+static void log_rtc_anchor(void)
+{
+    uint32_t seconds;
+    uint32_t ms;
+    uint32_t ticks = log_rtc_read(&seconds, &ms);
+
+#if LOG_BINARY_OUTPUT
+    const log_fmt_arg_t anchor[] = {{"\r\nLog RTC anchor ", strlen("\r\nLog RTC anchor "), _LOG_STRING},
+                                    {NULL, seconds, _LOG_UINT_DEC}, {" s ", strlen(" s "), _LOG_STRING},
+                                    {NULL, ms, _LOG_UINT_DEC}, {" ms\r\n", strlen(" ms\r\n"), _LOG_STRING}};
+
+    (void)ticks;                        // The record has its own timestamp, read right after
+    _log_fmt(anchor, LOG_ARRAY_N_ELEM(anchor), LOG_COLOR_NONE);
+#else
+    mRtcAnchorMs    = (seconds % 86400) * 1000 + ms;
+    mRtcAnchorTicks = ticks;
+#endif
+    mRtcAnchorTick = xTaskGetTickCount();
+    mIsRtcAnchored = true;
+}
+
+
+// Called by the log thread at each wakeup, like the task stats
+static void log_rtc_poll(void)
+{
+    if(!mIsRtcAnchored || xTaskGetTickCount() - mRtcAnchorTick >= pdMS_TO_TICKS(LOG_RTC_ANCHOR_MS))
+        log_rtc_anchor();
+}
+#endif
+
+
+#if LOG_TIMESTAMPS && !LOG_BINARY_OUTPUT && !LOG_SYSVIEW
+#if LOG_RTC_ANCHOR_MS
+static void log_put_digits(char *pText, uint32_t number, uint32_t nDigits)
+{
+    while(nDigits--)
+    {
+        pText[nDigits] = '0' + number % 10;
+        number /= 10;
+    }
+}
+
+
+// Prints the time of the day of the timestamp as "[hh:mm:ss.mmm] ", from the latest RTC anchor.
+// The signed difference with its ticks also dates the items logged before it.
+static void process_timestamp(uint32_t timestamp)
+{
+    char text[] = "[hh:mm:ss.mmm] ";
+    int32_t deltaMs;
+    uint32_t ms;
+
+    if(!mIsRtcAnchored)                 // Flush before the first wakeup of the log thread
+        log_rtc_anchor();
+    deltaMs = (int32_t)(timestamp - mRtcAnchorTicks) / (int32_t)(LOG_TIMESTAMP_HZ / 1000);
+    ms = (mRtcAnchorMs + LOG_MS_PER_DAY + deltaMs) % LOG_MS_PER_DAY;
+
+    log_put_digits(&text[1], ms / 3600000, 2);
+    log_put_digits(&text[4], ms / 60000 % 60, 2);
+    log_put_digits(&text[7], ms / 1000 % 60, 2);
+    log_put_digits(&text[10], ms % 1000, 3);
+    process_string(text, sizeof(text) - 1);
+}
+#else
+static uint32_t mLineTimestamp = 0;
+
+
+// Prints the timestamp ticks elapsed since the previous line started
+static void process_timestamp(uint32_t timestamp)
+{
+    int32_t delta = (int32_t)(timestamp - mLineTimestamp);
+
+    mLineTimestamp = timestamp;
+    process_string((delta < 0) ? "[-" : "[+", 2);
+    process_decimal((delta < 0) ? -(uint32_t)delta : (uint32_t)delta, false);
+    process_string("] ", 2);
+}
+#endif
+#endif
+
+
+#if LOG_CONTEXT_IDS && !LOG_BINARY_OUTPUT
+// Prints the name of the task or ISR that logged the line
+static void process_context(uint8_t ctxId)
+{
+    if(ctxId & LOG_CONTEXT_ID_ISR)
+    {
+        process_string("[ISR ", 5);
+        process_decimal(ctxId & ~LOG_CONTEXT_ID_ISR, false);
+    }
+    else if(ctxId == LOG_CONTEXT_ID_MAIN)
+        process_string("[main", 5);
+    else if(ctxId <= mNContexts)
+    {
+        process_string("[", 1);
+        process_string(mContextNames[ctxId - 1], strlen(mContextNames[ctxId - 1]));
+    }
+    else
+        process_string("[?", 2);
+    process_string("] ", 2);
+}
+#endif
+
+
+#if LOG_LINE_PREFIX
+static const char *const linePrefixes[LOG_LEVEL_DEBUG + 1] = {LOG_PREFIX_NONE, LOG_PREFIX_ERROR, LOG_PREFIX_WARNING,
+                                                              LOG_PREFIX_INFO, LOG_PREFIX_DEBUG};
+static const char levelLetters[LOG_LEVEL_DEBUG + 1] = {'-', 'E', 'W', 'I', 'D'};
+static const char *const levelNames[LOG_LEVEL_DEBUG + 1] = {"NONE", "ERROR", "WARNING", "INFO", "DEBUG"};
+#if LOG_SUPPORT_ANSI_COLOR
+static const enum log_color levelColors[LOG_LEVEL_DEBUG + 1] = {LOG_COLOR_NONE, LOG_COLOR_RED, LOG_COLOR_YELLOW,
+                                                                LOG_COLOR_DEFAULT, LOG_COLOR_CYAN};
+#endif
+static const char *const *mModuleNames = NULL;
+static uint32_t mNModuleNames = 0;
+
+
+static void process_module(uint8_t module)
+{
+    if(module < mNModuleNames && mModuleNames[module])
+        process_string((char*)mModuleNames[module], strlen(mModuleNames[module]));
+    else
+        process_decimal(module, false);
+}
+
+
+// Expands the template of the level of the item, the literal runs are output as they are
+static void process_prefix(const log_fifo_item_t *pItem)
+{
+    const char *pTemplate = linePrefixes[pItem->level];
+    const char *pLiteral;
+
+    while(*pTemplate)
+    {
+        for(pLiteral = pTemplate; *pTemplate && *pTemplate != '%'; pTemplate++)
+            ;
+        if(pTemplate != pLiteral)
+            process_string((char*)pLiteral, pTemplate - pLiteral);
+        if(!*pTemplate || !*++pTemplate)
+            break;
+
+        switch(*pTemplate++)
+        {
+        case 'l':
+            process_string((char*)&levelLetters[pItem->level], 1);
+            break;
+        case 'L':
+            process_string((char*)levelNames[pItem->level], strlen(levelNames[pItem->level]));
+            break;
+        case 'm':
+            process_module(pItem->module);
+            break;
+        case 'M':
+            process_decimal(pItem->module, false);
+            break;
+#if LOG_TIMESTAMPS
+        case 't':
+            process_decimal(pItem->timestamp, false);
+            break;
+#endif
+#if LOG_SUPPORT_ANSI_COLOR
+        case 'c':
+            set_color(levelColors[pItem->level]);
+            break;
+#endif
+        case '%':
+            process_string("%", 1);
+            break;
+        default:                        // Unknown directives are dropped
+            break;
+        }
+    }
+}
+#endif
+
+
+#if !LOG_BINARY_OUTPUT
+// Outputs the pairs of a log_kv() record as "key=value key=value" and ends its line. They were
+// stored with it, so they are the next items of its FIFO.
+static void process_kv(uint32_t nPairs, log_fifo_t *pFifo)
+{
+    log_fifo_item_t item;
+    uint32_t i;
+
+    for(i = 0; i < 2 * nPairs && log_fifo_get(&item, pFifo); i++)
+    {
+#if LOG_CONTEXT_QUOTA
+        log_quota_give(item.ctxId, 1);
+#endif
+#if LOG_SEQUENCE_NUMBERS
+        mNextSeq = item.seq + 1;        // Part of the line of the record, not a gap
+#endif
+        if(i)
+            process_string((i & 1) ? "=" : " ", 1);
+        if(item.type == _LOG_STRING)
+            process_string(item.str, item.strLen);
+        else
+            process_number(item.uData, item.type);
+    }
+    process_string("\r\n", 2);
+}
+
+
+// Formats the item extracted from pFifo, which also holds its copied data
+static void process_item(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+{
+#if LOG_LATENCY
+    log_latency_item(pItem->timestamp);
+#endif
+#if LOG_SUPPORT_ANSI_COLOR
+    set_color(pItem->color);
+#endif
+#if LOG_DEFERRED_STRLEN
+    log_strlen_resolve(pItem);
+#endif
+    if(pItem->type == _LOG_ENUM)
+        log_enum_resolve(pItem);
+    if(pItem->type == _LOG_REF)
+        log_ref_resolve(pItem);
+#if LOG_REGS
+    if(pItem->type == _LOG_REG)
+        log_reg_resolve(pItem);
+#endif
+#if LOG_CUSTOM_TYPES || LOG_PRINTF
+    if(pItem->type == _LOG_CUSTOM)
+        log_custom_resolve(pItem, pFifo);
+#endif
+
+    switch(pItem->type)
+    {
+    case _LOG_STRING:
+        process_string(pItem->str, pItem->strLen);
+        break;
+    case LOG_CHAR:
+        process_string(pItem->chr, pItem->nChars);
+        break;
+#if LOG_BULK_ARRAYS
+    case _LOG_ARRAY:
+        process_array_record((uint8_t*)pItem->str, pItem->nElems, pItem->elemSize, pItem->elemSize, pItem->elemType);
+        break;
+    case _LOG_ARRAY_STRIDE:
+        process_array_record((uint8_t*)pItem->str, pItem->strideElems, pItem->elemSize, pItem->stride, pItem->elemType);
+        break;
+#endif
+#if LOG_COPY_ARENA_SIZE
+    case _LOG_STRING_COPY:
+        process_string((char*)log_arena_ptr(pFifo, pItem->arenaIdx), pItem->strLen);
+        log_arena_release(pFifo, pItem->arenaIdx + pItem->strLen);
+        break;
+    case _LOG_ARRAY_COPY:
+        process_array(log_arena_ptr(pFifo, pItem->arenaIdx), pItem->nElems, pItem->elemSize, pItem->elemSize,
+                      pItem->elemType);
+        log_arena_release(pFifo, pItem->arenaIdx + pItem->nElems * pItem->elemSize);
+        break;
+    case _LOG_HEXDUMP_COPY:
+        process_hexdump(log_arena_ptr(pFifo, pItem->arenaIdx), pItem->strLen);
+        log_arena_release(pFifo, pItem->arenaIdx + pItem->strLen);
+        break;
+#endif
+    case _LOG_HEXDUMP:
+        process_hexdump((uint8_t*)pItem->str, pItem->strLen);
+        break;
+#if LOG_64BIT_NUMBERS
+    case _LOG_HEX_8:
+    case _LOG_UINT_DEC_8:
+    case _LOG_INT_DEC_8:
+        process_number64(pItem->uData, pItem->uDataHi, pItem->type);
+        break;
+#endif
+    case _LOG_FIXED:
+        process_fixed_number(pItem->uData, pItem->fracBits, pItem->nDecimals);
+        break;
+    case _LOG_FLOAT:
+        process_float(pItem->uData, pItem->nDecimals);
+        break;
+    case _LOG_LOCATION:
+        process_location(pItem->uData);
+        break;
+    case _LOG_KV:
+        process_kv(pItem->uData, pFifo);
+        break;
+#if LOG_SYSVIEW && LOG_RTOS_TRACE
+    case _LOG_TRACE:
+        sysview_trace(pItem);
+        break;
+#endif
+    default:
+        process_number(pItem->uData, pItem->type);
+    }
+}
+#endif
+
+#if LOG_INSTANCES
+// Each instance goes through the same formatting, only its own handler gets the output. Returns
+// the number of items left of maxItems.
+static uint32_t log_ctx_flush(uint32_t maxItems)
+{
+    log_out_handler printHandler = mPrintHandler;
+    log_fifo_item_t item;
+    log_ctx_t *pCtx;
+
+#if LOG_N_BACKENDS > 1
+    mOutLevelBit = 0;                   // None of the log_add_backend() ones
+#endif
+    for(pCtx = mInstances; pCtx; pCtx = pCtx->pNext)
+    {
+        mPrintHandler = pCtx->printHandler;
+#if LOG_COLOR_ON_CHANGE && LOG_SUPPORT_ANSI_COLOR
+        mLastColor = _LOG_COLOR_LEN;    // Each output starts with its color
+#endif
+        while(maxItems && log_fifo_get(&item, LOG_CTX_FIFO(pCtx)))
+        {
+            process_item(&item, LOG_CTX_FIFO(pCtx));
+            maxItems--;
+        }
+#if LOG_RENDER_BUFFER_SIZE
+        render_flush();
+#endif
+    }
+    mPrintHandler = printHandler;
+#if LOG_COLOR_ON_CHANGE && LOG_SUPPORT_ANSI_COLOR
+    mLastColor = _LOG_COLOR_LEN;
+#endif
+#if LOG_N_BACKENDS > 1
+    mOutLevelBit = UINT32_MAX;
+#endif
+    return maxItems;
+}
+#endif
+
+
+// Checks if the backend can take more output, public flushes make it drain instead of stopping
+static bool log_output_ready(bool isPublicCall)
+{
+    if(!mReadyHandler || mReadyHandler())
+        return true;
+    if(!isPublicCall)
+        return false;
+
+#if LOG_RENDER_BUFFER_SIZE
+    render_flush();
+#endif
+    if(mFlushHandler)
+        mFlushHandler();
+    return true;
+}
+
+
+// Outputs up to maxItems items of the input FIFOs, those of the instances first. Returns the number
+// of items left of maxItems, 0 if there may be more to output.
+static uint32_t log_flush_items(bool isPublicCall, uint32_t maxItems)
+{
+    log_fifo_item_t item;
+    log_fifo_t *pFifo;
+#if LOG_STATS
+    uint32_t flushStart = LOG_TIMESTAMP_GET();
+    uint32_t flushTicks;
+#endif
+
+    LOG_PROBE_HIGH(LOG_PROBE_FLUSH_PIN);
+#if LOG_DEDUP
+    if(isPublicCall)
+        log_dedup_flush();
+#endif
+#if LOG_INSTANCES
+    maxItems = log_ctx_flush(maxItems);
+#endif
+#if LOG_N_BACKENDS > 1
+    mOutLevelBit = UINT32_MAX;
+#endif
+#if LOG_BINARY_OUTPUT
+    if(!LOG_ARRAY_IS_PENDING() && log_input_is_full())
+    {
+        uint8_t tag = LOG_BINARY_FIFO_FULL;
+        process_string((char*)&tag, 1);
+    }
+
+    while(maxItems && log_output_ready(isPublicCall) && (LOG_ARRAY_IS_PENDING() || (pFifo = log_input_get(&item)) != NULL))
+    {
+        maxItems--;
+#if LOG_ARRAY_CHUNK_ELEMS
+        if(LOG_ARRAY_IS_PENDING())
+        {
+            process_array_chunk();
+            continue;
+        }
+#endif
+#if LOG_BUFFER_REFS
+        if(log_buffer_release(&item))
+            continue;
+#endif
+#if LOG_N_BACKENDS > 1
+        backends_select(&item);
+#endif
+        binary_process_item(&item, pFifo);
+    }
+#else
+    if(!LOG_ARRAY_IS_PENDING() && log_input_is_full())
+        process_string("\r\nLog input FIFO full\r\n", strlen("\r\nLog input FIFO full\r\n"));
+
+    while(maxItems && log_output_ready(isPublicCall) && (LOG_ARRAY_IS_PENDING() || (pFifo = log_input_get(&item)) != NULL))
+    {
+        maxItems--;
+#if LOG_ARRAY_CHUNK_ELEMS
+        if(LOG_ARRAY_IS_PENDING())      // Rest of the array being output, it is already in its line
+        {
+            process_array_chunk();
+            continue;
+        }
+#endif
+#if LOG_CONTEXT_QUOTA
+        log_quota_give(item.ctxId, 1);
+#endif
+#if LOG_BUFFER_REFS
+        if(log_buffer_release(&item))
+            continue;
+#endif
+#if LOG_N_BACKENDS > 1
+        backends_select(&item);
+#endif
+#if LOG_ERROR_FIFO_N_ELEM && !LOG_BINARY_OUTPUT
+        urgent_select(pFifo);
+#endif
+#if LOG_SYSVIEW
+        mSysviewTicks = item.timestamp;
+#elif LOG_TIMESTAMPS || LOG_CONTEXT_IDS || LOG_SEQUENCE_NUMBERS || LOG_LINE_PREFIX
+        bool isLineEnd = log_item_ends_line(&item, pFifo);
+
+#if LOG_SEQUENCE_NUMBERS
+        process_sequence(item.seq, mIsLineStart);
+#endif
+        if(mIsLineStart)
+        {
+#if LOG_TIMESTAMPS
+            process_timestamp(item.timestamp);
+#endif
+#if LOG_CONTEXT_IDS
+            process_context(item.ctxId);
+#endif
+#if LOG_LINE_PREFIX
+            process_prefix(&item);
+#endif
+        }
+        mIsLineStart = isLineEnd;
+#endif
+        process_item(&item, pFifo);
+    }
+#endif
+
+#if LOG_RENDER_BUFFER_SIZE
+    render_flush();
+#endif
+#if LOG_ERROR_FIFO_N_ELEM && !LOG_BINARY_OUTPUT
+    mIsUrgentOutput = false;
+#endif
+#if LOG_N_BACKENDS > 1
+    backends_flush(isPublicCall);
+#endif
+#if LOG_STATS
+    flushTicks = LOG_TIMESTAMP_GET() - flushStart;
+    if(flushTicks > mStats.maxFlushTicks)
+        mStats.maxFlushTicks = flushTicks;
+    mStats.flushTicks += flushTicks;
+#endif
+    if(isPublicCall && mFlushHandler)
+        mFlushHandler();
+    LOG_PROBE_LOW(LOG_PROBE_FLUSH_PIN);
+    return maxItems;
+}
+
+
+#if LOG_DELEGATED_FLUSH
+// Has the log thread do the flush and sleeps until it is done. Returns false if the caller must do it
+// itself: there is no scheduler, it is the log thread, an ISR or runs with the interrupts masked.
+static bool log_flush_delegate(void)
+{
+    TaskHandle_t task;
+    uint32_t primaskBit;
+    bool isQueued = false;
+
+    if(__get_PRIMASK() || __get_IPSR() || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING || !mLogTask)
+        return false;
+    task = xTaskGetCurrentTaskHandle();
+    if(task == mLogTask)
+        return false;
+
+    while(!isQueued)                    // A single request at a time, the others wait for their turn
+    {
+        LOG_ENTER_CRITICAL(primaskBit);
+        if(!mFlushTask)
+        {
+            mFlushTask = task;
+            isQueued = true;
+        }
+        LOG_EXIT_CRITICAL(primaskBit);
+        if(!isQueued)
+            vTaskDelay(1);
+    }
+
+    log_thread_notify();
+    xSemaphoreTake(mFlushDone, portMAX_DELAY);  // Not the notification of the task, it is the application's
+    return true;
+}
+#endif
+
+
+void _log_flush(bool isPublicCall)
+{
+#if LOG_DELEGATED_FLUSH
+    if(isPublicCall && log_flush_delegate())
+        return;
+#endif
+    log_flush_items(isPublicCall, UINT32_MAX);
+}
+
+
+// Sends the output that the backend buffered, for backends that do not have a thread to do it
+static inline void log_drain_backend(void)
+{
+#if LOG_DRAIN_BACKEND
+    if(mFlushHandler)
+        mFlushHandler();
+#endif
+}
+
+
+// Processes the whole input FIFO through panicHandler in the calling context. It makes no RTOS call
+// and does not need interrupts, so it can be used from fault handlers. The handlers of log_init() and
+// log_set_ready_handler() are not used anymore, the system is expected to halt or reset after it.
+void log_panic_flush(log_out_handler panicHandler)
+{
+    mPrintHandler = panicHandler;
+    mFlushHandler = NULL;
+    mReadyHandler = NULL;
+#if LOG_ERROR_FIFO_N_ELEM && !LOG_BINARY_OUTPUT
+    mUrgentHandler = NULL;
+#endif
+#if LOG_N_BACKENDS > 1
+    mNumBackends = 0;
+#endif
+#if LOG_INSTANCES
+    mInstances = NULL;                  // Their handlers may not work anymore
+#endif
+#if LOG_DEDUP
+    log_dedup_flush();
+#endif
+    _log_flush(false);
+}
+
+
+#if LOG_BOOT_MARKS
+// Processes the whole input FIFO through pollHandler in the calling context, like log_panic_flush(),
+// then puts the handlers back. It is meant for the boot logs before the scheduler starts, with a
+// handler that polls a peripheral the backend of log_init() is not using yet.
+void log_boot_flush(log_out_handler pollHandler)
+{
+    log_out_handler printHandler = mPrintHandler;
+    log_out_flush_handler flushHandler = mFlushHandler;
+    log_out_ready_handler readyHandler = mReadyHandler;
+#if LOG_ERROR_FIFO_N_ELEM && !LOG_BINARY_OUTPUT
+    log_out_handler urgentHandler = mUrgentHandler;
+#endif
+#if LOG_N_BACKENDS > 1
+    uint32_t nBackends = mNumBackends;
+#endif
+
+    mPrintHandler = pollHandler;
+    mFlushHandler = NULL;
+    mReadyHandler = NULL;
+#if LOG_ERROR_FIFO_N_ELEM && !LOG_BINARY_OUTPUT
+    mUrgentHandler = NULL;
+#endif
+#if LOG_N_BACKENDS > 1
+    mNumBackends = 0;
+#endif
+    _log_flush(false);
+    mPrintHandler = printHandler;
+    mFlushHandler = flushHandler;
+    mReadyHandler = readyHandler;
+#if LOG_ERROR_FIFO_N_ELEM && !LOG_BINARY_OUTPUT
+    mUrgentHandler = urgentHandler;
+#endif
+#if LOG_N_BACKENDS > 1
+    mNumBackends = nBackends;
+#endif
+}
+
+
+// Microseconds since HAL_Init(), from the 1 ms ticks of the HAL time base and its 1 MHz counter
+static uint32_t log_boot_us(void)
+{
+    uint32_t ticks;
+    uint32_t count;
+    uint32_t us;
+
+    do
+    {
+        ticks = HAL_GetTick();
+        count = LOG_BOOT_TIMEBASE->CNT;
+        us = ticks * 1000 + count;
+        if((LOG_BOOT_TIMEBASE->SR & TIM_SR_UIF) && count < 500)
+            us += 1000;                 // Wrapped with the interrupts masked, the tick is not counted yet
+    } while(ticks != HAL_GetTick());
+    return us;
+}
+
+
+void _log_boot_mark(const char *pName)
+{
+    uint32_t now = log_boot_us();
+    const log_fmt_arg_t mark[] = {{"Boot ", strlen("Boot "), _LOG_STRING}, {pName, strlen(pName), _LOG_STRING},
+                                  {" at ", strlen(" at "), _LOG_STRING}, {NULL, now, _LOG_UINT_DEC},
+                                  {" us, +", strlen(" us, +"), _LOG_STRING}, {NULL, now - mBootMarkUs, _LOG_UINT_DEC},
+                                  {" us\r\n", strlen(" us\r\n"), _LOG_STRING}};
+
+    mBootMarkUs = now;
+    _log_fmt(mark, LOG_ARRAY_N_ELEM(mark), LOG_COLOR_NONE);
+}
+#endif
+
+
+#if LOG_BENCH
+uint32_t _log_bench_irq_off_max(void)
+{
+    uint32_t irqOffMax = mBenchIrqOffMax;
+
+    mBenchIrqOffMax = 0;
+    return irqOffMax;
+}
+#endif
+
+
+#if LOG_STATS
+void log_get_stats(log_stats_t *pStats)
+{
+    uint32_t primaskBit;
+
+    LOG_ENTER_CRITICAL(primaskBit);
+    *pStats = mStats;
+    LOG_EXIT_CRITICAL(primaskBit);
+}
+#endif
+
+
+// Called by a log_*_ratelimited() call site once its window has expired, the call is stored
+bool _log_ratelimit_restart(log_ratelimit_t *pWindow)
+{
+#if LOG_STATS
+    uint32_t primaskBit;
+
+    if(pWindow->nSuppressed)
+    {
+        LOG_ENTER_CRITICAL(primaskBit);
+        mStats.nRateLimited += pWindow->nSuppressed;
+        LOG_EXIT_CRITICAL(primaskBit);
+        pWindow->nSuppressed = 0;
+    }
+#endif
+    pWindow->start  = LOG_RATELIMIT_MS_GET();
+    pWindow->nCalls = 1;
+    return true;
+}
+
+
+#if LOG_RUNTIME_LEVELS
+#if LOG_GOVERNOR
+static uint32_t             mLevelModules[LOG_LEVEL_DEBUG + 1] = { [0 ... LOG_LEVEL_DEBUG] = 0xFFFFFFFFUL };
+static uint32_t             mGovernorLevel = LOG_LEVEL_DEBUG;   // Highest level the governor lets through
+static uint32_t             mGovernorCalmLoops = 0;
+#define LOG_LEVEL_MODULES           mLevelModules       // The ones of log_set_module_level(), before the governor
+#else
+#define LOG_LEVEL_MODULES           _logLevelModules
+#endif
+
+
+#if LOG_GOVERNOR
+// Copies the module masks up to the governor level to the ones checked by the log calls, with the
+// interrupts masked
+static void log_governor_apply(void)
+{
+    uint32_t i;
+
+    for(i = LOG_LEVEL_ERROR; i <= LOG_LEVEL_DEBUG; i++)
+        _logLevelModules[i] = (i <= mGovernorLevel) ? mLevelModules[i] : 0;
+}
+#endif
+
+
+// Logs of the module at a level up to the given one are kept, LOG_LEVEL_OFF filters all of them
+void log_set_module_level(uint32_t module, uint32_t level)
+{
+    uint32_t primaskBit;
+    uint32_t i;
+
+    if(module > 31)
+        return;
+
+    LOG_MASK_SAVE(primaskBit);
+    for(i = LOG_LEVEL_ERROR; i <= LOG_LEVEL_DEBUG; i++)
+    {
+        if(i <= level)
+            LOG_LEVEL_MODULES[i] |= 1UL << module;
+        else
+            LOG_LEVEL_MODULES[i] &= ~(1UL << module);
+    }
+#if LOG_GOVERNOR
+    log_governor_apply();
+#endif
+    LOG_MASK_RESTORE(primaskBit);
+}
+
+
+uint32_t log_get_module_level(uint32_t module)
 {
-    union
-    {
-        uint32_t uData;
-        int32_t  sData;
-        char *   str;
-        char     chr[4];
-    };
-    union
-    {
-        uint16_t strLen;
-        uint8_t  nChars;
-    };
-    enum log_data_type type;
-#if LOG_SUPPORT_ANSI_COLOR
-    enum log_color     color;
-#endif
-} log_fifo_item_t;
+    uint32_t level = LOG_LEVEL_DEBUG;
+
+    if(module > 31)
+        return LOG_LEVEL_OFF;
+
+    while(level != LOG_LEVEL_OFF && !(LOG_LEVEL_MODULES[level] & (1UL << module)))
+        level--;
+    return level;
+}
 
 
-typedef struct log_fifo_s
+#if LOG_GOVERNOR
+static void log_governor_mark(uint32_t level)
 {
-    log_fifo_item_t buffer[LOG_INPUT_FIFO_N_ELEM];
-    uint32_t wrIdx;
-    uint32_t rdIdx;
-    uint32_t nItems;
-} log_fifo_t;
+    const log_fmt_arg_t marker[] = {{"\r\nLog governor level ", strlen("\r\nLog governor level "), _LOG_STRING},
+                                    {NULL, level, _LOG_UINT_DEC}, {"\r\n", 2, _LOG_STRING}};
 
+    _log_fmt(marker, LOG_ARRAY_N_ELEM(marker), LOG_COLOR_NONE);
+}
 
 
-static log_fifo_t            logFifo;
-static log_out_handler       mPrintHandler = NULL;
-static log_out_flush_handler mFlushHandler = NULL;
+// Lowers the runtime level by one when the input FIFOs fill up while the backend throttles the output
+// or the log thread is busy, and raises it back by one after LOG_GOVERNOR_CALM_LOOPS calm loops. A
+// line marks each change in the output.
+static void log_governor_update(bool isFilling, bool isCalm, uint32_t flushTicks)
+{
+    bool isBusy = (mReadyHandler && !mReadyHandler()) || flushTicks >= LOG_GOVERNOR_BUSY_TICKS;
+    uint32_t level = mGovernorLevel;
+    uint32_t primaskBit;
 
+    if(isFilling && isBusy && level > LOG_GOVERNOR_MIN_LEVEL)
+        level--;
+    else if(!isCalm)
+        mGovernorCalmLoops = 0;
+    else if(level < LOG_LEVEL_DEBUG && ++mGovernorCalmLoops >= LOG_GOVERNOR_CALM_LOOPS)
+        level++;
+    if(level == mGovernorLevel)
+        return;
+
+    mGovernorCalmLoops = 0;
+    LOG_MASK_SAVE(primaskBit);
+    mGovernorLevel = level;
+    log_governor_apply();
+    LOG_MASK_RESTORE(primaskBit);
+    log_governor_mark(level);
+}
+#endif
+#endif
 
 
-static inline void log_fifo_put(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+#if LOG_FLIGHT_RECORDER
+// Keeps the last LOG_TRIGGER_PRE_ITEMS, and the output starts once LOG_TRIGGER_POST_ITEMS more have
+// been stored. Can be called from any task or ISR, it is ignored while a capture is pending.
+void log_trigger(void)
 {
     uint32_t primaskBit;
 
-    primaskBit = __get_PRIMASK();
-    __disable_irq();
-
-    if(pFifo->nItems < LOG_ARRAY_N_ELEM(pFifo->buffer))
+    LOG_ENTER_CRITICAL(primaskBit);
+    if(mRecorderState == LOG_RECORDER_RECORDING)
     {
-        pFifo->buffer[pFifo->wrIdx++] = *pItem;
-        pFifo->wrIdx &= LOG_INPUT_FIFO_N_ELEM - 1;
-        pFifo->nItems++;
+        log_fifo_trim(&logFifo, LOG_TRIGGER_PRE_ITEMS);
+        mRecorderPostLeft = LOG_TRIGGER_POST_ITEMS;
+        mRecorderState    = LOG_TRIGGER_POST_ITEMS ? LOG_RECORDER_POST_TRIGGER : LOG_RECORDER_CAPTURED;
     }
+    LOG_EXIT_CRITICAL(primaskBit);
 
-    __set_PRIMASK(primaskBit);
+    log_input_wakeup(&logFifo);
 }
+#endif
 
 
-static inline bool log_fifo_get(log_fifo_item_t *pItem, log_fifo_t *pFifo)
+#if _LOG_COMMANDS
+// Parses the nValues decimal numbers that follow the command word, separated by spaces. Returns false
+// if the line is another command or if its arguments are not exactly nValues numbers.
+static bool log_command_args(const char *pLine, uint32_t length, const char *command, uint32_t *pValues,
+                             uint32_t nValues)
 {
-    bool retVal = false;
-    uint32_t primaskBit;
+    uint32_t i = strlen(command);
+    uint32_t n;
 
-    primaskBit = __get_PRIMASK();
-    __disable_irq();
+    if(length < i || memcmp(pLine, command, i) || (i < length && pLine[i] != ' '))
+        return false;
+    while(i < length && pLine[i] == ' ')
+        i++;
 
-    if(pFifo->nItems)
+    for(n = 0; n < nValues; n++)
     {
-        *pItem = pFifo->buffer[pFifo->rdIdx++];
-        pFifo->rdIdx &= LOG_INPUT_FIFO_N_ELEM - 1;
-        pFifo->nItems--;
-        retVal = true;
+        if(i >= length || pLine[i] < '0' || pLine[i] > '9')
+            return false;
+        pValues[n] = 0;
+        while(i < length && pLine[i] >= '0' && pLine[i] <= '9')
+            pValues[n] = pValues[n] * 10 + (pLine[i++] - '0');
+        while(i < length && pLine[i] == ' ')
+            i++;
     }
-
-    __set_PRIMASK(primaskBit);
-    return retVal;
+    return i == length;
 }
 
 
-static void log_fifo_reset(log_fifo_t *pFifo)
+#if LOG_STATS
+// Logs the counters of log_get_stats() on one line
+static void log_stats_command(void)
 {
-    pFifo->rdIdx  = 0;
-    pFifo->wrIdx  = 0;
-    pFifo->nItems = 0;
+    static const char * const names[] = {"Log stats: enqueued ", " dropped ", " high water ", " bytes out ",
+                                         " max flush ", " rate limited ",
+#if LOG_CPU_BUDGET_PERCENT
+                                         " budget shed ",
+#endif
+                                        };
+    log_stats_t stats;
+    uint32_t values[LOG_ARRAY_N_ELEM(names)];
+    uint32_t i;
+
+    log_get_stats(&stats);
+    values[0] = stats.nEnqueued;
+    values[1] = stats.nDropped;
+    values[2] = stats.highWater;
+    values[3] = stats.nBytesOut;
+    values[4] = stats.maxFlushTicks;
+    values[5] = stats.nRateLimited;
+#if LOG_CPU_BUDGET_PERCENT
+    values[6] = stats.nBudgetShed;
+#endif
+    for(i = 0; i < LOG_ARRAY_N_ELEM(names); i++)
+    {
+        _log_str((char*)names[i], strlen(names[i]), LOG_COLOR_NONE);
+        _log_var(values[i], _LOG_UINT_DEC, LOG_COLOR_NONE);
+    }
+    _log_str("\r\n", 2, LOG_COLOR_NONE);
+#if LOG_LATENCY
+    _log_str("Log latency handoff", strlen("Log latency handoff"), LOG_COLOR_NONE);
+    for(i = 0; i < LOG_LATENCY_N_BINS; i++)
+    {
+        _log_char(' ', LOG_COLOR_NONE);
+        _log_var(stats.latencyHandoff[i], _LOG_UINT_DEC, LOG_COLOR_NONE);
+    }
+    _log_str("\r\nLog latency wire", strlen("\r\nLog latency wire"), LOG_COLOR_NONE);
+    for(i = 0; i < LOG_LATENCY_N_BINS; i++)
+    {
+        _log_char(' ', LOG_COLOR_NONE);
+        _log_var(stats.latencyWire[i], _LOG_UINT_DEC, LOG_COLOR_NONE);
+    }
+    _log_str("\r\n", 2, LOG_COLOR_NONE);
+#endif
 }
+#endif
 
 
-static void process_string(char *string, uint32_t length)
+#if LOG_TIME_SYNC
+// Answers a beacon of the host with the ticks it arrived at, log_decode.py --sync maps them to the
+// host time it sent the beacon at
+static void log_sync_command(uint32_t beacon)
 {
-    if(mPrintHandler)
-        mPrintHandler(string, length);
+    const log_fmt_arg_t reply[] = {{"\r\nLog sync node ", strlen("\r\nLog sync node "), _LOG_STRING},
+                                   {NULL, LOG_NODE_ID, _LOG_UINT_DEC}, {" beacon ", strlen(" beacon "), _LOG_STRING},
+                                   {NULL, beacon, _LOG_UINT_DEC}, {" ticks ", strlen(" ticks "), _LOG_STRING},
+                                   {NULL, LOG_TIMESTAMP_GET(), _LOG_UINT_DEC}, {"\r\n", 2, _LOG_STRING}};
+
+    _log_fmt(reply, LOG_ARRAY_N_ELEM(reply), LOG_COLOR_NONE);
 }
+#endif
 
 
-#if LOG_SUPPORT_ANSI_COLOR
-static void set_color(enum log_color color)
+// Handles the lines of the host, usually received by the UART interrupt, anything unknown is ignored:
+// - "loglevel <module> <level>" sets the level of a module (LOG_RUNTIME_LEVELS)
+// - "logdump" triggers the flight recorder (LOG_FLIGHT_RECORDER)
+// - "logstats" logs the stats now (LOG_STATS) and has the log thread dump the profiler (LOG_PROF)
+// - "logwatch <index> <ms>" changes the sampling period of a watched variable (LOG_WATCH)
+// - "logsync <beacon>" answers a time sync beacon (LOG_TIME_SYNC)
+// - "loghistory" has the log thread replay the recent output (LOG_HISTORY_SIZE)
+// - "logtasks" has the log thread log the state of each task (LOG_TASK_SNAPSHOT)
+void log_command(char *pLine, uint32_t length)
 {
-    if(color != LOG_COLOR_NONE)
-    {
-        char str[5] = LOG_ANSI_PREFIX;
+    uint32_t values[2];
 
-        str[2] = ansiColors[color][0];
-        if(color != LOG_COLOR_DEFAULT)
-        {
-            str[3] = ansiColors[color][1];
-            str[4] = LOG_ANSI_SUFFIX;
-            process_string(str, 5);
-        }
-        else
-        {
-            str[3] = LOG_ANSI_SUFFIX;
-            process_string(str, 4);
-        }
+#if LOG_FLIGHT_RECORDER
+    if(log_command_args(pLine, length, "logdump", values, 0))
+        log_trigger();
+#endif
+#if LOG_RUNTIME_LEVELS
+    if(log_command_args(pLine, length, "loglevel", values, 2) && values[1] <= LOG_LEVEL_DEBUG)
+        log_set_module_level(values[0], values[1]);
+#endif
+#if LOG_STATS || LOG_PROF
+    if(log_command_args(pLine, length, "logstats", values, 0))
+    {
+#if LOG_STATS
+        log_stats_command();
+#endif
+#if LOG_PROF
+        log_prof_request_dump();
+#endif
     }
+#endif
+#if LOG_WATCH
+    if(log_command_args(pLine, length, "logwatch", values, 2))
+        log_watch_set_period(values[0], values[1]);
+#endif
+#if LOG_TIME_SYNC
+    if(log_command_args(pLine, length, "logsync", values, 1))
+        log_sync_command(values[0]);
+#endif
+#if LOG_HISTORY_SIZE
+    if(log_command_args(pLine, length, "loghistory", values, 0))
+        log_history_replay();
+#endif
+#if LOG_TASK_SNAPSHOT
+    if(log_command_args(pLine, length, "logtasks", values, 0))
+        log_task_snapshot();
+#endif
 }
 #endif
 
 
-static void process_hexadecimal(uint32_t number, uint8_t nDigits)
+#if LOG_DELEGATED_FLUSH
+// Does the flush of a task waiting in log_flush(), including the backend one, and wakes it up
+static void log_thread_serve_flush(void)
 {
-    const char hexVals[16] = {'0','1','2','3','4','5','6','7',
-                              '8','9','A','B','C','D','E','F'};
-    char output[8];
-    int8_t i;
+    if(!mFlushTask)
+        return;
 
-    // Fill char array starting at the end
-    for(i = nDigits-1 ; i > -1; i--)
+    log_flush_items(true, UINT32_MAX);
+    mFlushTask = NULL;
+    xSemaphoreGive(mFlushDone);
+}
+#endif
+
+
+#if !LOG_FLIGHT_RECORDER
+// Gives the log thread its priority back once it has drained the input FIFOs below the watermark
+static inline void log_thread_unboost(void)
+{
+#if LOG_BOOST_FILL_PERCENT
+    if(mIsBoosted && log_input_is_below(LOG_BOOST_RESTORE_PERCENT))
     {
-        output[i] = hexVals[number & 0x0F];
-        number >>= 4;
+        vTaskPrioritySet(NULL, mLogPriority);
+        mIsBoosted = false;             // Cleared once restored, a new crossing is never missed
     }
-
-    process_string(output, nDigits);
+#endif
 }
 
 
-static void process_decimal(uint32_t number, bool isNegative)
+#if LOG_CPU_BUDGET_PERCENT
+// Adds LOG_CPU_BUDGET_PERCENT of the time elapsed since the last refill to the credit of the log
+// thread, up to the budget of one window
+static void log_budget_refill(void)
 {
-    char output[11];
-    uint32_t divider = 1000000000UL;
-    uint8_t i = 0;
+    uint32_t now = LOG_TIMESTAMP_GET();
+    uint32_t elapsed = now - mBudgetLast;
 
-    if(isNegative)
-        output[i++] = '-';
+    mBudgetLast = now;
+    if(elapsed >= LOG_CPU_BUDGET_WINDOW_TICKS)
+        mBudgetCredit = LOG_CPU_BUDGET_TICKS;
+    else
+        mBudgetCredit += (int32_t)(elapsed * LOG_CPU_BUDGET_PERCENT / 100);
+    if(mBudgetCredit > LOG_CPU_BUDGET_TICKS)
+        mBudgetCredit = LOG_CPU_BUDGET_TICKS;
+    mIsOverBudget = (mBudgetCredit <= 0);
+}
 
-    while(number < divider)
-        divider /= 10;
 
-    while(divider >= 10)
+// Processes the input FIFOs in passes of LOG_CPU_BUDGET_PASS_ITEMS while the log thread has credit
+// left, each pass is paid with the ticks it took. What does not fit waits for the next loops.
+static void log_budget_flush(void)
+{
+    uint32_t start;
+    bool isDone = false;
+
+    log_budget_refill();
+    while(!mIsOverBudget && !isDone)
     {
-        output[i++] = 0x30 + number/divider;
-        number %= divider;
-        divider /= 10;
+        start = LOG_TIMESTAMP_GET();
+        isDone = (log_flush_items(false, LOG_CPU_BUDGET_PASS_ITEMS) != 0);
+        log_drain_backend();
+        log_thread_unboost();
+        log_overflow_release();
+        mBudgetCredit -= (int32_t)(LOG_TIMESTAMP_GET() - start);
+        log_budget_refill();
+#if LOG_FLUSH_BUDGET_ITEMS
+        if(!isDone)
+            osThreadYield();
+#endif
     }
+}
+#endif
 
-    output[i++] = 0x30 + number;
-    process_string(output, i);
+
+// Processes the input FIFOs in passes of LOG_FLUSH_BUDGET_ITEMS, the tasks of the same priority run
+// between them, so the logger never keeps them waiting longer than one pass
+static void log_thread_flush(void)
+{
+#if LOG_GOVERNOR
+    bool isFilling = !log_input_is_below(LOG_GOVERNOR_HIGH_PERCENT);
+    bool isCalm = log_input_is_below(LOG_GOVERNOR_LOW_PERCENT);
+    uint32_t flushStart = LOG_TIMESTAMP_GET();
+#endif
+
+#if LOG_CPU_BUDGET_PERCENT
+    log_budget_flush();
+#elif LOG_FLUSH_BUDGET_ITEMS
+    while(!log_flush_items(false, LOG_FLUSH_BUDGET_ITEMS))
+    {
+        log_drain_backend();
+        log_thread_unboost();
+        log_overflow_release();
+        osThreadYield();
+    }
+#else
+    _log_flush(false);
+#endif
+    log_drain_backend();
+    log_thread_unboost();
+    log_overflow_release();
+#if LOG_GOVERNOR
+    log_governor_update(isFilling, isCalm, LOG_TIMESTAMP_GET() - flushStart);
+#endif
 }
+#endif
 
 
-void _log_var(uint32_t number, enum log_data_type type, enum log_color color)
+void log_thread(void const * argument)
 {
-    log_fifo_item_t item = {.type = type, .uData = number};
+#if LOG_BOOST_FILL_PERCENT
+    mLogPriority = uxTaskPriorityGet(NULL);
+#endif
+#if LOG_THREAD_WAKEUP || LOG_FLIGHT_RECORDER || LOG_BOOST_FILL_PERCENT || LOG_DELEGATED_FLUSH || LOG_OVERFLOW_BLOCK
+    mLogTask = xTaskGetCurrentTaskHandle();
+#endif
 
-#if LOG_SUPPORT_ANSI_COLOR
-        item.color = color;
+    while(1)
+    {
+#if LOG_TASK_STATS || LOG_STACK_STATS
+        log_task_stats_poll();
+#endif
+#if LOG_TASK_SNAPSHOT
+        log_task_snapshot_poll();
+#endif
+#if LOG_RTC_ANCHOR_MS
+        log_rtc_poll();
+#endif
+#if LOG_PROF
+        _log_prof_poll();
+#endif
+#if LOG_METRICS
+        _log_metric_poll();
+#endif
+#if LOG_WATCH
+        _log_watch_poll();
+#endif
+#if LOG_QUEUE_MONITOR
+        _log_queue_poll();
+#endif
+#if LOG_HISTORY_SIZE
+        log_history_poll();
+#endif
+#if LOG_FLIGHT_RECORDER
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);    // Only recording until a capture is complete
+        if(mRecorderState != LOG_RECORDER_OUTPUT)
+            continue;
+
+        _log_flush(false);
+        while(!log_input_is_empty() || LOG_ARRAY_IS_PENDING())
+        {
+            osDelay(LOG_DELAY_LOOPS_MS);
+            _log_flush(false);
+        }
+        mRecorderState = LOG_RECORDER_RECORDING;
+#elif LOG_THREAD_WAKEUP || LOG_DELEGATED_FLUSH || LOG_OVERFLOW_BLOCK
+#if LOG_THREAD_WAKEUP
+        mIsWakeupPending = false;       // Rearmed before flushing so no crossing is missed
+#endif
+        log_thread_flush();
+#if LOG_DELEGATED_FLUSH
+        log_thread_serve_flush();
+#endif
+#if LOG_LOW_POWER
+        // Polls only while the backend throttles the output, a new item wakes it up otherwise
+        ulTaskNotifyTake(pdTRUE, (log_input_is_empty() && !LOG_ARRAY_IS_PENDING()) ? portMAX_DELAY :
+                                                                                   pdMS_TO_TICKS(LOG_DELAY_LOOPS_MS));
+#else
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_DELAY_LOOPS_MS));
+#endif
+#else
+        log_thread_flush();
+        osDelay(LOG_DELAY_LOOPS_MS);
 #endif
+    }
+}
 
-    log_fifo_put(&item, &logFifo);
+
+#if LOG_IDLE_HOOK_ITEMS
+// Called by vApplicationIdleHook() instead of running log_thread(). It must not block, so it returns
+// when the backend is not ready and only outputs a few items, the idle task runs again soon after.
+void log_idle_hook(void)
+{
+#if LOG_HISTORY_SIZE
+    log_history_poll();
+#endif
+    if(log_output_ready(false))
+        log_flush_items(false, LOG_IDLE_HOOK_ITEMS);
+    log_drain_backend();
 }
+#endif
 
 
-void _log_str(char *string, uint32_t length, enum log_color color)
+void log_set_ready_handler(log_out_ready_handler readyHandler)
 {
-    log_fifo_item_t item = {.type = _LOG_STRING, .str = string, .strLen = length};
+    mReadyHandler = readyHandler;
+}
 
-#if LOG_SUPPORT_ANSI_COLOR
-        item.color = color;
+
+#if LOG_ERROR_FIFO_N_ELEM && !LOG_BINARY_OUTPUT
+// The output of the error FIFO goes to urgentHandler instead of the log_init() one, NULL puts it back
+void log_set_urgent_handler(log_out_handler urgentHandler)
+{
+    mUrgentHandler = urgentHandler;
+}
 #endif
 
-    log_fifo_put(&item, &logFifo);
+
+#if LOG_LINE_PREFIX
+// Names of the LOG_MODULE numbers for %m of the line prefixes, the table must stay valid. The modules
+// without name (beyond nNames or NULL) are shown by their number.
+void log_set_module_names(const char *const *pNames, uint32_t nNames)
+{
+    mModuleNames  = pNames;
+    mNModuleNames = nNames;
 }
+#endif
 
 
-void _log_char(char chr, enum log_color color)
+#if LOG_N_BACKENDS > 1
+// Adds a backend that gets the output of the logs whose level is in levelMask (logs without level go to
+// all of them). If pRenderBuffer is not NULL the output is batched in it, so printHandler must be done
+// with its data when it returns. Returns false if there are already LOG_N_BACKENDS backends.
+bool log_add_backend(log_out_handler printHandler, log_out_flush_handler flushHandler, uint32_t levelMask,
+                     char *pRenderBuffer, uint32_t renderSize)
 {
-    log_fifo_item_t item = {.type = LOG_CHAR, .chr[0] = chr, .nChars = 1};
+    uint32_t idx = mNumBackends;
 
-#if LOG_SUPPORT_ANSI_COLOR
-        item.color = color;
-#endif
+    if(idx >= LOG_ARRAY_N_ELEM(mBackends) || !printHandler)
+        return false;
 
-    log_fifo_put(&item, &logFifo);
+    mBackends[idx].print      = printHandler;
+    mBackends[idx].flush      = flushHandler;
+    mBackends[idx].levelMask  = levelMask;
+    mBackends[idx].pRender    = pRenderBuffer;
+    mBackends[idx].renderSize = pRenderBuffer ? renderSize : 0;
+    mBackends[idx].renderLen  = 0;
+    __DMB();
+    mNumBackends = idx + 1;             // Visible to the log thread once complete
+    return true;
 }
+#endif
 
 
-void _log_array(void *pArray, uint32_t nItems, uint8_t nBytesPerItem, enum log_data_type type, enum log_color color)
+#if LOG_PROBES
+// Push-pull outputs at the highest speed, so the edges show the timing of the code and not of the pins
+void log_probe_init(void)
 {
-    uint8_t *pData = (uint8_t*) pArray;
-    uint32_t offset = 0;
-    uint32_t value;
+    GPIO_InitTypeDef gpio = {.Pin = LOG_PROBE_CRITICAL_PIN | LOG_PROBE_FLUSH_PIN | LOG_PROBE_TX_PIN,
+                             .Mode = GPIO_MODE_OUTPUT_PP, .Pull = GPIO_NOPULL, .Speed = GPIO_SPEED_FREQ_VERY_HIGH};
 
-    while(nItems--)
-    {
-        if(nBytesPerItem == 4)
-            value = *((uint32_t*)&pData[offset]);
-        else if(nBytesPerItem == 2)
-            value = *((uint16_t*)&pData[offset]);
-        else
-            value = *((uint8_t*)&pData[offset]);
+    LOG_PROBE_GPIO_CLK_ENABLE();
+    LOG_PROBE_GPIO_PORT->BSRR = (uint32_t)gpio.Pin << 16;
+    HAL_GPIO_Init(LOG_PROBE_GPIO_PORT, &gpio);
+}
+#endif
 
-        _log_var(value, type, color);
-        offset += nBytesPerItem;
-        if(nItems)                      // Skips separator after last array item
-            _log_char(' ', color);
-    }
+
+#if LOG_POWER_FAIL_SAVE
+static inline bool log_power_fail_is_inside(const log_power_fail_chunk_t *pChunk, const uint8_t *pStart,
+                                            const uint8_t *pEnd)
+{
+    return pChunk->address >= (uint32_t)pStart && pChunk->address <= (uint32_t)pEnd &&
+           pChunk->length <= (uint32_t)pEnd - pChunk->address;
 }
 
 
-void _log_flush(bool isPublicCall)
+// Writes the chunks saved by log_power_fail_save() back into the cleared .noinit.log section (and
+// .log_fifo with LOG_FIFO_SPARE_RAM), then marks the FIFOs as saved so that the LOG_POST_MORTEM
+// restore checks and keeps them
+static bool log_power_fail_restore(void)
 {
-    log_fifo_item_t item;
+    const log_power_fail_hdr_t *pHdr = (const log_power_fail_hdr_t*)LOG_POWER_FAIL_START;
+    const uint8_t *pChunks = &__log_save_start[sizeof(*pHdr)];
+    log_power_fail_chunk_t chunk;
+    uint32_t offset;
 
-    if(logFifo.nItems == LOG_ARRAY_N_ELEM(logFifo.buffer))
-        process_string("\r\nLog input FIFO full\r\n", strlen("\r\nLog input FIFO full\r\n"));
+    if(pHdr->magic != LOG_POWER_FAIL_MAGIC || pHdr->length > LOG_POWER_FAIL_END - (uint32_t)pChunks ||
+       ~log_crc32(0xFFFFFFFFUL, pChunks, pHdr->length) != pHdr->crc)
+        return false;
 
-    while(log_fifo_get(&item, &logFifo))
+    memset(__log_noinit_start, 0, __log_noinit_end - __log_noinit_start);
+#if LOG_FIFO_SPARE_RAM
+    memset(__log_fifo_start, 0, __log_fifo_end - (uint8_t*)__log_fifo_start);
+#endif
+    for(offset = 0; offset + sizeof(chunk) <= pHdr->length; offset += sizeof(chunk) + chunk.length)
     {
-#if LOG_SUPPORT_ANSI_COLOR
-        set_color(item.color);
+        memcpy(&chunk, &pChunks[offset], sizeof(chunk));
+        // A program built since the save may have moved its variables
+        if(chunk.length > pHdr->length - offset - sizeof(chunk) ||
+#if LOG_FIFO_SPARE_RAM
+           (!log_power_fail_is_inside(&chunk, __log_noinit_start, __log_noinit_end) &&
+            !log_power_fail_is_inside(&chunk, (uint8_t*)__log_fifo_start, __log_fifo_end)))
+#else
+           !log_power_fail_is_inside(&chunk, __log_noinit_start, __log_noinit_end))
 #endif
-        switch(item.type)
+            return false;
+        memcpy((void*)chunk.address, &pChunks[offset + sizeof(chunk)], chunk.length);
+    }
+    log_post_mortem_save();
+    return true;
+}
+
+
+// Erases the region for the next power failure, unless it is blank already
+static void log_power_fail_erase(void)
+{
+    FLASH_EraseInitTypeDef erase = {.TypeErase = FLASH_TYPEERASE_PAGES, .Banks = FLASH_BANK_1,
+                                    .Page = (LOG_POWER_FAIL_START - FLASH_BASE) / FLASH_PAGE_SIZE,
+                                    .NbPages = (LOG_POWER_FAIL_END - LOG_POWER_FAIL_START) / FLASH_PAGE_SIZE};
+    const uint32_t *pWord;
+    uint32_t pageError;
+
+    for(pWord = (const uint32_t*)LOG_POWER_FAIL_START; pWord < (const uint32_t*)LOG_POWER_FAIL_END; pWord++)
+    {
+        if(*pWord != LOG_POWER_FAIL_ERASED)
         {
-        case _LOG_STRING:
-            process_string(item.str, item.strLen);
-            break;
-        case _LOG_UINT_DEC:
-            process_decimal(item.uData, false);
-            break;
-        case _LOG_INT_DEC_1:
-            if((int8_t)item.sData < 0)
-                process_decimal((uint32_t)-((int8_t)item.sData), true);
-            else
-                process_decimal(item.uData, false);
-            break;
-        case _LOG_INT_DEC_2:
-            if((int16_t)item.sData < 0)
-                process_decimal((uint32_t)-((int16_t)item.sData), true);
-            else
-                process_decimal(item.uData, false);
-            break;
-        case _LOG_INT_DEC_4:
-            if((int32_t)item.sData < 0)
-                process_decimal((uint32_t)-((int32_t)item.sData), true);
-            else
-                process_decimal(item.uData, false);
-            break;
-        case _LOG_HEX_1:
-            process_hexadecimal(item.uData, 2);
-            break;
-        case _LOG_HEX_2:
-            process_hexadecimal(item.uData, 4);
-            break;
-        case _LOG_HEX_4:
-            process_hexadecimal(item.uData, 8);
-            break;
-        case LOG_CHAR:
-            process_string(item.chr, item.nChars);
+            HAL_FLASH_Unlock();
+            HAL_FLASHEx_Erase(&erase, &pageError);
+            HAL_FLASH_Lock();
+            return;
         }
     }
+}
 
-    if(isPublicCall && mFlushHandler)
-        mFlushHandler();
+
+// PVDO rises when VDD drops below the falling threshold of LOG_POWER_FAIL_PVD_LEVEL
+static void log_power_fail_init(void)
+{
+    PWR_PVDTypeDef pvd = {.PVDLevel = LOG_POWER_FAIL_PVD_LEVEL, .Mode = PWR_PVD_MODE_IT_RISING};
+
+    log_power_fail_erase();
+    HAL_PWREx_ConfigPVD(&pvd);
+    HAL_PWREx_EnablePVD();
+    HAL_NVIC_SetPriority(PVD_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(PVD_IRQn);
 }
+#endif
 
 
-void log_thread(void const * argument)
+// Everything of log_init() but the handlers, the logs stored after it wait in the input FIFO
+static void log_setup(void)
 {
+#if LOG_POWER_FAIL_SAVE
+    bool isPowerFail;
+#endif
 
-    while(1)
+#if LOG_PROBES
+    log_probe_init();
+#endif
+    static_assert(!(LOG_INPUT_FIFO_N_ELEM & (LOG_INPUT_FIFO_N_ELEM - 1)), "Log input queue must be power of 2");
+    static_assert(!(LOG_COPY_ARENA_SIZE & (LOG_COPY_ARENA_SIZE - 1)), "Log copy arena size must be power of 2");
+    static_assert(!(LOG_HISTORY_SIZE & (LOG_HISTORY_SIZE - 1)), "Log history size must be power of 2");
+#if LOG_FIFO_PACKED
+    static_assert(!(LOG_PACKED_BYTES_PER_ELEM & (LOG_PACKED_BYTES_PER_ELEM - 1)), "Log packed bytes per element must be power of 2");
+#endif
+#if LOG_WAKEUP_FILL_PERCENT
+    static_assert(LOG_WAKEUP_FILL_PERCENT <= 100, "Log wakeup fill level must be a percentage");
+#endif
+#if LOG_SATURATION_HOOKS
+    static_assert(LOG_SATURATION_PERCENT <= 100, "Log saturation fill level must be a percentage");
+#endif
+#if LOG_PER_CONTEXT_FIFOS
+    static_assert(!(LOG_ISR_FIFO_N_ELEM & (LOG_ISR_FIFO_N_ELEM - 1)), "Log ISR input queue must be power of 2");
+#endif
+#if LOG_ERROR_FIFO_N_ELEM
+    static_assert(!(LOG_ERROR_FIFO_N_ELEM & (LOG_ERROR_FIFO_N_ELEM - 1)), "Log error input queue must be power of 2");
+#endif
+#if LOG_TIMESTAMPS && LOG_BINARY_OUTPUT
+    mLastTimestamp = LOG_TIMESTAMP_GET();
+#elif LOG_SYSVIEW
+    mSysviewNPackets = 0;                   // The output starts with a sync
+#elif LOG_TIMESTAMPS && !LOG_RTC_ANCHOR_MS
+    mLineTimestamp = LOG_TIMESTAMP_GET();   // First line shows the time elapsed since initialization
+#endif
+#if LOG_STATS
+    memset(&mStats, 0, sizeof(mStats));
+#endif
+#if LOG_COLOR_ON_CHANGE && LOG_SUPPORT_ANSI_COLOR && !LOG_BINARY_OUTPUT
+    mLastColor = _LOG_COLOR_LEN;
+#endif
+#if LOG_OVERFLOW_BLOCK
+    log_overflow_init();
+#endif
+#if LOG_DELEGATED_FLUSH
+    mFlushDone = xSemaphoreCreateBinaryStatic(&mFlushDoneBuffer);
+#endif
+#if LOG_COMPRESS
+    static_assert(!(LOG_COMPRESS_WINDOW & (LOG_COMPRESS_WINDOW - 1)), "Log compress window must be power of 2");
+    compress_init();
+#endif
+#if LOG_PACKETS
+    packet_init();
+#endif
+#if LOG_POWER_FAIL_SAVE
+    isPowerFail = log_power_fail_restore();
+    log_power_fail_init();
+#endif
+#if LOG_POST_MORTEM
+    if(mPostMortem.magic == LOG_POST_MORTEM_MAGIC && log_input_restore())
     {
-        _log_flush(false);
-        osDelay(LOG_DELAY_LOOPS_MS);
+        mPostMortem.magic = 0;          // A later reset without a new save must not print them again
+#if LOG_POWER_FAIL_SAVE
+        if(isPowerFail)
+            _log_str(LOG_POWER_FAIL_MARK, strlen(LOG_POWER_FAIL_MARK), LOG_COLOR_NONE);
+        else
+#endif
+        _log_str(LOG_POST_MORTEM_MARK, strlen(LOG_POST_MORTEM_MARK), LOG_COLOR_NONE);
+#if LOG_RTOS_TRACE
+        mIsTraceOn = true;
+#endif
+        return;
     }
+    mPostMortem.magic = 0;
+#endif
+    log_input_init();
+#if LOG_RTOS_TRACE
+    mIsTraceOn = true;
+#endif
+}
+
+
+// Sets up the input FIFOs right after HAL_Init(), so that logging works before the backend and the
+// scheduler are started. The next log_init() only sets the handlers and keeps the stored items.
+void log_early_init(void)
+{
+    log_setup();
+    mIsEarlyInit = true;
 }
 
 
 void log_init(log_out_handler printHandler, log_out_flush_handler flushHandler)
 {
+    if(!mIsEarlyInit)
+        log_setup();
+    mIsEarlyInit = false;
     mPrintHandler = printHandler;
     mFlushHandler = flushHandler;
-    static_assert(!(LOG_INPUT_FIFO_N_ELEM & (LOG_INPUT_FIFO_N_ELEM - 1)), "Log input queue must be power of 2");
-    log_fifo_reset(&logFifo);
 }
+
+
+#if LOG_POST_MORTEM
+// Saves the input FIFOs for the next boot, to be called from fault handlers before the reset.
+// It does not use the RTOS nor interrupts, so it is also valid with interrupts disabled.
+void log_post_mortem_save(void)
+{
+    mPostMortem.crc   = log_input_crc();
+    mPostMortem.magic = LOG_POST_MORTEM_MAGIC;
+}
+#endif
+
+
+#if LOG_POWER_FAIL_SAVE
+// Programs the pending items of the input FIFOs into FLASH_LOG_SAVE, with the interrupts disabled
+// and without the RTOS nor the HAL. Nothing is written unless the region is blank, so the image of an
+// earlier failure is kept until log_init() replays it, and the header is programmed last. PRIMASK and
+// the flash lock are as the caller left them on return.
+void log_power_fail_save(void)
+{
+    log_power_fail_hdr_t *pHdr = (log_power_fail_hdr_t*)LOG_POWER_FAIL_START;
+    uint32_t primaskBit = __get_PRIMASK();
+    uint8_t hdr[2][8];
+    bool isLocked;
+
+    __disable_irq();
+    if(pHdr->magic != LOG_POWER_FAIL_ERASED || *(const uint32_t*)&pHdr[1] != LOG_POWER_FAIL_ERASED)
+    {
+        __set_PRIMASK(primaskBit);
+        return;
+    }
+    isLocked = FLASH->CR & FLASH_CR_LOCK;
+    if(isLocked)                        // A key written while unlocked would lock the flash until the reset
+    {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+    // The interrupt may have stopped the application between the steps of an erase or a programming:
+    // the ongoing operation ends and its bits are cleared before the first double word
+    while(FLASH->SR & FLASH_SR_BSY1)
+        ;
+    FLASH->CR &= ~(FLASH_CR_PER | FLASH_CR_PG);
+
+    memset(&mPowerFail, 0, sizeof(mPowerFail));
+    mPowerFail.address = LOG_POWER_FAIL_START + sizeof(*pHdr);
+    mPowerFail.crc     = 0xFFFFFFFFUL;
+    log_input_power_fail_save();
+    if(mPowerFail.nBytes && !mPowerFail.isFull && mPowerFail.address < LOG_POWER_FAIL_END)
+    {
+        memset(&mPowerFail.word[mPowerFail.nBytes], 0xFF, sizeof(mPowerFail.word) - mPowerFail.nBytes);
+        log_flash_program(mPowerFail.address, mPowerFail.word);
+    }
+    else if(mPowerFail.nBytes)
+        mPowerFail.isFull = true;
+
+    if(!mPowerFail.isFull)
+    {
+        log_power_fail_hdr_t header = {.magic = LOG_POWER_FAIL_MAGIC, .length = mPowerFail.length,
+                                       .crc = ~mPowerFail.crc, .reserved = LOG_POWER_FAIL_ERASED};
+
+        memcpy(hdr, &header, sizeof(hdr));
+        log_flash_program(LOG_POWER_FAIL_START + sizeof(hdr[0]), hdr[1]);
+        log_flash_program(LOG_POWER_FAIL_START, hdr[0]);
+    }
+    if(isLocked)
+        FLASH->CR |= FLASH_CR_LOCK;
+    __set_PRIMASK(primaskBit);
+}
+
+
+// To be called from PVD_IRQHandler(). If the supply comes back, it resets anyway so that the saved
+// items are printed once by the next log_init() as after a real power loss.
+void log_power_fail_irq_handler(void)
+{
+    EXTI->RPR1 = EXTI_RPR1_RPIF16;
+    log_power_fail_save();
+    while(PWR->SR2 & PWR_SR2_PVDO)
+        ;
+    NVIC_SystemReset();
+}
+#endif
@@ -0,0 +1,375 @@
+/*
+ * log_bench.c
+ *
+ * Self benchmark of the logger, enabled with LOG_BENCH in log.h. Cycles are measured with
+ * LOG_TIMESTAMP_GET(), so the counter must be running at core clock when log_bench_run() is called.
+ * The tables end with a "Bench summary" line for Tools/log_matrix.py:
+ *
+ *     Bench summary var <avg> str <avg> char <avg> array16 <avg> flush_byte <cycles> irq_off <max> wire <bytes> records <n>
+ *
+ * where wire is the output of the records of bench_flush(), as they go to the backend once encoded.
+ */
+
+
+#include "log_bench.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#if LOG_BENCH && LOG_BENCH_BASELINES
+#include "queue.h"
+#include "stream_buffer.h"
+#include "message_buffer.h"
+#endif
+
+#if LOG_BENCH
+
+
+#define LOG_BENCH_N_ELEM(x)     (sizeof(x)/sizeof((x)[0]))
+#define LOG_BENCH_FLUSH_RECORDS 7       // Logged by each run of bench_flush()
+
+
+typedef struct log_bench_result_s
+{
+    uint32_t min;
+    uint32_t max;
+    uint32_t total;
+} log_bench_result_t;
+
+
+// Average cycles of one payload size, irqOff is the longest masked time of the inserts
+typedef struct log_bench_fifo_s
+{
+    uint32_t insert;
+    uint32_t irqOff;
+    uint32_t drain;
+} log_bench_fifo_t;
+
+
+static uint32_t mSinkBytes;
+static uint32_t mOverhead;
+#if LOG_BENCH_BASELINES
+static const uint32_t mFifoSizes[] = {1, 4, 12};
+static uint32_t mFifoWords[3];
+static uint8_t mFifoStorage[LOG_BENCH_N_RUNS * (12 + sizeof(size_t)) + 1];  // Message buffers add the length
+#endif
+
+
+// Backend used while measuring, it only counts the output bytes
+static void bench_sink(void *pData, uint32_t length)
+{
+    (void)pData;
+    mSinkBytes += length;
+}
+
+
+static void bench_add(log_bench_result_t *pResult, uint32_t start, uint32_t end)
+{
+    uint32_t cycles = end - start;
+
+    cycles = (cycles > mOverhead) ? cycles - mOverhead : 0;
+    if(cycles < pResult->min)
+        pResult->min = cycles;
+    if(cycles > pResult->max)
+        pResult->max = cycles;
+    pResult->total += cycles;
+}
+
+
+static void bench_calibrate(void)
+{
+    uint32_t start;
+    uint32_t minCycles = UINT32_MAX;
+    uint32_t i;
+
+    for(i = 0; i < LOG_BENCH_N_RUNS; i++)
+    {
+        start = LOG_TIMESTAMP_GET();
+        start = LOG_TIMESTAMP_GET() - start;
+        if(start < minCycles)
+            minCycles = start;
+    }
+    mOverhead = minCycles;
+}
+
+
+#define BENCH_CALL(pResult, call)   do {                                            \
+                                        uint32_t start = LOG_TIMESTAMP_GET();       \
+                                        call;                                       \
+                                        bench_add((pResult), start, LOG_TIMESTAMP_GET()); \
+                                        _log_flush(false);                          \
+                                    } while(0)
+
+
+static void bench_inserts(log_bench_result_t *pResults)
+{
+    static uint16_t array[64];
+    uint32_t i;
+
+    for(i = 0; i < LOG_BENCH_N_ELEM(array); i++)
+        array[i] = i * 1000;
+
+    for(i = 0; i < LOG_BENCH_N_RUNS; i++)
+    {
+        BENCH_CALL(&pResults[0], _log_var(i, _LOG_UINT_DEC, LOG_COLOR_NONE));
+        BENCH_CALL(&pResults[1], _log_str("Benchmark\r\n", 11, LOG_COLOR_NONE));
+        BENCH_CALL(&pResults[2], _log_char('a', LOG_COLOR_NONE));
+        BENCH_CALL(&pResults[3], _log_array(array, 1, sizeof(array[0]), _LOG_UINT_DEC, LOG_COLOR_NONE));
+        BENCH_CALL(&pResults[4], _log_array(array, 16, sizeof(array[0]), _LOG_UINT_DEC, LOG_COLOR_NONE));
+        BENCH_CALL(&pResults[5], _log_array(array, 64, sizeof(array[0]), _LOG_UINT_DEC, LOG_COLOR_NONE));
+    }
+}
+
+
+// Returns the cycles per output byte of _log_flush() for a typical mix of items
+static uint32_t bench_flush(void)
+{
+    int16_t array[16];
+    uint32_t start;
+    uint32_t cycles = 0;
+    uint32_t i;
+
+    for(i = 0; i < LOG_BENCH_N_ELEM(array); i++)
+        array[i] = (i - 8) * 1234;
+
+    mSinkBytes = 0;
+    for(i = 0; i < LOG_BENCH_N_RUNS; i++)
+    {
+        log_str("Value: ");
+        log_dec(i * 123457);
+        log_char(' ');
+        log_hex(i, LOG_COLOR_GREEN);
+        log_char(' ');
+        log_array_dec(array, LOG_BENCH_N_ELEM(array));
+        log_str("\r\n", LOG_COLOR_DEFAULT);
+
+        start = LOG_TIMESTAMP_GET();
+        _log_flush(false);
+        cycles += LOG_TIMESTAMP_GET() - start - mOverhead;
+    }
+
+    return mSinkBytes ? cycles / mSinkBytes : 0;
+}
+
+
+#if LOG_BENCH_BASELINES
+static void bench_fifo_insert(uint32_t size, uint32_t i)
+{
+    if(size == 1)
+        _log_char('a', LOG_COLOR_NONE);
+    else if(size == 4)
+        _log_var(i, _LOG_UINT_DEC, LOG_COLOR_NONE);
+    else
+        _log_array(mFifoWords, LOG_BENCH_N_ELEM(mFifoWords), sizeof(mFifoWords[0]), _LOG_UINT_DEC, LOG_COLOR_NONE);
+}
+
+
+// The input FIFO in the LOG_FIFO_MODE it is built with, each item drained by _log_flush() to the sink
+static void bench_fifo_log(uint32_t size, log_bench_fifo_t *pResult)
+{
+    uint32_t start;
+    uint32_t irqOff;
+    uint32_t i;
+
+    (void)_log_bench_irq_off_max();
+    for(i = 0; i < LOG_BENCH_N_RUNS; i++)
+    {
+        start = LOG_TIMESTAMP_GET();
+        bench_fifo_insert(size, i);
+        pResult->insert += LOG_TIMESTAMP_GET() - start - mOverhead;
+        irqOff = _log_bench_irq_off_max();
+        if(irqOff > pResult->irqOff)
+            pResult->irqOff = irqOff;
+
+        start = LOG_TIMESTAMP_GET();
+        _log_flush(false);
+        pResult->drain += LOG_TIMESTAMP_GET() - start - mOverhead;
+        (void)_log_bench_irq_off_max();         // The masked time of the flush is not the one of the insert
+    }
+}
+
+
+// Kind 0 is a queue of items of the payload size, 1 a stream buffer and 2 a message buffer. They are
+// filled with LOG_BENCH_N_RUNS payloads, then drained, without waiting. Their masked time is not
+// measured: xQueueSend() copies the item in a critical section, the buffers copy with interrupts on.
+static void bench_fifo_rtos(uint32_t kind, uint32_t size, log_bench_fifo_t *pResult)
+{
+    static StaticQueue_t queueCb;
+    static StaticStreamBuffer_t streamCb;
+    QueueHandle_t queue = NULL;
+    StreamBufferHandle_t stream = NULL;
+    uint8_t payload[12] = {0};
+    uint32_t start;
+    uint32_t i;
+
+    if(!kind)
+        queue = xQueueCreateStatic(LOG_BENCH_N_RUNS, size, mFifoStorage, &queueCb);
+    else if(kind == 1)
+        stream = xStreamBufferCreateStatic(sizeof(mFifoStorage) - 1, 1, mFifoStorage, &streamCb);
+    else
+        stream = xMessageBufferCreateStatic(sizeof(mFifoStorage) - 1, mFifoStorage, &streamCb);
+
+    for(i = 0; i < LOG_BENCH_N_RUNS; i++)
+    {
+        start = LOG_TIMESTAMP_GET();
+        if(queue)
+            (void)xQueueSend(queue, payload, 0);
+        else
+            (void)xStreamBufferSend(stream, payload, size, 0);
+        pResult->insert += LOG_TIMESTAMP_GET() - start - mOverhead;
+    }
+    for(i = 0; i < LOG_BENCH_N_RUNS; i++)
+    {
+        start = LOG_TIMESTAMP_GET();
+        if(queue)
+            (void)xQueueReceive(queue, payload, 0);
+        else
+            (void)xStreamBufferReceive(stream, payload, size, 0);
+        pResult->drain += LOG_TIMESTAMP_GET() - start - mOverhead;
+    }
+
+    if(queue)
+        vQueueDelete(queue);
+    else
+        vStreamBufferDelete(stream);
+}
+
+
+static void bench_fifo_print(const char *name, log_bench_fifo_t *pResults, bool isMasked)
+{
+    uint32_t i;
+
+    for(i = 0; i < LOG_BENCH_N_ELEM(mFifoSizes); i++)
+    {
+        _log_str((char*)name, strlen(name), LOG_COLOR_NONE);
+        log_dec(mFifoSizes[i]);
+        log_char(' ');
+        log_dec(pResults[i].insert / LOG_BENCH_N_RUNS);
+        log_char(' ');
+        if(isMasked)
+            log_dec(pResults[i].irqOff);
+        else
+            log_char('-');
+        log_char(' ');
+        log_dec(pResults[i].drain / LOG_BENCH_N_RUNS);
+        log_str("\r\n");
+        log_flush();
+    }
+}
+#endif
+
+
+static void bench_print(const char *name, uint32_t nameLen, log_bench_result_t *pResult)
+{
+    _log_str((char*)name, nameLen, LOG_COLOR_NONE);
+    log_dec(pResult->min);
+    log_char(' ');
+    log_dec(pResult->total / LOG_BENCH_N_RUNS);
+    log_char(' ');
+    log_dec(pResult->max);
+    log_str("\r\n");
+    log_flush();
+}
+
+
+/**
+ * Measures the logger with a dummy backend and then prints the results to the given one.
+ * It reinitializes the logger, so it must be called before any other log is generated. The
+ * scheduler is suspended while measuring so only interrupts can disturb the results.
+ */
+void log_bench_run(log_out_handler printHandler, log_out_flush_handler flushHandler)
+{
+    static const char * const names[] = {
+        "_log_var            ",
+        "_log_str            ",
+        "_log_char           ",
+        "_log_array N=1      ",
+        "_log_array N=16     ",
+        "_log_array N=64     ",
+    };
+    log_bench_result_t results[LOG_BENCH_N_ELEM(names)];
+#if LOG_BENCH_BASELINES
+    static const char * const fifoNames[] = {
+#if LOG_FIFO_MODE == LOG_FIFO_LOCKED
+        "log FIFO locked     ",
+#elif LOG_FIFO_MODE == LOG_FIFO_MPSC && LOG_FIFO_LOCK_FREE
+        "log FIFO lock-free  ",
+#elif LOG_FIFO_MODE == LOG_FIFO_MPSC
+        "log FIFO MPSC       ",
+#else
+        "log FIFO SPSC       ",
+#endif
+        "xQueueSend          ",
+        "xStreamBufferSend   ",
+        "xMessageBufferSend  ",
+    };
+    log_bench_fifo_t fifos[LOG_BENCH_N_ELEM(fifoNames)][LOG_BENCH_N_ELEM(mFifoSizes)] = {0};
+    uint32_t j;
+#endif
+    uint32_t flushCycles;
+    uint32_t wireBytes;
+    uint32_t irqOffMax;
+    uint32_t i;
+
+    for(i = 0; i < LOG_BENCH_N_ELEM(results); i++)
+    {
+        results[i].min   = UINT32_MAX;
+        results[i].max   = 0;
+        results[i].total = 0;
+    }
+
+    vTaskSuspendAll();
+    log_init(bench_sink, NULL);
+    bench_calibrate();
+    (void)_log_bench_irq_off_max();
+    bench_inserts(results);
+    irqOffMax = _log_bench_irq_off_max();
+    flushCycles = bench_flush();
+    wireBytes = mSinkBytes;
+#if LOG_BENCH_BASELINES
+    for(j = 0; j < LOG_BENCH_N_ELEM(mFifoWords); j++)
+        mFifoWords[j] = j * 100000;
+    for(i = 0; i < LOG_BENCH_N_ELEM(mFifoSizes); i++)
+    {
+        bench_fifo_log(mFifoSizes[i], &fifos[0][i]);
+        for(j = 1; j < LOG_BENCH_N_ELEM(fifoNames); j++)
+            bench_fifo_rtos(j - 1, mFifoSizes[i], &fifos[j][i]);
+    }
+#endif
+    log_init(printHandler, flushHandler);
+    xTaskResumeAll();
+
+    log_str("\r\nLogger benchmark, cycles (min avg max)\r\n");
+    for(i = 0; i < LOG_BENCH_N_ELEM(results); i++)
+        bench_print(names[i], strlen(names[i]), &results[i]);
+    log_str("_log_flush per byte ");
+    log_dec(flushCycles);
+    log_str("\r\nIRQs disabled max   ");
+    log_dec(irqOffMax);
+    log_str("\r\n\r\n");
+#if LOG_BENCH_BASELINES
+    log_str("FIFO comparison, cycles (bytes insert IRQs-disabled-max drain)\r\n");
+    for(i = 0; i < LOG_BENCH_N_ELEM(fifoNames); i++)
+        bench_fifo_print(fifoNames[i], fifos[i], !i);
+    log_str("\r\n");
+#endif
+
+    log_str("Bench summary var ");
+    log_dec(results[0].total / LOG_BENCH_N_RUNS);
+    log_str(" str ");
+    log_dec(results[1].total / LOG_BENCH_N_RUNS);
+    log_str(" char ");
+    log_dec(results[2].total / LOG_BENCH_N_RUNS);
+    log_str(" array16 ");
+    log_dec(results[4].total / LOG_BENCH_N_RUNS);
+    log_str(" flush_byte ");
+    log_dec(flushCycles);
+    log_str(" irq_off ");
+    log_dec(irqOffMax);
+    log_str(" wire ");
+    log_dec(wireBytes);
+    log_str(" records ");
+    log_dec(LOG_BENCH_N_RUNS * LOG_BENCH_FLUSH_RECORDS);
+    log_str("\r\n");
+    log_flush();
+}
+
+#endif
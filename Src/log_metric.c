@@ -0,0 +1,68 @@
+/*
+ * log_metric.c
+ *
+ * Counters of events that would be too many to log one by one, enabled with LOG_METRICS in log.h.
+ * log_metric_inc(), log_metric_add() and log_metric_set() only update a word of the table, which the
+ * log thread logs as a single array every LOG_METRIC_PERIOD_MS. The output rate does not depend on
+ * the event rate then. The counters wrap at 2^32, so do the deltas of LOG_METRIC_DELTAS.
+ */
+
+
+#include "log_metric.h"
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if LOG_METRICS
+
+
+#if LOG_METRIC_DELTAS
+#define METRIC_HEADER           "Metric deltas: "
+#else
+#define METRIC_HEADER           "Metrics: "
+#endif
+
+
+volatile uint32_t           _logMetrics[LOG_METRIC_N_IDS];
+#if LOG_METRIC_DELTAS
+static uint32_t             mPrevious[LOG_METRIC_N_IDS];    // Values logged by the previous snapshot
+#endif
+static TickType_t           mLastSnapshot;
+
+
+static void metric_snapshot(void)
+{
+    uint32_t values[LOG_METRIC_N_IDS];
+    uint32_t value;
+    uint32_t id;
+
+    // Each word is read atomically, the counters may change between them
+    for(id = 0; id < LOG_METRIC_N_IDS; id++)
+    {
+        value = _logMetrics[id];
+#if LOG_METRIC_DELTAS
+        values[id] = value - mPrevious[id];
+        mPrevious[id] = value;
+#else
+        values[id] = value;
+#endif
+    }
+
+    _log_str(METRIC_HEADER, strlen(METRIC_HEADER), LOG_COLOR_NONE);
+    _log_array_copy(values, LOG_METRIC_N_IDS, sizeof(uint32_t), _LOG_UINT_DEC, LOG_COLOR_NONE);
+    _log_str("\r\n", 2, LOG_COLOR_NONE);
+}
+
+
+void _log_metric_poll(void)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    if(now - mLastSnapshot < pdMS_TO_TICKS(LOG_METRIC_PERIOD_MS))
+        return;
+    mLastSnapshot = now;
+    metric_snapshot();
+}
+
+
+#endif
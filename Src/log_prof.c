@@ -0,0 +1,142 @@
+/*
+ * log_prof.c
+ *
+ * Cycle profiler of code sections, enabled with LOG_PROF in log.h. LOG_PROF_END() only updates the
+ * counters of its ID, so hot code can be measured at any rate without a log item per run: the
+ * table is logged by the log thread every LOG_PROF_PERIOD_MS or when a dump is requested, and each
+ * dump covers the runs since the previous one. Cycles are measured with LOG_TIMESTAMP_GET(), so the
+ * counter must be running at core clock.
+ */
+
+
+#include "log_prof.h"
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if LOG_PROF
+
+
+typedef struct log_prof_entry_s
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t buckets[LOG_PROF_N_BUCKETS];   // Bucket n counts the runs of 2^(n-1) to 2^n - 1 cycles
+} log_prof_entry_t;
+
+
+static log_prof_entry_t     mEntries[LOG_PROF_N_IDS];
+static volatile bool        mIsDumpRequested = false;
+#if LOG_PROF_PERIOD_MS
+static TickType_t           mLastDump;
+#endif
+
+
+static inline void prof_str(const char *str)
+{
+    _log_str((char*)str, strlen(str), LOG_COLOR_NONE);
+}
+
+
+static inline uint32_t prof_bucket(uint32_t cycles)
+{
+    uint32_t bucket = cycles ? 32 - __builtin_clz(cycles) : 0;
+
+    return (bucket < LOG_PROF_N_BUCKETS) ? bucket : LOG_PROF_N_BUCKETS - 1;
+}
+
+
+// From any context, the interrupts are only masked for the update of the entry
+void _log_prof_add(uint32_t id, uint32_t cycles)
+{
+    log_prof_entry_t *pEntry;
+    uint32_t bucket = prof_bucket(cycles);
+    uint32_t primaskBit;
+
+    if(id >= LOG_PROF_N_IDS)
+        return;
+
+    pEntry = &mEntries[id];
+    LOG_MASK_SAVE(primaskBit);
+    if(!pEntry->count || cycles < pEntry->min)
+        pEntry->min = cycles;
+    if(cycles > pEntry->max)
+        pEntry->max = cycles;
+    pEntry->count++;
+    pEntry->total += cycles;
+    pEntry->buckets[bucket]++;
+    LOG_MASK_RESTORE(primaskBit);
+}
+
+
+// One line per ID that ran since the previous dump, then its histogram up to the last used bucket
+static void prof_dump_entry(uint32_t id, const log_prof_entry_t *pEntry)
+{
+    uint32_t nBuckets = LOG_PROF_N_BUCKETS;
+
+    while(!pEntry->buckets[nBuckets - 1])
+        nBuckets--;
+
+    prof_str("Prof ");
+    _log_var(id, _LOG_UINT_DEC, LOG_COLOR_NONE);
+    prof_str(": ");
+    _log_var(pEntry->count, _LOG_UINT_DEC, LOG_COLOR_NONE);
+    prof_str(" runs, min ");
+    _log_var(pEntry->min, _LOG_UINT_DEC, LOG_COLOR_NONE);
+    prof_str(" mean ");
+    _log_var((uint32_t)(pEntry->total / pEntry->count), _LOG_UINT_DEC, LOG_COLOR_NONE);
+    prof_str(" max ");
+    _log_var(pEntry->max, _LOG_UINT_DEC, LOG_COLOR_NONE);
+    prof_str(" cycles\r\n  log2 histogram: ");
+    _log_array_copy(pEntry->buckets, nBuckets, sizeof(uint32_t), _LOG_UINT_DEC, LOG_COLOR_NONE);
+    prof_str("\r\n");
+}
+
+
+// Each entry is copied and cleared with the interrupts masked, so no run is lost between two dumps
+void log_prof_dump(void)
+{
+    log_prof_entry_t entry;
+    uint32_t primaskBit;
+    uint32_t id;
+
+    for(id = 0; id < LOG_PROF_N_IDS; id++)
+    {
+        LOG_MASK_SAVE(primaskBit);
+        entry = mEntries[id];
+        memset(&mEntries[id], 0, sizeof(mEntries[id]));
+        LOG_MASK_RESTORE(primaskBit);
+
+        if(entry.count)
+            prof_dump_entry(id, &entry);
+    }
+}
+
+
+void log_prof_request_dump(void)
+{
+    mIsDumpRequested = true;
+}
+
+
+void _log_prof_poll(void)
+{
+#if LOG_PROF_PERIOD_MS
+    TickType_t now = xTaskGetTickCount();
+
+    if(now - mLastDump >= pdMS_TO_TICKS(LOG_PROF_PERIOD_MS))
+    {
+        mLastDump = now;
+        mIsDumpRequested = true;
+    }
+#endif
+    if(!mIsDumpRequested)
+        return;
+    mIsDumpRequested = false;
+    log_prof_dump();
+}
+
+
+#endif
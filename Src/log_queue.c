@@ -0,0 +1,179 @@
+/*
+ * log_queue.c
+ *
+ * Fill levels of the FreeRTOS queues and stream buffers, enabled with LOG_QUEUE_MONITOR in log.h. At
+ * each wakeup the log thread samples the queues of the kernel registry (vQueueAddToRegistry(), the
+ * semaphores and mutexes are queues too) and the stream buffers of log_queue_monitor_stream(), and
+ * keeps the highest level of each. Every LOG_QUEUE_MONITOR_PERIOD_MS it logs them:
+ *
+ *     Queue high water:
+ *       <name> <high water> <size>
+ *
+ * in items for the queues and in bytes for the stream buffers, then starts again from the current
+ * levels. A queue whose high water reaches its size is one its producers block on or drop at. The
+ * samples are only as frequent as the wakeups of the log thread (LOG_DELAY_LOOPS_MS), a shorter peak
+ * may be missed.
+ */
+
+
+#include "log_queue.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "stream_buffer.h"
+
+#if LOG_QUEUE_MONITOR
+
+
+#if configQUEUE_REGISTRY_SIZE < 1
+#error "LOG_QUEUE_MONITOR reads the queue registry, configQUEUE_REGISTRY_SIZE must be at least 1"
+#endif
+
+
+#define LOG_QUEUE_N_ELEM(x)         (sizeof(x)/sizeof((x)[0]))
+
+
+// Layout of QueueRegistryItem_t, private to queue.c. The array itself is global for the kernel aware
+// debuggers.
+typedef struct log_queue_registry_item_s
+{
+    const char   *pcQueueName;          // NULL if the slot is free
+    QueueHandle_t xHandle;
+} log_queue_registry_item_t;
+
+
+typedef struct log_queue_s
+{
+    void       *pHandle;                // Queue or stream buffer, NULL if the entry is free
+    const char *pName;
+    uint32_t    size;                   // Items or bytes
+    uint32_t    high;                   // Highest level since the previous report
+    uint32_t    reported;               // High water of the report being logged
+} log_queue_t;
+
+
+extern log_queue_registry_item_t xQueueRegistry[configQUEUE_REGISTRY_SIZE];
+
+// The registry slots first, in the same order, then the stream buffers
+static log_queue_t          mQueues[configQUEUE_REGISTRY_SIZE + LOG_QUEUE_MONITOR_N_STREAMS];
+static TickType_t           mLastReport;
+
+
+static inline bool queue_is_stream(uint32_t idx)
+{
+    return idx >= configQUEUE_REGISTRY_SIZE;
+}
+
+
+static uint32_t queue_level(uint32_t idx)
+{
+    if(queue_is_stream(idx))
+        return xStreamBufferBytesAvailable(mQueues[idx].pHandle);
+    return uxQueueMessagesWaiting(mQueues[idx].pHandle);
+}
+
+
+// Follows the queues added to and removed from the registry since the previous sample
+static void queue_sync_registry(void)
+{
+    QueueHandle_t queue;
+    uint32_t i;
+
+    for(i = 0; i < configQUEUE_REGISTRY_SIZE; i++)
+    {
+        queue = xQueueRegistry[i].pcQueueName ? xQueueRegistry[i].xHandle : NULL;
+        if(queue == mQueues[i].pHandle)
+            continue;
+        mQueues[i].pHandle = queue;
+        if(!queue)
+            continue;
+        mQueues[i].pName    = xQueueRegistry[i].pcQueueName;
+        mQueues[i].size     = uxQueueMessagesWaiting(queue) + uxQueueSpacesAvailable(queue);
+        mQueues[i].high     = 0;
+        mQueues[i].reported = 0;
+    }
+}
+
+
+// The entry is filled with the scheduler suspended, the log thread never sees it half set
+bool log_queue_monitor_stream(StreamBufferHandle_t stream, const char *pName)
+{
+    bool isAdded = false;
+    uint32_t i;
+
+    if(!stream)
+        return false;
+
+    vTaskSuspendAll();
+    for(i = configQUEUE_REGISTRY_SIZE; i < LOG_QUEUE_N_ELEM(mQueues) && !isAdded; i++)
+    {
+        if(mQueues[i].pHandle && mQueues[i].pHandle != stream)
+            continue;
+        mQueues[i].pName    = pName;
+        mQueues[i].size     = xStreamBufferBytesAvailable(stream) + xStreamBufferSpacesAvailable(stream);
+        mQueues[i].high     = 0;
+        mQueues[i].reported = 0;
+        mQueues[i].pHandle  = stream;
+        isAdded = true;
+    }
+    xTaskResumeAll();
+    return isAdded;
+}
+
+
+// Logs the high water and size of each queue on its own line, as an array after the name
+static void queue_report(void)
+{
+    uint32_t row[2];
+    uint32_t i;
+
+    _log_str("Queue high water:\r\n", strlen("Queue high water:\r\n"), LOG_COLOR_NONE);
+    for(i = 0; i < LOG_QUEUE_N_ELEM(mQueues); i++)
+    {
+        if(!mQueues[i].pHandle)
+            continue;
+        row[0] = mQueues[i].reported;
+        row[1] = mQueues[i].size;
+        _log_str("  ", 2, LOG_COLOR_NONE);
+        _log_strcpy(mQueues[i].pName, strlen(mQueues[i].pName), LOG_COLOR_NONE);
+        _log_char(' ', LOG_COLOR_NONE);
+        _log_array_copy(row, LOG_QUEUE_N_ELEM(row), sizeof(row[0]), _LOG_UINT_DEC, LOG_COLOR_NONE);
+        _log_str("\r\n", 2, LOG_COLOR_NONE);
+    }
+}
+
+
+// Samples with the scheduler suspended, so that no task deletes a registered queue in the middle. The
+// report is logged once it is resumed, a log call may block or wake up tasks.
+void _log_queue_poll(void)
+{
+    TickType_t now = xTaskGetTickCount();
+    bool isReportDue = now - mLastReport >= pdMS_TO_TICKS(LOG_QUEUE_MONITOR_PERIOD_MS);
+    uint32_t level;
+    uint32_t i;
+
+    vTaskSuspendAll();
+    queue_sync_registry();
+    for(i = 0; i < LOG_QUEUE_N_ELEM(mQueues); i++)
+    {
+        if(!mQueues[i].pHandle)
+            continue;
+        level = queue_level(i);
+        if(level > mQueues[i].high)
+            mQueues[i].high = level;
+        if(isReportDue)
+        {
+            mQueues[i].reported = mQueues[i].high;
+            mQueues[i].high     = level;
+        }
+    }
+    xTaskResumeAll();
+
+    if(!isReportDue)
+        return;
+    mLastReport = now;
+    queue_report();
+}
+
+
+#endif
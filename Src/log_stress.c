@@ -0,0 +1,245 @@
+/*
+ * log_stress.c
+ *
+ * Multi-producer stress test of the logger, enabled with LOG_STRESS in log.h. LOG_STRESS_N_TASKS tasks
+ * of increasing priorities and the TIM7 interrupt share the rate of each stage, which rises by
+ * LOG_STRESS_RATE_STEP every LOG_STRESS_STAGE_MS. Each event is one log_fmt() line:
+ *
+ *     STR <producer> <counter> <check>
+ *
+ * where the counter of each producer goes up by one per event and check is stress_check() of both,
+ * in hexadecimal. Each stage starts with "STR stage <n> rate <events/s>" and the test ends with
+ * "STR total <producer> <events>" for each producer then "STR end". Tools/log_stress.py reads that
+ * output and reports the events lost in each stage, so the highest rate without loss tells whether
+ * LOG_INPUT_FIFO_N_ELEM and VCP_INPUT_BUFFER_SIZE are enough.
+ *
+ * With LOG_STRESS_JITTER, TIM6 interrupts at LOG_STRESS_JITTER_HZ at the highest priority and reads
+ * its own counter on entry, which is the number of timer ticks since the update event: the sections
+ * of the producers run with the interrupts disabled (the input FIFO ones of the LOG_FIFO_MODE built
+ * in, "STR fifo <mode>" at the start) delay it. Each stage ends with
+ *
+ *     STR jitter <stage> samples <n> min <ticks> p99 <ticks> max <ticks>
+ *
+ * and the jitter is the p99 and max latencies minus the min one, the cost of the interrupt entry.
+ */
+
+
+#include "log_stress.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if LOG_STRESS
+
+
+#if LOG_STRESS_N_TASKS + 2 >= configMAX_PRIORITIES
+#error "LOG_STRESS_N_TASKS producers and the stage task must have priorities above the log thread and below configMAX_PRIORITIES"
+#endif
+
+
+#define LOG_STRESS_N_PRODUCERS  (LOG_STRESS_N_TASKS + LOG_STRESS_ISR)
+#define LOG_STRESS_PRIORITY     (tskIDLE_PRIORITY + 2)          // Of the first producer task, osPriorityBelowNormal
+
+#if LOG_FIFO_MODE == LOG_FIFO_SPSC
+#error "The stage task and the producers all log, which LOG_FIFO_SPSC does not allow"
+#endif
+
+#if LOG_STRESS_JITTER && LOG_STRESS_JITTER_HZ * LOG_STRESS_STAGE_MS / 1000 > 0xFFFF
+#error "LOG_STRESS_JITTER_HZ times LOG_STRESS_STAGE_MS overflows the 16 bit bins of the jitter histogram"
+#endif
+
+
+typedef struct log_stress_producer_s
+{
+    uint32_t id;
+    uint32_t counter;
+    uint32_t credit;                                            // Events times the unit of stress_produce()
+} log_stress_producer_t;
+
+
+static log_stress_producer_t mProducers[LOG_STRESS_N_PRODUCERS];
+static volatile uint32_t mRate;                                 // Events per second of each producer
+static StaticTask_t mTaskCbs[LOG_STRESS_N_TASKS];
+static StackType_t mTaskStacks[LOG_STRESS_N_TASKS][LOG_STRESS_STACK_SIZE];
+#if LOG_STRESS_JITTER
+static volatile uint16_t mJitterBins[LOG_STRESS_JITTER_N_BINS];  // Stage samples by entry latency
+static volatile uint32_t mJitterMax;
+#endif
+
+
+// Must match stress_check() in Tools/log_stress.py
+static uint32_t stress_check(uint32_t id, uint32_t counter)
+{
+    uint32_t hash = (id * 0x9E3779B1UL + counter) * 0x85EBCA6BUL;
+
+    return hash ^ (hash >> 16);
+}
+
+
+// Adds rate * elapsed time to the credit, in units of 1 / unit second, and logs the events it covers
+static void stress_produce(log_stress_producer_t *pProducer, uint32_t elapsed, uint32_t unit)
+{
+    pProducer->credit += mRate * elapsed;
+    while(pProducer->credit >= unit)
+    {
+        pProducer->credit -= unit;
+        log_fmt("STR ", pProducer->id, " ", pProducer->counter, " ",
+                log_fmt_hex(stress_check(pProducer->id, pProducer->counter)), "\r\n");
+        pProducer->counter++;
+    }
+}
+
+
+static void stress_task(void *pArgument)
+{
+    log_stress_producer_t *pProducer = pArgument;
+    TickType_t last = xTaskGetTickCount();
+    TickType_t now;
+
+    for(;;)
+    {
+        vTaskDelay(1);
+        now = xTaskGetTickCount();
+        stress_produce(pProducer, now - last, configTICK_RATE_HZ);
+        last = now;
+    }
+}
+
+
+#if LOG_STRESS_ISR
+void log_stress_tim_irq_handler(void)
+{
+    if(!(TIM7->SR & TIM_SR_UIF))
+        return;
+    CLEAR_BIT(TIM7->SR, TIM_SR_UIF);
+    stress_produce(&mProducers[LOG_STRESS_N_TASKS], 1, LOG_STRESS_TIM_HZ);
+}
+
+
+// 1 MHz counter, so any LOG_STRESS_TIM_HZ dividing it is exact
+static void stress_tim_init(void)
+{
+    __HAL_RCC_TIM7_CLK_ENABLE();
+    TIM7->PSC  = SystemCoreClock / 1000000UL - 1;
+    TIM7->ARR  = 1000000UL / LOG_STRESS_TIM_HZ - 1;
+    TIM7->EGR  = TIM_EGR_UG;
+    TIM7->SR   = 0;
+    TIM7->DIER = TIM_DIER_UIE;
+    TIM7->CR1  = TIM_CR1_CEN;
+    HAL_NVIC_SetPriority(TIM7_LPTIM2_IRQn, LOG_STRESS_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(TIM7_LPTIM2_IRQn);
+}
+#endif
+
+
+#if LOG_STRESS_JITTER
+void log_stress_jitter_irq_handler(void)
+{
+    uint32_t latency = TIM6->CNT;
+
+    CLEAR_BIT(TIM6->SR, TIM_SR_UIF);
+    if(latency > mJitterMax)
+        mJitterMax = latency;
+    mJitterBins[(latency < LOG_STRESS_JITTER_N_BINS) ? latency : LOG_STRESS_JITTER_N_BINS - 1]++;
+}
+
+
+// Counts at the APB timer clock without prescaler, the core clock here, so a tick is a cycle
+static void stress_jitter_init(void)
+{
+    __HAL_RCC_TIM6_CLK_ENABLE();
+    TIM6->PSC  = 0;
+    TIM6->ARR  = SystemCoreClock / LOG_STRESS_JITTER_HZ - 1;
+    TIM6->EGR  = TIM_EGR_UG;
+    TIM6->SR   = 0;
+    TIM6->DIER = TIM_DIER_UIE;
+    TIM6->CR1  = TIM_CR1_CEN;
+    HAL_NVIC_SetPriority(TIM6_DAC_LPTIM1_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(TIM6_DAC_LPTIM1_IRQn);
+}
+
+
+// Logs the latencies of the stage and clears the histogram for the next one
+static void stress_jitter_report(uint32_t stage)
+{
+    uint32_t nSamples = 0;
+    uint32_t minLatency;
+    uint32_t p99 = 0;
+    uint32_t maxLatency;
+    uint32_t count = 0;
+    uint32_t i;
+
+    HAL_NVIC_DisableIRQ(TIM6_DAC_LPTIM1_IRQn);
+    for(i = 0; i < LOG_STRESS_JITTER_N_BINS; i++)
+        nSamples += mJitterBins[i];
+    i = 0;
+    while(i < LOG_STRESS_JITTER_N_BINS && !mJitterBins[i])
+        i++;
+    minLatency = (i < LOG_STRESS_JITTER_N_BINS) ? i : 0;
+    for(i = 0; i < LOG_STRESS_JITTER_N_BINS && count * 100 < nSamples * 99; i++)
+    {
+        count += mJitterBins[i];
+        p99 = i;
+    }
+    maxLatency = mJitterMax;
+    for(i = 0; i < LOG_STRESS_JITTER_N_BINS; i++)
+        mJitterBins[i] = 0;
+    mJitterMax = 0;
+    HAL_NVIC_EnableIRQ(TIM6_DAC_LPTIM1_IRQn);
+
+    log_fmt("STR jitter ", stage, " samples ", nSamples, " min ", minLatency, " p99 ", p99, " max ", maxLatency, "\r\n");
+}
+#endif
+
+
+/**
+ * Starts the producers and runs the stages from the calling task, then stops them and returns. The
+ * caller is raised above the producers, so that the stages last their time. It can only run once.
+ */
+void log_stress_run(void)
+{
+    uint32_t rate;
+    uint32_t i;
+
+    vTaskPrioritySet(NULL, LOG_STRESS_PRIORITY + LOG_STRESS_N_TASKS);
+    mRate = 0;
+    for(i = 0; i < LOG_STRESS_N_PRODUCERS; i++)
+    {
+        mProducers[i].id = i;
+        mProducers[i].counter = 0;
+        mProducers[i].credit = 0;
+    }
+    for(i = 0; i < LOG_STRESS_N_TASKS; i++)
+        xTaskCreateStatic(stress_task, "stress", LOG_STRESS_STACK_SIZE, &mProducers[i], LOG_STRESS_PRIORITY + i,
+                          mTaskStacks[i], &mTaskCbs[i]);
+#if LOG_STRESS_ISR
+    stress_tim_init();
+#endif
+#if LOG_STRESS_JITTER
+    log_fmt("STR fifo ", LOG_FIFO_MODE, "\r\n");
+    stress_jitter_init();
+#endif
+
+    for(i = 0; i < LOG_STRESS_N_STAGES; i++)
+    {
+        rate = (LOG_STRESS_START_RATE + i * LOG_STRESS_RATE_STEP) / LOG_STRESS_N_PRODUCERS;
+        log_fmt("STR stage ", i, " rate ", rate * LOG_STRESS_N_PRODUCERS, "\r\n");
+        mRate = rate;
+        vTaskDelay(pdMS_TO_TICKS(LOG_STRESS_STAGE_MS));
+#if LOG_STRESS_JITTER
+        stress_jitter_report(i);
+#endif
+    }
+    mRate = 0;
+#if LOG_STRESS_JITTER
+    TIM6->CR1 = 0;
+    HAL_NVIC_DisableIRQ(TIM6_DAC_LPTIM1_IRQn);
+#endif
+
+    vTaskDelay(pdMS_TO_TICKS(100));         // Producers preempted in stress_produce() end their line first
+    for(i = 0; i < LOG_STRESS_N_PRODUCERS; i++)
+        log_fmt("STR total ", i, " ", mProducers[i].counter, "\r\n");
+    log_fmt("STR end\r\n");
+    log_flush();
+}
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ * log_throughput.c
+ *
+ * End to end throughput of the logger, enabled with LOG_THROUGHPUT in log.h. The demo thread floods
+ * the logger with each mix of log calls for LOG_THROUGHPUT_MIX_MS at the idle priority, so that the
+ * log thread, vcp_th and the interrupts take all the CPU they need and the producer the rest: the
+ * output rate is then the one the pipeline sustains. The mix ends with log_flush(), which returns
+ * once vcp_flush() has drained the UART. Each one prints a line:
+ *
+ *     Throughput <mix> out <bytes/s> B/s line <%> format <%> <cycles/byte> cycles/B vcp_send <%> other <%> enqueued <items> dropped <items> vcp_dropped <bytes>
+ *
+ * where out counts the bytes vcp_send() accepted over the whole time, line is that rate against
+ * LOG_THROUGHPUT_LINE_BPS (the UART stage is the bottleneck near 100 %), format the share of the time
+ * the log thread spent in _log_flush() minus the output handler, vcp_send the share spent in
+ * vcp_send() copying into the input buffer, and other the rest (the producer, vcp_th, the UART
+ * interrupts and the kernel). dropped are the items lost at the input FIFOs and vcp_dropped the bytes
+ * that did not fit in the VCP input buffer. LOG_TIMESTAMP_GET() must count core cycles.
+ */
+
+
+#include "log_throughput.h"
+#include "vcp.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if LOG_THROUGHPUT
+
+
+#if !LOG_STATS
+#error "LOG_THROUGHPUT reads the input FIFO and flush counters of LOG_STATS"
+#endif
+
+
+#define LOG_THROUGHPUT_N_ELEM(x)    (sizeof(x)/sizeof((x)[0]))
+
+
+typedef struct log_throughput_mix_s
+{
+    const char *pName;
+    void      (*produce)(uint32_t i);
+} log_throughput_mix_t;
+
+
+typedef struct log_throughput_result_s
+{
+    uint32_t bytesPerSecond;
+    uint32_t linePermille;
+    uint32_t formatPermille;
+    uint32_t formatCyclesPerByte;
+    uint32_t sendPermille;
+    uint32_t nEnqueued;
+    uint32_t nDropped;
+    uint32_t vcpDropped;
+} log_throughput_result_t;
+
+
+static uint32_t mSendTicks;
+static uint32_t mSendBytes;
+static const uint32_t mWords[8] = {0, 0x2A, 0x1234, 0xBEEF, 0x10000, 0xC0FFEE, 0x7FFFFFFF, 0xFFFFFFFF};
+
+
+// Output handler of the mixes, vcp_send() timed
+static void throughput_send(void *pData, uint32_t length)
+{
+    uint32_t start = LOG_TIMESTAMP_GET();
+
+    vcp_send(pData, length);
+    mSendTicks += LOG_TIMESTAMP_GET() - start;
+    mSendBytes += length;
+}
+
+
+static void mix_strings(uint32_t i)
+{
+    (void)i;
+    log_str("The quick brown fox jumps over the lazy dog\r\n");
+}
+
+
+static void mix_decimals(uint32_t i)
+{
+    log_dec(i);
+    log_char(' ');
+    log_dec(-(int32_t)i);
+    log_char(' ');
+    log_dec(i * 2654435761UL);
+    log_str("\r\n");
+}
+
+
+static void mix_hex_arrays(uint32_t i)
+{
+    (void)i;
+    log_array_hex(mWords, LOG_THROUGHPUT_N_ELEM(mWords));
+    log_str("\r\n");
+}
+
+
+static void mix_colored(uint32_t i)
+{
+    log_str("red ", LOG_COLOR_RED);
+    log_dec(i, LOG_COLOR_GREEN);
+    log_str(" blue\r\n", LOG_COLOR_BLUE);
+}
+
+
+static const log_throughput_mix_t mMixes[] =
+{
+    {"strings",    mix_strings},
+    {"decimals",   mix_decimals},
+    {"hex_arrays", mix_hex_arrays},
+    {"colored",    mix_colored},
+};
+
+
+static uint32_t throughput_permille(uint32_t ticks, uint32_t elapsed)
+{
+    return elapsed ? (uint32_t)((uint64_t)ticks * 1000 / elapsed) : 0;
+}
+
+
+static void throughput_mix(const log_throughput_mix_t *pMix, log_throughput_result_t *pResult)
+{
+    uint32_t cycles = LOG_THROUGHPUT_MIX_MS * (SystemCoreClock / 1000);
+    uint32_t vcpDropped = vcp_get_dropped_bytes();
+    log_stats_t stats;
+    uint32_t elapsed;
+    uint32_t start;
+    uint32_t i = 0;
+
+    vTaskSuspendAll();                  // The log thread must not run while log_init() resets the FIFOs
+    log_init(throughput_send, vcp_flush);
+    xTaskResumeAll();
+    mSendTicks = 0;
+    mSendBytes = 0;
+    start = LOG_TIMESTAMP_GET();
+    while(LOG_TIMESTAMP_GET() - start < cycles)
+        pMix->produce(i++);
+    log_flush();
+    elapsed = LOG_TIMESTAMP_GET() - start;
+
+    log_get_stats(&stats);
+    pResult->vcpDropped = vcp_get_dropped_bytes() - vcpDropped;
+    pResult->bytesPerSecond = elapsed ? (uint32_t)((uint64_t)(mSendBytes - pResult->vcpDropped) * SystemCoreClock / elapsed) : 0;
+    pResult->linePermille = (uint32_t)((uint64_t)pResult->bytesPerSecond * 10 * 1000 / LOG_THROUGHPUT_LINE_BPS);
+    pResult->formatPermille = throughput_permille(stats.flushTicks - mSendTicks, elapsed);
+    pResult->formatCyclesPerByte = stats.nBytesOut ? (stats.flushTicks - mSendTicks) / stats.nBytesOut : 0;
+    pResult->sendPermille = throughput_permille(mSendTicks, elapsed);
+    pResult->nEnqueued = stats.nEnqueued;
+    pResult->nDropped = stats.nDropped;
+}
+
+
+static void throughput_print_share(const char *pLabel, uint32_t permille)
+{
+    _log_str((char*)pLabel, strlen(pLabel), LOG_COLOR_NONE);
+    log_dec(permille / 10);
+    log_char('.');
+    log_dec(permille % 10);
+    log_str(" %");
+}
+
+
+static void throughput_print(const char *pName, const log_throughput_result_t *pResult)
+{
+    uint32_t busy = pResult->formatPermille + pResult->sendPermille;
+
+    log_str("Throughput ");
+    _log_str((char*)pName, strlen(pName), LOG_COLOR_NONE);
+    log_str(" out ");
+    log_dec(pResult->bytesPerSecond);
+    log_str(" B/s");
+    throughput_print_share(" line ", pResult->linePermille);
+    throughput_print_share(" format ", pResult->formatPermille);
+    log_char(' ');
+    log_dec(pResult->formatCyclesPerByte);
+    log_str(" cycles/B");
+    throughput_print_share(" vcp_send ", pResult->sendPermille);
+    throughput_print_share(" other ", (busy < 1000) ? 1000 - busy : 0);
+    log_str(" enqueued ");
+    log_dec(pResult->nEnqueued);
+    log_str(" dropped ");
+    log_dec(pResult->nDropped);
+    log_str(" vcp_dropped ");
+    log_dec(pResult->vcpDropped);
+    log_str("\r\n");
+}
+
+
+/**
+ * Runs the mixes one after the other from the calling task, then prints their lines to vcp_send()
+ * and returns. The caller is lowered to the idle priority meanwhile, the items logged before are
+ * sent first.
+ */
+void log_throughput_run(void)
+{
+    log_throughput_result_t results[LOG_THROUGHPUT_N_ELEM(mMixes)];
+    UBaseType_t priority = uxTaskPriorityGet(NULL);
+    uint32_t i;
+
+    log_flush();
+    vTaskPrioritySet(NULL, tskIDLE_PRIORITY);
+    for(i = 0; i < LOG_THROUGHPUT_N_ELEM(mMixes); i++)
+        throughput_mix(&mMixes[i], &results[i]);
+    vTaskSuspendAll();
+    log_init(vcp_send, vcp_flush);
+    xTaskResumeAll();
+    vTaskPrioritySet(NULL, priority);
+
+    log_str("\r\nLogger throughput, ");
+    log_dec(LOG_THROUGHPUT_MIX_MS);
+    log_str(" ms per mix, shares of the elapsed time\r\n");
+    for(i = 0; i < LOG_THROUGHPUT_N_ELEM(mMixes); i++)
+        throughput_print(mMixes[i].pName, &results[i]);
+    log_flush();
+}
+
+#endif
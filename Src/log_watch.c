@@ -0,0 +1,123 @@
+/*
+ * log_watch.c
+ *
+ * Watch list of variables that the log thread samples itself, enabled with LOG_WATCH in log.h. The
+ * tasks that own them do nothing for their trends: at each wakeup the log thread reads the variables
+ * whose period is over and logs them on one line, "Watch: index=value ...", the index being the one
+ * of the variable in the order of the log_watch() calls. A sample is a plain read, a variable wider
+ * than the bus or updated in several steps may be seen half written.
+ */
+
+
+#include "log_watch.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if LOG_WATCH
+
+
+typedef struct log_watch_s
+{
+    const volatile void *pVar;          // NULL if the entry is free
+    TickType_t           period;
+    TickType_t           last;          // Tick of the previous sample
+    uint8_t              size;
+    uint8_t              type;          // enum log_data_type of the value
+} log_watch_t;
+
+
+static log_watch_t          mWatches[LOG_WATCH_N_VARS];
+
+
+static uint32_t watch_read(const log_watch_t *pWatch)
+{
+    switch(pWatch->size)
+    {
+    case 1:
+        return (pWatch->type == _LOG_UINT_DEC) ? *(const volatile uint8_t*)pWatch->pVar :
+                                                 (uint32_t)*(const volatile int8_t*)pWatch->pVar;
+    case 2:
+        return (pWatch->type == _LOG_UINT_DEC) ? *(const volatile uint16_t*)pWatch->pVar :
+                                                 (uint32_t)*(const volatile int16_t*)pWatch->pVar;
+    default:
+        return *(const volatile uint32_t*)pWatch->pVar;
+    }
+}
+
+
+// The entry is filled with the scheduler suspended, the log thread never sees it half set
+bool _log_watch(const volatile void *pVar, uint32_t size, enum log_data_type type, uint32_t periodMs)
+{
+    bool isAdded = false;
+    uint32_t i;
+
+    if(!pVar || size > sizeof(uint32_t))
+        return false;
+
+    vTaskSuspendAll();
+    for(i = 0; i < LOG_WATCH_N_VARS && !isAdded; i++)
+    {
+        if(mWatches[i].pVar)
+            continue;
+        mWatches[i].period = pdMS_TO_TICKS(periodMs);
+        mWatches[i].last   = xTaskGetTickCount() - mWatches[i].period;  // First sample at the next wakeup
+        mWatches[i].size   = size;
+        mWatches[i].type   = type;
+        mWatches[i].pVar   = pVar;
+        isAdded = true;
+    }
+    xTaskResumeAll();
+    return isAdded;
+}
+
+
+void log_unwatch(const volatile void *pVar)
+{
+    uint32_t i;
+
+    for(i = 0; i < LOG_WATCH_N_VARS; i++)
+    {
+        if(mWatches[i].pVar == pVar)
+            mWatches[i].pVar = NULL;
+    }
+}
+
+
+// Returns false if no variable is watched at that index
+bool log_watch_set_period(uint32_t index, uint32_t periodMs)
+{
+    if(index >= LOG_WATCH_N_VARS || !mWatches[index].pVar)
+        return false;
+    mWatches[index].period = pdMS_TO_TICKS(periodMs);
+    return true;
+}
+
+
+void _log_watch_poll(void)
+{
+    TickType_t now = xTaskGetTickCount();
+    bool isLineStarted = false;
+    uint32_t i;
+
+    for(i = 0; i < LOG_WATCH_N_VARS; i++)
+    {
+        if(!mWatches[i].pVar || now - mWatches[i].last < mWatches[i].period)
+            continue;
+        mWatches[i].last = now;
+
+        if(!isLineStarted)
+        {
+            _log_str("Watch:", 6, LOG_COLOR_NONE);
+            isLineStarted = true;
+        }
+        _log_char(' ', LOG_COLOR_NONE);
+        _log_var(i, _LOG_UINT_DEC, LOG_COLOR_NONE);
+        _log_char('=', LOG_COLOR_NONE);
+        _log_var(watch_read(&mWatches[i]), mWatches[i].type, LOG_COLOR_NONE);
+    }
+    if(isLineStarted)
+        _log_str("\r\n", 2, LOG_COLOR_NONE);
+}
+
+
+#endif
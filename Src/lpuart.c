@@ -0,0 +1,229 @@
+/*
+ * lpuart.c
+ *
+ * Log backend that sends the output through LPUART1 with DMA. Its kernel clock is HSI or LSE, which
+ * the LPUART can keep requesting in STOP mode, so the bytes already in its 8 byte TX FIFO keep going
+ * out while the core is stopped. The DMA only runs in RUN and SLEEP modes, lpuart_pre_sleep() holds
+ * off the low power modes until it has moved the whole ring into the FIFO. PA2 is the TX pin of
+ * USART2 too, so the output still reaches the ST-LINK virtual COM port.
+ */
+
+
+#include "lpuart.h"
+#include "log.h"
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+#if LPUART_BACKEND && LOG_IDLE_HOOK_ITEMS && (LOG_DRAIN_BACKEND || LOG_HISTORY_SIZE)
+#error "lpuart_flush() sleeps until the ring is sent, log_idle_hook() cannot call it from the idle task"
+#endif
+
+
+static UART_HandleTypeDef   mHlpuart;
+static DMA_HandleTypeDef    mHdmaTx;
+static uint8_t              mRing[LPUART_BUFFER_SIZE];
+static volatile uint32_t    mWrIdx = 0;                     // Free running indexes
+static volatile uint32_t    mRdIdx = 0;
+static volatile uint32_t    mInFlight = 0;                  // Ring bytes being sent by DMA
+static uint32_t             mDroppedBytes = 0;
+static bool                 mIsReady = false;
+
+
+// Starts the DMA of the ring up to its wrap if none is ongoing, with the DMA interrupt masked or from it
+static void lpuart_start(void)
+{
+    uint32_t rdIdx = mRdIdx & (LPUART_BUFFER_SIZE - 1);
+    uint32_t nUsed = mWrIdx - mRdIdx;
+    uint32_t toEnd = LPUART_BUFFER_SIZE - rdIdx;
+
+    if(mInFlight || !nUsed)
+        return;
+
+    mInFlight = (nUsed < toEnd) ? nUsed : toEnd;
+    if(HAL_DMA_Start_IT(&mHdmaTx, (uint32_t)&mRing[rdIdx], (uint32_t)&mHlpuart.Instance->TDR, mInFlight) == HAL_OK)
+        SET_BIT(mHlpuart.Instance->CR3, USART_CR3_DMAT);
+    else
+    {
+        mDroppedBytes += mInFlight;
+        mRdIdx += mInFlight;
+        mInFlight = 0;
+    }
+}
+
+
+static void lpuart_dma_done(DMA_HandleTypeDef *hdma)
+{
+    CLEAR_BIT(mHlpuart.Instance->CR3, USART_CR3_DMAT);
+    mRdIdx += mInFlight;
+    mInFlight = 0;
+    lpuart_start();
+}
+
+
+void lpuart_dma_irq_handler(void)
+{
+    HAL_DMA_IRQHandler(&mHdmaTx);
+}
+
+
+// Copies what fits into the ring, the rest is dropped
+void lpuart_send(void* pData, uint32_t nBytes)
+{
+    uint32_t wrIdx = mWrIdx & (LPUART_BUFFER_SIZE - 1);
+    uint32_t nFree = LPUART_BUFFER_SIZE - (mWrIdx - mRdIdx);
+    uint32_t toEnd = LPUART_BUFFER_SIZE - wrIdx;
+    uint32_t primaskBit;
+
+    if(!mIsReady)
+        return;
+    if(nBytes > nFree)
+    {
+        mDroppedBytes += nBytes - nFree;
+        nBytes = nFree;
+    }
+    if(nBytes > toEnd)
+    {
+        memcpy(&mRing[wrIdx], pData, toEnd);
+        memcpy(mRing, (const uint8_t*)pData + toEnd, nBytes - toEnd);
+    }
+    else
+        memcpy(&mRing[wrIdx], pData, nBytes);
+
+    primaskBit = __get_PRIMASK();
+    __disable_irq();
+    mWrIdx += nBytes;
+    lpuart_start();
+    __set_PRIMASK(primaskBit);
+}
+
+
+// Waits until the ring and the LPUART are empty, sleeping if the caller is a task
+void lpuart_flush(void)
+{
+    if(!mIsReady)
+        return;
+
+    if(!__get_PRIMASK() && !__get_IPSR() && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+    {
+        while(mWrIdx != mRdIdx)
+            vTaskDelay(1);
+    }
+    else
+    {
+        while(mWrIdx != mRdIdx)
+            HAL_DMA_IRQHandler(&mHdmaTx);
+    }
+    while(!(mHlpuart.Instance->ISR & USART_ISR_TC));
+}
+
+
+bool lpuart_is_ready(void)
+{
+    return LPUART_BUFFER_SIZE - (mWrIdx - mRdIdx) >= LPUART_READY_MIN_FREE;
+}
+
+
+uint32_t lpuart_get_dropped_bytes(void)
+{
+    return mDroppedBytes;
+}
+
+
+static void lpuart_panic_write(const uint8_t *pData, uint32_t nBytes)
+{
+    while(nBytes--)
+    {
+        while(!(mHlpuart.Instance->ISR & USART_ISR_TXE_TXFNF));
+        mHlpuart.Instance->TDR = *pData++;
+    }
+}
+
+
+// The DMA is stopped and the ring sent first by polling, the part of it in flight may be repeated
+void lpuart_panic_send(void* pData, uint32_t nBytes)
+{
+    uint32_t rdIdx;
+    uint32_t toEnd;
+
+    if(!mIsReady)                       // Not initialized, polling would never end
+        return;
+
+    CLEAR_BIT(mHlpuart.Instance->CR3, USART_CR3_DMAT);
+    HAL_DMA_Abort(&mHdmaTx);
+    mInFlight = 0;
+    while(mWrIdx != mRdIdx)
+    {
+        rdIdx = mRdIdx & (LPUART_BUFFER_SIZE - 1);
+        toEnd = LPUART_BUFFER_SIZE - rdIdx;
+        if(toEnd > mWrIdx - mRdIdx)
+            toEnd = mWrIdx - mRdIdx;
+        lpuart_panic_write(&mRing[rdIdx], toEnd);
+        mRdIdx += toEnd;
+    }
+
+    lpuart_panic_write(pData, nBytes);
+    while(!(mHlpuart.Instance->ISR & USART_ISR_TC));
+}
+
+
+// Cancels the sleep while the DMA still has bytes to move, the TX FIFO drains by itself in STOP mode
+void lpuart_pre_sleep(uint32_t *pIdleTime)
+{
+    if(mWrIdx != mRdIdx)
+        *pIdleTime = 0;
+}
+
+
+void lpuart_init(void)
+{
+    GPIO_InitTypeDef gpio = {.Pin = GPIO_PIN_2, .Mode = GPIO_MODE_AF_PP, .Pull = GPIO_NOPULL,
+                             .Speed = GPIO_SPEED_FREQ_LOW, .Alternate = GPIO_AF6_LPUART1};
+
+    static_assert(!(LPUART_BUFFER_SIZE & (LPUART_BUFFER_SIZE - 1)), "LPUART buffer size must be power of 2");
+    mWrIdx = 0;
+    mRdIdx = 0;
+    mInFlight = 0;
+    mDroppedBytes = 0;
+
+    __HAL_RCC_LPUART1_CONFIG(LPUART_CLK_SOURCE);
+    __HAL_RCC_LPUART1_CLK_ENABLE();
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    HAL_GPIO_Init(GPIOA, &gpio);        // Taken over from USART2
+
+    mHlpuart.Instance            = LPUART1;
+    mHlpuart.Init.BaudRate       = LPUART_BAUDRATE;
+    mHlpuart.Init.WordLength     = UART_WORDLENGTH_8B;
+    mHlpuart.Init.StopBits       = UART_STOPBITS_1;
+    mHlpuart.Init.Parity         = UART_PARITY_NONE;
+    mHlpuart.Init.Mode           = UART_MODE_TX;
+    mHlpuart.Init.HwFlowCtl      = UART_HWCONTROL_NONE;
+    mHlpuart.Init.OverSampling   = UART_OVERSAMPLING_16;
+    mHlpuart.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
+    mHlpuart.Init.ClockPrescaler = UART_PRESCALER_DIV1;
+    mHlpuart.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
+    if(HAL_UART_Init(&mHlpuart) != HAL_OK)
+        return;
+    HAL_UARTEx_EnableFifoMode(&mHlpuart);
+    HAL_UARTEx_EnableStopMode(&mHlpuart);   // Keeps requesting its kernel clock in STOP mode
+
+    mHdmaTx.Instance                 = LPUART_DMA_CHANNEL;
+    mHdmaTx.Init.Request             = LPUART_DMA_REQUEST;
+    mHdmaTx.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+    mHdmaTx.Init.PeriphInc           = DMA_PINC_DISABLE;
+    mHdmaTx.Init.MemInc              = DMA_MINC_ENABLE;
+    mHdmaTx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    mHdmaTx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    mHdmaTx.Init.Mode                = DMA_NORMAL;
+    mHdmaTx.Init.Priority            = DMA_PRIORITY_LOW;
+    HAL_DMA_Init(&mHdmaTx);
+    mHdmaTx.XferCpltCallback = lpuart_dma_done;
+
+    HAL_NVIC_SetPriority(LPUART_DMA_IRQn, LPUART_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(LPUART_DMA_IRQn);
+    mIsReady = true;
+}
@@ -0,0 +1,153 @@
+/*
+ * rtt.c
+ *
+ * Log backend with the memory layout of SEGGER RTT: a control block in RAM that the debug probe
+ * finds by its ID and an up buffer it reads over SWD while the target runs. Sending is a copy into
+ * the ring, there is neither UART nor thread involved, and any RTT viewer (J-Link, OpenOCD,
+ * probe-rs) shows the output of channel 0. Only one writer is expected, the logger thread or
+ * log_panic_flush() once the system is halting.
+ */
+
+
+#include "rtt.h"
+#include <stdint.h>
+#include <string.h>
+
+
+#define RTT_ID                      "SEGGER RTT"
+#define RTT_ID_SIZE                 16
+#define RTT_MODE_MASK               3
+
+
+typedef struct rtt_buffer_s
+{
+    const char          *sName;
+    uint8_t             *pBuffer;
+    uint32_t            size;
+    volatile uint32_t   wrOff;                  // Written by the target
+    volatile uint32_t   rdOff;                  // Written by the probe
+    volatile uint32_t   flags;
+} rtt_buffer_t;
+
+
+// Searched in RAM by the probe, the field layout must not change
+typedef struct rtt_cb_s
+{
+    volatile char       id[RTT_ID_SIZE];
+    int32_t             maxNumUpBuffers;
+    int32_t             maxNumDownBuffers;
+    rtt_buffer_t        up[1];
+    rtt_buffer_t        down[1];
+} rtt_cb_t;
+
+
+static uint8_t              mUpBuffer[RTT_UP_BUFFER_SIZE];
+static rtt_cb_t             mCb;
+static uint32_t             mDroppedBytes = 0;
+
+
+static inline uint32_t rtt_free(void)
+{
+    uint32_t rdOff = mCb.up[0].rdOff;
+    uint32_t wrOff = mCb.up[0].wrOff;
+
+    return (rdOff > wrOff) ? rdOff - wrOff - 1 : RTT_UP_BUFFER_SIZE - 1 - wrOff + rdOff;
+}
+
+
+// Copies into the ring, wrOff is only published once the bytes are in place
+static void rtt_write(const uint8_t *pData, uint32_t nBytes)
+{
+    uint32_t wrOff = mCb.up[0].wrOff;
+    uint32_t nChunk = RTT_UP_BUFFER_SIZE - wrOff;
+
+    if(nChunk > nBytes)
+        nChunk = nBytes;
+
+    memcpy(&mUpBuffer[wrOff], pData, nChunk);
+    memcpy(mUpBuffer, &pData[nChunk], nBytes - nChunk);
+    wrOff += nBytes;
+    if(wrOff >= RTT_UP_BUFFER_SIZE)
+        wrOff -= RTT_UP_BUFFER_SIZE;
+
+    __DMB();
+    mCb.up[0].wrOff = wrOff;
+}
+
+
+void rtt_send(void* pData, uint32_t nBytes)
+{
+    const uint8_t *pBytes = pData;
+    uint32_t nFree;
+
+    switch(mCb.up[0].flags & RTT_MODE_MASK)
+    {
+    case RTT_MODE_SKIP:
+        if(rtt_free() < nBytes)
+        {
+            mDroppedBytes += nBytes;
+            return;
+        }
+        rtt_write(pBytes, nBytes);
+        break;
+
+    case RTT_MODE_BLOCK:
+        while(nBytes)
+        {
+            nFree = rtt_free();
+            if(nFree > nBytes)
+                nFree = nBytes;
+
+            rtt_write(pBytes, nFree);
+            pBytes += nFree;
+            nBytes -= nFree;
+        }
+        break;
+
+    default:
+        nFree = rtt_free();
+        if(nFree < nBytes)
+        {
+            mDroppedBytes += nBytes - nFree;
+            nBytes = nFree;
+        }
+        rtt_write(pBytes, nBytes);
+        break;
+    }
+}
+
+
+bool rtt_is_ready(void)
+{
+    return rtt_free() >= RTT_READY_MIN_FREE;
+}
+
+
+uint32_t rtt_get_dropped_bytes(void)
+{
+    return mDroppedBytes;
+}
+
+
+// The ID is written last and in reverse, so the probe never finds a half initialized control block
+void rtt_init(void)
+{
+    static const char id[] = RTT_ID;
+    int32_t i;
+
+    mCb.maxNumUpBuffers   = 1;
+    mCb.maxNumDownBuffers = 1;
+    mCb.up[0].sName   = "Terminal";
+    mCb.up[0].pBuffer = mUpBuffer;
+    mCb.up[0].size    = RTT_UP_BUFFER_SIZE;
+    mCb.up[0].wrOff   = 0;
+    mCb.up[0].rdOff   = 0;
+    mCb.up[0].flags   = RTT_MODE;
+    memset(&mCb.down[0], 0, sizeof(mCb.down[0]));   // No down buffer: zero size, the probe can not write
+
+    for(i = RTT_ID_SIZE - 1; i >= 0; i--)
+    {
+        __DMB();
+        mCb.id[i] = (i < (int32_t)sizeof(id)) ? id[i] : '\0';
+    }
+}
@@ -0,0 +1,281 @@
+/*
+ * spi_log.c
+ *
+ * Log backend that sends the output through SPI1 with DMA, transmit only, at up to PCLK / 2 (32 MHz).
+ * The target is the master, so the receiver is a logic analyzer or a USB bridge in SPI slave mode
+ * sampling SCK and MOSI, with CS low while a DMA transfer is ongoing. There is no idle pattern to
+ * tell the bytes apart from the captures of other traffic, so each send is cut into frames of the
+ * sync bytes, the 16 bit payload length and the payload. Frames that do not fit in the ring are
+ * dropped whole, a decoder joining at any point finds the next sync bytes and stays aligned.
+ */
+
+
+#include "spi_log.h"
+#include "lpuart.h"
+#include "log.h"
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+#if SPI_LOG_BACKEND && LPUART_BACKEND
+#error "SPI_LOG_BACKEND and LPUART_BACKEND share DMA1_Channel2_3_IRQHandler()"
+#endif
+#if SPI_LOG_BACKEND && LOG_IDLE_HOOK_ITEMS && (LOG_DRAIN_BACKEND || LOG_HISTORY_SIZE)
+#error "spi_log_flush() sleeps until the ring is sent, log_idle_hook() cannot call it from the idle task"
+#endif
+
+
+#define SPI_LOG_SPI                 SPI1
+#define SPI_LOG_CS_PORT             GPIOA
+#define SPI_LOG_CS_PIN              GPIO_PIN_4
+#define SPI_LOG_DR8                 (*(volatile uint8_t*)&SPI_LOG_SPI->DR)  // 8 bit access, no data packing
+
+
+static DMA_HandleTypeDef    mHdmaTx;
+static uint8_t              mRing[SPI_LOG_BUFFER_SIZE];
+static volatile uint32_t    mWrIdx = 0;                     // Free running indexes
+static volatile uint32_t    mRdIdx = 0;
+static volatile uint32_t    mInFlight = 0;                  // Ring bytes being sent by DMA
+static uint32_t             mDroppedBytes = 0;
+static bool                 mIsReady = false;
+
+
+static inline void spi_log_wait_idle(void)
+{
+    while(SPI_LOG_SPI->SR & (SPI_SR_FTLVL | SPI_SR_BSY));
+}
+
+
+// Starts the DMA of the ring up to its wrap if none is ongoing, with the DMA interrupt masked or from it
+static void spi_log_start(void)
+{
+    uint32_t rdIdx = mRdIdx & (SPI_LOG_BUFFER_SIZE - 1);
+    uint32_t nUsed = mWrIdx - mRdIdx;
+    uint32_t toEnd = SPI_LOG_BUFFER_SIZE - rdIdx;
+
+    if(mInFlight || !nUsed)
+        return;
+
+    mInFlight = (nUsed < toEnd) ? nUsed : toEnd;
+    SPI_LOG_CS_PORT->BRR = SPI_LOG_CS_PIN;
+    if(HAL_DMA_Start_IT(&mHdmaTx, (uint32_t)&mRing[rdIdx], (uint32_t)&SPI_LOG_SPI->DR, mInFlight) != HAL_OK)
+    {
+        mDroppedBytes += mInFlight;
+        mRdIdx += mInFlight;
+        mInFlight = 0;
+    }
+}
+
+
+// The last bytes are still in the SPI FIFO when the DMA completes, CS is released once they are out
+static void spi_log_dma_done(DMA_HandleTypeDef *hdma)
+{
+    mRdIdx += mInFlight;
+    mInFlight = 0;
+    spi_log_start();
+    if(!mInFlight)
+    {
+        spi_log_wait_idle();
+        SPI_LOG_CS_PORT->BSRR = SPI_LOG_CS_PIN;
+    }
+}
+
+
+void spi_log_dma_irq_handler(void)
+{
+    HAL_DMA_IRQHandler(&mHdmaTx);
+}
+
+
+static void spi_log_copy(uint32_t wrIdx, const void *pData, uint32_t nBytes)
+{
+    uint32_t toEnd;
+
+    wrIdx &= SPI_LOG_BUFFER_SIZE - 1;
+    toEnd = SPI_LOG_BUFFER_SIZE - wrIdx;
+    if(nBytes > toEnd)
+    {
+        memcpy(&mRing[wrIdx], pData, toEnd);
+        memcpy(mRing, (const uint8_t*)pData + toEnd, nBytes - toEnd);
+    }
+    else
+        memcpy(&mRing[wrIdx], pData, nBytes);
+}
+
+
+static inline void spi_log_header(uint8_t *pHdr, uint32_t nBytes)
+{
+    pHdr[0] = SPI_LOG_SYNC_0;
+    pHdr[1] = SPI_LOG_SYNC_1;
+    pHdr[2] = (uint8_t)nBytes;
+    pHdr[3] = (uint8_t)(nBytes >> 8);
+}
+
+
+// Copies the frames that fit into the ring, one per SPI_LOG_FRAME_MAX bytes of payload
+void spi_log_send(void* pData, uint32_t nBytes)
+{
+    const uint8_t *pBytes = pData;
+    uint8_t hdr[SPI_LOG_HDR_SIZE];
+    uint32_t wrIdx = mWrIdx;
+    uint32_t nChunk;
+    uint32_t primaskBit;
+
+    if(!mIsReady)
+        return;
+
+    while(nBytes)
+    {
+        nChunk = (nBytes < SPI_LOG_FRAME_MAX) ? nBytes : SPI_LOG_FRAME_MAX;
+        if(SPI_LOG_BUFFER_SIZE - (wrIdx - mRdIdx) < SPI_LOG_HDR_SIZE + nChunk)
+        {
+            mDroppedBytes += nBytes;
+            break;
+        }
+
+        spi_log_header(hdr, nChunk);
+        spi_log_copy(wrIdx, hdr, SPI_LOG_HDR_SIZE);
+        spi_log_copy(wrIdx + SPI_LOG_HDR_SIZE, pBytes, nChunk);
+        wrIdx  += SPI_LOG_HDR_SIZE + nChunk;
+        pBytes += nChunk;
+        nBytes -= nChunk;
+    }
+
+    primaskBit = __get_PRIMASK();
+    __disable_irq();
+    mWrIdx = wrIdx;
+    spi_log_start();
+    __set_PRIMASK(primaskBit);
+}
+
+
+// Waits until the ring and the SPI are empty, sleeping if the caller is a task
+void spi_log_flush(void)
+{
+    if(!mIsReady)
+        return;
+
+    if(!__get_PRIMASK() && !__get_IPSR() && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+    {
+        while(mWrIdx != mRdIdx)
+            vTaskDelay(1);
+    }
+    else
+    {
+        while(mWrIdx != mRdIdx)
+            HAL_DMA_IRQHandler(&mHdmaTx);
+    }
+    spi_log_wait_idle();
+}
+
+
+bool spi_log_is_ready(void)
+{
+    return SPI_LOG_BUFFER_SIZE - (mWrIdx - mRdIdx) >= SPI_LOG_READY_MIN_FREE;
+}
+
+
+uint32_t spi_log_get_dropped_bytes(void)
+{
+    return mDroppedBytes;
+}
+
+
+static void spi_log_panic_write(const uint8_t *pData, uint32_t nBytes)
+{
+    while(nBytes--)
+    {
+        while(!(SPI_LOG_SPI->SR & SPI_SR_TXE));
+        SPI_LOG_DR8 = *pData++;
+    }
+}
+
+
+// The DMA is stopped and the ring sent first by polling. The part of it in flight may be repeated,
+// the decoder then loses the frames around the cut and resyncs on the next sync bytes.
+void spi_log_panic_send(void* pData, uint32_t nBytes)
+{
+    const uint8_t *pBytes = pData;
+    uint8_t hdr[SPI_LOG_HDR_SIZE];
+    uint32_t rdIdx;
+    uint32_t nChunk;
+
+    if(!mIsReady)                       // Not initialized, polling would never end
+        return;
+
+    HAL_DMA_Abort(&mHdmaTx);
+    CLEAR_BIT(SPI_LOG_SPI->CR2, SPI_CR2_TXDMAEN);
+    mInFlight = 0;
+    SPI_LOG_CS_PORT->BRR = SPI_LOG_CS_PIN;
+    while(mWrIdx != mRdIdx)
+    {
+        rdIdx = mRdIdx & (SPI_LOG_BUFFER_SIZE - 1);
+        nChunk = SPI_LOG_BUFFER_SIZE - rdIdx;
+        if(nChunk > mWrIdx - mRdIdx)
+            nChunk = mWrIdx - mRdIdx;
+        spi_log_panic_write(&mRing[rdIdx], nChunk);
+        mRdIdx += nChunk;
+    }
+
+    while(nBytes)
+    {
+        nChunk = (nBytes < SPI_LOG_FRAME_MAX) ? nBytes : SPI_LOG_FRAME_MAX;
+        spi_log_header(hdr, nChunk);
+        spi_log_panic_write(hdr, SPI_LOG_HDR_SIZE);
+        spi_log_panic_write(pBytes, nChunk);
+        pBytes += nChunk;
+        nBytes -= nChunk;
+    }
+    spi_log_wait_idle();
+    SPI_LOG_CS_PORT->BSRR = SPI_LOG_CS_PIN;
+}
+
+
+// Master, transmit only on the MOSI line (no RX FIFO overruns), mode 0, 8 bit, MSB first
+void spi_log_init(void)
+{
+    GPIO_InitTypeDef gpio = {.Pin = GPIO_PIN_3 | GPIO_PIN_5, .Mode = GPIO_MODE_AF_PP, .Pull = GPIO_NOPULL,
+                             .Speed = GPIO_SPEED_FREQ_VERY_HIGH, .Alternate = GPIO_AF0_SPI1};
+    GPIO_InitTypeDef gpioCs = {.Pin = SPI_LOG_CS_PIN, .Mode = GPIO_MODE_OUTPUT_PP, .Pull = GPIO_NOPULL,
+                               .Speed = GPIO_SPEED_FREQ_HIGH};
+
+    static_assert(!(SPI_LOG_BUFFER_SIZE & (SPI_LOG_BUFFER_SIZE - 1)), "SPI log buffer size must be power of 2");
+    static_assert(SPI_LOG_FRAME_MAX <= 0xFFFF && SPI_LOG_HDR_SIZE + SPI_LOG_FRAME_MAX <= SPI_LOG_BUFFER_SIZE,
+                  "SPI log frames must fit in the 16 bit length and in the ring");
+    mWrIdx = 0;
+    mRdIdx = 0;
+    mInFlight = 0;
+    mDroppedBytes = 0;
+
+    __HAL_RCC_SPI1_CLK_ENABLE();
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    SPI_LOG_CS_PORT->BSRR = SPI_LOG_CS_PIN;
+    HAL_GPIO_Init(SPI_LOG_CS_PORT, &gpioCs);
+    HAL_GPIO_Init(GPIOB, &gpio);
+
+    SPI_LOG_SPI->CR1 = SPI_CR1_BIDIMODE | SPI_CR1_BIDIOE | SPI_CR1_SSM | SPI_CR1_SSI | SPI_CR1_MSTR |
+                       (SPI_LOG_BAUDRATE_PRESCALER << SPI_CR1_BR_Pos);
+    SPI_LOG_SPI->CR2 = (7UL << SPI_CR2_DS_Pos) | SPI_CR2_TXDMAEN;
+    SET_BIT(SPI_LOG_SPI->CR1, SPI_CR1_SPE);
+
+    mHdmaTx.Instance                 = SPI_LOG_DMA_CHANNEL;
+    mHdmaTx.Init.Request             = SPI_LOG_DMA_REQUEST;
+    mHdmaTx.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+    mHdmaTx.Init.PeriphInc           = DMA_PINC_DISABLE;
+    mHdmaTx.Init.MemInc              = DMA_MINC_ENABLE;
+    mHdmaTx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    mHdmaTx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    mHdmaTx.Init.Mode                = DMA_NORMAL;
+    mHdmaTx.Init.Priority            = DMA_PRIORITY_LOW;
+    HAL_DMA_Init(&mHdmaTx);
+    mHdmaTx.XferCpltCallback = spi_log_dma_done;
+
+    HAL_NVIC_SetPriority(SPI_LOG_DMA_IRQn, SPI_LOG_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(SPI_LOG_DMA_IRQn);
+    mIsReady = true;
+}
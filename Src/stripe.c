@@ -0,0 +1,264 @@
+/*
+ * stripe.c
+ *
+ * Log backend that doubles the output bandwidth of the UART by striping the packets of LOG_PACKETS
+ * across two lanes: USART2 through vcp.c, and USART1 on PA9 through a ring sent in place by DMA.
+ * log_send() hands over one whole packet per call, and each one goes to a single lane, so that both
+ * lanes carry complete packets in sequence order and Tools/log_decode.py --stripe merges them back
+ * by sequence number. A packet that fits in no lane is dropped whole, the decoder counts it lost.
+ */
+
+
+#include "stripe.h"
+#include "vcp.h"
+#include "lpuart.h"
+#include "spi_log.h"
+#include "rtt.h"
+#include "itm.h"
+#include "log.h"
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+#if STRIPE_BACKEND && !LOG_PACKETS
+#error "STRIPE_BACKEND needs LOG_PACKETS, whose sequence numbers order the packets of both lanes"
+#endif
+#if STRIPE_BACKEND && VCP_DIRECT
+#error "STRIPE_BACKEND needs the input buffer of vcp.c to know the backlog of USART2"
+#endif
+#if STRIPE_BACKEND && (LPUART_BACKEND || SPI_LOG_BACKEND || RTT_BACKEND || ITM_BACKEND)
+#error "STRIPE_BACKEND sends through vcp.c, which the other backends replace"
+#endif
+#if STRIPE_BACKEND && LOG_IDLE_HOOK_ITEMS && (LOG_DRAIN_BACKEND || LOG_HISTORY_SIZE)
+#error "stripe_flush() sleeps until both lanes are sent, log_idle_hook() cannot call it from the idle task"
+#endif
+
+
+static UART_HandleTypeDef   mHuart;
+static DMA_HandleTypeDef    mHdmaTx;
+static uint8_t              mRing[STRIPE_BUFFER_SIZE];
+static volatile uint32_t    mWrIdx = 0;                     // Free running indexes
+static volatile uint32_t    mRdIdx = 0;
+static volatile uint32_t    mInFlight = 0;                  // Ring bytes being sent by DMA
+static uint32_t             mDroppedBytes = 0;
+static bool                 mIsLastUsart1 = false;          // Lane of the previous packet
+static bool                 mIsReady = false;
+
+
+// Starts the DMA of the ring up to its wrap if none is ongoing, with the DMA interrupt masked or from it
+static void stripe_start(void)
+{
+    uint32_t rdIdx = mRdIdx & (STRIPE_BUFFER_SIZE - 1);
+    uint32_t nUsed = mWrIdx - mRdIdx;
+    uint32_t toEnd = STRIPE_BUFFER_SIZE - rdIdx;
+
+    if(mInFlight || !nUsed)
+        return;
+
+    mInFlight = (nUsed < toEnd) ? nUsed : toEnd;
+    if(HAL_DMA_Start_IT(&mHdmaTx, (uint32_t)&mRing[rdIdx], (uint32_t)&mHuart.Instance->TDR, mInFlight) == HAL_OK)
+        SET_BIT(mHuart.Instance->CR3, USART_CR3_DMAT);
+    else
+    {
+        mDroppedBytes += mInFlight;
+        mRdIdx += mInFlight;
+        mInFlight = 0;
+    }
+}
+
+
+static void stripe_dma_done(DMA_HandleTypeDef *hdma)
+{
+    CLEAR_BIT(mHuart.Instance->CR3, USART_CR3_DMAT);
+    mRdIdx += mInFlight;
+    mInFlight = 0;
+    stripe_start();
+}
+
+
+void stripe_dma_irq_handler(void)
+{
+    HAL_DMA_IRQHandler(&mHdmaTx);
+}
+
+
+// Copies the packet into the ring of USART1, which must have room for it
+static void stripe_write(const void *pData, uint32_t nBytes)
+{
+    uint32_t wrIdx = mWrIdx & (STRIPE_BUFFER_SIZE - 1);
+    uint32_t toEnd = STRIPE_BUFFER_SIZE - wrIdx;
+    uint32_t primaskBit;
+
+    if(nBytes > toEnd)
+    {
+        memcpy(&mRing[wrIdx], pData, toEnd);
+        memcpy(mRing, (const uint8_t*)pData + toEnd, nBytes - toEnd);
+    }
+    else
+        memcpy(&mRing[wrIdx], pData, nBytes);
+
+    primaskBit = __get_PRIMASK();
+    __disable_irq();
+    mWrIdx += nBytes;
+    stripe_start();
+    __set_PRIMASK(primaskBit);
+}
+
+
+// Sends the packet on the lane picked by STRIPE_SCHEDULING, or on the other one if it has no room
+void stripe_send(void* pData, uint32_t nBytes)
+{
+    uint32_t vcpFree;
+    uint32_t usart1Free;
+    bool isUsart1;
+
+    if(!mIsReady)
+        return;
+
+    vcpFree = vcp_get_free();
+    usart1Free = STRIPE_BUFFER_SIZE - (mWrIdx - mRdIdx);
+#if STRIPE_SCHEDULING == STRIPE_LEAST_BACKLOG
+    if(VCP_INPUT_BUFFER_SIZE - vcpFree != STRIPE_BUFFER_SIZE - usart1Free)
+        isUsart1 = (STRIPE_BUFFER_SIZE - usart1Free < VCP_INPUT_BUFFER_SIZE - vcpFree);
+    else
+#endif
+        isUsart1 = !mIsLastUsart1;
+    if(nBytes > (isUsart1 ? usart1Free : vcpFree))
+        isUsart1 = !isUsart1;
+    if(nBytes > (isUsart1 ? usart1Free : vcpFree))
+    {
+        mDroppedBytes += nBytes;
+        return;
+    }
+
+    mIsLastUsart1 = isUsart1;
+    if(isUsart1)
+        stripe_write(pData, nBytes);
+    else
+        vcp_send(pData, nBytes);
+}
+
+
+// Waits until both lanes are empty, sleeping if the caller is a task
+void stripe_flush(void)
+{
+    if(!mIsReady)
+        return;
+
+    vcp_flush();
+    if(!__get_PRIMASK() && !__get_IPSR() && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+    {
+        while(mWrIdx != mRdIdx)
+            vTaskDelay(1);
+    }
+    else
+    {
+        while(mWrIdx != mRdIdx)
+            HAL_DMA_IRQHandler(&mHdmaTx);
+    }
+    while(!(mHuart.Instance->ISR & USART_ISR_TC));
+}
+
+
+bool stripe_is_ready(void)
+{
+    return STRIPE_BUFFER_SIZE - (mWrIdx - mRdIdx) >= STRIPE_READY_MIN_FREE || vcp_is_ready();
+}
+
+
+uint32_t stripe_get_dropped_bytes(void)
+{
+    return mDroppedBytes;
+}
+
+
+static void stripe_panic_write(const uint8_t *pData, uint32_t nBytes)
+{
+    while(nBytes--)
+    {
+        while(!(mHuart.Instance->ISR & USART_ISR_TXE_TXFNF));
+        mHuart.Instance->TDR = *pData++;
+    }
+}
+
+
+// The DMA is stopped and the ring sent first by polling, the part of it in flight may be repeated. The
+// panic text itself goes to USART2 unframed, where the decoder skips it as a bad packet.
+void stripe_panic_send(void* pData, uint32_t nBytes)
+{
+    uint32_t rdIdx;
+    uint32_t toEnd;
+
+    if(mIsReady)                        // Not initialized, polling would never end
+    {
+        CLEAR_BIT(mHuart.Instance->CR3, USART_CR3_DMAT);
+        HAL_DMA_Abort(&mHdmaTx);
+        mInFlight = 0;
+        while(mWrIdx != mRdIdx)
+        {
+            rdIdx = mRdIdx & (STRIPE_BUFFER_SIZE - 1);
+            toEnd = STRIPE_BUFFER_SIZE - rdIdx;
+            if(toEnd > mWrIdx - mRdIdx)
+                toEnd = mWrIdx - mRdIdx;
+            stripe_panic_write(&mRing[rdIdx], toEnd);
+            mRdIdx += toEnd;
+        }
+        while(!(mHuart.Instance->ISR & USART_ISR_TC));
+    }
+
+    vcp_panic_send(pData, nBytes);
+}
+
+
+void stripe_init(void)
+{
+    GPIO_InitTypeDef gpio = {.Pin = GPIO_PIN_9, .Mode = GPIO_MODE_AF_PP, .Pull = GPIO_NOPULL,
+                             .Speed = GPIO_SPEED_FREQ_HIGH, .Alternate = GPIO_AF1_USART1};
+
+    static_assert(!(STRIPE_BUFFER_SIZE & (STRIPE_BUFFER_SIZE - 1)), "Stripe buffer size must be power of 2");
+    mRing[0] = 0;                       // Ends what the receiver got before, like the first packet of USART2
+    mWrIdx = 1;
+    mRdIdx = 0;
+    mInFlight = 0;
+    mDroppedBytes = 0;
+    mIsLastUsart1 = false;
+
+    __HAL_RCC_USART1_CLK_ENABLE();
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    HAL_GPIO_Init(GPIOA, &gpio);
+
+    mHuart.Instance            = USART1;
+    mHuart.Init.BaudRate       = STRIPE_BAUDRATE;
+    mHuart.Init.WordLength     = UART_WORDLENGTH_8B;
+    mHuart.Init.StopBits       = UART_STOPBITS_1;
+    mHuart.Init.Parity         = UART_PARITY_NONE;
+    mHuart.Init.Mode           = UART_MODE_TX;
+    mHuart.Init.HwFlowCtl      = UART_HWCONTROL_NONE;
+    mHuart.Init.OverSampling   = UART_OVERSAMPLING_8;      // Like MX_USART2_UART_Init()
+    mHuart.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
+    mHuart.Init.ClockPrescaler = UART_PRESCALER_DIV1;
+    mHuart.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
+    if(HAL_UART_Init(&mHuart) != HAL_OK)
+        return;
+    HAL_UARTEx_EnableFifoMode(&mHuart);
+
+    mHdmaTx.Instance                 = STRIPE_DMA_CHANNEL;
+    mHdmaTx.Init.Request             = STRIPE_DMA_REQUEST;
+    mHdmaTx.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+    mHdmaTx.Init.PeriphInc           = DMA_PINC_DISABLE;
+    mHdmaTx.Init.MemInc              = DMA_MINC_ENABLE;
+    mHdmaTx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    mHdmaTx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    mHdmaTx.Init.Mode                = DMA_NORMAL;
+    mHdmaTx.Init.Priority            = DMA_PRIORITY_LOW;
+    HAL_DMA_Init(&mHdmaTx);
+    mHdmaTx.XferCpltCallback = stripe_dma_done;
+
+    HAL_NVIC_SetPriority(STRIPE_DMA_IRQn, STRIPE_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(STRIPE_DMA_IRQn);
+    mIsReady = true;
+}
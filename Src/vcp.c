@@ -7,51 +7,1281 @@
 
 
 #include "vcp.h"
+#include "log.h"
+#include "log_probe.h"
+#include "log_queue.h"
 #include <stdint.h>
+#include <string.h>
+#include <assert.h>
 #include "FreeRTOS.h"
 #include "stream_buffer.h"
 #include "main.h"
+#if VCP_USE_DMA || VCP_BLOCKING_TH || VCP_TX_IRQ || VCP_OVERFLOW_POLICY == VCP_OVERFLOW_BLOCK
+#include "task.h"
+#endif
+
+
+#define VCP_TH_SLEEPS               (VCP_USE_DMA || VCP_BLOCKING_TH)
+#define VCP_TH_WAIT                 ((VCP_FLUSH_TIMEOUT_MS) ? pdMS_TO_TICKS(VCP_FLUSH_TIMEOUT_MS) : portMAX_DELAY)
+#define VCP_TX_FIFO_SIZE            8                       // Bytes taken from the input buffer at once by the UART interrupt
+#if VCP_TX_FIFO
+#define VCP_TX_IE_REG               CR3                     // Refill when the TX FIFO drains to its threshold
+#define VCP_TX_IE                   USART_CR3_TXFTIE
+#else
+#define VCP_TX_IE_REG               CR1                     // Refill each time the transmit data register is empty
+#define VCP_TX_IE                   USART_CR1_TXEIE_TXFNFIE
+#endif
+#if VCP_HW_FLOW_CONTROL
+#define VCP_FLOW_GPIO_PORT          GPIOA
+#define VCP_CTS_PIN                 GPIO_PIN_0              // Pulled down, the output is not held back while nothing drives it
+#define VCP_RTS_PIN                 GPIO_PIN_1
+#endif
+#if VCP_AUTOBAUD
+#define VCP_AB_SYNC                 "AB"
+#define VCP_AB_HDR_SIZE             7                       // Sync, message type and 32 bit value, little endian
+#define VCP_AB_PROBE_SIZE           64                      // Bytes after the header of the probe message
+#define VCP_AB_MAX_SIZE             (VCP_AB_HDR_SIZE + VCP_AB_PROBE_SIZE + 4)
+#endif
+#if VCP_LL_TX                                               // LL channel number and flags of VCP_DMA_CHANNEL
+#define VCP_DMA_LL_CHANNEL          (((uint32_t)VCP_DMA_CHANNEL - DMA1_Channel1_BASE) / (DMA1_Channel2_BASE - DMA1_Channel1_BASE))
+#define VCP_DMA_TC_FLAG             (DMA_ISR_TCIF1 << (4 * VCP_DMA_LL_CHANNEL))
+#define VCP_DMA_GI_FLAG             (DMA_IFCR_CGIF1 << (4 * VCP_DMA_LL_CHANNEL))
+#endif
+
+#if VCP_DIRECT && (!VCP_USE_DMA || VCP_ZERO_COPY)
+#error "VCP_DIRECT needs VCP_USE_DMA and replaces VCP_ZERO_COPY"
+#endif
+#if VCP_DIRECT && !LOG_RENDER_PING_PONG
+#error "VCP_DIRECT keeps sending the data after vcp_send() returns, it needs LOG_RENDER_PING_PONG so the logger thread does not reuse nor release it meanwhile"
+#endif
+#if VCP_TRIGGER_LEVEL > 1 && !VCP_FLUSH_TIMEOUT_MS
+#error "A VCP_TRIGGER_LEVEL above 1 needs VCP_FLUSH_TIMEOUT_MS, or the last bytes may never be sent"
+#endif
+#if VCP_TX_IRQ && VCP_USE_DMA
+#error "VCP_TX_IRQ replaces VCP_USE_DMA"
+#endif
+#if VCP_LOW_POWER && (!configUSE_TICKLESS_IDLE || VCP_RX_LINE_SIZE)
+#error "VCP_LOW_POWER needs configUSE_TICKLESS_IDLE, and stops the UART clock so it cannot receive"
+#endif
+#if VCP_RX_DMA && !VCP_RX_LINE_SIZE
+#error "VCP_RX_DMA needs VCP_RX_LINE_SIZE for the lines it receives"
+#endif
+#if VCP_LOW_POWER && !VCP_TH_SLEEPS && !VCP_TX_IRQ && !VCP_DIRECT
+#error "VCP_LOW_POWER needs a vcp_th that sleeps (VCP_BLOCKING_TH or VCP_USE_DMA), VCP_TX_IRQ or VCP_DIRECT"
+#endif
+#if LOG_IDLE_HOOK_ITEMS && (VCP_DIRECT || VCP_TX_IRQ || VCP_OVERFLOW_POLICY == VCP_OVERFLOW_BLOCK)
+#error "LOG_IDLE_HOOK_ITEMS outputs from the idle task, which must not wait for the UART as VCP_DIRECT, VCP_TX_IRQ and VCP_OVERFLOW_BLOCK do"
+#endif
+#if LOG_IDLE_HOOK_ITEMS && LOG_HISTORY_SIZE && VCP_USE_DMA && !LOG_DRAIN_BACKEND
+#error "vcp_flush() sleeps until vcp_th drains the input buffer, log_idle_hook() can only call it with LOG_DRAIN_BACKEND, which polls it instead"
+#endif
+#if VCP_URGENT_BUFFER_SIZE && (VCP_ZERO_COPY || VCP_DIRECT)
+#error "VCP_URGENT_BUFFER_SIZE adds a stream buffer to the one of the input buffer, not with VCP_ZERO_COPY nor VCP_DIRECT"
+#endif
+#if VCP_URGENT_BUFFER_SIZE && VCP_TH_SLEEPS && !VCP_FLUSH_TIMEOUT_MS
+#error "VCP_URGENT_BUFFER_SIZE with a sleeping vcp_th needs VCP_FLUSH_TIMEOUT_MS, an urgent write just before it sleeps does not wake it up"
+#endif
 
 
 static UART_HandleTypeDef*  mp_huart = NULL;
 
-static uint8_t inputStreamBuffer[VCP_INPUT_BUFFER_SIZE];
+#if VCP_ZERO_COPY
+static uint8_t              mRing[VCP_INPUT_BUFFER_SIZE] VCP_INPUT_BUFFER_PLACEMENT;
+static volatile uint32_t    mRingWrIdx = 0;                 // Free running indexes
+static volatile uint32_t    mRingRdIdx = 0;
+#elif !VCP_DIRECT
+static uint8_t inputStreamBuffer[VCP_INPUT_BUFFER_SIZE] VCP_INPUT_BUFFER_PLACEMENT;
 static StaticStreamBuffer_t inputStreamCb;
 static StreamBufferHandle_t inputStream;
+#endif
+#if VCP_URGENT_BUFFER_SIZE
+static uint8_t              urgentStreamBuffer[VCP_URGENT_BUFFER_SIZE];
+static StaticStreamBuffer_t urgentStreamCb;
+static StreamBufferHandle_t urgentStream;                   // Sent before the input buffer, chunk by chunk
+#endif
+
+#if VCP_USE_DMA
+#if VCP_LL_TX
+static volatile bool        mIsDmaBusy = false;             // Cleared by the DMA transfer complete interrupt
+#else
+static DMA_HandleTypeDef    mHdmaTx;
+#endif
+#if VCP_ZERO_COPY
+static volatile uint32_t    mTxInFlight = 0;                // Ring bytes being sent by DMA
+#elif !VCP_DIRECT
+static uint8_t              mTxBuffers[2][VCP_DMA_BUFFER_SIZE];     // One is filled while the other is sent
+#endif
+#endif
+#if VCP_TX_IRQ && !VCP_ZERO_COPY
+static uint8_t              mTxChunk[VCP_TX_FIFO_SIZE];     // Taken from the input buffer by the UART interrupt
+static volatile uint32_t    mTxChunkLen = 0;
+static volatile uint32_t    mTxChunkIdx = 0;
+#endif
+#if VCP_TX_IRQ
+static TaskHandle_t volatile mFlushTask = NULL;             // Waiting in vcp_flush() for the input buffer to drain
+#endif
+#if VCP_TH_SLEEPS
+static TaskHandle_t volatile mVcpTask = NULL;
+#endif
+static volatile uint32_t    mDroppedBytes = 0;              // Bytes that did not fit in the input buffer
+#if VCP_OVERFLOW_POLICY == VCP_OVERFLOW_MARKER
+static uint32_t             mLostBytes = 0;                 // Dropped bytes not reported by a marker yet
+#endif
+#if VCP_RX_DMA
+static DMA_HandleTypeDef    mHdmaRx;
+static uint8_t              mRxDmaBuffer[VCP_RX_DMA_BUFFER_SIZE];
+static uint32_t             mRxDmaIdx = 0;                  // Next byte of mRxDmaBuffer to parse
+#elif VCP_RX_LINE_SIZE
+static uint8_t              mRxByte;
+#endif
+#if VCP_RX_LINE_SIZE
+static char                 mRxLine[VCP_RX_LINE_SIZE];
+static uint32_t             mRxLen = 0;
+static vcp_rx_handler volatile mRxHandler = NULL;
+#endif
+
+
+#if VCP_ZERO_COPY
+// Returns the number of bytes that can be read in place from *ppData, up to the wrap of the ring
+static uint32_t vcp_ring_peek(uint8_t **ppData)
+{
+    uint32_t rdIdx = mRingRdIdx & (VCP_INPUT_BUFFER_SIZE - 1);
+    uint32_t nUsed = mRingWrIdx - mRingRdIdx;
+    uint32_t toEnd = VCP_INPUT_BUFFER_SIZE - rdIdx;
+
+    *ppData = &mRing[rdIdx];
+    return (nUsed < toEnd) ? nUsed : toEnd;
+}
+
+
+static void vcp_ring_consume(uint32_t nBytes)
+{
+    __DMB();
+    mRingRdIdx += nBytes;
+}
+#endif
+
+
+#if VCP_URGENT_BUFFER_SIZE
+// Takes the next chunk of the urgent lane if it has one, of the input buffer otherwise
+static inline uint32_t vcp_receive(uint8_t *pData, uint32_t nBytes, TickType_t wait)
+{
+    uint32_t nChars = xStreamBufferReceive(urgentStream, pData, nBytes, 0);
+
+    return nChars ? nChars : xStreamBufferReceive(inputStream, pData, nBytes, wait);
+}
+
+
+static inline uint32_t vcp_receive_from_isr(uint8_t *pData, uint32_t nBytes, BaseType_t *pIsYieldNeeded)
+{
+    uint32_t nChars = xStreamBufferReceiveFromISR(urgentStream, pData, nBytes, pIsYieldNeeded);
+
+    return nChars ? nChars : xStreamBufferReceiveFromISR(inputStream, pData, nBytes, pIsYieldNeeded);
+}
 
+#define VCP_URGENT_IS_EMPTY()       xStreamBufferIsEmpty(urgentStream)
+#elif !VCP_ZERO_COPY && !VCP_DIRECT
+#define vcp_receive(pData, nBytes, wait)                    xStreamBufferReceive(inputStream, pData, nBytes, wait)
+#define vcp_receive_from_isr(pData, nBytes, pIsYieldNeeded) xStreamBufferReceiveFromISR(inputStream, pData, nBytes, pIsYieldNeeded)
+#define VCP_URGENT_IS_EMPTY()       pdTRUE
+#endif
+
+
+// Counts the bytes that did not fit and reports them to the saturation handler of the logger
+static inline void vcp_drop(uint32_t nBytes)
+{
+    mDroppedBytes += nBytes;
+#if LOG_SATURATION_HOOKS
+    if(nBytes)
+        log_saturation_notify(LOG_SATURATION_OUTPUT_DROP, nBytes);
+#endif
+}
+
+
+// True while the UART driver still has bytes to send
+static inline bool vcp_tx_is_busy(void)
+{
+#if VCP_LL_TX && VCP_USE_DMA
+    return mIsDmaBusy;
+#elif VCP_LL_TX
+    return false;                       // vcp_transmit_polling() only returns once its bytes are in the UART
+#else
+    return mp_huart->gState != HAL_UART_STATE_READY;
+#endif
+}
+
+
+#if !VCP_TX_IRQ && !VCP_DIRECT
+// Sends the bytes polling TXE. With VCP_LL_TX it does not wait for TC either, only vcp_flush() does.
+static void vcp_transmit_polling(uint8_t *pData, uint32_t nBytes)
+{
+#if VCP_LL_TX
+    USART_TypeDef *pUart = mp_huart->Instance;
+
+    LOG_PROBE_HIGH(LOG_PROBE_TX_PIN);
+    while(nBytes--)
+    {
+        while(!(pUart->ISR & USART_ISR_TXE_TXFNF));
+        pUart->TDR = *pData++;
+    }
+#else
+    LOG_PROBE_HIGH(LOG_PROBE_TX_PIN);
+    HAL_UART_Transmit(mp_huart, pData, nBytes, HAL_MAX_DELAY);
+#endif
+    LOG_PROBE_LOW(LOG_PROBE_TX_PIN);
+}
+#endif
+
+
+#if VCP_USE_DMA
+// Starts the DMA of the bytes, false if a transfer is still ongoing
+static bool vcp_dma_start(uint8_t *pData, uint32_t nBytes)
+{
+#if VCP_LL_TX
+    if(mIsDmaBusy)
+        return false;
+
+    mIsDmaBusy = true;
+    LOG_PROBE_HIGH(LOG_PROBE_TX_PIN);
+    LL_DMA_DisableChannel(DMA1, VCP_DMA_LL_CHANNEL);
+    WRITE_REG(DMA1->IFCR, VCP_DMA_GI_FLAG);
+    LL_DMA_SetMemoryAddress(DMA1, VCP_DMA_LL_CHANNEL, (uint32_t)pData);
+    LL_DMA_SetDataLength(DMA1, VCP_DMA_LL_CHANNEL, nBytes);
+    LL_DMA_EnableChannel(DMA1, VCP_DMA_LL_CHANNEL);
+    ATOMIC_SET_BIT(mp_huart->Instance->CR3, USART_CR3_DMAT);
+    return true;
+#else
+    LOG_PROBE_HIGH(LOG_PROBE_TX_PIN);
+    if(HAL_UART_Transmit_DMA(mp_huart, pData, nBytes) == HAL_OK)
+        return true;
+    if(!vcp_tx_is_busy())
+        LOG_PROBE_LOW(LOG_PROBE_TX_PIN);   // Still high for the ongoing transfer otherwise
+    return false;
+#endif
+}
+#endif
+
+
+#if VCP_TX_IRQ
+// Fills the TX FIFO (or data register) from the input buffer, its interrupt is disabled and
+// vcp_flush() woken up once both are empty
+static void vcp_tx_refill(BaseType_t *pIsYieldNeeded)
+{
+    USART_TypeDef *pUart = mp_huart->Instance;
+#if VCP_ZERO_COPY
+    uint8_t *pData;
+    uint32_t nChars;
+    uint32_t nSent;
+
+    // The ring is sent in place, its space is freed once per region
+    while((nChars = vcp_ring_peek(&pData)) != 0)
+    {
+        for(nSent = 0; nSent < nChars && (pUart->ISR & USART_ISR_TXE_TXFNF); nSent++)
+            pUart->TDR = pData[nSent];
+        vcp_ring_consume(nSent);
+        if(nSent < nChars)
+            return;                         // Full, refilled on the next interrupt
+    }
+#else
+    while(1)
+    {
+        if(mTxChunkIdx == mTxChunkLen)
+        {
+            mTxChunkIdx = 0;
+            mTxChunkLen = vcp_receive_from_isr(mTxChunk, sizeof(mTxChunk), pIsYieldNeeded);
+            if(!mTxChunkLen)
+                break;
+        }
+        if(!(pUart->ISR & USART_ISR_TXE_TXFNF))
+            return;                         // Full, refilled on the next interrupt
+        pUart->TDR = mTxChunk[mTxChunkIdx++];
+    }
+#endif
+
+    ATOMIC_CLEAR_BIT(pUart->VCP_TX_IE_REG, VCP_TX_IE);
+    LOG_PROBE_LOW(LOG_PROBE_TX_PIN);
+    if(mFlushTask)
+        vTaskNotifyGiveFromISR(mFlushTask, pIsYieldNeeded);
+}
+#endif
+
+
+#if VCP_USE_DMA && VCP_LL_TX
+// Ends the transfer once the DMA has moved its last byte, the UART may still be sending the ones in
+// its data register or FIFO, which do not keep the next transfer from starting
+static void vcp_dma_done(void)
+{
+    BaseType_t isYieldNeeded = pdFALSE;
+
+    if(!(DMA1->ISR & VCP_DMA_TC_FLAG))
+        return;
+
+    WRITE_REG(DMA1->IFCR, VCP_DMA_GI_FLAG);
+    LL_DMA_DisableChannel(DMA1, VCP_DMA_LL_CHANNEL);
+    mIsDmaBusy = false;
+    LOG_PROBE_LOW(LOG_PROBE_TX_PIN);
+#if LOG_LATENCY && VCP_DIRECT
+    log_latency_tx_done();
+#endif
+    if(mVcpTask)
+    {
+        vTaskNotifyGiveFromISR(mVcpTask, &isYieldNeeded);
+        portYIELD_FROM_ISR(isYieldNeeded);
+    }
+}
+
+
+void vcp_dma_irq_handler(void)
+{
+    vcp_dma_done();
+}
+#elif VCP_USE_DMA
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    BaseType_t isYieldNeeded = pdFALSE;
+
+    if(huart == mp_huart)
+        LOG_PROBE_LOW(LOG_PROBE_TX_PIN);
+#if LOG_LATENCY && VCP_DIRECT
+    if(huart == mp_huart)
+        log_latency_tx_done();
+#endif
+    if(huart == mp_huart && mVcpTask)
+    {
+        vTaskNotifyGiveFromISR(mVcpTask, &isYieldNeeded);
+        portYIELD_FROM_ISR(isYieldNeeded);
+    }
+}
+
+
+void vcp_dma_irq_handler(void)
+{
+    HAL_DMA_IRQHandler(&mHdmaTx);
+}
+#endif
+
+
+#if VCP_USE_DMA || VCP_RX_LINE_SIZE || VCP_TX_IRQ
+void vcp_uart_irq_handler(void)
+{
+#if VCP_TX_IRQ
+    BaseType_t isYieldNeeded = pdFALSE;
+
+    if(READ_BIT(mp_huart->Instance->VCP_TX_IE_REG, VCP_TX_IE))
+        vcp_tx_refill(&isYieldNeeded);
+#endif
+#if (VCP_USE_DMA && !VCP_LL_TX) || VCP_RX_LINE_SIZE
+    HAL_UART_IRQHandler(mp_huart);
+#endif
+#if VCP_TX_IRQ
+    portYIELD_FROM_ISR(isYieldNeeded);
+#endif
+}
+#endif
+
+
+#if VCP_RX_LINE_SIZE
+static void vcp_rx_byte(uint8_t byte)
+{
+    if(byte == '\r' || byte == '\n')
+    {
+        mRxLine[mRxLen] = '\0';
+        if(mRxLen && mRxHandler)
+            mRxHandler(mRxLine, mRxLen);
+        mRxLen = 0;
+    }
+    else if(mRxLen < VCP_RX_LINE_SIZE - 1)      // Longer lines are truncated
+        mRxLine[mRxLen++] = byte;
+}
+
+
+#if VCP_RX_DMA
+static void vcp_rx_start(void)
+{
+    if(mp_huart->RxState != HAL_UART_STATE_READY)  // Noise and framing errors do not stop the transfer
+        return;
+    mRxDmaIdx = 0;
+    HAL_UARTEx_ReceiveToIdle_DMA(mp_huart, mRxDmaBuffer, sizeof(mRxDmaBuffer));
+}
+
+
+void vcp_rx_dma_irq_handler(void)
+{
+    HAL_DMA_IRQHandler(&mHdmaRx);
+}
+
+
+// Called at the idle line and at the half and full DMA transfer events, with the DMA write position.
+// The circular transfer goes on by itself, pos is the buffer size when it wraps.
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t pos)
+{
+    if(huart != mp_huart)
+        return;
+
+    while(mRxDmaIdx < pos)
+        vcp_rx_byte(mRxDmaBuffer[mRxDmaIdx++]);
+    if(mRxDmaIdx >= sizeof(mRxDmaBuffer))
+        mRxDmaIdx = 0;
+}
+#else
+static void vcp_rx_start(void)
+{
+    HAL_UART_Receive_IT(mp_huart, &mRxByte, 1);
+}
+
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if(huart != mp_huart)
+        return;
+
+    vcp_rx_byte(mRxByte);
+    HAL_UART_Receive_IT(mp_huart, &mRxByte, 1);
+}
+#endif
+
+
+// Reception stops on errors like overruns, it is restarted with the current line discarded
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    if(huart != mp_huart)
+        return;
+
+    mRxLen = 0;
+    vcp_rx_start();
+}
+
+
+void vcp_set_rx_handler(vcp_rx_handler handler)
+{
+    mRxHandler = handler;
+}
+#endif
+
+
+#if VCP_USE_DMA
+// Finishes the ongoing DMA transfer by polling, for callers that cannot wait for vcp_th
+static void vcp_dma_wait_polling(void)
+{
+    uint32_t primaskBit;
+
+    while(vcp_tx_is_busy())
+    {
+#if VCP_LL_TX
+        vcp_dma_done();
+#else
+        HAL_DMA_IRQHandler(&mHdmaTx);
+        HAL_UART_IRQHandler(mp_huart);
+#endif
+    }
+
+#if VCP_ZERO_COPY
+    primaskBit = __get_PRIMASK();
+    __disable_irq();
+    vcp_ring_consume(mTxInFlight);
+    mTxInFlight = 0;
+    __set_PRIMASK(primaskBit);
+#else
+    (void)primaskBit;
+#endif
+}
+#endif
+
+
+#if VCP_ZERO_COPY
+// Sends a region of the ring in place and frees it
+static void vcp_transmit(uint8_t *pData, uint32_t nBytes)
+{
+#if VCP_USE_DMA
+    uint32_t primaskBit;
+
+    mTxInFlight = nBytes;
+    if(vcp_dma_start(pData, nBytes))
+    {
+        while(vcp_tx_is_busy())
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    // vcp_flush() may have already freed it if it had to finish the transfer itself
+    primaskBit = __get_PRIMASK();
+    __disable_irq();
+    vcp_ring_consume(mTxInFlight);
+    mTxInFlight = 0;
+    __set_PRIMASK(primaskBit);
+#else
+    vcp_transmit_polling(pData, nBytes);
+    vcp_ring_consume(nBytes);
+#endif
+}
+#endif
+
+
+#if VCP_DIRECT
+// Waits for the ongoing transfer, sleeping until its end if the caller is a task
+static void vcp_dma_wait(void)
+{
+    if(!__get_PRIMASK() && !__get_IPSR() && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+    {
+        mVcpTask = xTaskGetCurrentTaskHandle();
+        while(vcp_tx_is_busy())
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    else
+        vcp_dma_wait_polling();
+}
+
+
+void vcp_flush(void)
+{
+    vcp_dma_wait();
+#if VCP_LL_TX
+    while(!(mp_huart->Instance->ISR & USART_ISR_TC));
+#endif
+}
+
+
+void vcp_th(void const * argument)
+{
+    vTaskDelete(NULL);                  // Not needed, vcp_send() starts the transfers itself
+}
+
+
+// Sends the data in place. It must not be modified until the next call, which waits for this
+// transfer to finish, so the caller can fill a second buffer in the meantime.
+void vcp_send(void* p_data, uint32_t length)
+{
+    vcp_dma_wait();
+    if(length && vcp_dma_start(p_data, length))
+        return;
+    vcp_drop(length);
+#if LOG_LATENCY
+    log_latency_tx_done();              // No transfer will end for this call
+#endif
+}
+
+
+bool vcp_is_ready(void)
+{
+    return true;                        // vcp_send() waits for the previous transfer instead
+}
+
+#else
+
+#if VCP_TX_IRQ
+// Sleeps until the UART interrupt drains the input buffer. If the caller cannot sleep, the refill is
+// run here with the interrupts masked, so that the interrupt does not read the buffer concurrently.
+// A notification left over by the interrupt only wakes the caller once more later on.
+void vcp_flush(void)
+{
+    BaseType_t isYieldNeeded = pdFALSE;
+    uint32_t primaskBit;
+
+    if(!__get_PRIMASK() && !__get_IPSR() && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+    {
+        mFlushTask = xTaskGetCurrentTaskHandle();
+        while(READ_BIT(mp_huart->Instance->VCP_TX_IE_REG, VCP_TX_IE))
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        mFlushTask = NULL;
+    }
+    else
+    {
+        primaskBit = __get_PRIMASK();
+        __disable_irq();
+        while(READ_BIT(mp_huart->Instance->VCP_TX_IE_REG, VCP_TX_IE))
+            vcp_tx_refill(&isYieldNeeded);
+        __set_PRIMASK(primaskBit);
+    }
+    while(!(mp_huart->Instance->ISR & USART_ISR_TC));
+}
+
+
+void vcp_th(void const * argument)
+{
+    vTaskDelete(NULL);                  // Not needed, the UART interrupt sends the input buffer
+}
+
+#else
 
 void vcp_flush(void)
 {
+#if VCP_ZERO_COPY
+    uint8_t *pData;
+#else
     uint8_t rxBuffer[16];
+#endif
     uint32_t nChars;
 
+#if VCP_USE_DMA
+    // If vcp_th can run, it drains the input buffer itself
+    if(!__get_PRIMASK() && !__get_IPSR() && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING && mVcpTask)
+    {
+#if VCP_ZERO_COPY
+        while(mRingWrIdx != mRingRdIdx)
+#else
+        while(!xStreamBufferIsEmpty(inputStream) || !VCP_URGENT_IS_EMPTY() || vcp_tx_is_busy())
+#endif
+            vTaskDelay(1);
+#if VCP_LL_TX
+        while(!(mp_huart->Instance->ISR & USART_ISR_TC));
+#endif
+        return;
+    }
+    vcp_dma_wait_polling();
+#endif
+
+#if VCP_ZERO_COPY
+    while((nChars = vcp_ring_peek(&pData)) != 0)
+    {
+        vcp_transmit_polling(pData, nChars);
+        vcp_ring_consume(nChars);
+    }
+#else
     do
     {
-        nChars = xStreamBufferReceive(inputStream, rxBuffer, sizeof(rxBuffer), 0);
-        HAL_UART_Transmit(mp_huart, rxBuffer, nChars, HAL_MAX_DELAY);
-    } while (nChars == sizeof(rxBuffer));
+        nChars = vcp_receive(rxBuffer, sizeof(rxBuffer), 0);
+        vcp_transmit_polling(rxBuffer, nChars);
+    } while (nChars == sizeof(rxBuffer) || !VCP_URGENT_IS_EMPTY());
+#endif
+#if VCP_LL_TX
+    while(!(mp_huart->Instance->ISR & USART_ISR_TC));
+#endif
 }
 
 
 void vcp_th(void const * argument)
 {
+#if VCP_ZERO_COPY
+    uint8_t *pData;
+    uint32_t nChars;
+
+#if VCP_TH_SLEEPS
+    mVcpTask = xTaskGetCurrentTaskHandle();
+#endif
+
+    while(1)
+    {
+        nChars = vcp_ring_peek(&pData);
+        if(nChars)
+        {
+            vcp_transmit(pData, nChars);
+            HAL_GPIO_TogglePin(LED_GREEN_GPIO_Port, LED_GREEN_Pin);
+        }
+#if VCP_TH_SLEEPS
+        else
+            ulTaskNotifyTake(pdTRUE, VCP_TH_WAIT);      // Woken up by vcp_send() at the trigger level
+#endif
+    }
+#elif VCP_USE_DMA
+    uint8_t *pTxBuffer = mTxBuffers[0];
+    uint32_t nChars;
+
+    mVcpTask = xTaskGetCurrentTaskHandle();
+    xTaskNotifyGive(mVcpTask);          // No transfer ongoing yet
+
+    while(1)
+    {
+        // The next chunk is collected while the previous one is being sent
+        nChars = vcp_receive(pTxBuffer, VCP_DMA_BUFFER_SIZE, VCP_TH_WAIT);
+        if(!nChars)
+            continue;
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if(!vcp_dma_start(pTxBuffer, nChars))
+            xTaskNotifyGive(mVcpTask);
+        pTxBuffer = (pTxBuffer == mTxBuffers[0]) ? mTxBuffers[1] : mTxBuffers[0];
+        HAL_GPIO_TogglePin(LED_GREEN_GPIO_Port, LED_GREEN_Pin);
+    }
+#elif VCP_BLOCKING_TH
+    uint8_t rxBuffer[16];
+    uint32_t nChars;
+
+    while(1)
+    {
+        // Sleeps until vcp_send() reaches the trigger level of the stream buffer, or the timeout
+        nChars = vcp_receive(rxBuffer, sizeof(rxBuffer), VCP_TH_WAIT);
+        if(!nChars)
+            continue;
+        vcp_transmit_polling(rxBuffer, nChars);
+        HAL_GPIO_TogglePin(LED_GREEN_GPIO_Port, LED_GREEN_Pin);
+    }
+#else
 
     while(1)
     {
         vcp_flush();
         HAL_GPIO_TogglePin(LED_GREEN_GPIO_Port, LED_GREEN_Pin);
     }
+#endif
+}
+#endif
+
+
+// Returns the number of bytes that can be written to the input buffer
+static uint32_t vcp_free(void)
+{
+#if VCP_ZERO_COPY
+    return VCP_INPUT_BUFFER_SIZE - (mRingWrIdx - mRingRdIdx);
+#else
+    return xStreamBufferSpacesAvailable(inputStream);
+#endif
+}
+
+
+// Copies the data to the input buffer, which must have room for it
+static void vcp_write(const void *pData, uint32_t length)
+{
+#if VCP_ZERO_COPY
+    uint32_t wrIdx = mRingWrIdx & (VCP_INPUT_BUFFER_SIZE - 1);
+    uint32_t toEnd = VCP_INPUT_BUFFER_SIZE - wrIdx;
+
+    if(length > toEnd)
+    {
+        memcpy(&mRing[wrIdx], pData, toEnd);
+        memcpy(mRing, (const uint8_t*)pData + toEnd, length - toEnd);
+    }
+    else
+        memcpy(&mRing[wrIdx], pData, length);
+
+    __DMB();
+    mRingWrIdx += length;
+#if VCP_TH_SLEEPS
+    if(mVcpTask && mRingWrIdx - mRingRdIdx >= VCP_TRIGGER_LEVEL)
+        xTaskNotifyGive(mVcpTask);
+#endif
+#else
+    xStreamBufferSend(inputStream, pData, length, 0);
+#endif
+#if VCP_TX_IRQ
+    LOG_PROBE_HIGH(LOG_PROBE_TX_PIN);
+    ATOMIC_SET_BIT(mp_huart->Instance->VCP_TX_IE_REG, VCP_TX_IE);  // Restarts the refill if it had stopped
+#endif
+}
+
+
+#if VCP_OVERFLOW_POLICY == VCP_OVERFLOW_BLOCK
+// Waits up to VCP_SEND_TIMEOUT_MS for room, or drains the buffer itself if vcp_th cannot run
+static void vcp_wait_free(uint32_t length)
+{
+    TickType_t start;
+
+    if(vcp_free() >= length || length > VCP_INPUT_BUFFER_SIZE)
+        return;
+
+    if(__get_PRIMASK() || __get_IPSR() || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING)
+    {
+        vcp_flush();
+        return;
+    }
+
+    start = xTaskGetTickCount();
+    while(vcp_free() < length && xTaskGetTickCount() - start < pdMS_TO_TICKS(VCP_SEND_TIMEOUT_MS))
+        vTaskDelay(1);
+}
+#endif
+
+
+#if VCP_OVERFLOW_POLICY == VCP_OVERFLOW_MARKER
+// Writes the "[N bytes lost]" line for the bytes dropped since the last one, if it fits
+static void vcp_write_marker(void)
+{
+    char marker[32];
+    char digits[10];
+    uint32_t nDigits = 0;
+    uint32_t length = 0;
+    uint32_t nLost = mLostBytes;
+
+    do
+    {
+        digits[nDigits++] = '0' + nLost % 10;
+        nLost /= 10;
+    } while(nLost);
+
+    memcpy(&marker[length], "\r\n[", 3);
+    length += 3;
+    while(nDigits)
+        marker[length++] = digits[--nDigits];
+    memcpy(&marker[length], " bytes lost]\r\n", 14);
+    length += 14;
+
+    if(vcp_free() >= length)
+    {
+        vcp_write(marker, length);
+        mLostBytes = 0;
+    }
 }
+#endif
 
 
 void vcp_send(void* p_data, uint32_t length)
 {
-    xStreamBufferSend(inputStream, p_data, length, 0);
+#if VCP_OVERFLOW_POLICY == VCP_OVERFLOW_TRUNCATE
+    uint32_t nFree = vcp_free();
+
+    if(length > nFree)                  // The rest is dropped, even in the middle of a token
+    {
+        vcp_drop(length - nFree);
+        length = nFree;
+    }
+#else
+#if VCP_OVERFLOW_POLICY == VCP_OVERFLOW_BLOCK
+    vcp_wait_free(length);
+#elif VCP_OVERFLOW_POLICY == VCP_OVERFLOW_MARKER
+    if(mLostBytes)
+        vcp_write_marker();
+#endif
+    if(length > vcp_free())             // Whole writes are dropped so output tokens are never cut
+    {
+        vcp_drop(length);
+#if VCP_OVERFLOW_POLICY == VCP_OVERFLOW_MARKER
+        mLostBytes += length;
+#endif
+        return;
+    }
+#endif
+
+    if(length)
+        vcp_write(p_data, length);
+}
+
+
+#if VCP_URGENT_BUFFER_SIZE
+// Writes to the urgent lane, which the transmit side drains before the input buffer at the end of its
+// current chunk. Writes that do not fit are dropped whole, whatever VCP_OVERFLOW_POLICY.
+void vcp_send_urgent(void* p_data, uint32_t length)
+{
+#if !VCP_TX_IRQ
+    BaseType_t isYieldNeeded = pdFALSE;
+#endif
+
+    if(length > xStreamBufferSpacesAvailable(urgentStream))
+    {
+        vcp_drop(length);
+        return;
+    }
+    if(!length)
+        return;
+
+    xStreamBufferSend(urgentStream, p_data, length, 0);
+#if VCP_TX_IRQ
+    LOG_PROBE_HIGH(LOG_PROBE_TX_PIN);
+    ATOMIC_SET_BIT(mp_huart->Instance->VCP_TX_IE_REG, VCP_TX_IE);  // Restarts the refill if it had stopped
+#else
+    // vcp_th may sleep in the receive of the input buffer, it wakes up with nothing and takes the lane.
+    // If it was about to sleep, it takes it after VCP_FLUSH_TIMEOUT_MS.
+    (void)xStreamBufferSendCompletedFromISR(inputStream, &isYieldNeeded);
+#endif
+}
+#endif
+
+
+// Output ready handler for the logger, false when a few more writes could be dropped. With
+// VCP_HW_FLOW_CONTROL it is also false while the host holds CTS, so the output stays in the log
+// FIFOs, which report what they drop, instead of filling the input buffer first.
+bool vcp_is_ready(void)
+{
+#if VCP_HW_FLOW_CONTROL
+    if(!(mp_huart->Instance->ISR & USART_ISR_CTS))
+        return false;
+#endif
+    return vcp_free() >= VCP_READY_MIN_FREE;
+}
+
+
+// Room left in the input buffer, for stripe.c to pick the lane of each packet. None while the host
+// holds CTS, so that the other lane takes the output meanwhile.
+uint32_t vcp_get_free(void)
+{
+#if VCP_HW_FLOW_CONTROL
+    if(!(mp_huart->Instance->ISR & USART_ISR_CTS))
+        return 0;
+#endif
+    return vcp_free();
+}
+#endif
+
+
+uint32_t vcp_get_dropped_bytes(void)
+{
+    return mDroppedBytes;
+}
+
+
+// Writes the bytes to the UART registers polling TXE, without HAL, RTOS nor interrupts. Meant for
+// fault handlers only, it stops any DMA transfer in progress.
+static void vcp_panic_write(USART_TypeDef *pUart, const uint8_t *pData, uint32_t nBytes)
+{
+    while(nBytes--)
+    {
+        while(!(pUart->ISR & USART_ISR_TXE_TXFNF));
+        pUart->TDR = *pData++;
+    }
+}
+
+
+void vcp_panic_send(void* pData, uint32_t nBytes)
+{
+    USART_TypeDef *pUart;
+#if VCP_ZERO_COPY
+    uint8_t *pPending;
+    uint32_t nPending;
+#elif VCP_TX_IRQ
+    BaseType_t isYieldNeeded = pdFALSE;
+    uint32_t nPending;
+#endif
+
+    if(!mp_huart)                       // Not initialized, polling would never end
+        return;
+    pUart = mp_huart->Instance;
+    CLEAR_BIT(pUart->CR3, USART_CR3_DMAT);
+#if VCP_TX_IRQ
+    CLEAR_BIT(pUart->VCP_TX_IE_REG, VCP_TX_IE);
+#endif
+
+#if VCP_ZERO_COPY
+    // Output already accepted by vcp_send() goes first, the part of it in flight may be repeated
+    while((nPending = vcp_ring_peek(&pPending)) != 0)
+    {
+        vcp_panic_write(pUart, pPending, nPending);
+        vcp_ring_consume(nPending);
+    }
+#elif VCP_TX_IRQ
+    // Same for the input buffer, xStreamBufferReceiveFromISR() only masks the interrupts
+    vcp_panic_write(pUart, &mTxChunk[mTxChunkIdx], mTxChunkLen - mTxChunkIdx);
+    while((nPending = vcp_receive_from_isr(mTxChunk, sizeof(mTxChunk), &isYieldNeeded)) != 0)
+        vcp_panic_write(pUart, mTxChunk, nPending);
+    mTxChunkIdx = 0;
+    mTxChunkLen = 0;
+#endif
+    vcp_panic_write(pUart, pData, nBytes);
+    while(!(pUart->ISR & USART_ISR_TC));
+}
+
+
+#if VCP_HW_FLOW_CONTROL
+// The CTSE and RTSE bits can only be changed with the UART disabled
+static void vcp_flow_control_init(UART_HandleTypeDef *p_huart)
+{
+    GPIO_InitTypeDef gpio = {.Pin = VCP_CTS_PIN, .Mode = GPIO_MODE_AF_PP, .Pull = GPIO_PULLDOWN,
+                             .Speed = GPIO_SPEED_FREQ_LOW, .Alternate = GPIO_AF1_USART2};
+    uint32_t flags = USART_CR3_CTSE;
+
+#if VCP_RX_LINE_SIZE
+    gpio.Pin |= VCP_RTS_PIN;
+    flags |= USART_CR3_RTSE;
+#endif
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    HAL_GPIO_Init(VCP_FLOW_GPIO_PORT, &gpio);
+
+    __HAL_UART_DISABLE(p_huart);
+    SET_BIT(p_huart->Instance->CR3, flags);
+    p_huart->Init.HwFlowCtl = flags;
+    __HAL_UART_ENABLE(p_huart);
+}
+#endif
+
+
+#if VCP_AUTOBAUD
+static uint32_t             mAbCycles;                      // Counted by vcp_ab_expired() since vcp_ab_start()
+static uint32_t             mAbLastVal;
+
+
+// The handshake runs in vcp_init(), before the scheduler starts and with the interrupts masked by the
+// thread creations, so it is timed by polling SysTick. FreeRTOS sets it up again when it starts.
+static void vcp_ab_start(void)
+{
+    if(!(SysTick->CTRL & SysTick_CTRL_ENABLE_Msk))
+    {
+        SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+        SysTick->VAL  = 0;
+        SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+    }
+    mAbLastVal = SysTick->VAL;
+    mAbCycles  = 0;
+}
+
+
+// Must be called more often than the SysTick period
+static bool vcp_ab_expired(uint32_t ms)
+{
+    uint32_t val = SysTick->VAL;
+
+    mAbCycles += (mAbLastVal >= val) ? mAbLastVal - val : mAbLastVal + SysTick->LOAD + 1 - val;
+    mAbLastVal = val;
+    return mAbCycles >= ms * (SystemCoreClock / 1000);
+}
+
+
+static void vcp_ab_delay(uint32_t ms)
+{
+    vcp_ab_start();
+    while(!vcp_ab_expired(ms));
+}
+
+
+// CRC-32 of zlib, so the host checks it with zlib.crc32()
+static uint32_t vcp_ab_crc32(const uint8_t *pData, uint32_t length)
+{
+    uint32_t crc = 0xFFFFFFFFUL;
+    uint32_t i;
+
+    while(length--)
+    {
+        crc ^= *pData++;
+        for(i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xEDB88320UL & -(crc & 1));
+    }
+    return ~crc;
+}
+
+
+static inline uint32_t vcp_ab_get32(const uint8_t *pData)
+{
+    return pData[0] | (pData[1] << 8) | (pData[2] << 16) | ((uint32_t)pData[3] << 24);
+}
+
+
+static inline void vcp_ab_put32(uint8_t *pData, uint32_t value)
+{
+    pData[0] = (uint8_t)value;
+    pData[1] = (uint8_t)(value >> 8);
+    pData[2] = (uint8_t)(value >> 16);
+    pData[3] = (uint8_t)(value >> 24);
 }
 
 
+// Sends a message, the probe carries VCP_AB_PROBE_SIZE more bytes of alternating bit patterns
+static void vcp_ab_send(USART_TypeDef *pUart, char type, uint32_t value)
+{
+    uint8_t msg[VCP_AB_MAX_SIZE];
+    uint32_t length = VCP_AB_HDR_SIZE;
+    uint32_t i;
+
+    memcpy(msg, VCP_AB_SYNC, 2);
+    msg[2] = (uint8_t)type;
+    vcp_ab_put32(&msg[3], value);
+    if(type == 'P')
+    {
+        for(i = 0; i < VCP_AB_PROBE_SIZE; i++)
+            msg[length++] = (uint8_t)((i & 1) ? ~(i * 0x11) : (i * 0x5B));
+    }
+    vcp_ab_put32(&msg[length], vcp_ab_crc32(msg, length));
+    vcp_panic_write(pUart, msg, length + 4);
+    while(!(pUart->ISR & USART_ISR_TC));
+}
+
+
+// Waits for a message of the host, false on timeout. Bytes that do not start with the sync bytes and
+// messages with a bad CRC are skipped.
+static bool vcp_ab_receive(USART_TypeDef *pUart, char *pType, uint32_t *pValue, uint32_t timeoutMs)
+{
+    uint8_t msg[VCP_AB_HDR_SIZE + 4];
+    uint32_t length = 0;
+    uint8_t byte;
+
+    vcp_ab_start();
+    while(!vcp_ab_expired(timeoutMs))
+    {
+        if(pUart->ISR & USART_ISR_ORE)
+            pUart->ICR = USART_ICR_ORECF;
+        if(!(pUart->ISR & USART_ISR_RXNE_RXFNE))
+            continue;
+
+        byte = (uint8_t)pUart->RDR;
+        if(length < 2 && byte != (uint8_t)VCP_AB_SYNC[length])
+            length = (byte == (uint8_t)VCP_AB_SYNC[0]);
+        else
+            msg[length++] = byte;
+
+        if(length == sizeof(msg))
+        {
+            if(vcp_ab_get32(&msg[VCP_AB_HDR_SIZE]) == vcp_ab_crc32(msg, VCP_AB_HDR_SIZE))
+            {
+                *pType  = (char)msg[2];
+                *pValue = vcp_ab_get32(&msg[3]);
+                return true;
+            }
+            length = 0;
+        }
+    }
+    return false;
+}
+
+
+// Oversampling by 8 reaches a baud rate of the kernel clock / 8
+static void vcp_ab_set_baudrate(UART_HandleTypeDef *p_huart, uint32_t baudrate)
+{
+    uint32_t div = UART_DIV_SAMPLING8(HAL_RCCEx_GetPeriphCLKFreq(VCP_UART_PERIPHCLK), baudrate, p_huart->Init.ClockPrescaler);
+
+    while(!(p_huart->Instance->ISR & USART_ISR_TC));
+    __HAL_UART_DISABLE(p_huart);
+    SET_BIT(p_huart->Instance->CR1, USART_CR1_OVER8);
+    p_huart->Instance->BRR = (div & 0xFFF0U) | ((div & 0x000FU) >> 1);
+    p_huart->Init.OverSampling = UART_OVERSAMPLING_8;
+    p_huart->Init.BaudRate = baudrate;
+    __HAL_UART_ENABLE(p_huart);
+}
+
+
+// Offers each rate to the host in turn. Once the host accepts one, both switch to it and the host
+// echoes the CRC checked probe with 'K' for the rate to be kept. Otherwise both go back to the last
+// good one, where 'D' ends the handshake. Without host tool, the first offer times out after
+// VCP_AUTOBAUD_TIMEOUT_MS and nothing else is sent.
+static void vcp_autobaud(UART_HandleTypeDef *p_huart)
+{
+    static const uint32_t rates[] = VCP_AUTOBAUD_RATES;
+    USART_TypeDef *pUart = p_huart->Instance;
+    uint32_t goodRate = p_huart->Init.BaudRate;
+    bool isHostFound = false;
+    uint32_t value;
+    uint32_t i;
+    char type;
+
+    pUart->RQR = USART_RQR_RXFRQ;
+    for(i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+    {
+        if(rates[i] <= goodRate)
+            continue;
+
+        vcp_ab_send(pUart, 'O', rates[i]);
+        if(!vcp_ab_receive(pUart, &type, &value, VCP_AUTOBAUD_TIMEOUT_MS))
+            break;
+        isHostFound = true;
+        if(type != 'A' || value != rates[i])
+            break;                                  // Refused ('N'), the host port can not go faster
+
+        vcp_ab_set_baudrate(p_huart, rates[i]);
+        vcp_ab_delay(VCP_AUTOBAUD_SETTLE_MS);
+        vcp_ab_send(pUart, 'P', rates[i]);
+        if(vcp_ab_receive(pUart, &type, &value, 2 * VCP_AUTOBAUD_TIMEOUT_MS) && type == 'K' && value == rates[i])
+            goodRate = rates[i];
+        else
+        {
+            vcp_ab_set_baudrate(p_huart, goodRate);
+            vcp_ab_delay(VCP_AUTOBAUD_SETTLE_MS);
+            break;
+        }
+    }
+
+    if(isHostFound)
+        vcp_ab_send(pUart, 'D', goodRate);
+    pUart->RQR = USART_RQR_RXFRQ;
+}
+#endif
+
+
+#if VCP_LOW_POWER
+// Cancels the sleep while there is output left, so the ongoing transfer ends before the UART clock
+// stops. The next idle period sleeps once both the input buffer and the UART are empty.
+void vcp_pre_sleep(uint32_t *pIdleTime)
+{
+    bool isBusy = mp_huart && (vcp_tx_is_busy() || !(mp_huart->Instance->ISR & USART_ISR_TC));
+
+#if VCP_ZERO_COPY
+    isBusy |= (mRingWrIdx != mRingRdIdx);
+#elif !VCP_DIRECT
+    isBusy |= mp_huart && (!xStreamBufferIsEmpty(inputStream) || !VCP_URGENT_IS_EMPTY());
+#endif
+#if VCP_TX_IRQ
+    isBusy |= mp_huart && READ_BIT(mp_huart->Instance->VCP_TX_IE_REG, VCP_TX_IE);
+#endif
+    if(isBusy)
+        *pIdleTime = 0;
+}
+#endif
+
+
 void vcp_init(UART_HandleTypeDef *p_huart)
 {
     mp_huart = p_huart;
-    inputStream = xStreamBufferCreateStatic(sizeof(inputStreamBuffer), 1, inputStreamBuffer, &inputStreamCb);
+    mDroppedBytes = 0;
+#if VCP_OVERFLOW_POLICY == VCP_OVERFLOW_MARKER
+    mLostBytes = 0;
+#endif
+#if VCP_ZERO_COPY
+    static_assert(!(VCP_INPUT_BUFFER_SIZE & (VCP_INPUT_BUFFER_SIZE - 1)), "VCP input buffer size must be power of 2");
+    mRingWrIdx = 0;
+    mRingRdIdx = 0;
+#elif !VCP_DIRECT
+    static_assert(VCP_TRIGGER_LEVEL >= 1 && VCP_TRIGGER_LEVEL <= VCP_INPUT_BUFFER_SIZE, "VCP trigger level must fit in the input buffer");
+    inputStream = xStreamBufferCreateStatic(sizeof(inputStreamBuffer), VCP_TRIGGER_LEVEL, inputStreamBuffer, &inputStreamCb);
+    (void)log_queue_monitor_stream(inputStream, "vcp_input");
+#endif
+#if VCP_URGENT_BUFFER_SIZE
+    urgentStream = xStreamBufferCreateStatic(sizeof(urgentStreamBuffer), 1, urgentStreamBuffer, &urgentStreamCb);
+    (void)log_queue_monitor_stream(urgentStream, "vcp_urgent");
+#endif
+
+#if VCP_AUTOBAUD
+    vcp_autobaud(p_huart);
+#endif
+#if VCP_TX_FIFO
+    HAL_UARTEx_EnableFifoMode(p_huart);     // The TX threshold set by MX_USART2_UART_Init() is kept
+#endif
+#if VCP_HW_FLOW_CONTROL
+    vcp_flow_control_init(p_huart);
+#endif
+#if VCP_LOW_POWER
+    VCP_UART_CLK_SLEEP_DISABLE();           // Only runs while the core does, vcp_pre_sleep() waits for it
+#endif
+#if VCP_TX_IRQ && !VCP_ZERO_COPY
+    mTxChunkLen = 0;
+    mTxChunkIdx = 0;
+#endif
+
+#if VCP_USE_DMA && VCP_LL_TX
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    mIsDmaBusy = false;
+
+    LL_DMA_ConfigTransfer(DMA1, VCP_DMA_LL_CHANNEL, LL_DMA_DIRECTION_MEMORY_TO_PERIPH | LL_DMA_MODE_NORMAL |
+                          LL_DMA_PERIPH_NOINCREMENT | LL_DMA_MEMORY_INCREMENT | LL_DMA_PDATAALIGN_BYTE |
+                          LL_DMA_MDATAALIGN_BYTE | LL_DMA_PRIORITY_LOW);
+    LL_DMA_SetPeriphAddress(DMA1, VCP_DMA_LL_CHANNEL, (uint32_t)&p_huart->Instance->TDR);
+    LL_DMA_SetPeriphRequest(DMA1, VCP_DMA_LL_CHANNEL, VCP_DMA_REQUEST);
+    LL_DMA_EnableIT_TC(DMA1, VCP_DMA_LL_CHANNEL);
+
+    HAL_NVIC_SetPriority(VCP_DMA_IRQn, VCP_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(VCP_DMA_IRQn);
+#elif VCP_USE_DMA
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    mHdmaTx.Instance                 = VCP_DMA_CHANNEL;
+    mHdmaTx.Init.Request             = VCP_DMA_REQUEST;
+    mHdmaTx.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+    mHdmaTx.Init.PeriphInc           = DMA_PINC_DISABLE;
+    mHdmaTx.Init.MemInc              = DMA_MINC_ENABLE;
+    mHdmaTx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    mHdmaTx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    mHdmaTx.Init.Mode                = DMA_NORMAL;
+    mHdmaTx.Init.Priority            = DMA_PRIORITY_LOW;
+    HAL_DMA_Init(&mHdmaTx);
+    __HAL_LINKDMA(p_huart, hdmatx, mHdmaTx);
+
+    HAL_NVIC_SetPriority(VCP_DMA_IRQn, VCP_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(VCP_DMA_IRQn);
+#endif
+#if (VCP_USE_DMA && !VCP_LL_TX) || VCP_RX_LINE_SIZE || VCP_TX_IRQ
+    HAL_NVIC_SetPriority(VCP_UART_IRQn, VCP_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(VCP_UART_IRQn);
+#endif
+#if VCP_RX_DMA
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    mHdmaRx.Instance                 = VCP_RX_DMA_CHANNEL;
+    mHdmaRx.Init.Request             = VCP_RX_DMA_REQUEST;
+    mHdmaRx.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+    mHdmaRx.Init.PeriphInc           = DMA_PINC_DISABLE;
+    mHdmaRx.Init.MemInc              = DMA_MINC_ENABLE;
+    mHdmaRx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    mHdmaRx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    mHdmaRx.Init.Mode                = DMA_CIRCULAR;
+    mHdmaRx.Init.Priority            = DMA_PRIORITY_LOW;
+    HAL_DMA_Init(&mHdmaRx);
+    __HAL_LINKDMA(p_huart, hdmarx, mHdmaRx);
+
+    HAL_NVIC_SetPriority(VCP_RX_DMA_IRQn, VCP_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(VCP_RX_DMA_IRQn);
+#endif
+#if VCP_RX_LINE_SIZE
+    mRxLen = 0;
+    vcp_rx_start();
+#endif
 }
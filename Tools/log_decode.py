@@ -0,0 +1,1130 @@
+#!/usr/bin/env python3
+"""
+Host decoder for the binary output mode of the logger (LOG_BINARY_OUTPUT set to 1 in log.h).
+
+Reads the encoded records from a file, stdin or a serial port and writes the same text that the
+target would have printed in text mode to stdout. Files are mapped in memory and decoded from there,
+streams are read in chunks of what is available, and the output is only flushed when the input
+has to be waited for, so long captures decode at several MB/s and live ports without delay.
+
+Record format: a tag byte with the item type + 1 in the low nibble and the color in the high
+nibble, followed by:
+- string: varint length + characters
+- char: 1 byte length + characters
+- numbers: varint value, zigzag encoded for signed types (64 bit decimals use the same tags,
+  64 bit hexadecimals have their own type field 12)
+- array: 1 byte element type, varint number of elements, then each element as a number. If bit 7
+  of the element type is set (LOG_ARRAY_DELTA), each element is instead the zigzag varint difference
+  with the previous one modulo 2^32, and a difference of 0 is followed by the varint number of
+  further repeats
+- fixed point (type field 10): 1 byte fraction bits (bit 7 set if unsigned), 1 byte decimals,
+  then the varint value
+- float (type field 11): 1 byte decimals, then the 4 bytes of the IEEE 754 value
+- hexdump (type field 13): varint length + raw bytes, printed 16 per line like hexdump -C
+- interned string (type field 14): varint offset of the string in the .log_strings section of
+  the firmware ELF file (LOG_INTERN_STRINGS set to 1), which must then be passed with --elf
+If LOG_TIMESTAMPS is set to 1, every tag is followed by the zigzag varint difference between the
+timestamp of the record and the one of the previous record (--timestamps). They are printed as
+"[+ticks] " at the start of each line, relative to the start of the previous line, like the target
+does in text mode.
+If LOG_SEQUENCE_NUMBERS is set to 1, every tag is then followed by the 16 bit little endian sequence
+number of the record (--seq). Dropped records leave gaps, which are reported on stderr with a
+summary of the losses at the end: the gaps across a packet lost by --packets are transport losses,
+the others were dropped by the target before reaching the output.
+A tag of 0 means the input FIFO of the target was found full.
+With LOG_LOCATIONS set to 1, a tag of 0xE0 is a LOG_HERE() record, followed by its timestamp and the
+4 little endian bytes of the 16 bit line and the 16 bit hash of the file name. --sources hashes the
+names of the .c and .h files under the given directories like log.h does (the path suffixes too,
+for compilers without __FILE_NAME__) and prints "file:line", or "@hash:line" like the target in text
+mode if no name matches.
+A tag of 0xD0 is a log_kv() record, followed by its timestamp and a CBOR map (RFC 8949) of its pairs:
+integer or text string values, text string keys or unsigned ones for the interned keys, which are
+offsets in .log_strings like the interned strings. It is printed as "key=value key=value" like in
+text mode, or as one JSON object per line with --json.
+With LOG_RTOS_TRACE set to 1 in log_trace.h, a tag of 0xF0 + enum log_trace_event is a kernel event,
+followed by its timestamp and the varint word offset in RAM of the task or queue, or the exception
+number of the ISR enter and exit events. It prints nothing and only goes to --trace.
+
+If LOG_COMPRESS is set to 1, the output (text or binary) is LZSS compressed and must be decoded
+with --compressed, adding --text if LOG_BINARY_OUTPUT is not set. Tokens:
+- 0nnnnnnn: n + 1 literal bytes follow
+- 1llllldd dddddddd: copy l + 3 bytes from d + 1 bytes back, the copy may overlap itself
+- 0xFF 0xFF 'L' 'Z': resync marker sent every LOG_COMPRESS_SYNC_BYTES, the window restarts empty
+A match farther back than the last marker, or a lost packet, means bytes were missed: the decoder
+then skips to the next marker. A capture that starts after log_init() resyncs the same way, and
+without markers (LOG_COMPRESS_SYNC_BYTES set to 0) it must start before log_init().
+
+The output of the SPI backend (SPI_LOG_BACKEND set to 1 in spi_log.h) is cut into frames of 0xA5 0x5A,
+the 16 bit little endian payload length and the payload, which --spi removes from the MOSI bytes of
+a capture before any other decoding. Add --text if the output is neither binary nor compressed.
+
+If LOG_PACKETS is set to 1, the output is sent in COBS encoded packets ending with a zero byte, which
+--packets decodes after --spi and before --compressed. Each packet holds the 16 bit little endian
+sequence number, the output bytes and the little endian zlib CRC-32 of both. Packets with a bad CRC
+are skipped and the gaps of the sequence numbers are reported as lost packets on stderr. The
+output of the lost ones is missing, with --compressed the output after them may be wrong too.
+With STRIPE_BACKEND set to 1 in stripe.h, the packets are spread over USART2 and USART1, which
+--stripe reads from a second port (or capture file) and merges back by sequence number. Each lane
+is in order by itself, so a packet is only counted lost once both lanes are past it, and a live lane
+without packets holds the other one back by 0.2 s at most.
+
+With VCP_AUTOBAUD set to 1 in vcp.h, the target offers higher baud rates at boot and --autobaud
+answers from the --baud one, so the tool must be started before the target is reset. Messages are
+"AB", a type byte, a 32 bit little endian value and the zlib CRC-32 of the bytes before it:
+- 'O' rate offered by the target, answered with 'A' (accept) or 'N' (above --max-baud)
+- 'P' probe sent at the new rate, with 64 more bytes before the CRC, echoed with 'K' if intact
+- 'D' final rate, the log output follows
+
+With --timestamps, --trace also writes the lines to a file in the JSON trace event format, which
+Perfetto (ui.perfetto.dev) and chrome://tracing open, as instant events on a timeline in
+microseconds from the first record. The timestamps are LOG_TIMESTAMP_GET() ticks, --tick-hz gives
+their frequency. Records more than 2^31 ticks apart can not be told from earlier ones. With kernel
+events, each task gets a track of complete events while it runs, the lines go on the track of the
+task that was running when they were logged (records are in that order unless LOG_PER_CONTEXT_FIFOS
+is set), and queue events are instants on the running task or on the "ISR" track. Tasks are named
+after the symbols of their control blocks (static ones, such as logger_th_cb) if --elf is given.
+
+With LOG_TIME_SYNC set to 1, --sync sends the "logsync <beacon>" lines of the target every
+--sync-period seconds through --port and maps the record timestamps to the host time from its
+"Log sync node n beacon b ticks t" answers: the last answer gives the offset, the first one and the
+last one the frequency of the target clock (--tick-hz until they are a second apart). Each line
+then starts with "[<host seconds> node <n>] ", the lines before the first answer with the time
+they are decoded at. Tools/log_merge.py merges the outputs of several boards on that prefix.
+With LOG_RTC_ANCHOR_MS, --rtc maps them instead to the calendar time of the "Log RTC anchor <seconds>
+s <ms> ms" lines of the target, the frequency of its clock measured the same way between anchors.
+Each line after the first anchor then starts with "[YYYY-MM-DD hh:mm:ss.mmm] ", in UTC.
+
+Usage:
+    log_decode.py capture.bin
+    log_decode.py --elf "Debug/frtos_logger.elf" --port /dev/ttyACM0 --baud 2000000
+    log_decode.py --compressed --text capture.bin
+    log_decode.py --spi --text mosi.bin
+    log_decode.py --packets --port /dev/ttyACM0
+    log_decode.py --packets --port /dev/ttyACM0 --stripe /dev/ttyUSB0
+    log_decode.py --timestamps --trace trace.json capture.bin
+    log_decode.py --seq --packets --port /dev/ttyACM0
+    log_decode.py --timestamps --sync --port /dev/ttyACM0 > node1.log
+    log_decode.py --timestamps --rtc capture.bin
+    log_decode.py --port /dev/ttyACM0 --autobaud --max-baud 6000000
+    log_decode.py --sources Src --sources Inc --port /dev/ttyACM0
+"""
+
+import argparse
+import json
+import mmap
+import os
+import queue
+import re
+import stat
+import struct
+import sys
+import threading
+import time
+import zlib
+
+
+# Must match enum log_data_type and enum log_color in Inc/log.h
+LOG_STRING, LOG_UINT_DEC, LOG_INT_DEC_1, LOG_INT_DEC_2, LOG_INT_DEC_4, \
+    LOG_HEX_1, LOG_HEX_2, LOG_HEX_4, LOG_CHAR, LOG_ARRAY = range(10)
+LOG_FIXED, LOG_FLOAT = 10, 11
+LOG_HEX_8 = 12
+LOG_HEXDUMP = 13
+LOG_FIXED_UNSIGNED = 0x80
+LOG_ARRAY_DELTA = 0x80
+LOG_STRING_ID = 14
+LOG_TRACE_TAG = 0xF0
+LOG_LOCATION_TAG = 0xE0
+LOG_KV_TAG = 0xD0
+CBOR_UINT, CBOR_NEGINT, CBOR_TEXT, CBOR_MAP = 0, 1, 3, 5
+LOG_COLOR_DEFAULT = 0
+LOG_COLOR_NONE = 10
+
+HEX_DIGITS = {LOG_HEX_1: 2, LOG_HEX_2: 4, LOG_HEX_4: 8, LOG_HEX_8: 16}
+SIGNED_TYPES = (LOG_INT_DEC_1, LOG_INT_DEC_2, LOG_INT_DEC_4)
+FIFO_FULL_MSG = b"\r\nLog input FIFO full\r\n"
+
+# Must match enum log_trace_event in Inc/log_trace.h
+TRACE_EVENTS = ("switched in", "task create", "task delete", "task delay", "queue send", "queue send failed",
+                "queue receive", "queue receive failed", "queue block send", "queue block receive",
+                "queue send from ISR", "queue receive from ISR", "ISR enter", "ISR exit")
+TRACE_SWITCHED_IN, TRACE_TASK_CREATE, TRACE_TASK_DELETE = range(3)
+TRACE_FROM_ISR = (10, 11)
+TRACE_ISR_ENTER, TRACE_ISR_EXIT = 12, 13
+SRAM_BASE = 0x20000000
+
+
+def read_elf_section(path, name):
+    """Returns the content of a section of a little endian ELF file"""
+    with open(path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF" or elf[5] != 1:
+        raise ValueError("%s is not a little endian ELF file" % path)
+
+    if elf[4] == 1:                                     # 32-bit, as generated for the target
+        shoff, = struct.unpack_from("<I", elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x2E)
+        header = "<IIIIII"
+    else:
+        shoff, = struct.unpack_from("<Q", elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x3A)
+        header = "<IIQQQQ"
+
+    # Name, type, flags, address, offset and size of each section
+    sections = [struct.unpack_from(header, elf, shoff + i * shentsize) for i in range(shnum)]
+    names_offset = sections[shstrndx][4]
+
+    for sh_name, _, _, _, offset, size in sections:
+        end = elf.index(b"\0", names_offset + sh_name)
+        if elf[names_offset + sh_name:end] == name.encode():
+            return elf[offset:offset + size]
+    raise ValueError("section %s not found in %s" % (name, path))
+
+
+def read_elf_symbols(path):
+    """Returns the names of the data objects of a 32-bit ELF file by address"""
+    symtab = read_elf_section(path, ".symtab")
+    strtab = read_elf_section(path, ".strtab")
+    symbols = {}
+    for name, value, _, info, _, _ in struct.iter_unpack("<IIIBBH", symtab):
+        if info & 0x0F == 1:                            # STT_OBJECT
+            symbols[value] = strtab[name:strtab.index(b"\0", name)].decode(errors="replace")
+    return symbols
+
+
+class Reader:
+    """Buffered input, a regular file is mapped in memory, other streams are read in chunks of what
+    they have. wait() is called before blocking on the stream."""
+
+    CHUNK = 65536
+
+    def __init__(self, stream, wait=None):
+        self.stream = stream
+        self.wait = wait
+        self.buf = b""
+        self.pos = 0
+        try:
+            if stat.S_ISREG(os.fstat(stream.fileno()).st_mode) and os.fstat(stream.fileno()).st_size:
+                self.buf = mmap.mmap(stream.fileno(), 0, access=mmap.ACCESS_READ)
+                self.pos = stream.tell()
+                self.stream = None                      # Everything is in the mapping
+        except (AttributeError, OSError, ValueError):
+            pass
+
+    def fill(self):
+        if self.stream is None:
+            raise EOFError
+        data = b""
+        while not data:                                 # Serial ports return empty on timeout
+            if self.wait:
+                self.wait()
+            if hasattr(self.stream, "in_waiting"):
+                data = self.stream.read(max(1, self.stream.in_waiting))
+            elif hasattr(self.stream, "read1"):
+                data = self.stream.read1(self.CHUNK)
+            else:
+                data = self.stream.read(self.CHUNK)
+            if not data and not getattr(self.stream, "is_open", False):
+                raise EOFError
+        self.buf = self.buf[self.pos:] + data
+        self.pos = 0
+
+    def byte(self):
+        try:
+            b = self.buf[self.pos]
+        except IndexError:
+            self.fill()
+            b = self.buf[self.pos]
+        self.pos += 1
+        return b
+
+    def bytes(self, length):
+        while len(self.buf) - self.pos < length:
+            self.fill()
+        self.pos += length
+        return bytes(self.buf[self.pos - length:self.pos])
+
+    def chunk(self):
+        """Returns what is buffered, at least one byte"""
+        if self.pos >= len(self.buf):
+            self.fill()
+        data = bytes(self.buf[self.pos:])
+        self.pos = len(self.buf)
+        return data
+
+    def varint(self):
+        b = self.byte()
+        if b < 0x80:                                    # Most values fit in one byte
+            return b
+        value = b & 0x7F
+        shift = 7
+        while True:
+            b = self.byte()
+            value |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                return value
+
+
+class Strings(dict):
+    """Interned strings by offset in the .log_strings section, each one is only searched once"""
+
+    def __init__(self, section):
+        super().__init__()
+        self.section = section
+
+    def __missing__(self, offset):
+        string = self[offset] = self.section[offset:self.section.index(b"\0", offset)]
+        return string
+
+
+class Locations(dict):
+    """File names by the 16 bit hash of the LOG_HERE() records"""
+
+    HASHED_CHARS = 32
+    PRIME = 0x01000193
+
+    @classmethod
+    def file_hash(cls, name):
+        """Must match _LOG_LOCATION_ID in Inc/log.h"""
+        value = sum(char * pow(cls.PRIME, i, 1 << 32) for i, char in enumerate(name[:cls.HASHED_CHARS])) & 0xFFFFFFFF
+        return (value ^ (value >> 16)) & 0xFFFF
+
+    def __init__(self, directories):
+        super().__init__()
+        for directory in directories:
+            for root, _, files in os.walk(directory):
+                for name in files:
+                    if not name.endswith((".c", ".h")):
+                        continue
+                    parts = os.path.relpath(os.path.join(root, name)).replace(os.sep, "/").split("/")
+                    for i in range(len(parts)):
+                        self.add("/".join(parts[i:]).encode())
+
+    def add(self, name):
+        names = self.setdefault(self.file_hash(name), [])
+        if name not in names:
+            names.append(name)
+
+    def format(self, location):
+        file_hash, line = location >> 16, location & 0xFFFF
+        names = self.get(file_hash)
+        if not names:
+            return b"@%04X:%d" % (file_hash, line)
+        return b"%s:%d" % (b"|".join(names), line)              # Several names on a collision
+
+
+class Decompressor:
+    """Stream that undoes the LZSS compression of LOG_COMPRESS, read like the raw input"""
+
+    WINDOW = 1024                                       # Largest distance of a match token
+    SYNC = b"\xFF\xFFLZ"                                # Must match LOG_COMPRESS_SYNC in Src/log.c
+
+    def __init__(self, stream):
+        self.reader = Reader(stream)
+        self.packets = stream if isinstance(stream, Depacketizer) else None
+        self.n_lost = 0
+        self.n_resyncs = 0
+        self.window = bytearray()
+        self.n_known = 0                                # Bytes since the last marker, the matches may refer to
+        self.pending = bytearray()
+
+    def resync(self):
+        """Skips the input up to the end of the next marker"""
+        self.n_resyncs += 1
+        print("Compressed: bytes missed, resync (%d so far)" % self.n_resyncs, file=sys.stderr)
+        last = bytearray()
+        while last != self.SYNC:
+            last.append(self.reader.byte())
+            del last[:-len(self.SYNC)]
+        self.window.clear()
+        self.n_known = 0
+
+    def token(self):
+        if self.packets and self.packets.n_lost != self.n_lost:
+            self.n_lost = self.packets.n_lost
+            self.resync()
+        first = self.reader.byte()
+        if first & 0x80:
+            second = self.reader.byte()
+            if first == second == 0xFF:
+                if self.reader.bytes(2) == self.SYNC[2:]:
+                    self.window.clear()
+                    self.n_known = 0
+                else:
+                    self.resync()
+                return
+            length = ((first >> 2) & 0x1F) + 3
+            dist = (((first & 0x03) << 8) | second) + 1
+            if dist > self.n_known:
+                self.resync()
+                return
+            for _ in range(length):
+                self.window.append(self.window[-dist])
+            data = self.window[-length:]
+        else:
+            data = self.reader.bytes(first + 1)
+            self.window += data
+        self.n_known += len(data)
+        if len(self.window) > 64 * self.WINDOW:         # Trimmed now and then, not for every token
+            del self.window[:-self.WINDOW]
+        self.pending += data
+
+    def read(self, size):
+        while not self.pending:
+            self.token()
+        data = bytes(self.pending[:size])
+        del self.pending[:size]
+        return data
+
+
+class Deframer:
+    """Stream that removes the frames of the SPI backend, read like the raw input"""
+
+    SYNC = (0xA5, 0x5A)                                 # Must match SPI_LOG_SYNC_0/1 in Inc/spi_log.h
+    FRAME_MAX = 256                                     # SPI_LOG_FRAME_MAX, longer lengths mean a lost sync
+
+    def __init__(self, stream):
+        self.reader = Reader(stream)
+        self.pending = bytearray()
+
+    def frame(self):
+        b = self.reader.byte()
+        while True:                                     # Skips the bytes up to the next sync sequence
+            while b != self.SYNC[0]:
+                b = self.reader.byte()
+            b = self.reader.byte()
+            if b != self.SYNC[1]:
+                continue
+            length = self.reader.byte() | (self.reader.byte() << 8)
+            if 0 < length <= self.FRAME_MAX:
+                break
+            b = self.reader.byte()
+        self.pending += self.reader.bytes(length)
+
+    def read(self, size):
+        while not self.pending:
+            self.frame()
+        data = bytes(self.pending[:size])
+        del self.pending[:size]
+        return data
+
+
+class Depacketizer:
+    """Stream that removes the COBS packets of LOG_PACKETS, read like the raw input. With a stripe
+    stream (STRIPE_BACKEND), the packets of both lanes are merged back in sequence order."""
+
+    STRIPE_WAIT = 0.2                                   # Seconds a live lane is waited for while the other has a packet
+
+    def __init__(self, stream, stripe=None):
+        self.readers = [Reader(stream)] + ([Reader(stripe)] if stripe else [])
+        self.pending = bytearray()
+        self.next_seq = None                            # Unknown until the first valid packet
+        self.n_lost = 0
+        self.n_bad = 0
+        self.lanes = None
+        if stripe:
+            self.lanes = [queue.Queue(64) for _ in self.readers]
+            self.heads = [None for _ in self.readers]
+            self.ended = [False for _ in self.readers]
+            for reader, lane in zip(self.readers, self.lanes):
+                threading.Thread(target=self.lane, args=(reader, lane), daemon=True).start()
+
+    @staticmethod
+    def cobs_decode(data):
+        out = bytearray()
+        idx = 0
+        while idx < len(data):
+            code = data[idx]
+            if not code or idx + code > len(data):
+                return None
+            out += data[idx + 1:idx + code]
+            idx += code
+            if code < 0xFF and idx < len(data):
+                out.append(0)
+        return out
+
+    def lane_packet(self, reader, is_synced):
+        """Returns the sequence number and payload of the next packet of a lane, None if it is bad"""
+        data = bytearray()
+        b = reader.byte()
+        while b:
+            data.append(b)
+            b = reader.byte()
+        packet = self.cobs_decode(data)
+        if packet is None or len(packet) < 6 or zlib.crc32(packet[:-4]) != struct.unpack("<I", packet[-4:])[0]:
+            if data and is_synced:                      # The first one is usually cut by the capture start
+                self.n_bad += 1
+                print("Packets: bad CRC (%d so far)" % self.n_bad, file=sys.stderr)
+            return None
+        return packet[0] | (packet[1] << 8), packet[2:-4]
+
+    def lane(self, reader, lane):
+        """Thread that queues the packets of one lane, then None at its end"""
+        is_synced = False
+        try:
+            while True:
+                packet = self.lane_packet(reader, is_synced)
+                if packet:
+                    is_synced = True
+                    lane.put(packet)
+        except EOFError:
+            lane.put(None)
+
+    def merged_packet(self):
+        """Each lane is in sequence order, so the next packet is the lane head closest after next_seq.
+        A live lane without packet is only waited for a while if the other one has some."""
+        for i, lane in enumerate(self.lanes):
+            if self.heads[i] is None and not self.ended[i]:
+                is_waiting = any(head is not None for head in self.heads) and self.readers[i].stream is not None
+                try:
+                    self.heads[i] = lane.get(timeout=self.STRIPE_WAIT if is_waiting else None)
+                except queue.Empty:
+                    continue
+                self.ended[i] = self.heads[i] is None
+        heads = [i for i, head in enumerate(self.heads) if head is not None]
+        if not heads:
+            raise EOFError
+        first = self.next_seq if self.next_seq is not None else min(self.heads[i][0] for i in heads)
+        i = min(heads, key=lambda i: (self.heads[i][0] - first) & 0xFFFF)
+        packet, self.heads[i] = self.heads[i], None
+        return packet
+
+    def packet(self):
+        if self.lanes:
+            packet = self.merged_packet()
+        else:
+            packet = self.lane_packet(self.readers[0], self.next_seq is not None)
+            if packet is None:
+                return
+        seq, payload = packet
+        if self.next_seq is not None and seq != self.next_seq:
+            self.n_lost += (seq - self.next_seq) & 0xFFFF
+            print("Packets: %d lost before %d (%d so far)" % ((seq - self.next_seq) & 0xFFFF, seq, self.n_lost),
+                  file=sys.stderr)
+        self.next_seq = (seq + 1) & 0xFFFF
+        self.pending += payload
+
+    def read(self, size):
+        while not self.pending:
+            self.packet()
+        data = bytes(self.pending[:size])
+        del self.pending[:size]
+        return data
+
+
+AUTOBAUD_SYNC = b"AB"
+AUTOBAUD_PROBE_SIZE = 64                                # Must match VCP_AB_PROBE_SIZE in Src/vcp.c
+AUTOBAUD_TIMEOUT = 0.05                                 # VCP_AUTOBAUD_TIMEOUT_MS in Inc/vcp.h
+
+
+def autobaud_read(port, timeout):
+    """Returns the type and value of the next message with a valid CRC, None on timeout"""
+    deadline = None if timeout is None else time.monotonic() + timeout
+    msg = bytearray()
+    while deadline is None or time.monotonic() < deadline:
+        data = port.read(1)
+        if not data:
+            continue
+        if len(msg) < 2 and data[0] != AUTOBAUD_SYNC[len(msg)]:
+            msg = bytearray(data) if data[0] == AUTOBAUD_SYNC[0] else bytearray()
+            continue
+        msg += data
+        size = 7 + (AUTOBAUD_PROBE_SIZE if len(msg) > 2 and msg[2] == ord("P") else 0) + 4
+        if len(msg) == size:
+            if struct.unpack_from("<I", msg, size - 4)[0] == zlib.crc32(msg[:size - 4]):
+                return chr(msg[2]), struct.unpack_from("<I", msg, 3)[0]
+            msg = bytearray()
+    return None
+
+
+def autobaud_send(port, msg_type, value):
+    msg = AUTOBAUD_SYNC + msg_type.encode() + struct.pack("<I", value)
+    port.write(msg + struct.pack("<I", zlib.crc32(msg)))
+    port.flush()
+
+
+def autobaud(port, max_baud):
+    """Answers the handshake of VCP_AUTOBAUD until its 'D' message, at the final rate"""
+    fallback = None                                     # Rate to go back to if 'K' did not reach the target
+    while True:
+        msg = autobaud_read(port, None if fallback is None else 3 * AUTOBAUD_TIMEOUT)
+        if msg is None:
+            port.baudrate, fallback = fallback, None
+            continue
+        msg_type, value = msg
+        if msg_type == "D":
+            port.baudrate = value
+            return
+        if msg_type != "O":
+            continue
+
+        fallback = None
+        if value > max_baud:
+            autobaud_send(port, "N", value)
+            continue
+        autobaud_send(port, "A", value)
+        previous = port.baudrate
+        port.baudrate = value
+        port.reset_input_buffer()
+        if autobaud_read(port, AUTOBAUD_TIMEOUT) == ("P", value):
+            autobaud_send(port, "K", value)
+            fallback = previous
+        else:
+            port.baudrate = previous
+            port.reset_input_buffer()
+
+
+def format_number(value, data_type):
+    if data_type in SIGNED_TYPES:
+        return b"%d" % ((value >> 1) ^ -(value & 1))
+    if data_type in HEX_DIGITS:
+        return b"%0*X" % (HEX_DIGITS[data_type], value)
+    return b"%d" % value
+
+
+def decode_delta_array(reader, elem_type, n_elems):
+    """Returns the elements of a LOG_ARRAY_DELTA array, formatted like the plain ones"""
+    values = []
+    value = 0
+    while len(values) < n_elems:
+        delta = zigzag(reader.varint())
+        value = (value + delta) & 0xFFFFFFFF
+        values += [value] * (1 + (reader.varint() if delta == 0 else 0))
+
+    if elem_type in (LOG_INT_DEC_1, LOG_INT_DEC_2, LOG_INT_DEC_4):
+        return [str(v - (1 << 32) if v >> 31 else v).encode() for v in values]
+    return [format_number(v, elem_type) for v in values]
+
+
+def format_fixed(magnitude, frac_bits, decimals, negative):
+    """Same rounding as the target: magnitude / 2^frac_bits, halves rounded up"""
+    integer = magnitude >> frac_bits
+    digits = 0
+    if frac_bits:
+        fraction = magnitude & ((1 << frac_bits) - 1)
+        digits = (fraction * 10 ** decimals + (1 << (frac_bits - 1))) >> frac_bits
+        if digits >= 10 ** decimals:
+            integer += 1
+            digits -= 10 ** decimals
+    output = b"%s%d" % (b"-" if negative else b"", integer)
+    if decimals:
+        output += b".%0*d" % (decimals, digits)
+    return output
+
+
+def format_float(bits, decimals):
+    negative = bool(bits >> 31)
+    exponent = (bits >> 23) & 0xFF
+    mantissa = bits & 0x7FFFFF
+    if exponent == 0xFF:
+        return b"nan" if mantissa else (b"-inf" if negative else b"inf")
+    if exponent:
+        mantissa |= 0x800000
+    else:
+        exponent = 1
+    if exponent > 150 + 8:
+        return b"-ovf" if negative else b"ovf"
+    if exponent >= 150:
+        return format_fixed(mantissa << (exponent - 150), 0, decimals, negative)
+    return format_fixed(mantissa, 150 - exponent, decimals, negative)
+
+
+def format_hexdump(data):
+    output = b""
+    for offset in range(0, len(data), 16):
+        line = data[offset:offset + 16]
+        hex_bytes = b" ".join(b"%02X" % byte for byte in line[:8]) + b"  " + \
+            b" ".join(b"%02X" % byte for byte in line[8:])
+        ascii_chars = bytes(byte if 0x20 <= byte <= 0x7E else 0x2E for byte in line)
+        output += b"%04X  %-49s |%s|\r\n" % (offset & 0xFFFF, hex_bytes, ascii_chars)
+    return output
+
+
+def format_color(color):
+    if color == LOG_COLOR_NONE:
+        return b""
+    if color == LOG_COLOR_DEFAULT:
+        return b"\x1b[0m"
+    return b"\x1b[3%dm" % (color - 1)
+
+
+class Timestamps:
+    def __init__(self):
+        self.now = 0
+        self.line_start = 0
+        self.is_line_start = True
+        self.total = 0                                  # Not wrapped, ticks since the first record
+        self.line_start_total = 0
+
+    def advance(self, delta):
+        """Moves to the timestamp of a kernel event, which is not part of any line"""
+        self.now = (self.now + delta) & 0xFFFFFFFF
+        self.total += delta
+
+    def prefix(self, delta):
+        self.now = (self.now + delta) & 0xFFFFFFFF
+        self.total += delta
+        if not self.is_line_start:
+            return b""
+        elapsed = (self.now - self.line_start + 0x80000000) % 0x100000000 - 0x80000000
+        self.line_start = self.now
+        self.line_start_total = self.total
+        return b"[%+d] " % elapsed
+
+
+class Sequence:
+    """Gaps of the record sequence numbers, split between the target and the transport"""
+
+    def __init__(self, depacketizer=None):
+        self.depacketizer = depacketizer
+        self.next_seq = None                            # Unknown until the first record
+        self.n_packet_errors = 0
+        self.n_records = 0
+        self.n_target_lost = 0
+        self.n_transport_lost = 0
+
+    def check(self, seq):
+        n_packet_errors = self.depacketizer.n_lost + self.depacketizer.n_bad if self.depacketizer else 0
+        if self.next_seq is not None and seq != self.next_seq:
+            n_lost = (seq - self.next_seq) & 0xFFFF
+            if n_packet_errors != self.n_packet_errors:
+                self.n_transport_lost += n_lost
+                stage = "in transport"
+            else:
+                self.n_target_lost += n_lost
+                stage = "by the target"
+            print("Records: %d lost %s before %d" % (n_lost, stage, seq), file=sys.stderr)
+        self.n_packet_errors = n_packet_errors
+        self.next_seq = (seq + 1) & 0xFFFF
+        self.n_records += 1
+
+    def skip(self, n_items):
+        """Items sent inside the previous record, like the pairs of log_kv(), which have their own numbers"""
+        self.next_seq = (self.next_seq + n_items) & 0xFFFF
+
+    def summary(self):
+        print("Records: %d received, %d lost by the target, %d lost in transport" %
+              (self.n_records, self.n_target_lost, self.n_transport_lost), file=sys.stderr)
+
+
+class HostClock:
+    """Sends the sync beacons and maps the record ticks to the host time from their answers"""
+
+    SYNC_LINE = re.compile(rb"Log sync node (\d+) beacon (\d+) ticks \d+")
+    MAX_PENDING = 16                                    # Beacons kept waiting for their answer
+
+    def __init__(self, port, period, tick_hz):
+        self.port = port
+        self.period = period
+        self.rate = float(tick_hz)
+        self.n_beacons = 0
+        self.next_send = 0.0
+        self.sent = {}                                  # Host time of the beacons not answered yet
+        self.first = None                               # (ticks, host time) of the first answer
+        self.last = None
+        self.node = None
+        self.line = b""
+        self.line_ticks = 0
+
+    def poll(self):
+        now = time.time()
+        if now < self.next_send:
+            return
+        self.sent[self.n_beacons] = now
+        self.sent.pop(self.n_beacons - self.MAX_PENDING, None)
+        self.port.write(b"logsync %d\r" % self.n_beacons)
+        self.n_beacons += 1
+        self.next_send = now + self.period
+
+    def prefix(self, ticks):
+        self.line_ticks = ticks
+        host_time = self.last[1] + (ticks - self.last[0]) / self.rate if self.last else time.time()
+        return b"[%.6f node %s] " % (host_time, b"?" if self.node is None else b"%d" % self.node)
+
+    def record(self, record):
+        self.line += record
+        if not record.endswith(b"\n"):
+            return
+        match = self.SYNC_LINE.search(self.line)
+        self.line = b""
+        if not match or int(match.group(2)) not in self.sent:
+            return
+        self.node = int(match.group(1))
+        self.last = (self.line_ticks, self.sent.pop(int(match.group(2))))
+        if not self.first:
+            self.first = self.last
+        elif self.last[1] - self.first[1] >= 1.0:
+            self.rate = (self.last[0] - self.first[0]) / (self.last[1] - self.first[1])
+
+
+class RtcClock:
+    """Maps the record ticks to the wall clock time of the LOG_RTC_ANCHOR_MS anchors of the target"""
+
+    ANCHOR_LINE = re.compile(rb"Log RTC anchor (\d+) s (\d+) ms")
+
+    def __init__(self, tick_hz):
+        self.rate = float(tick_hz)
+        self.first = None                               # (ticks, seconds since 1970) of the first anchor
+        self.last = None
+        self.line = b""
+        self.line_ticks = 0
+
+    def poll(self):
+        pass
+
+    def prefix(self, ticks):
+        self.line_ticks = ticks
+        if not self.last:
+            return b""
+        wall = self.last[1] + (ticks - self.last[0]) / self.rate
+        return b"[%s.%03d] " % (time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(wall)).encode(), int(wall * 1000) % 1000)
+
+    def record(self, record):
+        self.line += record
+        if not record.endswith(b"\n"):
+            return
+        match = self.ANCHOR_LINE.search(self.line)
+        self.line = b""
+        if not match:
+            return
+        self.last = (self.line_ticks, int(match.group(1)) + int(match.group(2)) / 1000.0)
+        if not self.first:
+            self.first = self.last
+        elif self.last[1] - self.first[1] >= 1.0:
+            self.rate = (self.last[0] - self.first[0]) / (self.last[1] - self.first[1])
+
+
+class TraceWriter:
+    """JSON trace event file of the decoded lines and kernel events, opened by Perfetto and chrome://tracing"""
+
+    STRIP = re.compile(rb"\x1b\[[0-9;]*m|^\[[+-]?\d+\] |\s+$")    # Colors, line prefix, line end
+
+    def __init__(self, path, tick_hz, symbols):
+        self.file = open(path, "w")
+        self.tick_us = 1e6 / tick_hz
+        self.symbols = symbols                          # Task and queue names by address
+        self.tracks = {}                                # Thread id of each track by task address
+        self.line = b""
+        self.line_start = 0
+        self.line_tid = 0
+        self.separator = "\n"
+        self.file.write('{"displayTimeUnit": "ns", "traceEvents": [')
+        self.event({"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "Target"}})
+        self.tid = self.track(None, "Log")              # Running task, until the first switch
+        self.run_start = None
+        self.last = 0
+
+    def event(self, event):
+        self.file.write(self.separator + json.dumps(event, separators=(",", ":")))
+        self.separator = ",\n"
+
+    def ts(self, ticks):
+        return round(ticks * self.tick_us, 3)
+
+    def track(self, key, name):
+        tid = self.tracks.get(key)
+        if tid is None:
+            tid = self.tracks[key] = len(self.tracks)
+            self.event({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid, "args": {"name": name}})
+        return tid
+
+    def name(self, address):
+        return self.symbols.get(address, "0x%08X" % address)
+
+    def task_track(self, address):
+        return self.track(address, self.symbols.get(address, "task 0x%08X" % address))
+
+    def line_event(self):
+        self.event({"name": self.STRIP.sub(b"", self.line).decode(errors="replace"), "ph": "i", "s": "t",
+                    "ts": self.ts(self.line_start), "pid": 1, "tid": self.line_tid})
+        self.line = b""
+
+    def record(self, data, timestamps):
+        """Adds the output of a record, an event is written at the end of each line"""
+        self.last = timestamps.total
+        if not self.line:
+            self.line_start = timestamps.line_start_total
+            self.line_tid = self.tid
+        self.line += data
+        if timestamps.is_line_start:
+            self.line_event()
+
+    def end_run(self, ticks):
+        if self.run_start is not None:
+            self.event({"name": "running", "ph": "X", "ts": self.ts(self.run_start),
+                        "dur": round(self.ts(ticks) - self.ts(self.run_start), 3), "pid": 1, "tid": self.tid})
+
+    def kernel_event(self, event, address, ticks):
+        """Adds a kernel event, the running time of a task ends when another one is switched in"""
+        self.last = ticks
+        if event == TRACE_SWITCHED_IN:
+            tid = self.task_track(address)
+            if tid != self.tid or self.run_start is None:     # Also called when the same task goes on
+                self.end_run(ticks)
+                self.tid = tid
+                self.run_start = ticks
+            return
+
+        if event in (TRACE_ISR_ENTER, TRACE_ISR_EXIT):         # The object is the exception number
+            self.event({"name": "ISR %d" % ((address - SRAM_BASE) >> 2), "ph": "B" if event == TRACE_ISR_ENTER else "E",
+                        "ts": self.ts(ticks), "pid": 1, "tid": self.track("ISR", "ISR")})
+            return
+
+        name = TRACE_EVENTS[event] if event < len(TRACE_EVENTS) else "event %d" % event
+        if event in TRACE_FROM_ISR:
+            tid = self.track("ISR", "ISR")
+        elif event in (TRACE_TASK_CREATE, TRACE_TASK_DELETE):
+            tid = self.task_track(address)
+        else:
+            tid = self.tid
+        self.event({"name": name, "ph": "i", "s": "t", "ts": self.ts(ticks), "pid": 1, "tid": tid,
+                    "args": {"object": self.name(address)}})
+
+    def close(self):
+        if self.line:                                   # Last line not ended yet
+            self.line_event()
+        self.end_run(self.last)
+        self.file.write("\n]}\n")
+        self.file.close()
+
+
+COLORS = tuple(format_color(color) for color in range(16))
+NUMBER_TYPES = frozenset(range(LOG_UINT_DEC, LOG_HEX_4 + 1)) | {LOG_HEX_8}
+
+
+def zigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def decode_cbor_head(reader):
+    """Major type and argument of a CBOR head, log.c only writes the 32 bit forms"""
+    head = reader.byte()
+    argument = head & 0x1F
+    if 24 <= argument <= 26:
+        argument = int.from_bytes(reader.bytes(1 << (argument - 24)), "big")
+    elif argument > 26:
+        raise ValueError("unsupported CBOR head 0x%02X" % head)
+    return head >> 5, argument
+
+
+def decode_kv(reader, strings):
+    """Pairs of the CBOR map of a log_kv() record, keys as bytes and values as int or bytes"""
+    major, n_pairs = decode_cbor_head(reader)
+    if major != CBOR_MAP:
+        raise ValueError("log_kv() record without a CBOR map")
+    items = []
+    for i in range(2 * n_pairs):
+        major, argument = decode_cbor_head(reader)
+        if major == CBOR_TEXT:
+            items.append(reader.bytes(argument))
+        elif major == CBOR_UINT:
+            items.append(strings[argument] if i % 2 == 0 else argument)     # Keys are interned strings
+        elif major == CBOR_NEGINT and i % 2:
+            items.append(-1 - argument)
+        else:
+            raise ValueError("unsupported CBOR item of major type %d in a log_kv() record" % major)
+    return list(zip(items[0::2], items[1::2]))
+
+
+def format_kv(pairs, is_json):
+    if is_json:
+        return json.dumps({key.decode("latin-1"): value.decode("latin-1") if isinstance(value, bytes) else value
+                           for key, value in pairs}).encode() + b"\r\n"
+    return b" ".join(key + b"=" + (value if isinstance(value, bytes) else b"%d" % value)
+                     for key, value in pairs) + b"\r\n"
+
+
+def decode_record(reader, strings, timestamps, trace=None, sequence=None, locations=None, is_json=False):
+    tag = reader.byte()
+    if tag == 0:
+        return FIFO_FULL_MSG
+    if sequence:
+        sequence.check(struct.unpack("<H", reader.bytes(2))[0])
+    if tag & 0xF0 == LOG_TRACE_TAG:                     # Kernel event, only for --trace
+        if not timestamps:
+            raise ValueError("kernel event record without --timestamps")
+        timestamps.advance(zigzag(reader.varint()))
+        address = SRAM_BASE + (reader.varint() << 2)
+        if trace:
+            trace.kernel_event(tag & 0x0F, address, timestamps.total)
+        return b""
+    if tag == LOG_LOCATION_TAG:
+        output = timestamps.prefix(zigzag(reader.varint())) if timestamps else b""
+        location = struct.unpack("<I", reader.bytes(4))[0]
+        output += locations.format(location) if locations else b"@%04X:%d" % (location >> 16, location & 0xFFFF)
+        if timestamps:
+            timestamps.is_line_start = False
+        return output
+    if tag == LOG_KV_TAG:                               # A whole line
+        output = timestamps.prefix(zigzag(reader.varint())) if timestamps else b""
+        pairs = decode_kv(reader, strings)
+        output += format_kv(pairs, is_json)
+        if sequence:
+            sequence.skip(2 * len(pairs))
+        if timestamps:
+            timestamps.is_line_start = True
+        return output
+
+    data_type = (tag & 0x0F) - 1
+    output = b""
+    if timestamps:
+        output += timestamps.prefix(zigzag(reader.varint()))
+    output += COLORS[tag >> 4]
+    start = len(output)
+
+    if data_type in NUMBER_TYPES:                       # Most records, checked first
+        output += format_number(reader.varint(), data_type)
+    elif data_type == LOG_STRING:
+        output += reader.bytes(reader.varint())
+    elif data_type == LOG_CHAR:
+        output += reader.bytes(reader.byte())
+    elif data_type == LOG_ARRAY:
+        elem_type = reader.byte()
+        n_elems = reader.varint()
+        if elem_type & LOG_ARRAY_DELTA:
+            output += b" ".join(decode_delta_array(reader, elem_type & ~LOG_ARRAY_DELTA, n_elems))
+        else:
+            output += b" ".join(format_number(reader.varint(), elem_type) for _ in range(n_elems))
+    elif data_type == LOG_FIXED:
+        frac_bits = reader.byte()
+        decimals = reader.byte()
+        value = reader.varint()
+        if frac_bits & LOG_FIXED_UNSIGNED:
+            output += format_fixed(value, frac_bits & ~LOG_FIXED_UNSIGNED, decimals, False)
+        else:
+            value = zigzag(value)
+            output += format_fixed(abs(value), frac_bits, decimals, value < 0)
+    elif data_type == LOG_FLOAT:
+        decimals = reader.byte()
+        output += format_float(struct.unpack("<I", reader.bytes(4))[0], decimals)
+    elif data_type == LOG_HEXDUMP:
+        output += format_hexdump(reader.bytes(reader.varint()))
+    elif data_type == LOG_STRING_ID:
+        output += strings[reader.varint()]
+    else:
+        raise ValueError("unknown record tag 0x%02X" % tag)
+
+    if timestamps:
+        timestamps.is_line_start = data_type in (LOG_STRING, LOG_CHAR, LOG_STRING_ID, LOG_HEXDUMP) and \
+            output[start:].endswith(b"\n")
+    return output
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode the binary output of the logger")
+    parser.add_argument("input", nargs="?", help="capture file (default: stdin)")
+    parser.add_argument("--port", help="serial port to read from instead of a file")
+    parser.add_argument("--baud", type=int, default=2000000, help="serial baud rate (default: 2000000)")
+    parser.add_argument("--elf", help="firmware ELF file, needed to decode interned strings")
+    parser.add_argument("--sources", action="append", metavar="DIR",
+                        help="source directory of the LOG_HERE() file names (LOG_LOCATIONS), can be repeated")
+    parser.add_argument("--json", action="store_true", help="print the log_kv() records as JSON objects")
+    parser.add_argument("--timestamps", action="store_true", help="records carry timestamps (LOG_TIMESTAMPS)")
+    parser.add_argument("--seq", action="store_true", help="records carry sequence numbers (LOG_SEQUENCE_NUMBERS)")
+    parser.add_argument("--compressed", action="store_true", help="output is compressed (LOG_COMPRESS)")
+    parser.add_argument("--text", action="store_true", help="output is text, only decompress it (no LOG_BINARY_OUTPUT)")
+    parser.add_argument("--spi", action="store_true", help="input is framed by the SPI backend (SPI_LOG_BACKEND)")
+    parser.add_argument("--packets", action="store_true", help="output is sent in COBS packets (LOG_PACKETS)")
+    parser.add_argument("--stripe", metavar="INPUT", help="serial port (with --port) or capture of the USART1 lane of STRIPE_BACKEND")
+    parser.add_argument("--autobaud", action="store_true", help="answer the baud rate handshake of the target (VCP_AUTOBAUD)")
+    parser.add_argument("--max-baud", type=int, default=8000000, help="highest rate accepted by --autobaud (default: 8000000)")
+    parser.add_argument("--trace", metavar="FILE", help="also write the lines as JSON trace events, for Perfetto")
+    parser.add_argument("--sync", action="store_true", help="send time sync beacons and prefix the lines with the host time (LOG_TIME_SYNC)")
+    parser.add_argument("--rtc", action="store_true", help="prefix the lines with the wall clock time of the RTC anchors (LOG_RTC_ANCHOR_MS)")
+    parser.add_argument("--sync-period", type=float, default=1.0, help="seconds between two sync beacons (default: 1)")
+    parser.add_argument("--tick-hz", type=int, default=64000000,
+                        help="LOG_TIMESTAMP_GET() frequency for --trace (default: 64000000, TIM2 at the core clock)")
+    args = parser.parse_args()
+    if args.autobaud and not args.port:
+        parser.error("--autobaud needs --port")
+    if args.text and not args.compressed and not args.spi and not args.packets:
+        parser.error("--text only applies to --compressed, --spi or --packets output")
+    if args.trace and (args.text or not args.timestamps):
+        parser.error("--trace needs binary output with --timestamps")
+    if args.sync and (not args.port or args.text or not args.timestamps):
+        parser.error("--sync needs --port and binary output with --timestamps")
+    if args.rtc and (args.sync or args.text or not args.timestamps):
+        parser.error("--rtc needs binary output with --timestamps, without --sync")
+    if args.stripe and not args.packets:
+        parser.error("--stripe needs --packets, whose sequence numbers merge the lanes")
+    if args.seq and args.text:
+        parser.error("--seq needs binary output, text mode prints the numbers itself")
+
+    try:
+        strings = Strings(read_elf_section(args.elf, ".log_strings") if args.elf else b"")
+    except ValueError:                                  # No interned strings, the ELF may still name the tasks
+        strings = Strings(b"")
+
+    if args.port:
+        import serial                                   # pyserial, only needed for live decoding
+        stream = port = serial.Serial(args.port, args.baud, timeout=1)
+        if args.autobaud:
+            stream.timeout = 0.005
+            autobaud(stream, args.max_baud)
+            print("Autobaud: %d bauds" % stream.baudrate, file=sys.stderr)
+            stream.timeout = 1
+    elif args.input:
+        stream = open(args.input, "rb")
+    else:
+        stream = sys.stdin.buffer
+    stripe = None
+    if args.stripe:
+        stripe = serial.Serial(args.stripe, args.baud, timeout=1) if args.port else open(args.stripe, "rb")
+
+    if args.spi:
+        stream = Deframer(stream)
+    depacketizer = None
+    if args.packets:
+        stream = depacketizer = Depacketizer(stream, stripe)
+    if args.compressed:
+        stream = Decompressor(stream)
+
+    output = bytearray()                                # Written in big chunks, stdout may be unbuffered
+
+    def flush():
+        sys.stdout.buffer.write(output)
+        sys.stdout.buffer.flush()
+        output.clear()
+
+    clock = HostClock(port, args.sync_period, args.tick_hz) if args.sync else \
+        RtcClock(args.tick_hz) if args.rtc else None
+
+    def wait():
+        flush()
+        if clock:
+            clock.poll()
+
+    reader = Reader(stream, wait)
+    locations = Locations(args.sources) if args.sources else None
+    timestamps = Timestamps() if args.timestamps else None
+    sequence = Sequence(depacketizer) if args.seq else None
+    trace = TraceWriter(args.trace, args.tick_hz, read_elf_symbols(args.elf) if args.elf else {}) \
+        if args.trace else None
+    try:
+        while True:
+            if args.text:
+                output += reader.chunk()
+            else:
+                is_line_start = timestamps and timestamps.is_line_start
+                record = decode_record(reader, strings, timestamps, trace, sequence, locations, args.json)
+                if clock and record:
+                    if is_line_start and record is not FIFO_FULL_MSG:
+                        output += clock.prefix(timestamps.line_start_total)
+                    clock.record(record)
+                output += record
+                if trace and record:
+                    trace.record(record, timestamps)
+            if len(output) >= Reader.CHUNK:
+                flush()
+    except (EOFError, KeyboardInterrupt):
+        pass
+    finally:
+        flush()
+        if trace:
+            trace.close()
+        if sequence:
+            sequence.summary()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,280 @@
+"""
+GDB script that prints the logs still waiting in the RAM of a halted target, post mortem.
+
+The logger keeps its items in the input FIFOs until the log thread outputs them, and the VCP
+backend keeps the bytes it was given in its input buffer until the UART sends them. After a hang or
+a fault, both are in RAM but nothing is ever sent. This script reads them through the debugger,
+with the types of the ELF file, so it follows the configuration the firmware was built with and
+costs nothing on the target.
+
+Usage, with the firmware ELF file loaded and the target halted:
+    (gdb) source Tools/log_gdb.py
+    (gdb) log-dump              items of the input FIFOs, oldest first, rendered like the log thread
+    (gdb) log-dump -t           the same with "[@ticks] " at each line start (LOG_TIMESTAMPS)
+    (gdb) log-dump -r           one line per raw item: index, type and fields
+    (gdb) vcp-dump              bytes of the VCP input buffer not sent yet
+
+log-dump reads logFifo (and errorFifo, isrFifo and taskFifos[] if they exist) from rdIdx: nItems
+items with LOG_FIFO_LOCKED, wrIdx - rdIdx with the free running indexes of the other modes. Strings
+are read where their str pointer goes, in flash or RAM, and copies from the FIFO arena
+(LOG_COPY_ARENA_SIZE). Numbers, fixed point, floats, hexdumps, arrays (LOG_BULK_ARRAYS), log_enum()
+names and log_kv() records are rendered like in text mode, the other types as "<type>". Several FIFOs
+are printed one after the other, not merged by sequence number. LOG_FIFO_PACKED rings are not decoded.
+
+vcp-dump reads inputStreamBuffer between the tail and head of its stream buffer, or mRing between
+mRingRdIdx and mRingWrIdx with VCP_ZERO_COPY. Bytes of an ongoing DMA transfer have already left it.
+The output of LOG_BINARY_OUTPUT, LOG_COMPRESS or LOG_PACKETS can be saved with "vcp-dump -o file"
+and decoded by log_decode.py.
+"""
+
+import struct
+
+import gdb
+
+
+FIFO_NAMES = ["errorFifo", "isrFifo", "logFifo", "_logFifo"]
+FIXED_UNSIGNED = 0x80                               # _LOG_FIXED_UNSIGNED of log.h
+
+
+def lookup(name):
+    """Value of a global or file static variable, None if the firmware does not have it"""
+    for expression in (name, "'log.c'::" + name, "'vcp.c'::" + name):
+        try:
+            return gdb.parse_and_eval(expression)
+        except gdb.error:
+            pass
+    return None
+
+
+def has_field(value, name):
+    return any(field.name == name for field in value.type.strip_typedefs().fields())
+
+
+def read_bytes(address, length):
+    return gdb.selected_inferior().read_memory(int(address), int(length)).tobytes()
+
+
+def read_c_string(address, limit=256):
+    data = read_bytes(address, limit)
+    return data.split(b"\0", 1)[0]
+
+
+def item_field(item, name, default=0):
+    """Field of the item, looking into its anonymous unions"""
+    try:
+        return int(item[name])
+    except gdb.error:
+        return default
+
+
+def format_number(number, type_name):
+    if type_name == "_LOG_UINT_DEC":
+        return str(number & 0xFFFFFFFF)
+    for size, bits in (("1", 8), ("2", 16), ("4", 32)):
+        if type_name == "_LOG_INT_DEC_" + size:
+            number &= (1 << bits) - 1
+            return str(number - (1 << bits) if number >> (bits - 1) else number)
+        if type_name == "_LOG_HEX_" + size:
+            return "%0*X" % (bits // 4, number & ((1 << bits) - 1))
+    if type_name == "_LOG_HEX_8":
+        return "%016X" % number
+    if type_name == "_LOG_UINT_DEC_8":
+        return str(number)
+    if type_name == "_LOG_INT_DEC_8":
+        return str(number - (1 << 64) if number >> 63 else number)
+    return "<%s>" % type_name
+
+
+def format_fixed(number, frac_bits, n_decimals):
+    if not frac_bits & FIXED_UNSIGNED and number & 0x80000000:
+        number -= 1 << 32
+    value = number / float(1 << (frac_bits & ~FIXED_UNSIGNED))
+    return "%.*f" % (n_decimals, value)
+
+
+def format_hexdump(data):
+    lines = []
+    for offset in range(0, len(data), 16):
+        chunk = data[offset:offset + 16]
+        hex_part = " ".join("%02X" % byte for byte in chunk[:8])
+        if len(chunk) > 8:
+            hex_part += "  " + " ".join("%02X" % byte for byte in chunk[8:])
+        ascii_part = "".join(chr(byte) if 32 <= byte <= 126 else "." for byte in chunk)
+        lines.append("%04X  %-49s |%s|\r\n" % (offset, hex_part, ascii_part))
+    return "".join(lines)
+
+
+class Fifo:
+    def __init__(self, name, fifo):
+        self.name = name
+        self.fifo = fifo
+        self.size = int(fifo["size"])
+        self.buffer = fifo["buffer"]
+
+    def items(self):
+        """The stored items, oldest first"""
+        rd_idx = int(self.fifo["rdIdx"])
+        if has_field(self.fifo, "nItems"):
+            n_items = int(self.fifo["nItems"])      # LOG_FIFO_LOCKED, rdIdx is already masked
+        else:
+            n_items = (int(self.fifo["wrIdx"]) - rd_idx) & 0xFFFFFFFF
+        n_items = min(n_items, self.size)
+        for i in range(n_items):
+            yield (rd_idx + i) & (self.size - 1), self.buffer[(rd_idx + i) & (self.size - 1)]
+
+    def arena(self, index, length):
+        """Bytes copied at the free running index, allocations are contiguous"""
+        address = int(self.fifo["arena"]) + (index & (arena_size() - 1))
+        return read_bytes(address, length)
+
+
+def arena_size():
+    """LOG_COPY_ARENA_SIZE, the size of the arena arrays, which is not stored in the FIFOs"""
+    for name in ("logFifoArena", "isrFifoArena", "errorFifoArena"):
+        arena = lookup(name)
+        if arena is not None:
+            return arena.type.strip_typedefs().sizeof
+    raise gdb.GdbError("No copy arena in this program")
+
+
+def render_item(fifo, item):
+    type_name = str(item["type"])
+    if type_name in ("_LOG_STRING", "_LOG_ENUM"):
+        if type_name == "_LOG_ENUM":
+            index = item_field(item, "enumIndex")
+            if index >= item_field(item, "enumCount"):
+                return str(index)
+            names = item["str"].cast(gdb.lookup_type("char").pointer().pointer())
+            return read_c_string(names[index]).decode("latin-1")
+        return read_bytes(item["str"], item_field(item, "strLen")).decode("latin-1")
+    if type_name == "LOG_CHAR":
+        n_chars = item_field(item, "nChars")
+        return bytes(int(item["chr"][i]) & 0xFF for i in range(min(n_chars, 4))).decode("latin-1")
+    if type_name == "_LOG_STRING_COPY":
+        return fifo.arena(item_field(item, "arenaIdx"), item_field(item, "strLen")).decode("latin-1")
+    if type_name == "_LOG_HEXDUMP":
+        return format_hexdump(read_bytes(item["str"], item_field(item, "strLen")))
+    if type_name == "_LOG_HEXDUMP_COPY":
+        return format_hexdump(fifo.arena(item_field(item, "arenaIdx"), item_field(item, "strLen")))
+    if type_name in ("_LOG_ARRAY", "_LOG_ARRAY_COPY", "_LOG_ARRAY_STRIDE"):
+        n_elems, elem_size = item_field(item, "nElems"), item_field(item, "elemSize")
+        stride = elem_size
+        if type_name == "_LOG_ARRAY_STRIDE":
+            n_elems, stride = item_field(item, "strideElems"), item_field(item, "stride")
+        if type_name == "_LOG_ARRAY_COPY":
+            data = fifo.arena(item_field(item, "arenaIdx"), n_elems * elem_size)
+        else:
+            data = read_bytes(item["str"], max(n_elems - 1, 0) * stride + elem_size)
+        elem_type = str(item["elemType"].cast(item["type"].type))
+        formats = {1: "<B", 2: "<H", 4: "<I"}
+        return " ".join(format_number(struct.unpack_from(formats[elem_size], data, i * stride)[0], elem_type)
+                        for i in range(n_elems))
+    if type_name == "_LOG_FIXED":
+        return format_fixed(item_field(item, "uData"), item_field(item, "fracBits"), item_field(item, "nDecimals"))
+    if type_name == "_LOG_FLOAT":
+        value = struct.unpack("<f", struct.pack("<I", item_field(item, "uData")))[0]
+        return "%.*f" % (item_field(item, "nDecimals"), value)
+    if type_name == "_LOG_LOCATION":
+        location = item_field(item, "uData")
+        return "@%04X:%d" % (location >> 16, location & 0xFFFF)
+    if type_name == "_LOG_KV":                      # Its pairs follow, joined by LogDump
+        return ""
+    if type_name == "_LOG_REF":                     # Current value of the variable, as the log thread would read it
+        ref_size = item_field(item, "refSize")
+        number = int.from_bytes(read_bytes(item["str"], ref_size), "little")
+        return format_number(number, str(item["refType"].cast(item["type"].type)))
+    if type_name in ("_LOG_HEX_8", "_LOG_UINT_DEC_8", "_LOG_INT_DEC_8"):
+        return format_number(item_field(item, "uData") | item_field(item, "uDataHi") << 32, type_name)
+    return format_number(item_field(item, "uData"), type_name)
+
+
+def input_fifos():
+    fifos = []
+    for name in FIFO_NAMES:
+        fifo = lookup(name)
+        if fifo is not None and not any(int(fifo.address) == int(other.fifo.address) for other in fifos):
+            fifos.append(Fifo(name, fifo))
+    task_fifos = lookup("taskFifos")
+    if task_fifos is not None:
+        n_fifos = task_fifos.type.strip_typedefs().range()[1] + 1
+        for i in reversed(range(n_fifos)):      # Highest priority band first, like log_input_get()
+            fifos.append(Fifo("taskFifos[%d]" % i, task_fifos[i]))
+    return fifos
+
+
+class LogDump(gdb.Command):
+    """log-dump [-t] [-r]: prints the items waiting in the input FIFOs of the logger"""
+
+    def __init__(self):
+        super().__init__("log-dump", gdb.COMMAND_DATA)
+
+    def invoke(self, argument, from_tty):
+        args = argument.split()
+        fifos = input_fifos()
+        if not fifos:
+            raise gdb.GdbError("No logFifo in this program")
+        for fifo in fifos:
+            if fifo.buffer.type.strip_typedefs().target().sizeof == 1:
+                raise gdb.GdbError("LOG_FIFO_PACKED rings are not decoded")
+            if has_field(fifo.fifo, "head"):
+                raise gdb.GdbError("LOG_FIFO_SPLIT slots are not decoded")
+            items = list(fifo.items())
+            gdb.write("%s: %d items\n" % (fifo.name, len(items)))
+            is_line_start = True
+            kv_items, kv_left = 0, 0                # Keys and values of the log_kv() record being printed
+            for index, item in items:
+                if "-r" in args:
+                    gdb.write("%4d %s\n" % (index, item))
+                    continue
+                if "-t" in args and is_line_start and has_field(item, "timestamp"):
+                    gdb.write("[@%d] " % int(item["timestamp"]))
+                text = render_item(fifo, item)
+                if kv_left:
+                    position = kv_items - kv_left
+                    text = ("" if not position else "=" if position % 2 else " ") + text
+                    kv_left -= 1
+                    text += "" if kv_left else "\r\n"
+                elif str(item["type"]) == "_LOG_KV":
+                    kv_items = kv_left = 2 * item_field(item, "uData")
+                gdb.write(text.replace("\r\n", "\n"))
+                is_line_start = text.endswith("\n")
+            if not is_line_start:
+                gdb.write("\n")
+
+
+class VcpDump(gdb.Command):
+    """vcp-dump [-o file]: prints (or saves) the bytes waiting in the VCP input buffer"""
+
+    def __init__(self):
+        super().__init__("vcp-dump", gdb.COMMAND_DATA)
+
+    def invoke(self, argument, from_tty):
+        args = argument.split()
+        ring = lookup("mRing")
+        if ring is not None:                        # VCP_ZERO_COPY, free running indexes
+            size = ring.type.strip_typedefs().sizeof
+            rd_idx, wr_idx = int(lookup("mRingRdIdx")), int(lookup("mRingWrIdx"))
+            data = bytes(int(ring[(rd_idx + i) % size]) & 0xFF for i in range((wr_idx - rd_idx) & 0xFFFFFFFF))
+        else:
+            buffer, control = lookup("inputStreamBuffer"), lookup("inputStreamCb")
+            if buffer is None or control is None:
+                raise gdb.GdbError("No VCP input buffer in this program (VCP_DIRECT sends in place)")
+            try:
+                stream = control.address.cast(gdb.lookup_type("StreamBuffer_t").pointer()).dereference()
+                tail, head, length = int(stream["xTail"]), int(stream["xHead"]), int(stream["xLength"])
+            except gdb.error:
+                # StaticStreamBuffer_t mirrors the first fields of StreamBuffer_t: xTail, xHead, xLength
+                dummy = control["uxDummy1"]
+                tail, head, length = int(dummy[0]), int(dummy[1]), int(dummy[2])
+            raw = read_bytes(buffer.address, length)
+            data = raw[tail:head] if head >= tail else raw[tail:] + raw[:head]
+        if "-o" in args:
+            with open(args[args.index("-o") + 1], "wb") as output:
+                output.write(data)
+            gdb.write("%d bytes saved\n" % len(data))
+        else:
+            gdb.write("%d bytes:\n%s\n" % (len(data), data.decode("latin-1").replace("\r\n", "\n")))
+
+
+LogDump()
+VcpDump()
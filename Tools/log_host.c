@@ -0,0 +1,192 @@
+/*
+ * log_host.c
+ *
+ * Host harness of the number formatters of log.c, built on a PC with the stubs of log_port.h:
+ *
+ *     gcc -O2 -DLOG_PORT_HOST=1 -IInc Tools/log_host.c Src/log.c -o log_host
+ *     ./log_host [millions of values, default 10]
+ *
+ * It first checks the decimal and hexadecimal outputs of log_format_dec(), log_format_udec() and
+ * log_format_hex() against snprintf() for the edge values and random ones, each bit length equally
+ * likely, and exits with 1 at the first difference. It then prints how many millions of values per
+ * second each one formats. These functions run the kernels of the text output (format_decimal() and
+ * format_hexadecimal() behind process_decimal() and process_hexadecimal()), so a change of
+ * LOG_FAST_DECIMAL or LOG_FAST_HEX in log.h is checked and measured by rebuilding this program.
+ *
+ * With LOG_COPY_ARENA_SIZE and a line prefix (LOG_TIMESTAMPS, LOG_CONTEXT_IDS or LOG_LINE_PREFIX),
+ * it also checks that the line after a log_hexdump_copy() gets its prefix, which LOG_PRINTF once broke.
+ */
+
+
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+
+TIM_TypeDef logPortTim2;                // TIM2 of LOG_TIMESTAMP_GET(), not advanced here
+
+static uint32_t mRandom = 2463534242UL;
+static volatile uint32_t mSink;         // Keeps the benchmarked calls from being optimized out
+
+
+// xorshift32, with a random bit length so that short numbers are as frequent as long ones
+static uint32_t next_random(void)
+{
+    mRandom ^= mRandom << 13;
+    mRandom ^= mRandom >> 17;
+    mRandom ^= mRandom << 5;
+    return mRandom >> (mRandom % 32);
+}
+
+
+static int check(const char *name, uint32_t number, const char *pOutput, const char *pExpected)
+{
+    if(!strcmp(pOutput, pExpected))
+        return 0;
+    printf("%s(0x%08" PRIX32 "): \"%s\" instead of \"%s\"\n", name, number, pOutput, pExpected);
+    return 1;
+}
+
+
+static int check_number(uint32_t number)
+{
+    static const uint32_t hexBytes[] = {1, 2, 4};
+    char output[LOG_FORMAT_MAX];
+    char expected[LOG_FORMAT_MAX];
+    int nErrors = 0;
+    uint32_t i;
+
+    log_format_udec(output, sizeof(output), number);
+    snprintf(expected, sizeof(expected), "%" PRIu32, number);
+    nErrors += check("log_format_udec", number, output, expected);
+
+    log_format_dec(output, sizeof(output), (int32_t)number);
+    snprintf(expected, sizeof(expected), "%" PRId32, (int32_t)number);
+    nErrors += check("log_format_dec", number, output, expected);
+
+    for(i = 0; i < sizeof(hexBytes) / sizeof(hexBytes[0]); i++)
+    {
+        log_format_hex(output, sizeof(output), number, hexBytes[i]);
+        snprintf(expected, sizeof(expected), "%0*" PRIX32, (int)(2 * hexBytes[i]),
+                 (hexBytes[i] == 4) ? number : number & (uint32_t)((1UL << (8 * hexBytes[i])) - 1));
+        nErrors += check("log_format_hex", number, output, expected);
+    }
+    return nErrors;
+}
+
+
+static int fuzz(uint32_t nValues)
+{
+    static const uint32_t edges[] = {0, 1, 9, 10, 99, 100, 999, 1000, 9999, 10000, 43698, 43699, 65535,
+                                     99999, 100000, 999999, 1000000, 9999999, 10000000, 99999999,
+                                     100000000, 999999999, 1000000000, 0x7FFFFFFFUL, 0x80000000UL,
+                                     0xFFFFFFFFUL};
+    uint32_t i;
+
+    for(i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+    {
+        if(check_number(edges[i]) || check_number(-edges[i]))
+            return 1;
+    }
+    for(i = 0; i < nValues; i++)
+    {
+        if(check_number(next_random()))
+            return 1;
+    }
+    return 0;
+}
+
+
+#if LOG_COPY_ARENA_SIZE && (LOG_TIMESTAMPS || LOG_CONTEXT_IDS || LOG_LINE_PREFIX)
+static char mOutput[1024];
+static uint32_t mOutputLen = 0;
+
+
+static void capture(void *pData, uint32_t length)
+{
+    if(length > sizeof(mOutput) - 1 - mOutputLen)
+        length = sizeof(mOutput) - 1 - mOutputLen;
+    memcpy(&mOutput[mOutputLen], pData, length);
+    mOutputLen += length;
+    mOutput[mOutputLen] = '\0';
+}
+
+
+// The lines before and after a copied dump must start with the same prefix, the host clock does not move
+static int check_line_ends(void)
+{
+    static const uint8_t dump[4] = {1, 2, 3, 4};
+    const char *pLine;
+    const char *pText;
+    size_t prefixLen;
+
+    log_init(capture, NULL);
+    log_str("A\r\n");
+    log_hexdump_copy(dump, sizeof(dump));
+    log_str("B\r\n");
+    log_flush();
+
+    prefixLen = strcspn(mOutput, "A");
+    pText = strstr(mOutput, "B\r\n");
+    pLine = pText;
+    while(pLine && pLine > mOutput && pLine[-1] != '\n')
+        pLine--;
+    if(pLine && (size_t)(pText - pLine) == prefixLen && !strncmp(mOutput, pLine, prefixLen))
+        return 0;
+    printf("log_hexdump_copy(): the next line lost its prefix in \"%s\"\n", mOutput);
+    return 1;
+}
+#endif
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void bench(const char *name, uint32_t kind, uint32_t nValues)
+{
+    char output[LOG_FORMAT_MAX];
+    uint32_t number = 1;
+    uint32_t i;
+    double start = now();
+
+    for(i = 0; i < nValues; i++)
+    {
+        number = number * 1664525UL + 1013904223UL;
+        if(kind == 0)
+            mSink += log_format_udec(output, sizeof(output), number >> (i % 32));
+        else if(kind == 1)
+            mSink += log_format_dec(output, sizeof(output), (int32_t)number >> (i % 32));
+        else
+            mSink += log_format_hex(output, sizeof(output), number, 4);
+        mSink += (uint8_t)output[0];
+    }
+    printf("%-16s %8.2f M values/s\n", name, nValues / (now() - start) / 1e6);
+}
+
+
+int main(int argc, char *argv[])
+{
+    uint32_t nValues = 1000000UL * ((argc > 1) ? strtoul(argv[1], NULL, 0) : 10);
+
+    if(fuzz(nValues))
+        return 1;
+#if LOG_COPY_ARENA_SIZE && (LOG_TIMESTAMPS || LOG_CONTEXT_IDS || LOG_LINE_PREFIX)
+    if(check_line_ends())
+        return 1;
+#endif
+    printf("%" PRIu32 " random values formatted like printf\n", nValues);
+
+    bench("log_format_udec", 0, nValues);
+    bench("log_format_dec", 1, nValues);
+    bench("log_format_hex", 2, nValues);
+    return 0;
+}
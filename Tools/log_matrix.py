@@ -0,0 +1,247 @@
+#!/usr/bin/env python3
+"""
+Footprint and cycle report of a matrix of logger configurations, to pick a production one from data.
+
+For each combination of the option values, Inc/ is copied with the defines of log.h (or of the other
+headers) set to those values, and Src/log.c is compiled with the flags of the Debug (-O0) or Release
+(-Os) configuration of .cproject. arm-none-eabi-size gives the flash (text, rodata and data) and the
+RAM (data, bss and noinit) of log.o, and arm-none-eabi-nm the part of that RAM taken by the input
+FIFOs: their slots, commit flags, arenas and state. With LOG_FIFO_SPARE_RAM the FIFO is the .log_fifo
+region of the linker script instead, which log.o does not show.
+
+The "wire" option sets the output mode: text, binary (LOG_BINARY_OUTPUT), compressed (with
+LOG_COMPRESS) or packets (with LOG_PACKETS). "build" is Debug or Release. Any other name is a define,
+"--set NAME=V1,V2" replaces its values in the default matrix or adds it.
+
+With --run, the command is run for each combination to build and flash a firmware of the same
+configuration with LOG_BENCH set. It gets the header copy in LOG_MATRIX_INC, to put first in the
+include path, the configuration in LOG_MATRIX_BUILD and the combination in LOG_MATRIX_NAME. The
+output of the target is read from --port (through log_decode.py in the binary modes) until the
+"Bench summary" line of log_bench_run(), which adds the cycles per call (LOG_TIMESTAMP_GET(), TIM2 at
+core clock) of _log_var(), _log_str(), _log_char() and _log_array() of 16 items, the flush cycles per
+output byte, the longest time with interrupts disabled and the bytes per record on the wire.
+
+Usage:
+    log_matrix.py
+    log_matrix.py --set LOG_INPUT_FIFO_N_ELEM=64,256,1024 --set LOG_FAST_DECIMAL=0,1 --csv matrix.csv
+    log_matrix.py --set build=Release --run "make -C Release flash" --port /dev/ttyACM0
+"""
+
+import argparse
+import csv
+import itertools
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# Include paths and symbols of .cproject, Inc/ is replaced by the copy with the matrix defines
+INCLUDES = ["Core/Inc", "Drivers/CMSIS/Device/ST/STM32G0xx/Include", "Drivers/CMSIS/Include",
+            "Drivers/STM32G0xx_HAL_Driver/Inc", "Drivers/STM32G0xx_HAL_Driver/Inc/Legacy",
+            "Middlewares/Third_Party/FreeRTOS/Source/CMSIS_RTOS", "Middlewares/Third_Party/FreeRTOS/Source/include",
+            "Middlewares/Third_Party/FreeRTOS/Source/portable/GCC/ARM_CM0"]
+CFLAGS = ["-mcpu=cortex-m0plus", "-mthumb", "-mfloat-abi=soft", "-std=gnu11", "-ffunction-sections",
+          "-fdata-sections", "-DUSE_HAL_DRIVER", "-DSTM32G071xx", "-DUSE_FULL_LL_DRIVER"]
+BUILDS = {"Debug": ["-O0", "-g3", "-DDEBUG"], "Release": ["-Os", "-g3"]}
+
+WIRES = {
+    "text":       ({}, None),
+    "binary":     ({"LOG_BINARY_OUTPUT": "1"}, []),
+    "compressed": ({"LOG_BINARY_OUTPUT": "1", "LOG_COMPRESS": "1"}, ["--compressed"]),
+    "packets":    ({"LOG_BINARY_OUTPUT": "1", "LOG_PACKETS": "1"}, ["--packets"]),
+}                                               # Defines and log_decode.py arguments of each output mode
+
+DEFAULT_MATRIX = [
+    ("build", ["Debug", "Release"]),
+    ("wire", ["text", "binary", "compressed", "packets"]),
+    ("LOG_SUPPORT_ANSI_COLOR", ["0", "1"]),
+    ("LOG_INPUT_FIFO_N_ELEM", ["64", "256"]),
+]
+
+FLASH_SECTIONS = (".text", ".rodata", ".data", ".RamFunc", ".log_strings", ".log_regs")
+RAM_SECTIONS = (".data", ".bss", ".noinit", ".RamFunc", "COMMON")
+FIFO_SYMBOL = re.compile(r"^(_?log|error|isr|task)Fifo")
+
+SUMMARY = re.compile(r"Bench summary var (\d+) str (\d+) char (\d+) array16 (\d+) flush_byte (\d+) irq_off (\d+) "
+                     r"wire (\d+) records (\d+)")
+BENCH_COLUMNS = ["var", "str", "char", "array16", "flush/B", "irq off", "B/record"]
+
+
+def set_define(directory, name, value):
+    pattern = re.compile(r"^(#define %s +)(.*?)( *//.*)?$" % re.escape(name), re.M)
+    for header in sorted(os.listdir(directory)):
+        path = os.path.join(directory, header)
+        with open(path) as f:
+            text = f.read()
+        text, count = pattern.subn(lambda match: match.group(1) + value + (match.group(3) or ""), text, count=1)
+        if count:
+            with open(path, "w") as f:
+                f.write(text)
+            return
+    sys.exit("No #define %s in Inc/" % name)
+
+
+def make_headers(directory, config, extra):
+    shutil.copytree(os.path.join(ROOT, "Inc"), directory)
+    defines = dict(WIRES[config["wire"]][0])
+    defines.update((name, value) for name, value in config.items() if name not in ("build", "wire"))
+    defines.update(extra)
+    for name, value in defines.items():
+        set_define(directory, name, value)
+
+
+def section_sizes(tools, obj):
+    """Returns the flash and RAM bytes of the object"""
+    output = subprocess.run([tools + "size", "-A", obj], capture_output=True, text=True, check=True).stdout
+    flash = ram = 0
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) < 2 or not fields[1].isdigit():
+            continue
+        if fields[0].startswith(FLASH_SECTIONS):
+            flash += int(fields[1])
+        if fields[0].startswith(RAM_SECTIONS):
+            ram += int(fields[1])
+    return flash, ram
+
+
+def fifo_ram(tools, obj):
+    output = subprocess.run([tools + "nm", "-S", obj], capture_output=True, text=True, check=True).stdout
+    total = 0
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) == 4 and fields[2] in "bBdD" and FIFO_SYMBOL.match(fields[3]):
+            total += int(fields[1], 16)
+    return total
+
+
+def compile_log(tools, headers, build, obj):
+    command = [tools + "gcc", *CFLAGS, *BUILDS[build], "-I" + headers]
+    command += ["-I" + os.path.join(ROOT, path) for path in INCLUDES]
+    command += ["-c", os.path.join(ROOT, "Src", "log.c"), "-o", obj]
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode:
+        errors = [line for line in result.stderr.splitlines() if "error" in line]
+        return errors[0] if errors else "compile failed"
+    return None
+
+
+def read_summary(args, wire):
+    """Starts reading the port, then runs the build and flash command and waits for the summary"""
+    decode_args = WIRES[wire][1]
+    if decode_args is None:
+        import serial                           # pyserial, only needed with --run
+        port = serial.Serial(args.port, args.baud, timeout=0.1)
+        lines = None
+    else:
+        port = subprocess.Popen([sys.executable, os.path.join(ROOT, "Tools", "log_decode.py"), "--port", args.port,
+                                 "--baud", str(args.baud), *decode_args], stdout=subprocess.PIPE)
+        os.set_blocking(port.stdout.fileno(), False)
+        lines = port.stdout
+    try:
+        if subprocess.run(args.run, shell=True, env=os.environ).returncode:
+            return None
+        buffer = b""
+        deadline = time.monotonic() + args.timeout
+        while time.monotonic() < deadline:
+            data = port.read(4096) if lines is None else lines.read()
+            if not data:
+                time.sleep(0.05)
+                continue
+            buffer += data
+            match = SUMMARY.search(buffer.decode("ascii", "replace"))
+            if match:
+                values = [int(value) for value in match.groups()]
+                return values[:6] + ["%.2f" % (values[6] / values[7])]
+        return None
+    finally:
+        if lines is None:
+            port.close()
+        else:
+            port.terminate()
+            port.wait()
+
+
+def parse_matrix(sets):
+    matrix = [list(axis) for axis in DEFAULT_MATRIX]
+    for item in sets:
+        name, _, values = item.partition("=")
+        if not values:
+            sys.exit("--set needs NAME=V1,V2: %s" % item)
+        values = values.split(",")
+        if name == "build" and not set(values) <= set(BUILDS):
+            sys.exit("build is one of %s" % ", ".join(BUILDS))
+        if name == "wire" and not set(values) <= set(WIRES):
+            sys.exit("wire is one of %s" % ", ".join(WIRES))
+        for axis in matrix:
+            if axis[0] == name:
+                axis[1] = values
+                break
+        else:
+            matrix.append([name, values])
+    return matrix
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Footprint and benchmark report of a matrix of logger configurations")
+    parser.add_argument("--set", action="append", default=[], metavar="NAME=V1,V2",
+                        help="values of a define, or of build and wire, replacing the default ones")
+    parser.add_argument("--toolchain", default="arm-none-eabi-", help="prefix of gcc, size and nm")
+    parser.add_argument("--csv", help="also write the table to this file")
+    parser.add_argument("--run", help="command building and flashing the LOG_BENCH firmware of each configuration")
+    parser.add_argument("--port", help="serial port of the target output, with --run")
+    parser.add_argument("--baud", type=int, default=2000000, help="serial baud rate (default: 2000000)")
+    parser.add_argument("--timeout", type=float, default=30, help="seconds to wait for the bench summary")
+    args = parser.parse_args()
+    if args.run and not args.port:
+        parser.error("--run needs --port")
+
+    matrix = parse_matrix(args.set)
+    names = [axis[0] for axis in matrix]
+    columns = names + ["flash", "RAM", "FIFO RAM"] + (BENCH_COLUMNS if args.run else [])
+    rows = []
+    work = tempfile.mkdtemp(prefix="log_matrix_")
+    try:
+        for values in itertools.product(*(axis[1] for axis in matrix)):
+            config = dict(zip(names, values))
+            label = " ".join("%s=%s" % item for item in config.items())
+            headers = os.path.join(work, "inc%d" % len(rows))
+            obj = os.path.join(work, "log%d.o" % len(rows))
+            make_headers(headers, config, {})
+            error = compile_log(args.toolchain, headers, config["build"], obj)
+            if error:
+                print("%s: %s" % (label, error), file=sys.stderr)
+                rows.append(list(values) + ["error"] * (len(columns) - len(values)))
+                continue
+            row = list(values) + list(section_sizes(args.toolchain, obj)) + [fifo_ram(args.toolchain, obj)]
+            if args.run:
+                bench = os.path.join(work, "bench%d" % len(rows))
+                make_headers(bench, config, {"LOG_BENCH": "1"})
+                os.environ.update(LOG_MATRIX_INC=bench, LOG_MATRIX_BUILD=config["build"], LOG_MATRIX_NAME=label)
+                summary = read_summary(args, config["wire"])
+                if summary is None:
+                    print("%s: no bench summary" % label, file=sys.stderr)
+                row += summary or ["-"] * len(BENCH_COLUMNS)
+            rows.append(row)
+            print(label, file=sys.stderr)
+    finally:
+        shutil.rmtree(work)
+
+    widths = [max(len(str(cell)) for cell in column) for column in zip(columns, *rows)]
+    for row in [columns] + rows:
+        print("  ".join(str(cell).rjust(width) for cell, width in zip(row, widths)))
+    if args.csv:
+        with open(args.csv, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerow(columns)
+            writer.writerows(rows)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""
+Merges the outputs of log_decode.py --sync of several boards into one time ordered view.
+
+Each line of the inputs starts with "[<host seconds> node <n>] ", the host time that the decoder
+mapped its record timestamps to. The lines of all the files are written to stdout in the order of
+that time, the ones without prefix stay after the line they follow in their file. Each file must be
+in time order itself, which the decoder output is.
+
+Usage:
+    log_merge.py node1.log node2.log node3.log
+    log_merge.py --relative node*.log
+"""
+
+import argparse
+import heapq
+import re
+import sys
+
+
+PREFIX = re.compile(rb"^\[(\d+\.\d+) node ")
+
+
+def lines(path, index):
+    """Yields (host time, file index, line) of a decoder output, continuation lines joined"""
+    pending = None
+    with open(path, "rb") as f:
+        for line in f:
+            match = PREFIX.match(line)
+            if match and pending:
+                yield pending
+                pending = None
+            if match:
+                pending = (float(match.group(1)), index, line)
+            elif pending:
+                pending = (pending[0], index, pending[2] + line)
+    if pending:
+        yield pending
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Merge the log_decode.py --sync outputs of several boards")
+    parser.add_argument("inputs", nargs="+", help="decoder outputs, one per board")
+    parser.add_argument("--relative", action="store_true", help="print the times relative to the first line")
+    args = parser.parse_args()
+
+    start = None
+    for host_time, _, line in heapq.merge(*(lines(path, i) for i, path in enumerate(args.inputs))):
+        if args.relative:
+            if start is None:
+                start = host_time
+            line = PREFIX.sub(b"[%.6f node " % (host_time - start), line, count=1)
+        sys.stdout.buffer.write(line)
+
+
+if __name__ == "__main__":
+    main()
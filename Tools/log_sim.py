@@ -0,0 +1,265 @@
+#!/usr/bin/env python3
+"""
+Capacity planning of the logger pipeline: simulates producers -> input FIFO -> log thread -> VCP input
+buffer -> UART for each combination of a matrix of configurations, to size them from data instead of
+trial and error.
+
+The load is either a capture of the text output with LOG_TIMESTAMPS (the target one or the one of
+log_decode.py --timestamps), each line being logged at the time of its "[+ticks] " prefix, or synthetic
+profiles given by --profile RATE:SECONDS[:BYTES[:ITEMS]], lines per second for a number of seconds,
+Poisson arrivals unless --periodic. A line takes ITEMS slots of the input FIFO (--items for the
+captures) and gives its bytes to the output, the prefix included.
+
+The log thread wakes up every LOG_DELAY_LOOPS_MS, or as soon as the FIFO reaches
+LOG_WAKEUP_FILL_PERCENT, and renders the lines one after the other at the cycles per output byte of the
+"Bench summary" line of log_bench_run() (--bench gives a capture that has it, --flush-byte the value),
+releasing their slots. Each line is then written to the VCP input buffer of VCP_INPUT_BUFFER_SIZE bytes,
+which the UART empties at BAUD / 10 bytes per second, with the VCP_OVERFLOW_POLICY of --overflow. A line
+that finds the FIFO full is dropped, one whose bytes do not all fit in the buffer is damaged.
+
+For each configuration a row gives the lines, the percentage dropped at the FIFO, damaged at the VCP
+buffer and lost overall, which is the drop probability of a line, and the p50, p99 and worst
+latencies from the log call to the last byte on the wire, in milliseconds. The defaults of the matrix
+are the values of Inc/log.h, Inc/vcp.h and of the USART2 baud rate of Core/Src/main.c, "--set NAME=V1,V2"
+replaces the values of one of them.
+
+Usage:
+    log_sim.py capture.txt
+    log_sim.py --profile 200:5 --profile 2000:0.5:60 --set LOG_INPUT_FIFO_N_ELEM=64,256,1024
+    log_sim.py --bench bench.txt --set VCP_INPUT_BUFFER_SIZE=512,1024,4096 --set BAUD=115200,2000000 capture.txt
+"""
+
+import argparse
+import collections
+import csv
+import itertools
+import math
+import os
+import random
+import re
+import sys
+
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# Name of each parameter, the file and pattern its default is read from
+PARAMETERS = [
+    ("LOG_INPUT_FIFO_N_ELEM", "Inc/log.h", r"^#define LOG_INPUT_FIFO_N_ELEM +(\d+)"),
+    ("LOG_DELAY_LOOPS_MS", "Inc/log.h", r"^#define LOG_DELAY_LOOPS_MS +(\d+)"),
+    ("LOG_WAKEUP_FILL_PERCENT", "Inc/log.h", r"^#define LOG_WAKEUP_FILL_PERCENT +(\d+)"),
+    ("VCP_INPUT_BUFFER_SIZE", "Inc/vcp.h", r"^#define VCP_INPUT_BUFFER_SIZE +(\d+)"),
+    ("BAUD", "Core/Src/main.c", r"huart2\.Init\.BaudRate = (\d+);"),
+]
+
+TIMESTAMP = re.compile(rb"\[\+(\d+)\] ")
+SUMMARY = re.compile(rb"Bench summary var \d+ str \d+ char \d+ array16 \d+ flush_byte (\d+)")
+FLUSH_BYTE_CYCLES = 100                         # Rough figure of a Debug build, --bench or --flush-byte replace it
+CORE_HZ = 64000000
+OVERFLOW_POLICIES = ("truncate", "drop", "block")
+
+
+# A line of the load: log call time in seconds, input FIFO slots and output bytes
+Line = collections.namedtuple("Line", "time items bytes")
+
+
+def read_default(path, pattern):
+    with open(os.path.join(ROOT, path)) as f:
+        match = re.search(pattern, f.read(), re.M)
+    if not match:
+        sys.exit("No default for %s in %s" % (pattern, path))
+    return int(match.group(1))
+
+
+def read_capture(path, items, tick_hz):
+    """Returns the lines of a timestamped text capture, the ones without prefix at the time of the previous one"""
+    lines = []
+    ticks = 0
+    has_timestamps = False
+    with open(path, "rb") as f:
+        for text in f:
+            match = TIMESTAMP.search(text)
+            if match:
+                ticks += int(match.group(1))
+                has_timestamps = True
+            lines.append(Line(ticks / tick_hz, items, len(text.rstrip(b"\r\n")) + 2))
+    if not has_timestamps:
+        sys.exit("%s has no [+ticks] prefixes, build with LOG_TIMESTAMPS" % path)
+    return lines
+
+
+def make_profiles(profiles, is_periodic, seed):
+    rng = random.Random(seed)
+    lines = []
+    start = 0.0
+    for profile in profiles:
+        fields = profile.split(":")
+        if not 2 <= len(fields) <= 4:
+            sys.exit("--profile needs RATE:SECONDS[:BYTES[:ITEMS]]: %s" % profile)
+        rate, seconds = float(fields[0]), float(fields[1])
+        size = int(fields[2]) if len(fields) > 2 else 40
+        items = int(fields[3]) if len(fields) > 3 else 3
+        time = start
+        while rate > 0:
+            time += 1 / rate if is_periodic else rng.expovariate(rate)
+            if time >= start + seconds:
+                break
+            lines.append(Line(time, items, size))
+        start += seconds
+    return lines
+
+
+def read_flush_byte(path):
+    with open(path, "rb") as f:
+        match = SUMMARY.search(f.read())
+    if not match:
+        sys.exit("No Bench summary line in %s" % path)
+    return int(match.group(1))
+
+
+class Uart:
+    """The VCP input buffer emptied by the UART at a constant byte rate"""
+
+    def __init__(self, size, baud):
+        self.size = size
+        self.rate = baud / 10
+        self.end = 0.0                          # Time the bytes written so far are all sent
+
+    def level(self, time):
+        return max(0.0, (self.end - time) * self.rate)
+
+    def write(self, time, length):
+        """Returns the time the last byte is sent"""
+        self.end = max(self.end, time) + length / self.rate
+        return self.end
+
+
+def simulate(lines, config, flush_byte, core_hz, overflow):
+    """Returns the dropped and damaged counts and the sorted latencies in seconds"""
+    fifo_size = config["LOG_INPUT_FIFO_N_ELEM"]
+    period = config["LOG_DELAY_LOOPS_MS"] / 1000
+    wakeup_items = fifo_size * config["LOG_WAKEUP_FILL_PERCENT"] / 100
+    uart = Uart(config["VCP_INPUT_BUFFER_SIZE"], config["BAUD"])
+    fifo = collections.deque()
+    fifo_items = 0
+    now = 0.0                                   # Time of the log thread
+    wakeup = period
+    is_awake = False
+    dropped = damaged = 0
+    latencies = []
+
+    def run_until(time):
+        """Runs the log thread up to the given time"""
+        nonlocal fifo_items, now, wakeup, is_awake, damaged
+        while True:
+            if not is_awake:
+                if not fifo:
+                    return
+                if wakeup < fifo[0].time:           # Periods of an empty FIFO skipped at once
+                    wakeup += math.ceil((fifo[0].time - wakeup) / period) * period
+                if wakeup > time:
+                    return
+                now = max(now, wakeup)
+                is_awake = True
+            if not fifo:
+                wakeup = now + period
+                is_awake = False
+                continue
+            if now >= time:
+                return
+            line = fifo.popleft()
+            now = max(now, line.time) + line.bytes * flush_byte / core_hz
+            fifo_items -= line.items
+            room = uart.size - uart.level(now)
+            length = line.bytes
+            if length > room:
+                if overflow == "block":
+                    now += (length - room) / uart.rate
+                else:
+                    damaged += 1
+                    length = 0 if overflow == "drop" else int(room)
+            if length:
+                done = uart.write(now, length)
+                if length == line.bytes:
+                    latencies.append(done - line.time)
+
+    for line in lines:
+        run_until(line.time)
+        if fifo_items + line.items > fifo_size:
+            dropped += 1
+            continue
+        fifo.append(line)
+        fifo_items += line.items
+        if wakeup_items and not is_awake and fifo_items >= wakeup_items:
+            wakeup = line.time
+    run_until(float("inf"))
+    latencies.sort()
+    return dropped, damaged, latencies
+
+
+def percentile(values, ratio):
+    return values[min(len(values) - 1, int(len(values) * ratio))] if values else 0.0
+
+
+def parse_matrix(sets):
+    matrix = [[name, [read_default(path, pattern)]] for name, path, pattern in PARAMETERS]
+    for item in sets:
+        name, _, values = item.partition("=")
+        axis = next((axis for axis in matrix if axis[0] == name), None)
+        if axis is None or not values:
+            sys.exit("--set needs NAME=V1,V2 with NAME one of %s" % ", ".join(axis[0] for axis in matrix))
+        axis[1] = [int(value) for value in values.split(",")]
+    return matrix
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate the logger pipeline to size its FIFO, buffer, period and baud rate")
+    parser.add_argument("capture", nargs="?", help="text capture with [+ticks] line prefixes (LOG_TIMESTAMPS)")
+    parser.add_argument("--profile", action="append", default=[], metavar="RATE:SECONDS[:BYTES[:ITEMS]]",
+                        help="synthetic load segment, lines per second (default 40 bytes and 3 items per line)")
+    parser.add_argument("--periodic", action="store_true", help="evenly spaced synthetic lines instead of Poisson")
+    parser.add_argument("--seed", type=int, default=1, help="random seed of the Poisson arrivals")
+    parser.add_argument("--items", type=int, default=3, help="input FIFO items per line of the capture (default: 3)")
+    parser.add_argument("--tick-hz", type=float, default=64e6, help="LOG_TIMESTAMP_HZ of the capture (default: 64e6)")
+    parser.add_argument("--set", action="append", default=[], metavar="NAME=V1,V2",
+                        help="values of a parameter, replacing its default one")
+    parser.add_argument("--bench", help="capture with the Bench summary line of log_bench_run()")
+    parser.add_argument("--flush-byte", type=int, help="log thread cycles per output byte (default: %d)" % FLUSH_BYTE_CYCLES)
+    parser.add_argument("--core-hz", type=float, default=CORE_HZ, help="core clock (default: %d)" % CORE_HZ)
+    parser.add_argument("--overflow", choices=OVERFLOW_POLICIES, default="truncate", help="VCP_OVERFLOW_POLICY")
+    parser.add_argument("--csv", help="also write the table to this file")
+    args = parser.parse_args()
+    if bool(args.capture) == bool(args.profile):
+        parser.error("give either a capture or --profile")
+
+    if args.capture:
+        lines = read_capture(args.capture, args.items, args.tick_hz)
+    else:
+        lines = make_profiles(args.profile, args.periodic, args.seed)
+    flush_byte = args.flush_byte or (read_flush_byte(args.bench) if args.bench else FLUSH_BYTE_CYCLES)
+
+    matrix = parse_matrix(args.set)
+    names = [axis[0] for axis in matrix]
+    columns = names + ["lines", "FIFO drop %", "VCP damaged %", "lost %", "p50 ms", "p99 ms", "max ms"]
+    rows = []
+    for values in itertools.product(*(axis[1] for axis in matrix)):
+        config = dict(zip(names, values))
+        dropped, damaged, latencies = simulate(lines, config, flush_byte, args.core_hz, args.overflow)
+        total = len(lines) or 1
+        rows.append(list(values) + [len(lines), "%.2f" % (100 * dropped / total), "%.2f" % (100 * damaged / total),
+                                    "%.2f" % (100 * (dropped + damaged) / total),
+                                    "%.2f" % (1000 * percentile(latencies, 0.5)),
+                                    "%.2f" % (1000 * percentile(latencies, 0.99)),
+                                    "%.2f" % (1000 * (latencies[-1] if latencies else 0))])
+
+    widths = [max(len(str(cell)) for cell in column) for column in zip(columns, *rows)]
+    for row in [columns] + rows:
+        print("  ".join(str(cell).rjust(width) for cell, width in zip(row, widths)))
+    if args.csv:
+        with open(args.csv, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerow(columns)
+            writer.writerows(rows)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""
+Checks the output of the stress test of the logger (LOG_STRESS set to 1 in log.h, see Src/log_stress.c).
+
+Each event line "STR <producer> <counter> <check>" must carry the next counter of its producer and
+the check value of both. The gaps of each counter are counted as lost events in the stage they are
+found in, the lines starting with "STR " that do not parse or have a wrong check as corrupted, and
+the "STR total" lines at the end give the events lost after the last line of each producer. The text
+before "STR " is ignored, so the lines may have timestamps or context names, and the input may be
+the text output of the target or the one of log_decode.py in binary mode.
+
+At "STR end" (or at the end of the input) a table of the stages is printed, with the rate of events
+per second asked by the target, the events received and lost, the corrupted lines and the "Log input
+FIFO full" messages, then the highest rate that was sustained without any loss until then.
+
+With LOG_STRESS_JITTER, the "STR jitter" line of each stage adds the p99 and worst interrupt jitter
+of TIM6, in ticks (core cycles) above the shortest entry latency of the stage, and the "STR fifo"
+line names the LOG_FIFO_MODE of the build, so that the captures of each mode can be compared.
+
+Usage:
+    log_stress.py capture.txt
+    log_stress.py --port /dev/ttyACM0 --baud 2000000
+    log_decode.py --port /dev/ttyACM0 | log_stress.py
+"""
+
+import argparse
+import re
+import sys
+
+
+EVENT = re.compile(rb"STR (\d+) (\d+) ([0-9A-F]+)\r?$")
+STAGE = re.compile(rb"STR stage (\d+) rate (\d+)")
+TOTAL = re.compile(rb"STR total (\d+) (\d+)")
+JITTER = re.compile(rb"STR jitter (\d+) samples (\d+) min (\d+) p99 (\d+) max (\d+)")
+FIFO_MODE = re.compile(rb"STR fifo (\d+)")
+FIFO_MODES = {0: "LOG_FIFO_LOCKED", 1: "LOG_FIFO_MPSC", 2: "LOG_FIFO_SPSC"}
+FIFO_FULL = b"Log input FIFO full"
+
+
+def stress_check(producer, counter):
+    """Must match stress_check() in Src/log_stress.c"""
+    value = ((producer * 0x9E3779B1 + counter) * 0x85EBCA6B) & 0xFFFFFFFF
+    return value ^ (value >> 16)
+
+
+class Stage:
+    def __init__(self, number, rate):
+        self.number = number
+        self.rate = rate
+        self.received = 0
+        self.lost = 0
+        self.corrupted = 0
+        self.fifo_full = 0
+        self.jitter = None                              # p99 and max ticks above the min latency
+
+
+class Checker:
+    def __init__(self):
+        self.stages = [Stage(None, None)]               # Events before the first stage line
+        self.next_counters = {}
+        self.fifo_mode = None
+
+    def line(self, line):
+        """Returns False at the end of the test"""
+        stage = self.stages[-1]
+        if FIFO_FULL in line:
+            stage.fifo_full += 1
+        start = line.find(b"STR ")
+        if start < 0:
+            return True
+        line = line[start:].rstrip(b"\r\n")
+        match = EVENT.match(line)
+        if match:
+            producer, counter, check = int(match.group(1)), int(match.group(2)), int(match.group(3), 16)
+            if check != stress_check(producer, counter):
+                stage.corrupted += 1
+                return True
+            stage.lost += (counter - self.next_counters.get(producer, 0)) & 0xFFFFFFFF
+            self.next_counters[producer] = (counter + 1) & 0xFFFFFFFF
+            stage.received += 1
+        elif STAGE.match(line):
+            match = STAGE.match(line)
+            self.stages.append(Stage(int(match.group(1)), int(match.group(2))))
+        elif TOTAL.match(line):
+            match = TOTAL.match(line)
+            producer, total = int(match.group(1)), int(match.group(2))
+            stage.lost += (total - self.next_counters.get(producer, 0)) & 0xFFFFFFFF
+            self.next_counters[producer] = total
+        elif JITTER.match(line):
+            _, samples, minimum, p99, maximum = (int(value) for value in JITTER.match(line).groups())
+            if samples:
+                stage.jitter = (p99 - minimum, maximum - minimum)
+        elif FIFO_MODE.match(line):
+            mode = int(FIFO_MODE.match(line).group(1))
+            self.fifo_mode = FIFO_MODES.get(mode, str(mode))
+        elif line == b"STR end":
+            return False
+        else:
+            stage.corrupted += 1
+        return True
+
+    def report(self):
+        if self.fifo_mode:
+            print("FIFO mode %s" % self.fifo_mode)
+        print("stage  events/s  received      lost  corrupted  FIFO full  jitter p99  jitter max")
+        sustained = None
+        is_clean = True
+        for stage in self.stages:
+            if stage.number is None and not (stage.received or stage.lost or stage.corrupted or stage.fifo_full):
+                continue
+            jitter = ("%10d" % stage.jitter[0], "%10d" % stage.jitter[1]) if stage.jitter else ("-".rjust(10),) * 2
+            print("%5s  %8s  %8d  %8d  %9d  %9d  %s  %s" % ("-" if stage.number is None else stage.number,
+                                                           "-" if stage.rate is None else stage.rate,
+                                                           stage.received, stage.lost, stage.corrupted,
+                                                           stage.fifo_full, *jitter))
+            is_clean = is_clean and not (stage.lost or stage.corrupted or stage.fifo_full)
+            if is_clean and stage.rate is not None:
+                sustained = stage.rate
+        if sustained is None:
+            print("No stage without loss")
+        else:
+            print("Sustained without loss up to %d events/s" % sustained)
+        jitters = [stage.jitter for stage in self.stages if stage.jitter]
+        if jitters:
+            print("Interrupt jitter p99 %d, worst %d ticks" % (max(j[0] for j in jitters), max(j[1] for j in jitters)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the output of the LOG_STRESS stress test")
+    parser.add_argument("input", nargs="?", help="capture file (default: stdin)")
+    parser.add_argument("--port", help="serial port to read from instead of a file")
+    parser.add_argument("--baud", type=int, default=2000000, help="serial baud rate (default: 2000000)")
+    args = parser.parse_args()
+
+    if args.port:
+        import serial                                   # pyserial, only needed for live checks
+        stream = serial.Serial(args.port, args.baud, timeout=None)
+    elif args.input:
+        stream = open(args.input, "rb")
+    else:
+        stream = sys.stdin.buffer
+
+    checker = Checker()
+    try:
+        for line in iter(stream.readline, b""):
+            if not checker.line(line):
+                break
+    except KeyboardInterrupt:
+        pass
+    checker.report()
+    lost = sum(stage.lost + stage.corrupted for stage in checker.stages)
+    sys.exit(1 if lost else 0)
+
+
+if __name__ == "__main__":
+    main()